@@ -172,6 +172,14 @@ namespace DirectX
             // DDS_FLAGS_FORCE_DX10_EXT including miscFlags2 information (result may not be compatible with D3DX10 or D3DX11)
     };
 
+    enum TGA_FLAGS
+    {
+        TGA_FLAGS_NONE                  = 0x0,
+
+        TGA_FLAGS_RLE                   = 0x1,
+            // Writes run-length encoded TGA files (TGA writer defaults to uncompressed)
+    };
+
     enum WIC_FLAGS
     {
         WIC_FLAGS_NONE                  = 0x0,
@@ -331,6 +339,51 @@ namespace DirectX
         size_t  m_size;
     };
 
+    //---------------------------------------------------------------------------------
+    // Bitmap image container backed by a read-only file mapping
+    // (Image entries point directly into the mapped view whenever no conversion is required)
+    class MappedImage
+    {
+    public:
+        MappedImage() noexcept
+            : m_nimages(0), m_metadata{}, m_image(nullptr), m_view(nullptr), m_viewSize(0), m_hMapping(nullptr) {}
+        MappedImage(MappedImage&& moveFrom) noexcept
+            : m_nimages(0), m_metadata{}, m_image(nullptr), m_view(nullptr), m_viewSize(0), m_hMapping(nullptr) { *this = std::move(moveFrom); }
+        ~MappedImage() { Release(); }
+
+        MappedImage& __cdecl operator= (MappedImage&& moveFrom) noexcept;
+
+        MappedImage(const MappedImage&) = delete;
+        MappedImage& operator=(const MappedImage&) = delete;
+
+        void __cdecl Release();
+
+        const TexMetadata& __cdecl GetMetadata() const { return m_view ? m_metadata : m_scratch.GetMetadata(); }
+        const Image* __cdecl GetImage(_In_ size_t mip, _In_ size_t item, _In_ size_t slice) const;
+
+        const Image* __cdecl GetImages() const { return m_view ? m_image : m_scratch.GetImages(); }
+        size_t __cdecl GetImageCount() const { return m_view ? m_nimages : m_scratch.GetImageCount(); }
+
+        bool __cdecl IsMapped() const { return m_view != nullptr; }
+            // Returns false if the file required a legacy expansion and the pixels were copied into an owned ScratchImage
+
+        const ScratchImage& __cdecl GetScratchImage() const { return m_scratch; }
+
+    private:
+        size_t          m_nimages;
+        TexMetadata     m_metadata;
+        Image*          m_image;
+        void*           m_view;
+        size_t          m_viewSize;
+        HANDLE          m_hMapping;
+        ScratchImage    m_scratch;
+
+        friend HRESULT __cdecl LoadFromDDSFileMapped(
+            _In_z_ const wchar_t* szFile,
+            _In_ DWORD flags,
+            _Out_opt_ TexMetadata* metadata, _Out_ MappedImage& image);
+    };
+
     //---------------------------------------------------------------------------------
     // Image I/O
 
@@ -344,6 +397,13 @@ namespace DirectX
         _In_ DWORD flags,
         _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image);
 
+    HRESULT __cdecl LoadFromDDSFileMapped(
+        _In_z_ const wchar_t* szFile,
+        _In_ DWORD flags,
+        _Out_opt_ TexMetadata* metadata, _Out_ MappedImage& image);
+        // Maps the file rather than reading it; swizzle/alpha fix-ups are applied to copy-on-write pages,
+        // and legacy expansions fall back to an owned ScratchImage (see MappedImage::IsMapped)
+
     HRESULT __cdecl SaveToDDSMemory(
         _In_ const Image& image,
         _In_ DWORD flags,
@@ -358,6 +418,52 @@ namespace DirectX
         _In_reads_(nimages) const Image* images, _In_ size_t nimages, _In_ const TexMetadata& metadata,
         _In_ DWORD flags, _In_z_ const wchar_t* szFile);
 
+    class DDSStreamWriter
+        // Writes a DDS file one subresource at a time, in any order, at its final file offset
+        // (calls must be serialized by the caller)
+    {
+    public:
+        DDSStreamWriter() noexcept : m_hFile(nullptr), m_metadata{}, m_pending(0) {}
+        DDSStreamWriter(DDSStreamWriter&& moveFrom) noexcept : m_hFile(nullptr), m_metadata{}, m_pending(0) { *this = std::move(moveFrom); }
+        ~DDSStreamWriter() { Release(); }
+
+        DDSStreamWriter& __cdecl operator= (DDSStreamWriter&& moveFrom) noexcept;
+
+        DDSStreamWriter(const DDSStreamWriter&) = delete;
+        DDSStreamWriter& operator=(const DDSStreamWriter&) = delete;
+
+        HRESULT __cdecl Create(_In_z_ const wchar_t* szFile, _In_ const TexMetadata& metadata, _In_ DWORD flags);
+            // Creates the file, writes the header, and reserves space for all subresources
+
+        HRESULT __cdecl WriteImage(_In_ size_t mip, _In_ size_t item, _In_ size_t slice, _In_ const Image& image);
+            // Image must match the metadata format and the dimensions of that mip level
+
+        HRESULT __cdecl Finish();
+            // Fails if any subresource was never written, otherwise closes and keeps the file
+
+        void __cdecl Release();
+            // Closes the file, deleting it if Finish did not succeed
+
+        const TexMetadata& __cdecl GetMetadata() const { return m_metadata; }
+        size_t __cdecl GetPendingCount() const { return m_pending; }
+
+    private:
+        struct Subresource
+        {
+            uint64_t    offset;
+            size_t      width;
+            size_t      height;
+            size_t      rowPitch;
+            size_t      slicePitch;
+            bool        written;
+        };
+
+        HANDLE                      m_hFile;
+        TexMetadata                 m_metadata;
+        size_t                      m_pending;
+        std::vector<Subresource>    m_subresources;
+    };
+
     // HDR operations
     HRESULT __cdecl LoadFromHDRMemory(
         _In_reads_bytes_(size) const void* pSource, _In_ size_t size,
@@ -378,7 +484,9 @@ namespace DirectX
         _Out_opt_ TexMetadata* metadata, _Out_ ScratchImage& image);
 
     HRESULT __cdecl SaveToTGAMemory(_In_ const Image& image, _Out_ Blob& blob);
+    HRESULT __cdecl SaveToTGAMemory(_In_ const Image& image, _In_ DWORD flags, _Out_ Blob& blob);
     HRESULT __cdecl SaveToTGAFile(_In_ const Image& image, _In_z_ const wchar_t* szFile);
+    HRESULT __cdecl SaveToTGAFile(_In_ const Image& image, _In_ DWORD flags, _In_z_ const wchar_t* szFile);
 
     // WIC operations
     HRESULT __cdecl LoadFromWICMemory(
@@ -430,6 +538,10 @@ namespace DirectX
         _In_ DWORD flags, _Out_ ScratchImage& result);
         // Flip and/or rotate image
 
+    HRESULT __cdecl FlipRotate(_In_ const Image& srcImage, _In_ DWORD flags, _In_ const Image& destImage);
+        // Flip and/or rotate into an existing image of the same format
+        // destImage may be srcImage for flips, 180, and 90/270 of a square image (requires a directly movable pixel format)
+
     enum TEX_FILTER_FLAGS
     {
         TEX_FILTER_DEFAULT          = 0,
@@ -551,6 +663,9 @@ namespace DirectX
         _In_ DWORD flags, _Out_ ScratchImage& result);
         // Converts to/from a premultiplied alpha version of the texture
 
+    HRESULT __cdecl PremultiplyAlpha(_In_ const Image& srcImage, _In_ DWORD flags, _In_ const Image& destImage);
+        // Converts into an existing image of the same format and size, which may be srcImage itself
+
     enum TEX_COMPRESS_FLAGS
     {
         TEX_COMPRESS_DEFAULT            = 0,
@@ -631,6 +746,10 @@ namespace DirectX
 
         CNMAP_COMPUTE_OCCLUSION = 0x8000,
             // Computes a crude occlusion term stored in the alpha channel
+
+        CNMAP_SOBEL             = 0x10000,
+        CNMAP_SCHARR            = 0x20000,
+            // Derivative kernel (defaults to an unweighted 3x3 central difference)
     };
 
     HRESULT __cdecl ComputeNormalMap(
@@ -640,6 +759,46 @@ namespace DirectX
         _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
         _In_ DWORD flags, _In_ float amplitude, _In_ DXGI_FORMAT format, _Out_ ScratchImage& normalMaps);
 
+    enum NMAP_MIPS_FLAGS
+    {
+        NMAP_MIPS_DEFAULT           = 0,
+
+        NMAP_MIPS_VARIANCE_ALPHA    = 0x1,
+        NMAP_MIPS_VARIANCE_BLUE     = 0x2,
+            // Stores the Toksvig variance (1 - |Na|) / |Na| of the averaged normal in the given channel
+            // Blue suits normal maps that store XY in RG and reconstruct Z, but the destination format must still
+            // have a blue channel (R8G8/R16G16 have none to hold it); widen roughness with a^2 + 2 * variance
+    };
+
+    HRESULT __cdecl GenerateNormalMapMipMaps(
+        _In_ const Image& baseImage, _In_ DWORD flags, _In_ size_t levels, _Out_ ScratchImage& mipChain);
+    HRESULT __cdecl GenerateNormalMapMipMaps(
+        _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
+        _In_ DWORD flags, _In_ size_t levels, _Out_ ScratchImage& mipChain);
+        // Box-filters unit normals and renormalizes each level; levels of '0' indicates a full mipchain
+
+    enum SPECAA_FLAGS
+    {
+        SPECAA_DEFAULT          = 0,
+
+        SPECAA_CHANNEL_RED      = 0x1,
+        SPECAA_CHANNEL_GREEN    = 0x2,
+        SPECAA_CHANNEL_BLUE     = 0x3,
+        SPECAA_CHANNEL_ALPHA    = 0x4,
+            // Channel holding roughness (defaults to green as in glTF metallic-roughness maps)
+
+        SPECAA_LINEAR_ROUGHNESS = 0x100,
+            // Roughness is stored as GGX alpha rather than perceptual roughness (alpha = roughness^2)
+    };
+
+    HRESULT __cdecl ComputeSpecularAA(
+        _In_reads_(nimages) const Image* srcImages, _In_ size_t nimages, _In_ const TexMetadata& metadata,
+        _In_reads_(nnormals) const Image* normalImages, _In_ size_t nnormals, _In_ const TexMetadata& normalMetadata,
+        _In_ DWORD flags, _In_ float maxVariance, _Out_ ScratchImage& result);
+        // Widens roughness at every mip level by the normal-map variance under each texel (Toksvig)
+        //     alpha'^2 = alpha^2 + min(2 * variance, maxVariance)
+        // The normal map is usually the base level at equal or higher resolution than the roughness map
+
     //---------------------------------------------------------------------------------
     // Misc image operations
 
@@ -657,6 +816,7 @@ namespace DirectX
     HRESULT __cdecl CopyRectangle(
         _In_ const Image& srcImage, _In_ const Rect& srcRect, _In_ const Image& dstImage,
         _In_ DWORD filter, _In_ size_t xOffset, _In_ size_t yOffset);
+        // srcImage and dstImage may be the same image when the formats match; overlapping rectangles are handled
 
     enum CMSE_FLAGS
     {
@@ -679,6 +839,53 @@ namespace DirectX
 
     HRESULT __cdecl ComputeMSE(_In_ const Image& image1, _In_ const Image& image2, _Out_ float& mse, _Out_writes_opt_(4) float* mseV, _In_ DWORD flags = 0);
 
+    struct ImageMetrics
+    {
+        static const size_t HISTOGRAM_BINS = 16;
+
+        size_t      mip;
+        size_t      item;
+        size_t      slice;
+        size_t      width;
+        size_t      height;
+            // Location of the compared subresource
+
+        float       mse;
+        float       psnr;
+        float       ssim;
+        float       maxError;
+            // Combined results: MSE summed over channels (as ComputeMSE), PSNR and SSIM averaged
+            // over the channels compared, and the largest absolute error of any channel
+
+        float       mseV[4];
+        float       psnrV[4];
+        float       ssimV[4];
+        float       maxErrorV[4];
+            // Per-channel (RGBA) results; PSNR is +INF for identical channels
+
+        uint32_t    histogram[HISTOGRAM_BINS];
+            // Pixel count by largest per-channel absolute error, bucketed evenly over [0,1]
+    };
+
+    HRESULT __cdecl ComputeMetrics(_In_ const Image& image1, _In_ const Image& image2, _In_ DWORD flags, _Out_ ImageMetrics& metrics);
+    HRESULT __cdecl ComputeMetrics(
+        _In_reads_(nimages1) const Image* images1, _In_ size_t nimages1, _In_ const TexMetadata& metadata1,
+        _In_reads_(nimages2) const Image* images2, _In_ size_t nimages2, _In_ const TexMetadata& metadata2,
+        _In_ DWORD flags, _Out_ std::vector<ImageMetrics>& metrics);
+        // Computes MSE, PSNR, SSIM (8x8 windows), max error, and an error histogram using CMSE_FLAGS;
+        // the array form compares every mip, array item, and volume slice of two matching textures
+
+    enum METRICS_REPORT_FLAGS
+    {
+        METRICS_REPORT_JSON         = 0x0,
+        METRICS_REPORT_CSV          = 0x1,
+    };
+
+    HRESULT __cdecl SaveMetricsReport(
+        _In_reads_(nmetrics) const ImageMetrics* metrics, _In_ size_t nmetrics,
+        _In_ DWORD flags, _Out_ Blob& blob);
+        // Writes results as JSON (an array of objects) or CSV (one row per subresource)
+
     HRESULT __cdecl EvaluateImage(
         _In_ const Image& image,
         _In_ std::function<void __cdecl(_In_reads_(width) const XMVECTOR* pixels, size_t width, size_t y)> pixelFunc);
@@ -697,6 +904,65 @@ namespace DirectX
         _In_reads_(width) const XMVECTOR* inPixels, size_t width, size_t y)> pixelFunc,
         ScratchImage& result);
 
+    //---------------------------------------------------------------------------------
+    // Fused image operation pipeline
+
+    enum TEX_PIPELINE_FLAGS
+    {
+        TEX_PIPELINE_DEFAULT        = 0,
+
+        TEX_PIPELINE_PARALLEL       = 0x1,
+            // Processes bands of output rows in parallel (requires OpenMP); Transform functions must be thread-safe
+    };
+
+    class ImagePipeline
+        // Records Convert, Resize, PremultiplyAlpha, and Transform operations and runs them fused over
+        // scanlines in a single pass, with the result as the only image allocated. Intermediate results
+        // stay in float and are not quantized to intermediate formats; Resize uses the non-WIC filters.
+    {
+    public:
+        ImagePipeline& __cdecl Convert(_In_ DXGI_FORMAT format, _In_ DWORD filter = TEX_FILTER_DEFAULT, _In_ float threshold = TEX_THRESHOLD_DEFAULT);
+            // Dithering filters are not supported
+
+        ImagePipeline& __cdecl Resize(_In_ size_t width, _In_ size_t height, _In_ DWORD filter = TEX_FILTER_DEFAULT);
+            // Point, box, linear, and cubic filters are supported
+
+        ImagePipeline& __cdecl PremultiplyAlpha(_In_ DWORD flags = TEX_PMALPHA_DEFAULT);
+
+        ImagePipeline& __cdecl Transform(
+            _In_ std::function<void __cdecl(_Out_writes_(width) XMVECTOR* outPixels,
+            _In_reads_(width) const XMVECTOR* inPixels, size_t width, size_t y)> pixelFunc);
+            // y is the row within the image as it is at that point of the pipeline
+
+        void __cdecl Clear() { m_ops.clear(); }
+        size_t __cdecl GetOperationCount() const { return m_ops.size(); }
+
+        HRESULT __cdecl Execute(_In_ const Image& srcImage, _In_ DWORD flags, _Out_ ScratchImage& result) const;
+            // Operations are validated against the source here; flags are TEX_PIPELINE_FLAGS
+
+    private:
+        enum OPERATION_TYPE
+        {
+            OP_CONVERT,
+            OP_RESIZE,
+            OP_PMALPHA,
+            OP_TRANSFORM,
+        };
+
+        struct Operation
+        {
+            OPERATION_TYPE  type;
+            DXGI_FORMAT     format;
+            DWORD           flags;
+            size_t          width;
+            size_t          height;
+            float           threshold;
+            std::function<void __cdecl(XMVECTOR* outPixels, const XMVECTOR* inPixels, size_t width, size_t y)> pixelFunc;
+        };
+
+        std::vector<Operation> m_ops;
+    };
+
     //---------------------------------------------------------------------------------
     // WIC utility code
 
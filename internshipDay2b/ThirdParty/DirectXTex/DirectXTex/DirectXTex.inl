@@ -122,3 +122,15 @@ inline HRESULT __cdecl SaveToDDSFile(const Image& image, DWORD flags, const wcha
 
     return SaveToDDSFile(&image, 1, mdata, flags, szFile);
 }
+
+_Use_decl_annotations_
+inline HRESULT __cdecl SaveToTGAMemory(const Image& image, Blob& blob)
+{
+    return SaveToTGAMemory(image, TGA_FLAGS_NONE, blob);
+}
+
+_Use_decl_annotations_
+inline HRESULT __cdecl SaveToTGAFile(const Image& image, const wchar_t* szFile)
+{
+    return SaveToTGAFile(image, TGA_FLAGS_NONE, szFile);
+}
@@ -189,9 +189,6 @@ namespace
 #endif
 
     const XMVECTORF32 g_Grayscale = { { { 0.2125f, 0.7154f, 0.0721f, 0.0f } } };
-    const XMVECTORF32 g_HalfMin   = { { { -65504.f, -65504.f, -65504.f, -65504.f } } };
-    const XMVECTORF32 g_HalfMax   = { { { 65504.f, 65504.f, 65504.f, 65504.f } } };
-    const XMVECTORF32 g_8BitBias  = { { { 0.5f / 255.f, 0.5f / 255.f, 0.5f / 255.f, 0.5f / 255.f } } };
 }
 
 //-------------------------------------------------------------------------------------
@@ -2719,26 +2716,12 @@ HRESULT DirectX::_ConvertFromR16G16B16A16(const Image& srcImage, const Image& de
 
 
 //-------------------------------------------------------------------------------------
-// Convert from Linear RGB to sRGB
-//
-// if C_linear <= 0.0031308 -> C_srgb = 12.92 * C_linear
-// if C_linear >  0.0031308 -> C_srgb = ( 1 + a ) * pow( C_Linear, 1 / 2.4 ) - a
-//                             where a = 0.055
+// Applies the sRGB rules of the *Linear scanline functions: sRGB formats always
+// convert, and formats that can't hold sRGB data never do
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-bool DirectX::_StoreScanlineLinear(
-    void* pDestination,
-    size_t size,
-    DXGI_FORMAT format,
-    XMVECTOR* pSource,
-    size_t count,
-    DWORD flags,
-    float threshold)
+DWORD DirectX::_ScanlineSRGBFlags(DXGI_FORMAT format, DWORD flags)
 {
-    assert(pDestination && size > 0);
-    assert(pSource && count > 0 && ((reinterpret_cast<uintptr_t>(pSource) & 0xF) == 0));
-    assert(IsValid(format) && !IsTypeless(format) && !IsCompressed(format) && !IsPlanar(format) && !IsPalettized(format));
-
     switch (format)
     {
     case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
@@ -2778,6 +2761,33 @@ bool DirectX::_StoreScanlineLinear(
         break;
     }
 
+    return flags;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Convert from Linear RGB to sRGB
+//
+// if C_linear <= 0.0031308 -> C_srgb = 12.92 * C_linear
+// if C_linear >  0.0031308 -> C_srgb = ( 1 + a ) * pow( C_Linear, 1 / 2.4 ) - a
+//                             where a = 0.055
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+bool DirectX::_StoreScanlineLinear(
+    void* pDestination,
+    size_t size,
+    DXGI_FORMAT format,
+    XMVECTOR* pSource,
+    size_t count,
+    DWORD flags,
+    float threshold)
+{
+    assert(pDestination && size > 0);
+    assert(pSource && count > 0 && ((reinterpret_cast<uintptr_t>(pSource) & 0xF) == 0));
+    assert(IsValid(format) && !IsTypeless(format) && !IsCompressed(format) && !IsPlanar(format) && !IsPalettized(format));
+
+    flags = _ScanlineSRGBFlags(format, flags);
+
     // sRGB output processing (Linear RGB -> sRGB)
     if (flags & TEX_FILTER_SRGB_OUT)
     {
@@ -2814,44 +2824,7 @@ bool DirectX::_LoadScanlineLinear(
     assert(pSource && size > 0);
     assert(IsValid(format) && !IsTypeless(format, false) && !IsCompressed(format) && !IsPlanar(format) && !IsPalettized(format));
 
-    switch (format)
-    {
-    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
-    case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
-        flags |= TEX_FILTER_SRGB;
-        break;
-
-    case DXGI_FORMAT_R32G32B32A32_FLOAT:
-    case DXGI_FORMAT_R32G32B32_FLOAT:
-    case DXGI_FORMAT_R16G16B16A16_FLOAT:
-    case DXGI_FORMAT_R16G16B16A16_UNORM:
-    case DXGI_FORMAT_R32G32_FLOAT:
-    case DXGI_FORMAT_R10G10B10A2_UNORM:
-    case DXGI_FORMAT_R11G11B10_FLOAT:
-    case DXGI_FORMAT_R8G8B8A8_UNORM:
-    case DXGI_FORMAT_R16G16_FLOAT:
-    case DXGI_FORMAT_R16G16_UNORM:
-    case DXGI_FORMAT_R32_FLOAT:
-    case DXGI_FORMAT_R8G8_UNORM:
-    case DXGI_FORMAT_R16_FLOAT:
-    case DXGI_FORMAT_R16_UNORM:
-    case DXGI_FORMAT_R8_UNORM:
-    case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
-    case DXGI_FORMAT_R8G8_B8G8_UNORM:
-    case DXGI_FORMAT_G8R8_G8B8_UNORM:
-    case DXGI_FORMAT_B5G6R5_UNORM:
-    case DXGI_FORMAT_B5G5R5A1_UNORM:
-    case DXGI_FORMAT_B8G8R8A8_UNORM:
-    case DXGI_FORMAT_B8G8R8X8_UNORM:
-    case DXGI_FORMAT_B4G4R4A4_UNORM:
-        break;
-
-    default:
-        // can't treat A8, XR, Depth, SNORM, UINT, or SINT as sRGB
-        flags &= ~TEX_FILTER_SRGB;
-        break;
-    }
+    flags = _ScanlineSRGBFlags(format, flags);
 
     if (_LoadScanline(pDestination, count, pSource, size, format))
     {
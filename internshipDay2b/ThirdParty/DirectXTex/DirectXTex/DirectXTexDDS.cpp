@@ -1392,17 +1392,15 @@ namespace
         return S_OK;
     }
 
-    HRESULT CopyImageInPlace(DWORD convFlags, _In_ const ScratchImage& image)
+    HRESULT CopyImageInPlace(
+        DWORD convFlags,
+        _In_reads_(nimages) const Image* images,
+        size_t nimages,
+        _In_ const TexMetadata& metadata)
     {
-        if (!image.GetPixels())
-            return E_FAIL;
-
-        const Image* images = image.GetImages();
         if (!images)
             return E_FAIL;
 
-        const TexMetadata& metadata = image.GetMetadata();
-
         if (IsPlanar(metadata.format))
             return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
 
@@ -1410,7 +1408,7 @@ namespace
         if (convFlags & CONV_FLAGS_SWIZZLE)
             tflags |= TEXP_SCANLINE_LEGACY;
 
-        for (size_t i = 0; i < image.GetImageCount(); ++i)
+        for (size_t i = 0; i < nimages; ++i)
         {
             const Image* img = &images[i];
             uint8_t *pPixels = img->pixels;
@@ -1436,6 +1434,14 @@ namespace
 
         return S_OK;
     }
+
+    HRESULT CopyImageInPlace(DWORD convFlags, _In_ const ScratchImage& image)
+    {
+        if (!image.GetPixels())
+            return E_FAIL;
+
+        return CopyImageInPlace(convFlags, image.GetImages(), image.GetImageCount(), image.GetMetadata());
+    }
 }
 
 
@@ -1777,6 +1783,161 @@ HRESULT DirectX::LoadFromDDSFile(
 }
 
 
+//-------------------------------------------------------------------------------------
+// Load a DDS file from disk by mapping it into the address space
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::LoadFromDDSFileMapped(
+    const wchar_t* szFile,
+    DWORD flags,
+    TexMetadata* metadata,
+    MappedImage& image)
+{
+    if (!szFile)
+        return E_INVALIDARG;
+
+    image.Release();
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hFile(safe_handle(CreateFile2(szFile, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr)));
+#else
+    ScopedHandle hFile(safe_handle(CreateFileW(szFile, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr)));
+#endif
+
+    if (!hFile)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    // Get the file size
+    FILE_STANDARD_INFO fileInfo;
+    if (!GetFileInformationByHandleEx(hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+#if !defined(_WIN64)
+    // File is too big to map into a 32-bit address space
+    if (fileInfo.EndOfFile.HighPart > 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE);
+    }
+#endif
+
+    // Need at least enough data to fill the standard header and magic number to be a valid DDS
+    if (fileInfo.EndOfFile.QuadPart < LONGLONG(sizeof(DDS_HEADER) + sizeof(uint32_t)))
+    {
+        return E_FAIL;
+    }
+
+    const size_t fileSize = static_cast<size_t>(fileInfo.EndOfFile.QuadPart);
+
+    // Decode the header from a read-only view to find out if any fix-ups are needed
+    ScopedHandle hMapping(CreateFileMappingW(hFile.get(), nullptr, PAGE_WRITECOPY, 0, 0, nullptr));
+    if (!hMapping)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    const size_t MAX_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+
+    DWORD convFlags = 0;
+    TexMetadata mdata;
+    {
+        const void* pHeader = MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, std::min(fileSize, MAX_HEADER_SIZE));
+        if (!pHeader)
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        HRESULT hr = DecodeDDSHeader(pHeader, std::min(fileSize, MAX_HEADER_SIZE), flags, mdata, convFlags);
+        (void)UnmapViewOfFile(pHeader);
+        if (FAILED(hr))
+            return hr;
+    }
+
+    size_t offset = sizeof(uint32_t) + sizeof(DDS_HEADER);
+    if (convFlags & CONV_FLAGS_DX10)
+        offset += sizeof(DDS_HEADER_DXT10);
+
+    if (convFlags & CONV_FLAGS_PAL8)
+        offset += (256 * sizeof(uint32_t));
+
+    if (fileSize <= offset)
+        return E_FAIL;
+
+    if ((convFlags & CONV_FLAGS_EXPAND) || (flags & (DDS_FLAGS_LEGACY_DWORD | DDS_FLAGS_BAD_DXTN_TAILS)))
+    {
+        // Layout on disk doesn't match the in-memory layout, so expand into an owned copy
+        const void* pView = MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0);
+        if (!pView)
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        HRESULT hr = LoadFromDDSMemory(pView, fileSize, flags, metadata, image.m_scratch);
+        (void)UnmapViewOfFile(pView);
+        if (FAILED(hr))
+        {
+            image.Release();
+            return hr;
+        }
+
+        image.m_metadata = mdata;
+        return S_OK;
+    }
+
+    size_t pixelSize, nimages;
+    if (!_DetermineImageArray(mdata, CP_FLAGS_NONE, nimages, pixelSize))
+        return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+
+    if (pixelSize > (fileSize - offset))
+        return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+
+    std::unique_ptr<Image[]> images(new (std::nothrow) Image[nimages]);
+    if (!images)
+        return E_OUTOFMEMORY;
+
+    // Swizzle and alpha fix-ups write to private copy-on-write pages; otherwise the view is left read-only
+    const bool fixup = (convFlags & (CONV_FLAGS_SWIZZLE | CONV_FLAGS_NOALPHA)) != 0;
+
+    void* pView = MapViewOfFile(hMapping.get(), fixup ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+    if (!pView)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    if (!_SetupImageArray(static_cast<uint8_t*>(pView) + offset, pixelSize, mdata, CP_FLAGS_NONE, images.get(), nimages))
+    {
+        (void)UnmapViewOfFile(pView);
+        return E_FAIL;
+    }
+
+    if (fixup)
+    {
+        HRESULT hr = CopyImageInPlace(convFlags, images.get(), nimages, mdata);
+        if (FAILED(hr))
+        {
+            (void)UnmapViewOfFile(pView);
+            return hr;
+        }
+    }
+
+    image.m_nimages = nimages;
+    image.m_metadata = mdata;
+    image.m_image = images.release();
+    image.m_view = pView;
+    image.m_viewSize = fileSize;
+    image.m_hMapping = hMapping.release();
+
+    if (metadata)
+        memcpy(metadata, &mdata, sizeof(TexMetadata));
+
+    return S_OK;
+}
+
+
 //-------------------------------------------------------------------------------------
 // Save a DDS file to memory
 //-------------------------------------------------------------------------------------
@@ -2207,3 +2368,292 @@ HRESULT DirectX::SaveToDDSFile(
 
     return S_OK;
 }
+
+
+//=====================================================================================
+// DDSStreamWriter - Incremental DDS file writer
+//=====================================================================================
+
+DDSStreamWriter& DDSStreamWriter::operator= (DDSStreamWriter&& moveFrom) noexcept
+{
+    if (this != &moveFrom)
+    {
+        Release();
+
+        m_hFile = moveFrom.m_hFile;
+        m_metadata = moveFrom.m_metadata;
+        m_pending = moveFrom.m_pending;
+        m_subresources = std::move(moveFrom.m_subresources);
+
+        moveFrom.m_hFile = nullptr;
+        moveFrom.m_pending = 0;
+    }
+    return *this;
+}
+
+_Use_decl_annotations_
+HRESULT DDSStreamWriter::Create(const wchar_t* szFile, const TexMetadata& metadata, DWORD flags)
+{
+    if (!szFile)
+        return E_INVALIDARG;
+
+    Release();
+
+    // Create DDS Header
+    const size_t MAX_HEADER_SIZE = sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+    uint8_t header[MAX_HEADER_SIZE];
+    size_t required;
+    HRESULT hr = _EncodeDDSHeader(metadata, flags, header, MAX_HEADER_SIZE, required);
+    if (FAILED(hr))
+        return hr;
+
+    if (IsPlanar(metadata.format) && metadata.dimension == TEX_DIMENSION_TEXTURE3D)
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    // Compute the final layout of every subresource
+    size_t nimages, pixelSize;
+    if (!_DetermineImageArray(metadata, CP_FLAGS_NONE, nimages, pixelSize))
+        return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+
+    std::vector<Subresource> subresources;
+    subresources.reserve(nimages);
+
+    uint64_t offset = required;
+
+    switch (static_cast<DDS_RESOURCE_DIMENSION>(metadata.dimension))
+    {
+    case DDS_DIMENSION_TEXTURE1D:
+    case DDS_DIMENSION_TEXTURE2D:
+        for (size_t item = 0; item < metadata.arraySize; ++item)
+        {
+            size_t w = metadata.width;
+            size_t h = metadata.height;
+
+            for (size_t level = 0; level < metadata.mipLevels; ++level)
+            {
+                Subresource sub = {};
+                hr = ComputePitch(metadata.format, w, h, sub.rowPitch, sub.slicePitch, CP_FLAGS_NONE);
+                if (FAILED(hr))
+                    return hr;
+
+                sub.offset = offset;
+                sub.width = w;
+                sub.height = h;
+                subresources.push_back(sub);
+
+                offset += sub.slicePitch;
+
+                if (h > 1)
+                    h >>= 1;
+
+                if (w > 1)
+                    w >>= 1;
+            }
+        }
+        break;
+
+    case DDS_DIMENSION_TEXTURE3D:
+        {
+            if (metadata.arraySize != 1)
+                return E_FAIL;
+
+            size_t w = metadata.width;
+            size_t h = metadata.height;
+            size_t d = metadata.depth;
+
+            for (size_t level = 0; level < metadata.mipLevels; ++level)
+            {
+                Subresource sub = {};
+                hr = ComputePitch(metadata.format, w, h, sub.rowPitch, sub.slicePitch, CP_FLAGS_NONE);
+                if (FAILED(hr))
+                    return hr;
+
+                sub.width = w;
+                sub.height = h;
+
+                for (size_t slice = 0; slice < d; ++slice)
+                {
+                    sub.offset = offset;
+                    subresources.push_back(sub);
+
+                    offset += sub.slicePitch;
+                }
+
+                if (h > 1)
+                    h >>= 1;
+
+                if (w > 1)
+                    w >>= 1;
+
+                if (d > 1)
+                    d >>= 1;
+            }
+        }
+        break;
+
+    default:
+        return E_FAIL;
+    }
+
+    if (subresources.size() != nimages)
+        return E_UNEXPECTED;
+
+    // Create file and write header
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+    ScopedHandle hFile(safe_handle(CreateFile2(szFile, GENERIC_WRITE | DELETE, 0, CREATE_ALWAYS, nullptr)));
+#else
+    ScopedHandle hFile(safe_handle(CreateFileW(szFile, GENERIC_WRITE | DELETE, 0, nullptr, CREATE_ALWAYS, 0, nullptr)));
+#endif
+    if (!hFile)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    auto_delete_file delonfail(hFile.get());
+
+    DWORD bytesWritten;
+    if (!WriteFile(hFile.get(), header, static_cast<DWORD>(required), &bytesWritten, nullptr))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    if (bytesWritten != required)
+    {
+        return E_FAIL;
+    }
+
+    // Reserve the full file size up front so out-of-order writes don't extend the file repeatedly
+    FILE_END_OF_FILE_INFO eof = {};
+    eof.EndOfFile.QuadPart = static_cast<LONGLONG>(offset);
+    if (!SetFileInformationByHandle(hFile.get(), FileEndOfFileInfo, &eof, sizeof(eof)))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    delonfail.clear();
+
+    m_hFile = hFile.release();
+    m_metadata = metadata;
+    m_pending = nimages;
+    m_subresources = std::move(subresources);
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DDSStreamWriter::WriteImage(size_t mip, size_t item, size_t slice, const Image& image)
+{
+    if (!m_hFile)
+        return E_UNEXPECTED;
+
+    if (!image.pixels)
+        return E_POINTER;
+
+    if (image.format != m_metadata.format)
+        return E_FAIL;
+
+    size_t index = m_metadata.ComputeIndex(mip, item, slice);
+    if (index >= m_subresources.size())
+        return E_INVALIDARG;
+
+    Subresource& sub = m_subresources[index];
+
+    if (image.width != sub.width || image.height != sub.height)
+        return E_INVALIDARG;
+
+    assert(image.rowPitch > 0);
+    assert(image.slicePitch > 0);
+
+    OVERLAPPED ov = {};
+    uint64_t offset = sub.offset;
+    DWORD bytesWritten;
+
+    if ((image.slicePitch == sub.slicePitch) && (sub.slicePitch <= UINT32_MAX))
+    {
+        ov.Offset = static_cast<DWORD>(offset);
+        ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        if (!WriteFile(m_hFile, image.pixels, static_cast<DWORD>(sub.slicePitch), &bytesWritten, &ov))
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        if (bytesWritten != sub.slicePitch)
+        {
+            return E_FAIL;
+        }
+    }
+    else
+    {
+        if (image.rowPitch < sub.rowPitch)
+        {
+            // DDS uses 1-byte alignment, so if this is happening then the input pitch isn't actually a full line of data
+            return E_FAIL;
+        }
+
+        if (sub.rowPitch > UINT32_MAX)
+            return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+
+        const uint8_t * __restrict sPtr = image.pixels;
+
+        size_t lines = ComputeScanlines(m_metadata.format, image.height);
+        for (size_t j = 0; j < lines; ++j)
+        {
+            ov.Offset = static_cast<DWORD>(offset);
+            ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+            if (!WriteFile(m_hFile, sPtr, static_cast<DWORD>(sub.rowPitch), &bytesWritten, &ov))
+            {
+                return HRESULT_FROM_WIN32(GetLastError());
+            }
+
+            if (bytesWritten != sub.rowPitch)
+            {
+                return E_FAIL;
+            }
+
+            sPtr += image.rowPitch;
+            offset += sub.rowPitch;
+        }
+    }
+
+    if (!sub.written)
+    {
+        sub.written = true;
+        --m_pending;
+    }
+
+    return S_OK;
+}
+
+HRESULT DDSStreamWriter::Finish()
+{
+    if (!m_hFile)
+        return E_UNEXPECTED;
+
+    if (m_pending > 0)
+        return E_FAIL;
+
+    CloseHandle(m_hFile);
+    m_hFile = nullptr;
+
+    return S_OK;
+}
+
+void DDSStreamWriter::Release()
+{
+    if (m_hFile)
+    {
+        {
+            // Incomplete file, so mark it for deletion before closing the handle
+            auto_delete_file delonfail(m_hFile);
+        }
+
+        CloseHandle(m_hFile);
+        m_hFile = nullptr;
+    }
+
+    m_pending = 0;
+    m_subresources.clear();
+    memset(&m_metadata, 0, sizeof(m_metadata));
+}
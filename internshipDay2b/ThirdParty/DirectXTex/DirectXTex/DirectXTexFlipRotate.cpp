@@ -171,6 +171,325 @@ namespace
 
         return S_OK;
     }
+
+
+    //-------------------------------------------------------------------------------------
+    // Direct flip/rotate on the stored texels
+    //
+    // Works for any format where each pixel is a whole number of bytes that can be moved
+    // on its own, so no conversion or temporary image is needed and flips, 180 and square
+    // 90/270 rotations can run in place. Rotations by 90/270 are done in cache-sized tiles.
+    //-------------------------------------------------------------------------------------
+    const size_t c_RotateTileSize = 32;
+
+    template<typename T>
+    inline const T* SrcPixel(const Image& image, size_t x, size_t y)
+    {
+        return reinterpret_cast<const T*>(image.pixels + y * image.rowPitch) + x;
+    }
+
+    template<typename T>
+    inline T* DestPixel(const Image& image, size_t x, size_t y)
+    {
+        return reinterpret_cast<T*>(image.pixels + y * image.rowPitch) + x;
+    }
+
+    template<typename T>
+    inline void ReverseRow(T* row, size_t width)
+    {
+        for (size_t x = 0, x2 = width - 1; x < x2; ++x, --x2)
+        {
+            std::swap(row[x], row[x2]);
+        }
+    }
+
+    template<typename T>
+    void FlipPixels(const Image& srcImage, bool flipH, bool flipV, const Image& destImage)
+    {
+        const size_t width = srcImage.width;
+        const size_t height = srcImage.height;
+
+        if (srcImage.pixels == destImage.pixels)
+        {
+            if (flipV)
+            {
+                for (size_t y = 0, y2 = height - 1; y < y2; ++y, --y2)
+                {
+                    T* a = DestPixel<T>(destImage, 0, y);
+                    T* b = DestPixel<T>(destImage, 0, y2);
+                    if (flipH)
+                    {
+                        for (size_t x = 0; x < width; ++x)
+                        {
+                            std::swap(a[x], b[width - 1 - x]);
+                        }
+                    }
+                    else
+                    {
+                        for (size_t x = 0; x < width; ++x)
+                        {
+                            std::swap(a[x], b[x]);
+                        }
+                    }
+                }
+
+                // The middle row of an odd height image stays in place
+                if (flipH && (height & 1))
+                {
+                    ReverseRow(DestPixel<T>(destImage, 0, height / 2), width);
+                }
+            }
+            else if (flipH)
+            {
+                for (size_t y = 0; y < height; ++y)
+                {
+                    ReverseRow(DestPixel<T>(destImage, 0, y), width);
+                }
+            }
+            return;
+        }
+
+        for (size_t y = 0; y < height; ++y)
+        {
+            const T* sPtr = SrcPixel<T>(srcImage, 0, (flipV) ? (height - 1 - y) : y);
+            T* dPtr = DestPixel<T>(destImage, 0, y);
+            if (flipH)
+            {
+                for (size_t x = 0; x < width; ++x)
+                {
+                    dPtr[x] = sPtr[width - 1 - x];
+                }
+            }
+            else
+            {
+                memcpy_s(dPtr, destImage.rowPitch, sPtr, sizeof(T) * width);
+            }
+        }
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Rotates the destination rectangle [x0,x1) x [y0,y1)
+    //  clockwise:          dest(x,y) = src(y, srcHeight - 1 - x)
+    //  counter-clockwise:  dest(x,y) = src(srcWidth - 1 - y, x)
+    template<typename T>
+    void RotateRect(const Image& srcImage, bool cw, const Image& destImage, size_t x0, size_t y0, size_t x1, size_t y1)
+    {
+        for (size_t y = y0; y < y1; ++y)
+        {
+            T* dPtr = DestPixel<T>(destImage, 0, y);
+            for (size_t x = x0; x < x1; ++x)
+            {
+                dPtr[x] = (cw) ? *SrcPixel<T>(srcImage, y, srcImage.height - 1 - x)
+                               : *SrcPixel<T>(srcImage, srcImage.width - 1 - y, x);
+            }
+        }
+    }
+
+    template<typename T>
+    void RotateTile(const Image& srcImage, bool cw, const Image& destImage, size_t x0, size_t y0, size_t x1, size_t y1)
+    {
+        RotateRect<T>(srcImage, cw, destImage, x0, y0, x1, y1);
+    }
+
+    // 32-bit pixels are moved as 4x4 blocks with a register transpose
+    template<>
+    void RotateTile<uint32_t>(const Image& srcImage, bool cw, const Image& destImage, size_t x0, size_t y0, size_t x1, size_t y1)
+    {
+        const size_t qx1 = x0 + ((x1 - x0) & ~size_t(3));
+        const size_t qy1 = y0 + ((y1 - y0) & ~size_t(3));
+
+        for (size_t y = y0; y < qy1; y += 4)
+        {
+            for (size_t x = x0; x < qx1; x += 4)
+            {
+                XMMATRIX m;
+                if (cw)
+                {
+                    // Source rows run bottom to top, columns y..y+3
+                    for (size_t j = 0; j < 4; ++j)
+                    {
+                        m.r[j] = XMLoadInt4(SrcPixel<uint32_t>(srcImage, y, srcImage.height - 1 - x - j));
+                    }
+                    m = XMMatrixTranspose(m);
+                    for (size_t i = 0; i < 4; ++i)
+                    {
+                        XMStoreInt4(DestPixel<uint32_t>(destImage, x, y + i), m.r[i]);
+                    }
+                }
+                else
+                {
+                    // Source rows x..x+3, columns ending at srcWidth - 1 - y
+                    for (size_t j = 0; j < 4; ++j)
+                    {
+                        m.r[j] = XMLoadInt4(SrcPixel<uint32_t>(srcImage, srcImage.width - 4 - y, x + j));
+                    }
+                    m = XMMatrixTranspose(m);
+                    for (size_t i = 0; i < 4; ++i)
+                    {
+                        XMStoreInt4(DestPixel<uint32_t>(destImage, x, y + i), m.r[3 - i]);
+                    }
+                }
+            }
+        }
+
+        RotateRect<uint32_t>(srcImage, cw, destImage, qx1, y0, x1, qy1);
+        RotateRect<uint32_t>(srcImage, cw, destImage, x0, qy1, x1, y1);
+    }
+
+    template<typename T>
+    void RotatePixels(const Image& srcImage, bool cw, const Image& destImage)
+    {
+        if (srcImage.pixels == destImage.pixels)
+        {
+            // Square image rotated in place by cycling the four symmetric positions
+            const size_t n = srcImage.width;
+            assert(n == srcImage.height);
+
+            for (size_t y = 0; y < n / 2; ++y)
+            {
+                for (size_t x = y; x < n - 1 - y; ++x)
+                {
+                    T* p0 = DestPixel<T>(destImage, x, y);
+                    T* p1 = DestPixel<T>(destImage, n - 1 - y, x);
+                    T* p2 = DestPixel<T>(destImage, n - 1 - x, n - 1 - y);
+                    T* p3 = DestPixel<T>(destImage, y, n - 1 - x);
+
+                    T t = *p0;
+                    if (cw)
+                    {
+                        *p0 = *p3;
+                        *p3 = *p2;
+                        *p2 = *p1;
+                        *p1 = t;
+                    }
+                    else
+                    {
+                        *p0 = *p1;
+                        *p1 = *p2;
+                        *p2 = *p3;
+                        *p3 = t;
+                    }
+                }
+            }
+            return;
+        }
+
+        for (size_t y = 0; y < destImage.height; y += c_RotateTileSize)
+        {
+            const size_t y1 = std::min<size_t>(y + c_RotateTileSize, destImage.height);
+            for (size_t x = 0; x < destImage.width; x += c_RotateTileSize)
+            {
+                const size_t x1 = std::min<size_t>(x + c_RotateTileSize, destImage.width);
+                RotateTile<T>(srcImage, cw, destImage, x, y, x1, y1);
+            }
+        }
+    }
+
+    template<typename T>
+    void FlipRotatePixels(const Image& srcImage, DWORD flags, const Image& destImage)
+    {
+        switch (flags & (TEX_FR_ROTATE90 | TEX_FR_ROTATE180 | TEX_FR_ROTATE270))
+        {
+        case TEX_FR_ROTATE90:
+            RotatePixels<T>(srcImage, true, destImage);
+            break;
+
+        case TEX_FR_ROTATE270:
+            RotatePixels<T>(srcImage, false, destImage);
+            break;
+
+        default:
+            {
+                // A 180 rotation is a horizontal plus a vertical flip
+                const bool rot180 = (flags & TEX_FR_ROTATE180) != 0;
+                const bool flipH = ((flags & TEX_FR_FLIP_HORIZONTAL) != 0) != rot180;
+                const bool flipV = ((flags & TEX_FR_FLIP_VERTICAL) != 0) != rot180;
+                FlipPixels<T>(srcImage, flipH, flipV, destImage);
+            }
+            break;
+        }
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Returns true if the direct path handles this format and combination of flags.
+    // Rotations by 90/270 combined with flips are left to WIC.
+    bool IsDirectFlipRotate(DXGI_FORMAT format, DWORD flags)
+    {
+        if (IsCompressed(format) || IsPlanar(format) || IsPacked(format))
+            return false;
+
+        switch (BitsPerPixel(format))
+        {
+        case 8:
+        case 16:
+        case 32:
+        case 64:
+        case 96:
+        case 128:
+            break;
+
+        default:
+            return false;
+        }
+
+        const DWORD rotateMode = flags & (TEX_FR_ROTATE90 | TEX_FR_ROTATE180 | TEX_FR_ROTATE270);
+        if ((rotateMode == TEX_FR_ROTATE90) || (rotateMode == TEX_FR_ROTATE270))
+        {
+            return (flags & (TEX_FR_FLIP_HORIZONTAL | TEX_FR_FLIP_VERTICAL)) == 0;
+        }
+
+        return true;
+    }
+
+    HRESULT PerformFlipRotateDirect(const Image& srcImage, DWORD flags, const Image& destImage)
+    {
+        if (!srcImage.pixels || !destImage.pixels)
+            return E_POINTER;
+
+        assert(srcImage.format == destImage.format);
+        assert(IsDirectFlipRotate(srcImage.format, flags));
+
+        switch (BitsPerPixel(srcImage.format))
+        {
+        case 8:     FlipRotatePixels<uint8_t>(srcImage, flags, destImage); break;
+        case 16:    FlipRotatePixels<uint16_t>(srcImage, flags, destImage); break;
+        case 32:    FlipRotatePixels<uint32_t>(srcImage, flags, destImage); break;
+        case 64:    FlipRotatePixels<uint64_t>(srcImage, flags, destImage); break;
+        case 96:    FlipRotatePixels<XMUINT3>(srcImage, flags, destImage); break;
+        case 128:   FlipRotatePixels<XMUINT4>(srcImage, flags, destImage); break;
+        default:    return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        return S_OK;
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Picks the direct path, WIC, or a float conversion cycle through WIC
+    HRESULT PerformFlipRotate(const Image& srcImage, DWORD flags, const Image& destImage)
+    {
+        if (IsDirectFlipRotate(srcImage.format, flags))
+        {
+            // Case 1: Pixels can be moved directly
+            return PerformFlipRotateDirect(srcImage, flags, destImage);
+        }
+
+        WICPixelFormatGUID pfGUID;
+        if (_DXGIToWIC(srcImage.format, pfGUID))
+        {
+            // Case 2: Source format is supported by Windows Imaging Component
+            return PerformFlipRotateUsingWIC(srcImage, flags, pfGUID, destImage);
+        }
+
+        // Case 3: Source format is not supported by WIC, so we have to convert, flip/rotate, and convert back
+        uint64_t expandedSize = uint64_t(srcImage.width) * uint64_t(srcImage.height) * sizeof(float) * 4;
+        if (expandedSize > UINT32_MAX)
+        {
+            // Image is too large for float32, so have to use float16 instead
+            return PerformFlipRotateViaF16(srcImage, flags, destImage);
+        }
+
+        return PerformFlipRotateViaF32(srcImage, flags, destImage);
+    }
 }
 
 
@@ -244,34 +563,93 @@ HRESULT DirectX::FlipRotate(
         return E_POINTER;
     }
 
-    WICPixelFormatGUID pfGUID;
-    if (_DXGIToWIC(srcImage.format, pfGUID))
+    hr = PerformFlipRotate(srcImage, flags, *rimage);
+    if (FAILED(hr))
     {
-        // Case 1: Source format is supported by Windows Imaging Component
-        hr = PerformFlipRotateUsingWIC(srcImage, flags, pfGUID, *rimage);
+        image.Release();
+        return hr;
     }
-    else
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Flip/rotate image into an existing image, which may be the source for flips,
+// 180 rotations, and 90/270 rotations of a square image
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::FlipRotate(
+    const Image& srcImage,
+    DWORD flags,
+    const Image& destImage)
+{
+    if (!srcImage.pixels || !destImage.pixels)
+        return E_POINTER;
+
+    if (!flags || !srcImage.width || !srcImage.height)
+        return E_INVALIDARG;
+
+    if ((srcImage.width > UINT32_MAX) || (srcImage.height > UINT32_MAX))
+        return E_INVALIDARG;
+
+    if (IsCompressed(srcImage.format))
     {
-        // Case 2: Source format is not supported by WIC, so we have to convert, flip/rotate, and convert back
-        uint64_t expandedSize = uint64_t(srcImage.width) * uint64_t(srcImage.height) * sizeof(float) * 4;
-        if (expandedSize > UINT32_MAX)
-        {
-            // Image is too large for float32, so have to use float16 instead
-            hr = PerformFlipRotateViaF16(srcImage, flags, *rimage);
-        }
-        else
-        {
-            hr = PerformFlipRotateViaF32(srcImage, flags, *rimage);
-        }
+        // We don't support flip/rotate operations on compressed images
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
     }
 
-    if (FAILED(hr))
+    if (srcImage.format != destImage.format)
+        return E_INVALIDARG;
+
+    // Only supports 90, 180, 270, or no rotation flags... not a combination of rotation flags
+    int rotateMode = static_cast<int>(flags & (TEX_FR_ROTATE0 | TEX_FR_ROTATE90 | TEX_FR_ROTATE180 | TEX_FR_ROTATE270));
+
+    switch (rotateMode)
     {
-        image.Release();
-        return hr;
+    case 0:
+    case TEX_FR_ROTATE90:
+    case TEX_FR_ROTATE180:
+    case TEX_FR_ROTATE270:
+        break;
+
+    default:
+        return E_INVALIDARG;
     }
 
-    return S_OK;
+    if ((rotateMode == TEX_FR_ROTATE90) || (rotateMode == TEX_FR_ROTATE270))
+    {
+        if (srcImage.width != destImage.height || srcImage.height != destImage.width)
+            return E_INVALIDARG;
+    }
+    else if (srcImage.width != destImage.width || srcImage.height != destImage.height)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (srcImage.pixels == destImage.pixels)
+    {
+        if (srcImage.rowPitch != destImage.rowPitch)
+            return E_INVALIDARG;
+
+        // A non-square 90/270 rotation changes the buffer's shape, so it can't be done in place
+        if (((rotateMode == TEX_FR_ROTATE90) || (rotateMode == TEX_FR_ROTATE270))
+            && srcImage.width != srcImage.height)
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+        // WIC and the float conversion cycle both need a separate destination
+        if (!IsDirectFlipRotate(srcImage.format, flags))
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+        return PerformFlipRotateDirect(srcImage, flags, destImage);
+    }
+
+    const uint8_t* srcEnd = srcImage.pixels + srcImage.rowPitch * srcImage.height;
+    const uint8_t* destEnd = destImage.pixels + destImage.rowPitch * destImage.height;
+    if (srcImage.pixels < destEnd && destImage.pixels < srcEnd)
+        return E_INVALIDARG;
+
+    return PerformFlipRotate(srcImage, flags, destImage);
 }
 
 
@@ -344,9 +722,6 @@ HRESULT DirectX::FlipRotate(
         return E_POINTER;
     }
 
-    WICPixelFormatGUID pfGUID;
-    bool wicpf = _DXGIToWIC(metadata.format, pfGUID);
-
     for (size_t index = 0; index < nimages; ++index)
     {
         const Image& src = srcImages[index];
@@ -379,26 +754,7 @@ HRESULT DirectX::FlipRotate(
             }
         }
 
-        if (wicpf)
-        {
-            // Case 1: Source format is supported by Windows Imaging Component
-            hr = PerformFlipRotateUsingWIC(src, flags, pfGUID, dst);
-        }
-        else
-        {
-            // Case 2: Source format is not supported by WIC, so we have to convert, flip/rotate, and convert back
-            uint64_t expandedSize = uint64_t(src.width) * uint64_t(src.height) * sizeof(float) * 4;
-            if (expandedSize > UINT32_MAX)
-            {
-                // Image is too large for float32, so have to use float16 instead
-                hr = PerformFlipRotateViaF16(src, flags, dst);
-            }
-            else
-            {
-                hr = PerformFlipRotateViaF32(src, flags, dst);
-            }
-        }
-
+        hr = PerformFlipRotate(src, flags, dst);
         if (FAILED(hr))
         {
             result.Release();
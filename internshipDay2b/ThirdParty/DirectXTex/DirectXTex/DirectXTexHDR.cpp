@@ -11,6 +11,11 @@
 
 #include "DirectXTexp.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#pragma warning(disable : 4616 6993)
+#endif
+
 //
 // In theory HDR (RGBE) Radiance files can have any of the following data orientations
 //
@@ -34,6 +39,7 @@
 //#define WRITE_OLD_COLORS
 
 using namespace DirectX;
+using namespace DirectX::PackedVector;
 
 namespace
 {
@@ -296,28 +302,25 @@ namespace
         for (size_t j = 0; j < width; ++j)
         {
             if (pSource + 2 >= ePtr) break;
-            float r = pSource[0] >= 0.f ? pSource[0] : 0.f;
-            float g = pSource[1] >= 0.f ? pSource[1] : 0.f;
-            float b = pSource[2] >= 0.f ? pSource[2] : 0.f;
+            XMVECTOR v = XMVectorMax(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(pSource)), g_XMZero);
             pSource += fpp;
 
-            const float max_xy = (r > g) ? r : g;
-            float max_xyz = (max_xy > b) ? max_xy : b;
+            XMVECTOR vmax = XMVectorMax(XMVectorMax(XMVectorSplatX(v), XMVectorSplatY(v)), XMVectorSplatZ(v));
 
-            if (max_xyz > 1e-32)
+            if (XMVectorGetX(vmax) > 1e-32f)
             {
-                int e;
-                max_xyz = frexpf(max_xyz, &e) * 256.f / max_xyz;
-                e += 128;
-
-                uint8_t red = uint8_t(r * max_xyz);
-                uint8_t green = uint8_t(g * max_xyz);
-                uint8_t blue = uint8_t(b * max_xyz);
-
-                pDestination[0] = red;
-                pDestination[1] = green;
-                pDestination[2] = blue;
-                pDestination[3] = (red || green || blue) ? uint8_t(e & 0xff) : 0;
+                // Equivalent to frexpf: the stored exponent is (biased exponent + 2) and the scale
+                // applied to the mantissa is 256 / 2^(biased exponent - 126)
+                uint32_t biased = (XMVectorGetIntX(vmax) >> 23) & 0xff;
+                XMVECTOR scale = XMVectorReplicateInt((261u - biased) << 23);
+
+                XMUBYTE4 rgbe;
+                XMStoreUByte4(&rgbe, XMVectorTruncate(XMVectorMultiply(v, scale)));
+
+                pDestination[0] = rgbe.x;
+                pDestination[1] = rgbe.y;
+                pDestination[2] = rgbe.z;
+                pDestination[3] = (rgbe.x || rgbe.y || rgbe.z) ? uint8_t((biased + 2) & 0xff) : 0;
             }
             else
             {
@@ -328,6 +331,171 @@ namespace
         }
     }
 
+    //-------------------------------------------------------------------------------------
+    // RGBEToFloat (converts a scanline in place; the RGBE data is stored in the last quarter of the row)
+    //-------------------------------------------------------------------------------------
+    inline void RGBEToFloat(_Inout_updates_bytes_(width*16) uint8_t* pScanline, size_t width, _In_reads_(256) const float* scales)
+    {
+        auto pDestination = reinterpret_cast<XMFLOAT4*>(pScanline);
+        const uint8_t* pSource = pScanline + width * 12;
+
+        static const XMVECTORF32 s_Half = { { { 0.5f, 0.5f, 0.5f, 0.f } } };
+
+        for (size_t j = 0; j < width; ++j)
+        {
+            // Pixel j's source bytes are always read before its (overlapping) float data is written
+            XMVECTOR v = XMVectorAdd(XMLoadUByte4(reinterpret_cast<const XMUBYTE4*>(pSource)), s_Half);
+            XMVECTOR scale = XMVectorReplicate(scales[pSource[3]]);
+            pSource += 4;
+
+            v = XMVectorSelect(g_XMIdentityR3, XMVectorMultiply(v, scale), g_XMSelect1110);
+            XMStoreFloat4(pDestination++, v);
+        }
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Decodes one RLE scanline into RGBE bytes; with a null destination it only validates
+    // the data and determines the size of the encoded scanline
+    //-------------------------------------------------------------------------------------
+    HRESULT DecodeScanline(
+        _In_reads_bytes_(size) const uint8_t* pSource,
+        size_t size,
+        _Out_writes_bytes_opt_(width * 4) uint8_t* pDestination,
+        size_t width,
+        _Out_ size_t& consumed)
+    {
+        consumed = 0;
+
+        const uint8_t* sourcePtr = pSource;
+        size_t pixelLen = size;
+
+        if (pixelLen < 4)
+            return E_FAIL;
+
+        uint8_t inColor[4];
+        memcpy(inColor, sourcePtr, 4);
+        sourcePtr += 4;
+        pixelLen -= 4;
+
+        if (inColor[0] == 2 && inColor[1] == 2 && inColor[2] < 128)
+        {
+            // Adaptive Run Length Encoding (RLE)
+            if (size_t((size_t(inColor[2]) << 8) + inColor[3]) != width)
+                return E_FAIL;
+
+            for (int channel = 0; channel < 4; ++channel)
+            {
+                uint8_t* pixelLoc = pDestination ? (pDestination + channel) : nullptr;
+                for (size_t pixelCount = 0; pixelCount < width;)
+                {
+                    if (pixelLen < 2)
+                        return E_FAIL;
+
+                    uint8_t runLen = *sourcePtr;
+                    if (runLen > 128)
+                    {
+                        runLen &= 127;
+                        if (pixelCount + runLen > width)
+                            return E_FAIL;
+
+                        if (pixelLoc)
+                        {
+                            const uint8_t val = sourcePtr[1];
+                            for (uint8_t j = 0; j < runLen; ++j)
+                            {
+                                *pixelLoc = val;
+                                pixelLoc += 4;
+                            }
+                        }
+                        pixelCount += runLen;
+                        sourcePtr += 2;
+                        pixelLen -= 2;
+                    }
+                    else if ((pixelLen < size_t(runLen) + 1) || ((pixelCount + size_t(runLen)) > width))
+                    {
+                        return E_FAIL;
+                    }
+                    else
+                    {
+                        ++sourcePtr;
+                        if (pixelLoc)
+                        {
+                            for (uint8_t j = 0; j < runLen; ++j)
+                            {
+                                *pixelLoc = *sourcePtr++;
+                                pixelLoc += 4;
+                            }
+                        }
+                        else
+                        {
+                            sourcePtr += runLen;
+                        }
+                        pixelCount += runLen;
+                        pixelLen -= size_t(runLen) + 1;
+                    }
+                }
+            }
+        }
+        else
+        {
+            uint8_t* pixelLoc = pDestination;
+
+            uint8_t prevColor[4];
+            memcpy(prevColor, inColor, 4);
+
+            int bitShift = 0;
+            for (size_t pixelCount = 0; pixelCount < width;)
+            {
+                if (inColor[0] == 1 && inColor[1] == 1 && inColor[2] == 1)
+                {
+                    if (bitShift > 24)
+                        return E_FAIL;
+
+                    // "Standard" Run Length Encoding
+                    size_t spanLen = size_t(inColor[3]) << bitShift;
+                    if (spanLen + pixelCount > width)
+                        return E_FAIL;
+
+                    if (pixelLoc)
+                    {
+                        for (size_t j = 0; j < spanLen; ++j)
+                        {
+                            memcpy(pixelLoc, prevColor, 4);
+                            pixelLoc += 4;
+                        }
+                    }
+                    pixelCount += spanLen;
+                    bitShift += 8;
+                }
+                else
+                {
+                    // Uncompressed
+                    memcpy(prevColor, inColor, 4);
+                    if (pixelLoc)
+                    {
+                        memcpy(pixelLoc, inColor, 4);
+                        pixelLoc += 4;
+                    }
+                    bitShift = 0;
+                    ++pixelCount;
+                }
+
+                if (pixelCount >= width)
+                    break;
+
+                if (pixelLen < 4)
+                    return E_FAIL;
+
+                memcpy(inColor, sourcePtr, 4);
+                sourcePtr += 4;
+                pixelLen -= 4;
+            }
+        }
+
+        consumed = size - pixelLen;
+        return S_OK;
+    }
+
     //-------------------------------------------------------------------------------------
     // Encode using Adapative RLE
     //-------------------------------------------------------------------------------------
@@ -611,11 +779,6 @@ HRESULT DirectX::LoadFromHDRMemory(const void* pSource, size_t size, TexMetadata
     if (FAILED(hr))
         return hr;
 
-    // Copy pixels
-    auto sourcePtr = static_cast<const uint8_t*>(pSource) + offset;
-
-    size_t pixelLen = remaining;
-
     const Image* img = image.GetImage(0, 0, 0);
     if (!img)
     {
@@ -623,173 +786,69 @@ HRESULT DirectX::LoadFromHDRMemory(const void* pSource, size_t size, TexMetadata
         return E_POINTER;
     }
 
-    auto destPtr = img->pixels;
+    // First pass finds where each scanline starts, so they can then be decoded independently
+    std::unique_ptr<size_t[]> scanOffsets(new (std::nothrow) size_t[mdata.height]);
+    if (!scanOffsets)
+    {
+        image.Release();
+        return E_OUTOFMEMORY;
+    }
 
-#ifdef _DEBUG
-    memset(img->pixels, 0xFF, img->rowPitch * img->height);
-#endif
+    auto sourcePtr = static_cast<const uint8_t*>(pSource) + offset;
 
-    for (size_t scan = 0; scan < mdata.height; ++scan)
     {
-        if (pixelLen < 4)
+        size_t pos = 0;
+        for (size_t scan = 0; scan < mdata.height; ++scan)
         {
-            image.Release();
-            return E_FAIL;
-        }
+            scanOffsets[scan] = pos;
 
-        uint8_t inColor[4];
-        memcpy(inColor, sourcePtr, 4);
-        sourcePtr += 4;
-        pixelLen -= 4;
-
-        auto scanLine = reinterpret_cast<float*>(destPtr);
-        
-        if (inColor[0] == 2 && inColor[1] == 2 && inColor[2] < 128)
-        {
-            // Adaptive Run Length Encoding (RLE)
-            if (size_t((size_t(inColor[2]) << 8) + inColor[3]) != mdata.width)
+            size_t consumed;
+            hr = DecodeScanline(sourcePtr + pos, remaining - pos, nullptr, mdata.width, consumed);
+            if (FAILED(hr))
             {
                 image.Release();
-                return E_FAIL;
+                return hr;
             }
 
-            for (int channel = 0; channel < 4; ++channel)
-            {
-                auto pixelLoc = scanLine + channel;
-                for(size_t pixelCount = 0; pixelCount < mdata.width;)
-                {
-                    if (pixelLen < 2)
-                    {
-                        image.Release();
-                        return E_FAIL;
-                    }
-
-                    assert(sourcePtr < (reinterpret_cast<const uint8_t*>(pSource) + size));
-
-                    uint8_t runLen = *sourcePtr;
-                    if (runLen > 128)
-                    {
-                        runLen &= 127;
-                        if (pixelCount + runLen > mdata.width)
-                        {
-                            image.Release();
-                            return E_FAIL;
-                        }
-
-                        auto val = static_cast<float>(sourcePtr[1]);
-                        for (uint8_t j = 0; j < runLen; ++j)
-                        {
-                            *pixelLoc = val;
-                            pixelLoc += 4;
-                        }
-                        pixelCount += runLen;
-                        sourcePtr += 2;
-                        pixelLen -= 2;
-                    }
-                    else if ((size < size_t(runLen) + 1) || ((pixelCount + size_t(runLen)) > mdata.width))
-                    {
-                        image.Release();
-                        return E_FAIL;
-                    }
-                    else
-                    {
-                        ++sourcePtr;
-                        for (uint8_t j = 0; j < runLen; ++j)
-                        {
-                            auto val = static_cast<float>(*sourcePtr++);
-                            *pixelLoc = val;
-                            pixelLoc += 4;
-                        }
-                        pixelCount += runLen;
-                        pixelLen -= size_t(runLen) + 1;
-                    }
-                }
-            }
+            pos += consumed;
         }
-        else
-        {
-            auto pixelLoc = scanLine;
-
-            float prevColor[4];
-            prevColor[0] = inColor[0];
-            prevColor[1] = inColor[1];
-            prevColor[2] = inColor[2];
-            prevColor[3] = inColor[3];
-
-            int bitShift = 0;
-            for (size_t pixelCount = 0; pixelCount < mdata.width;)
-            {
-                if (inColor[0] == 1 && inColor[1] == 1 && inColor[2] == 1)
-                {
-                    if (bitShift > 24)
-                    {
-                        image.Release();
-                        return E_FAIL;
-                    }
-
-                    // "Standard" Run Length Encoding
-                    size_t spanLen = size_t(inColor[3]) << bitShift;
-                    if (spanLen + pixelCount > mdata.width)
-                    {
-                        image.Release();
-                        return E_FAIL;
-                    }
+    }
 
-                    for (size_t j = 0; j < spanLen; ++j)
-                    {
-                        pixelLoc[0] = prevColor[0];
-                        pixelLoc[1] = prevColor[1];
-                        pixelLoc[2] = prevColor[2];
-                        pixelLoc[3] = prevColor[3];
-                        pixelLoc += 4;
-                    }
-                    pixelCount += spanLen;
-                    bitShift += 8;
-                }
-                else
-                {
-                    // Uncompressed
-                    pixelLoc[0] = prevColor[0] = inColor[0];
-                    pixelLoc[1] = prevColor[1] = inColor[1];
-                    pixelLoc[2] = prevColor[2] = inColor[2];
-                    pixelLoc[3] = prevColor[3] = inColor[3];
-                    bitShift = 0;
-                    ++pixelCount;
-                    pixelLoc += 4;
-                }
+    // Scale factors for each exponent value
+    float scales[256];
+    for (int e = 0; e < 256; ++e)
+    {
+        scales[e] = 1.0f / exposure*ldexpf(1.f, e - (128 + 8));
+    }
 
-                if (pixelCount >= mdata.width)
-                    break;
+    // Second pass decodes the RLE data into the end of each row and expands it to float in place
+    const size_t width = mdata.width;
+    const size_t rowPitch = img->rowPitch;
+    uint8_t* pixels = img->pixels;
+    bool fail = false;
 
-                if (pixelLen < 4)
-                {
-                    image.Release();
-                    return E_FAIL;
-                }
+#ifdef _OPENMP
+#pragma omp parallel for if (mdata.height >= 64)
+#endif
+    for (int scan = 0; scan < static_cast<int>(mdata.height); ++scan)
+    {
+        uint8_t* destPtr = pixels + rowPitch * size_t(scan);
+        size_t start = scanOffsets[size_t(scan)];
 
-                memcpy(inColor, sourcePtr, 4);
-                sourcePtr += 4;
-                pixelLen -= 4;
-            }
+        size_t consumed;
+        if (FAILED(DecodeScanline(sourcePtr + start, remaining - start, destPtr + width * 12, width, consumed)))
+        {
+            fail = true;
+            continue;
         }
 
-        destPtr += img->rowPitch;
+        RGBEToFloat(destPtr, width, scales);
     }
 
-    // Transform values
+    if (fail)
     {
-        auto fdata = reinterpret_cast<float*>(image.GetPixels());
-
-        for (size_t j = 0; j < image.GetPixelsSize(); j += 16)
-        {
-            auto exponent = static_cast<int>(fdata[3]);
-            fdata[0] = 1.0f / exposure*ldexpf((fdata[0] + 0.5f), exponent - (128 + 8));
-            fdata[1] = 1.0f / exposure*ldexpf((fdata[1] + 0.5f), exponent - (128 + 8));
-            fdata[2] = 1.0f / exposure*ldexpf((fdata[2] + 0.5f), exponent - (128 + 8));
-            fdata[3] = 1.f;
-
-            fdata += 4;
-        }
+        image.Release();
+        return E_FAIL;
     }
 
     if (metadata)
@@ -821,3 +821,72 @@ bool ScratchImage::IsAlphaAllOpaque() const
 
     return true;
 }
+
+
+//=====================================================================================
+// MappedImage - Bitmap image container backed by a file mapping
+//=====================================================================================
+
+MappedImage& MappedImage::operator= (MappedImage&& moveFrom) noexcept
+{
+    if (this != &moveFrom)
+    {
+        Release();
+
+        m_nimages = moveFrom.m_nimages;
+        m_metadata = moveFrom.m_metadata;
+        m_image = moveFrom.m_image;
+        m_view = moveFrom.m_view;
+        m_viewSize = moveFrom.m_viewSize;
+        m_hMapping = moveFrom.m_hMapping;
+        m_scratch = std::move(moveFrom.m_scratch);
+
+        moveFrom.m_nimages = 0;
+        moveFrom.m_image = nullptr;
+        moveFrom.m_view = nullptr;
+        moveFrom.m_viewSize = 0;
+        moveFrom.m_hMapping = nullptr;
+    }
+    return *this;
+}
+
+void MappedImage::Release()
+{
+    m_nimages = 0;
+
+    if (m_image)
+    {
+        delete[] m_image;
+        m_image = nullptr;
+    }
+
+    if (m_view)
+    {
+        (void)UnmapViewOfFile(m_view);
+        m_view = nullptr;
+    }
+    m_viewSize = 0;
+
+    if (m_hMapping)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+
+    m_scratch.Release();
+
+    memset(&m_metadata, 0, sizeof(m_metadata));
+}
+
+_Use_decl_annotations_
+const Image* MappedImage::GetImage(size_t mip, size_t item, size_t slice) const
+{
+    if (!m_view)
+        return m_scratch.GetImage(mip, item, slice);
+
+    size_t index = m_metadata.ComputeIndex(mip, item, slice);
+    if (index >= m_nimages)
+        return nullptr;
+
+    return &m_image[index];
+}
@@ -0,0 +1,645 @@
+//-------------------------------------------------------------------------------------
+// DirectXTexMetrics.cpp
+//
+// DirectX Texture Library - Image comparison metrics
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248926
+//-------------------------------------------------------------------------------------
+
+#include "DirectXTexp.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#pragma warning(disable : 4616 6993)
+#endif
+
+#include <stdio.h>
+#include <string>
+
+using namespace DirectX;
+
+namespace
+{
+    const size_t SSIM_WINDOW = 8;
+
+    const XMVECTORF32 g_Gamma22 = { { { 2.2f, 2.2f, 2.2f, 1.f } } };
+    const XMVECTORF32 g_Two = { { { 2.0f, 2.0f, 2.0f, 2.0f } } };
+
+    // SSIM stabilization constants (0.01 * L)^2 and (0.03 * L)^2 for a dynamic range L of 1
+    const XMVECTORF32 g_SSIM_C1 = { { { 0.0001f, 0.0001f, 0.0001f, 0.0001f } } };
+    const XMVECTORF32 g_SSIM_C2 = { { { 0.0009f, 0.0009f, 0.0009f, 0.0009f } } };
+
+    // Partial results for one band of SSIM_WINDOW scanlines
+    struct BandResult
+    {
+        XMFLOAT4A   sumSq;
+        XMFLOAT4A   maxError;
+        XMFLOAT4A   ssim;
+        size_t      windows;
+        uint32_t    histogram[ImageMetrics::HISTOGRAM_BINS];
+    };
+
+    //-------------------------------------------------------------------------------------
+    // Comparison flags implied by an image format (see ComputeMSE)
+    //-------------------------------------------------------------------------------------
+    DWORD GetImpliedFlags(DXGI_FORMAT format, DWORD srgbFlag)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_B8G8R8X8_UNORM:
+            return CMSE_IGNORE_ALPHA;
+
+        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+            return srgbFlag | CMSE_IGNORE_ALPHA;
+
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            return srgbFlag;
+
+        default:
+            return 0;
+        }
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // Loads a scanline and applies gamma, scale & bias, and channel masking
+    //-------------------------------------------------------------------------------------
+    bool LoadMetricScanline(
+        _Out_writes_(width) XMVECTOR* pDestination,
+        size_t width,
+        _In_reads_bytes_(rowPitch) const uint8_t* pSource,
+        size_t rowPitch,
+        DXGI_FORMAT format,
+        bool srgb,
+        bool bias,
+        FXMVECTOR ignoreMask)
+    {
+        if (!_LoadScanline(pDestination, width, pSource, rowPitch, format))
+            return false;
+
+        for (size_t i = 0; i < width; ++i)
+        {
+            XMVECTOR v = pDestination[i];
+            if (srgb)
+            {
+                v = XMVectorPow(v, g_Gamma22);
+            }
+            if (bias)
+            {
+                v = XMVectorMultiplyAdd(v, g_Two, g_XMNegativeOne);
+            }
+            pDestination[i] = XMVectorSelect(v, g_XMZero, ignoreMask);
+        }
+
+        return true;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // Computes error sums, maximum error, histogram, and SSIM windows for one band
+    //-------------------------------------------------------------------------------------
+    bool ComputeBand(
+        const Image& image1,
+        const Image& image2,
+        size_t y,
+        DWORD flags,
+        FXMVECTOR ignoreMask,
+        _Inout_updates_(image1.width * SSIM_WINDOW * 2) XMVECTOR* scanlines,
+        BandResult& result)
+    {
+        const size_t width = image1.width;
+        const size_t rows = std::min<size_t>(SSIM_WINDOW, image1.height - y);
+
+        XMVECTOR* rows1 = scanlines;
+        XMVECTOR* rows2 = scanlines + width * SSIM_WINDOW;
+
+        for (size_t r = 0; r < rows; ++r)
+        {
+            if (!LoadMetricScanline(rows1 + r * width, width, image1.pixels + (y + r) * image1.rowPitch, image1.rowPitch,
+                image1.format, (flags & CMSE_IMAGE1_SRGB) != 0, (flags & CMSE_IMAGE1_X2_BIAS) != 0, ignoreMask))
+                return false;
+
+            if (!LoadMetricScanline(rows2 + r * width, width, image2.pixels + (y + r) * image2.rowPitch, image2.rowPitch,
+                image2.format, (flags & CMSE_IMAGE2_SRGB) != 0, (flags & CMSE_IMAGE2_X2_BIAS) != 0, ignoreMask))
+                return false;
+        }
+
+        memset(result.histogram, 0, sizeof(result.histogram));
+
+        // Per-pixel error
+        XMVECTOR sumSq = g_XMZero;
+        XMVECTOR maxError = g_XMZero;
+        for (size_t i = 0; i < rows * width; ++i)
+        {
+            XMVECTOR d = XMVectorSubtract(rows1[i], rows2[i]);
+            sumSq = XMVectorMultiplyAdd(d, d, sumSq);
+
+            d = XMVectorAbs(d);
+            maxError = XMVectorMax(maxError, d);
+
+            XMVECTOR e = XMVectorMax(d, XMVectorSwizzle<1, 0, 3, 2>(d));
+            e = XMVectorMax(e, XMVectorSwizzle<2, 3, 0, 1>(e));
+            float f = XMVectorGetX(e) * float(ImageMetrics::HISTOGRAM_BINS);
+
+            // Errors above 1 (HDR/SNORM data) and NaNs land in the last bin
+            size_t bin = (f < float(ImageMetrics::HISTOGRAM_BINS)) ? static_cast<size_t>(f) : (ImageMetrics::HISTOGRAM_BINS - 1);
+            ++result.histogram[bin];
+        }
+
+        // SSIM over non-overlapping windows (partial windows at the right and bottom edges)
+        XMVECTOR ssim = g_XMZero;
+        size_t windows = 0;
+        for (size_t x = 0; x < width; x += SSIM_WINDOW)
+        {
+            const size_t cols = std::min<size_t>(SSIM_WINDOW, width - x);
+
+            XMVECTOR s1 = g_XMZero;
+            XMVECTOR s2 = g_XMZero;
+            XMVECTOR s11 = g_XMZero;
+            XMVECTOR s22 = g_XMZero;
+            XMVECTOR s12 = g_XMZero;
+            for (size_t r = 0; r < rows; ++r)
+            {
+                const XMVECTOR* p1 = rows1 + r * width + x;
+                const XMVECTOR* p2 = rows2 + r * width + x;
+                for (size_t c = 0; c < cols; ++c)
+                {
+                    s1 = XMVectorAdd(s1, p1[c]);
+                    s2 = XMVectorAdd(s2, p2[c]);
+                    s11 = XMVectorMultiplyAdd(p1[c], p1[c], s11);
+                    s22 = XMVectorMultiplyAdd(p2[c], p2[c], s22);
+                    s12 = XMVectorMultiplyAdd(p1[c], p2[c], s12);
+                }
+            }
+
+            const float invN = 1.f / float(rows * cols);
+            XMVECTOR mu1 = XMVectorScale(s1, invN);
+            XMVECTOR mu2 = XMVectorScale(s2, invN);
+            XMVECTOR mu11 = XMVectorMultiply(mu1, mu1);
+            XMVECTOR mu22 = XMVectorMultiply(mu2, mu2);
+            XMVECTOR mu12 = XMVectorMultiply(mu1, mu2);
+            XMVECTOR var1 = XMVectorSubtract(XMVectorScale(s11, invN), mu11);
+            XMVECTOR var2 = XMVectorSubtract(XMVectorScale(s22, invN), mu22);
+            XMVECTOR cov = XMVectorSubtract(XMVectorScale(s12, invN), mu12);
+
+            // ((2 mu1 mu2 + C1)(2 cov + C2)) / ((mu1^2 + mu2^2 + C1)(var1 + var2 + C2))
+            XMVECTOR num = XMVectorMultiply(XMVectorMultiplyAdd(g_Two, mu12, g_SSIM_C1), XMVectorMultiplyAdd(g_Two, cov, g_SSIM_C2));
+            XMVECTOR den = XMVectorMultiply(XMVectorAdd(XMVectorAdd(mu11, mu22), g_SSIM_C1), XMVectorAdd(XMVectorAdd(var1, var2), g_SSIM_C2));
+            ssim = XMVectorAdd(ssim, XMVectorDivide(num, den));
+            ++windows;
+        }
+
+        XMStoreFloat4A(&result.sumSq, sumSq);
+        XMStoreFloat4A(&result.maxError, maxError);
+        XMStoreFloat4A(&result.ssim, ssim);
+        result.windows = windows;
+
+        return true;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    HRESULT ComputeMetrics_(
+        const Image& image1,
+        const Image& image2,
+        DWORD flags,
+        ImageMetrics& metrics)
+    {
+        if (!image1.pixels || !image2.pixels)
+            return E_POINTER;
+
+        assert(image1.width == image2.width && image1.height == image2.height);
+        assert(!IsCompressed(image1.format) && !IsCompressed(image2.format));
+
+        // Flags implied from image formats
+        flags |= GetImpliedFlags(image1.format, CMSE_IMAGE1_SRGB) | GetImpliedFlags(image2.format, CMSE_IMAGE2_SRGB);
+
+        const bool ignore[4] =
+        {
+            (flags & CMSE_IGNORE_RED) != 0,
+            (flags & CMSE_IGNORE_GREEN) != 0,
+            (flags & CMSE_IGNORE_BLUE) != 0,
+            (flags & CMSE_IGNORE_ALPHA) != 0,
+        };
+        const XMVECTOR ignoreMask = XMVectorSelectControl(ignore[0], ignore[1], ignore[2], ignore[3]);
+
+        const size_t width = image1.width;
+        const size_t nbands = (image1.height + SSIM_WINDOW - 1) / SSIM_WINDOW;
+
+        std::unique_ptr<BandResult[]> bands(new (std::nothrow) BandResult[nbands]);
+        if (!bands)
+            return E_OUTOFMEMORY;
+
+        bool fail = false;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (nbands >= 8)
+#endif
+        for (int band = 0; band < static_cast<int>(nbands); ++band)
+        {
+            ScopedAlignedArrayXMVECTOR scanlines(static_cast<XMVECTOR*>(_aligned_malloc(sizeof(XMVECTOR) * width * SSIM_WINDOW * 2, 16)));
+            if (!scanlines)
+            {
+                fail = true;
+                continue;
+            }
+
+            if (!ComputeBand(image1, image2, size_t(band) * SSIM_WINDOW, flags, ignoreMask, scanlines.get(), bands[band]))
+                fail = true;
+        }
+
+        if (fail)
+            return E_FAIL;
+
+        // Reduce bands in double precision
+        double sumSq[4] = {};
+        double ssim[4] = {};
+        float maxError[4] = {};
+        size_t windows = 0;
+        memset(metrics.histogram, 0, sizeof(metrics.histogram));
+
+        for (size_t band = 0; band < nbands; ++band)
+        {
+            const BandResult& b = bands[band];
+            const float* bSumSq = &b.sumSq.x;
+            const float* bMaxError = &b.maxError.x;
+            const float* bSSIM = &b.ssim.x;
+            for (size_t c = 0; c < 4; ++c)
+            {
+                sumSq[c] += bSumSq[c];
+                ssim[c] += bSSIM[c];
+                maxError[c] = std::max(maxError[c], bMaxError[c]);
+            }
+            windows += b.windows;
+
+            for (size_t bin = 0; bin < ImageMetrics::HISTOGRAM_BINS; ++bin)
+                metrics.histogram[bin] += b.histogram[bin];
+        }
+
+        // Signals compared after scale & bias span [-1,1]
+        const double peak = (flags & (CMSE_IMAGE1_X2_BIAS | CMSE_IMAGE2_X2_BIAS)) ? 2.0 : 1.0;
+        const double pixels = double(image1.width) * double(image1.height);
+
+        metrics.width = image1.width;
+        metrics.height = image1.height;
+        metrics.mse = 0.f;
+        metrics.ssim = 0.f;
+        metrics.maxError = 0.f;
+
+        size_t channels = 0;
+        for (size_t c = 0; c < 4; ++c)
+        {
+            const double mse = sumSq[c] / pixels;
+            metrics.mseV[c] = float(mse);
+            metrics.psnrV[c] = (mse > 0.0) ? float(10.0 * log10(peak * peak / mse)) : INFINITY;
+            metrics.ssimV[c] = float(ssim[c] / double(windows));
+            metrics.maxErrorV[c] = maxError[c];
+
+            metrics.mse += metrics.mseV[c];
+
+            if (!ignore[c])
+            {
+                ++channels;
+                metrics.ssim += metrics.ssimV[c];
+                metrics.maxError = std::max(metrics.maxError, maxError[c]);
+            }
+        }
+
+        if (channels > 0)
+        {
+            const double mse = double(metrics.mse) / double(channels);
+            metrics.psnr = (mse > 0.0) ? float(10.0 * log10(peak * peak / mse)) : INFINITY;
+            metrics.ssim /= float(channels);
+        }
+        else
+        {
+            metrics.psnr = INFINITY;
+            metrics.ssim = 1.f;
+        }
+
+        return S_OK;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // Report formatting
+    //-------------------------------------------------------------------------------------
+    void AppendFormat(std::string& report, _In_z_ _Printf_format_string_ const char* format, ...)
+    {
+        char buff[128];
+
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf_s(buff, _countof(buff), _TRUNCATE, format, args);
+        va_end(args);
+
+        if (len > 0)
+            report.append(buff, static_cast<size_t>(len));
+    }
+
+    void AppendFloat(std::string& report, float value, bool json)
+    {
+        if (isfinite(value))
+        {
+            AppendFormat(report, "%.9g", value);
+        }
+        else if (json)
+        {
+            // JSON has no representation for infinity
+            report.append("null");
+        }
+        else
+        {
+            report.append((value < 0.f) ? "-inf" : "inf");
+        }
+    }
+
+    void AppendJSONArray(std::string& report, const char* name, const float* values, size_t count)
+    {
+        AppendFormat(report, ", \"%s\": [", name);
+        for (size_t j = 0; j < count; ++j)
+        {
+            if (j > 0)
+                report.append(", ");
+            AppendFloat(report, values[j], true);
+        }
+        report.append("]");
+    }
+}
+
+
+//=====================================================================================
+// Entry points
+//=====================================================================================
+
+//-------------------------------------------------------------------------------------
+// Computes image comparison metrics between two images
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::ComputeMetrics(
+    const Image& image1,
+    const Image& image2,
+    DWORD flags,
+    ImageMetrics& metrics)
+{
+    memset(&metrics, 0, sizeof(ImageMetrics));
+
+    if (!image1.pixels || !image2.pixels)
+        return E_POINTER;
+
+    if (image1.width != image2.width || image1.height != image2.height)
+        return E_INVALIDARG;
+
+    if (!IsValid(image1.format) || !IsValid(image2.format))
+        return E_INVALIDARG;
+
+    if (IsPlanar(image1.format) || IsPlanar(image2.format)
+        || IsPalettized(image1.format) || IsPalettized(image2.format)
+        || IsTypeless(image1.format) || IsTypeless(image2.format))
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    // Expand compressed images to RGBA32F
+    ScratchImage temp1;
+    const Image* img1 = &image1;
+    if (IsCompressed(image1.format))
+    {
+        HRESULT hr = Decompress(image1, DXGI_FORMAT_R32G32B32A32_FLOAT, temp1);
+        if (FAILED(hr))
+            return hr;
+
+        img1 = temp1.GetImage(0, 0, 0);
+        if (!img1)
+            return E_POINTER;
+    }
+
+    ScratchImage temp2;
+    const Image* img2 = &image2;
+    if (IsCompressed(image2.format))
+    {
+        HRESULT hr = Decompress(image2, DXGI_FORMAT_R32G32B32A32_FLOAT, temp2);
+        if (FAILED(hr))
+            return hr;
+
+        img2 = temp2.GetImage(0, 0, 0);
+        if (!img2)
+            return E_POINTER;
+    }
+
+    return ComputeMetrics_(*img1, *img2, flags, metrics);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::ComputeMetrics(
+    const Image* images1,
+    size_t nimages1,
+    const TexMetadata& metadata1,
+    const Image* images2,
+    size_t nimages2,
+    const TexMetadata& metadata2,
+    DWORD flags,
+    std::vector<ImageMetrics>& metrics)
+{
+    metrics.clear();
+
+    if (!images1 || !nimages1 || !images2 || !nimages2)
+        return E_INVALIDARG;
+
+    if (metadata1.width != metadata2.width
+        || metadata1.height != metadata2.height
+        || metadata1.depth != metadata2.depth
+        || metadata1.arraySize != metadata2.arraySize
+        || metadata1.mipLevels != metadata2.mipLevels
+        || metadata1.dimension != metadata2.dimension)
+        return E_INVALIDARG;
+
+    if (metadata1.width > UINT32_MAX
+        || metadata1.height > UINT32_MAX)
+        return E_INVALIDARG;
+
+    if (metadata1.IsVolumemap() && metadata1.depth > UINT16_MAX)
+        return E_INVALIDARG;
+
+    std::vector<ImageMetrics> results;
+
+    switch (metadata1.dimension)
+    {
+    case TEX_DIMENSION_TEXTURE1D:
+    case TEX_DIMENSION_TEXTURE2D:
+        results.reserve(metadata1.arraySize * metadata1.mipLevels);
+        for (size_t item = 0; item < metadata1.arraySize; ++item)
+        {
+            for (size_t level = 0; level < metadata1.mipLevels; ++level)
+            {
+                size_t index1 = metadata1.ComputeIndex(level, item, 0);
+                size_t index2 = metadata2.ComputeIndex(level, item, 0);
+                if (index1 >= nimages1 || index2 >= nimages2)
+                    return E_FAIL;
+
+                ImageMetrics result;
+                HRESULT hr = ComputeMetrics(images1[index1], images2[index2], flags, result);
+                if (FAILED(hr))
+                    return hr;
+
+                result.mip = level;
+                result.item = item;
+                results.push_back(result);
+            }
+        }
+        break;
+
+    case TEX_DIMENSION_TEXTURE3D:
+    {
+        size_t d = metadata1.depth;
+        for (size_t level = 0; level < metadata1.mipLevels; ++level)
+        {
+            for (size_t slice = 0; slice < d; ++slice)
+            {
+                size_t index1 = metadata1.ComputeIndex(level, 0, slice);
+                size_t index2 = metadata2.ComputeIndex(level, 0, slice);
+                if (index1 >= nimages1 || index2 >= nimages2)
+                    return E_FAIL;
+
+                ImageMetrics result;
+                HRESULT hr = ComputeMetrics(images1[index1], images2[index2], flags, result);
+                if (FAILED(hr))
+                    return hr;
+
+                result.mip = level;
+                result.slice = slice;
+                results.push_back(result);
+            }
+
+            if (d > 1)
+                d >>= 1;
+        }
+    }
+    break;
+
+    default:
+        return E_FAIL;
+    }
+
+    metrics.swap(results);
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Writes comparison metrics as a JSON or CSV report
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::SaveMetricsReport(
+    const ImageMetrics* metrics,
+    size_t nmetrics,
+    DWORD flags,
+    Blob& blob)
+{
+    blob.Release();
+
+    if (!metrics && nmetrics > 0)
+        return E_INVALIDARG;
+
+    const bool json = !(flags & METRICS_REPORT_CSV);
+
+    std::string report;
+    try
+    {
+        if (json)
+        {
+            report.append("[\n");
+        }
+        else
+        {
+            report.append("mip,item,slice,width,height,mse,psnr,ssim,maxError");
+            static const char* s_channels[4] = { "R", "G", "B", "A" };
+            static const char* s_names[4] = { "mse", "psnr", "ssim", "maxError" };
+            for (size_t j = 0; j < 4; ++j)
+            {
+                for (size_t c = 0; c < 4; ++c)
+                    AppendFormat(report, ",%s%s", s_names[j], s_channels[c]);
+            }
+            for (size_t bin = 0; bin < ImageMetrics::HISTOGRAM_BINS; ++bin)
+                AppendFormat(report, ",hist%zu", bin);
+            report.append("\n");
+        }
+
+        for (size_t i = 0; i < nmetrics; ++i)
+        {
+            const ImageMetrics& m = metrics[i];
+
+            if (json)
+            {
+                AppendFormat(report, "  { \"mip\": %zu, \"item\": %zu, \"slice\": %zu, \"width\": %zu, \"height\": %zu",
+                    m.mip, m.item, m.slice, m.width, m.height);
+
+                report.append(", \"mse\": ");
+                AppendFloat(report, m.mse, true);
+                report.append(", \"psnr\": ");
+                AppendFloat(report, m.psnr, true);
+                report.append(", \"ssim\": ");
+                AppendFloat(report, m.ssim, true);
+                report.append(", \"maxError\": ");
+                AppendFloat(report, m.maxError, true);
+
+                AppendJSONArray(report, "mseV", m.mseV, 4);
+                AppendJSONArray(report, "psnrV", m.psnrV, 4);
+                AppendJSONArray(report, "ssimV", m.ssimV, 4);
+                AppendJSONArray(report, "maxErrorV", m.maxErrorV, 4);
+
+                report.append(", \"histogram\": [");
+                for (size_t bin = 0; bin < ImageMetrics::HISTOGRAM_BINS; ++bin)
+                    AppendFormat(report, (bin > 0) ? ", %u" : "%u", m.histogram[bin]);
+                report.append((i + 1 < nmetrics) ? "] },\n" : "] }\n");
+            }
+            else
+            {
+                AppendFormat(report, "%zu,%zu,%zu,%zu,%zu", m.mip, m.item, m.slice, m.width, m.height);
+
+                const float combined[4] = { m.mse, m.psnr, m.ssim, m.maxError };
+                for (size_t j = 0; j < 4; ++j)
+                {
+                    report.append(",");
+                    AppendFloat(report, combined[j], false);
+                }
+
+                const float* channels[4] = { m.mseV, m.psnrV, m.ssimV, m.maxErrorV };
+                for (size_t j = 0; j < 4; ++j)
+                {
+                    for (size_t c = 0; c < 4; ++c)
+                    {
+                        report.append(",");
+                        AppendFloat(report, channels[j][c], false);
+                    }
+                }
+
+                for (size_t bin = 0; bin < ImageMetrics::HISTOGRAM_BINS; ++bin)
+                    AppendFormat(report, ",%u", m.histogram[bin]);
+                report.append("\n");
+            }
+        }
+
+        if (json)
+            report.append("]\n");
+    }
+    catch (const std::bad_alloc&)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    HRESULT hr = blob.Initialize(report.size());
+    if (FAILED(hr))
+        return hr;
+
+    memcpy(blob.GetBufferPointer(), report.data(), report.size());
+
+    return S_OK;
+}
@@ -17,6 +17,9 @@ namespace
 {
     const XMVECTORF32 g_Gamma22 = { { { 2.2f, 2.2f, 2.2f, 1.f } } };
 
+    // Pixels converted per pass by CopyRectangle (must be even)
+    const size_t c_CopyChunk = 128;
+
     //-------------------------------------------------------------------------------------
     HRESULT ComputeMSE_(
         const Image& image1,
@@ -317,6 +320,36 @@ HRESULT DirectX::CopyRectangle(
         // Direct copy case (avoid intermediate conversions)
         uint8_t* pDest = dstImage.pixels + (yOffset * dstImage.rowPitch) + (xOffset * sbpp);
         const size_t copyW = srcRect.w * sbpp;
+
+        if (srcImage.pixels == dstImage.pixels)
+        {
+            // Copying within one image: walk rows bottom-up when moving down so overlapping rows
+            // are read before they are overwritten, and move each row as a possibly overlapping block
+            if (srcImage.rowPitch != dstImage.rowPitch)
+                return E_INVALIDARG;
+
+            ptrdiff_t pitch = static_cast<ptrdiff_t>(srcImage.rowPitch);
+            if (yOffset > srcRect.y)
+            {
+                pSrc += (srcRect.h - 1) * srcImage.rowPitch;
+                pDest += (srcRect.h - 1) * dstImage.rowPitch;
+                pitch = -pitch;
+            }
+
+            for (size_t h = 0; h < srcRect.h; ++h)
+            {
+                if (((pSrc + copyW) > pEndSrc) || (pDest > pEndDest))
+                    return E_FAIL;
+
+                memmove_s(pDest, pEndDest - pDest, pSrc, copyW);
+
+                pSrc += pitch;
+                pDest += pitch;
+            }
+
+            return S_OK;
+        }
+
         for (size_t h = 0; h < srcRect.h; ++h)
         {
             if (((pSrc + copyW) > pEndSrc) || (pDest > pEndDest))
@@ -347,9 +380,9 @@ HRESULT DirectX::CopyRectangle(
 
     uint8_t* pDest = dstImage.pixels + (yOffset * dstImage.rowPitch) + (xOffset * dbpp);
 
-    ScopedAlignedArrayXMVECTOR scanline(static_cast<XMVECTOR*>(_aligned_malloc((sizeof(XMVECTOR)*srcRect.w), 16)));
-    if (!scanline)
-        return E_OUTOFMEMORY;
+    // Convert in chunks through a small stack buffer rather than allocating a full row. The
+    // chunk width is even so that packed formats (YUY2 etc.) never split a pixel pair.
+    XMVECTOR scanline[c_CopyChunk];
 
     const size_t copyS = srcRect.w * sbpp;
     const size_t copyD = srcRect.w * dbpp;
@@ -359,13 +392,18 @@ HRESULT DirectX::CopyRectangle(
         if (((pSrc + copyS) > pEndSrc) || ((pDest + copyD) > pEndDest))
             return E_FAIL;
 
-        if (!_LoadScanline(scanline.get(), srcRect.w, pSrc, copyS, srcImage.format))
-            return E_FAIL;
+        for (size_t x = 0; x < srcRect.w; x += c_CopyChunk)
+        {
+            const size_t count = std::min<size_t>(c_CopyChunk, srcRect.w - x);
 
-        _ConvertScanline(scanline.get(), srcRect.w, dstImage.format, srcImage.format, filter);
+            if (!_LoadScanline(scanline, count, pSrc + x * sbpp, count * sbpp, srcImage.format))
+                return E_FAIL;
 
-        if (!_StoreScanline(pDest, copyD, dstImage.format, scanline.get(), srcRect.w))
-            return E_FAIL;
+            _ConvertScanline(scanline, count, dstImage.format, srcImage.format, filter);
+
+            if (!_StoreScanline(pDest + x * dbpp, count * dbpp, dstImage.format, scanline, count))
+                return E_FAIL;
+        }
 
         pSrc += srcImage.rowPitch;
         pDest += dstImage.rowPitch;
@@ -11,66 +11,297 @@
 
 #include "DirectXTexp.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#pragma warning(disable : 4616 6993)
+#endif
+
 using namespace DirectX;
 
+namespace DirectX
+{
+    extern bool _CalculateMipLevels(_In_ size_t width, _In_ size_t height, _Inout_ size_t& mipLevels);
+}
+
 namespace
 {
+    // Scanlines per work item for threaded processing
+    const size_t NMAP_BAND_HEIGHT = 16;
 
-#pragma prefast(suppress : 25000, "FXMVECTOR is 16 bytes")
-    inline float EvaluateColor(_In_ FXMVECTOR val, _In_ DWORD flags)
-    {
-        XMFLOAT4A f;
+    const XMVECTORF32 g_Luminance = { { { 0.2125f, 0.7154f, 0.0721f, 0.f } } };
 
-        static XMVECTORF32 lScale = { { { 0.2125f, 0.7154f, 0.0721f, 1.f } } };
+    //-------------------------------------------------------------------------------------
+    // Height evaluation
+    //-------------------------------------------------------------------------------------
+    void EvaluateRow(
+        _In_reads_(width) const XMVECTOR* pSource,
+        _Out_writes_(width + 2) float* pDest,
+        size_t width,
+        DWORD flags)
+    {
+        assert(pSource && pDest);
+        assert(width > 0);
 
+        // Channel selection is hoisted out of the pixel loop
         static_assert(CNMAP_CHANNEL_RED == 0x1, "CNMAP_CHANNEL_ flag values don't match mask");
         switch (flags & 0xf)
         {
         case 0:
-        case CNMAP_CHANNEL_RED:     return XMVectorGetX(val);
-        case CNMAP_CHANNEL_GREEN:   return XMVectorGetY(val);
-        case CNMAP_CHANNEL_BLUE:    return XMVectorGetZ(val);
-        case CNMAP_CHANNEL_ALPHA:   return XMVectorGetW(val);
+        case CNMAP_CHANNEL_RED:
+            for (size_t x = 0; x < width; ++x)
+                pDest[x + 1] = XMVectorGetX(pSource[x]);
+            break;
+
+        case CNMAP_CHANNEL_GREEN:
+            for (size_t x = 0; x < width; ++x)
+                pDest[x + 1] = XMVectorGetY(pSource[x]);
+            break;
+
+        case CNMAP_CHANNEL_BLUE:
+            for (size_t x = 0; x < width; ++x)
+                pDest[x + 1] = XMVectorGetZ(pSource[x]);
+            break;
+
+        case CNMAP_CHANNEL_ALPHA:
+            for (size_t x = 0; x < width; ++x)
+                pDest[x + 1] = XMVectorGetW(pSource[x]);
+            break;
 
         case CNMAP_CHANNEL_LUMINANCE:
-        {
-            XMVECTOR v = XMVectorMultiply(val, lScale);
-            XMStoreFloat4A(&f, v);
-            return f.x + f.y + f.z;
-        }
+            for (size_t x = 0; x < width; ++x)
+                pDest[x + 1] = XMVectorGetX(XMVector3Dot(pSource[x], g_Luminance));
+            break;
 
         default:
             assert(false);
-            return 0.f;
+            memset(pDest, 0, sizeof(float) * (width + 2));
+            return;
+        }
+
+        if (flags & CNMAP_MIRROR_U)
+        {
+            // Mirror in U
+            pDest[0] = pDest[1];
+            pDest[width + 1] = pDest[width];
+        }
+        else
+        {
+            // Wrap in U
+            pDest[0] = pDest[width];
+            pDest[width + 1] = pDest[1];
         }
     }
 
-    void EvaluateRow(
-        _In_reads_(width) const XMVECTOR* pSource,
-        _Out_writes_(width + 2) float* pDest,
-        size_t width,
-        DWORD flags)
+    // Loads and evaluates scanline 'y' of the height map, resolving rows outside the image per CNMAP_MIRROR_V
+    bool EvaluateSourceRow(
+        const Image& srcImage,
+        ptrdiff_t y,
+        DWORD flags,
+        _Out_writes_(srcImage.width) XMVECTOR* scanline,
+        _Out_writes_(srcImage.width + 2) float* pDest)
     {
-        assert(pSource && pDest);
-        assert(width > 0);
+        const ptrdiff_t height = static_cast<ptrdiff_t>(srcImage.height);
+        if (y < 0)
+        {
+            y = (flags & CNMAP_MIRROR_V) ? 0 : (height - 1);
+        }
+        else if (y >= height)
+        {
+            y = (flags & CNMAP_MIRROR_V) ? (height - 1) : 0;
+        }
 
-        for (size_t x = 0; x < width; ++x)
+        if (!_LoadScanline(scanline, srcImage.width, srcImage.pixels + (srcImage.rowPitch * size_t(y)), srcImage.rowPitch, srcImage.format))
+            return false;
+
+        EvaluateRow(scanline, pDest, srcImage.width, flags);
+        return true;
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Height-map to normal-map conversion
+    //-------------------------------------------------------------------------------------
+    struct NMapKernel
+    {
+        XMVECTOR outer;     // Weight of the neighboring rows/columns
+        XMVECTOR center;    // Weight of the center row/column
+        XMVECTOR scale;     // amplitude / (2 * sum of weights)
+    };
+
+    NMapKernel GetKernel(DWORD flags, float amplitude)
+    {
+        float outer = 1.f;
+        float center = 1.f;
+
+        if (flags & CNMAP_SOBEL)
+        {
+            center = 2.f;
+        }
+        else if (flags & CNMAP_SCHARR)
         {
-            pDest[x + 1] = EvaluateColor(pSource[x], flags);
+            outer = 3.f;
+            center = 10.f;
         }
 
-        if (flags & CNMAP_MIRROR_U)
+        NMapKernel kernel;
+        kernel.outer = XMVectorReplicate(outer);
+        kernel.center = XMVectorReplicate(center);
+        kernel.scale = XMVectorReplicate(amplitude / (2.f * (outer * 2.f + center)));
+        return kernel;
+    }
+
+    // Computes four horizontally adjacent normals from three evaluated rows (SoA), returned as one pixel per row of 'pixels'
+    void ComputeNormals4(
+        _In_reads_(6) const float* val0,
+        _In_reads_(6) const float* val1,
+        _In_reads_(6) const float* val2,
+        const NMapKernel& kernel,
+        DWORD flags,
+        DWORD convFlags,
+        float amplitude,
+        XMMATRIX& pixels)
+    {
+        const XMVECTOR t0 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(val0));
+        const XMVECTOR t1 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(val0 + 1));
+        const XMVECTOR t2 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(val0 + 2));
+        const XMVECTOR m0 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(val1));
+        const XMVECTOR m1 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(val1 + 1));
+        const XMVECTOR m2 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(val1 + 2));
+        const XMVECTOR b0 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(val2));
+        const XMVECTOR b1 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(val2 + 1));
+        const XMVECTOR b2 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(val2 + 2));
+
+        // Weighted central differences
+        XMVECTOR deltaZX = XMVectorAdd(XMVectorSubtract(t0, t2), XMVectorSubtract(b0, b2));
+        deltaZX = XMVectorMultiplyAdd(kernel.outer, deltaZX, XMVectorMultiply(kernel.center, XMVectorSubtract(m0, m2)));
+        deltaZX = XMVectorMultiply(deltaZX, kernel.scale);
+
+        XMVECTOR deltaZY = XMVectorAdd(XMVectorSubtract(t0, b0), XMVectorSubtract(t2, b2));
+        deltaZY = XMVectorMultiplyAdd(kernel.outer, deltaZY, XMVectorMultiply(kernel.center, XMVectorSubtract(t1, b1)));
+        deltaZY = XMVectorMultiply(deltaZY, kernel.scale);
+
+        // cross((-1, 0, deltaZX), (0, -1, deltaZY)) = (deltaZX, deltaZY, 1)
+        XMVECTOR lengthSq = XMVectorMultiplyAdd(deltaZX, deltaZX, XMVectorMultiplyAdd(deltaZY, deltaZY, g_XMOne));
+        XMVECTOR invLength = XMVectorDivide(g_XMOne, XMVectorSqrt(lengthSq));
+
+        XMVECTOR nx = XMVectorMultiply(deltaZX, invLength);
+        XMVECTOR ny = XMVectorMultiply(deltaZY, invLength);
+        XMVECTOR nz = invLength;
+
+        // Compute alpha (1.0 or an occlusion term)
+        XMVECTOR alpha = g_XMOne;
+
+        if (flags & CNMAP_COMPUTE_OCCLUSION)
         {
-            // Mirror in U
-            pDest[0] = EvaluateColor(pSource[0], flags);
-            pDest[width + 1] = EvaluateColor(pSource[width - 1], flags);
+            const XMVECTOR zero = XMVectorZero();
+
+            XMVECTOR delta = XMVectorMax(XMVectorSubtract(t0, m1), zero);
+            delta = XMVectorAdd(delta, XMVectorMax(XMVectorSubtract(t1, m1), zero));
+            delta = XMVectorAdd(delta, XMVectorMax(XMVectorSubtract(t2, m1), zero));
+            delta = XMVectorAdd(delta, XMVectorMax(XMVectorSubtract(m0, m1), zero));
+            // Skip current pixel
+            delta = XMVectorAdd(delta, XMVectorMax(XMVectorSubtract(m2, m1), zero));
+            delta = XMVectorAdd(delta, XMVectorMax(XMVectorSubtract(b0, m1), zero));
+            delta = XMVectorAdd(delta, XMVectorMax(XMVectorSubtract(b1, m1), zero));
+            delta = XMVectorAdd(delta, XMVectorMax(XMVectorSubtract(b2, m1), zero));
+
+            // Average delta (divide by 8, scale by amplitude factor)
+            delta = XMVectorMultiply(delta, XMVectorReplicate(0.125f * amplitude));
+
+            // If <= 0, then no occlusion
+            XMVECTOR r = XMVectorSqrt(XMVectorMultiplyAdd(delta, delta, g_XMOne));
+            XMVECTOR occlusion = XMVectorDivide(XMVectorSubtract(r, delta), r);
+            alpha = XMVectorSelect(g_XMOne, occlusion, XMVectorGreater(delta, zero));
         }
-        else
+
+        // Encode based on target format
+        if (convFlags & CONVF_UNORM)
         {
-            // Wrap in U
-            pDest[0] = EvaluateColor(pSource[width - 1], flags);
-            pDest[width + 1] = EvaluateColor(pSource[0], flags);
+            // 0.5f*normal + 0.5f -or- invert sign case: -0.5f*normal + 0.5f
+            XMVECTOR s = (flags & CNMAP_INVERT_SIGN) ? g_XMNegativeOneHalf : g_XMOneHalf;
+            nx = XMVectorMultiplyAdd(s, nx, g_XMOneHalf);
+            ny = XMVectorMultiplyAdd(s, ny, g_XMOneHalf);
+            nz = XMVectorMultiplyAdd(s, nz, g_XMOneHalf);
+        }
+        else if (flags & CNMAP_INVERT_SIGN)
+        {
+            nx = XMVectorNegate(nx);
+            ny = XMVectorNegate(ny);
+            nz = XMVectorNegate(nz);
+        }
+
+        pixels = XMMatrixTranspose(XMMATRIX(nx, ny, nz, alpha));
+    }
+
+    // Generates scanlines [y0, y1) of the normal map
+    bool ComputeNMapBand(
+        const Image& srcImage,
+        DWORD flags,
+        float amplitude,
+        DWORD convFlags,
+        const Image& normalMap,
+        size_t y0,
+        size_t y1)
+    {
+        const size_t width = srcImage.width;
+
+        // Pixels are processed four at a time; evaluated rows are padded so the last group can be read whole
+        const size_t width4 = (width + 3) & ~size_t(3);
+        const size_t stride = width4 + 4;
+
+        ScopedAlignedArrayXMVECTOR scanline(static_cast<XMVECTOR*>(_aligned_malloc(sizeof(XMVECTOR) * (width + width4), 16)));
+        if (!scanline)
+            return false;
+
+        ScopedAlignedArrayFloat buffer(static_cast<float*>(_aligned_malloc(sizeof(float) * stride * 3, 16)));
+        if (!buffer)
+            return false;
+
+        memset(buffer.get(), 0, sizeof(float) * stride * 3);
+
+        XMVECTOR* row = scanline.get();
+        XMVECTOR* target = row + width;
+
+        float* val0 = buffer.get();
+        float* val1 = val0 + stride;
+        float* val2 = val1 + stride;
+
+        if (!EvaluateSourceRow(srcImage, ptrdiff_t(y0) - 1, flags, row, val0)
+            || !EvaluateSourceRow(srcImage, ptrdiff_t(y0), flags, row, val1))
+            return false;
+
+        const NMapKernel kernel = GetKernel(flags, amplitude);
+
+        uint8_t* pDest = normalMap.pixels + (normalMap.rowPitch * y0);
+
+        for (size_t y = y0; y < y1; ++y)
+        {
+            if (!EvaluateSourceRow(srcImage, ptrdiff_t(y) + 1, flags, row, val2))
+                return false;
+
+            for (size_t x = 0; x < width4; x += 4)
+            {
+                XMMATRIX pixels;
+                ComputeNormals4(val0 + x, val1 + x, val2 + x, kernel, flags, convFlags, amplitude, pixels);
+
+                target[x] = pixels.r[0];
+                target[x + 1] = pixels.r[1];
+                target[x + 2] = pixels.r[2];
+                target[x + 3] = pixels.r[3];
+            }
+
+            if (!_StoreScanline(pDest, normalMap.rowPitch, normalMap.format, target, width))
+                return false;
+
+            // Cycle buffers
+            float* temp = val0;
+            val0 = val1;
+            val1 = val2;
+            val2 = temp;
+
+            pDest += normalMap.rowPitch;
         }
+
+        return true;
     }
 
     HRESULT ComputeNMap(_In_ const Image& srcImage, _In_ DWORD flags, _In_ float amplitude,
@@ -88,159 +319,563 @@ namespace
 
         const size_t width = srcImage.width;
         const size_t height = srcImage.height;
-        if (width != normalMap.width || height != normalMap.height)
+        if (width != normalMap.width || height != normalMap.height || format != normalMap.format)
             return E_FAIL;
 
-        // Allocate temporary space (4 scanlines and 3 evaluated rows)
-        ScopedAlignedArrayXMVECTOR scanline(static_cast<XMVECTOR*>(_aligned_malloc((sizeof(XMVECTOR)*width * 4), 16)));
-        if (!scanline)
-            return E_OUTOFMEMORY;
-
-        ScopedAlignedArrayFloat buffer(static_cast<float*>(_aligned_malloc(((sizeof(float) * (width + 2)) * 3), 16)));
-        if (!buffer)
-            return E_OUTOFMEMORY;
+        // Each band reads the rows bordering it, so bands can be generated independently
+        const size_t nbands = (height + NMAP_BAND_HEIGHT - 1) / NMAP_BAND_HEIGHT;
 
-        uint8_t* pDest = normalMap.pixels;
-        if (!pDest)
-            return E_POINTER;
+        bool fail = false;
 
-        XMVECTOR* row0 = scanline.get();
-        XMVECTOR* row1 = row0 + width;
-        XMVECTOR* row2 = row1 + width;
-        XMVECTOR* target = row2 + width;
+#ifdef _OPENMP
+#pragma omp parallel for if (nbands >= 4)
+#endif
+        for (int band = 0; band < static_cast<int>(nbands); ++band)
+        {
+            const size_t y0 = size_t(band) * NMAP_BAND_HEIGHT;
+            const size_t y1 = std::min(y0 + NMAP_BAND_HEIGHT, height);
 
-        float* val0 = buffer.get();
-        float* val1 = val0 + width + 2;
-        float* val2 = val1 + width + 2;
+            if (!ComputeNMapBand(srcImage, flags, amplitude, convFlags, normalMap, y0, y1))
+                fail = true;
+        }
 
-        const size_t rowPitch = srcImage.rowPitch;
-        const uint8_t* pSrc = srcImage.pixels;
+        return (fail) ? E_FAIL : S_OK;
+    }
 
-        // Read first scanline row into 'row1'
-        if (!_LoadScanline(row1, width, pSrc, rowPitch, srcImage.format))
-            return E_FAIL;
+    //-------------------------------------------------------------------------------------
+    // Normal-map mipmap generation
+    //-------------------------------------------------------------------------------------
 
-        // Setup 'row0'
-        if (flags & CNMAP_MIRROR_V)
+    // Two-channel normal maps store X & Y only
+    bool HasNormalZ(DXGI_FORMAT format)
+    {
+        switch (format)
         {
-            // Mirror first row
-            memcpy_s(row0, rowPitch, row1, rowPitch);
+        case DXGI_FORMAT_R8G8_UNORM:
+        case DXGI_FORMAT_R8G8_SNORM:
+        case DXGI_FORMAT_R16G16_UNORM:
+        case DXGI_FORMAT_R16G16_SNORM:
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R32G32_FLOAT:
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+            return false;
+
+        default:
+            return true;
         }
-        else
+    }
+
+    // Loads scanline 'y' of a normal map as unit vectors (w is passed through)
+    bool LoadNormalRow(
+        const Image& image,
+        size_t y,
+        DWORD convFlags,
+        _Out_writes_(image.width) XMVECTOR* row)
+    {
+        if (!_LoadScanline(row, image.width, image.pixels + (image.rowPitch * y), image.rowPitch, image.format))
+            return false;
+
+        const bool hasZ = HasNormalZ(image.format);
+
+        for (size_t x = 0; x < image.width; ++x)
         {
-            // Read last row (Wrap V)
-            if (!_LoadScanline(row0, width, pSrc + (rowPitch * (height - 1)), rowPitch, srcImage.format))
-                return E_FAIL;
+            XMVECTOR v = row[x];
+            if (convFlags & CONVF_UNORM)
+            {
+                // 2.0f*value - 1.0f
+                v = XMVectorSubtract(XMVectorAdd(v, v), g_XMOne);
+            }
+
+            if (!hasZ)
+            {
+                // z = sqrt(1 - x*x - y*y)
+                XMVECTOR z = XMVectorSqrt(XMVectorMax(XMVectorSubtract(g_XMOne, XMVector2Dot(v, v)), g_XMZero));
+                v = XMVectorSelect(v, z, g_XMSelect0010);
+            }
+
+            row[x] = XMVectorSelect(row[x], XMVector3Normalize(v), g_XMSelect1110);
         }
 
-        // Evaluate the initial rows
-        EvaluateRow(row0, val0, width, flags);
-        EvaluateRow(row1, val1, width, flags);
+        return true;
+    }
+
+    // Encodes averaged normals: the direction is renormalized and the length gives the Toksvig variance
+    void EncodeNormalRow(
+        _In_reads_(width) const XMVECTOR* pSource,
+        _Out_writes_(width) XMVECTOR* pDest,
+        size_t width,
+        DWORD flags,
+        DWORD convFlags)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            XMVECTOR v = pSource[x];
+
+            XMVECTOR length = XMVector3Length(v);
+            XMVECTOR normal = XMVector3Normalize(v);
+
+            // (1 - |Na|) / |Na|, a zero-length average saturates to 1
+            XMVECTOR variance = XMVectorSaturate(XMVectorDivide(XMVectorSubtract(g_XMOne, length), length));
+
+            if (convFlags & CONVF_UNORM)
+            {
+                // 0.5f*normal + 0.5f
+                normal = XMVectorMultiplyAdd(normal, g_XMOneHalf, g_XMOneHalf);
+            }
+
+            v = XMVectorSelect(v, normal, g_XMSelect1110);
 
-        pSrc += rowPitch;
+            if (flags & NMAP_MIPS_VARIANCE_ALPHA)
+            {
+                v = XMVectorSelect(v, variance, g_XMSelect0001);
+            }
+            else if (flags & NMAP_MIPS_VARIANCE_BLUE)
+            {
+                v = XMVectorSelect(v, variance, g_XMSelect0010);
+            }
 
-        for (size_t y = 0; y < height; ++y)
+            pDest[x] = v;
+        }
+    }
+
+    // Box-filters one destination scanline; odd source sizes fold the last row/column into the final texel
+    void AverageRow(
+        _In_reads_(nrows) const XMVECTOR* const* rows,
+        size_t nrows,
+        size_t srcWidth,
+        _Out_writes_(destWidth) XMVECTOR* pDest,
+        size_t destWidth)
+    {
+        for (size_t x = 0; x < destWidth; ++x)
         {
-            // Load next scanline of source image
-            if (y < (height - 1))
+            const size_t x0 = (x * srcWidth) / destWidth;
+            const size_t x1 = ((x + 1) * srcWidth) / destWidth;
+
+            XMVECTOR sum = XMVectorZero();
+            for (size_t j = 0; j < nrows; ++j)
             {
-                if (!_LoadScanline(row2, width, pSrc, rowPitch, srcImage.format))
-                    return E_FAIL;
+                for (size_t i = x0; i < x1; ++i)
+                {
+                    sum = XMVectorAdd(sum, rows[j][i]);
+                }
             }
-            else
+
+            pDest[x] = XMVectorScale(sum, 1.f / float((x1 - x0) * nrows));
+        }
+    }
+
+    // Generates 'levels' images into 'dest' from 'baseImage' (which is also dest[0]'s source)
+    HRESULT GenerateNMapMips(
+        const Image& baseImage,
+        DWORD flags,
+        size_t levels,
+        _In_reads_(levels) const Image* dest)
+    {
+        const DWORD convFlags = _GetConvertFlags(baseImage.format);
+        if (!convFlags)
+            return E_FAIL;
+
+        if (!(convFlags & (CONVF_UNORM | CONVF_SNORM | CONVF_FLOAT)))
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+        const size_t width = baseImage.width;
+        const size_t height = baseImage.height;
+
+        bool fail = false;
+
+        //--- Level 0 is a copy, or unit normals with zero variance ---------------------------
+        if (flags & (NMAP_MIPS_VARIANCE_ALPHA | NMAP_MIPS_VARIANCE_BLUE))
+        {
+            const size_t nbands = (height + NMAP_BAND_HEIGHT - 1) / NMAP_BAND_HEIGHT;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (nbands >= 4)
+#endif
+            for (int band = 0; band < static_cast<int>(nbands); ++band)
             {
-                if (flags & CNMAP_MIRROR_V)
+                ScopedAlignedArrayXMVECTOR scanline(static_cast<XMVECTOR*>(_aligned_malloc(sizeof(XMVECTOR) * width * 2, 16)));
+                if (!scanline)
                 {
-                    // Use last row of source image
-                    if (!_LoadScanline(row2, width, srcImage.pixels + (rowPitch * (height - 1)), rowPitch, srcImage.format))
-                        return E_FAIL;
+                    fail = true;
+                    continue;
                 }
-                else
+
+                XMVECTOR* row = scanline.get();
+                XMVECTOR* target = row + width;
+
+                const size_t y1 = std::min(size_t(band + 1) * NMAP_BAND_HEIGHT, height);
+                for (size_t y = size_t(band) * NMAP_BAND_HEIGHT; y < y1; ++y)
                 {
-                    // Use first row of source image (Wrap V)
-                    if (!_LoadScanline(row2, width, srcImage.pixels, rowPitch, srcImage.format))
-                        return E_FAIL;
+                    if (!LoadNormalRow(baseImage, y, convFlags, row))
+                    {
+                        fail = true;
+                        break;
+                    }
+
+                    EncodeNormalRow(row, target, width, flags, convFlags);
+
+                    if (!_StoreScanline(dest[0].pixels + (dest[0].rowPitch * y), dest[0].rowPitch, dest[0].format, target, width))
+                    {
+                        fail = true;
+                        break;
+                    }
                 }
             }
+        }
+        else
+        {
+            const uint8_t* pSrc = baseImage.pixels;
+            uint8_t* pDest = dest[0].pixels;
+            const size_t rowPitch = std::min(baseImage.rowPitch, dest[0].rowPitch);
+            for (size_t y = 0; y < height; ++y)
+            {
+                memcpy_s(pDest, dest[0].rowPitch, pSrc, rowPitch);
+                pSrc += baseImage.rowPitch;
+                pDest += dest[0].rowPitch;
+            }
+        }
 
-            // Evaluate row
-            EvaluateRow(row2, val2, width, flags);
+        if (fail)
+            return E_FAIL;
 
-            // Generate target scanline
-            XMVECTOR *dptr = target;
-            for (size_t x = 0; x < width; ++x)
-            {
-                // Compute normal via central differencing
-                float totDelta = (val0[x] - val0[x + 2]) + (val1[x] - val1[x + 2]) + (val2[x] - val2[x + 2]);
-                float deltaZX = totDelta * amplitude / 6.f;
+        if (levels <= 1)
+            return S_OK;
 
-                totDelta = (val0[x] - val2[x]) + (val0[x + 1] - val2[x + 1]) + (val0[x + 2] - val2[x + 2]);
-                float deltaZY = totDelta * amplitude / 6.f;
+        //--- Level 1 from the base image --------------------------------------------------
+        // Average normals are kept unnormalized at full precision so that each level's length
+        // reflects the spread of the base normals under its footprint.
+        size_t srcWidth = std::max<size_t>(1, width >> 1);
+        size_t srcHeight = std::max<size_t>(1, height >> 1);
 
-                XMVECTOR vx = XMVectorSetZ(g_XMNegIdentityR0, deltaZX);   // (-1.0f, 0.0f, deltaZX)
-                XMVECTOR vy = XMVectorSetZ(g_XMNegIdentityR1, deltaZY);   // (0.0f, -1.0f, deltaZY)
+        ScopedAlignedArrayXMVECTOR work(static_cast<XMVECTOR*>(_aligned_malloc(sizeof(XMVECTOR) * srcWidth * srcHeight * 2, 16)));
+        if (!work)
+            return E_OUTOFMEMORY;
+
+        XMVECTOR* current = work.get();
+        XMVECTOR* next = current + srcWidth * srcHeight;
+
+        {
+            const Image& img = dest[1];
+            assert(img.width == srcWidth && img.height == srcHeight);
 
-                XMVECTOR normal = XMVector3Normalize(XMVector3Cross(vx, vy));
+            const size_t nbands = (srcHeight + NMAP_BAND_HEIGHT - 1) / NMAP_BAND_HEIGHT;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (nbands >= 4)
+#endif
+            for (int band = 0; band < static_cast<int>(nbands); ++band)
+            {
+                // Up to three source rows per destination row, plus the encoded scanline
+                ScopedAlignedArrayXMVECTOR scanline(static_cast<XMVECTOR*>(_aligned_malloc(sizeof(XMVECTOR) * (width * 3 + srcWidth), 16)));
+                if (!scanline)
+                {
+                    fail = true;
+                    continue;
+                }
 
-                // Compute alpha (1.0 or an occlusion term)
-                float alpha = 1.f;
+                XMVECTOR* target = scanline.get() + width * 3;
 
-                if (flags & CNMAP_COMPUTE_OCCLUSION)
+                const size_t y1 = std::min(size_t(band + 1) * NMAP_BAND_HEIGHT, srcHeight);
+                for (size_t y = size_t(band) * NMAP_BAND_HEIGHT; y < y1; ++y)
                 {
-                    float delta = 0.f;
-                    float c = val1[x + 1];
-
-                    float t = val0[x] - c;  if (t > 0.f) delta += t;
-                    t = val0[x + 1] - c;    if (t > 0.f) delta += t;
-                    t = val0[x + 2] - c;    if (t > 0.f) delta += t;
-                    t = val1[x] - c;    if (t > 0.f) delta += t;
-                    // Skip current pixel
-                    t = val1[x + 2] - c;    if (t > 0.f) delta += t;
-                    t = val2[x] - c;    if (t > 0.f) delta += t;
-                    t = val2[x + 1] - c;    if (t > 0.f) delta += t;
-                    t = val2[x + 2] - c;    if (t > 0.f) delta += t;
-
-                    // Average delta (divide by 8, scale by amplitude factor)
-                    delta *= 0.125f * amplitude;
-                    if (delta > 0.f)
+                    const size_t sy0 = (y * height) / srcHeight;
+                    const size_t sy1 = ((y + 1) * height) / srcHeight;
+
+                    const XMVECTOR* rows[3] = {};
+                    for (size_t j = 0; j < sy1 - sy0; ++j)
+                    {
+                        XMVECTOR* row = scanline.get() + width * j;
+                        if (!LoadNormalRow(baseImage, sy0 + j, convFlags, row))
+                        {
+                            fail = true;
+                            break;
+                        }
+                        rows[j] = row;
+                    }
+
+                    if (fail)
+                        break;
+
+                    XMVECTOR* avg = current + srcWidth * y;
+                    AverageRow(rows, sy1 - sy0, width, avg, srcWidth);
+
+                    EncodeNormalRow(avg, target, srcWidth, flags, convFlags);
+
+                    if (!_StoreScanline(img.pixels + (img.rowPitch * y), img.rowPitch, img.format, target, srcWidth))
                     {
-                        // If < 0, then no occlusion
-                        float r = sqrtf(1.f + delta*delta);
-                        alpha = (r - delta) / r;
+                        fail = true;
+                        break;
                     }
                 }
+            }
+
+            if (fail)
+                return E_FAIL;
+        }
+
+        //--- Remaining levels from the previous level's averages ---------------------------
+        for (size_t level = 2; level < levels; ++level)
+        {
+            const Image& img = dest[level];
+
+            const size_t mipWidth = std::max<size_t>(1, srcWidth >> 1);
+            const size_t mipHeight = std::max<size_t>(1, srcHeight >> 1);
+            assert(img.width == mipWidth && img.height == mipHeight);
 
-                // Encode based on target format
-                if (convFlags & CONVF_UNORM)
+            const size_t nbands = (mipHeight + NMAP_BAND_HEIGHT - 1) / NMAP_BAND_HEIGHT;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (nbands >= 4)
+#endif
+            for (int band = 0; band < static_cast<int>(nbands); ++band)
+            {
+                ScopedAlignedArrayXMVECTOR scanline(static_cast<XMVECTOR*>(_aligned_malloc(sizeof(XMVECTOR) * mipWidth, 16)));
+                if (!scanline)
                 {
-                    // 0.5f*normal + 0.5f -or- invert sign case: -0.5f*normal + 0.5f
-                    XMVECTOR n1 = XMVectorMultiplyAdd((flags & CNMAP_INVERT_SIGN) ? g_XMNegativeOneHalf : g_XMOneHalf, normal, g_XMOneHalf);
-                    *dptr++ = XMVectorSetW(n1, alpha);
+                    fail = true;
+                    continue;
                 }
-                else if (flags & CNMAP_INVERT_SIGN)
+
+                const size_t y1 = std::min(size_t(band + 1) * NMAP_BAND_HEIGHT, mipHeight);
+                for (size_t y = size_t(band) * NMAP_BAND_HEIGHT; y < y1; ++y)
                 {
-                    *dptr++ = XMVectorSetW(XMVectorNegate(normal), alpha);
+                    const size_t sy0 = (y * srcHeight) / mipHeight;
+                    const size_t sy1 = ((y + 1) * srcHeight) / mipHeight;
+
+                    const XMVECTOR* rows[3] = {};
+                    for (size_t j = 0; j < sy1 - sy0; ++j)
+                    {
+                        rows[j] = current + srcWidth * (sy0 + j);
+                    }
+
+                    XMVECTOR* avg = next + mipWidth * y;
+                    AverageRow(rows, sy1 - sy0, srcWidth, avg, mipWidth);
+
+                    EncodeNormalRow(avg, scanline.get(), mipWidth, flags, convFlags);
+
+                    if (!_StoreScanline(img.pixels + (img.rowPitch * y), img.rowPitch, img.format, scanline.get(), mipWidth))
+                    {
+                        fail = true;
+                        break;
+                    }
                 }
-                else
+            }
+
+            if (fail)
+                return E_FAIL;
+
+            std::swap(current, next);
+            srcWidth = mipWidth;
+            srcHeight = mipHeight;
+        }
+
+        return S_OK;
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Specular anti-aliasing
+    //-------------------------------------------------------------------------------------
+
+    // Unnormalized average normals of a normal map at successively halved resolutions
+    class NormalPyramid
+    {
+    public:
+        struct Level
+        {
+            size_t width;
+            size_t height;
+            const XMVECTOR* data;
+        };
+
+        HRESULT Initialize(const Image& normalMap)
+        {
+            const DWORD convFlags = _GetConvertFlags(normalMap.format);
+            if (!convFlags)
+                return E_FAIL;
+
+            if (!(convFlags & (CONVF_UNORM | CONVF_SNORM | CONVF_FLOAT)))
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+            size_t total = 0;
+            for (size_t w = normalMap.width, h = normalMap.height; ; w = std::max<size_t>(1, w >> 1), h = std::max<size_t>(1, h >> 1))
+            {
+                total += w * h;
+                if (w == 1 && h == 1)
+                    break;
+            }
+
+            m_data.reset(static_cast<XMVECTOR*>(_aligned_malloc(sizeof(XMVECTOR) * total, 16)));
+            if (!m_data)
+                return E_OUTOFMEMORY;
+
+            m_levels.clear();
+
+            XMVECTOR* pDest = m_data.get();
+            size_t width = normalMap.width;
+            size_t height = normalMap.height;
+
+            // Base level holds the decoded unit normals
+            bool fail = false;
+            size_t nbands = (height + NMAP_BAND_HEIGHT - 1) / NMAP_BAND_HEIGHT;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (nbands >= 4)
+#endif
+            for (int band = 0; band < static_cast<int>(nbands); ++band)
+            {
+                const size_t y1 = std::min(size_t(band + 1) * NMAP_BAND_HEIGHT, height);
+                for (size_t y = size_t(band) * NMAP_BAND_HEIGHT; y < y1; ++y)
                 {
-                    *dptr++ = XMVectorSetW(normal, alpha);
+                    if (!LoadNormalRow(normalMap, y, convFlags, pDest + width * y))
+                    {
+                        fail = true;
+                        break;
+                    }
                 }
             }
 
-            if (!_StoreScanline(pDest, normalMap.rowPitch, format, target, width))
+            if (fail)
                 return E_FAIL;
 
-            // Cycle buffers
-            float* temp = val0;
-            val0 = val1;
-            val1 = val2;
-            val2 = temp;
+            Level base = { width, height, pDest };
+            m_levels.push_back(base);
 
-            pSrc += rowPitch;
-            pDest += normalMap.rowPitch;
+            while (width > 1 || height > 1)
+            {
+                const XMVECTOR* pSrc = pDest;
+                const size_t srcWidth = width;
+                const size_t srcHeight = height;
+
+                pDest += width * height;
+                width = std::max<size_t>(1, width >> 1);
+                height = std::max<size_t>(1, height >> 1);
+
+                nbands = (height + NMAP_BAND_HEIGHT - 1) / NMAP_BAND_HEIGHT;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (nbands >= 4)
+#endif
+                for (int band = 0; band < static_cast<int>(nbands); ++band)
+                {
+                    const size_t y1 = std::min(size_t(band + 1) * NMAP_BAND_HEIGHT, height);
+                    for (size_t y = size_t(band) * NMAP_BAND_HEIGHT; y < y1; ++y)
+                    {
+                        const size_t sy0 = (y * srcHeight) / height;
+                        const size_t sy1 = ((y + 1) * srcHeight) / height;
+
+                        const XMVECTOR* rows[3] = {};
+                        for (size_t j = 0; j < sy1 - sy0; ++j)
+                        {
+                            rows[j] = pSrc + srcWidth * (sy0 + j);
+                        }
+
+                        AverageRow(rows, sy1 - sy0, srcWidth, pDest + width * y, width);
+                    }
+                }
+
+                Level level = { width, height, pDest };
+                m_levels.push_back(level);
+            }
+
+            return S_OK;
         }
 
-        return S_OK;
+        // Coarsest level that is at least the given size, so each texel covers one or more entries
+        const Level& Select(size_t width, size_t height) const
+        {
+            assert(!m_levels.empty());
+
+            size_t index = 0;
+            while ((index + 1) < m_levels.size()
+                && m_levels[index + 1].width >= width && m_levels[index + 1].height >= height)
+            {
+                ++index;
+            }
+
+            return m_levels[index];
+        }
+
+    private:
+        ScopedAlignedArrayXMVECTOR  m_data;
+        std::vector<Level>          m_levels;
+    };
+
+    // A band of scanlines of one roughness image
+    struct SpecularAAWork
+    {
+        size_t index;
+        size_t y0;
+        size_t y1;
+    };
+
+    bool ComputeSpecularAABand(
+        const Image& srcImage,
+        const NormalPyramid& pyramid,
+        DWORD flags,
+        float maxVariance,
+        const Image& destImage,
+        size_t y0,
+        size_t y1)
+    {
+        const size_t width = srcImage.width;
+
+        ScopedAlignedArrayXMVECTOR scanline(static_cast<XMVECTOR*>(_aligned_malloc(sizeof(XMVECTOR) * width, 16)));
+        if (!scanline)
+            return false;
+
+        // Footprints are rounded down to whole entries of the selected level; for power-of-2 sizes they are exact
+        const NormalPyramid::Level& level = pyramid.Select(width, srcImage.height);
+        const size_t scaleX = std::max<size_t>(1, level.width / width);
+        const size_t scaleY = std::max<size_t>(1, level.height / srcImage.height);
+
+        static_assert(SPECAA_CHANNEL_RED == 0x1, "SPECAA_CHANNEL_ flag values don't match mask");
+        const size_t channel = (flags & 0xf) ? ((flags & 0xf) - 1) : 1;
+
+        for (size_t y = y0; y < y1; ++y)
+        {
+            XMVECTOR* ptr = scanline.get();
+            if (!_LoadScanline(ptr, width, srcImage.pixels + (srcImage.rowPitch * y), srcImage.rowPitch, srcImage.format))
+                return false;
+
+            const size_t ny0 = std::min((y * level.height) / srcImage.height, level.height - scaleY);
+
+            for (size_t x = 0; x < width; ++x)
+            {
+                const size_t nx0 = std::min((x * level.width) / width, level.width - scaleX);
+
+                XMVECTOR sum = XMVectorZero();
+                for (size_t j = 0; j < scaleY; ++j)
+                {
+                    const XMVECTOR* row = level.data + level.width * (ny0 + j) + nx0;
+                    for (size_t i = 0; i < scaleX; ++i)
+                    {
+                        sum = XMVectorAdd(sum, row[i]);
+                    }
+                }
+
+                // Toksvig variance of the footprint, (1 - |Na|) / |Na|
+                float length = XMVectorGetX(XMVector3Length(sum)) / float(scaleX * scaleY);
+                float variance = (length > 0.f) ? std::max(0.f, std::min((1.f - length) / length, 1.f)) : 1.f;
+                float kernel = std::min(2.f * variance, maxVariance);
+
+                float roughness = XMVectorGetByIndex(ptr[x], channel);
+                roughness = std::max(0.f, std::min(roughness, 1.f));
+
+                // alpha'^2 = alpha^2 + kernel
+                float alpha = (flags & SPECAA_LINEAR_ROUGHNESS) ? roughness : (roughness * roughness);
+                float alphaSq = std::min(alpha * alpha + kernel, 1.f);
+
+                roughness = (flags & SPECAA_LINEAR_ROUGHNESS) ? sqrtf(alphaSq) : sqrtf(sqrtf(alphaSq));
+
+                ptr[x] = XMVectorSetByIndex(ptr[x], roughness, channel);
+            }
+
+            if (!_StoreScanline(destImage.pixels + (destImage.rowPitch * y), destImage.rowPitch, destImage.format, ptr, width))
+                return false;
+        }
+
+        return true;
     }
 }
 
@@ -278,6 +913,9 @@ HRESULT DirectX::ComputeNormalMap(
         return E_INVALIDARG;
     }
 
+    if ((flags & CNMAP_SOBEL) && (flags & CNMAP_SCHARR))
+        return E_INVALIDARG;
+
     if (IsCompressed(format) || IsCompressed(srcImage.format)
         || IsTypeless(format) || IsTypeless(srcImage.format)
         || IsPlanar(format) || IsPlanar(srcImage.format)
@@ -342,6 +980,9 @@ HRESULT DirectX::ComputeNormalMap(
         return E_INVALIDARG;
     }
 
+    if ((flags & CNMAP_SOBEL) && (flags & CNMAP_SCHARR))
+        return E_INVALIDARG;
+
     normalMaps.Release();
 
     TexMetadata mdata2 = metadata;
@@ -390,3 +1031,258 @@ HRESULT DirectX::ComputeNormalMap(
 
     return S_OK;
 }
+
+
+//-------------------------------------------------------------------------------------
+// Generates a mipmap chain for a normal map, renormalizing each level
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::GenerateNormalMapMipMaps(
+    const Image& baseImage,
+    DWORD flags,
+    size_t levels,
+    ScratchImage& mipChain)
+{
+    if (!IsValid(baseImage.format))
+        return E_INVALIDARG;
+
+    if (!baseImage.pixels)
+        return E_POINTER;
+
+    if ((flags & NMAP_MIPS_VARIANCE_ALPHA) && (flags & NMAP_MIPS_VARIANCE_BLUE))
+        return E_INVALIDARG;
+
+    if (!_CalculateMipLevels(baseImage.width, baseImage.height, levels))
+        return E_INVALIDARG;
+
+    if (levels <= 1)
+        return E_INVALIDARG;
+
+    if (IsCompressed(baseImage.format) || IsTypeless(baseImage.format) || IsPlanar(baseImage.format) || IsPalettized(baseImage.format))
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    HRESULT hr = mipChain.Initialize2D(baseImage.format, baseImage.width, baseImage.height, 1, levels);
+    if (FAILED(hr))
+        return hr;
+
+    const Image* dest = mipChain.GetImage(0, 0, 0);
+    if (!dest)
+    {
+        mipChain.Release();
+        return E_POINTER;
+    }
+
+    hr = GenerateNMapMips(baseImage, flags, levels, dest);
+    if (FAILED(hr))
+    {
+        mipChain.Release();
+        return hr;
+    }
+
+    return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::GenerateNormalMapMipMaps(
+    const Image* srcImages,
+    size_t nimages,
+    const TexMetadata& metadata,
+    DWORD flags,
+    size_t levels,
+    ScratchImage& mipChain)
+{
+    if (!srcImages || !nimages || !IsValid(metadata.format))
+        return E_INVALIDARG;
+
+    if (metadata.IsVolumemap()
+        || IsCompressed(metadata.format) || IsTypeless(metadata.format) || IsPlanar(metadata.format) || IsPalettized(metadata.format))
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    if ((flags & NMAP_MIPS_VARIANCE_ALPHA) && (flags & NMAP_MIPS_VARIANCE_BLUE))
+        return E_INVALIDARG;
+
+    if (!_CalculateMipLevels(metadata.width, metadata.height, levels))
+        return E_INVALIDARG;
+
+    if (levels <= 1)
+        return E_INVALIDARG;
+
+    TexMetadata mdata2 = metadata;
+    mdata2.mipLevels = levels;
+    HRESULT hr = mipChain.Initialize(mdata2);
+    if (FAILED(hr))
+        return hr;
+
+    for (size_t item = 0; item < metadata.arraySize; ++item)
+    {
+        size_t index = metadata.ComputeIndex(0, item, 0);
+        if (index >= nimages)
+        {
+            mipChain.Release();
+            return E_FAIL;
+        }
+
+        const Image& src = srcImages[index];
+        if (!src.pixels)
+        {
+            mipChain.Release();
+            return E_POINTER;
+        }
+
+        if (src.format != metadata.format || src.width != metadata.width || src.height != metadata.height)
+        {
+            // All base images must be the same format, width, and height
+            mipChain.Release();
+            return E_FAIL;
+        }
+
+        // Levels of an item are contiguous in the image array
+        const Image* dest = mipChain.GetImage(0, item, 0);
+        if (!dest)
+        {
+            mipChain.Release();
+            return E_POINTER;
+        }
+
+        hr = GenerateNMapMips(src, flags, levels, dest);
+        if (FAILED(hr))
+        {
+            mipChain.Release();
+            return hr;
+        }
+    }
+
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Widens roughness by the normal variance under each texel (Toksvig specular AA)
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::ComputeSpecularAA(
+    const Image* srcImages,
+    size_t nimages,
+    const TexMetadata& metadata,
+    const Image* normalImages,
+    size_t nnormals,
+    const TexMetadata& normalMetadata,
+    DWORD flags,
+    float maxVariance,
+    ScratchImage& result)
+{
+    if (!srcImages || !nimages || !IsValid(metadata.format)
+        || !normalImages || !nnormals || !IsValid(normalMetadata.format))
+        return E_INVALIDARG;
+
+    if ((flags & 0xf) > SPECAA_CHANNEL_ALPHA || maxVariance < 0.f)
+        return E_INVALIDARG;
+
+    if (metadata.IsVolumemap() || normalMetadata.IsVolumemap()
+        || IsCompressed(metadata.format) || IsTypeless(metadata.format) || IsPlanar(metadata.format) || IsPalettized(metadata.format)
+        || IsCompressed(normalMetadata.format) || IsTypeless(normalMetadata.format) || IsPlanar(normalMetadata.format) || IsPalettized(normalMetadata.format))
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    // One normal map shared by all items, or one per item
+    const size_t npyramids = normalMetadata.arraySize;
+    if (npyramids != 1 && npyramids != metadata.arraySize)
+        return E_INVALIDARG;
+
+    HRESULT hr = result.Initialize(metadata);
+    if (FAILED(hr))
+        return hr;
+
+    if (nimages != result.GetImageCount())
+    {
+        result.Release();
+        return E_FAIL;
+    }
+
+    const Image* dest = result.GetImages();
+    if (!dest)
+    {
+        result.Release();
+        return E_POINTER;
+    }
+
+    for (size_t n = 0; n < npyramids; ++n)
+    {
+        size_t nindex = normalMetadata.ComputeIndex(0, n, 0);
+        if (nindex >= nnormals)
+        {
+            result.Release();
+            return E_FAIL;
+        }
+
+        if (!normalImages[nindex].pixels)
+        {
+            result.Release();
+            return E_POINTER;
+        }
+
+        NormalPyramid pyramid;
+        hr = pyramid.Initialize(normalImages[nindex]);
+        if (FAILED(hr))
+        {
+            result.Release();
+            return hr;
+        }
+
+        // Bands of every mip level using this normal map are processed together
+        const size_t firstItem = (npyramids > 1) ? n : 0;
+        const size_t lastItem = (npyramids > 1) ? (n + 1) : metadata.arraySize;
+
+        std::vector<SpecularAAWork> work;
+        for (size_t item = firstItem; item < lastItem; ++item)
+        {
+            for (size_t level = 0; level < metadata.mipLevels; ++level)
+            {
+                size_t index = metadata.ComputeIndex(level, item, 0);
+                if (index >= nimages)
+                {
+                    result.Release();
+                    return E_FAIL;
+                }
+
+                const Image& src = srcImages[index];
+                if (!src.pixels)
+                {
+                    result.Release();
+                    return E_POINTER;
+                }
+
+                if (src.format != metadata.format || src.width != dest[index].width || src.height != dest[index].height)
+                {
+                    result.Release();
+                    return E_FAIL;
+                }
+
+                for (size_t y = 0; y < src.height; y += NMAP_BAND_HEIGHT)
+                {
+                    SpecularAAWork band = { index, y, std::min(y + NMAP_BAND_HEIGHT, src.height) };
+                    work.push_back(band);
+                }
+            }
+        }
+
+        bool fail = false;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int i = 0; i < static_cast<int>(work.size()); ++i)
+        {
+            const SpecularAAWork& band = work[size_t(i)];
+            if (!ComputeSpecularAABand(srcImages[band.index], pyramid, flags, maxVariance, dest[band.index], band.y0, band.y1))
+                fail = true;
+        }
+
+        if (fail)
+        {
+            result.Release();
+            return E_FAIL;
+        }
+    }
+
+    return S_OK;
+}
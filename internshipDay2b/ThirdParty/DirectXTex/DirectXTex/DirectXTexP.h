@@ -259,11 +259,20 @@ namespace DirectX
         _Out_writes_bytes_(size) void* pDestination, _In_ size_t size, _In_ DXGI_FORMAT format,
         _Inout_updates_all_(count) XMVECTOR* pSource, _In_ size_t count, _In_ DWORD flags, _In_ float threshold = 0);
 
+    DWORD __cdecl _ScanlineSRGBFlags(_In_ DXGI_FORMAT format, _In_ DWORD flags);
+        // Returns the TEX_FILTER_SRGB* bits the Linear functions above apply for this format
+
     _Success_(return != false) bool __cdecl _StoreScanlineDither(
         _Out_writes_bytes_(size) void* pDestination, _In_ size_t size, _In_ DXGI_FORMAT format,
         _Inout_updates_all_(count) XMVECTOR* pSource, _In_ size_t count, _In_ float threshold, size_t y, size_t z,
         _Inout_updates_all_opt_(count + 2) XMVECTOR* pDiffusionErrors);
 
+    // Rounding bias and clamp range the store functions above apply for 8-bit and half formats;
+    // code that stores texels itself uses the same values so results stay identical
+    XMGLOBALCONST XMVECTORF32 g_8BitBias = { { { 0.5f / 255.f, 0.5f / 255.f, 0.5f / 255.f, 0.5f / 255.f } } };
+    XMGLOBALCONST XMVECTORF32 g_HalfMin = { { { -65504.f, -65504.f, -65504.f, -65504.f } } };
+    XMGLOBALCONST XMVECTORF32 g_HalfMax = { { { 65504.f, 65504.f, 65504.f, 65504.f } } };
+
     HRESULT __cdecl _ConvertToR32G32B32A32(_In_ const Image& srcImage, _Inout_ ScratchImage& image);
 
     HRESULT __cdecl _ConvertFromR32G32B32A32(_In_ const Image& srcImage, _In_ const Image& destImage);
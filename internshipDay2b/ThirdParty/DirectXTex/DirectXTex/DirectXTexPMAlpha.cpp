@@ -15,122 +15,134 @@ using namespace DirectX;
 
 namespace
 {
+    // Pixels converted per pass of the scanline path; the buffer lives on the stack and
+    // stays in L1, so no allocation is needed and source and destination may alias
+    const size_t c_PMAlphaChunk = 128;
+
     //---------------------------------------------------------------------------------
-    // NonPremultiplied alpha -> Premultiplied alpha
-    HRESULT PremultiplyAlpha_(const Image& srcImage, const Image& destImage)
+    // NonPremultiplied alpha <-> Premultiplied alpha for a single texel
+    template<bool reverse>
+    inline XMVECTOR XM_CALLCONV ScaleByAlpha(FXMVECTOR v)
     {
-        assert(srcImage.width == destImage.width);
-        assert(srcImage.height == destImage.height);
-
-        ScopedAlignedArrayXMVECTOR scanline(static_cast<XMVECTOR*>(_aligned_malloc((sizeof(XMVECTOR)*srcImage.width), 16)));
-        if (!scanline)
-            return E_OUTOFMEMORY;
+        XMVECTOR alpha = XMVectorSplatW(v);
+        alpha = (reverse) ? XMVectorDivide(v, alpha) : XMVectorMultiply(v, alpha);
+        return XMVectorSelect(v, alpha, g_XMSelect1110);
+    }
 
+    template<bool reverse, typename T, typename TLoad, typename TStore>
+    void ScaleRows(const Image& srcImage, const Image& destImage, TLoad load, TStore store)
+    {
         const uint8_t *pSrc = srcImage.pixels;
         uint8_t *pDest = destImage.pixels;
-        if (!pSrc || !pDest)
-            return E_POINTER;
 
         for (size_t h = 0; h < srcImage.height; ++h)
         {
-            if (!_LoadScanline(scanline.get(), srcImage.width, pSrc, srcImage.rowPitch, srcImage.format))
-                return E_FAIL;
-
-            XMVECTOR* ptr = scanline.get();
+            auto sPtr = reinterpret_cast<const T*>(pSrc);
+            auto dPtr = reinterpret_cast<T*>(pDest);
             for (size_t w = 0; w < srcImage.width; ++w)
             {
-                XMVECTOR v = *ptr;
-                XMVECTOR alpha = XMVectorSplatW(*ptr);
-                alpha = XMVectorMultiply(v, alpha);
-                *(ptr++) = XMVectorSelect(v, alpha, g_XMSelect1110);
+                store(dPtr++, ScaleByAlpha<reverse>(load(sPtr++)));
             }
 
-            if (!_StoreScanline(pDest, destImage.rowPitch, destImage.format, scanline.get(), srcImage.width))
-                return E_FAIL;
-
             pSrc += srcImage.rowPitch;
             pDest += destImage.rowPitch;
         }
-
-        return S_OK;
     }
 
-    HRESULT PremultiplyAlphaLinear(const Image& srcImage, DWORD flags, const Image& destImage)
+    //---------------------------------------------------------------------------------
+    // Works directly on the stored texels of the common four-channel formats. Loads and
+    // stores match _LoadScanline/_StoreScanline for these formats, so results are the
+    // same as the scanline path. The colour channels are scaled uniformly, so BGRA needs
+    // no swizzle.
+    template<bool reverse>
+    bool ScaleByAlphaDirect(const Image& srcImage, const Image& destImage)
     {
-        assert(srcImage.width == destImage.width);
-        assert(srcImage.height == destImage.height);
-
-        static_assert(static_cast<int>(TEX_PMALPHA_SRGB_IN) == static_cast<int>(TEX_FILTER_SRGB_IN), "TEX_PMALHPA_SRGB* should match TEX_FILTER_SRGB*");
-        static_assert(static_cast<int>(TEX_PMALPHA_SRGB_OUT) == static_cast<int>(TEX_FILTER_SRGB_OUT), "TEX_PMALHPA_SRGB* should match TEX_FILTER_SRGB*");
-        static_assert(static_cast<int>(TEX_PMALPHA_SRGB) == static_cast<int>(TEX_FILTER_SRGB), "TEX_PMALHPA_SRGB* should match TEX_FILTER_SRGB*");
-        flags &= TEX_PMALPHA_SRGB;
-
-        ScopedAlignedArrayXMVECTOR scanline(static_cast<XMVECTOR*>(_aligned_malloc((sizeof(XMVECTOR)*srcImage.width), 16)));
-        if (!scanline)
-            return E_OUTOFMEMORY;
-
-        const uint8_t *pSrc = srcImage.pixels;
-        uint8_t *pDest = destImage.pixels;
-        if (!pSrc || !pDest)
-            return E_POINTER;
+        using namespace DirectX::PackedVector;
 
-        for (size_t h = 0; h < srcImage.height; ++h)
+        switch (srcImage.format)
         {
-            if (!_LoadScanlineLinear(scanline.get(), srcImage.width, pSrc, srcImage.rowPitch, srcImage.format, flags))
-                return E_FAIL;
-
-            XMVECTOR* ptr = scanline.get();
-            for (size_t w = 0; w < srcImage.width; ++w)
-            {
-                XMVECTOR v = *ptr;
-                XMVECTOR alpha = XMVectorSplatW(*ptr);
-                alpha = XMVectorMultiply(v, alpha);
-                *(ptr++) = XMVectorSelect(v, alpha, g_XMSelect1110);
-            }
-
-            if (!_StoreScanlineLinear(pDest, destImage.rowPitch, destImage.format, scanline.get(), srcImage.width, flags))
-                return E_FAIL;
-
-            pSrc += srcImage.rowPitch;
-            pDest += destImage.rowPitch;
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+            ScaleRows<reverse, XMFLOAT4>(srcImage, destImage,
+                [](const XMFLOAT4* p) { return XMLoadFloat4(p); },
+                [](XMFLOAT4* p, FXMVECTOR v) { XMStoreFloat4(p, v); });
+            return true;
+
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            ScaleRows<reverse, XMHALF4>(srcImage, destImage,
+                [](const XMHALF4* p) { return XMLoadHalf4(p); },
+                [](XMHALF4* p, FXMVECTOR v) { XMStoreHalf4(p, XMVectorClamp(v, g_HalfMin, g_HalfMax)); });
+            return true;
+
+        case DXGI_FORMAT_R16G16B16A16_UNORM:
+            ScaleRows<reverse, XMUSHORTN4>(srcImage, destImage,
+                [](const XMUSHORTN4* p) { return XMLoadUShortN4(p); },
+                [](XMUSHORTN4* p, FXMVECTOR v) { XMStoreUShortN4(p, v); });
+            return true;
+
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+        case DXGI_FORMAT_B8G8R8A8_UNORM:
+        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+            ScaleRows<reverse, XMUBYTEN4>(srcImage, destImage,
+                [](const XMUBYTEN4* p) { return XMLoadUByteN4(p); },
+                [](XMUBYTEN4* p, FXMVECTOR v) { XMStoreUByteN4(p, XMVectorAdd(v, g_8BitBias)); });
+            return true;
+
+        default:
+            return false;
         }
-
-        return S_OK;
     }
 
     //---------------------------------------------------------------------------------
-    // Premultiplied alpha -> NonPremultiplied alpha (a.k.a. Straight alpha)
-    HRESULT DemultiplyAlpha(const Image& srcImage, const Image& destImage)
+    // Any other format goes through the float4 scanline conversion, a chunk at a time
+    template<bool reverse>
+    HRESULT ScaleByAlphaScanline(const Image& srcImage, DWORD flags, bool linear, const Image& destImage)
     {
-        assert(srcImage.width == destImage.width);
-        assert(srcImage.height == destImage.height);
+        size_t bpp = BitsPerPixel(srcImage.format);
+        if (bpp < 8)
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+        // Round to bytes
+        bpp = (bpp + 7) / 8;
 
-        ScopedAlignedArrayXMVECTOR scanline(static_cast<XMVECTOR*>(_aligned_malloc((sizeof(XMVECTOR)*srcImage.width), 16)));
-        if (!scanline)
-            return E_OUTOFMEMORY;
+        XMVECTOR scanline[c_PMAlphaChunk];
 
         const uint8_t *pSrc = srcImage.pixels;
         uint8_t *pDest = destImage.pixels;
-        if (!pSrc || !pDest)
-            return E_POINTER;
 
         for (size_t h = 0; h < srcImage.height; ++h)
         {
-            if (!_LoadScanline(scanline.get(), srcImage.width, pSrc, srcImage.rowPitch, srcImage.format))
-                return E_FAIL;
-
-            XMVECTOR* ptr = scanline.get();
-            for (size_t w = 0; w < srcImage.width; ++w)
+            for (size_t x = 0; x < srcImage.width; x += c_PMAlphaChunk)
             {
-                XMVECTOR v = *ptr;
-                XMVECTOR alpha = XMVectorSplatW(*ptr);
-                alpha = XMVectorDivide(v, alpha);
-                *(ptr++) = XMVectorSelect(v, alpha, g_XMSelect1110);
+                const size_t count = std::min<size_t>(c_PMAlphaChunk, srcImage.width - x);
+                const size_t bytes = count * bpp;
+
+                if (linear)
+                {
+                    if (!_LoadScanlineLinear(scanline, count, pSrc + x * bpp, bytes, srcImage.format, flags))
+                        return E_FAIL;
+                }
+                else if (!_LoadScanline(scanline, count, pSrc + x * bpp, bytes, srcImage.format))
+                {
+                    return E_FAIL;
+                }
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    scanline[i] = ScaleByAlpha<reverse>(scanline[i]);
+                }
+
+                if (linear)
+                {
+                    if (!_StoreScanlineLinear(pDest + x * bpp, bytes, destImage.format, scanline, count, flags))
+                        return E_FAIL;
+                }
+                else if (!_StoreScanline(pDest + x * bpp, bytes, destImage.format, scanline, count))
+                {
+                    return E_FAIL;
+                }
             }
 
-            if (!_StoreScanline(pDest, destImage.rowPitch, destImage.format, scanline.get(), srcImage.width))
-                return E_FAIL;
-
             pSrc += srcImage.rowPitch;
             pDest += destImage.rowPitch;
         }
@@ -138,47 +150,47 @@ namespace
         return S_OK;
     }
 
-    HRESULT DemultiplyAlphaLinear(const Image& srcImage, DWORD flags, const Image& destImage)
+    //---------------------------------------------------------------------------------
+    // Converts srcImage into destImage, which may be the same memory
+    HRESULT PremultiplyAlphaImage(const Image& srcImage, DWORD flags, const Image& destImage)
     {
         assert(srcImage.width == destImage.width);
         assert(srcImage.height == destImage.height);
+        assert(srcImage.format == destImage.format);
+
+        if (!srcImage.pixels || !destImage.pixels)
+            return E_POINTER;
 
         static_assert(static_cast<int>(TEX_PMALPHA_SRGB_IN) == static_cast<int>(TEX_FILTER_SRGB_IN), "TEX_PMALHPA_SRGB* should match TEX_FILTER_SRGB*");
         static_assert(static_cast<int>(TEX_PMALPHA_SRGB_OUT) == static_cast<int>(TEX_FILTER_SRGB_OUT), "TEX_PMALHPA_SRGB* should match TEX_FILTER_SRGB*");
         static_assert(static_cast<int>(TEX_PMALPHA_SRGB) == static_cast<int>(TEX_FILTER_SRGB), "TEX_PMALHPA_SRGB* should match TEX_FILTER_SRGB*");
-        flags &= TEX_PMALPHA_SRGB;
 
-        ScopedAlignedArrayXMVECTOR scanline(static_cast<XMVECTOR*>(_aligned_malloc((sizeof(XMVECTOR)*srcImage.width), 16)));
-        if (!scanline)
-            return E_OUTOFMEMORY;
+        const bool reverse = (flags & TEX_PMALPHA_REVERSE) != 0;
 
-        const uint8_t *pSrc = srcImage.pixels;
-        uint8_t *pDest = destImage.pixels;
-        if (!pSrc || !pDest)
-            return E_POINTER;
+        // The linear path only differs from the direct one when sRGB conversion applies
+        const bool linear = !(flags & TEX_PMALPHA_IGNORE_SRGB)
+            && (IsSRGB(srcImage.format) || (flags & TEX_PMALPHA_SRGB));
 
-        for (size_t h = 0; h < srcImage.height; ++h)
+        if (!linear)
         {
-            if (!_LoadScanlineLinear(scanline.get(), srcImage.width, pSrc, srcImage.rowPitch, srcImage.format, flags))
-                return E_FAIL;
-
-            XMVECTOR* ptr = scanline.get();
-            for (size_t w = 0; w < srcImage.width; ++w)
-            {
-                XMVECTOR v = *ptr;
-                XMVECTOR alpha = XMVectorSplatW(*ptr);
-                alpha = XMVectorDivide(v, alpha);
-                *(ptr++) = XMVectorSelect(v, alpha, g_XMSelect1110);
-            }
+            if ((reverse) ? ScaleByAlphaDirect<true>(srcImage, destImage) : ScaleByAlphaDirect<false>(srcImage, destImage))
+                return S_OK;
+        }
 
-            if (!_StoreScanlineLinear(pDest, destImage.rowPitch, destImage.format, scanline.get(), srcImage.width, flags))
-                return E_FAIL;
+        flags &= TEX_PMALPHA_SRGB;
 
-            pSrc += srcImage.rowPitch;
-            pDest += destImage.rowPitch;
-        }
+        return (reverse)
+            ? ScaleByAlphaScanline<true>(srcImage, flags, linear, destImage)
+            : ScaleByAlphaScanline<false>(srcImage, flags, linear, destImage);
+    }
 
-        return S_OK;
+    bool IsPMAlphaSupported(DXGI_FORMAT format)
+    {
+        return !(IsCompressed(format)
+            || IsPlanar(format)
+            || IsPalettized(format)
+            || IsTypeless(format)
+            || !HasAlpha(format));
     }
 }
 
@@ -199,11 +211,7 @@ HRESULT DirectX::PremultiplyAlpha(
     if (!srcImage.pixels)
         return E_POINTER;
 
-    if (IsCompressed(srcImage.format)
-        || IsPlanar(srcImage.format)
-        || IsPalettized(srcImage.format)
-        || IsTypeless(srcImage.format)
-        || !HasAlpha(srcImage.format))
+    if (!IsPMAlphaSupported(srcImage.format))
         return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
 
     if ((srcImage.width > UINT32_MAX) || (srcImage.height > UINT32_MAX))
@@ -220,14 +228,7 @@ HRESULT DirectX::PremultiplyAlpha(
         return E_POINTER;
     }
 
-    if (flags & TEX_PMALPHA_REVERSE)
-    {
-        hr = (flags & TEX_PMALPHA_IGNORE_SRGB) ? DemultiplyAlpha(srcImage, *rimage) : DemultiplyAlphaLinear(srcImage, flags, *rimage);
-    }
-    else
-    {
-        hr = (flags & TEX_PMALPHA_IGNORE_SRGB) ? PremultiplyAlpha_(srcImage, *rimage) : PremultiplyAlphaLinear(srcImage, flags, *rimage);
-    }
+    hr = PremultiplyAlphaImage(srcImage, flags, *rimage);
     if (FAILED(hr))
     {
         image.Release();
@@ -238,6 +239,46 @@ HRESULT DirectX::PremultiplyAlpha(
 }
 
 
+//-------------------------------------------------------------------------------------
+// Converts to/from a premultiplied alpha version of the texture into an existing image
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::PremultiplyAlpha(
+    const Image& srcImage,
+    DWORD flags,
+    const Image& destImage)
+{
+    if (!srcImage.pixels || !destImage.pixels)
+        return E_POINTER;
+
+    if (!IsPMAlphaSupported(srcImage.format))
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    if (srcImage.format != destImage.format
+        || srcImage.width != destImage.width
+        || srcImage.height != destImage.height)
+        return E_INVALIDARG;
+
+    if ((srcImage.width > UINT32_MAX) || (srcImage.height > UINT32_MAX))
+        return E_INVALIDARG;
+
+    // In-place use requires the two images to describe the same texels, not overlap partially
+    if (srcImage.pixels != destImage.pixels)
+    {
+        const uint8_t* srcEnd = srcImage.pixels + srcImage.rowPitch * srcImage.height;
+        const uint8_t* destEnd = destImage.pixels + destImage.rowPitch * destImage.height;
+        if (srcImage.pixels < destEnd && destImage.pixels < srcEnd)
+            return E_INVALIDARG;
+    }
+    else if (srcImage.rowPitch != destImage.rowPitch)
+    {
+        return E_INVALIDARG;
+    }
+
+    return PremultiplyAlphaImage(srcImage, flags, destImage);
+}
+
+
 //-------------------------------------------------------------------------------------
 // Converts to/from a premultiplied alpha version of the texture (complex)
 //-------------------------------------------------------------------------------------
@@ -252,11 +293,7 @@ HRESULT DirectX::PremultiplyAlpha(
     if (!srcImages || !nimages)
         return E_INVALIDARG;
 
-    if (IsCompressed(metadata.format)
-        || IsPlanar(metadata.format)
-        || IsPalettized(metadata.format)
-        || IsTypeless(metadata.format)
-        || !HasAlpha(metadata.format))
+    if (!IsPMAlphaSupported(metadata.format))
         return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
 
     if ((metadata.width > UINT32_MAX) || (metadata.height > UINT32_MAX))
@@ -305,14 +342,7 @@ HRESULT DirectX::PremultiplyAlpha(
             return E_FAIL;
         }
 
-        if (flags & TEX_PMALPHA_REVERSE)
-        {
-            hr = (flags & TEX_PMALPHA_IGNORE_SRGB) ? DemultiplyAlpha(src, dst) : DemultiplyAlphaLinear(src, flags, dst);
-        }
-        else
-        {
-            hr = (flags & TEX_PMALPHA_IGNORE_SRGB) ? PremultiplyAlpha_(src, dst) : PremultiplyAlphaLinear(src, flags, dst);
-        }
+        hr = PremultiplyAlphaImage(src, flags, dst);
         if (FAILED(hr))
         {
             result.Release();
@@ -0,0 +1,685 @@
+//-------------------------------------------------------------------------------------
+// DirectXTexPipeline.cpp
+//
+// DirectX Texture Library - Fused image operation pipeline
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248926
+//-------------------------------------------------------------------------------------
+
+#include "DirectXTexp.h"
+
+#include "filters.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#pragma warning(disable : 4616 6993)
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+    // Output rows per band when running in parallel; each band refills its own row caches
+    const size_t PIPELINE_BAND_HEIGHT = 32;
+
+    typedef std::function<void __cdecl(XMVECTOR* outPixels, const XMVECTOR* inPixels, size_t width, size_t y)> PixelFunc;
+
+    enum POINT_OP
+    {
+        POINT_CONVERT,
+        POINT_PMALPHA,
+        POINT_TRANSFORM,
+    };
+
+    // An operation applied to each pixel of a row independently
+    struct PointOp
+    {
+        POINT_OP            op;
+        DXGI_FORMAT         inFormat;
+        DXGI_FORMAT         outFormat;
+        DWORD               flags;
+        const PixelFunc*    pixelFunc;
+    };
+
+    // A stage produces rows of width x height. Stage 0 loads them from the source image and
+    // each later stage resamples the rows of the stage before it; both then apply their own
+    // point operations.
+    struct Stage
+    {
+        size_t      width;
+        size_t      height;
+        size_t      firstOp;
+        size_t      opCount;
+
+        DWORD       filter;     // TEX_FILTER_POINT, TEX_FILTER_LINEAR, or TEX_FILTER_CUBIC
+        DWORD       srgb;       // TEX_FILTER_SRGB_IN/OUT applied around the filter
+        size_t      taps;       // Source rows used per output row
+
+        std::unique_ptr<LinearFilter[]> lf;
+        std::unique_ptr<CubicFilter[]>  cf;
+
+        Stage() noexcept : width(0), height(0), firstOp(0), opCount(0), filter(0), srgb(0), taps(0) {}
+        Stage(Stage&& moveFrom) noexcept :
+            width(moveFrom.width), height(moveFrom.height), firstOp(moveFrom.firstOp), opCount(moveFrom.opCount),
+            filter(moveFrom.filter), srgb(moveFrom.srgb), taps(moveFrom.taps),
+            lf(std::move(moveFrom.lf)), cf(std::move(moveFrom.cf)) {}
+
+        Stage(const Stage&) = delete;
+        Stage& operator=(const Stage&) = delete;
+    };
+
+    //-------------------------------------------------------------------------------------
+    // Point operations
+    //-------------------------------------------------------------------------------------
+    void ToLinear(_Inout_updates_all_(count) XMVECTOR* row, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i, ++row)
+        {
+            *row = XMColorSRGBToRGB(*row);
+        }
+    }
+
+    void ToSRGB(_Inout_updates_all_(count) XMVECTOR* row, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i, ++row)
+        {
+            *row = XMColorRGBToSRGB(*row);
+        }
+    }
+
+    // Matches PremultiplyAlpha, minus the quantization to the current format
+    void PremultiplyRow(_Inout_updates_all_(count) XMVECTOR* row, size_t count, DXGI_FORMAT format, DWORD flags)
+    {
+        const DWORD srgb = (flags & TEX_PMALPHA_IGNORE_SRGB) ? 0 : _ScanlineSRGBFlags(format, flags & TEX_PMALPHA_SRGB);
+
+        if (srgb & TEX_FILTER_SRGB_IN)
+            ToLinear(row, count);
+
+        XMVECTOR* ptr = row;
+        if (flags & TEX_PMALPHA_REVERSE)
+        {
+            for (size_t i = 0; i < count; ++i, ++ptr)
+            {
+                XMVECTOR v = *ptr;
+                XMVECTOR alpha = XMVectorSplatW(v);
+                alpha = XMVectorDivide(v, alpha);
+                *ptr = XMVectorSelect(v, alpha, g_XMSelect1110);
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < count; ++i, ++ptr)
+            {
+                XMVECTOR v = *ptr;
+                XMVECTOR alpha = XMVectorSplatW(v);
+                alpha = XMVectorMultiply(v, alpha);
+                *ptr = XMVectorSelect(v, alpha, g_XMSelect1110);
+            }
+        }
+
+        if (srgb & TEX_FILTER_SRGB_OUT)
+            ToSRGB(row, count);
+    }
+
+    //-------------------------------------------------------------------------------------
+    // Working state for one band of output rows
+    //
+    // Rows are pulled from the last stage. A resampling stage keeps its last few source
+    // rows, already filtered horizontally, so each row of every stage is computed once as
+    // long as rows are requested in order.
+    //-------------------------------------------------------------------------------------
+    class PipelineBand
+    {
+    public:
+        PipelineBand(const Image& srcImage, const std::vector<Stage>& stages, const std::vector<PointOp>& ops) noexcept :
+            m_src(srcImage), m_stages(stages), m_ops(ops) {}
+
+        PipelineBand(const PipelineBand&) = delete;
+        PipelineBand& operator=(const PipelineBand&) = delete;
+
+        HRESULT Run(const Image& destImage, size_t y0, size_t y1, float threshold)
+        {
+            const size_t nstages = m_stages.size();
+            const Stage& last = m_stages[nstages - 1];
+
+            // One allocation holds every stage's rows plus the output row
+            size_t total = last.width;
+            for (size_t s = 0; s < nstages; ++s)
+            {
+                const Stage& stage = m_stages[s];
+                total += stage.width * (stage.taps + 1);
+                if (s > 0)
+                    total += m_stages[s - 1].width;
+            }
+
+            m_scanline.reset(static_cast<XMVECTOR*>(_aligned_malloc(sizeof(XMVECTOR) * total, 16)));
+            if (!m_scanline)
+                return E_OUTOFMEMORY;
+
+            m_rows.reset(new (std::nothrow) StageRows[nstages]);
+            if (!m_rows)
+                return E_OUTOFMEMORY;
+
+            XMVECTOR* ptr = m_scanline.get();
+            for (size_t s = 0; s < nstages; ++s)
+            {
+                const Stage& stage = m_stages[s];
+                auto& rows = m_rows[s];
+
+                rows.temp = ptr;
+                ptr += stage.width;
+
+                rows.cache = ptr;
+                ptr += stage.width * stage.taps;
+
+                if (s > 0)
+                {
+                    rows.input = ptr;
+                    ptr += m_stages[s - 1].width;
+                }
+
+                for (size_t i = 0; i < _countof(rows.tags); ++i)
+                {
+                    rows.tags[i] = size_t(-1);
+                }
+            }
+
+            XMVECTOR* target = ptr;
+
+            uint8_t* pDest = destImage.pixels + destImage.rowPitch * y0;
+            for (size_t y = y0; y < y1; ++y)
+            {
+                if (!GetRow(nstages - 1, y, target))
+                    return E_FAIL;
+
+                if (!_StoreScanline(pDest, destImage.rowPitch, destImage.format, target, destImage.width, threshold))
+                    return E_FAIL;
+
+                pDest += destImage.rowPitch;
+            }
+
+            return S_OK;
+        }
+
+    private:
+        struct StageRows
+        {
+            XMVECTOR*   input;      // One row of the previous stage
+            XMVECTOR*   temp;       // Output of Transform operations
+            XMVECTOR*   cache;      // 'taps' horizontally filtered source rows
+            size_t      tags[4];    // Source row held by each cache entry
+
+            StageRows() noexcept : input(nullptr), temp(nullptr), cache(nullptr), tags{} {}
+        };
+
+        const Image&                    m_src;
+        const std::vector<Stage>&       m_stages;
+        const std::vector<PointOp>&     m_ops;
+        ScopedAlignedArrayXMVECTOR      m_scanline;
+        std::unique_ptr<StageRows[]>    m_rows;
+
+        bool GetRow(size_t s, size_t y, _Out_writes_(m_stages[s].width) XMVECTOR* row)
+        {
+            const Stage& stage = m_stages[s];
+
+            if (!s)
+            {
+                if (!_LoadScanline(row, stage.width, m_src.pixels + m_src.rowPitch * y, m_src.rowPitch, m_src.format))
+                    return false;
+            }
+            else if (!Resample(s, y, row))
+            {
+                return false;
+            }
+
+            return ApplyPointOps(s, y, row);
+        }
+
+        bool Resample(size_t s, size_t y, _Out_writes_(m_stages[s].width) XMVECTOR* row)
+        {
+            const Stage& stage = m_stages[s];
+            const size_t width = stage.width;
+
+            switch (stage.filter)
+            {
+            case TEX_FILTER_POINT:
+                {
+                    const size_t yinc = (m_stages[s - 1].height << 16) / stage.height;
+                    const size_t sy = (y * yinc) >> 16;
+
+                    const XMVECTOR* r0 = CachedRow(s, sy, &sy, 1);
+                    if (!r0)
+                        return false;
+
+                    memcpy_s(row, sizeof(XMVECTOR) * width, r0, sizeof(XMVECTOR) * width);
+                }
+                break;
+
+            case TEX_FILTER_LINEAR:
+                {
+                    auto& toY = stage.lf[width + y];
+                    const size_t needed[2] = { toY.u0, toY.u1 };
+
+                    const XMVECTOR* r0 = CachedRow(s, toY.u0, needed, 2);
+                    const XMVECTOR* r1 = (r0) ? CachedRow(s, toY.u1, needed, 2) : nullptr;
+                    if (!r1)
+                        return false;
+
+                    for (size_t x = 0; x < width; ++x)
+                    {
+                        row[x] = XMVectorAdd(XMVectorScale(r0[x], toY.weight0), XMVectorScale(r1[x], toY.weight1));
+                    }
+                }
+                break;
+
+            case TEX_FILTER_CUBIC:
+                {
+                    auto& toY = stage.cf[width + y];
+                    const size_t needed[4] = { toY.u0, toY.u1, toY.u2, toY.u3 };
+
+                    const XMVECTOR* r[4] = {};
+                    for (size_t i = 0; i < 4; ++i)
+                    {
+                        r[i] = CachedRow(s, needed[i], needed, 4);
+                        if (!r[i])
+                            return false;
+                    }
+
+                    for (size_t x = 0; x < width; ++x)
+                    {
+                        CUBIC_INTERPOLATE(row[x], toY.x, r[0][x], r[1][x], r[2][x], r[3][x]);
+                    }
+                }
+                break;
+
+            default:
+                return false;
+            }
+
+            if (stage.srgb & TEX_FILTER_SRGB_OUT)
+                ToSRGB(row, width);
+
+            return true;
+        }
+
+        // Returns source row 'sy' of stage 's' filtered horizontally, computing it if it isn't
+        // cached. Entries holding any of the 'needed' rows are never evicted.
+        const XMVECTOR* CachedRow(size_t s, size_t sy, _In_reads_(count) const size_t* needed, size_t count)
+        {
+            const Stage& stage = m_stages[s];
+            auto& rows = m_rows[s];
+
+            size_t slot = size_t(-1);
+            for (size_t i = 0; i < stage.taps; ++i)
+            {
+                if (rows.tags[i] == sy)
+                    return rows.cache + stage.width * i;
+
+                if (slot == size_t(-1))
+                {
+                    bool inUse = false;
+                    for (size_t j = 0; j < count; ++j)
+                    {
+                        if (rows.tags[i] == needed[j])
+                            inUse = true;
+                    }
+
+                    if (!inUse)
+                        slot = i;
+                }
+            }
+
+            assert(slot != size_t(-1));
+            if (slot == size_t(-1))
+                return nullptr;
+
+            const size_t srcWidth = m_stages[s - 1].width;
+            const XMVECTOR* src = rows.input;
+
+            if (!GetRow(s - 1, sy, rows.input))
+                return nullptr;
+
+            if (stage.srgb & TEX_FILTER_SRGB_IN)
+                ToLinear(rows.input, srcWidth);
+
+            XMVECTOR* dest = rows.cache + stage.width * slot;
+
+            switch (stage.filter)
+            {
+            case TEX_FILTER_POINT:
+                {
+                    const size_t xinc = (srcWidth << 16) / stage.width;
+                    size_t sx = 0;
+                    for (size_t x = 0; x < stage.width; ++x)
+                    {
+                        dest[x] = src[sx >> 16];
+                        sx += xinc;
+                    }
+                }
+                break;
+
+            case TEX_FILTER_LINEAR:
+                for (size_t x = 0; x < stage.width; ++x)
+                {
+                    auto& toX = stage.lf[x];
+                    dest[x] = XMVectorAdd(XMVectorScale(src[toX.u0], toX.weight0), XMVectorScale(src[toX.u1], toX.weight1));
+                }
+                break;
+
+            case TEX_FILTER_CUBIC:
+                for (size_t x = 0; x < stage.width; ++x)
+                {
+                    auto& toX = stage.cf[x];
+                    CUBIC_INTERPOLATE(dest[x], toX.x, src[toX.u0], src[toX.u1], src[toX.u2], src[toX.u3]);
+                }
+                break;
+
+            default:
+                return nullptr;
+            }
+
+            rows.tags[slot] = sy;
+            return dest;
+        }
+
+        bool ApplyPointOps(size_t s, size_t y, _Inout_updates_all_(m_stages[s].width) XMVECTOR* row)
+        {
+            const Stage& stage = m_stages[s];
+            const size_t width = stage.width;
+
+            XMVECTOR* current = row;
+            XMVECTOR* other = m_rows[s].temp;
+
+            for (size_t index = stage.firstOp; index < stage.firstOp + stage.opCount; ++index)
+            {
+                const PointOp& op = m_ops[index];
+                switch (op.op)
+                {
+                case POINT_CONVERT:
+                    _ConvertScanline(current, width, op.outFormat, op.inFormat, op.flags);
+                    break;
+
+                case POINT_PMALPHA:
+                    PremultiplyRow(current, width, op.inFormat, op.flags);
+                    break;
+
+                case POINT_TRANSFORM:
+                    (*op.pixelFunc)(other, current, width, y);
+                    std::swap(current, other);
+                    break;
+
+                default:
+                    return false;
+                }
+            }
+
+            if (current != row)
+            {
+                memcpy_s(row, sizeof(XMVECTOR) * width, current, sizeof(XMVECTOR) * width);
+            }
+
+            return true;
+        }
+    };
+
+    //-------------------------------------------------------------------------------------
+    // Sets up a resampling stage, using the same filter choices as the custom Resize filters
+    HRESULT InitializeResize(Stage& stage, const Stage& prev, DXGI_FORMAT format, DWORD filter)
+    {
+        static_assert(TEX_FILTER_POINT == 0x100000, "TEX_FILTER_ flag values don't match TEX_FILTER_MASK");
+
+        DWORD filter_select = (filter & TEX_FILTER_MASK);
+        if (!filter_select)
+        {
+            // Default filter choice
+            filter_select = (((stage.width << 1) == prev.width) && ((stage.height << 1) == prev.height))
+                ? TEX_FILTER_BOX : TEX_FILTER_LINEAR;
+        }
+
+        switch (filter_select)
+        {
+        case TEX_FILTER_POINT:
+            stage.filter = TEX_FILTER_POINT;
+            stage.taps = 1;
+            return S_OK;
+
+        case TEX_FILTER_BOX:
+            if (((stage.width << 1) != prev.width) || ((stage.height << 1) != prev.height))
+                return E_FAIL;
+
+            // An exact 2:1 linear filter weights each pair of source pixels by 1/2, which is the box filter
+            // fall through
+
+        case TEX_FILTER_LINEAR:
+            stage.lf.reset(new (std::nothrow) LinearFilter[stage.width + stage.height]);
+            if (!stage.lf)
+                return E_OUTOFMEMORY;
+
+            _CreateLinearFilter(prev.width, stage.width, (filter & TEX_FILTER_WRAP_U) != 0, stage.lf.get());
+            _CreateLinearFilter(prev.height, stage.height, (filter & TEX_FILTER_WRAP_V) != 0, stage.lf.get() + stage.width);
+
+            stage.filter = TEX_FILTER_LINEAR;
+            stage.taps = 2;
+            break;
+
+        case TEX_FILTER_CUBIC:
+            stage.cf.reset(new (std::nothrow) CubicFilter[stage.width + stage.height]);
+            if (!stage.cf)
+                return E_OUTOFMEMORY;
+
+            _CreateCubicFilter(prev.width, stage.width, (filter & TEX_FILTER_WRAP_U) != 0, (filter & TEX_FILTER_MIRROR_U) != 0, stage.cf.get());
+            _CreateCubicFilter(prev.height, stage.height, (filter & TEX_FILTER_WRAP_V) != 0, (filter & TEX_FILTER_MIRROR_V) != 0, stage.cf.get() + stage.width);
+
+            stage.filter = TEX_FILTER_CUBIC;
+            stage.taps = 4;
+            break;
+
+        default:
+            // Triangle filtering accumulates over the whole image and isn't streamed
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        stage.srgb = _ScanlineSRGBFlags(format, filter);
+        return S_OK;
+    }
+}
+
+
+//=====================================================================================
+// ImagePipeline
+//=====================================================================================
+
+_Use_decl_annotations_
+ImagePipeline& ImagePipeline::Convert(DXGI_FORMAT format, DWORD filter, float threshold)
+{
+    Operation op = {};
+    op.type = OP_CONVERT;
+    op.format = format;
+    op.flags = filter;
+    op.threshold = threshold;
+    m_ops.emplace_back(std::move(op));
+    return *this;
+}
+
+_Use_decl_annotations_
+ImagePipeline& ImagePipeline::Resize(size_t width, size_t height, DWORD filter)
+{
+    Operation op = {};
+    op.type = OP_RESIZE;
+    op.flags = filter;
+    op.width = width;
+    op.height = height;
+    m_ops.emplace_back(std::move(op));
+    return *this;
+}
+
+_Use_decl_annotations_
+ImagePipeline& ImagePipeline::PremultiplyAlpha(DWORD flags)
+{
+    Operation op = {};
+    op.type = OP_PMALPHA;
+    op.flags = flags;
+    m_ops.emplace_back(std::move(op));
+    return *this;
+}
+
+_Use_decl_annotations_
+ImagePipeline& ImagePipeline::Transform(
+    std::function<void __cdecl(_Out_writes_(width) XMVECTOR* outPixels, _In_reads_(width) const XMVECTOR* inPixels, size_t width, size_t y)> pixelFunc)
+{
+    Operation op = {};
+    op.type = OP_TRANSFORM;
+    op.pixelFunc = pixelFunc;
+    m_ops.emplace_back(std::move(op));
+    return *this;
+}
+
+
+//-------------------------------------------------------------------------------------
+// Validates the recorded operations and runs them as one pass over the source
+//-------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT ImagePipeline::Execute(const Image& srcImage, DWORD flags, ScratchImage& result) const
+{
+    if (!srcImage.pixels)
+        return E_POINTER;
+
+    if (!srcImage.width || !srcImage.height
+        || (srcImage.width > UINT32_MAX) || (srcImage.height > UINT32_MAX))
+        return E_INVALIDARG;
+
+    if (IsPlanar(srcImage.format) || IsPalettized(srcImage.format) || IsCompressed(srcImage.format) || IsTypeless(srcImage.format))
+        return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+    std::vector<Stage> stages;
+    std::vector<PointOp> ops;
+    stages.reserve(1);
+    ops.reserve(m_ops.size());
+
+    Stage first;
+    first.width = srcImage.width;
+    first.height = srcImage.height;
+    stages.emplace_back(std::move(first));
+
+    DXGI_FORMAT format = srcImage.format;
+    float threshold = 0.f;
+
+    for (auto it = m_ops.cbegin(); it != m_ops.cend(); ++it)
+    {
+        PointOp pop = {};
+        pop.inFormat = format;
+        pop.outFormat = format;
+        pop.flags = it->flags;
+
+        switch (it->type)
+        {
+        case OP_CONVERT:
+            if (!IsValid(it->format))
+                return E_INVALIDARG;
+
+            if (IsPlanar(it->format) || IsPalettized(it->format) || IsCompressed(it->format) || IsTypeless(it->format))
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+            if (it->flags & (TEX_FILTER_DITHER | TEX_FILTER_DITHER_DIFFUSION))
+            {
+                // Dithering depends on quantizing each intermediate, which the fused pipeline skips
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            }
+
+            pop.op = POINT_CONVERT;
+            pop.outFormat = it->format;
+            format = it->format;
+            threshold = it->threshold;
+            break;
+
+        case OP_PMALPHA:
+            if (!HasAlpha(format))
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+            pop.op = POINT_PMALPHA;
+            break;
+
+        case OP_TRANSFORM:
+            if (!it->pixelFunc)
+                return E_INVALIDARG;
+
+            pop.op = POINT_TRANSFORM;
+            pop.pixelFunc = &it->pixelFunc;
+            break;
+
+        case OP_RESIZE:
+            {
+                if (!it->width || !it->height
+                    || (it->width > UINT32_MAX) || (it->height > UINT32_MAX))
+                    return E_INVALIDARG;
+
+                Stage stage;
+                stage.width = it->width;
+                stage.height = it->height;
+                stage.firstOp = ops.size();
+
+                HRESULT hr = InitializeResize(stage, stages.back(), format, it->flags);
+                if (FAILED(hr))
+                    return hr;
+
+                stages.emplace_back(std::move(stage));
+            }
+            continue;
+
+        default:
+            return E_UNEXPECTED;
+        }
+
+        ops.push_back(pop);
+        stages.back().opCount++;
+    }
+
+    const Stage& last = stages.back();
+
+    HRESULT hr = result.Initialize2D(format, last.width, last.height, 1, 1);
+    if (FAILED(hr))
+        return hr;
+
+    const Image* dest = result.GetImage(0, 0, 0);
+    if (!dest)
+    {
+        result.Release();
+        return E_POINTER;
+    }
+
+    // Run as a single band unless asked to go parallel, so no row is ever computed twice
+    const size_t bandHeight = (flags & TEX_PIPELINE_PARALLEL) ? PIPELINE_BAND_HEIGHT : last.height;
+    const size_t nbands = (last.height + bandHeight - 1) / bandHeight;
+
+    bool fail = false;
+    bool outOfMemory = false;
+
+#ifdef _OPENMP
+#pragma omp parallel for if (nbands >= 4)
+#endif
+    for (int band = 0; band < static_cast<int>(nbands); ++band)
+    {
+        const size_t y0 = size_t(band) * bandHeight;
+        const size_t y1 = std::min(y0 + bandHeight, last.height);
+
+        PipelineBand work(srcImage, stages, ops);
+        HRESULT hrBand = work.Run(*dest, y0, y1, threshold);
+        if (FAILED(hrBand))
+        {
+            if (hrBand == E_OUTOFMEMORY)
+                outOfMemory = true;
+            fail = true;
+        }
+    }
+
+    if (fail)
+    {
+        result.Release();
+        return (outOfMemory) ? E_OUTOFMEMORY : E_FAIL;
+    }
+
+    return S_OK;
+}
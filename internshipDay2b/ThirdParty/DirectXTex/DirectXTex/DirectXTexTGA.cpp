@@ -16,7 +16,7 @@
 //      * Does not support files that contain color maps (these are rare in practice)
 //      * Interleaved files are not supported (deprecated aspect of TGA format)
 //      * Only supports 8-bit grayscale; 16-, 24-, and 32-bit truecolor images
-//      * Always writes uncompressed files (i.e. can read RLE compression, but does not write it)
+//      * Writes uncompressed files unless TGA_FLAGS_RLE is specified
 //
 
 using namespace DirectX;
@@ -250,325 +250,197 @@ namespace
 
 
     //-------------------------------------------------------------------------------------
-    // Uncompress pixel data from a TGA into the target image
+    // Per-depth pixel readers used by the TGA decoders
+    //
+    // Read converts a single TGA pixel, ReadRow converts a contiguous run of them; both
+    // OR the alpha bits seen into 'alpha' so callers can detect all-zero alpha channels
     //-------------------------------------------------------------------------------------
-    HRESULT UncompressPixels(
-        _In_reads_bytes_(size) const void* pSource,
-        size_t size,
-        _In_ const Image* image,
-        _In_ DWORD convFlags)
+    struct TGAPixel8
     {
-        assert(pSource && size > 0);
-
-        if (!image || !image->pixels)
-            return E_POINTER;
+        typedef uint8_t pixel_t;
+        static const size_t bytes = 1;
 
-        // Compute TGA image data pitch
-        size_t rowPitch;
-        if (convFlags & CONV_FLAGS_EXPAND)
+        static pixel_t Read(_In_reads_bytes_(1) const uint8_t* sPtr, uint32_t&)
         {
-            rowPitch = image->width * 3;
+            return *sPtr;
         }
-        else
+
+        static void ReadRow(_Out_writes_(count) pixel_t* dPtr, _In_reads_bytes_(count) const uint8_t* sPtr, size_t count, uint32_t&)
         {
-            size_t slicePitch;
-            HRESULT hr = ComputePitch(image->format, image->width, image->height, rowPitch, slicePitch, CP_FLAGS_NONE);
-            if (FAILED(hr))
-                return hr;
+            memcpy(dPtr, sPtr, count);
         }
+    };
 
-        auto sPtr = static_cast<const uint8_t*>(pSource);
-        const uint8_t* endPtr = sPtr + size;
+    struct TGAPixel16
+    {
+        typedef uint16_t pixel_t;
+        static const size_t bytes = 2;
 
-        switch (image->format)
+        static pixel_t Read(_In_reads_bytes_(2) const uint8_t* sPtr, uint32_t& alpha)
         {
-        //--------------------------------------------------------------------------- 8-bit
-        case DXGI_FORMAT_R8_UNORM:
-            for (size_t y = 0; y < image->height; ++y)
-            {
-                size_t offset = ((convFlags & CONV_FLAGS_INVERTX) ? (image->width - 1) : 0);
-                assert(offset < rowPitch);
-
-                uint8_t* dPtr = image->pixels
-                    + (image->rowPitch * ((convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1)))
-                    + offset;
-
-                for (size_t x = 0; x < image->width; )
-                {
-                    if (sPtr >= endPtr)
-                        return E_FAIL;
-
-                    if (*sPtr & 0x80)
-                    {
-                        // Repeat
-                        size_t j = size_t(*sPtr & 0x7F) + 1;
-                        if (++sPtr >= endPtr)
-                            return E_FAIL;
-
-                        for (; j > 0; --j, ++x)
-                        {
-                            if (x >= image->width)
-                                return E_FAIL;
-
-                            *dPtr = *sPtr;
-
-                            if (convFlags & CONV_FLAGS_INVERTX)
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
-
-                        ++sPtr;
-                    }
-                    else
-                    {
-                        // Literal
-                        size_t j = size_t(*sPtr & 0x7F) + 1;
-                        ++sPtr;
+            auto t = static_cast<uint16_t>(unsigned(*sPtr) | (*(sPtr + 1u) << 8));
+            alpha |= t & 0x8000;
+            return t;
+        }
 
-                        if (sPtr + j > endPtr)
-                            return E_FAIL;
+        static void ReadRow(_Out_writes_(count) pixel_t* dPtr, _In_reads_bytes_(count * 2) const uint8_t* sPtr, size_t count, uint32_t& alpha)
+        {
+            // TGA stores 5:5:5:1 little-endian which matches B5G5R5A1_UNORM
+            memcpy(dPtr, sPtr, count * 2);
 
-                        for (; j > 0; --j, ++x)
-                        {
-                            if (x >= image->width)
-                                return E_FAIL;
+            uint32_t a = 0;
+            for (size_t x = 0; x < count; ++x)
+                a |= dPtr[x];
+            alpha |= a & 0x8000;
+        }
+    };
 
-                            *dPtr = *(sPtr++);
+    struct TGAPixel24
+    {
+        typedef uint32_t pixel_t;
+        static const size_t bytes = 3;
 
-                            if (convFlags & CONV_FLAGS_INVERTX)
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
-                    }
-                }
-            }
-            break;
+        static pixel_t Read(_In_reads_bytes_(3) const uint8_t* sPtr, uint32_t& alpha)
+        {
+            // BGR -> RGBA
+            alpha |= 0xFF000000;
+            return uint32_t(*sPtr << 16) | uint32_t(*(sPtr + 1) << 8) | uint32_t(*(sPtr + 2)) | 0xFF000000;
+        }
 
-        //-------------------------------------------------------------------------- 16-bit
-        case DXGI_FORMAT_B5G5R5A1_UNORM:
+        static void ReadRow(_Out_writes_(count) pixel_t* dPtr, _In_reads_bytes_(count * 3) const uint8_t* sPtr, size_t count, uint32_t& alpha)
         {
-            bool nonzeroa = false;
-            for (size_t y = 0; y < image->height; ++y)
+            for (size_t x = 0; x < count; ++x, sPtr += 3)
             {
-                size_t offset = ((convFlags & CONV_FLAGS_INVERTX) ? (image->width - 1) : 0);
-                assert(offset * 2 < rowPitch);
+                dPtr[x] = uint32_t(*sPtr << 16) | uint32_t(*(sPtr + 1) << 8) | uint32_t(*(sPtr + 2)) | 0xFF000000;
+            }
+            alpha |= 0xFF000000;
+        }
+    };
 
-                auto dPtr = reinterpret_cast<uint16_t*>(image->pixels
-                    + (image->rowPitch * ((convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1))))
-                    + offset;
+    struct TGAPixel32
+    {
+        typedef uint32_t pixel_t;
+        static const size_t bytes = 4;
 
-                for (size_t x = 0; x < image->width; )
-                {
-                    if (sPtr >= endPtr)
-                        return E_FAIL;
+        static pixel_t Read(_In_reads_bytes_(4) const uint8_t* sPtr, uint32_t& alpha)
+        {
+            // BGRA -> RGBA
+            uint32_t t;
+            memcpy(&t, sPtr, sizeof(uint32_t));
+            t = (t & 0xFF00FF00) | ((t >> 16) & 0xFF) | ((t & 0xFF) << 16);
+            alpha |= t & 0xFF000000;
+            return t;
+        }
 
-                    if (*sPtr & 0x80)
-                    {
-                        // Repeat
-                        size_t j = size_t(*sPtr & 0x7F) + 1;
-                        ++sPtr;
-
-                        if (sPtr + 1 >= endPtr)
-                            return E_FAIL;
-
-                        auto t = static_cast<uint16_t>(unsigned(*sPtr) | (*(sPtr + 1u) << 8));
-                        if (t & 0x8000)
-                            nonzeroa = true;
-                        sPtr += 2;
-
-                        for (; j > 0; --j, ++x)
-                        {
-                            if (x >= image->width)
-                                return E_FAIL;
-
-                            *dPtr = t;
-
-                            if (convFlags & CONV_FLAGS_INVERTX)
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
-                    }
-                    else
-                    {
-                        // Literal
-                        size_t j = size_t(*sPtr & 0x7F) + 1;
-                        ++sPtr;
-
-                        if (sPtr + (j * 2) > endPtr)
-                            return E_FAIL;
-
-                        for (; j > 0; --j, ++x)
-                        {
-                            if (x >= image->width)
-                                return E_FAIL;
-
-                            auto t = static_cast<uint16_t>(unsigned(*sPtr) | (*(sPtr + 1u) << 8));
-                            if (t & 0x8000)
-                                nonzeroa = true;
-                            sPtr += 2;
-                            *dPtr = t;
-
-                            if (convFlags & CONV_FLAGS_INVERTX)
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
-                    }
-                }
-            }
+        static void ReadRow(_Out_writes_(count) pixel_t* dPtr, _In_reads_bytes_(count * 4) const uint8_t* sPtr, size_t count, uint32_t& alpha)
+        {
+            memcpy(dPtr, sPtr, count * 4);
 
-            // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
-            if (!nonzeroa)
+            uint32_t a = 0;
+            for (size_t x = 0; x < count; ++x)
             {
-                HRESULT hr = SetAlphaChannelToOpaque(image);
-                if (FAILED(hr))
-                    return hr;
+                uint32_t t = dPtr[x];
+                a |= t;
+                dPtr[x] = (t & 0xFF00FF00) | ((t >> 16) & 0xFF) | ((t & 0xFF) << 16);
             }
+            alpha |= a & 0xFF000000;
         }
-        break;
+    };
 
-        //----------------------------------------------------------------------- 24/32-bit
-        case DXGI_FORMAT_R8G8B8A8_UNORM:
+
+    //-------------------------------------------------------------------------------------
+    // Decodes RLE packets a scanline at a time
+    //
+    // Runs become a fill and raw packets a bulk row conversion. Scanlines are always
+    // written left-to-right and reversed afterwards for right-to-left files.
+    //-------------------------------------------------------------------------------------
+    template<typename TPixel>
+    HRESULT UncompressScanlines(
+        _In_reads_bytes_(size) const uint8_t* sPtr,
+        size_t size,
+        _In_ const Image* image,
+        _In_ DWORD convFlags,
+        _Inout_ uint32_t& alpha)
+    {
+        typedef typename TPixel::pixel_t pixel_t;
+
+        const uint8_t* endPtr = sPtr + size;
+        const size_t width = image->width;
+
+        for (size_t y = 0; y < image->height; ++y)
         {
-            bool nonzeroa = false;
-            for (size_t y = 0; y < image->height; ++y)
+            auto dPtr = reinterpret_cast<pixel_t*>(image->pixels
+                + (image->rowPitch * ((convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1))));
+
+            for (size_t x = 0; x < width; )
             {
-                size_t offset = ((convFlags & CONV_FLAGS_INVERTX) ? (image->width - 1) : 0);
+                if (sPtr >= endPtr)
+                    return E_FAIL;
 
-                auto dPtr = reinterpret_cast<uint32_t*>(image->pixels
-                    + (image->rowPitch * ((convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1))))
-                    + offset;
+                const uint8_t packet = *(sPtr++);
+                size_t j = size_t(packet & 0x7F) + 1;
+                if (j > width - x)
+                    return E_FAIL;
 
-                for (size_t x = 0; x < image->width; )
+                if (packet & 0x80)
                 {
-                    if (sPtr >= endPtr)
+                    // Repeat
+                    if (sPtr + TPixel::bytes > endPtr)
                         return E_FAIL;
 
-                    if (*sPtr & 0x80)
-                    {
-                        // Repeat
-                        size_t j = size_t(*sPtr & 0x7F) + 1;
-                        ++sPtr;
-
-                        DWORD t;
-                        if (convFlags & CONV_FLAGS_EXPAND)
-                        {
-                            assert(offset * 3 < rowPitch);
-
-                            if (sPtr + 2 >= endPtr)
-                                return E_FAIL;
+                    std::fill_n(dPtr + x, j, TPixel::Read(sPtr, alpha));
+                    sPtr += TPixel::bytes;
+                }
+                else
+                {
+                    // Literal
+                    if (sPtr + j * TPixel::bytes > endPtr)
+                        return E_FAIL;
 
-                            // BGR -> RGBA
-                            t = (*sPtr << 16) | (*(sPtr + 1) << 8) | (*(sPtr + 2)) | 0xFF000000;
-                            sPtr += 3;
+                    TPixel::ReadRow(dPtr + x, sPtr, j, alpha);
+                    sPtr += j * TPixel::bytes;
+                }
 
-                            nonzeroa = true;
-                        }
-                        else
-                        {
-                            assert(offset * 4 < rowPitch);
+                x += j;
+            }
 
-                            if (sPtr + 3 >= endPtr)
-                                return E_FAIL;
+            if (convFlags & CONV_FLAGS_INVERTX)
+                std::reverse(dPtr, dPtr + width);
+        }
 
-                            // BGRA -> RGBA
-                            t = (*sPtr << 16) | (*(sPtr + 1) << 8) | (*(sPtr + 2)) | (*(sPtr + 3) << 24);
+        return S_OK;
+    }
 
-                            if (*(sPtr + 3) > 0)
-                                nonzeroa = true;
 
-                            sPtr += 4;
-                        }
+    //-------------------------------------------------------------------------------------
+    // Copies uncompressed scanlines
+    //-------------------------------------------------------------------------------------
+    template<typename TPixel>
+    HRESULT CopyScanlines(
+        _In_reads_bytes_(size) const uint8_t* sPtr,
+        size_t size,
+        _In_ const Image* image,
+        _In_ DWORD convFlags,
+        _Inout_ uint32_t& alpha)
+    {
+        typedef typename TPixel::pixel_t pixel_t;
 
-                        for (; j > 0; --j, ++x)
-                        {
-                            if (x >= image->width)
-                                return E_FAIL;
+        const size_t width = image->width;
+        const size_t rowBytes = width * TPixel::bytes;
 
-                            *dPtr = t;
+        if (uint64_t(rowBytes) * uint64_t(image->height) > size)
+            return E_FAIL;
 
-                            if (convFlags & CONV_FLAGS_INVERTX)
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
-                    }
-                    else
-                    {
-                        // Literal
-                        size_t j = size_t(*sPtr & 0x7F) + 1;
-                        ++sPtr;
-
-                        if (convFlags & CONV_FLAGS_EXPAND)
-                        {
-                            if (sPtr + (j * 3) > endPtr)
-                                return E_FAIL;
-                        }
-                        else
-                        {
-                            if (sPtr + (j * 4) > endPtr)
-                                return E_FAIL;
-                        }
-
-                        for (; j > 0; --j, ++x)
-                        {
-                            if (x >= image->width)
-                                return E_FAIL;
-
-                            if (convFlags & CONV_FLAGS_EXPAND)
-                            {
-                                assert(offset * 3 < rowPitch);
-
-                                if (sPtr + 2 >= endPtr)
-                                    return E_FAIL;
-
-                                // BGR -> RGBA
-                                *dPtr = (*sPtr << 16) | (*(sPtr + 1) << 8) | (*(sPtr + 2)) | 0xFF000000;
-                                sPtr += 3;
-
-                                nonzeroa = true;
-                            }
-                            else
-                            {
-                                assert(offset * 4 < rowPitch);
-
-                                if (sPtr + 3 >= endPtr)
-                                    return E_FAIL;
-
-                                // BGRA -> RGBA
-                                *dPtr = (*sPtr << 16) | (*(sPtr + 1) << 8) | (*(sPtr + 2)) | (*(sPtr + 3) << 24);
-
-                                if (*(sPtr + 3) > 0)
-                                    nonzeroa = true;
-
-                                sPtr += 4;
-                            }
-
-                            if (convFlags & CONV_FLAGS_INVERTX)
-                                --dPtr;
-                            else
-                                ++dPtr;
-                        }
-                    }
-                }
-            }
+        for (size_t y = 0; y < image->height; ++y)
+        {
+            auto dPtr = reinterpret_cast<pixel_t*>(image->pixels
+                + (image->rowPitch * ((convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1))));
 
-            // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
-            if (!nonzeroa)
-            {
-                HRESULT hr = SetAlphaChannelToOpaque(image);
-                if (FAILED(hr))
-                    return hr;
-            }
-        }
-        break;
+            TPixel::ReadRow(dPtr, sPtr, width, alpha);
+            sPtr += rowBytes;
 
-        //---------------------------------------------------------------------------------
-        default:
-            return E_FAIL;
+            if (convFlags & CONV_FLAGS_INVERTX)
+                std::reverse(dPtr, dPtr + width);
         }
 
         return S_OK;
@@ -576,9 +448,9 @@ namespace
 
 
     //-------------------------------------------------------------------------------------
-    // Copies pixel data from a TGA into the target image
+    // Uncompress pixel data from a TGA into the target image
     //-------------------------------------------------------------------------------------
-    HRESULT CopyPixels(
+    HRESULT UncompressPixels(
         _In_reads_bytes_(size) const void* pSource,
         size_t size,
         _In_ const Image* image,
@@ -589,158 +461,84 @@ namespace
         if (!image || !image->pixels)
             return E_POINTER;
 
-        // Compute TGA image data pitch
-        size_t rowPitch;
-        if (convFlags & CONV_FLAGS_EXPAND)
-        {
-            rowPitch = image->width * 3;
-        }
-        else
-        {
-            size_t slicePitch;
-            HRESULT hr = ComputePitch(image->format, image->width, image->height, rowPitch, slicePitch, CP_FLAGS_NONE);
-            if (FAILED(hr))
-                return hr;
-        }
-
         auto sPtr = static_cast<const uint8_t*>(pSource);
-        const uint8_t* endPtr = sPtr + size;
 
+        uint32_t alpha = 0;
+        HRESULT hr;
         switch (image->format)
         {
-        //--------------------------------------------------------------------------- 8-bit
         case DXGI_FORMAT_R8_UNORM:
-            for (size_t y = 0; y < image->height; ++y)
-            {
-                size_t offset = ((convFlags & CONV_FLAGS_INVERTX) ? (image->width - 1) : 0);
-                assert(offset < rowPitch);
+            return UncompressScanlines<TGAPixel8>(sPtr, size, image, convFlags, alpha);
 
-                uint8_t* dPtr = image->pixels
-                    + (image->rowPitch * ((convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1)))
-                    + offset;
-
-                for (size_t x = 0; x < image->width; ++x)
-                {
-                    if (sPtr >= endPtr)
-                        return E_FAIL;
-
-                    *dPtr = *(sPtr++);
-
-                    if (convFlags & CONV_FLAGS_INVERTX)
-                        --dPtr;
-                    else
-                        ++dPtr;
-                }
-            }
-            break;
-
-        //-------------------------------------------------------------------------- 16-bit
         case DXGI_FORMAT_B5G5R5A1_UNORM:
-        {
-            bool nonzeroa = false;
-            for (size_t y = 0; y < image->height; ++y)
-            {
-                size_t offset = ((convFlags & CONV_FLAGS_INVERTX) ? (image->width - 1) : 0);
-                assert(offset * 2 < rowPitch);
-
-                auto dPtr = reinterpret_cast<uint16_t*>(image->pixels
-                    + (image->rowPitch * ((convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1))))
-                    + offset;
-
-                for (size_t x = 0; x < image->width; ++x)
-                {
-                    if (sPtr + 1 >= endPtr)
-                        return E_FAIL;
-
-                    auto t = static_cast<uint16_t>(unsigned(*sPtr) | (*(sPtr + 1u) << 8));
-                    sPtr += 2;
-                    *dPtr = t;
-
-                    if (t & 0x8000)
-                        nonzeroa = true;
-
-                    if (convFlags & CONV_FLAGS_INVERTX)
-                        --dPtr;
-                    else
-                        ++dPtr;
-                }
-            }
-
-            // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
-            if (!nonzeroa)
-            {
-                HRESULT hr = SetAlphaChannelToOpaque(image);
-                if (FAILED(hr))
-                    return hr;
-            }
-        }
-        break;
+            hr = UncompressScanlines<TGAPixel16>(sPtr, size, image, convFlags, alpha);
+            break;
 
-        //----------------------------------------------------------------------- 24/32-bit
         case DXGI_FORMAT_R8G8B8A8_UNORM:
-        {
-            bool nonzeroa = false;
-            for (size_t y = 0; y < image->height; ++y)
-            {
-                size_t offset = ((convFlags & CONV_FLAGS_INVERTX) ? (image->width - 1) : 0);
+            hr = (convFlags & CONV_FLAGS_EXPAND)
+                ? UncompressScanlines<TGAPixel24>(sPtr, size, image, convFlags, alpha)
+                : UncompressScanlines<TGAPixel32>(sPtr, size, image, convFlags, alpha);
+            break;
 
-                auto dPtr = reinterpret_cast<uint32_t*>(image->pixels
-                    + (image->rowPitch * ((convFlags & CONV_FLAGS_INVERTY) ? y : (image->height - y - 1))))
-                    + offset;
+        default:
+            return E_FAIL;
+        }
 
-                for (size_t x = 0; x < image->width; ++x)
-                {
-                    if (convFlags & CONV_FLAGS_EXPAND)
-                    {
-                        assert(offset * 3 < rowPitch);
+        if (FAILED(hr))
+            return hr;
 
-                        if (sPtr + 2 >= endPtr)
-                            return E_FAIL;
+        // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
+        if (!alpha)
+            return SetAlphaChannelToOpaque(image);
 
-                        // BGR -> RGBA
-                        *dPtr = (*sPtr << 16) | (*(sPtr + 1) << 8) | (*(sPtr + 2)) | 0xFF000000;
-                        sPtr += 3;
+        return S_OK;
+    }
 
-                        nonzeroa = true;
-                    }
-                    else
-                    {
-                        assert(offset * 4 < rowPitch);
 
-                        if (sPtr + 3 >= endPtr)
-                            return E_FAIL;
+    //-------------------------------------------------------------------------------------
+    // Copies pixel data from a TGA into the target image
+    //-------------------------------------------------------------------------------------
+    HRESULT CopyPixels(
+        _In_reads_bytes_(size) const void* pSource,
+        size_t size,
+        _In_ const Image* image,
+        _In_ DWORD convFlags)
+    {
+        assert(pSource && size > 0);
 
-                        // BGRA -> RGBA
-                        *dPtr = (*sPtr << 16) | (*(sPtr + 1) << 8) | (*(sPtr + 2)) | (*(sPtr + 3) << 24);
+        if (!image || !image->pixels)
+            return E_POINTER;
 
-                        if (*(sPtr + 3) > 0)
-                            nonzeroa = true;
+        auto sPtr = static_cast<const uint8_t*>(pSource);
 
-                        sPtr += 4;
-                    }
+        uint32_t alpha = 0;
+        HRESULT hr;
+        switch (image->format)
+        {
+        case DXGI_FORMAT_R8_UNORM:
+            return CopyScanlines<TGAPixel8>(sPtr, size, image, convFlags, alpha);
 
-                    if (convFlags & CONV_FLAGS_INVERTX)
-                        --dPtr;
-                    else
-                        ++dPtr;
-                }
-            }
+        case DXGI_FORMAT_B5G5R5A1_UNORM:
+            hr = CopyScanlines<TGAPixel16>(sPtr, size, image, convFlags, alpha);
+            break;
 
-            // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
-            if (!nonzeroa)
-            {
-                HRESULT hr = SetAlphaChannelToOpaque(image);
-                if (FAILED(hr))
-                    return hr;
-            }
-        }
-        break;
+        case DXGI_FORMAT_R8G8B8A8_UNORM:
+            hr = (convFlags & CONV_FLAGS_EXPAND)
+                ? CopyScanlines<TGAPixel24>(sPtr, size, image, convFlags, alpha)
+                : CopyScanlines<TGAPixel32>(sPtr, size, image, convFlags, alpha);
+            break;
 
-        //---------------------------------------------------------------------------------
         default:
             return E_FAIL;
         }
 
+        if (FAILED(hr))
+            return hr;
+
+        // If there are no non-zero alpha channel entries, we'll assume alpha is not used and force it to opaque
+        if (!alpha)
+            return SetAlphaChannelToOpaque(image);
+
         return S_OK;
     }
 
@@ -748,7 +546,7 @@ namespace
     //-------------------------------------------------------------------------------------
     // Encodes TGA file header
     //-------------------------------------------------------------------------------------
-    HRESULT EncodeTGAHeader(_In_ const Image& image, _Out_ TGA_HEADER& header, _Inout_ DWORD& convFlags)
+    HRESULT EncodeTGAHeader(_In_ const Image& image, _In_ DWORD flags, _Out_ TGA_HEADER& header, _Inout_ DWORD& convFlags)
     {
         memset(&header, 0, sizeof(TGA_HEADER));
 
@@ -803,10 +601,108 @@ namespace
             return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
         }
 
+        if (flags & TGA_FLAGS_RLE)
+        {
+            header.bImageType = (header.bImageType == TGA_BLACK_AND_WHITE) ? TGA_BLACK_AND_WHITE_RLE : TGA_TRUECOLOR_RLE;
+            convFlags |= CONV_FLAGS_RLE;
+        }
+
         return S_OK;
     }
 
 
+    //-------------------------------------------------------------------------------------
+    // Worst-case size of an RLE encoded scanline (raw data plus a header per 128 pixels)
+    //-------------------------------------------------------------------------------------
+    inline size_t RLEScanlineBound(size_t width, size_t rowPitch)
+    {
+        return rowPitch + (width + 127) / 128;
+    }
+
+
+    //-------------------------------------------------------------------------------------
+    // RLE encodes a TGA scanline
+    //
+    // Repeat packets are only emitted where they are smaller than the raw pixels they
+    // replace (2 pixels, or 3 for 8-bit), so output never exceeds RLEScanlineBound
+    //-------------------------------------------------------------------------------------
+    template<size_t bpp>
+    inline size_t CountRun(_In_reads_bytes_(width * bpp) const uint8_t* sPtr, size_t x, size_t width, size_t maxRun)
+    {
+        const uint8_t* pixel = sPtr + x * bpp;
+        size_t run = 1;
+        while ((x + run < width) && (run < maxRun) && !memcmp(pixel, pixel + run * bpp, bpp))
+            ++run;
+        return run;
+    }
+
+    template<size_t bpp>
+    size_t EncodeRLEScanline(
+        _Out_writes_bytes_to_(outSize, return) uint8_t* pDestination,
+        _In_ size_t outSize,
+        _In_reads_bytes_(width * bpp) const uint8_t* pSource,
+        _In_ size_t width)
+    {
+        const size_t minRun = (bpp > 1) ? 2 : 3;
+
+        uint8_t* dPtr = pDestination;
+        const uint8_t* endPtr = pDestination + outSize;
+
+        for (size_t x = 0; x < width; )
+        {
+            size_t run = CountRun<bpp>(pSource, x, width, 128);
+            if (run >= minRun)
+            {
+                // Repeat
+                if (dPtr + 1 + bpp > endPtr)
+                    return 0;
+
+                *(dPtr++) = static_cast<uint8_t>(0x80 | (run - 1));
+                memcpy(dPtr, pSource + x * bpp, bpp);
+                dPtr += bpp;
+                x += run;
+            }
+            else
+            {
+                // Literal, up to the start of the next worthwhile run
+                size_t count = run;
+                while ((x + count < width) && (count < 128)
+                    && (CountRun<bpp>(pSource, x + count, width, minRun) < minRun))
+                {
+                    ++count;
+                }
+
+                if (dPtr + 1 + count * bpp > endPtr)
+                    return 0;
+
+                *(dPtr++) = static_cast<uint8_t>(count - 1);
+                memcpy(dPtr, pSource + x * bpp, count * bpp);
+                dPtr += count * bpp;
+                x += count;
+            }
+        }
+
+        return static_cast<size_t>(dPtr - pDestination);
+    }
+
+    size_t EncodeRLEScanline(
+        _Out_writes_bytes_to_(outSize, return) uint8_t* pDestination,
+        _In_ size_t outSize,
+        _In_reads_bytes_(width * bpp) const uint8_t* pSource,
+        _In_ size_t width,
+        _In_ size_t bpp)
+    {
+        switch (bpp)
+        {
+        case 1: return EncodeRLEScanline<1>(pDestination, outSize, pSource, width);
+        case 2: return EncodeRLEScanline<2>(pDestination, outSize, pSource, width);
+        case 3: return EncodeRLEScanline<3>(pDestination, outSize, pSource, width);
+        case 4: return EncodeRLEScanline<4>(pDestination, outSize, pSource, width);
+        default: return 0;
+        }
+    }
+
+
     //-------------------------------------------------------------------------------------
     // Copies BGRX data to form BGR 24bpp data
     //-------------------------------------------------------------------------------------
@@ -1247,14 +1143,14 @@ HRESULT DirectX::LoadFromTGAFile(
 // Save a TGA file to memory
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT DirectX::SaveToTGAMemory(const Image& image, Blob& blob)
+HRESULT DirectX::SaveToTGAMemory(const Image& image, DWORD flags, Blob& blob)
 {
     if (!image.pixels)
         return E_POINTER;
 
     TGA_HEADER tga_header = {};
     DWORD convFlags = 0;
-    HRESULT hr = EncodeTGAHeader(image, tga_header, convFlags);
+    HRESULT hr = EncodeTGAHeader(image, flags, tga_header, convFlags);
     if (FAILED(hr))
         return hr;
 
@@ -1274,6 +1170,17 @@ HRESULT DirectX::SaveToTGAMemory(const Image& image, Blob& blob)
             return hr;
     }
 
+    std::unique_ptr<uint8_t[]> temp;
+    if (convFlags & CONV_FLAGS_RLE)
+    {
+        // Scanlines are converted into a temporary and then encoded into the blob
+        temp.reset(new (std::nothrow) uint8_t[rowPitch]);
+        if (!temp)
+            return E_OUTOFMEMORY;
+
+        slicePitch = image.height * RLEScanlineBound(image.width, rowPitch);
+    }
+
     hr = blob.Initialize(sizeof(TGA_HEADER) + slicePitch);
     if (FAILED(hr))
         return hr;
@@ -1287,26 +1194,56 @@ HRESULT DirectX::SaveToTGAMemory(const Image& image, Blob& blob)
     const uint8_t* pPixels = image.pixels;
     assert(pPixels);
 
+    const size_t bpp = tga_header.bBitsPerPixel / 8;
+    const uint8_t* endPtr = dPtr + slicePitch;
+
     for (size_t y = 0; y < image.height; ++y)
     {
+        uint8_t* pScanline = (convFlags & CONV_FLAGS_RLE) ? temp.get() : dPtr;
+
         // Copy pixels
         if (convFlags & CONV_FLAGS_888)
         {
-            Copy24bppScanline(dPtr, rowPitch, pPixels, image.rowPitch);
+            Copy24bppScanline(pScanline, rowPitch, pPixels, image.rowPitch);
         }
         else if (convFlags & CONV_FLAGS_SWIZZLE)
         {
-            _SwizzleScanline(dPtr, rowPitch, pPixels, image.rowPitch, image.format, TEXP_SCANLINE_NONE);
+            _SwizzleScanline(pScanline, rowPitch, pPixels, image.rowPitch, image.format, TEXP_SCANLINE_NONE);
         }
         else
         {
-            _CopyScanline(dPtr, rowPitch, pPixels, image.rowPitch, image.format, TEXP_SCANLINE_NONE);
+            _CopyScanline(pScanline, rowPitch, pPixels, image.rowPitch, image.format, TEXP_SCANLINE_NONE);
+        }
+
+        if (convFlags & CONV_FLAGS_RLE)
+        {
+            size_t encoded = EncodeRLEScanline(dPtr, static_cast<size_t>(endPtr - dPtr), pScanline, image.width, bpp);
+            if (!encoded)
+            {
+                blob.Release();
+                return E_FAIL;
+            }
+
+            dPtr += encoded;
+        }
+        else
+        {
+            dPtr += rowPitch;
         }
 
-        dPtr += rowPitch;
         pPixels += image.rowPitch;
     }
 
+    if (convFlags & CONV_FLAGS_RLE)
+    {
+        hr = blob.Trim(static_cast<size_t>(dPtr - static_cast<uint8_t*>(blob.GetBufferPointer())));
+        if (FAILED(hr))
+        {
+            blob.Release();
+            return hr;
+        }
+    }
+
     return S_OK;
 }
 
@@ -1315,7 +1252,7 @@ HRESULT DirectX::SaveToTGAMemory(const Image& image, Blob& blob)
 // Save a TGA file to disk
 //-------------------------------------------------------------------------------------
 _Use_decl_annotations_
-HRESULT DirectX::SaveToTGAFile(const Image& image, const wchar_t* szFile)
+HRESULT DirectX::SaveToTGAFile(const Image& image, DWORD flags, const wchar_t* szFile)
 {
     if (!szFile)
         return E_INVALIDARG;
@@ -1325,7 +1262,7 @@ HRESULT DirectX::SaveToTGAFile(const Image& image, const wchar_t* szFile)
 
     TGA_HEADER tga_header = {};
     DWORD convFlags = 0;
-    HRESULT hr = EncodeTGAHeader(image, tga_header, convFlags);
+    HRESULT hr = EncodeTGAHeader(image, flags, tga_header, convFlags);
     if (FAILED(hr))
         return hr;
 
@@ -1372,7 +1309,7 @@ HRESULT DirectX::SaveToTGAFile(const Image& image, const wchar_t* szFile)
         // For small images, it is better to create an in-memory file and write it out
         Blob blob;
 
-        hr = SaveToTGAMemory(image, blob);
+        hr = SaveToTGAMemory(image, flags, blob);
         if (FAILED(hr))
             return hr;
 
@@ -1396,6 +1333,16 @@ HRESULT DirectX::SaveToTGAFile(const Image& image, const wchar_t* szFile)
         if (!temp)
             return E_OUTOFMEMORY;
 
+        size_t encodedPitch = 0;
+        std::unique_ptr<uint8_t[]> encoded;
+        if (convFlags & CONV_FLAGS_RLE)
+        {
+            encodedPitch = RLEScanlineBound(image.width, rowPitch);
+            encoded.reset(new (std::nothrow) uint8_t[encodedPitch]);
+            if (!encoded)
+                return E_OUTOFMEMORY;
+        }
+
         // Write header
         DWORD bytesWritten;
         if (!WriteFile(hFile.get(), &tga_header, sizeof(TGA_HEADER), &bytesWritten, nullptr))
@@ -1406,11 +1353,12 @@ HRESULT DirectX::SaveToTGAFile(const Image& image, const wchar_t* szFile)
         if (bytesWritten != sizeof(TGA_HEADER))
             return E_FAIL;
 
-        if (rowPitch > UINT32_MAX)
+        if (rowPitch > UINT32_MAX || encodedPitch > UINT32_MAX)
             return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
 
         // Write pixels
         const uint8_t* pPixels = image.pixels;
+        const size_t bpp = tga_header.bBitsPerPixel / 8;
 
         for (size_t y = 0; y < image.height; ++y)
         {
@@ -1430,12 +1378,23 @@ HRESULT DirectX::SaveToTGAFile(const Image& image, const wchar_t* szFile)
 
             pPixels += image.rowPitch;
 
-            if (!WriteFile(hFile.get(), temp.get(), static_cast<DWORD>(rowPitch), &bytesWritten, nullptr))
+            const uint8_t* pWrite = temp.get();
+            size_t bytesToWrite = rowPitch;
+            if (convFlags & CONV_FLAGS_RLE)
+            {
+                bytesToWrite = EncodeRLEScanline(encoded.get(), encodedPitch, temp.get(), image.width, bpp);
+                if (!bytesToWrite)
+                    return E_FAIL;
+
+                pWrite = encoded.get();
+            }
+
+            if (!WriteFile(hFile.get(), pWrite, static_cast<DWORD>(bytesToWrite), &bytesWritten, nullptr))
             {
                 return HRESULT_FROM_WIN32(GetLastError());
             }
 
-            if (bytesWritten != rowPitch)
+            if (bytesWritten != bytesToWrite)
                 return E_FAIL;
         }
     }
@@ -25,9 +25,12 @@
 #include <stdlib.h>
 #include <assert.h>
 
+#include <atomic>
 #include <fstream>
 #include <memory>
 #include <list>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <wrl/client.h>
@@ -62,6 +65,7 @@ enum COMMANDS
     CMD_V_STRIP,
     CMD_MERGE,
     CMD_GIF,
+    CMD_PAGES,
     CMD_MAX
 };
 
@@ -87,6 +91,10 @@ enum OPTIONS
     OPT_TONEMAP,
     OPT_FILELIST,
     OPT_GIF_BGCOLOR,
+    OPT_MIPLEVELS,
+    OPT_JOBS,
+    OPT_PAGE_SIZE,
+    OPT_PAGE_BORDER,
     OPT_MAX
 };
 
@@ -119,6 +127,7 @@ const SValue g_pCommands[] =
     { L"v-strip",   CMD_V_STRIP },
     { L"merge",     CMD_MERGE },
     { L"gif",       CMD_GIF },
+    { L"pages",     CMD_PAGES },
     { nullptr,      0 }
 };
 
@@ -144,6 +153,10 @@ const SValue g_pOptions [] =
     { L"tonemap",   OPT_TONEMAP },
     { L"flist",     OPT_FILELIST },
     { L"bgcolor",   OPT_GIF_BGCOLOR },
+    { L"m",         OPT_MIPLEVELS },
+    { L"j",         OPT_JOBS },
+    { L"page",      OPT_PAGE_SIZE },
+    { L"border",    OPT_PAGE_BORDER },
     { nullptr,      0 }
 };
 
@@ -200,6 +213,16 @@ const SValue g_pFormats [] =
     DEFFMT(R9G9B9E5_SHAREDEXP),
     DEFFMT(R8G8_B8G8_UNORM),
     DEFFMT(G8R8_G8B8_UNORM),
+    DEFFMT(BC1_UNORM),
+    DEFFMT(BC1_UNORM_SRGB),
+    DEFFMT(BC2_UNORM),
+    DEFFMT(BC2_UNORM_SRGB),
+    DEFFMT(BC3_UNORM),
+    DEFFMT(BC3_UNORM_SRGB),
+    DEFFMT(BC4_UNORM),
+    DEFFMT(BC4_SNORM),
+    DEFFMT(BC5_UNORM),
+    DEFFMT(BC5_SNORM),
     DEFFMT(B5G6R5_UNORM),
     DEFFMT(B5G5R5A1_UNORM),
 
@@ -209,6 +232,10 @@ const SValue g_pFormats [] =
     DEFFMT(R10G10B10_XR_BIAS_A2_UNORM),
     DEFFMT(B8G8R8A8_UNORM_SRGB),
     DEFFMT(B8G8R8X8_UNORM_SRGB),
+    DEFFMT(BC6H_UF16),
+    DEFFMT(BC6H_SF16),
+    DEFFMT(BC7_UNORM),
+    DEFFMT(BC7_UNORM_SRGB),
 
     // DXGI 1.2 formats
     DEFFMT(AYUV),
@@ -511,7 +538,8 @@ namespace
         wprintf(L"   h-cross or v-cross  create a cross image from a cubemap\n");
         wprintf(L"   h-strip or v-strip  create a strip image from a cubemap\n");
         wprintf(L"   merge               create texture from rgb image and alpha image\n");
-        wprintf(L"   gif                 create array from animated gif\n\n");
+        wprintf(L"   gif                 create array from animated gif\n");
+        wprintf(L"   pages               pack textures into virtual texture pages with a page table\n\n");
         wprintf(L"   -r                  wildcard filename search is recursive\n");
         wprintf(L"   -w <n>              width\n");
         wprintf(L"   -h <n>              height\n");
@@ -528,6 +556,12 @@ namespace
         wprintf(L"   -nologo             suppress copyright message\n");
         wprintf(L"   -tonemap            Apply a tonemap operator based on maximum luminance\n");
         wprintf(L"   -flist <filename>   use text file with a list of input files (one per line)\n");
+        wprintf(L"\n                       (cube, volume, array, cubearray, and pages only)\n");
+        wprintf(L"   -m <levels>         miplevels for output (0 means full chain, default is 1)\n");
+        wprintf(L"   -j <n>              decode up to n input files at a time\n");
+        wprintf(L"\n                       (pages only)\n");
+        wprintf(L"   -page <n>           tile size in texels, a power of 2 (default is 128)\n");
+        wprintf(L"   -border <n>         texels copied from neighboring tiles for filtering (default is 4)\n");
         wprintf(L"\n                       (gif only)\n");
         wprintf(L"   -bgcolor            Use background color instead of transparency\n");
 
@@ -908,320 +942,1855 @@ namespace
 
         return S_OK;
     }
-}
-
 
-//--------------------------------------------------------------------------------------
-// Entry-point
-//--------------------------------------------------------------------------------------
-#pragma prefast(disable : 28198, "Command-line tool, frees all memory on exit")
 
-int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
-{
-    // Parameters and defaults
-    size_t width = 0;
-    size_t height = 0;
+    //--------------------------------------------------------------------------------------
+    // Fast assembly for cube, cubearray, array, and volume
+    //--------------------------------------------------------------------------------------
+    HRESULT LoadImageFile(const wchar_t* szFile, DWORD dwFilter, TexMetadata& info, ScratchImage& image)
+    {
+        wchar_t ext[_MAX_EXT];
+        _wsplitpath_s(szFile, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT);
 
-    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
-    DWORD dwFilter = TEX_FILTER_DEFAULT;
-    DWORD dwSRGB = 0;
-    DWORD dwFilterOpts = 0;
-    DWORD fileType = WIC_CODEC_BMP;
+        if (_wcsicmp(ext, L".dds") == 0)
+        {
+            return LoadFromDDSFile(szFile, DDS_FLAGS_NONE, &info, image);
+        }
+        else if (_wcsicmp(ext, L".tga") == 0)
+        {
+            return LoadFromTGAFile(szFile, &info, image);
+        }
+        else if (_wcsicmp(ext, L".hdr") == 0)
+        {
+            return LoadFromHDRFile(szFile, &info, image);
+        }
+#ifdef USE_OPENEXR
+        else if (_wcsicmp(ext, L".exr") == 0)
+        {
+            return LoadFromEXRFile(szFile, &info, image);
+        }
+#endif
+        else
+        {
+            // WIC shares the same filter values for mode and dither
+            static_assert(WIC_FLAGS_DITHER == TEX_FILTER_DITHER, "WIC_FLAGS_* & TEX_FILTER_* should match");
+            static_assert(WIC_FLAGS_DITHER_DIFFUSION == TEX_FILTER_DITHER_DIFFUSION, "WIC_FLAGS_* & TEX_FILTER_* should match");
+            static_assert(WIC_FLAGS_FILTER_POINT == TEX_FILTER_POINT, "WIC_FLAGS_* & TEX_FILTER_* should match");
+            static_assert(WIC_FLAGS_FILTER_LINEAR == TEX_FILTER_LINEAR, "WIC_FLAGS_* & TEX_FILTER_* should match");
+            static_assert(WIC_FLAGS_FILTER_CUBIC == TEX_FILTER_CUBIC, "WIC_FLAGS_* & TEX_FILTER_* should match");
+            static_assert(WIC_FLAGS_FILTER_FANT == TEX_FILTER_FANT, "WIC_FLAGS_* & TEX_FILTER_* should match");
+
+            return LoadFromWICFile(szFile, dwFilter | WIC_FLAGS_ALL_FRAMES, &info, image);
+        }
+    }
 
-    wchar_t szOutputFile[MAX_PATH] = {};
 
-    // Initialize COM (needed for WIC)
-    HRESULT hr = hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
-    if (FAILED(hr))
+    HRESULT GetImageFileMetadata(const wchar_t* szFile, DWORD dwFilter, TexMetadata& info)
     {
-        wprintf(L"Failed to initialize COM (%08X)\n", hr);
-        return 1;
+        wchar_t ext[_MAX_EXT];
+        _wsplitpath_s(szFile, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT);
+
+        if (_wcsicmp(ext, L".dds") == 0)
+        {
+            return GetMetadataFromDDSFile(szFile, DDS_FLAGS_NONE, info);
+        }
+        else if (_wcsicmp(ext, L".tga") == 0)
+        {
+            return GetMetadataFromTGAFile(szFile, info);
+        }
+        else if (_wcsicmp(ext, L".hdr") == 0)
+        {
+            return GetMetadataFromHDRFile(szFile, info);
+        }
+#ifdef USE_OPENEXR
+        else if (_wcsicmp(ext, L".exr") == 0)
+        {
+            return GetMetadataFromEXRFile(szFile, info);
+        }
+#endif
+        else
+        {
+            return GetMetadataFromWICFile(szFile, dwFilter | WIC_FLAGS_ALL_FRAMES, info);
+        }
     }
 
-    // Process command line
-    if (argc < 2)
+
+    size_t CountMips(size_t width, size_t height, size_t depth)
     {
-        PrintUsage();
-        return 0;
+        size_t mipLevels = 1;
+
+        while (width > 1 || height > 1 || depth > 1)
+        {
+            if (width > 1)
+                width >>= 1;
+
+            if (height > 1)
+                height >>= 1;
+
+            if (depth > 1)
+                depth >>= 1;
+
+            ++mipLevels;
+        }
+
+        return mipLevels;
     }
 
-    DWORD dwCommand = LookupByName(argv[1], g_pCommands);
-    switch (dwCommand)
+
+    // Format the faces are assembled in before any block compression
+    DXGI_FORMAT GetAssemblyFormat(DXGI_FORMAT format)
     {
-    case CMD_CUBE:
-    case CMD_VOLUME:
-    case CMD_ARRAY:
-    case CMD_CUBEARRAY:
-    case CMD_H_CROSS:
-    case CMD_V_CROSS:
-    case CMD_H_STRIP:
-    case CMD_V_STRIP:
-    case CMD_MERGE:
-    case CMD_GIF:
-        break;
+        switch (format)
+        {
+        case DXGI_FORMAT_BC1_UNORM:
+        case DXGI_FORMAT_BC2_UNORM:
+        case DXGI_FORMAT_BC3_UNORM:
+        case DXGI_FORMAT_BC7_UNORM:
+            return DXGI_FORMAT_R8G8B8A8_UNORM;
+
+        case DXGI_FORMAT_BC1_UNORM_SRGB:
+        case DXGI_FORMAT_BC2_UNORM_SRGB:
+        case DXGI_FORMAT_BC3_UNORM_SRGB:
+        case DXGI_FORMAT_BC7_UNORM_SRGB:
+            return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
 
-    default:
-        wprintf(L"Must use one of: cube, volume, array, cubearray,\n   h-cross, v-cross, h-strip, v-strip\n   merge, gif\n\n");
-        return 1;
+        default:
+            // BC4, BC5, and BC6H keep full precision until compression
+            return IsCompressed(format) ? DXGI_FORMAT_R32G32B32A32_FLOAT : format;
+        }
     }
 
-    DWORD dwOptions = 0;
-    std::list<SConversion> conversion;
 
-    for (int iArg = 2; iArg < argc; iArg++)
+    struct SAssembleOptions
     {
-        PWSTR pArg = argv[iArg];
+        DWORD dwCommand;
+        DWORD dwOptions;
+        DWORD dwFilter;
+        DWORD dwSRGB;
+        DWORD dwFilterOpts;
+        size_t width;
+        size_t height;
+        size_t mipLevels;
+    };
 
-        if (('-' == pArg[0]) || ('/' == pArg[0]))
-        {
-            pArg++;
-            PWSTR pValue;
+    struct SAssembleJob
+    {
+        const SConversion* pConv;
+        size_t firstIndex;                      // First destination array item (or volume slice)
+        TexMetadata info;
+        TexMetadata sourceInfo;                 // As loaded, for reporting
+        std::unique_ptr<ScratchImage> image;    // Decoded and converted, released once copied
+        HRESULT hr;
+        const wchar_t* failedStep;
+        const wchar_t* warning;
+
+        SAssembleJob() : pConv(nullptr), firstIndex(0), info{}, sourceInfo{}, hr(S_OK), failedStep(nullptr), warning(nullptr) {}
+    };
 
-            for (pValue = pArg; *pValue && (':' != *pValue); pValue++);
 
-            if (*pValue)
-                *pValue++ = 0;
+    // Decodes one input and applies the planar, decompress, alpha, resize, and tonemap steps.
+    // A zero opts.width or opts.height keeps the size the input was loaded with.
+    HRESULT PrepareImage(SAssembleJob& job, const SAssembleOptions& opts)
+    {
+        // Set when the header was read up front to lay out the destination
+        const size_t items = job.info.arraySize;
 
-            DWORD dwOption = LookupByName(pArg, g_pOptions);
+        bool unfoldCube = false;
+        switch (opts.dwCommand)
+        {
+        case CMD_H_CROSS:
+        case CMD_V_CROSS:
+        case CMD_H_STRIP:
+        case CMD_V_STRIP:
+            unfoldCube = true;
+            break;
+        }
 
-            if (!dwOption || (dwOptions & (1 << dwOption)))
+        if (unfoldCube)
+        {
+            wchar_t ext[_MAX_EXT];
+            _wsplitpath_s(job.pConv->szSrc, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT);
+
+            if (_wcsicmp(ext, L".dds") != 0)
             {
-                PrintUsage();
-                return 1;
+                job.failedStep = L"input must be a dds of a cubemap";
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
             }
+        }
 
-            dwOptions |= 1 << dwOption;
+        std::unique_ptr<ScratchImage> image(new (std::nothrow) ScratchImage);
+        if (!image)
+        {
+            job.failedStep = L"memory";
+            return E_OUTOFMEMORY;
+        }
 
-            // Handle options with additional value parameter
-            switch (dwOption)
+        TexMetadata& info = job.info;
+        HRESULT hr = LoadImageFile(job.pConv->szSrc, opts.dwFilter, info, *image);
+        if (FAILED(hr))
+        {
+            job.failedStep = L"load";
+            return hr;
+        }
+
+        job.sourceInfo = info;
+
+        if (unfoldCube)
+        {
+            if (!info.IsCubemap())
             {
-            case OPT_WIDTH:
-            case OPT_HEIGHT:
-            case OPT_FORMAT:
-            case OPT_FILTER:
-            case OPT_OUTPUTFILE:
-            case OPT_FILELIST:
-                if (!*pValue)
-                {
-                    if ((iArg + 1 >= argc))
-                    {
-                        PrintUsage();
-                        return 1;
-                    }
+                job.failedStep = L"input must be a cubemap";
+                return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+            }
 
-                    iArg++;
-                    pValue = argv[iArg];
-                }
+            if (info.arraySize != 6)
+            {
+                job.warning = L"Only the first cubemap in an array is written out as a cross/strip";
             }
+        }
 
-            switch (dwOption)
+        if (opts.dwCommand == CMD_PAGES && info.mipLevels > 1 && info.arraySize == 1 && !info.IsVolumemap() && !info.IsCubemap())
+        {
+            // Pages are cut from a regenerated mip chain, so only the top level is kept
+            std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+            if (!timage)
             {
-            case OPT_WIDTH:
-                if (swscanf_s(pValue, L"%zu", &width) != 1)
-                {
-                    wprintf(L"Invalid value specified with -w (%ls)\n", pValue);
-                    return 1;
-                }
-                break;
+                job.failedStep = L"memory";
+                return E_OUTOFMEMORY;
+            }
 
-            case OPT_HEIGHT:
-                if (swscanf_s(pValue, L"%zu", &height) != 1)
-                {
-                    wprintf(L"Invalid value specified with -h (%ls)\n", pValue);
-                    return 1;
-                }
-                break;
+            hr = timage->InitializeFromImage(*image->GetImage(0, 0, 0));
+            if (FAILED(hr))
+            {
+                job.failedStep = L"copy top level";
+                return hr;
+            }
 
-            case OPT_FORMAT:
-                format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormats));
-                if (!format)
-                {
-                    format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormatAliases));
-                    if (!format)
-                    {
-                        wprintf(L"Invalid value specified with -f (%ls)\n", pValue);
-                        return 1;
-                    }
-                }
-                break;
+            info.mipLevels = 1;
+            image.swap(timage);
+        }
 
-            case OPT_FILTER:
-                dwFilter = LookupByName(pValue, g_pFilters);
-                if (!dwFilter)
-                {
-                    wprintf(L"Invalid value specified with -if (%ls)\n", pValue);
-                    return 1;
-                }
-                break;
+        if (!unfoldCube
+            && (info.mipLevels > 1
+                || info.IsVolumemap()
+                || info.IsCubemap()))
+        {
+            job.failedStep = L"can't assemble complex surfaces";
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
 
-            case OPT_SRGBI:
-                dwSRGB |= TEX_FILTER_SRGB_IN;
-                break;
+        if (items && info.arraySize != items)
+        {
+            job.failedStep = L"image count changed";
+            return E_UNEXPECTED;
+        }
 
-            case OPT_SRGBO:
-                dwSRGB |= TEX_FILTER_SRGB_OUT;
-                break;
+        // --- Planar ------------------------------------------------------------------
+        if (IsPlanar(info.format))
+        {
+            std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+            if (!timage)
+            {
+                job.failedStep = L"memory";
+                return E_OUTOFMEMORY;
+            }
 
-            case OPT_SRGB:
-                dwSRGB |= TEX_FILTER_SRGB;
-                break;
+            hr = ConvertToSinglePlane(image->GetImages(), image->GetImageCount(), info, *timage);
+            if (FAILED(hr))
+            {
+                job.failedStep = L"converttosingleplane";
+                return hr;
+            }
 
-            case OPT_SEPALPHA:
-                dwFilterOpts |= TEX_FILTER_SEPARATE_ALPHA;
-                break;
+            info.format = timage->GetMetadata().format;
+            image.swap(timage);
+        }
 
-            case OPT_NO_WIC:
-                dwFilterOpts |= TEX_FILTER_FORCE_NON_WIC;
-                break;
+        // --- Decompress --------------------------------------------------------------
+        if (IsCompressed(info.format))
+        {
+            std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+            if (!timage)
+            {
+                job.failedStep = L"memory";
+                return E_OUTOFMEMORY;
+            }
 
-            case OPT_OUTPUTFILE:
+            hr = Decompress(image->GetImages(), image->GetImageCount(), info, DXGI_FORMAT_UNKNOWN /* picks good default */, *timage);
+            if (FAILED(hr))
             {
-                wcscpy_s(szOutputFile, MAX_PATH, pValue);
+                job.failedStep = L"decompress";
+                return hr;
+            }
 
-                wchar_t ext[_MAX_EXT];
-                _wsplitpath_s(szOutputFile, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT);
+            info.format = timage->GetMetadata().format;
+            image.swap(timage);
+        }
 
-                fileType = LookupByName(ext, g_pExtFileTypes);
+        // --- Undo Premultiplied Alpha (if requested) ---------------------------------
+        if ((opts.dwOptions & (1 << OPT_DEMUL_ALPHA))
+            && HasAlpha(info.format)
+            && info.format != DXGI_FORMAT_A8_UNORM)
+        {
+            if (info.GetAlphaMode() == TEX_ALPHA_MODE_STRAIGHT)
+            {
+                job.warning = L"Image is already using straight alpha";
+            }
+            else if (!info.IsPMAlpha())
+            {
+                job.warning = L"Image is not using premultipled alpha";
+            }
+            else
+            {
+                std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+                if (!timage)
+                {
+                    job.failedStep = L"memory";
+                    return E_OUTOFMEMORY;
+                }
 
-                switch (dwCommand)
+                hr = PremultiplyAlpha(image->GetImages(), image->GetImageCount(), info, TEX_PMALPHA_REVERSE | opts.dwSRGB, *timage);
+                if (FAILED(hr))
                 {
-                case CMD_H_CROSS:
-                case CMD_V_CROSS:
-                case CMD_H_STRIP:
-                case CMD_V_STRIP:
-                case CMD_MERGE:
-                    break;
+                    job.failedStep = L"demultiply alpha";
+                    return hr;
+                }
 
-                default:
-                    if (fileType != CODEC_DDS)
-                    {
-                        wprintf(L"Assembled output file must be a dds\n");
-                        return 1;
-                    }
+                info.miscFlags2 = timage->GetMetadata().miscFlags2;
+                image.swap(timage);
+            }
+        }
+
+        // --- Resize ------------------------------------------------------------------
+        const size_t targetWidth = (opts.width) ? opts.width : info.width;
+        const size_t targetHeight = (opts.height) ? opts.height : info.height;
+        if (info.width != targetWidth || info.height != targetHeight)
+        {
+            std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+            if (!timage)
+            {
+                job.failedStep = L"memory";
+                return E_OUTOFMEMORY;
+            }
+
+            hr = Resize(image->GetImages(), image->GetImageCount(), image->GetMetadata(), targetWidth, targetHeight, opts.dwFilter | opts.dwFilterOpts, *timage);
+            if (FAILED(hr))
+            {
+                job.failedStep = L"resize";
+                return hr;
+            }
+
+            info.width = targetWidth;
+            info.height = targetHeight;
+            info.mipLevels = 1;
+            image.swap(timage);
+        }
+
+        // --- Tonemap (if requested) --------------------------------------------------
+        if (opts.dwOptions & (1 << OPT_TONEMAP))
+        {
+            std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+            if (!timage)
+            {
+                job.failedStep = L"memory";
+                return E_OUTOFMEMORY;
+            }
+
+            // Compute max luminosity across all images
+            XMVECTOR maxLum = XMVectorZero();
+            hr = EvaluateImage(image->GetImages(), image->GetImageCount(), image->GetMetadata(),
+                [&](const XMVECTOR* pixels, size_t width, size_t y)
+            {
+                UNREFERENCED_PARAMETER(y);
+
+                for (size_t j = 0; j < width; ++j)
+                {
+                    static const XMVECTORF32 s_luminance = { 0.3f, 0.59f, 0.11f, 0.f };
+
+                    XMVECTOR v = *pixels++;
+
+                    v = XMVector3Dot(v, s_luminance);
+
+                    maxLum = XMVectorMax(v, maxLum);
                 }
-                break;
+            });
+            if (FAILED(hr))
+            {
+                job.failedStep = L"tonemap maxlum";
+                return hr;
             }
 
-            case OPT_TA_WRAP:
-                if (dwFilterOpts & TEX_FILTER_MIRROR)
+            // Reinhard et al, "Photographic Tone Reproduction for Digital Images"
+            // http://www.cs.utah.edu/~reinhard/cdrom/
+            maxLum = XMVectorMultiply(maxLum, maxLum);
+
+            hr = TransformImage(image->GetImages(), image->GetImageCount(), image->GetMetadata(),
+                [&](XMVECTOR* outPixels, const XMVECTOR* inPixels, size_t width, size_t y)
+            {
+                UNREFERENCED_PARAMETER(y);
+
+                for (size_t j = 0; j < width; ++j)
                 {
-                    wprintf(L"Can't use -wrap and -mirror at same time\n\n");
-                    PrintUsage();
-                    return 1;
+                    XMVECTOR value = inPixels[j];
+
+                    XMVECTOR scale = XMVectorDivide(
+                        XMVectorAdd(g_XMOne, XMVectorDivide(value, maxLum)),
+                        XMVectorAdd(g_XMOne, value));
+                    XMVECTOR nvalue = XMVectorMultiply(value, scale);
+
+                    value = XMVectorSelect(value, nvalue, g_XMSelect1110);
+
+                    outPixels[j] = value;
                 }
-                dwFilterOpts |= TEX_FILTER_WRAP;
-                break;
+            }, *timage);
+            if (FAILED(hr))
+            {
+                job.failedStep = L"tonemap apply";
+                return hr;
+            }
 
-            case OPT_TA_MIRROR:
-                if (dwFilterOpts & TEX_FILTER_WRAP)
+            image.swap(timage);
+        }
+
+        job.image.swap(image);
+        return S_OK;
+    }
+
+
+    // Writes each decoded item straight into its destination subresource, converting the
+    // format on the way, then fills in that face's mip chain
+    HRESULT CopyToDestination(SAssembleJob& job, const SAssembleOptions& opts, const ScratchImage& dest)
+    {
+        const TexMetadata& mdata = dest.GetMetadata();
+        const bool volume = (mdata.dimension == TEX_DIMENSION_TEXTURE3D);
+        const DWORD convertFlags = opts.dwFilter | opts.dwFilterOpts | opts.dwSRGB;
+        const Rect rect(0, 0, opts.width, opts.height);
+
+        for (size_t item = 0; item < job.info.arraySize; ++item)
+        {
+            const Image* src = job.image->GetImage(0, item, 0);
+            const size_t index = job.firstIndex + item;
+            const Image* dst = (volume) ? dest.GetImage(0, 0, index) : dest.GetImage(0, index, 0);
+            if (!src || !dst)
+            {
+                job.failedStep = L"copy";
+                return E_UNEXPECTED;
+            }
+
+            HRESULT hr;
+            if (src->format != dst->format
+                && (opts.dwFilter & (TEX_FILTER_DITHER | TEX_FILTER_DITHER_DIFFUSION)))
+            {
+                // Dithering needs the full converter
+                ScratchImage timage;
+                hr = Convert(*src, dst->format, convertFlags, TEX_THRESHOLD_DEFAULT, timage);
+                if (SUCCEEDED(hr))
+                    hr = CopyRectangle(*timage.GetImage(0, 0, 0), rect, *dst, TEX_FILTER_DEFAULT, 0, 0);
+            }
+            else
+            {
+                hr = CopyRectangle(*src, rect, *dst, convertFlags, 0, 0);
+            }
+            if (FAILED(hr))
+            {
+                job.failedStep = L"convert";
+                return hr;
+            }
+
+            if (!volume && mdata.mipLevels > 1)
+            {
+                ScratchImage mipChain;
+                hr = GenerateMipMaps(*dst, opts.dwFilter | opts.dwFilterOpts, mdata.mipLevels, mipChain, mdata.dimension == TEX_DIMENSION_TEXTURE1D);
+                if (FAILED(hr))
                 {
-                    wprintf(L"Can't use -wrap and -mirror at same time\n\n");
-                    PrintUsage();
-                    return 1;
+                    job.failedStep = L"mips generation";
+                    return hr;
                 }
-                dwFilterOpts |= TEX_FILTER_MIRROR;
-                break;
 
-            case OPT_FILELIST:
+                for (size_t level = 1; level < mdata.mipLevels; ++level)
                 {
-                    std::wifstream inFile(pValue);
-                    if (!inFile)
+                    const Image* mip = mipChain.GetImage(level, 0, 0);
+                    const Image* mipDest = dest.GetImage(level, index, 0);
+                    if (!mip || !mipDest)
                     {
-                        wprintf(L"Error opening -flist file %ls\n", pValue);
-                        return 1;
+                        job.failedStep = L"mips generation";
+                        return E_UNEXPECTED;
                     }
-                    wchar_t fname[1024] = {};
-                    for (;;)
-                    {
-                        inFile >> fname;
-                        if (!inFile)
-                            break;
-
-                        if (*fname == L'#')
-                        {
-                            // Comment
-                        }
-                        else if (*fname == L'-')
-                        {
-                            wprintf(L"Command-line arguments not supported in -flist file\n");
-                            return 1;
-                        }
-                        else if (wcspbrk(fname, L"?*") != nullptr)
-                        {
-                            wprintf(L"Wildcards not supported in -flist file\n");
-                            return 1;
-                        }
-                        else
-                        {
-                            SConversion conv;
-                            wcscpy_s(conv.szSrc, MAX_PATH, fname);
-                            conversion.push_back(conv);
-                        }
 
-                        inFile.ignore(1000, '\n');
+                    hr = CopyRectangle(*mip, Rect(0, 0, mip->width, mip->height), *mipDest, TEX_FILTER_DEFAULT, 0, 0);
+                    if (FAILED(hr))
+                    {
+                        job.failedStep = L"mips generation";
+                        return hr;
                     }
-                    inFile.close();
                 }
-                break;
+            }
+        }
 
-            case OPT_GIF_BGCOLOR:
-                if (dwCommand != CMD_GIF)
-                {
-                    wprintf(L"-bgcolor only applies to gif command\n");
-                    return 1;
-                }
-                break;
+        job.image.reset();
+        return S_OK;
+    }
+
+
+    // Prepares and copies the inputs on up to 'jobs' threads
+    void AssembleImages(std::vector<SAssembleJob>& assembleJobs, const SAssembleOptions& opts, const ScratchImage& dest, size_t jobs)
+    {
+        std::atomic<size_t> nextJob(0);
+
+        auto worker = [&]()
+        {
+            HRESULT hrCOM = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+            for (;;)
+            {
+                size_t index = nextJob++;
+                if (index >= assembleJobs.size())
+                    break;
+
+                SAssembleJob& job = assembleJobs[index];
+
+                if (!job.image)
+                    job.hr = PrepareImage(job, opts);
+
+                if (SUCCEEDED(job.hr))
+                    job.hr = CopyToDestination(job, opts, dest);
+
+                job.image.reset();
             }
+
+            if (SUCCEEDED(hrCOM))
+                CoUninitialize();
+        };
+
+        std::vector<std::thread> workers;
+        try
+        {
+            for (size_t j = 1; j < jobs; ++j)
+                workers.emplace_back(worker);
         }
-        else if (wcspbrk(pArg, L"?*") != nullptr)
+        catch (const std::exception&)
         {
-            size_t count = conversion.size();
-            SearchForFiles(pArg, conversion, (dwOptions & (1 << OPT_RECURSIVE)) != 0);
-            if (conversion.size() <= count)
+            // Carry on with the threads that were started
+        }
+
+        // The calling thread works too
+        worker();
+
+        for (auto& t : workers)
+            t.join();
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Virtual texture pages
+    //--------------------------------------------------------------------------------------
+
+    // Largest pool texture dimension (D3D11/D3D12 Texture2D limit)
+    const size_t c_MaxPoolDimension = 16384;
+
+    // Page table entries per row of the indirection texture
+    const size_t c_IndirectionWidth = 4096;
+
+    struct SPageOptions
+    {
+        size_t pageSize;        // Payload texels per side, tiles cover this much of a mip level
+        size_t border;          // Texels copied from the neighboring tiles on each side
+        size_t mipLevels;       // 0 means down to the first level that fits in one page
+        size_t bpp;             // Bytes per texel of the assembly format
+        DWORD addressMode;      // TEX_FILTER_WRAP, TEX_FILTER_MIRROR, or 0 for clamp
+
+        size_t PageDimension() const { return pageSize + border * 2; }
+        size_t PageBytes() const { return PageDimension() * PageDimension() * bpp; }
+    };
+
+    struct SVirtualMip
+    {
+        size_t width;
+        size_t height;
+        size_t tilesX;
+        size_t tilesY;
+        size_t firstEntry;      // Page table index of tile (0,0), tiles follow in row-major order
+    };
+
+    struct SPageJob
+    {
+        SAssembleJob assemble;                          // Decode state shared with the other commands
+        ScratchImage mipChain;                          // Kept until the pages are verified
+        std::vector<SVirtualMip> mips;
+        std::vector<std::unique_ptr<uint8_t[]>> pages;  // One per tile, level-major then row-major
+        std::vector<uint64_t> hashes;
+    };
+
+
+    // Identical pages (solid colors, repeated tiles) are stored once
+    class CPagePool
+    {
+    public:
+        explicit CPagePool(size_t pageBytes) : m_pageBytes(pageBytes) {}
+
+        CPagePool(const CPagePool&) = delete;
+        CPagePool& operator=(const CPagePool&) = delete;
+
+        uint32_t Add(std::unique_ptr<uint8_t[]>& page, uint64_t hash)
+        {
+            auto range = m_lookup.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it)
             {
-                wprintf(L"No matching files found for %ls\n", pArg);
-                return 1;
+                if (memcmp(m_pages[it->second].get(), page.get(), m_pageBytes) == 0)
+                    return it->second;
             }
+
+            auto index = static_cast<uint32_t>(m_pages.size());
+            m_pages.emplace_back(std::move(page));
+            m_lookup.emplace(hash, index);
+            return index;
         }
-        else
+
+        size_t GetPageCount() const { return m_pages.size(); }
+        const uint8_t* GetPage(size_t index) const { return m_pages[index].get(); }
+
+    private:
+        size_t m_pageBytes;
+        std::vector<std::unique_ptr<uint8_t[]>> m_pages;
+        std::unordered_multimap<uint64_t, uint32_t> m_lookup;
+    };
+
+
+    // 64-bit FNV-1a
+    uint64_t HashPage(_In_reads_bytes_(size) const uint8_t* data, size_t size)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; ++i)
         {
-            SConversion conv;
-            wcscpy_s(conv.szSrc, MAX_PATH, pArg);
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
 
-            conversion.push_back(conv);
+
+    // Applies the texture addressing mode to a texel coordinate
+    size_t AddressTexel(ptrdiff_t coord, size_t size, DWORD addressMode)
+    {
+        const auto n = static_cast<ptrdiff_t>(size);
+
+        if (addressMode & TEX_FILTER_WRAP)
+        {
+            return static_cast<size_t>(((coord % n) + n) % n);
+        }
+        else if (addressMode & TEX_FILTER_MIRROR)
+        {
+            ptrdiff_t m = ((coord % (n * 2)) + n * 2) % (n * 2);
+            return static_cast<size_t>((m < n) ? m : (n * 2 - 1 - m));
         }
+
+        return static_cast<size_t>(std::max<ptrdiff_t>(0, std::min(coord, n - 1)));
     }
 
-    if (conversion.empty())
+
+    size_t CountPageMips(size_t width, size_t height, const SPageOptions& opts)
     {
-        PrintUsage();
-        return 0;
+        size_t levels = 1;
+        while (std::max(width, height) > opts.pageSize)
+        {
+            width = std::max<size_t>(1, width >> 1);
+            height = std::max<size_t>(1, height >> 1);
+            ++levels;
+        }
+
+        return (opts.mipLevels) ? std::min(levels, opts.mipLevels) : levels;
     }
 
-    if (~dwOptions & (1 << OPT_NOLOGO))
-        PrintLogo();
 
-    switch (dwCommand)
+    // Copies one tile and its border into a page
+    void CutPage(const Image& level, size_t tileX, size_t tileY, const SPageOptions& opts, _Out_writes_bytes_(opts.PageBytes()) uint8_t* pDest)
     {
-    case CMD_H_CROSS:
-    case CMD_V_CROSS:
-    case CMD_H_STRIP:
-    case CMD_V_STRIP:
-    case CMD_GIF:
-        if (conversion.size() > 1)
+        const size_t dim = opts.PageDimension();
+        const ptrdiff_t originX = static_cast<ptrdiff_t>(tileX * opts.pageSize) - static_cast<ptrdiff_t>(opts.border);
+        const ptrdiff_t originY = static_cast<ptrdiff_t>(tileY * opts.pageSize) - static_cast<ptrdiff_t>(opts.border);
+
+        std::vector<size_t> columns(dim);
+        for (size_t x = 0; x < dim; ++x)
         {
-            wprintf(L"ERROR: cross/strip/gif output only accepts 1 input file\n");
-            return 1;
+            columns[x] = AddressTexel(originX + static_cast<ptrdiff_t>(x), level.width, opts.addressMode) * opts.bpp;
+        }
+
+        for (size_t y = 0; y < dim; ++y)
+        {
+            const uint8_t* pSrc = level.pixels + level.rowPitch * AddressTexel(originY + static_cast<ptrdiff_t>(y), level.height, opts.addressMode);
+            for (size_t x = 0; x < dim; ++x)
+            {
+                memcpy(pDest, pSrc + columns[x], opts.bpp);
+                pDest += opts.bpp;
+            }
+        }
+    }
+
+
+    // Decodes one texture, builds its mip chain in the assembly format, and cuts every level into pages
+    HRESULT CutTexturePages(SPageJob& job, const SAssembleOptions& opts, const SPageOptions& pageOpts, DXGI_FORMAT assemblyFormat)
+    {
+        SAssembleJob& assemble = job.assemble;
+
+        HRESULT hr = GetImageFileMetadata(assemble.pConv->szSrc, opts.dwFilter, assemble.info);
+        if (FAILED(hr))
+        {
+            assemble.failedStep = L"load";
+            return hr;
+        }
+
+        if (assemble.info.arraySize > 1 || assemble.info.IsVolumemap() || assemble.info.IsCubemap())
+        {
+            assemble.failedStep = L"pages need 2D textures";
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+        }
+
+        // Each texture keeps its own size
+        SAssembleOptions textureOpts = opts;
+        textureOpts.width = assemble.info.width;
+        textureOpts.height = assemble.info.height;
+
+        hr = PrepareImage(assemble, textureOpts);
+        if (FAILED(hr))
+            return hr;
+
+        const Image* base = assemble.image->GetImage(0, 0, 0);
+
+        ScratchImage converted;
+        if (base->format != assemblyFormat)
+        {
+            hr = Convert(*base, assemblyFormat, opts.dwFilter | opts.dwFilterOpts | opts.dwSRGB, TEX_THRESHOLD_DEFAULT, converted);
+            if (FAILED(hr))
+            {
+                assemble.failedStep = L"convert";
+                return hr;
+            }
+
+            base = converted.GetImage(0, 0, 0);
+        }
+
+        const size_t levels = CountPageMips(base->width, base->height, pageOpts);
+        if (levels > 1)
+        {
+            hr = GenerateMipMaps(*base, opts.dwFilter | opts.dwFilterOpts, levels, job.mipChain);
+        }
+        else
+        {
+            hr = job.mipChain.InitializeFromImage(*base);
+        }
+        if (FAILED(hr))
+        {
+            assemble.failedStep = L"mips generation";
+            return hr;
+        }
+
+        converted.Release();
+        assemble.image.reset();
+
+        for (size_t level = 0; level < levels; ++level)
+        {
+            const Image* img = job.mipChain.GetImage(level, 0, 0);
+            if (!img)
+            {
+                assemble.failedStep = L"pages";
+                return E_UNEXPECTED;
+            }
+
+            SVirtualMip mip = {};
+            mip.width = img->width;
+            mip.height = img->height;
+            mip.tilesX = (img->width + pageOpts.pageSize - 1) / pageOpts.pageSize;
+            mip.tilesY = (img->height + pageOpts.pageSize - 1) / pageOpts.pageSize;
+            job.mips.push_back(mip);
+
+            for (size_t ty = 0; ty < mip.tilesY; ++ty)
+            {
+                for (size_t tx = 0; tx < mip.tilesX; ++tx)
+                {
+                    std::unique_ptr<uint8_t[]> page(new (std::nothrow) uint8_t[pageOpts.PageBytes()]);
+                    if (!page)
+                    {
+                        assemble.failedStep = L"memory";
+                        return E_OUTOFMEMORY;
+                    }
+
+                    CutPage(*img, tx, ty, pageOpts, page.get());
+
+                    job.hashes.push_back(HashPage(page.get(), pageOpts.PageBytes()));
+                    job.pages.emplace_back(std::move(page));
+                }
+            }
+        }
+
+        return S_OK;
+    }
+
+
+    // Cuts pages for jobs [first, last) on up to 'jobs' threads
+    void CutPagesParallel(std::vector<SPageJob>& pageJobs, size_t first, size_t last,
+        const SAssembleOptions& opts, const SPageOptions& pageOpts, DXGI_FORMAT assemblyFormat, size_t jobs)
+    {
+        std::atomic<size_t> nextJob(first);
+
+        auto worker = [&]()
+        {
+            HRESULT hrCOM = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+            for (;;)
+            {
+                size_t index = nextJob++;
+                if (index >= last)
+                    break;
+
+                SPageJob& job = pageJobs[index];
+                job.assemble.hr = CutTexturePages(job, opts, pageOpts, assemblyFormat);
+                job.assemble.image.reset();
+            }
+
+            if (SUCCEEDED(hrCOM))
+                CoUninitialize();
+        };
+
+        std::vector<std::thread> workers;
+        try
+        {
+            for (size_t j = 1; j < std::min(jobs, last - first); ++j)
+                workers.emplace_back(worker);
+        }
+        catch (const std::exception&)
+        {
+            // Carry on with the threads that were started
+        }
+
+        worker();
+
+        for (auto& t : workers)
+            t.join();
+    }
+
+
+    // CPU sampler: resolves texel (x, y) of a virtual mip level through the page table, as a shader
+    // would, from the page holding tile (tileX, tileY). Returns nullptr outside the page border.
+    const uint8_t* FetchVirtualTexel(const CPagePool& pool, const std::vector<uint32_t>& pageTable, const SVirtualMip& mip,
+        const SPageOptions& opts, size_t tileX, size_t tileY, ptrdiff_t x, ptrdiff_t y)
+    {
+        const auto dim = static_cast<ptrdiff_t>(opts.PageDimension());
+        const ptrdiff_t px = x - static_cast<ptrdiff_t>(tileX * opts.pageSize) + static_cast<ptrdiff_t>(opts.border);
+        const ptrdiff_t py = y - static_cast<ptrdiff_t>(tileY * opts.pageSize) + static_cast<ptrdiff_t>(opts.border);
+        if (px < 0 || py < 0 || px >= dim || py >= dim)
+            return nullptr;
+
+        const uint32_t page = pageTable[mip.firstEntry + tileY * mip.tilesX + tileX];
+        return pool.GetPage(page) + (static_cast<size_t>(py) * opts.PageDimension() + static_cast<size_t>(px)) * opts.bpp;
+    }
+
+
+    // Checks that every bilinear footprint, including those straddling tile edges, reads the same
+    // texels through the page table as it does from the source mip level
+    bool VerifyPages(const CPagePool& pool, const std::vector<uint32_t>& pageTable, const SPageJob& job, const SPageOptions& opts)
+    {
+        for (size_t level = 0; level < job.mips.size(); ++level)
+        {
+            const SVirtualMip& mip = job.mips[level];
+            const Image* img = job.mipChain.GetImage(level, 0, 0);
+            if (!img)
+                return false;
+
+            // Sample positions on texel corners put the footprint's taps at (x-1..x, y-1..y)
+            for (size_t y = 0; y <= mip.height; ++y)
+            {
+                const size_t tileY = std::min(y, mip.height - 1) / opts.pageSize;
+
+                for (size_t x = 0; x <= mip.width; ++x)
+                {
+                    const size_t tileX = std::min(x, mip.width - 1) / opts.pageSize;
+
+                    for (size_t tap = 0; tap < 4; ++tap)
+                    {
+                        const ptrdiff_t sx = static_cast<ptrdiff_t>(x) - ((tap & 1) ? 0 : 1);
+                        const ptrdiff_t sy = static_cast<ptrdiff_t>(y) - ((tap & 2) ? 0 : 1);
+
+                        const uint8_t* pVirtual = FetchVirtualTexel(pool, pageTable, mip, opts, tileX, tileY, sx, sy);
+                        if (!pVirtual)
+                            continue;
+
+                        const uint8_t* pSource = img->pixels
+                            + img->rowPitch * AddressTexel(sy, mip.height, opts.addressMode)
+                            + opts.bpp * AddressTexel(sx, mip.width, opts.addressMode);
+
+                        if (memcmp(pVirtual, pSource, opts.bpp) != 0)
+                            return false;
+                    }
+                }
+            }
+        }
+
+        return true;
+    }
+
+
+    void WriteJsonString(FILE* file, const wchar_t* str)
+    {
+        char utf8[MAX_PATH * 3] = {};
+        if (!WideCharToMultiByte(CP_UTF8, 0, str, -1, utf8, static_cast<int>(sizeof(utf8)), nullptr, nullptr))
+            *utf8 = 0;
+
+        fputc('"', file);
+        for (const char* ptr = utf8; *ptr; ++ptr)
+        {
+            if (*ptr == '"' || *ptr == '\\')
+                fputc('\\', file);
+            fputc(*ptr, file);
+        }
+        fputc('"', file);
+    }
+
+
+    // Describes the page pool, the indirection texture, and where each texture's tiles start in it
+    HRESULT WritePageTable(const wchar_t* szFile, const wchar_t* szPoolFile, const wchar_t* szIndirectionFile,
+        const std::vector<SPageJob>& pageJobs, const SPageOptions& opts, DXGI_FORMAT format,
+        size_t pageCount, size_t poolColumns, size_t poolRows, size_t entries)
+    {
+        FILE* file = nullptr;
+        if (_wfopen_s(&file, szFile, L"wt") || !file)
+            return HRESULT_FROM_WIN32(ERROR_OPEN_FAILED);
+
+        fprintf(file, "{\n");
+        fprintf(file, "  \"pool\": ");
+        WriteJsonString(file, szPoolFile);
+        fprintf(file, ",\n  \"format\": ");
+        const wchar_t* formatName = LookupByValue(static_cast<DWORD>(format), g_pFormats);
+        WriteJsonString(file, (formatName) ? formatName : L"UNKNOWN");
+        fprintf(file, ",\n  \"pageSize\": %zu,\n  \"border\": %zu,\n  \"pageDimension\": %zu,\n",
+            opts.pageSize, opts.border, opts.PageDimension());
+        fprintf(file, "  \"pageCount\": %zu,\n  \"poolColumns\": %zu,\n  \"poolRows\": %zu,\n", pageCount, poolColumns, poolRows);
+        fprintf(file, "  \"indirection\": ");
+        WriteJsonString(file, szIndirectionFile);
+        fprintf(file, ",\n  \"indirectionWidth\": %zu,\n  \"entries\": %zu,\n", std::min(entries, c_IndirectionWidth), entries);
+        fprintf(file, "  \"textures\": [\n");
+
+        for (size_t i = 0; i < pageJobs.size(); ++i)
+        {
+            const SPageJob& job = pageJobs[i];
+
+            fprintf(file, "    {\n      \"name\": ");
+            WriteJsonString(file, job.assemble.pConv->szSrc);
+            fprintf(file, ",\n      \"width\": %zu,\n      \"height\": %zu,\n      \"mips\": [\n",
+                job.assemble.info.width, job.assemble.info.height);
+
+            for (size_t level = 0; level < job.mips.size(); ++level)
+            {
+                const SVirtualMip& mip = job.mips[level];
+                fprintf(file, "        { \"width\": %zu, \"height\": %zu, \"tilesX\": %zu, \"tilesY\": %zu, \"firstEntry\": %zu }%s\n",
+                    mip.width, mip.height, mip.tilesX, mip.tilesY, mip.firstEntry, (level + 1 < job.mips.size()) ? "," : "");
+            }
+
+            fprintf(file, "      ]\n    }%s\n", (i + 1 < pageJobs.size()) ? "," : "");
+        }
+
+        fprintf(file, "  ]\n}\n");
+
+        bool failed = ferror(file) != 0;
+        fclose(file);
+
+        return (failed) ? HRESULT_FROM_WIN32(ERROR_WRITE_FAULT) : S_OK;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Entry-point
+//--------------------------------------------------------------------------------------
+#pragma prefast(disable : 28198, "Command-line tool, frees all memory on exit")
+
+int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
+{
+    // Parameters and defaults
+    size_t width = 0;
+    size_t height = 0;
+
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    DWORD dwFilter = TEX_FILTER_DEFAULT;
+    DWORD dwSRGB = 0;
+    DWORD dwFilterOpts = 0;
+    DWORD fileType = WIC_CODEC_BMP;
+
+    size_t mipLevels = 1;
+    size_t numJobs = 0;
+    size_t pageSize = 128;
+    size_t pageBorder = 4;
+
+    wchar_t szOutputFile[MAX_PATH] = {};
+
+    // Initialize COM (needed for WIC)
+    HRESULT hr = hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    if (FAILED(hr))
+    {
+        wprintf(L"Failed to initialize COM (%08X)\n", hr);
+        return 1;
+    }
+
+    // Process command line
+    if (argc < 2)
+    {
+        PrintUsage();
+        return 0;
+    }
+
+    DWORD dwCommand = LookupByName(argv[1], g_pCommands);
+    switch (dwCommand)
+    {
+    case CMD_CUBE:
+    case CMD_VOLUME:
+    case CMD_ARRAY:
+    case CMD_CUBEARRAY:
+    case CMD_H_CROSS:
+    case CMD_V_CROSS:
+    case CMD_H_STRIP:
+    case CMD_V_STRIP:
+    case CMD_MERGE:
+    case CMD_GIF:
+    case CMD_PAGES:
+        break;
+
+    default:
+        wprintf(L"Must use one of: cube, volume, array, cubearray,\n   h-cross, v-cross, h-strip, v-strip\n   merge, gif, pages\n\n");
+        return 1;
+    }
+
+    DWORD dwOptions = 0;
+    std::list<SConversion> conversion;
+
+    for (int iArg = 2; iArg < argc; iArg++)
+    {
+        PWSTR pArg = argv[iArg];
+
+        if (('-' == pArg[0]) || ('/' == pArg[0]))
+        {
+            pArg++;
+            PWSTR pValue;
+
+            for (pValue = pArg; *pValue && (':' != *pValue); pValue++);
+
+            if (*pValue)
+                *pValue++ = 0;
+
+            DWORD dwOption = LookupByName(pArg, g_pOptions);
+
+            if (!dwOption || (dwOptions & (1 << dwOption)))
+            {
+                PrintUsage();
+                return 1;
+            }
+
+            dwOptions |= 1 << dwOption;
+
+            // Handle options with additional value parameter
+            switch (dwOption)
+            {
+            case OPT_WIDTH:
+            case OPT_HEIGHT:
+            case OPT_FORMAT:
+            case OPT_FILTER:
+            case OPT_OUTPUTFILE:
+            case OPT_FILELIST:
+            case OPT_MIPLEVELS:
+            case OPT_JOBS:
+            case OPT_PAGE_SIZE:
+            case OPT_PAGE_BORDER:
+                if (!*pValue)
+                {
+                    if ((iArg + 1 >= argc))
+                    {
+                        PrintUsage();
+                        return 1;
+                    }
+
+                    iArg++;
+                    pValue = argv[iArg];
+                }
+            }
+
+            switch (dwOption)
+            {
+            case OPT_WIDTH:
+                if (swscanf_s(pValue, L"%zu", &width) != 1)
+                {
+                    wprintf(L"Invalid value specified with -w (%ls)\n", pValue);
+                    return 1;
+                }
+                break;
+
+            case OPT_HEIGHT:
+                if (swscanf_s(pValue, L"%zu", &height) != 1)
+                {
+                    wprintf(L"Invalid value specified with -h (%ls)\n", pValue);
+                    return 1;
+                }
+                break;
+
+            case OPT_FORMAT:
+                format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormats));
+                if (!format)
+                {
+                    format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormatAliases));
+                    if (!format)
+                    {
+                        wprintf(L"Invalid value specified with -f (%ls)\n", pValue);
+                        return 1;
+                    }
+                }
+                break;
+
+            case OPT_FILTER:
+                dwFilter = LookupByName(pValue, g_pFilters);
+                if (!dwFilter)
+                {
+                    wprintf(L"Invalid value specified with -if (%ls)\n", pValue);
+                    return 1;
+                }
+                break;
+
+            case OPT_SRGBI:
+                dwSRGB |= TEX_FILTER_SRGB_IN;
+                break;
+
+            case OPT_SRGBO:
+                dwSRGB |= TEX_FILTER_SRGB_OUT;
+                break;
+
+            case OPT_SRGB:
+                dwSRGB |= TEX_FILTER_SRGB;
+                break;
+
+            case OPT_SEPALPHA:
+                dwFilterOpts |= TEX_FILTER_SEPARATE_ALPHA;
+                break;
+
+            case OPT_NO_WIC:
+                dwFilterOpts |= TEX_FILTER_FORCE_NON_WIC;
+                break;
+
+            case OPT_OUTPUTFILE:
+            {
+                wcscpy_s(szOutputFile, MAX_PATH, pValue);
+
+                wchar_t ext[_MAX_EXT];
+                _wsplitpath_s(szOutputFile, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT);
+
+                fileType = LookupByName(ext, g_pExtFileTypes);
+
+                switch (dwCommand)
+                {
+                case CMD_H_CROSS:
+                case CMD_V_CROSS:
+                case CMD_H_STRIP:
+                case CMD_V_STRIP:
+                case CMD_MERGE:
+                    break;
+
+                default:
+                    if (fileType != CODEC_DDS)
+                    {
+                        wprintf(L"Assembled output file must be a dds\n");
+                        return 1;
+                    }
+                }
+                break;
+            }
+
+            case OPT_TA_WRAP:
+                if (dwFilterOpts & TEX_FILTER_MIRROR)
+                {
+                    wprintf(L"Can't use -wrap and -mirror at same time\n\n");
+                    PrintUsage();
+                    return 1;
+                }
+                dwFilterOpts |= TEX_FILTER_WRAP;
+                break;
+
+            case OPT_TA_MIRROR:
+                if (dwFilterOpts & TEX_FILTER_WRAP)
+                {
+                    wprintf(L"Can't use -wrap and -mirror at same time\n\n");
+                    PrintUsage();
+                    return 1;
+                }
+                dwFilterOpts |= TEX_FILTER_MIRROR;
+                break;
+
+            case OPT_FILELIST:
+                {
+                    std::wifstream inFile(pValue);
+                    if (!inFile)
+                    {
+                        wprintf(L"Error opening -flist file %ls\n", pValue);
+                        return 1;
+                    }
+                    wchar_t fname[1024] = {};
+                    for (;;)
+                    {
+                        inFile >> fname;
+                        if (!inFile)
+                            break;
+
+                        if (*fname == L'#')
+                        {
+                            // Comment
+                        }
+                        else if (*fname == L'-')
+                        {
+                            wprintf(L"Command-line arguments not supported in -flist file\n");
+                            return 1;
+                        }
+                        else if (wcspbrk(fname, L"?*") != nullptr)
+                        {
+                            wprintf(L"Wildcards not supported in -flist file\n");
+                            return 1;
+                        }
+                        else
+                        {
+                            SConversion conv;
+                            wcscpy_s(conv.szSrc, MAX_PATH, fname);
+                            conversion.push_back(conv);
+                        }
+
+                        inFile.ignore(1000, '\n');
+                    }
+                    inFile.close();
+                }
+                break;
+
+            case OPT_GIF_BGCOLOR:
+                if (dwCommand != CMD_GIF)
+                {
+                    wprintf(L"-bgcolor only applies to gif command\n");
+                    return 1;
+                }
+                break;
+
+            case OPT_MIPLEVELS:
+                switch (dwCommand)
+                {
+                case CMD_CUBE:
+                case CMD_VOLUME:
+                case CMD_ARRAY:
+                case CMD_CUBEARRAY:
+                case CMD_PAGES:
+                    break;
+
+                default:
+                    wprintf(L"-m only applies to cube, volume, array, cubearray, and pages commands\n");
+                    return 1;
+                }
+
+                if (swscanf_s(pValue, L"%zu", &mipLevels) != 1)
+                {
+                    wprintf(L"Invalid value specified with -m (%ls)\n", pValue);
+                    return 1;
+                }
+                break;
+
+            case OPT_JOBS:
+                if (swscanf_s(pValue, L"%zu", &numJobs) != 1 || !numJobs)
+                {
+                    wprintf(L"Invalid value specified with -j (%ls)\n", pValue);
+                    return 1;
+                }
+                break;
+
+            case OPT_PAGE_SIZE:
+            case OPT_PAGE_BORDER:
+                if (dwCommand != CMD_PAGES)
+                {
+                    wprintf(L"-page and -border only apply to pages command\n");
+                    return 1;
+                }
+
+                if (dwOption == OPT_PAGE_SIZE)
+                {
+                    if (swscanf_s(pValue, L"%zu", &pageSize) != 1 || pageSize < 4 || (pageSize & (pageSize - 1)) != 0)
+                    {
+                        wprintf(L"Invalid value specified with -page (%ls)\n", pValue);
+                        return 1;
+                    }
+                }
+                else if (swscanf_s(pValue, L"%zu", &pageBorder) != 1 || pageBorder > 64)
+                {
+                    wprintf(L"Invalid value specified with -border (%ls)\n", pValue);
+                    return 1;
+                }
+                break;
+            }
+        }
+        else if (wcspbrk(pArg, L"?*") != nullptr)
+        {
+            size_t count = conversion.size();
+            SearchForFiles(pArg, conversion, (dwOptions & (1 << OPT_RECURSIVE)) != 0);
+            if (conversion.size() <= count)
+            {
+                wprintf(L"No matching files found for %ls\n", pArg);
+                return 1;
+            }
+        }
+        else
+        {
+            SConversion conv;
+            wcscpy_s(conv.szSrc, MAX_PATH, pArg);
+
+            conversion.push_back(conv);
+        }
+    }
+
+    if (conversion.empty())
+    {
+        PrintUsage();
+        return 0;
+    }
+
+    if (~dwOptions & (1 << OPT_NOLOGO))
+        PrintLogo();
+
+    switch (dwCommand)
+    {
+    case CMD_H_CROSS:
+    case CMD_V_CROSS:
+    case CMD_H_STRIP:
+    case CMD_V_STRIP:
+    case CMD_GIF:
+        if (conversion.size() > 1)
+        {
+            wprintf(L"ERROR: cross/strip/gif output only accepts 1 input file\n");
+            return 1;
+        }
+        break;
+
+    case CMD_MERGE:
+        if (conversion.size() > 2)
+        {
+            wprintf(L"ERROR: merge output only accepts 2 input files\n");
+            return 1;
+        }
+        break;
+    }
+
+    // --- Virtual texture pages -------------------------------------------------------
+    if (dwCommand == CMD_PAGES)
+    {
+        if (!*szOutputFile)
+        {
+            wprintf(L"ERROR: Need to specify output file via -o\n");
+            return 1;
+        }
+
+        wchar_t drive[_MAX_DRIVE];
+        wchar_t dir[_MAX_DIR];
+        wchar_t fname[_MAX_FNAME];
+        _wsplitpath_s(szOutputFile, drive, _MAX_DRIVE, dir, _MAX_DIR, fname, _MAX_FNAME, nullptr, 0);
+
+        wchar_t szTableFile[MAX_PATH];
+        _wmakepath_s(szTableFile, drive, dir, fname, L".json");
+
+        wchar_t szIndirectionName[_MAX_FNAME];
+        swprintf_s(szIndirectionName, L"%ls_indirection", fname);
+
+        wchar_t szIndirectionFile[MAX_PATH];
+        _wmakepath_s(szIndirectionFile, drive, dir, szIndirectionName, L".dds");
+
+        if (~dwOptions & (1 << OPT_OVERWRITE))
+        {
+            if (GetFileAttributesW(szOutputFile) != INVALID_FILE_ATTRIBUTES
+                || GetFileAttributesW(szTableFile) != INVALID_FILE_ATTRIBUTES
+                || GetFileAttributesW(szIndirectionFile) != INVALID_FILE_ATTRIBUTES)
+            {
+                wprintf(L"\nERROR: Output file already exists, use -y to overwrite\n");
+                return 1;
+            }
+        }
+
+        std::vector<SPageJob> pageJobs(conversion.size());
+        {
+            auto pConv = conversion.cbegin();
+            for (auto& job : pageJobs)
+            {
+                job.assemble.pConv = &(*pConv);
+                ++pConv;
+            }
+        }
+
+        if (format == DXGI_FORMAT_UNKNOWN)
+        {
+            TexMetadata info;
+            hr = GetImageFileMetadata(pageJobs[0].assemble.pConv->szSrc, dwFilter, info);
+            if (FAILED(hr))
+            {
+                wprintf(L"reading %ls FAILED (%x)\n", pageJobs[0].assemble.pConv->szSrc, hr);
+                return 1;
+            }
+
+            if (IsPlanar(info.format) || IsVideo(info.format) || IsTypeless(info.format))
+            {
+                wprintf(L"ERROR: Specify the page format via -f\n");
+                return 1;
+            }
+
+            format = info.format;
+        }
+
+        const DXGI_FORMAT assemblyFormat = GetAssemblyFormat(format);
+        if (IsPacked(assemblyFormat) || IsVideo(assemblyFormat) || (BitsPerPixel(assemblyFormat) % 8) != 0)
+        {
+            wprintf(L"ERROR: Format not supported for pages\n");
+            return 1;
+        }
+
+        SAssembleOptions opts = {};
+        opts.dwCommand = dwCommand;
+        opts.dwOptions = dwOptions;
+        opts.dwFilter = dwFilter;
+        opts.dwSRGB = dwSRGB;
+        opts.dwFilterOpts = dwFilterOpts;
+
+        SPageOptions pageOpts = {};
+        pageOpts.pageSize = pageSize;
+        pageOpts.border = pageBorder;
+        pageOpts.mipLevels = (dwOptions & (1 << OPT_MIPLEVELS)) ? mipLevels : 0;
+        pageOpts.bpp = BitsPerPixel(assemblyFormat) / 8;
+        pageOpts.addressMode = dwFilterOpts & (TEX_FILTER_WRAP | TEX_FILTER_MIRROR);
+
+        const size_t pageDim = pageOpts.PageDimension();
+        if (IsCompressed(format) && (pageDim % 4) != 0)
+        {
+            wprintf(L"ERROR: Page size plus borders must be a multiple of 4 for block compression\n");
+            return 1;
+        }
+
+        size_t jobs = (numJobs) ? numJobs : std::thread::hardware_concurrency();
+        jobs = std::max<size_t>(1, jobs);
+
+        // Textures are cut a batch at a time and merged in input order, so page numbering does not
+        // depend on thread timing and only one batch of mip chains is held for verification
+        CPagePool pool(pageOpts.PageBytes());
+        std::vector<uint32_t> pageTable;
+        size_t tiles = 0;
+
+        for (size_t first = 0; first < pageJobs.size(); first += jobs * 2)
+        {
+            const size_t last = std::min(first + jobs * 2, pageJobs.size());
+
+            CutPagesParallel(pageJobs, first, last, opts, pageOpts, assemblyFormat, jobs);
+
+            for (size_t i = first; i < last; ++i)
+            {
+                SPageJob& job = pageJobs[i];
+
+                wprintf(L"reading %ls", job.assemble.pConv->szSrc);
+
+                if (FAILED(job.assemble.hr))
+                {
+                    wprintf(L" FAILED [%ls] (%x)\n", (job.assemble.failedStep) ? job.assemble.failedStep : L"", job.assemble.hr);
+                    return 1;
+                }
+
+                PrintInfo(job.assemble.sourceInfo);
+
+                if (job.assemble.warning)
+                    wprintf(L"\nWARNING: %ls", job.assemble.warning);
+
+                size_t page = 0;
+                for (auto& mip : job.mips)
+                {
+                    mip.firstEntry = pageTable.size();
+
+                    for (size_t tile = 0; tile < mip.tilesX * mip.tilesY; ++tile, ++page)
+                    {
+                        pageTable.push_back(pool.Add(job.pages[page], job.hashes[page]));
+                    }
+                }
+
+                tiles += page;
+
+                if (!VerifyPages(pool, pageTable, job, pageOpts))
+                {
+                    wprintf(L"\nERROR: Page table lookup does not match the source texels\n");
+                    return 1;
+                }
+
+                wprintf(L" %zu tiles\n", page);
+
+                job.pages.clear();
+                job.hashes.clear();
+                job.mipChain.Release();
+            }
+        }
+
+        // --- Assemble the page pool --------------------------------------------------
+        const size_t pageCount = pool.GetPageCount();
+        const size_t maxColumns = c_MaxPoolDimension / pageDim;
+
+        size_t poolColumns = 1;
+        while (poolColumns * poolColumns < pageCount)
+            ++poolColumns;
+        poolColumns = std::min(poolColumns, maxColumns);
+
+        const size_t poolRows = (pageCount + poolColumns - 1) / poolColumns;
+        if (poolRows * pageDim > c_MaxPoolDimension)
+        {
+            wprintf(L"\nERROR: %zu pages do not fit in a %zu x %zu pool, use a larger -page or fewer inputs\n",
+                pageCount, c_MaxPoolDimension, c_MaxPoolDimension);
+            return 1;
+        }
+
+        std::unique_ptr<ScratchImage> result(new (std::nothrow) ScratchImage);
+        if (!result)
+        {
+            wprintf(L"\nERROR: Memory allocation failed\n");
+            return 1;
+        }
+
+        hr = result->Initialize2D(assemblyFormat, poolColumns * pageDim, poolRows * pageDim, 1, 1);
+        if (FAILED(hr))
+        {
+            wprintf(L"FAILED setting up result image (%x)\n", hr);
+            return 1;
+        }
+
+        {
+            const Image* img = result->GetImage(0, 0, 0);
+            memset(img->pixels, 0, img->slicePitch);
+
+            const size_t rowBytes = pageDim * pageOpts.bpp;
+            for (size_t page = 0; page < pageCount; ++page)
+            {
+                const uint8_t* pSrc = pool.GetPage(page);
+                uint8_t* pDest = img->pixels
+                    + img->rowPitch * (page / poolColumns) * pageDim
+                    + rowBytes * (page % poolColumns);
+
+                for (size_t y = 0; y < pageDim; ++y)
+                {
+                    memcpy(pDest, pSrc, rowBytes);
+                    pSrc += rowBytes;
+                    pDest += img->rowPitch;
+                }
+            }
+        }
+
+        if (IsCompressed(format))
+        {
+            std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+            if (!timage)
+            {
+                wprintf(L"\nERROR: Memory allocation failed\n");
+                return 1;
+            }
+
+            hr = Compress(*result->GetImage(0, 0, 0), format, TEX_COMPRESS_DEFAULT | TEX_COMPRESS_PARALLEL | dwSRGB, TEX_THRESHOLD_DEFAULT, *timage);
+            if (FAILED(hr))
+            {
+                wprintf(L" FAILED [compress] (%x)\n", hr);
+                return 1;
+            }
+
+            result.swap(timage);
+        }
+
+        // --- Indirection texture -----------------------------------------------------
+        const size_t indirectionWidth = std::min(pageTable.size(), c_IndirectionWidth);
+        const size_t indirectionHeight = (pageTable.size() + indirectionWidth - 1) / indirectionWidth;
+
+        ScratchImage indirection;
+        hr = indirection.Initialize2D(DXGI_FORMAT_R32_UINT, indirectionWidth, indirectionHeight, 1, 1);
+        if (FAILED(hr))
+        {
+            wprintf(L"FAILED setting up indirection image (%x)\n", hr);
+            return 1;
+        }
+
+        {
+            const Image* img = indirection.GetImage(0, 0, 0);
+            for (size_t y = 0; y < indirectionHeight; ++y)
+            {
+                auto pDest = reinterpret_cast<uint32_t*>(img->pixels + img->rowPitch * y);
+                for (size_t x = 0; x < indirectionWidth; ++x)
+                {
+                    const size_t entry = y * indirectionWidth + x;
+                    pDest[x] = (entry < pageTable.size()) ? pageTable[entry] : UINT32_MAX;
+                }
+            }
+        }
+
+        // Write pool, indirection, and page table
+        wprintf(L"\n%zu tiles in %zu unique pages (%zu x %zu pool)\n", tiles, pageCount, poolColumns, poolRows);
+        wprintf(L"\nWriting %ls ", szOutputFile);
+        PrintInfo(result->GetMetadata());
+        wprintf(L"\n");
+        fflush(stdout);
+
+        hr = SaveToDDSFile(result->GetImages(), result->GetImageCount(), result->GetMetadata(),
+            (dwOptions & (1 << OPT_USE_DX10)) ? (DDS_FLAGS_FORCE_DX10_EXT | DDS_FLAGS_FORCE_DX10_EXT_MISC2) : DDS_FLAGS_NONE,
+            szOutputFile);
+        if (FAILED(hr))
+        {
+            wprintf(L"\nFAILED (%x)\n", hr);
+            return 1;
+        }
+
+        wprintf(L"Writing %ls\n", szIndirectionFile);
+        hr = SaveToDDSFile(*indirection.GetImage(0, 0, 0), DDS_FLAGS_NONE, szIndirectionFile);
+        if (FAILED(hr))
+        {
+            wprintf(L"\nFAILED (%x)\n", hr);
+            return 1;
+        }
+
+        wprintf(L"Writing %ls\n", szTableFile);
+        hr = WritePageTable(szTableFile, szOutputFile, szIndirectionFile, pageJobs, pageOpts, format,
+            pageCount, poolColumns, poolRows, pageTable.size());
+        if (FAILED(hr))
+        {
+            wprintf(L"\nFAILED (%x)\n", hr);
+            return 1;
+        }
+
+        return 0;
+    }
+
+    // --- Fast assembly ---------------------------------------------------------------
+    switch (dwCommand)
+    {
+    case CMD_CUBE:
+    case CMD_VOLUME:
+    case CMD_ARRAY:
+    case CMD_CUBEARRAY:
+    {
+        if (!*szOutputFile)
+        {
+            wchar_t ext[_MAX_EXT];
+            wchar_t fname[_MAX_FNAME];
+            _wsplitpath_s(conversion.front().szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT);
+
+            if (_wcsicmp(ext, L".dds") == 0)
+            {
+                wprintf(L"ERROR: Need to specify output file via -o\n");
+                return 1;
+            }
+
+            _wmakepath_s(szOutputFile, nullptr, nullptr, fname, L".dds");
+        }
+
+        // Only the headers are read up front to lay out the destination
+        std::vector<SAssembleJob> assembleJobs(conversion.size());
+        size_t images = 0;
+        {
+            auto pConv = conversion.cbegin();
+            for (auto& job : assembleJobs)
+            {
+                job.pConv = &(*pConv);
+                ++pConv;
+
+                hr = GetImageFileMetadata(job.pConv->szSrc, dwFilter, job.info);
+                if (FAILED(hr))
+                {
+                    wprintf(L"reading %ls FAILED (%x)\n", job.pConv->szSrc, hr);
+                    return 1;
+                }
+
+                job.firstIndex = images;
+                images += job.info.arraySize;
+            }
+        }
+
+        switch (dwCommand)
+        {
+        case CMD_CUBE:
+            if (images != 6)
+            {
+                wprintf(L"\nERROR: cube requires six images to form the faces of the cubemap\n");
+                return 1;
+            }
+            break;
+
+        case CMD_CUBEARRAY:
+            if ((images < 6) || (images % 6) != 0)
+            {
+                wprintf(L"cubearray requires a multiple of 6 images to form the faces of the cubemaps\n");
+                return 1;
+            }
+            break;
+
+        default:
+            if (images < 2)
+            {
+                wprintf(L"\nERROR: Need at least 2 images to assemble\n\n");
+                return 1;
+            }
+            break;
+        }
+
+        SAssembleOptions opts = {};
+        opts.dwCommand = dwCommand;
+        opts.dwOptions = dwOptions;
+        opts.dwFilter = dwFilter;
+        opts.dwSRGB = dwSRGB;
+        opts.dwFilterOpts = dwFilterOpts;
+        opts.width = (width) ? width : assembleJobs[0].info.width;
+        opts.height = (height) ? height : assembleJobs[0].info.height;
+
+        const size_t depth = (dwCommand == CMD_VOLUME) ? images : 1;
+        const size_t maxMips = CountMips(opts.width, opts.height, depth);
+        opts.mipLevels = (mipLevels) ? mipLevels : maxMips;
+        if (opts.mipLevels > maxMips)
+        {
+            wprintf(L"ERROR: Too many miplevels specified with -m (%zu maximum)\n", maxMips);
+            return 1;
+        }
+
+        if (format == DXGI_FORMAT_UNKNOWN)
+        {
+            SAssembleJob& first = assembleJobs[0];
+            if (IsCompressed(first.info.format) || IsPlanar(first.info.format))
+            {
+                // The decoded format is only known once the first image is prepared
+                first.hr = PrepareImage(first, opts);
+                if (FAILED(first.hr))
+                {
+                    wprintf(L"reading %ls FAILED [%ls] (%x)\n", first.pConv->szSrc, first.failedStep, first.hr);
+                    return 1;
+                }
+
+                format = first.image->GetMetadata().format;
+            }
+            else
+            {
+                format = first.info.format;
+            }
+        }
+
+        const DXGI_FORMAT assemblyFormat = GetAssemblyFormat(format);
+
+        std::unique_ptr<ScratchImage> result(new (std::nothrow) ScratchImage);
+        if (!result)
+        {
+            wprintf(L"\nERROR: Memory allocation failed\n");
+            return 1;
+        }
+
+        switch (dwCommand)
+        {
+        case CMD_VOLUME:
+            // Volume mips need every slice, so they are generated after assembly
+            hr = result->Initialize3D(assemblyFormat, opts.width, opts.height, images, 1);
+            break;
+
+        case CMD_ARRAY:
+            if (opts.height == 1 && (dwOptions & (1 << OPT_USE_DX10)))
+                hr = result->Initialize1D(assemblyFormat, opts.width, images, opts.mipLevels);
+            else
+                hr = result->Initialize2D(assemblyFormat, opts.width, opts.height, images, opts.mipLevels);
+            break;
+
+        default:
+            hr = result->InitializeCube(assemblyFormat, opts.width, opts.height, images / 6, opts.mipLevels);
+            break;
+        }
+
+        if (FAILED(hr))
+        {
+            wprintf(L"FAILED setting up result image (%x)\n", hr);
+            return 1;
+        }
+
+        size_t jobs = (numJobs) ? numJobs : std::thread::hardware_concurrency();
+        jobs = std::max<size_t>(1, std::min(jobs, assembleJobs.size()));
+
+        AssembleImages(assembleJobs, opts, *result, jobs);
+
+        for (auto it = assembleJobs.cbegin(); it != assembleJobs.cend(); ++it)
+        {
+            if (it != assembleJobs.cbegin())
+                wprintf(L"\n");
+
+            wprintf(L"reading %ls", it->pConv->szSrc);
+
+            if (FAILED(it->hr))
+            {
+                wprintf(L" FAILED [%ls] (%x)\n", (it->failedStep) ? it->failedStep : L"", it->hr);
+                return 1;
+            }
+
+            PrintInfo(it->sourceInfo);
+
+            if (it->warning)
+                wprintf(L"\nWARNING: %ls\n", it->warning);
+        }
+
+        // --- Generate mips (volume) --------------------------------------------------
+        if (dwCommand == CMD_VOLUME && opts.mipLevels > 1)
+        {
+            std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+            if (!timage)
+            {
+                wprintf(L"\nERROR: Memory allocation failed\n");
+                return 1;
+            }
+
+            hr = GenerateMipMaps3D(result->GetImages(), images, dwFilter | dwFilterOpts, opts.mipLevels, *timage);
+            if (FAILED(hr))
+            {
+                wprintf(L" FAILED [mipmaps] (%x)\n", hr);
+                return 1;
+            }
+
+            result.swap(timage);
+        }
+
+        // --- Compress ----------------------------------------------------------------
+        if (IsCompressed(format))
+        {
+            std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+            if (!timage)
+            {
+                wprintf(L"\nERROR: Memory allocation failed\n");
+                return 1;
+            }
+
+            hr = Compress(result->GetImages(), result->GetImageCount(), result->GetMetadata(), format,
+                TEX_COMPRESS_DEFAULT | TEX_COMPRESS_PARALLEL | dwSRGB, TEX_THRESHOLD_DEFAULT, *timage);
+            if (FAILED(hr))
+            {
+                wprintf(L" FAILED [compress] (%x)\n", hr);
+                return 1;
+            }
+
+            result.swap(timage);
+        }
+
+        // Write texture
+        wprintf(L"\nWriting %ls ", szOutputFile);
+        PrintInfo(result->GetMetadata());
+        wprintf(L"\n");
+        fflush(stdout);
+
+        if (~dwOptions & (1 << OPT_OVERWRITE))
+        {
+            if (GetFileAttributesW(szOutputFile) != INVALID_FILE_ATTRIBUTES)
+            {
+                wprintf(L"\nERROR: Output file already exists, use -y to overwrite\n");
+                return 1;
+            }
         }
-        break;
 
-    case CMD_MERGE:
-        if (conversion.size() > 2)
+        hr = SaveToDDSFile(result->GetImages(), result->GetImageCount(), result->GetMetadata(),
+            (dwOptions & (1 << OPT_USE_DX10)) ? (DDS_FLAGS_FORCE_DX10_EXT | DDS_FLAGS_FORCE_DX10_EXT_MISC2) : DDS_FLAGS_NONE,
+            szOutputFile);
+        if (FAILED(hr))
         {
-            wprintf(L"ERROR: merge output only accepts 2 input files\n");
+            wprintf(L"\nFAILED (%x)\n", hr);
             return 1;
         }
-        break;
+
+        return 0;
+    }
     }
 
     // Convert images
@@ -1252,6 +2821,15 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
     }
     else
     {
+        SAssembleOptions opts = {};
+        opts.dwCommand = dwCommand;
+        opts.dwOptions = dwOptions;
+        opts.dwFilter = dwFilter;
+        opts.dwSRGB = dwSRGB;
+        opts.dwFilterOpts = dwFilterOpts;
+        opts.width = width;
+        opts.height = height;
+
         for (auto pConv = conversion.begin(); pConv != conversion.end(); ++pConv)
         {
             wchar_t ext[_MAX_EXT];
@@ -1287,356 +2865,29 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             wprintf(L"reading %ls", pConv->szSrc);
             fflush(stdout);
 
-            TexMetadata info;
-            std::unique_ptr<ScratchImage> image(new (std::nothrow) ScratchImage);
-            if (!image)
-            {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
-            }
-
-            switch (dwCommand)
-            {
-            case CMD_H_CROSS:
-            case CMD_V_CROSS:
-            case CMD_H_STRIP:
-            case CMD_V_STRIP:
-                if (_wcsicmp(ext, L".dds") == 0)
-                {
-                    hr = LoadFromDDSFile(pConv->szSrc, DDS_FLAGS_NONE, &info, *image);
-                    if (FAILED(hr))
-                    {
-                        wprintf(L" FAILED (%x)\n", hr);
-                        return 1;
-                    }
-
-                    if (!info.IsCubemap())
-                    {
-                        wprintf(L"\nERROR: Input must be a cubemap\n");
-                        return 1;
-                    }
-                    else if (info.arraySize != 6)
-                    {
-                        wprintf(L"\nWARNING: Only the first cubemap in an array is written out as a cross/strip\n");
-                    }
-                }
-                else
-                {
-                    wprintf(L"\nERROR: Input must be a dds of a cubemap\n");
-                    return 1;
-                }
-                break;
-
-            default:
-                if (_wcsicmp(ext, L".dds") == 0)
-                {
-                    hr = LoadFromDDSFile(pConv->szSrc, DDS_FLAGS_NONE, &info, *image);
-                    if (FAILED(hr))
-                    {
-                        wprintf(L" FAILED (%x)\n", hr);
-                        return 1;
-                    }
-
-                    if (info.mipLevels > 1
-                        || info.IsVolumemap()
-                        || info.IsCubemap())
-                    {
-                        wprintf(L"\nERROR: Can't assemble complex surfaces\n");
-                        return 1;
-                    }
-                }
-                else if (_wcsicmp(ext, L".tga") == 0)
-                {
-                    hr = LoadFromTGAFile(pConv->szSrc, &info, *image);
-                    if (FAILED(hr))
-                    {
-                        wprintf(L" FAILED (%x)\n", hr);
-                        return 1;
-                    }
-                }
-                else if (_wcsicmp(ext, L".hdr") == 0)
-                {
-                    hr = LoadFromHDRFile(pConv->szSrc, &info, *image);
-                    if (FAILED(hr))
-                    {
-                        wprintf(L" FAILED (%x)\n", hr);
-                        return 1;
-                    }
-                }
-#ifdef USE_OPENEXR
-                else if (_wcsicmp(ext, L".exr") == 0)
-                {
-                    hr = LoadFromEXRFile(pConv->szSrc, &info, *image);
-                    if (FAILED(hr))
-                    {
-                        wprintf(L" FAILED (%x)\n", hr);
-                        continue;
-                    }
-                }
-#endif
-                else
-                {
-                    // WIC shares the same filter values for mode and dither
-                    static_assert(WIC_FLAGS_DITHER == TEX_FILTER_DITHER, "WIC_FLAGS_* & TEX_FILTER_* should match");
-                    static_assert(WIC_FLAGS_DITHER_DIFFUSION == TEX_FILTER_DITHER_DIFFUSION, "WIC_FLAGS_* & TEX_FILTER_* should match");
-                    static_assert(WIC_FLAGS_FILTER_POINT == TEX_FILTER_POINT, "WIC_FLAGS_* & TEX_FILTER_* should match");
-                    static_assert(WIC_FLAGS_FILTER_LINEAR == TEX_FILTER_LINEAR, "WIC_FLAGS_* & TEX_FILTER_* should match");
-                    static_assert(WIC_FLAGS_FILTER_CUBIC == TEX_FILTER_CUBIC, "WIC_FLAGS_* & TEX_FILTER_* should match");
-                    static_assert(WIC_FLAGS_FILTER_FANT == TEX_FILTER_FANT, "WIC_FLAGS_* & TEX_FILTER_* should match");
-
-                    hr = LoadFromWICFile(pConv->szSrc, dwFilter | WIC_FLAGS_ALL_FRAMES, &info, *image);
-                    if (FAILED(hr))
-                    {
-                        wprintf(L" FAILED (%x)\n", hr);
-                        return 1;
-                    }
-                }
-                break;
-            }
-
-            PrintInfo(info);
-
-            // Convert texture
-            fflush(stdout);
-
-            // --- Planar ------------------------------------------------------------------
-            if (IsPlanar(info.format))
-            {
-                auto img = image->GetImage(0, 0, 0);
-                assert(img);
-                size_t nimg = image->GetImageCount();
-
-                std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
-                if (!timage)
-                {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
-                    return 1;
-                }
-
-                hr = ConvertToSinglePlane(img, nimg, info, *timage);
-                if (FAILED(hr))
-                {
-                    wprintf(L" FAILED [converttosingleplane] (%x)\n", hr);
-                    continue;
-                }
-
-                auto& tinfo = timage->GetMetadata();
-
-                info.format = tinfo.format;
-
-                assert(info.width == tinfo.width);
-                assert(info.height == tinfo.height);
-                assert(info.depth == tinfo.depth);
-                assert(info.arraySize == tinfo.arraySize);
-                assert(info.mipLevels == tinfo.mipLevels);
-                assert(info.miscFlags == tinfo.miscFlags);
-                assert(info.dimension == tinfo.dimension);
-
-                image.swap(timage);
-            }
-
-            // --- Decompress --------------------------------------------------------------
-            if (IsCompressed(info.format))
-            {
-                const Image* img = image->GetImage(0, 0, 0);
-                assert(img);
-                size_t nimg = image->GetImageCount();
-
-                std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
-                if (!timage)
-                {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
-                    return 1;
-                }
-
-                hr = Decompress(img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, *timage.get());
-                if (FAILED(hr))
-                {
-                    wprintf(L" FAILED [decompress] (%x)\n", hr);
-                    continue;
-                }
-
-                const TexMetadata& tinfo = timage->GetMetadata();
-
-                info.format = tinfo.format;
-
-                assert(info.width == tinfo.width);
-                assert(info.height == tinfo.height);
-                assert(info.depth == tinfo.depth);
-                assert(info.arraySize == tinfo.arraySize);
-                assert(info.mipLevels == tinfo.mipLevels);
-                assert(info.miscFlags == tinfo.miscFlags);
-                assert(info.dimension == tinfo.dimension);
-
-                image.swap(timage);
-            }
-
-            // --- Undo Premultiplied Alpha (if requested) ---------------------------------
-            if ((dwOptions & (1 << OPT_DEMUL_ALPHA))
-                && HasAlpha(info.format)
-                && info.format != DXGI_FORMAT_A8_UNORM)
-            {
-                if (info.GetAlphaMode() == TEX_ALPHA_MODE_STRAIGHT)
-                {
-                    printf("\nWARNING: Image is already using straight alpha\n");
-                }
-                else if (!info.IsPMAlpha())
-                {
-                    printf("\nWARNING: Image is not using premultipled alpha\n");
-                }
-                else
-                {
-                    auto img = image->GetImage(0, 0, 0);
-                    assert(img);
-                    size_t nimg = image->GetImageCount();
-
-                    std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
-                    if (!timage)
-                    {
-                        wprintf(L"\nERROR: Memory allocation failed\n");
-                        return 1;
-                    }
-
-                    hr = PremultiplyAlpha(img, nimg, info, TEX_PMALPHA_REVERSE | dwSRGB, *timage);
-                    if (FAILED(hr))
-                    {
-                        wprintf(L" FAILED [demultiply alpha] (%x)\n", hr);
-                        continue;
-                    }
-
-                    auto& tinfo = timage->GetMetadata();
-                    info.miscFlags2 = tinfo.miscFlags2;
-
-                    assert(info.width == tinfo.width);
-                    assert(info.height == tinfo.height);
-                    assert(info.depth == tinfo.depth);
-                    assert(info.arraySize == tinfo.arraySize);
-                    assert(info.mipLevels == tinfo.mipLevels);
-                    assert(info.miscFlags == tinfo.miscFlags);
-                    assert(info.dimension == tinfo.dimension);
-
-                    image.swap(timage);
-                }
-            }
+            SAssembleJob job;
+            job.pConv = &(*pConv);
 
-            // --- Resize ------------------------------------------------------------------
-            if (!width)
-            {
-                width = info.width;
-            }
-            if (!height)
-            {
-                height = info.height;
-            }
-            if (info.width != width || info.height != height)
+            hr = PrepareImage(job, opts);
+            if (FAILED(hr))
             {
-                std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
-                if (!timage)
-                {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
-                    return 1;
-                }
-
-                hr = Resize(image->GetImages(), image->GetImageCount(), image->GetMetadata(), width, height, dwFilter | dwFilterOpts, *timage.get());
-                if (FAILED(hr))
-                {
-                    wprintf(L" FAILED [resize] (%x)\n", hr);
-                    return 1;
-                }
-
-                const TexMetadata& tinfo = timage->GetMetadata();
-
-                assert(tinfo.width == width && tinfo.height == height && tinfo.mipLevels == 1);
-                info.width = tinfo.width;
-                info.height = tinfo.height;
-                info.mipLevels = 1;
-
-                assert(info.depth == tinfo.depth);
-                assert(info.arraySize == tinfo.arraySize);
-                assert(info.miscFlags == tinfo.miscFlags);
-                assert(info.format == tinfo.format);
-                assert(info.dimension == tinfo.dimension);
-
-                image.swap(timage);
+                wprintf(L" FAILED [%ls] (%x)\n", (job.failedStep) ? job.failedStep : L"", hr);
+                return 1;
             }
 
-            // --- Tonemap (if requested) --------------------------------------------------
-            if (dwOptions & (1 << OPT_TONEMAP))
-            {
-                std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
-                if (!timage)
-                {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
-                    return 1;
-                }
-
-                // Compute max luminosity across all images
-                XMVECTOR maxLum = XMVectorZero();
-                hr = EvaluateImage(image->GetImages(), image->GetImageCount(), image->GetMetadata(),
-                    [&](const XMVECTOR* pixels, size_t width, size_t y)
-                {
-                    UNREFERENCED_PARAMETER(y);
-
-                    for (size_t j = 0; j < width; ++j)
-                    {
-                        static const XMVECTORF32 s_luminance = { 0.3f, 0.59f, 0.11f, 0.f };
-
-                        XMVECTOR v = *pixels++;
-
-                        v = XMVector3Dot(v, s_luminance);
-
-                        maxLum = XMVectorMax(v, maxLum);
-                    }
-                });
-                if (FAILED(hr))
-                {
-                    wprintf(L" FAILED [tonemap maxlum] (%x)\n", hr);
-                    return 1;
-                }
-
-                // Reinhard et al, "Photographic Tone Reproduction for Digital Images" 
-                // http://www.cs.utah.edu/~reinhard/cdrom/
-                maxLum = XMVectorMultiply(maxLum, maxLum);
-
-                hr = TransformImage(image->GetImages(), image->GetImageCount(), image->GetMetadata(),
-                    [&](XMVECTOR* outPixels, const XMVECTOR* inPixels, size_t width, size_t y)
-                {
-                    UNREFERENCED_PARAMETER(y);
-
-                    for (size_t j = 0; j < width; ++j)
-                    {
-                        XMVECTOR value = inPixels[j];
-
-                        XMVECTOR scale = XMVectorDivide(
-                            XMVectorAdd(g_XMOne, XMVectorDivide(value, maxLum)),
-                            XMVectorAdd(g_XMOne, value));
-                        XMVECTOR nvalue = XMVectorMultiply(value, scale);
-
-                        value = XMVectorSelect(value, nvalue, g_XMSelect1110);
-
-                        outPixels[j] = value;
-                    }
-                }, *timage);
-                if (FAILED(hr))
-                {
-                    wprintf(L" FAILED [tonemap apply] (%x)\n", hr);
-                    return 1;
-                }
+            PrintInfo(job.sourceInfo);
 
-                auto& tinfo = timage->GetMetadata();
-                tinfo;
+            if (job.warning)
+                wprintf(L"\nWARNING: %ls\n", job.warning);
 
-                assert(info.width == tinfo.width);
-                assert(info.height == tinfo.height);
-                assert(info.depth == tinfo.depth);
-                assert(info.arraySize == tinfo.arraySize);
-                assert(info.mipLevels == tinfo.mipLevels);
-                assert(info.miscFlags == tinfo.miscFlags);
-                assert(info.format == tinfo.format);
-                assert(info.dimension == tinfo.dimension);
+            // Later inputs are resized to the first one unless -w and -h were given
+            if (!opts.width)
+                opts.width = width = job.info.width;
+            if (!opts.height)
+                opts.height = height = job.info.height;
 
-                image.swap(timage);
-            }
+            TexMetadata& info = job.info;
+            std::unique_ptr<ScratchImage>& image = job.image;
 
             // --- Convert -----------------------------------------------------------------
             if (format == DXGI_FORMAT_UNKNOWN)
@@ -1683,22 +2934,6 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
 
     switch (dwCommand)
     {
-    case CMD_CUBE:
-        if (images != 6)
-        {
-            wprintf(L"\nERROR: cube requires six images to form the faces of the cubemap\n");
-            return 1;
-        }
-        break;
-
-    case CMD_CUBEARRAY:
-        if ((images < 6) || (images % 6) != 0)
-        {
-            wprintf(L"cubearray requires a multiple of 6 images to form the faces of the cubemaps\n");
-            return 1;
-        }
-        break;
-
     case CMD_H_CROSS:
     case CMD_V_CROSS:
     case CMD_H_STRIP:
@@ -1955,24 +3190,11 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             }
         }
 
-        ScratchImage result;
-        switch (dwCommand)
-        {
-        case CMD_VOLUME:
-            hr = result.Initialize3DFromImages(&imageArray[0], imageArray.size());
-            break;
-
-        case CMD_ARRAY:
-        case CMD_GIF:
-            hr = result.InitializeArrayFromImages(&imageArray[0], imageArray.size(), (dwOptions & (1 << OPT_USE_DX10)) != 0);
-            break;
-
-        case CMD_CUBE:
-        case CMD_CUBEARRAY:
-            hr = result.InitializeCubeFromImages(&imageArray[0], imageArray.size());
-            break;
-        }
+        // Cube, volume, and array are handled by the fast assembly path above
+        assert(dwCommand == CMD_GIF);
 
+        ScratchImage result;
+        hr = result.InitializeArrayFromImages(&imageArray[0], imageArray.size(), (dwOptions & (1 << OPT_USE_DX10)) != 0);
         if (FAILED(hr))
         {
             wprintf(L"FAILED building result image (%x)\n", hr);
@@ -0,0 +1,1782 @@
+//--------------------------------------------------------------------------------------
+// File: Texbench.cpp
+//
+// DirectX Texture block-compression benchmark tool
+//
+// Runs the CPU BC encoders over a fixed synthetic corpus (plus any images given on the
+// command line) and reports throughput, quality, and memory use as JSON.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+//
+// http://go.microsoft.com/fwlink/?LinkId=248926
+//--------------------------------------------------------------------------------------
+
+#pragma warning(push)
+#pragma warning(disable : 4005)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NODRAWTEXT
+#define NOGDI
+#define NOBITMAP
+#define NOMCX
+#define NOSERVICE
+#define NOHELP
+#pragma warning(pop)
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dxgiformat.h>
+#include <psapi.h>
+
+#include "directxtex.h"
+
+// The block encoders are internal to the library, but exported from its static lib
+#include "BC.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace DirectX;
+
+enum OPTIONS
+{
+    OPT_RECURSIVE = 1,
+    OPT_NOLOGO,
+    OPT_OUTPUTFILE,
+    OPT_OVERWRITE,
+    OPT_FILELIST,
+    OPT_MODES,
+    OPT_THREADS,
+    OPT_ITERATIONS,
+    OPT_SIZE,
+    OPT_SEED,
+    OPT_NO_SYNTHETIC,
+    OPT_COMPRESS_ONLY,
+    OPT_ENCODE_ONLY,
+    OPT_MAX
+};
+
+static_assert(OPT_MAX <= 32, "dwOptions is a DWORD bitfield");
+
+enum CORPUS_KIND
+{
+    KIND_ALBEDO = 0x1,
+    KIND_NORMAL = 0x2,
+    KIND_HDR    = 0x4,
+    KIND_ALPHA  = 0x8,
+};
+
+struct SConversion
+{
+    wchar_t szSrc[MAX_PATH];
+};
+
+struct SValue
+{
+    LPCWSTR pName;
+    DWORD dwValue;
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+const SValue g_pOptions[] =
+{
+    { L"r",             OPT_RECURSIVE },
+    { L"nologo",        OPT_NOLOGO },
+    { L"o",             OPT_OUTPUTFILE },
+    { L"y",             OPT_OVERWRITE },
+    { L"flist",         OPT_FILELIST },
+    { L"m",             OPT_MODES },
+    { L"threads",       OPT_THREADS },
+    { L"n",             OPT_ITERATIONS },
+    { L"size",          OPT_SIZE },
+    { L"seed",          OPT_SEED },
+    { L"nosynth",       OPT_NO_SYNTHETIC },
+    { L"compressonly",  OPT_COMPRESS_ONLY },
+    { L"encodeonly",    OPT_ENCODE_ONLY },
+    { nullptr,          0 }
+};
+
+const SValue g_pKinds[] =
+{
+    { L"albedo",    KIND_ALBEDO },
+    { L"normal",    KIND_NORMAL },
+    { L"hdr",       KIND_HDR },
+    { L"alpha",     KIND_ALPHA },
+    { nullptr,      0 }
+};
+
+#define DEFFMT(fmt) { L#fmt, DXGI_FORMAT_ ## fmt }
+
+const SValue g_pFormats[] =
+{
+    // List only includes the formats this tool reads or writes
+    DEFFMT(R32G32B32A32_FLOAT),
+    DEFFMT(R8G8B8A8_UNORM),
+    DEFFMT(BC1_UNORM),
+    DEFFMT(BC2_UNORM),
+    DEFFMT(BC3_UNORM),
+    DEFFMT(BC4_UNORM),
+    DEFFMT(BC4_SNORM),
+    DEFFMT(BC5_UNORM),
+    DEFFMT(BC5_SNORM),
+    DEFFMT(BC6H_UF16),
+    DEFFMT(BC6H_SF16),
+    DEFFMT(BC7_UNORM),
+    { nullptr, DXGI_FORMAT_UNKNOWN }
+};
+
+#undef DEFFMT
+
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+    inline HANDLE safe_handle(HANDLE h) { return (h == INVALID_HANDLE_VALUE) ? nullptr : h; }
+
+    struct find_closer { void operator()(HANDLE h) { assert(h != INVALID_HANDLE_VALUE); if (h) FindClose(h); } };
+
+    typedef std::unique_ptr<void, find_closer> ScopedFindHandle;
+
+    struct aligned_deleter { void operator()(void* p) { _aligned_free(p); } };
+
+    typedef std::unique_ptr<XMVECTOR[], aligned_deleter> ScopedAlignedArrayXMVECTOR;
+
+    // Default synthetic corpus dimension and timed repetitions per result
+    const size_t c_DefaultSize = 256;
+    const size_t c_DefaultIterations = 3;
+
+    // Blocks handed to a block-encoder worker at a time
+    const size_t c_BlocksPerChunk = 64;
+
+    //----------------------------------------------------------------------------------
+    // Benchmark modes
+    //----------------------------------------------------------------------------------
+
+    // A Compress() call: the public path texconv uses, including format conversion
+    struct SCompressMode
+    {
+        const wchar_t*  pName;
+        DXGI_FORMAT     format;
+        DWORD           dwCompress;
+        DWORD           kinds;
+    };
+
+    const SCompressMode g_pCompressModes[] =
+    {
+        { L"BC1",           DXGI_FORMAT_BC1_UNORM,  TEX_COMPRESS_DEFAULT,           KIND_ALBEDO | KIND_NORMAL },
+        { L"BC1_UNIFORM",   DXGI_FORMAT_BC1_UNORM,  TEX_COMPRESS_UNIFORM,           KIND_ALBEDO },
+        { L"BC1_DITHER",    DXGI_FORMAT_BC1_UNORM,  TEX_COMPRESS_DITHER,            KIND_ALBEDO },
+        { L"BC2",           DXGI_FORMAT_BC2_UNORM,  TEX_COMPRESS_DEFAULT,           KIND_ALPHA },
+        { L"BC3",           DXGI_FORMAT_BC3_UNORM,  TEX_COMPRESS_DEFAULT,           KIND_ALPHA },
+        { L"BC3_DITHER",    DXGI_FORMAT_BC3_UNORM,  TEX_COMPRESS_DITHER,            KIND_ALPHA },
+        { L"BC4_UNORM",     DXGI_FORMAT_BC4_UNORM,  TEX_COMPRESS_DEFAULT,           KIND_ALBEDO },
+        { L"BC4_SNORM",     DXGI_FORMAT_BC4_SNORM,  TEX_COMPRESS_DEFAULT,           KIND_NORMAL },
+        { L"BC5_UNORM",     DXGI_FORMAT_BC5_UNORM,  TEX_COMPRESS_DEFAULT,           KIND_NORMAL },
+        { L"BC5_SNORM",     DXGI_FORMAT_BC5_SNORM,  TEX_COMPRESS_DEFAULT,           KIND_NORMAL },
+        { L"BC6H_UF16",     DXGI_FORMAT_BC6H_UF16,  TEX_COMPRESS_DEFAULT,           KIND_HDR },
+        { L"BC6H_SF16",     DXGI_FORMAT_BC6H_SF16,  TEX_COMPRESS_DEFAULT,           KIND_HDR },
+        { L"BC7_QUICK",     DXGI_FORMAT_BC7_UNORM,  TEX_COMPRESS_BC7_QUICK,         KIND_ALBEDO | KIND_NORMAL | KIND_ALPHA },
+        { L"BC7",           DXGI_FORMAT_BC7_UNORM,  TEX_COMPRESS_DEFAULT,           KIND_ALBEDO | KIND_NORMAL | KIND_ALPHA },
+        { L"BC7_MAX",       DXGI_FORMAT_BC7_UNORM,  TEX_COMPRESS_BC7_USE_3SUBSETS,  KIND_ALBEDO | KIND_ALPHA },
+        { nullptr,          DXGI_FORMAT_UNKNOWN,    0,                              0 }
+    };
+
+    void EncodeBC1(uint8_t* pBC, const XMVECTOR* pColor, DWORD flags)
+    {
+        D3DXEncodeBC1(pBC, pColor, TEX_THRESHOLD_DEFAULT, flags);
+    }
+
+    // A D3DXEncodeBC* entry point called directly on pre-gathered float blocks, which
+    // isolates the encoder from the scanline conversion Compress does around it
+    struct SBlockEncoder
+    {
+        const wchar_t*  pName;
+        BC_ENCODE       pfEncode;
+        BC_DECODE       pfDecode;
+        DXGI_FORMAT     format;
+        size_t          blockSize;
+        DWORD           dwFlags;
+        DWORD           kinds;
+    };
+
+    const SBlockEncoder g_pBlockEncoders[] =
+    {
+        { L"BC1",       EncodeBC1,          D3DXDecodeBC1,      DXGI_FORMAT_BC1_UNORM,  8,  BC_FLAGS_NONE,              KIND_ALBEDO | KIND_NORMAL },
+        { L"BC2",       D3DXEncodeBC2,      D3DXDecodeBC2,      DXGI_FORMAT_BC2_UNORM,  16, BC_FLAGS_NONE,              KIND_ALPHA },
+        { L"BC3",       D3DXEncodeBC3,      D3DXDecodeBC3,      DXGI_FORMAT_BC3_UNORM,  16, BC_FLAGS_NONE,              KIND_ALPHA },
+        { L"BC4U",      D3DXEncodeBC4U,     D3DXDecodeBC4U,     DXGI_FORMAT_BC4_UNORM,  8,  BC_FLAGS_NONE,              KIND_ALBEDO },
+        { L"BC4S",      D3DXEncodeBC4S,     D3DXDecodeBC4S,     DXGI_FORMAT_BC4_SNORM,  8,  BC_FLAGS_NONE,              KIND_NORMAL },
+        { L"BC5U",      D3DXEncodeBC5U,     D3DXDecodeBC5U,     DXGI_FORMAT_BC5_UNORM,  16, BC_FLAGS_NONE,              KIND_NORMAL },
+        { L"BC5S",      D3DXEncodeBC5S,     D3DXDecodeBC5S,     DXGI_FORMAT_BC5_SNORM,  16, BC_FLAGS_NONE,              KIND_NORMAL },
+        { L"BC6HU",     D3DXEncodeBC6HU,    D3DXDecodeBC6HU,    DXGI_FORMAT_BC6H_UF16,  16, BC_FLAGS_NONE,              KIND_HDR },
+        { L"BC6HS",     D3DXEncodeBC6HS,    D3DXDecodeBC6HS,    DXGI_FORMAT_BC6H_SF16,  16, BC_FLAGS_NONE,              KIND_HDR },
+        { L"BC7",       D3DXEncodeBC7,      D3DXDecodeBC7,      DXGI_FORMAT_BC7_UNORM,  16, BC_FLAGS_NONE,              KIND_ALBEDO | KIND_NORMAL | KIND_ALPHA },
+        { L"BC7_MODE6", D3DXEncodeBC7,      D3DXDecodeBC7,      DXGI_FORMAT_BC7_UNORM,  16, BC_FLAGS_FORCE_BC7_MODE6,   KIND_ALBEDO | KIND_NORMAL | KIND_ALPHA },
+        { nullptr,      nullptr,            nullptr,            DXGI_FORMAT_UNKNOWN,    0,  0,                          0 }
+    };
+
+    //----------------------------------------------------------------------------------
+    // Corpus and results
+    //----------------------------------------------------------------------------------
+    struct SCorpusImage
+    {
+        wchar_t         szName[MAX_PATH];
+        DWORD           kind;
+        uint32_t        hash;
+        ScratchImage    source;
+            // R8G8B8A8_UNORM, or R32G32B32A32_FLOAT for HDR
+        ScratchImage    linear;
+            // R32G32B32A32_FLOAT copy of source, read by the block encoders
+        ScratchImage    signedLinear;
+            // linear * 2 - 1 for the SNORM modes (LDR only)
+    };
+
+    struct SBenchResult
+    {
+        const wchar_t*  pPath;
+        const wchar_t*  pMode;
+        DXGI_FORMAT     format;
+        size_t          image;
+        size_t          threads;
+        size_t          blocks;
+        double          bestTime;
+        double          medianTime;
+        ImageMetrics    metrics;
+        size_t          privateBytes;
+        size_t          peakWorkingSet;
+        HRESULT         hr;
+    };
+
+    struct SBenchOptions
+    {
+        std::vector<std::wstring>   modes;
+        std::vector<size_t>         threads;
+        size_t                      iterations;
+        bool                        compress;
+        bool                        encode;
+    };
+
+#pragma prefast(disable : 26018, "Only used with static internal arrays")
+
+    DWORD LookupByName(const wchar_t *pName, const SValue *pArray)
+    {
+        while (pArray->pName)
+        {
+            if (!_wcsicmp(pName, pArray->pName))
+                return pArray->dwValue;
+
+            pArray++;
+        }
+
+        return 0;
+    }
+
+
+    const wchar_t* LookupByValue(DWORD pValue, const SValue *pArray)
+    {
+        while (pArray->pName)
+        {
+            if (pValue == pArray->dwValue)
+                return pArray->pName;
+
+            pArray++;
+        }
+
+        return L"";
+    }
+
+
+    void SearchForFiles(const wchar_t* path, std::list<SConversion>& files, bool recursive)
+    {
+        // Process files
+        WIN32_FIND_DATA findData = {};
+        ScopedFindHandle hFile(safe_handle(FindFirstFileExW(path,
+            FindExInfoBasic, &findData,
+            FindExSearchNameMatch, nullptr,
+            FIND_FIRST_EX_LARGE_FETCH)));
+        if (hFile)
+        {
+            for (;;)
+            {
+                if (!(findData.dwFileAttributes & (FILE_ATTRIBUTE_HIDDEN | FILE_ATTRIBUTE_SYSTEM | FILE_ATTRIBUTE_DIRECTORY)))
+                {
+                    wchar_t drive[_MAX_DRIVE] = {};
+                    wchar_t dir[_MAX_DIR] = {};
+                    _wsplitpath_s(path, drive, _MAX_DRIVE, dir, _MAX_DIR, nullptr, 0, nullptr, 0);
+
+                    SConversion conv;
+                    _wmakepath_s(conv.szSrc, drive, dir, findData.cFileName, nullptr);
+                    files.push_back(conv);
+                }
+
+                if (!FindNextFile(hFile.get(), &findData))
+                    break;
+            }
+        }
+
+        // Process directories
+        if (recursive)
+        {
+            wchar_t searchDir[MAX_PATH] = {};
+            {
+                wchar_t drive[_MAX_DRIVE] = {};
+                wchar_t dir[_MAX_DIR] = {};
+                _wsplitpath_s(path, drive, _MAX_DRIVE, dir, _MAX_DIR, nullptr, 0, nullptr, 0);
+                _wmakepath_s(searchDir, drive, dir, L"*", nullptr);
+            }
+
+            hFile.reset(safe_handle(FindFirstFileExW(searchDir,
+                FindExInfoBasic, &findData,
+                FindExSearchLimitToDirectories, nullptr,
+                FIND_FIRST_EX_LARGE_FETCH)));
+            if (!hFile)
+                return;
+
+            for (;;)
+            {
+                if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                {
+                    if (findData.cFileName[0] != L'.')
+                    {
+                        wchar_t subdir[MAX_PATH] = {};
+
+                        {
+                            wchar_t drive[_MAX_DRIVE] = {};
+                            wchar_t dir[_MAX_DIR] = {};
+                            wchar_t fname[_MAX_FNAME] = {};
+                            wchar_t ext[_MAX_FNAME] = {};
+                            _wsplitpath_s(path, drive, dir, fname, ext);
+                            wcscat_s(dir, findData.cFileName);
+                            _wmakepath_s(subdir, drive, dir, fname, ext);
+                        }
+
+                        SearchForFiles(subdir, files, recursive);
+                    }
+                }
+
+                if (!FindNextFile(hFile.get(), &findData))
+                    break;
+            }
+        }
+    }
+
+
+    void PrintList(size_t cch, const SValue *pValue)
+    {
+        while (pValue->pName)
+        {
+            size_t cchName = wcslen(pValue->pName);
+
+            if (cch + cchName + 2 >= 80)
+            {
+                wprintf(L"\n      ");
+                cch = 6;
+            }
+
+            wprintf(L"%ls ", pValue->pName);
+            cch += cchName + 2;
+            pValue++;
+        }
+
+        wprintf(L"\n");
+    }
+
+
+    void PrintLogo()
+    {
+        wprintf(L"Microsoft (R) DirectX Texture Compression Benchmark Tool\n");
+        wprintf(L"Copyright (C) Microsoft Corp. All rights reserved.\n");
+#ifdef _DEBUG
+        wprintf(L"*** Debug build ***\n");
+#endif
+        wprintf(L"\n");
+    }
+
+
+    void PrintUsage()
+    {
+        PrintLogo();
+
+        wprintf(L"Usage: texbench <options> [files]\n\n");
+        wprintf(L"   -r                  wildcard filename search is recursive\n");
+        wprintf(L"   -flist <filename>   use text file with a list of input files (one per line)\n");
+        wprintf(L"   -nosynth            skip the synthetic corpus (files only)\n");
+        wprintf(L"   -size <n>           synthetic corpus width and height (defaults to %zu)\n", c_DefaultSize);
+        wprintf(L"   -seed <n>           synthetic corpus seed (defaults to 1)\n");
+        wprintf(L"   -m <mode>[,...]     only run modes starting with these names (i.e. BC7,BC1)\n");
+        wprintf(L"   -compressonly       only time Compress()\n");
+        wprintf(L"   -encodeonly         only time the D3DXEncodeBC* block encoders\n");
+        wprintf(L"   -threads <n>[,...]  thread counts to sweep (defaults to 1 and all cores)\n");
+        wprintf(L"   -n <count>          timed repetitions per result (defaults to %zu)\n", c_DefaultIterations);
+        wprintf(L"   -o <filename>       write results as JSON\n");
+        wprintf(L"   -y                  overwrite existing output file (if any)\n");
+        wprintf(L"   -nologo             suppress copyright message\n");
+
+        wprintf(L"\n   Compress modes: ");
+        size_t cch = 20;
+        for (const SCompressMode* pMode = g_pCompressModes; pMode->pName; ++pMode)
+        {
+            size_t cchName = wcslen(pMode->pName);
+            if (cch + cchName + 2 >= 80)
+            {
+                wprintf(L"\n      ");
+                cch = 6;
+            }
+            wprintf(L"%ls ", pMode->pName);
+            cch += cchName + 2;
+        }
+
+        wprintf(L"\n   Block encoders: ");
+        cch = 20;
+        for (const SBlockEncoder* pEncoder = g_pBlockEncoders; pEncoder->pName; ++pEncoder)
+        {
+            size_t cchName = wcslen(pEncoder->pName);
+            if (cch + cchName + 2 >= 80)
+            {
+                wprintf(L"\n      ");
+                cch = 6;
+            }
+            wprintf(L"%ls ", pEncoder->pName);
+            cch += cchName + 2;
+        }
+
+        wprintf(L"\n   Corpus kinds: ");
+        PrintList(17, g_pKinds);
+        wprintf(L"                       files are classified as hdr (float), alpha (not opaque),\n");
+        wprintf(L"                       normal (name contains 'normal' or ends in '_n'), or albedo\n");
+    }
+
+
+    double ElapsedSeconds(const LARGE_INTEGER& start, const LARGE_INTEGER& end)
+    {
+        LARGE_INTEGER qpcFreq;
+        if (!QueryPerformanceFrequency(&qpcFreq) || !qpcFreq.QuadPart)
+            return 0;
+
+        return double(end.QuadPart - start.QuadPart) / double(qpcFreq.QuadPart);
+    }
+
+
+    void GetMemoryUsage(size_t& privateBytes, size_t& peakWorkingSet)
+    {
+        PROCESS_MEMORY_COUNTERS_EX counters = {};
+        counters.cb = sizeof(counters);
+        if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&counters), sizeof(counters)))
+        {
+            privateBytes = counters.PrivateUsage;
+            peakWorkingSet = counters.PeakWorkingSetSize;
+        }
+        else
+        {
+            privateBytes = peakWorkingSet = 0;
+        }
+    }
+
+
+    // FNV-1a over the pixels, so a report shows whether two runs saw the same corpus
+    uint32_t HashImage(const Image& image)
+    {
+        uint32_t hash = 2166136261u;
+        const uint8_t* pRow = image.pixels;
+        const size_t rowBytes = (image.width * BitsPerPixel(image.format) + 7) / 8;
+        for (size_t y = 0; y < image.height; ++y, pRow += image.rowPitch)
+        {
+            for (size_t x = 0; x < rowBytes; ++x)
+            {
+                hash ^= pRow[x];
+                hash *= 16777619u;
+            }
+        }
+        return hash;
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // Synthetic corpus
+    //
+    // All of the generators use integer arithmetic, so the corpus is bit-identical no
+    // matter which compiler, floating-point model, or instruction set built the tool.
+    //----------------------------------------------------------------------------------
+    inline uint32_t HashLattice(uint32_t x, uint32_t y, uint32_t seed)
+    {
+        uint32_t h = (x * 0x8da6b343u) ^ (y * 0xd8163841u) ^ (seed * 0xcb1ab31fu);
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        return h;
+    }
+
+
+    // Tiling value noise in [0,65535] at (u,v) in 16.16 image coordinates
+    uint32_t ValueNoise(uint32_t u, uint32_t v, uint32_t period, uint32_t seed)
+    {
+        const uint64_t cu = uint64_t(u) * period;
+        const uint64_t cv = uint64_t(v) * period;
+        const uint32_t x0 = uint32_t(cu >> 16) % period;
+        const uint32_t y0 = uint32_t(cv >> 16) % period;
+        const uint32_t x1 = (x0 + 1) % period;
+        const uint32_t y1 = (y0 + 1) % period;
+
+        // Smoothstep weights in 0.16 fixed point
+        const int64_t fx = int64_t(cu & 0xFFFF);
+        const int64_t fy = int64_t(cv & 0xFFFF);
+        const int64_t sx = (((fx * fx) >> 16) * (3 * 65536 - 2 * fx)) >> 16;
+        const int64_t sy = (((fy * fy) >> 16) * (3 * 65536 - 2 * fy)) >> 16;
+
+        const int64_t n00 = HashLattice(x0, y0, seed) >> 16;
+        const int64_t n10 = HashLattice(x1, y0, seed) >> 16;
+        const int64_t n01 = HashLattice(x0, y1, seed) >> 16;
+        const int64_t n11 = HashLattice(x1, y1, seed) >> 16;
+
+        const int64_t top = n00 + (((n10 - n00) * sx) >> 16);
+        const int64_t bottom = n01 + (((n11 - n01) * sx) >> 16);
+        return uint32_t(top + (((bottom - top) * sy) >> 16));
+    }
+
+
+    // Fractal sum of 'octaves' noise layers starting at a 4x4 lattice, in [0,65535]
+    uint32_t Fractal(uint32_t u, uint32_t v, uint32_t octaves, uint32_t seed)
+    {
+        uint64_t sum = 0;
+        uint32_t period = 4;
+        for (uint32_t o = 0; o < octaves; ++o, period *= 2)
+        {
+            sum += uint64_t(ValueNoise(u, v, period, seed + o)) << (octaves - 1 - o);
+        }
+        return uint32_t(sum / ((1u << octaves) - 1));
+    }
+
+
+    inline uint8_t ToByte(uint32_t n)
+    {
+        return uint8_t((n * 255 + 32767) / 65535);
+    }
+
+
+    // Brick mortar lines over part of the image, so the corpus has hard edges as well
+    // as smooth gradients
+    bool IsMortar(uint32_t x, uint32_t y, uint32_t u, uint32_t v, uint32_t seed)
+    {
+        if (Fractal(u, v, 2, seed + 100) <= 0x8000)
+            return false;
+
+        return ((y % 16) < 2) || (((x + ((y / 16) & 1) * 16) % 32) < 2);
+    }
+
+
+    HRESULT GenerateAlbedo(size_t size, uint32_t seed, ScratchImage& image, bool alpha)
+    {
+        HRESULT hr = image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, size, size, 1, 1);
+        if (FAILED(hr))
+            return hr;
+
+        const Image* img = image.GetImage(0, 0, 0);
+        assert(img);
+
+        for (size_t y = 0; y < size; ++y)
+        {
+            uint8_t* pDest = img->pixels + y * img->rowPitch;
+            const uint32_t v = uint32_t((uint64_t(y) << 16) / size);
+
+            for (size_t x = 0; x < size; ++x, pDest += 4)
+            {
+                const uint32_t u = uint32_t((uint64_t(x) << 16) / size);
+                const bool mortar = IsMortar(uint32_t(x), uint32_t(y), u, v, seed);
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    pDest[c] = (mortar) ? uint8_t(48 + c * 8) : ToByte(Fractal(u, v, 6, seed + 10 * c));
+                }
+
+                if (!alpha)
+                {
+                    pDest[3] = 255;
+                }
+                else if (y < size / 2)
+                {
+                    // Foliage-style cutout
+                    pDest[3] = (Fractal(u, v, 5, seed + 200) > 0x8000) ? 255 : 0;
+                }
+                else
+                {
+                    // Smooth translucency
+                    pDest[3] = ToByte(Fractal(u, v, 3, seed + 300));
+                }
+            }
+        }
+
+        return S_OK;
+    }
+
+
+    HRESULT GenerateNormal(size_t size, uint32_t seed, ScratchImage& image)
+    {
+        std::unique_ptr<int32_t[]> height(new (std::nothrow) int32_t[size * size]);
+        if (!height)
+            return E_OUTOFMEMORY;
+
+        for (size_t y = 0; y < size; ++y)
+        {
+            const uint32_t v = uint32_t((uint64_t(y) << 16) / size);
+            for (size_t x = 0; x < size; ++x)
+            {
+                const uint32_t u = uint32_t((uint64_t(x) << 16) / size);
+
+                // Rolling terrain, with the brick mortar pressed into it
+                int32_t h = int32_t(Fractal(u, v, 6, seed + 400));
+                if (IsMortar(uint32_t(x), uint32_t(y), u, v, seed))
+                    h -= 0x2000;
+                height[y * size + x] = h;
+            }
+        }
+
+        HRESULT hr = image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, size, size, 1, 1);
+        if (FAILED(hr))
+            return hr;
+
+        const Image* img = image.GetImage(0, 0, 0);
+        assert(img);
+
+        // Central differences with wrap; one texel spans 1/8th of the height range
+        const double scale = double(size) / (8.0 * 65535.0);
+        for (size_t y = 0; y < size; ++y)
+        {
+            uint8_t* pDest = img->pixels + y * img->rowPitch;
+            const size_t ym = (y + size - 1) % size;
+            const size_t yp = (y + 1) % size;
+
+            for (size_t x = 0; x < size; ++x, pDest += 4)
+            {
+                const size_t xm = (x + size - 1) % size;
+                const size_t xp = (x + 1) % size;
+
+                const double dx = double(height[y * size + xp] - height[y * size + xm]) * scale;
+                const double dy = double(height[yp * size + x] - height[ym * size + x]) * scale;
+                const double len = sqrt(dx * dx + dy * dy + 1.0);
+
+                const double n[3] = { -dx / len, -dy / len, 1.0 / len };
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    const int32_t q = int32_t(floor((n[c] * 0.5 + 0.5) * 255.0 + 0.5));
+                    pDest[c] = uint8_t(std::min(255, std::max(0, q)));
+                }
+                pDest[3] = 255;
+            }
+        }
+
+        return S_OK;
+    }
+
+
+    // Sky-like radiance spanning 2^-2..2^13, with a sun disc far above 1.0
+    HRESULT GenerateHDR(size_t size, uint32_t seed, ScratchImage& image)
+    {
+        HRESULT hr = image.Initialize2D(DXGI_FORMAT_R32G32B32A32_FLOAT, size, size, 1, 1);
+        if (FAILED(hr))
+            return hr;
+
+        const Image* img = image.GetImage(0, 0, 0);
+        assert(img);
+
+        const int64_t sunX = int64_t(size) * 3 / 4;
+        const int64_t sunY = int64_t(size) / 4;
+        const int64_t sunR = std::max<int64_t>(2, int64_t(size) / 32);
+
+        for (size_t y = 0; y < size; ++y)
+        {
+            float* pDest = reinterpret_cast<float*>(img->pixels + y * img->rowPitch);
+            const uint32_t v = uint32_t((uint64_t(y) << 16) / size);
+
+            for (size_t x = 0; x < size; ++x, pDest += 4)
+            {
+                const uint32_t u = uint32_t((uint64_t(x) << 16) / size);
+
+                const int64_t dx = int64_t(x) - sunX;
+                const int64_t dy = int64_t(y) - sunY;
+                const bool sun = (dx * dx + dy * dy) <= sunR * sunR;
+                const int exponent = (sun) ? 13 : int(Fractal(u, v, 3, seed + 500) >> 13) - 2;
+
+                for (size_t c = 0; c < 3; ++c)
+                {
+                    const uint32_t n = Fractal(u, v, 5, seed + 600 + uint32_t(c) * 10);
+                    pDest[c] = ldexpf(float(n) / 65535.f, exponent);
+                }
+                pDest[3] = 1.f;
+            }
+        }
+
+        return S_OK;
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // Corpus preparation
+    //----------------------------------------------------------------------------------
+    bool IsHDRFormat(DXGI_FORMAT format)
+    {
+        switch (format)
+        {
+        case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        case DXGI_FORMAT_R32G32B32_FLOAT:
+        case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        case DXGI_FORMAT_R32G32_FLOAT:
+        case DXGI_FORMAT_R11G11B10_FLOAT:
+        case DXGI_FORMAT_R16G16_FLOAT:
+        case DXGI_FORMAT_R32_FLOAT:
+        case DXGI_FORMAT_R16_FLOAT:
+        case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+            return true;
+
+        default:
+            return false;
+        }
+    }
+
+
+    bool IsSignedFormat(DXGI_FORMAT format)
+    {
+        return (format == DXGI_FORMAT_BC4_SNORM || format == DXGI_FORMAT_BC5_SNORM);
+    }
+
+
+    HRESULT LoadImage(const wchar_t *fileName, TexMetadata& info, ScratchImage& image)
+    {
+        wchar_t ext[_MAX_EXT];
+        _wsplitpath_s(fileName, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT);
+
+        if (_wcsicmp(ext, L".dds") == 0)
+        {
+            HRESULT hr = LoadFromDDSFile(fileName, DDS_FLAGS_NONE, &info, image);
+            if (FAILED(hr))
+                return hr;
+
+            if (IsTypeless(info.format))
+            {
+                info.format = MakeTypelessUNORM(info.format);
+                if (IsTypeless(info.format))
+                    return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+                image.OverrideFormat(info.format);
+            }
+
+            return S_OK;
+        }
+        else if (_wcsicmp(ext, L".tga") == 0)
+        {
+            return LoadFromTGAFile(fileName, &info, image);
+        }
+        else if (_wcsicmp(ext, L".hdr") == 0)
+        {
+            return LoadFromHDRFile(fileName, &info, image);
+        }
+        else
+        {
+            return LoadFromWICFile(fileName, WIC_FLAGS_NONE, &info, image);
+        }
+    }
+
+
+    DWORD ClassifyImage(const wchar_t* fileName, const TexMetadata& info, const ScratchImage& image)
+    {
+        if (IsHDRFormat(info.format))
+            return KIND_HDR;
+
+        if (!image.IsAlphaAllOpaque())
+            return KIND_ALPHA;
+
+        wchar_t fname[_MAX_FNAME] = {};
+        _wsplitpath_s(fileName, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, nullptr, 0);
+        _wcslwr_s(fname);
+
+        const size_t len = wcslen(fname);
+        if (wcsstr(fname, L"normal") || (len > 2 && !wcscmp(fname + len - 2, L"_n")))
+            return KIND_NORMAL;
+
+        return KIND_ALBEDO;
+    }
+
+
+    // Uses the top-level image of the first item, decompressed and converted to the
+    // corpus format for its kind
+    HRESULT LoadCorpusImage(const wchar_t* fileName, SCorpusImage& corpus)
+    {
+        TexMetadata info;
+        ScratchImage image;
+        HRESULT hr = LoadImage(fileName, info, image);
+        if (FAILED(hr))
+            return hr;
+
+        if (info.dimension == TEX_DIMENSION_TEXTURE3D || IsPlanar(info.format) || IsPalettized(info.format))
+            return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+        const Image* img = image.GetImage(0, 0, 0);
+        if (!img)
+            return E_POINTER;
+
+        ScratchImage decompressed;
+        if (IsCompressed(img->format))
+        {
+            hr = Decompress(*img, DXGI_FORMAT_UNKNOWN, decompressed);
+            if (FAILED(hr))
+                return hr;
+
+            img = decompressed.GetImage(0, 0, 0);
+        }
+
+        corpus.kind = ClassifyImage(fileName, info, (decompressed.GetImageCount()) ? decompressed : image);
+
+        const DXGI_FORMAT format = (corpus.kind == KIND_HDR) ? DXGI_FORMAT_R32G32B32A32_FLOAT : DXGI_FORMAT_R8G8B8A8_UNORM;
+        if (img->format == format)
+        {
+            hr = corpus.source.InitializeFromImage(*img);
+        }
+        else
+        {
+            hr = Convert(*img, format, TEX_FILTER_DEFAULT, TEX_THRESHOLD_DEFAULT, corpus.source);
+        }
+        if (FAILED(hr))
+            return hr;
+
+        wchar_t fname[_MAX_FNAME] = {};
+        wchar_t ext[_MAX_EXT] = {};
+        _wsplitpath_s(fileName, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT);
+        _wmakepath_s(corpus.szName, nullptr, nullptr, fname, ext);
+
+        return S_OK;
+    }
+
+
+    HRESULT PrepareCorpusImage(SCorpusImage& corpus)
+    {
+        const Image* img = corpus.source.GetImage(0, 0, 0);
+        if (!img)
+            return E_POINTER;
+
+        corpus.hash = HashImage(*img);
+
+        HRESULT hr = (img->format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+            ? corpus.linear.InitializeFromImage(*img)
+            : Convert(*img, DXGI_FORMAT_R32G32B32A32_FLOAT, TEX_FILTER_DEFAULT, TEX_THRESHOLD_DEFAULT, corpus.linear);
+        if (FAILED(hr))
+            return hr;
+
+        if (corpus.kind == KIND_HDR)
+            return S_OK;
+
+        hr = corpus.signedLinear.InitializeFromImage(*corpus.linear.GetImage(0, 0, 0));
+        if (FAILED(hr))
+            return hr;
+
+        const Image* dest = corpus.signedLinear.GetImage(0, 0, 0);
+        for (size_t y = 0; y < dest->height; ++y)
+        {
+            XMVECTOR* ptr = reinterpret_cast<XMVECTOR*>(dest->pixels + y * dest->rowPitch);
+            for (size_t x = 0; x < dest->width; ++x, ++ptr)
+            {
+                XMVECTOR v = XMLoadFloat4A(reinterpret_cast<const XMFLOAT4A*>(ptr));
+                v = XMVectorSubtract(XMVectorAdd(v, v), g_XMOne);
+                XMStoreFloat4A(reinterpret_cast<XMFLOAT4A*>(ptr), v);
+            }
+        }
+
+        return S_OK;
+    }
+
+
+    // Channels that take part in the PSNR for a format and kind of content
+    DWORD GetMetricFlags(DXGI_FORMAT format, DWORD kind)
+    {
+        DWORD flags = (kind == KIND_ALPHA) ? CMSE_DEFAULT : CMSE_IGNORE_ALPHA;
+
+        switch (format)
+        {
+        case DXGI_FORMAT_BC4_UNORM:
+        case DXGI_FORMAT_BC4_SNORM:
+            flags |= CMSE_IGNORE_GREEN | CMSE_IGNORE_BLUE | CMSE_IGNORE_ALPHA;
+            break;
+
+        case DXGI_FORMAT_BC5_UNORM:
+        case DXGI_FORMAT_BC5_SNORM:
+            flags |= CMSE_IGNORE_BLUE | CMSE_IGNORE_ALPHA;
+            break;
+
+        case DXGI_FORMAT_BC6H_UF16:
+        case DXGI_FORMAT_BC6H_SF16:
+            flags |= CMSE_IGNORE_ALPHA;
+            break;
+
+        default:
+            break;
+        }
+
+        // SNORM results are compared against the UNORM source scaled & biased into [-1,1]
+        if (IsSignedFormat(format))
+            flags |= CMSE_IMAGE1_X2_BIAS;
+
+        return flags;
+    }
+
+
+    bool MatchesMode(const wchar_t* pName, const std::vector<std::wstring>& modes)
+    {
+        if (modes.empty())
+            return true;
+
+        for (auto& it : modes)
+        {
+            // 'BC7' selects BC7, BC7_QUICK, and BC7_MODE6, but 'BC1' does not select 'BC10'
+            const size_t len = it.size();
+            if (!_wcsnicmp(pName, it.c_str(), len) && !(pName[len] >= L'0' && pName[len] <= L'9'))
+                return true;
+        }
+
+        return false;
+    }
+
+
+    double Median(std::vector<double>& times)
+    {
+        if (times.empty())
+            return 0;
+
+        std::sort(times.begin(), times.end());
+        const size_t mid = times.size() / 2;
+        return (times.size() & 1) ? times[mid] : (times[mid - 1] + times[mid]) * 0.5;
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // Compress path
+    //----------------------------------------------------------------------------------
+    void RunCompress(const SCompressMode& mode, const SCorpusImage& corpus, size_t threads, size_t iterations, SBenchResult& result)
+    {
+        const bool snorm = IsSignedFormat(mode.format) && (corpus.kind != KIND_HDR);
+        const Image& input = *((snorm) ? corpus.signedLinear : corpus.source).GetImage(0, 0, 0);
+
+        result.blocks = ((input.width + 3) / 4) * ((input.height + 3) / 4);
+
+        DWORD dwCompress = mode.dwCompress;
+        if (threads > 1)
+        {
+            dwCompress |= TEX_COMPRESS_PARALLEL;
+#ifdef _OPENMP
+            omp_set_num_threads(static_cast<int>(threads));
+#endif
+        }
+
+        std::vector<double> times;
+        ScratchImage compressed;
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            compressed.Release();
+
+            LARGE_INTEGER qpcStart, qpcEnd;
+            QueryPerformanceCounter(&qpcStart);
+
+            result.hr = Compress(input, mode.format, dwCompress, TEX_THRESHOLD_DEFAULT, compressed);
+
+            QueryPerformanceCounter(&qpcEnd);
+            if (FAILED(result.hr))
+                return;
+
+            times.push_back(ElapsedSeconds(qpcStart, qpcEnd));
+        }
+
+        GetMemoryUsage(result.privateBytes, result.peakWorkingSet);
+
+        result.bestTime = *std::min_element(times.cbegin(), times.cend());
+        result.medianTime = Median(times);
+
+        ScratchImage decoded;
+        result.hr = Decompress(*compressed.GetImage(0, 0, 0), DXGI_FORMAT_UNKNOWN, decoded);
+        if (FAILED(result.hr))
+            return;
+
+        const Image& reference = *((snorm) ? corpus.linear : corpus.source).GetImage(0, 0, 0);
+        result.hr = ComputeMetrics(reference, *decoded.GetImage(0, 0, 0),
+            GetMetricFlags(mode.format, corpus.kind), result.metrics);
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // Block encoder path
+    //----------------------------------------------------------------------------------
+
+    // Copies a R32G32B32A32_FLOAT image into 4x4 blocks in row-major block order,
+    // replicating the edge texels of partial blocks
+    HRESULT GatherBlocks(const Image& image, ScopedAlignedArrayXMVECTOR& blocks, size_t& nblocks)
+    {
+        assert(image.format == DXGI_FORMAT_R32G32B32A32_FLOAT);
+
+        const size_t bw = (image.width + 3) / 4;
+        const size_t bh = (image.height + 3) / 4;
+        nblocks = bw * bh;
+
+        blocks.reset(static_cast<XMVECTOR*>(_aligned_malloc(sizeof(XMVECTOR) * NUM_PIXELS_PER_BLOCK * nblocks, 16)));
+        if (!blocks)
+            return E_OUTOFMEMORY;
+
+        XMVECTOR* pDest = blocks.get();
+        for (size_t by = 0; by < bh; ++by)
+        {
+            for (size_t bx = 0; bx < bw; ++bx)
+            {
+                for (size_t j = 0; j < 4; ++j)
+                {
+                    const size_t y = std::min(by * 4 + j, image.height - 1);
+                    auto pRow = reinterpret_cast<const XMFLOAT4*>(image.pixels + y * image.rowPitch);
+
+                    for (size_t i = 0; i < 4; ++i)
+                    {
+                        const size_t x = std::min(bx * 4 + i, image.width - 1);
+                        *pDest++ = XMLoadFloat4(&pRow[x]);
+                    }
+                }
+            }
+        }
+
+        return S_OK;
+    }
+
+
+    void EncodeBlocks(const SBlockEncoder& encoder, const XMVECTOR* pBlocks, size_t nblocks, uint8_t* pDest, size_t threads)
+    {
+        std::atomic<size_t> nextBlock(0);
+
+        auto worker = [&]()
+        {
+            for (;;)
+            {
+                const size_t first = nextBlock.fetch_add(c_BlocksPerChunk);
+                if (first >= nblocks)
+                    break;
+
+                const size_t last = std::min(first + c_BlocksPerChunk, nblocks);
+                for (size_t b = first; b < last; ++b)
+                {
+                    encoder.pfEncode(pDest + b * encoder.blockSize, pBlocks + b * NUM_PIXELS_PER_BLOCK, encoder.dwFlags);
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        try
+        {
+            for (size_t j = 1; j < threads; ++j)
+                workers.emplace_back(worker);
+        }
+        catch (const std::exception&)
+        {
+            // Carry on with the threads that were started
+        }
+
+        // The calling thread works too
+        worker();
+
+        for (auto& t : workers)
+            t.join();
+    }
+
+
+    void DecodeBlocks(const SBlockEncoder& encoder, const uint8_t* pSrc, const Image& image)
+    {
+        assert(image.format == DXGI_FORMAT_R32G32B32A32_FLOAT);
+
+        const size_t bw = (image.width + 3) / 4;
+        const size_t bh = (image.height + 3) / 4;
+
+        __declspec(align(16)) XMVECTOR temp[NUM_PIXELS_PER_BLOCK];
+        for (size_t by = 0; by < bh; ++by)
+        {
+            for (size_t bx = 0; bx < bw; ++bx, pSrc += encoder.blockSize)
+            {
+                encoder.pfDecode(temp, pSrc);
+
+                const size_t ph = std::min<size_t>(4, image.height - by * 4);
+                const size_t pw = std::min<size_t>(4, image.width - bx * 4);
+                for (size_t j = 0; j < ph; ++j)
+                {
+                    auto pRow = reinterpret_cast<XMFLOAT4*>(image.pixels + (by * 4 + j) * image.rowPitch) + bx * 4;
+                    for (size_t i = 0; i < pw; ++i)
+                    {
+                        XMStoreFloat4(&pRow[i], temp[j * 4 + i]);
+                    }
+                }
+            }
+        }
+    }
+
+
+    void RunEncoder(const SBlockEncoder& encoder, const SCorpusImage& corpus, size_t threads, size_t iterations, SBenchResult& result)
+    {
+        const bool snorm = IsSignedFormat(encoder.format) && (corpus.kind != KIND_HDR);
+        const Image& input = *((snorm) ? corpus.signedLinear : corpus.linear).GetImage(0, 0, 0);
+
+        // Gathering is setup, not encoding, so it stays outside the timed region
+        ScopedAlignedArrayXMVECTOR blocks;
+        result.hr = GatherBlocks(input, blocks, result.blocks);
+        if (FAILED(result.hr))
+            return;
+
+        std::unique_ptr<uint8_t[]> encoded(new (std::nothrow) uint8_t[result.blocks * encoder.blockSize]);
+        if (!encoded)
+        {
+            result.hr = E_OUTOFMEMORY;
+            return;
+        }
+
+        std::vector<double> times;
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            LARGE_INTEGER qpcStart, qpcEnd;
+            QueryPerformanceCounter(&qpcStart);
+
+            EncodeBlocks(encoder, blocks.get(), result.blocks, encoded.get(), threads);
+
+            QueryPerformanceCounter(&qpcEnd);
+            times.push_back(ElapsedSeconds(qpcStart, qpcEnd));
+        }
+
+        GetMemoryUsage(result.privateBytes, result.peakWorkingSet);
+
+        result.bestTime = *std::min_element(times.cbegin(), times.cend());
+        result.medianTime = Median(times);
+
+        blocks.reset();
+
+        ScratchImage decoded;
+        result.hr = decoded.Initialize2D(DXGI_FORMAT_R32G32B32A32_FLOAT, input.width, input.height, 1, 1);
+        if (FAILED(result.hr))
+            return;
+
+        DecodeBlocks(encoder, encoded.get(), *decoded.GetImage(0, 0, 0));
+
+        result.hr = ComputeMetrics(*corpus.linear.GetImage(0, 0, 0), *decoded.GetImage(0, 0, 0),
+            GetMetricFlags(encoder.format, corpus.kind), result.metrics);
+    }
+
+
+    //----------------------------------------------------------------------------------
+    // Console and JSON output
+    //----------------------------------------------------------------------------------
+    void PrintResult(const SBenchResult& result, const SCorpusImage& corpus)
+    {
+        wprintf(L"%-8ls %-12ls %-24ls %3zu thread%ls ", result.pPath, result.pMode, corpus.szName,
+            result.threads, (result.threads > 1) ? L"s" : L" ");
+
+        if (FAILED(result.hr))
+        {
+            wprintf(L"FAILED (%08X)\n", static_cast<unsigned int>(result.hr));
+            return;
+        }
+
+        const double rate = (result.bestTime > 0) ? double(result.blocks) / result.bestTime : 0;
+        wprintf(L"%12.0f blocks/s  %8.3f ms  PSNR %6.2f dB\n", rate, result.bestTime * 1000.0, result.metrics.psnr);
+    }
+
+
+    void AppendFormat(std::string& str, _In_z_ _Printf_format_string_ const char* format, ...)
+    {
+        char buff[512];
+
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf_s(buff, _TRUNCATE, format, args);
+        va_end(args);
+
+        if (len > 0)
+            str.append(buff, static_cast<size_t>(len));
+    }
+
+
+    void AppendNumber(std::string& str, double value)
+    {
+        if (std::isfinite(value))
+            AppendFormat(str, "%.9g", value);
+        else
+            str.append("null");
+    }
+
+
+    // Appends a name as UTF-8, quoted and escaped for JSON
+    void AppendString(std::string& str, const wchar_t* value)
+    {
+        char buff[MAX_PATH * 3];
+        int len = WideCharToMultiByte(CP_UTF8, 0, value, -1, buff, static_cast<int>(sizeof(buff)), nullptr, nullptr);
+        if (len <= 0)
+            buff[0] = 0;
+
+        str.push_back('"');
+        for (const char* ptr = buff; *ptr; ++ptr)
+        {
+            if (*ptr == '"' || *ptr == '\\')
+                str.push_back('\\');
+            str.push_back(*ptr);
+        }
+        str.push_back('"');
+    }
+
+
+    // Describes the build, since results are only comparable between like builds
+    void AppendBuildInfo(std::string& str)
+    {
+#if defined(_M_X64)
+        const char* platform = "x64";
+#elif defined(_M_ARM64)
+        const char* platform = "ARM64";
+#elif defined(_M_ARM)
+        const char* platform = "ARM";
+#else
+        const char* platform = "x86";
+#endif
+
+#if defined(_XM_NO_INTRINSICS_)
+        const char* simd = "none";
+#elif defined(__AVX2__)
+        const char* simd = "AVX2";
+#elif defined(__AVX__)
+        const char* simd = "AVX";
+#elif defined(_XM_ARM_NEON_INTRINSICS_)
+        const char* simd = "NEON";
+#else
+        const char* simd = "SSE2";
+#endif
+
+#ifdef _MSC_FULL_VER
+        const unsigned long long compiler = _MSC_FULL_VER;
+#else
+        const unsigned long long compiler = 0;
+#endif
+
+#ifdef _DEBUG
+        const char* config = "debug";
+#else
+        const char* config = "release";
+#endif
+
+#ifdef _OPENMP
+        const bool openmp = true;
+#else
+        const bool openmp = false;
+#endif
+
+        AppendFormat(str, "  \"build\": { \"compiler\": %llu, \"platform\": \"%s\", \"simd\": \"%s\", \"config\": \"%s\", \"openmp\": %s, \"hardwareThreads\": %u },\n",
+            compiler, platform, simd, config, (openmp) ? "true" : "false", std::thread::hardware_concurrency());
+    }
+
+
+    HRESULT WriteReport(const wchar_t* szFile, const std::vector<std::unique_ptr<SCorpusImage>>& corpus,
+        const std::vector<SBenchResult>& results, size_t size, uint32_t seed, size_t iterations)
+    {
+        std::string report;
+        try
+        {
+            report.append("{\n  \"tool\": \"texbench\",\n");
+            AppendBuildInfo(report);
+            AppendFormat(report, "  \"size\": %zu,\n  \"seed\": %u,\n  \"iterations\": %zu,\n", size, seed, iterations);
+
+            report.append("  \"corpus\": [\n");
+            for (size_t i = 0; i < corpus.size(); ++i)
+            {
+                const SCorpusImage& item = *corpus[i];
+                const TexMetadata& info = item.source.GetMetadata();
+
+                report.append("    { \"name\": ");
+                AppendString(report, item.szName);
+                report.append(", \"kind\": ");
+                AppendString(report, LookupByValue(item.kind, g_pKinds));
+                AppendFormat(report, ", \"width\": %zu, \"height\": %zu, \"format\": ", info.width, info.height);
+                AppendString(report, LookupByValue(static_cast<DWORD>(info.format), g_pFormats));
+                AppendFormat(report, ", \"hash\": \"%08x\" }%s\n", item.hash, (i + 1 < corpus.size()) ? "," : "");
+            }
+
+            report.append("  ],\n  \"results\": [\n");
+            for (size_t i = 0; i < results.size(); ++i)
+            {
+                const SBenchResult& result = results[i];
+
+                report.append("    { \"path\": ");
+                AppendString(report, result.pPath);
+                report.append(", \"mode\": ");
+                AppendString(report, result.pMode);
+                report.append(", \"format\": ");
+                AppendString(report, LookupByValue(static_cast<DWORD>(result.format), g_pFormats));
+                AppendFormat(report, ", \"image\": %zu, \"threads\": %zu, \"blocks\": %zu, \"status\": \"%s\", \"hr\": \"0x%08X\"",
+                    result.image, result.threads, result.blocks, FAILED(result.hr) ? "failed" : "ok", static_cast<unsigned int>(result.hr));
+
+                if (SUCCEEDED(result.hr))
+                {
+                    report.append(",\n      \"bestTime\": ");
+                    AppendNumber(report, result.bestTime);
+                    report.append(", \"medianTime\": ");
+                    AppendNumber(report, result.medianTime);
+                    report.append(", \"blocksPerSecond\": ");
+                    AppendNumber(report, (result.bestTime > 0) ? double(result.blocks) / result.bestTime : 0);
+                    report.append(", \"psnr\": ");
+                    AppendNumber(report, result.metrics.psnr);
+                    report.append(", \"ssim\": ");
+                    AppendNumber(report, result.metrics.ssim);
+                    report.append(", \"maxError\": ");
+                    AppendNumber(report, result.metrics.maxError);
+                    AppendFormat(report, ", \"privateBytes\": %zu, \"peakWorkingSet\": %zu", result.privateBytes, result.peakWorkingSet);
+                }
+
+                AppendFormat(report, " }%s\n", (i + 1 < results.size()) ? "," : "");
+            }
+
+            report.append("  ]\n}\n");
+        }
+        catch (const std::bad_alloc&)
+        {
+            return E_OUTOFMEMORY;
+        }
+
+        std::ofstream outFile(szFile, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!outFile)
+            return HRESULT_FROM_WIN32(ERROR_CANNOT_MAKE);
+
+        outFile.write(report.data(), static_cast<std::streamsize>(report.size()));
+        if (!outFile)
+            return HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+
+        return S_OK;
+    }
+
+
+    // Parses "n[,n...]" into non-zero counts
+    bool ParseCounts(const wchar_t* pValue, std::vector<size_t>& counts)
+    {
+        counts.clear();
+        while (*pValue)
+        {
+            wchar_t* pEnd = nullptr;
+            const unsigned long n = wcstoul(pValue, &pEnd, 10);
+            if (pEnd == pValue || !n || (*pEnd && *pEnd != L','))
+                return false;
+
+            counts.push_back(n);
+            pValue = (*pEnd) ? pEnd + 1 : pEnd;
+        }
+
+        return !counts.empty();
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Entry-point
+//--------------------------------------------------------------------------------------
+#pragma prefast(disable : 28198, "Command-line tool, frees all memory on exit")
+
+int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
+{
+    // Parameters and defaults
+    size_t size = c_DefaultSize;
+    uint32_t seed = 1;
+    wchar_t szOutputFile[MAX_PATH] = {};
+
+    SBenchOptions opts;
+    opts.iterations = c_DefaultIterations;
+    opts.compress = true;
+    opts.encode = true;
+
+    // Initialize COM (needed for WIC)
+    HRESULT hr = hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    if (FAILED(hr))
+    {
+        wprintf(L"Failed to initialize COM (%08X)\n", hr);
+        return 1;
+    }
+
+    // Process command line
+    DWORD dwOptions = 0;
+    std::list<SConversion> conversion;
+
+    for (int iArg = 1; iArg < argc; iArg++)
+    {
+        PWSTR pArg = argv[iArg];
+
+        if (('-' == pArg[0]) || ('/' == pArg[0]))
+        {
+            pArg++;
+            PWSTR pValue;
+
+            for (pValue = pArg; *pValue && (':' != *pValue); pValue++);
+
+            if (*pValue)
+                *pValue++ = 0;
+
+            DWORD dwOption = LookupByName(pArg, g_pOptions);
+
+            if (!dwOption || (dwOptions & (1 << dwOption)))
+            {
+                PrintUsage();
+                return 1;
+            }
+
+            dwOptions |= 1 << dwOption;
+
+            // Handle options with additional value parameter
+            switch (dwOption)
+            {
+            case OPT_OUTPUTFILE:
+            case OPT_FILELIST:
+            case OPT_MODES:
+            case OPT_THREADS:
+            case OPT_ITERATIONS:
+            case OPT_SIZE:
+            case OPT_SEED:
+                if (!*pValue)
+                {
+                    if ((iArg + 1 >= argc))
+                    {
+                        PrintUsage();
+                        return 1;
+                    }
+
+                    iArg++;
+                    pValue = argv[iArg];
+                }
+                break;
+            }
+
+            switch (dwOption)
+            {
+            case OPT_OUTPUTFILE:
+                wcscpy_s(szOutputFile, MAX_PATH, pValue);
+                break;
+
+            case OPT_FILELIST:
+                {
+                    std::wifstream inFile(pValue);
+                    if (!inFile)
+                    {
+                        wprintf(L"Error opening -flist file %ls\n", pValue);
+                        return 1;
+                    }
+                    wchar_t fname[1024] = {};
+                    for (;;)
+                    {
+                        inFile >> fname;
+                        if (!inFile)
+                            break;
+
+                        if (*fname == L'#')
+                        {
+                            // Comment
+                        }
+                        else if (*fname == L'-')
+                        {
+                            wprintf(L"Command-line arguments not supported in -flist file\n");
+                            return 1;
+                        }
+                        else if (wcspbrk(fname, L"?*") != nullptr)
+                        {
+                            wprintf(L"Wildcards not supported in -flist file\n");
+                            return 1;
+                        }
+                        else
+                        {
+                            SConversion conv;
+                            wcscpy_s(conv.szSrc, MAX_PATH, fname);
+                            conversion.push_back(conv);
+                        }
+
+                        inFile.ignore(1000, '\n');
+                    }
+                    inFile.close();
+                }
+                break;
+
+            case OPT_MODES:
+                {
+                    std::wstring modes(pValue);
+                    for (size_t start = 0; start <= modes.size();)
+                    {
+                        size_t end = modes.find(L',', start);
+                        if (end == std::wstring::npos)
+                            end = modes.size();
+
+                        if (end > start)
+                            opts.modes.emplace_back(modes, start, end - start);
+
+                        start = end + 1;
+                    }
+
+                    if (opts.modes.empty())
+                    {
+                        wprintf(L"Invalid value specified with -m (%ls)\n", pValue);
+                        return 1;
+                    }
+                }
+                break;
+
+            case OPT_THREADS:
+                if (!ParseCounts(pValue, opts.threads))
+                {
+                    wprintf(L"Invalid value specified with -threads (%ls)\n", pValue);
+                    return 1;
+                }
+                break;
+
+            case OPT_ITERATIONS:
+                if (swscanf_s(pValue, L"%zu", &opts.iterations) != 1 || !opts.iterations)
+                {
+                    wprintf(L"Invalid value specified with -n (%ls)\n", pValue);
+                    return 1;
+                }
+                break;
+
+            case OPT_SIZE:
+                if (swscanf_s(pValue, L"%zu", &size) != 1 || size < 4 || (size % 4) != 0 || size > 16384)
+                {
+                    wprintf(L"Invalid value specified with -size (%ls), must be a multiple of 4 up to 16384\n", pValue);
+                    return 1;
+                }
+                break;
+
+            case OPT_SEED:
+                if (swscanf_s(pValue, L"%u", &seed) != 1)
+                {
+                    wprintf(L"Invalid value specified with -seed (%ls)\n", pValue);
+                    return 1;
+                }
+                break;
+
+            case OPT_COMPRESS_ONLY:
+                opts.encode = false;
+                break;
+
+            case OPT_ENCODE_ONLY:
+                opts.compress = false;
+                break;
+            }
+        }
+        else if (wcspbrk(pArg, L"?*") != nullptr)
+        {
+            size_t count = conversion.size();
+            SearchForFiles(pArg, conversion, (dwOptions & (1 << OPT_RECURSIVE)) != 0);
+            if (conversion.size() <= count)
+            {
+                wprintf(L"No matching files found for %ls\n", pArg);
+                return 1;
+            }
+        }
+        else
+        {
+            SConversion conv;
+            wcscpy_s(conv.szSrc, MAX_PATH, pArg);
+
+            conversion.push_back(conv);
+        }
+    }
+
+    if (!opts.compress && !opts.encode)
+    {
+        wprintf(L"-compressonly and -encodeonly are mutually exclusive\n");
+        return 1;
+    }
+
+    if ((dwOptions & (1 << OPT_NO_SYNTHETIC)) && conversion.empty())
+    {
+        PrintUsage();
+        return 0;
+    }
+
+    if (opts.threads.empty())
+    {
+        opts.threads.push_back(1);
+
+        const size_t cores = std::thread::hardware_concurrency();
+        if (cores > 1)
+            opts.threads.push_back(cores);
+    }
+
+    if (*szOutputFile && (~dwOptions & (1 << OPT_OVERWRITE)))
+    {
+        if (GetFileAttributesW(szOutputFile) != INVALID_FILE_ATTRIBUTES)
+        {
+            wprintf(L"ERROR: Output file already exists, use -y to overwrite\n");
+            return 1;
+        }
+    }
+
+    if (~dwOptions & (1 << OPT_NOLOGO))
+        PrintLogo();
+
+    // Build the corpus
+    std::vector<std::unique_ptr<SCorpusImage>> corpus;
+
+    if (~dwOptions & (1 << OPT_NO_SYNTHETIC))
+    {
+        static const struct { const wchar_t* pName; DWORD kind; } s_synthetic[] =
+        {
+            { L"synthetic_albedo",  KIND_ALBEDO },
+            { L"synthetic_normal",  KIND_NORMAL },
+            { L"synthetic_hdr",     KIND_HDR },
+            { L"synthetic_alpha",   KIND_ALPHA },
+        };
+
+        for (size_t i = 0; i < _countof(s_synthetic); ++i)
+        {
+            std::unique_ptr<SCorpusImage> item(new (std::nothrow) SCorpusImage);
+            if (!item)
+            {
+                wprintf(L"ERROR: Memory allocation failed\n");
+                return 1;
+            }
+
+            wcscpy_s(item->szName, s_synthetic[i].pName);
+            item->kind = s_synthetic[i].kind;
+
+            switch (item->kind)
+            {
+            case KIND_NORMAL:   hr = GenerateNormal(size, seed, item->source); break;
+            case KIND_HDR:      hr = GenerateHDR(size, seed, item->source); break;
+            default:            hr = GenerateAlbedo(size, seed, item->source, item->kind == KIND_ALPHA); break;
+            }
+
+            if (SUCCEEDED(hr))
+                hr = PrepareCorpusImage(*item);
+
+            if (FAILED(hr))
+            {
+                wprintf(L"ERROR: Failed generating %ls (%08X)\n", item->szName, static_cast<unsigned int>(hr));
+                return 1;
+            }
+
+            corpus.emplace_back(std::move(item));
+        }
+    }
+
+    for (auto& conv : conversion)
+    {
+        std::unique_ptr<SCorpusImage> item(new (std::nothrow) SCorpusImage);
+        if (!item)
+        {
+            wprintf(L"ERROR: Memory allocation failed\n");
+            return 1;
+        }
+
+        hr = LoadCorpusImage(conv.szSrc, *item);
+        if (SUCCEEDED(hr))
+            hr = PrepareCorpusImage(*item);
+
+        if (FAILED(hr))
+        {
+            wprintf(L"ERROR: Failed loading %ls (%08X)\n", conv.szSrc, static_cast<unsigned int>(hr));
+            return 1;
+        }
+
+        corpus.emplace_back(std::move(item));
+    }
+
+    for (auto& item : corpus)
+    {
+        const TexMetadata& info = item->source.GetMetadata();
+        wprintf(L"%ls (%zux%zu %ls, %08x)\n", item->szName, info.width, info.height,
+            LookupByValue(item->kind, g_pKinds), item->hash);
+    }
+    wprintf(L"\n");
+
+    // Run every selected mode on every image of a kind it applies to, for each thread count
+    std::vector<SBenchResult> results;
+    size_t failed = 0;
+
+    for (size_t image = 0; image < corpus.size(); ++image)
+    {
+        const SCorpusImage& item = *corpus[image];
+
+        for (size_t threads : opts.threads)
+        {
+            if (opts.compress)
+            {
+                for (const SCompressMode* pMode = g_pCompressModes; pMode->pName; ++pMode)
+                {
+                    if (!(pMode->kinds & item.kind) || !MatchesMode(pMode->pName, opts.modes))
+                        continue;
+
+                    SBenchResult result = {};
+                    result.pPath = L"compress";
+                    result.pMode = pMode->pName;
+                    result.format = pMode->format;
+                    result.image = image;
+                    result.threads = threads;
+
+                    RunCompress(*pMode, item, threads, opts.iterations, result);
+                    if (FAILED(result.hr))
+                        ++failed;
+
+                    PrintResult(result, item);
+                    results.push_back(result);
+                }
+            }
+
+            if (opts.encode)
+            {
+                for (const SBlockEncoder* pEncoder = g_pBlockEncoders; pEncoder->pName; ++pEncoder)
+                {
+                    if (!(pEncoder->kinds & item.kind) || !MatchesMode(pEncoder->pName, opts.modes))
+                        continue;
+
+                    SBenchResult result = {};
+                    result.pPath = L"encode";
+                    result.pMode = pEncoder->pName;
+                    result.format = pEncoder->format;
+                    result.image = image;
+                    result.threads = threads;
+
+                    RunEncoder(*pEncoder, item, threads, opts.iterations, result);
+                    if (FAILED(result.hr))
+                        ++failed;
+
+                    PrintResult(result, item);
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+
+    if (results.empty())
+    {
+        wprintf(L"No modes selected for this corpus\n");
+        return 1;
+    }
+
+    wprintf(L"\n%zu results, %zu failed\n", results.size(), failed);
+
+    if (*szOutputFile)
+    {
+        hr = WriteReport(szOutputFile, corpus, results, size, seed, opts.iterations);
+        if (FAILED(hr))
+        {
+            wprintf(L"ERROR: Failed writing report %ls (%08X)\n", szOutputFile, static_cast<unsigned int>(hr));
+            return 1;
+        }
+
+        wprintf(L"Report %ls\n", szOutputFile);
+    }
+
+    return (failed > 0) ? 1 : 0;
+}
@@ -19,13 +19,21 @@
 #define NOHELP
 #pragma warning(pop)
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <memory>
 #include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <wrl\client.h>
 
@@ -104,6 +112,9 @@ enum OPTIONS
     OPT_FILELIST,
     OPT_ROTATE_COLOR,
     OPT_PAPER_WHITE_NITS,
+    OPT_JOBS,
+    OPT_CACHE,
+    OPT_SPECULAR_AA,
     OPT_MAX
 };
 
@@ -189,6 +200,9 @@ const SValue g_pOptions[] =
     { L"flist",         OPT_FILELIST },
     { L"rotatecolor",   OPT_ROTATE_COLOR },
     { L"nits",          OPT_PAPER_WHITE_NITS },
+    { L"j",             OPT_JOBS },
+    { L"cache",         OPT_CACHE },
+    { L"specaa",        OPT_SPECULAR_AA },
     { nullptr,          0 }
 };
 
@@ -550,13 +564,133 @@ namespace
     }
 
 
-    void PrintFormat(DXGI_FORMAT Format)
+    //--------------------------------------------------------------------------------------
+    // Conversion pipeline
+    //--------------------------------------------------------------------------------------
+    enum CONVERSION_STAGE
+    {
+        STAGE_LOAD = 0,
+        STAGE_PROCESS,
+        STAGE_MIPS,
+        STAGE_COMPRESS,
+        STAGE_SAVE,
+        STAGE_MAX
+    };
+
+    const wchar_t* g_pStageNames[STAGE_MAX] =
+    {
+        L"load",
+        L"process",
+        L"mips",
+        L"compress",
+        L"save",
+    };
+
+    enum STAGE_RESULT
+    {
+        STAGE_OK = 0,   // Continue with the next stage
+        STAGE_SKIP,     // This file failed, move on to the next one
+        STAGE_DONE,     // This file is finished without running the remaining stages
+        STAGE_ABORT,    // Stop processing files
+    };
+
+    // Upper bound on the roughness widening applied by -specaa (in alpha^2)
+    const float c_SpecularAAMaxVariance = 0.18f;
+
+    // Settings from the command line, shared by all files
+    struct SConvertOptions
+    {
+        size_t width;
+        size_t height;
+        size_t mipLevels;
+        DXGI_FORMAT format;
+        DWORD dwFilter;
+        DWORD dwSRGB;
+        DWORD dwConvert;
+        DWORD dwCompress;
+        DWORD dwFilterOpts;
+        DWORD FileType;
+        DWORD maxSize;
+        int adapter;
+        float alphaWeight;
+        DWORD dwNormalMap;
+        float nmapAmplitude;
+        float wicQuality;
+        DWORD colorKey;
+        DWORD dwRotateColor;
+        float paperWhiteNits;
+        DWORD64 dwOptions;
+        size_t jobs;
+        wchar_t szPrefix[MAX_PATH];
+        wchar_t szSuffix[MAX_PATH];
+        wchar_t szCacheDir[MAX_PATH];   // Build cache directory with trailing slash, or empty
+        uint64_t cacheSeed;             // Hash of the options that affect the output
+        const ScratchImage* pSpecularAANormals; // Normal map for -specaa, or nullptr
+    };
+
+    // State shared by all files
+    struct SSharedState
+    {
+        std::atomic<bool> nonpow2warn;
+        std::atomic<bool> non4bc;
+        std::mutex deviceLock;
+        bool deviceTried;
+        ComPtr<ID3D11Device> pDevice;
+        LONGLONG stageTime[STAGE_MAX];  // QPC ticks summed over all files
+        std::atomic<size_t> cacheHits;
+        std::atomic<size_t> cacheMisses;
+
+        SSharedState() : nonpow2warn(false), non4bc(false), deviceTried(false), stageTime{}, cacheHits(0), cacheMisses(0) {}
+    };
+
+    // Per-file state carried between stages
+    struct SConversionJob
+    {
+        SConversion* pConv;
+        TexMetadata info;
+        std::unique_ptr<ScratchImage> image;
+        std::unique_ptr<ScratchImage> cimage;   // Original compressed image, kept in case it can be reused
+        size_t tMips;
+        size_t twidth;
+        size_t theight;
+        DXGI_FORMAT tformat;
+        std::wstring* log;                      // Buffered output for -j, or nullptr to write directly
+        std::wstring output;
+        uint64_t cacheKey;                      // Hash of the source file and options
+        bool cacheMiss;                         // Store the result in the build cache once saved
+
+        SConversionJob() : pConv(nullptr), info{}, tMips(0), twidth(0), theight(0), tformat(DXGI_FORMAT_UNKNOWN), log(nullptr), cacheKey(0), cacheMiss(false) {}
+    };
+
+
+    void Print(_Inout_opt_ std::wstring* log, _In_z_ _Printf_format_string_ const wchar_t* format, ...)
+    {
+        va_list args;
+        va_start(args, format);
+
+        if (log)
+        {
+            wchar_t buff[2048];
+            int len = vswprintf_s(buff, format, args);
+            if (len > 0)
+                log->append(buff, static_cast<size_t>(len));
+        }
+        else
+        {
+            vwprintf(format, args);
+        }
+
+        va_end(args);
+    }
+
+
+    void PrintFormat(DXGI_FORMAT Format, _Inout_opt_ std::wstring* log = nullptr)
     {
         for (const SValue *pFormat = g_pFormats; pFormat->pName; pFormat++)
         {
             if ((DXGI_FORMAT)pFormat->dwValue == Format)
             {
-                wprintf(pFormat->pName);
+                Print(log, L"%ls", pFormat->pName);
                 return;
             }
         }
@@ -565,67 +699,67 @@ namespace
         {
             if ((DXGI_FORMAT)pFormat->dwValue == Format)
             {
-                wprintf(pFormat->pName);
+                Print(log, L"%ls", pFormat->pName);
                 return;
             }
         }
 
-        wprintf(L"*UNKNOWN*");
+        Print(log, L"*UNKNOWN*");
     }
 
 
-    void PrintInfo(const TexMetadata& info)
+    void PrintInfo(const TexMetadata& info, _Inout_opt_ std::wstring* log = nullptr)
     {
-        wprintf(L" (%zux%zu", info.width, info.height);
+        Print(log, L" (%zux%zu", info.width, info.height);
 
         if (TEX_DIMENSION_TEXTURE3D == info.dimension)
-            wprintf(L"x%zu", info.depth);
+            Print(log, L"x%zu", info.depth);
 
         if (info.mipLevels > 1)
-            wprintf(L",%zu", info.mipLevels);
+            Print(log, L",%zu", info.mipLevels);
 
         if (info.arraySize > 1)
-            wprintf(L",%zu", info.arraySize);
+            Print(log, L",%zu", info.arraySize);
 
-        wprintf(L" ");
-        PrintFormat(info.format);
+        Print(log, L" ");
+        PrintFormat(info.format, log);
 
         switch (info.dimension)
         {
         case TEX_DIMENSION_TEXTURE1D:
-            wprintf((info.arraySize > 1) ? L" 1DArray" : L" 1D");
+            Print(log, (info.arraySize > 1) ? L" 1DArray" : L" 1D");
             break;
 
         case TEX_DIMENSION_TEXTURE2D:
             if (info.IsCubemap())
             {
-                wprintf((info.arraySize > 6) ? L" CubeArray" : L" Cube");
+                Print(log, (info.arraySize > 6) ? L" CubeArray" : L" Cube");
             }
             else
             {
-                wprintf((info.arraySize > 1) ? L" 2DArray" : L" 2D");
+                Print(log, (info.arraySize > 1) ? L" 2DArray" : L" 2D");
             }
             break;
 
         case TEX_DIMENSION_TEXTURE3D:
-            wprintf(L" 3D");
+            Print(log, L" 3D");
             break;
         }
 
         switch (info.GetAlphaMode())
         {
         case TEX_ALPHA_MODE_OPAQUE:
-            wprintf(L" \x0e0:Opaque");
+            Print(log, L" \x0e0:Opaque");
             break;
         case TEX_ALPHA_MODE_PREMULTIPLIED:
-            wprintf(L" \x0e0:PM");
+            Print(log, L" \x0e0:PM");
             break;
         case TEX_ALPHA_MODE_STRAIGHT:
-            wprintf(L" \x0e0:NonPM");
+            Print(log, L" \x0e0:NonPM");
             break;
         }
 
-        wprintf(L")");
+        Print(log, L")");
     }
 
 
@@ -717,7 +851,7 @@ namespace
         wprintf(
             L"   -nmap <options>     converts height-map to normal-map\n"
             L"                       options must be one or more of\n"
-            L"                          r, g, b, a, l, m, u, v, i, o\n");
+            L"                          r, g, b, a, l, m, u, v, i, o, s, c\n");
         wprintf(L"   -nmapamp <weight>   normal map amplitude (defaults to 1.0)\n");
         wprintf(L"   -fl <feature-level> Set maximum feature level target (defaults to 11.0)\n");
         wprintf(L"\n                       (DDS input only)\n");
@@ -732,6 +866,9 @@ namespace
 #ifdef _OPENMP
         wprintf(L"   -singleproc         Do not use multi-threaded compression\n");
 #endif
+        wprintf(L"   -j <n>              Convert up to n files at a time (pipelined)\n");
+        wprintf(L"   -cache <dir>        Reuse results from <dir> for unchanged inputs and options\n");
+        wprintf(L"   -specaa <file>      widen roughness (green) by the variance of a normal map\n");
         wprintf(L"   -gpu <adapter>      Select GPU for DirectCompute-based codecs (0 is default)\n");
         wprintf(L"   -nogpu              Do not use DirectCompute-based codecs\n");
         wprintf(L"   -bcuniform          Use uniform rather than perceptual weighting for BC1-3\n");
@@ -1083,656 +1220,347 @@ namespace
 
         return S_OK;
     }
-}
 
+    // Loads the normal map used by -specaa, decompressing it if needed
+    HRESULT LoadNormalMap(_In_z_ const wchar_t* szFile, DWORD64 dwOptions, _Out_ ScratchImage& image)
+    {
+        wchar_t ext[_MAX_EXT];
+        _wsplitpath_s(szFile, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT);
 
-//--------------------------------------------------------------------------------------
-// Entry-point
-//--------------------------------------------------------------------------------------
-#pragma prefast(disable : 28198, "Command-line tool, frees all memory on exit")
+        TexMetadata info;
+        HRESULT hr;
+        if (_wcsicmp(ext, L".dds") == 0)
+        {
+            DWORD ddsFlags = DDS_FLAGS_NONE;
+            if (dwOptions & (DWORD64(1) << OPT_DDS_DWORD_ALIGN))
+                ddsFlags |= DDS_FLAGS_LEGACY_DWORD;
+            if (dwOptions & (DWORD64(1) << OPT_DDS_BAD_DXTN_TAILS))
+                ddsFlags |= DDS_FLAGS_BAD_DXTN_TAILS;
 
-int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
-{
-    // Parameters and defaults
-    size_t width = 0;
-    size_t height = 0;
-    size_t mipLevels = 0;
-    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
-    DWORD dwFilter = TEX_FILTER_DEFAULT;
-    DWORD dwSRGB = 0;
-    DWORD dwConvert = 0;
-    DWORD dwCompress = TEX_COMPRESS_DEFAULT;
-    DWORD dwFilterOpts = 0;
-    DWORD FileType = CODEC_DDS;
-    DWORD maxSize = 16384;
-    int adapter = -1;
-    float alphaWeight = 1.f;
-    DWORD dwNormalMap = 0;
-    float nmapAmplitude = 1.f;
-    float wicQuality = -1.f;
-    DWORD colorKey = 0;
-    DWORD dwRotateColor = 0;
-    float paperWhiteNits = 200.f;
+            hr = LoadFromDDSFile(szFile, ddsFlags, &info, image);
+        }
+        else if (_wcsicmp(ext, L".tga") == 0)
+        {
+            hr = LoadFromTGAFile(szFile, &info, image);
+        }
+        else if (_wcsicmp(ext, L".hdr") == 0)
+        {
+            hr = LoadFromHDRFile(szFile, &info, image);
+        }
+        else
+        {
+            hr = LoadFromWICFile(szFile, WIC_FLAGS_NONE, &info, image);
+        }
+        if (FAILED(hr))
+            return hr;
 
-    wchar_t szPrefix[MAX_PATH];
-    wchar_t szSuffix[MAX_PATH];
-    wchar_t szOutputDir[MAX_PATH];
+        if (IsTypeless(info.format))
+        {
+            info.format = MakeTypelessUNORM(info.format);
+            image.OverrideFormat(info.format);
+        }
 
-    szPrefix[0] = 0;
-    szSuffix[0] = 0;
-    szOutputDir[0] = 0;
+        if (IsCompressed(info.format))
+        {
+            // Keep the encoding (UNORM normals are biased) and two-channel BC5 so Z is reconstructed when read
+            DXGI_FORMAT tformat = DXGI_FORMAT_R8G8B8A8_UNORM;
+            switch (info.format)
+            {
+            case DXGI_FORMAT_BC5_UNORM:     tformat = DXGI_FORMAT_R16G16_UNORM; break;
+            case DXGI_FORMAT_BC5_SNORM:     tformat = DXGI_FORMAT_R16G16_SNORM; break;
+            case DXGI_FORMAT_BC6H_UF16:
+            case DXGI_FORMAT_BC6H_SF16:     tformat = DXGI_FORMAT_R32G32B32A32_FLOAT; break;
+            default:                        break;
+            }
 
-    // Initialize COM (needed for WIC)
-    HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
-    if (FAILED(hr))
-    {
-        wprintf(L"Failed to initialize COM (%08X)\n", hr);
-        return 1;
+            ScratchImage timage;
+            hr = Decompress(image.GetImages(), image.GetImageCount(), info, tformat, timage);
+            if (FAILED(hr))
+                return hr;
+
+            image = std::move(timage);
+        }
+
+        return S_OK;
     }
 
-    // Process command line
-    DWORD64 dwOptions = 0;
-    std::list<SConversion> conversion;
+    //--------------------------------------------------------------------------------------
+    // Build cache
+    //--------------------------------------------------------------------------------------
 
-    for (int iArg = 1; iArg < argc; iArg++)
-    {
-        PWSTR pArg = argv[iArg];
+    // Bump this whenever a change to texconv or DirectXTex alters the output for the same inputs
+    const uint32_t c_CacheVersion = 3;
 
-        if (('-' == pArg[0]) || ('/' == pArg[0]))
+    // 64-bit FNV-1a
+    uint64_t HashBytes(_In_reads_bytes_(size) const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+    {
+        auto ptr = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
         {
-            pArg++;
-            PWSTR pValue;
-
-            for (pValue = pArg; *pValue && (':' != *pValue); pValue++);
+            hash ^= ptr[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
 
-            if (*pValue)
-                *pValue++ = 0;
+    template<typename T>
+    uint64_t HashValue(const T& value, uint64_t hash)
+    {
+        return HashBytes(&value, sizeof(T), hash);
+    }
 
-            DWORD dwOption = LookupByName(pArg, g_pOptions);
 
-            if (!dwOption || (dwOptions & (DWORD64(1) << dwOption)))
+    uint64_t HashOptions(const SConvertOptions& opts)
+    {
+        // Switches that only affect file naming, console output, or threading
+        const DWORD64 ignored = (DWORD64(1) << OPT_RECURSIVE)
+            | (DWORD64(1) << OPT_PREFIX)
+            | (DWORD64(1) << OPT_SUFFIX)
+            | (DWORD64(1) << OPT_OUTPUTDIR)
+            | (DWORD64(1) << OPT_OVERWRITE)
+            | (DWORD64(1) << OPT_NOLOGO)
+            | (DWORD64(1) << OPT_TIMING)
+            | (DWORD64(1) << OPT_FORCE_SINGLEPROC)
+            | (DWORD64(1) << OPT_GPU)
+            | (DWORD64(1) << OPT_FILELIST)
+            | (DWORD64(1) << OPT_JOBS)
+            | (DWORD64(1) << OPT_CACHE);
+
+        uint64_t hash = HashBytes(&c_CacheVersion, sizeof(c_CacheVersion));
+        hash = HashValue(opts.dwOptions & ~ignored, hash);
+        hash = HashValue(opts.width, hash);
+        hash = HashValue(opts.height, hash);
+        hash = HashValue(opts.mipLevels, hash);
+        hash = HashValue(opts.format, hash);
+        hash = HashValue(opts.dwFilter, hash);
+        hash = HashValue(opts.dwSRGB, hash);
+        hash = HashValue(opts.dwConvert, hash);
+        hash = HashValue(opts.dwCompress, hash);
+        hash = HashValue(opts.dwFilterOpts, hash);
+        hash = HashValue(opts.FileType, hash);
+        hash = HashValue(opts.maxSize, hash);
+        hash = HashValue(opts.alphaWeight, hash);
+        hash = HashValue(opts.dwNormalMap, hash);
+        hash = HashValue(opts.nmapAmplitude, hash);
+        hash = HashValue(opts.wicQuality, hash);
+        hash = HashValue(opts.colorKey, hash);
+        hash = HashValue(opts.dwRotateColor, hash);
+        hash = HashValue(opts.paperWhiteNits, hash);
+
+        if (opts.pSpecularAANormals)
+        {
+            // The normal map contents affect the output, not its path
+            const Image* images = opts.pSpecularAANormals->GetImages();
+            for (size_t i = 0; i < opts.pSpecularAANormals->GetImageCount(); ++i)
             {
-                PrintUsage();
-                return 1;
+                hash = HashBytes(images[i].pixels, images[i].slicePitch, hash);
             }
+        }
 
-            dwOptions |= (DWORD64(1) << dwOption);
+        return hash;
+    }
 
-            // Handle options with additional value parameter
-            switch (dwOption)
-            {
-            case OPT_WIDTH:
-            case OPT_HEIGHT:
-            case OPT_MIPLEVELS:
-            case OPT_FORMAT:
-            case OPT_FILTER:
-            case OPT_PREFIX:
-            case OPT_SUFFIX:
-            case OPT_OUTPUTDIR:
-            case OPT_FILETYPE:
-            case OPT_GPU:
-            case OPT_FEATURE_LEVEL:
-            case OPT_ALPHA_WEIGHT:
-            case OPT_NORMAL_MAP:
-            case OPT_NORMAL_MAP_AMPLITUDE:
-            case OPT_WIC_QUALITY:
-            case OPT_COLORKEY:
-            case OPT_FILELIST:
-            case OPT_ROTATE_COLOR:
-            case OPT_PAPER_WHITE_NITS:
-                if (!*pValue)
-                {
-                    if ((iArg + 1 >= argc))
-                    {
-                        PrintUsage();
-                        return 1;
-                    }
 
-                    iArg++;
-                    pValue = argv[iArg];
-                }
-                break;
-            }
+    void MakeOutputPath(SConversion& conv, const SConvertOptions& opts)
+    {
+        wchar_t *pchSlash, *pchDot;
 
-            switch (dwOption)
-            {
-            case OPT_WIDTH:
-                if (swscanf_s(pValue, L"%zu", &width) != 1)
-                {
-                    wprintf(L"Invalid value specified with -w (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        wcscpy_s(conv.szDest, MAX_PATH, opts.szPrefix);
 
-            case OPT_HEIGHT:
-                if (swscanf_s(pValue, L"%zu", &height) != 1)
-                {
-                    wprintf(L"Invalid value specified with -h (%ls)\n", pValue);
-                    printf("\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        pchSlash = wcsrchr(conv.szSrc, L'\\');
+        if (pchSlash != 0)
+            wcscat_s(conv.szDest, MAX_PATH, pchSlash + 1);
+        else
+            wcscat_s(conv.szDest, MAX_PATH, conv.szSrc);
 
-            case OPT_MIPLEVELS:
-                if (swscanf_s(pValue, L"%zu", &mipLevels) != 1)
-                {
-                    wprintf(L"Invalid value specified with -m (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        pchSlash = wcsrchr(conv.szDest, '\\');
+        pchDot = wcsrchr(conv.szDest, '.');
 
-            case OPT_FORMAT:
-                format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormats));
-                if (!format)
-                {
-                    format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormatAliases));
-                    if (!format)
-                    {
-                        wprintf(L"Invalid value specified with -f (%ls)\n", pValue);
-                        wprintf(L"\n");
-                        PrintUsage();
-                        return 1;
-                    }
-                }
-                break;
+        if (pchDot > pchSlash)
+            *pchDot = 0;
 
-            case OPT_FILTER:
-                dwFilter = LookupByName(pValue, g_pFilters);
-                if (!dwFilter)
-                {
-                    wprintf(L"Invalid value specified with -if (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        wcscat_s(conv.szDest, MAX_PATH, opts.szSuffix);
+    }
 
-            case OPT_ROTATE_COLOR:
-                dwRotateColor = LookupByName(pValue, g_pRotateColor);
-                if (!dwRotateColor)
-                {
-                    wprintf(L"Invalid value specified with -rotatecolor (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
 
-            case OPT_SRGBI:
-                dwSRGB |= TEX_FILTER_SRGB_IN;
-                break;
+    void MakeCachePath(uint64_t key, const SConvertOptions& opts, _Out_writes_(MAX_PATH) wchar_t* szPath)
+    {
+        const wchar_t* ext = wcsrchr(opts.szSuffix, L'.');
+        swprintf_s(szPath, MAX_PATH, L"%ls%016llx%ls", opts.szCacheDir, static_cast<unsigned long long>(key), (ext) ? ext : L"");
+    }
 
-            case OPT_SRGBO:
-                dwSRGB |= TEX_FILTER_SRGB_OUT;
-                break;
 
-            case OPT_SRGB:
-                dwSRGB |= TEX_FILTER_SRGB;
-                break;
+    // Copies the result from the build cache if the source file and options are unchanged
+    STAGE_RESULT CheckCache(SConversionJob& job, const SConvertOptions& opts, SSharedState& shared)
+    {
+        SConversion* pConv = job.pConv;
+        std::wstring* log = job.log;
 
-            case OPT_SEPALPHA:
-                dwFilterOpts |= TEX_FILTER_SEPARATE_ALPHA;
-                break;
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+        if (FAILED(ReadData(pConv->szSrc, data, size)))
+        {
+            // Leave it to the loader to report the error
+            return STAGE_OK;
+        }
 
-            case OPT_NO_WIC:
-                dwFilterOpts |= TEX_FILTER_FORCE_NON_WIC;
-                break;
+        // The extension is part of the key since it picks the loader
+        wchar_t ext[_MAX_EXT];
+        _wsplitpath_s(pConv->szSrc, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT);
+        _wcslwr_s(ext);
 
-            case OPT_PREFIX:
-                wcscpy_s(szPrefix, MAX_PATH, pValue);
-                break;
+        uint64_t key = HashBytes(ext, wcslen(ext) * sizeof(wchar_t), opts.cacheSeed);
+        job.cacheKey = HashBytes(data.get(), size, key);
+        data.reset();
 
-            case OPT_SUFFIX:
-                wcscpy_s(szSuffix, MAX_PATH, pValue);
-                break;
+        wchar_t szEntry[MAX_PATH];
+        MakeCachePath(job.cacheKey, opts, szEntry);
 
-            case OPT_OUTPUTDIR:
-                wcscpy_s(szOutputDir, MAX_PATH, pValue);
-                break;
+        if (GetFileAttributesW(szEntry) != INVALID_FILE_ATTRIBUTES)
+        {
+            MakeOutputPath(*pConv, opts);
 
-            case OPT_FILETYPE:
-                FileType = LookupByName(pValue, g_pSaveFileTypes);
-                if (!FileType)
-                {
-                    wprintf(L"Invalid value specified with -ft (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+            Print(log, L" [cached]\nwriting %ls", pConv->szDest);
 
-            case OPT_PREMUL_ALPHA:
-                if (dwOptions & (DWORD64(1) << OPT_DEMUL_ALPHA))
+            if (~opts.dwOptions & (DWORD64(1) << OPT_OVERWRITE))
+            {
+                if (GetFileAttributesW(pConv->szDest) != INVALID_FILE_ATTRIBUTES)
                 {
-                    wprintf(L"Can't use -pmalpha and -alpha at same time\n\n");
-                    PrintUsage();
-                    return 1;
+                    Print(log, L"\nERROR: Output file already exists, use -y to overwrite:\n");
+                    return STAGE_SKIP;
                 }
-                break;
+            }
 
-            case OPT_DEMUL_ALPHA:
-                if (dwOptions & (DWORD64(1) << OPT_PREMUL_ALPHA))
-                {
-                    wprintf(L"Can't use -pmalpha and -alpha at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+            if (CopyFileW(szEntry, pConv->szDest, FALSE))
+            {
+                ++shared.cacheHits;
+                Print(log, L"\n");
+                return STAGE_DONE;
+            }
 
-            case OPT_TA_WRAP:
-                if (dwFilterOpts & TEX_FILTER_MIRROR)
-                {
-                    wprintf(L"Can't use -wrap and -mirror at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                dwFilterOpts |= TEX_FILTER_WRAP;
-                break;
+            // Entry may have been evicted or is unreadable, so fall back to a full conversion
+            Print(log, L" FAILED (%x), converting\nreading %ls", HRESULT_FROM_WIN32(GetLastError()), pConv->szSrc);
+        }
 
-            case OPT_TA_MIRROR:
-                if (dwFilterOpts & TEX_FILTER_WRAP)
-                {
-                    wprintf(L"Can't use -wrap and -mirror at same time\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                dwFilterOpts |= TEX_FILTER_MIRROR;
-                break;
+        ++shared.cacheMisses;
+        job.cacheMiss = true;
+        return STAGE_OK;
+    }
 
-            case OPT_NORMAL_MAP:
-            {
-                dwNormalMap = 0;
 
-                if (wcschr(pValue, L'l'))
-                {
-                    dwNormalMap |= CNMAP_CHANNEL_LUMINANCE;
-                }
-                else if (wcschr(pValue, L'r'))
-                {
-                    dwNormalMap |= CNMAP_CHANNEL_RED;
-                }
-                else if (wcschr(pValue, L'g'))
-                {
-                    dwNormalMap |= CNMAP_CHANNEL_GREEN;
-                }
-                else if (wcschr(pValue, L'b'))
-                {
-                    dwNormalMap |= CNMAP_CHANNEL_BLUE;
-                }
-                else if (wcschr(pValue, L'a'))
-                {
-                    dwNormalMap |= CNMAP_CHANNEL_ALPHA;
-                }
-                else
-                {
-                    wprintf(L"Invalid value specified for -nmap (%ls), missing l, r, g, b, or a\n\n", pValue);
-                    PrintUsage();
-                    return 1;
-                }
+    void StoreCache(const SConversionJob& job, const SConvertOptions& opts)
+    {
+        wchar_t szEntry[MAX_PATH];
+        MakeCachePath(job.cacheKey, opts, szEntry);
 
-                if (wcschr(pValue, L'm'))
-                {
-                    dwNormalMap |= CNMAP_MIRROR;
-                }
-                else
-                {
-                    if (wcschr(pValue, L'u'))
-                    {
-                        dwNormalMap |= CNMAP_MIRROR_U;
-                    }
-                    if (wcschr(pValue, L'v'))
-                    {
-                        dwNormalMap |= CNMAP_MIRROR_V;
-                    }
-                }
+        // Copy to a unique name first so that other texconv instances never see a partial entry
+        wchar_t szTemp[MAX_PATH];
+        swprintf_s(szTemp, L"%ls.%lu.%lu.tmp", szEntry, GetCurrentProcessId(), GetCurrentThreadId());
 
-                if (wcschr(pValue, L'i'))
-                {
-                    dwNormalMap |= CNMAP_INVERT_SIGN;
-                }
+        if (!CopyFileW(job.pConv->szDest, szTemp, FALSE)
+            || !MoveFileExW(szTemp, szEntry, MOVEFILE_REPLACE_EXISTING))
+        {
+            HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+            DeleteFileW(szTemp);
+            Print(job.log, L"WARNING: Failed to update build cache (%x)\n", hr);
+        }
+    }
 
-                if (wcschr(pValue, L'o'))
-                {
-                    dwNormalMap |= CNMAP_COMPUTE_OCCLUSION;
-                }
-            }
-            break;
 
-            case OPT_NORMAL_MAP_AMPLITUDE:
-                if (!dwNormalMap)
-                {
-                    wprintf(L"-nmapamp requires -nmap\n\n");
-                    PrintUsage();
-                    return 1;
-                }
-                else if (swscanf_s(pValue, L"%f", &nmapAmplitude) != 1)
-                {
-                    wprintf(L"Invalid value specified with -nmapamp (%ls)\n\n", pValue);
-                    PrintUsage();
-                    return 1;
-                }
-                else if (nmapAmplitude < 0.f)
-                {
-                    wprintf(L"Normal map amplitude must be positive (%ls)\n\n", pValue);
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+    //--------------------------------------------------------------------------------------
+    // Reads the source file and works out the target size
+    //--------------------------------------------------------------------------------------
+    STAGE_RESULT LoadStage(SConversionJob& job, const SConvertOptions& opts, SSharedState& shared)
+    {
+        SConversion* pConv = job.pConv;
+        TexMetadata& info = job.info;
+        auto& image = job.image;
+        size_t& tMips = job.tMips;
+        size_t& twidth = job.twidth;
+        size_t& theight = job.theight;
+        std::wstring* log = job.log;
 
-            case OPT_GPU:
-                if (swscanf_s(pValue, L"%d", &adapter) != 1)
-                {
-                    wprintf(L"Invalid value specified with -gpu (%ls)\n\n", pValue);
-                    PrintUsage();
-                    return 1;
-                }
-                else if (adapter < 0)
-                {
-                    wprintf(L"Adapter index (%ls)\n\n", pValue);
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        HRESULT hr;
 
-            case OPT_FEATURE_LEVEL:
-                maxSize = LookupByName(pValue, g_pFeatureLevels);
-                if (!maxSize)
-                {
-                    wprintf(L"Invalid value specified with -fl (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                break;
+        Print(log, L"reading %ls", pConv->szSrc);
+        fflush(stdout);
 
-            case OPT_ALPHA_WEIGHT:
-                if (swscanf_s(pValue, L"%f", &alphaWeight) != 1)
-                {
-                    wprintf(L"Invalid value specified with -aw (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                else if (alphaWeight < 0.f)
-                {
-                    wprintf(L"-aw (%ls) parameter must be positive\n", pValue);
-                    wprintf(L"\n");
-                    return 1;
-                }
-                break;
+        if (*opts.szCacheDir)
+        {
+            STAGE_RESULT result = CheckCache(job, opts, shared);
+            if (result != STAGE_OK)
+                return result;
+        }
 
-            case OPT_COMPRESS_UNIFORM:
-                dwCompress |= TEX_COMPRESS_UNIFORM;
-                break;
+        wchar_t ext[_MAX_EXT];
+        wchar_t fname[_MAX_FNAME];
+        _wsplitpath_s(pConv->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT);
 
-            case OPT_COMPRESS_MAX:
-                if (dwCompress & TEX_COMPRESS_BC7_QUICK)
+        image.reset(new (std::nothrow) ScratchImage);
+
+        if (!image)
+        {
+            Print(log, L"\nERROR: Memory allocation failed\n");
+            return STAGE_ABORT;
+        }
+
+        if (_wcsicmp(ext, L".dds") == 0)
+        {
+            DWORD ddsFlags = DDS_FLAGS_NONE;
+            if (opts.dwOptions & (DWORD64(1) << OPT_DDS_DWORD_ALIGN))
+                ddsFlags |= DDS_FLAGS_LEGACY_DWORD;
+            if (opts.dwOptions & (DWORD64(1) << OPT_EXPAND_LUMINANCE))
+                ddsFlags |= DDS_FLAGS_EXPAND_LUMINANCE;
+            if (opts.dwOptions & (DWORD64(1) << OPT_DDS_BAD_DXTN_TAILS))
+                ddsFlags |= DDS_FLAGS_BAD_DXTN_TAILS;
+
+            hr = LoadFromDDSFile(pConv->szSrc, ddsFlags, &info, *image);
+            if (FAILED(hr))
+            {
+                Print(log, L" FAILED (%x)\n", hr);
+                return STAGE_SKIP;
+            }
+
+            if (IsTypeless(info.format))
+            {
+                if (opts.dwOptions & (DWORD64(1) << OPT_TYPELESS_UNORM))
                 {
-                    wprintf(L"Can't use -bcmax and -bcquick at same time\n\n");
-                    PrintUsage();
-                    return 1;
+                    info.format = MakeTypelessUNORM(info.format);
                 }
-                dwCompress |= TEX_COMPRESS_BC7_USE_3SUBSETS;
-                break;
-
-            case OPT_COMPRESS_QUICK:
-                if (dwCompress & TEX_COMPRESS_BC7_USE_3SUBSETS)
+                else if (opts.dwOptions & (DWORD64(1) << OPT_TYPELESS_FLOAT))
                 {
-                    wprintf(L"Can't use -bcmax and -bcquick at same time\n\n");
-                    PrintUsage();
-                    return 1;
+                    info.format = MakeTypelessFLOAT(info.format);
                 }
-                dwCompress |= TEX_COMPRESS_BC7_QUICK;
-                break;
-
-            case OPT_COMPRESS_DITHER:
-                dwCompress |= TEX_COMPRESS_DITHER;
-                break;
 
-            case OPT_WIC_QUALITY:
-                if (swscanf_s(pValue, L"%f", &wicQuality) != 1
-                    || (wicQuality < 0.f)
-                    || (wicQuality > 1.f))
+                if (IsTypeless(info.format))
                 {
-                    wprintf(L"Invalid value specified with -wicq (%ls)\n", pValue);
-                    printf("\n");
-                    PrintUsage();
-                    return 1;
+                    Print(log, L" FAILED due to Typeless format %d\n", info.format);
+                    return STAGE_SKIP;
                 }
-                break;
 
-            case OPT_COLORKEY:
-                if (swscanf_s(pValue, L"%x", &colorKey) != 1)
+                image->OverrideFormat(info.format);
+            }
+        }
+        else if (_wcsicmp(ext, L".bmp") == 0)
+        {
+            std::unique_ptr<uint8_t []> bmpData;
+            size_t bmpSize;
+            hr = ReadData(pConv->szSrc, bmpData, bmpSize);
+            if (SUCCEEDED(hr))
+            {
+                hr = LoadFromWICMemory(bmpData.get(), bmpSize, opts.dwFilter, &info, *image);
+                if (FAILED(hr))
                 {
-                    printf("Invalid value specified with -c (%ls)\n", pValue);
-                    printf("\n");
-                    PrintUsage();
-                    return 1;
-                }
-                colorKey &= 0xFFFFFF;
-                break;
-
-            case OPT_X2_BIAS:
-                dwConvert |= TEX_FILTER_FLOAT_X2BIAS;
-                break;
-
-            case OPT_FILELIST:
-                {
-                    std::wifstream inFile(pValue);
-                    if (!inFile)
-                    {
-                        wprintf(L"Error opening -flist file %ls\n", pValue);
-                        return 1;
-                    }
-                    wchar_t fname[1024] = {};
-                    for (;;)
-                    {
-                        inFile >> fname;
-                        if (!inFile)
-                            break;
-
-                        if (*fname == L'#')
-                        {
-                            // Comment
-                        }
-                        else if (*fname == L'-')
-                        {
-                            wprintf(L"Command-line arguments not supported in -flist file\n");
-                            return 1;
-                        }
-                        else if (wcspbrk(fname, L"?*") != nullptr)
-                        {
-                            wprintf(L"Wildcards not supported in -flist file\n");
-                            return 1;
-                        }
-                        else
-                        {
-                            SConversion conv;
-                            wcscpy_s(conv.szSrc, MAX_PATH, fname);
-                            conversion.push_back(conv);
-                        }
-
-                        inFile.ignore(1000, '\n');
-                    }
-                    inFile.close();
-                }
-                break;
-
-            case OPT_PAPER_WHITE_NITS:
-                if (swscanf_s(pValue, L"%f", &paperWhiteNits) != 1)
-                {
-                    wprintf(L"Invalid value specified with -nits (%ls)\n", pValue);
-                    wprintf(L"\n");
-                    PrintUsage();
-                    return 1;
-                }
-                else if (paperWhiteNits > 10000.f || paperWhiteNits <= 0.f)
-                {
-                    wprintf(L"-nits (%ls) parameter must be between 0 and 10000\n", pValue);
-                    wprintf(L"\n");
-                    return 1;
-                }
-                break;
-            }
-        }
-        else if (wcspbrk(pArg, L"?*") != nullptr)
-        {
-            size_t count = conversion.size();
-            SearchForFiles(pArg, conversion, (dwOptions & (DWORD64(1) << OPT_RECURSIVE)) != 0);
-            if (conversion.size() <= count)
-            {
-                wprintf(L"No matching files found for %ls\n", pArg);
-                return 1;
-            }
-        }
-        else
-        {
-            SConversion conv;
-            wcscpy_s(conv.szSrc, MAX_PATH, pArg);
-
-            conv.szDest[0] = 0;
-
-            conversion.push_back(conv);
-        }
-    }
-
-    if (conversion.empty())
-    {
-        PrintUsage();
-        return 0;
-    }
-
-    if (~dwOptions & (DWORD64(1) << OPT_NOLOGO))
-        PrintLogo();
-
-    // Work out out filename prefix and suffix
-    if (szOutputDir[0] && (L'\\' != szOutputDir[wcslen(szOutputDir) - 1]))
-        wcscat_s(szOutputDir, MAX_PATH, L"\\");
-
-    if (szPrefix[0])
-        wcscat_s(szOutputDir, MAX_PATH, szPrefix);
-
-    wcscpy_s(szPrefix, MAX_PATH, szOutputDir);
-
-    const wchar_t* fileTypeName = LookupByValue(FileType, g_pSaveFileTypes);
-
-    if (fileTypeName)
-    {
-        wcscat_s(szSuffix, MAX_PATH, L".");
-        wcscat_s(szSuffix, MAX_PATH, fileTypeName);
-    }
-    else
-    {
-        wcscat_s(szSuffix, MAX_PATH, L".unknown");
-    }
-
-    if (FileType != CODEC_DDS)
-    {
-        mipLevels = 1;
-    }
-
-    LARGE_INTEGER qpcFreq;
-    if (!QueryPerformanceFrequency(&qpcFreq))
-    {
-        qpcFreq.QuadPart = 0;
-    }
-
-
-    LARGE_INTEGER qpcStart;
-    if (!QueryPerformanceCounter(&qpcStart))
-    {
-        qpcStart.QuadPart = 0;
-    }
-
-    // Convert images
-    bool nonpow2warn = false;
-    bool non4bc = false;
-    ComPtr<ID3D11Device> pDevice;
-
-    for (auto pConv = conversion.begin(); pConv != conversion.end(); ++pConv)
-    {
-        if (pConv != conversion.begin())
-            wprintf(L"\n");
-
-        // Load source image
-        wprintf(L"reading %ls", pConv->szSrc);
-        fflush(stdout);
-
-        wchar_t ext[_MAX_EXT];
-        wchar_t fname[_MAX_FNAME];
-        _wsplitpath_s(pConv->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT);
-
-        TexMetadata info;
-        std::unique_ptr<ScratchImage> image(new (std::nothrow) ScratchImage);
-
-        if (!image)
-        {
-            wprintf(L"\nERROR: Memory allocation failed\n");
-            return 1;
-        }
-
-        if (_wcsicmp(ext, L".dds") == 0)
-        {
-            DWORD ddsFlags = DDS_FLAGS_NONE;
-            if (dwOptions & (DWORD64(1) << OPT_DDS_DWORD_ALIGN))
-                ddsFlags |= DDS_FLAGS_LEGACY_DWORD;
-            if (dwOptions & (DWORD64(1) << OPT_EXPAND_LUMINANCE))
-                ddsFlags |= DDS_FLAGS_EXPAND_LUMINANCE;
-            if (dwOptions & (DWORD64(1) << OPT_DDS_BAD_DXTN_TAILS))
-                ddsFlags |= DDS_FLAGS_BAD_DXTN_TAILS;
-
-            hr = LoadFromDDSFile(pConv->szSrc, ddsFlags, &info, *image);
-            if (FAILED(hr))
-            {
-                wprintf(L" FAILED (%x)\n", hr);
-                continue;
-            }
-
-            if (IsTypeless(info.format))
-            {
-                if (dwOptions & (DWORD64(1) << OPT_TYPELESS_UNORM))
-                {
-                    info.format = MakeTypelessUNORM(info.format);
-                }
-                else if (dwOptions & (DWORD64(1) << OPT_TYPELESS_FLOAT))
-                {
-                    info.format = MakeTypelessFLOAT(info.format);
-                }
-
-                if (IsTypeless(info.format))
-                {
-                    wprintf(L" FAILED due to Typeless format %d\n", info.format);
-                    continue;
-                }
-
-                image->OverrideFormat(info.format);
-            }
-        }
-        else if (_wcsicmp(ext, L".bmp") == 0)
-        {
-            std::unique_ptr<uint8_t []> bmpData;
-            size_t bmpSize;
-            hr = ReadData(pConv->szSrc, bmpData, bmpSize);
-            if (SUCCEEDED(hr))
-            {
-                hr = LoadFromWICMemory(bmpData.get(), bmpSize, dwFilter, &info, *image);
-                if (FAILED(hr))
-                {
-                    if (SUCCEEDED(LoadFromExtendedBMPMemory(bmpData.get(), bmpSize, &info, *image)))
-                    {
-                        hr = S_OK;
-                    }
+                    if (SUCCEEDED(LoadFromExtendedBMPMemory(bmpData.get(), bmpSize, &info, *image)))
+                    {
+                        hr = S_OK;
+                    }
                 }
             }
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", hr);
-                continue;
+                Print(log, L" FAILED (%x)\n", hr);
+                return STAGE_SKIP;
             }
         }
         else if (_wcsicmp(ext, L".tga") == 0)
@@ -1740,8 +1568,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = LoadFromTGAFile(pConv->szSrc, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", hr);
-                continue;
+                Print(log, L" FAILED (%x)\n", hr);
+                return STAGE_SKIP;
             }
         }
         else if (_wcsicmp(ext, L".hdr") == 0)
@@ -1749,8 +1577,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = LoadFromHDRFile(pConv->szSrc, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", hr);
-                continue;
+                Print(log, L" FAILED (%x)\n", hr);
+                return STAGE_SKIP;
             }
         }
 #ifdef USE_OPENEXR
@@ -1759,8 +1587,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = LoadFromEXRFile(pConv->szSrc, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", hr);
-                continue;
+                Print(log, L" FAILED (%x)\n", hr);
+                return STAGE_SKIP;
             }
         }
 #endif
@@ -1774,54 +1602,74 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             static_assert(WIC_FLAGS_FILTER_CUBIC == TEX_FILTER_CUBIC, "WIC_FLAGS_* & TEX_FILTER_* should match");
             static_assert(WIC_FLAGS_FILTER_FANT == TEX_FILTER_FANT, "WIC_FLAGS_* & TEX_FILTER_* should match");
 
-            DWORD wicFlags = dwFilter;
-            if (FileType == CODEC_DDS)
+            DWORD wicFlags = opts.dwFilter;
+            if (opts.FileType == CODEC_DDS)
                 wicFlags |= WIC_FLAGS_ALL_FRAMES;
 
             hr = LoadFromWICFile(pConv->szSrc, wicFlags, &info, *image);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED (%x)\n", hr);
-                continue;
+                Print(log, L" FAILED (%x)\n", hr);
+                return STAGE_SKIP;
             }
         }
 
-        PrintInfo(info);
+        PrintInfo(info, log);
 
-        size_t tMips = (!mipLevels && info.mipLevels > 1) ? info.mipLevels : mipLevels;
+        tMips = (!opts.mipLevels && info.mipLevels > 1) ? info.mipLevels : opts.mipLevels;
 
         bool sizewarn = false;
 
-        size_t twidth = (!width) ? info.width : width;
-        if (twidth > maxSize)
+        twidth = (!opts.width) ? info.width : opts.width;
+        if (twidth > opts.maxSize)
         {
-            if (!width)
-                twidth = maxSize;
+            if (!opts.width)
+                twidth = opts.maxSize;
             else
                 sizewarn = true;
         }
 
-        size_t theight = (!height) ? info.height : height;
-        if (theight > maxSize)
+        theight = (!opts.height) ? info.height : opts.height;
+        if (theight > opts.maxSize)
         {
-            if (!height)
-                theight = maxSize;
+            if (!opts.height)
+                theight = opts.maxSize;
             else
                 sizewarn = true;
         }
 
         if (sizewarn)
         {
-            wprintf(L"\nWARNING: Target size exceeds maximum size for feature level (%u)\n", maxSize);
+            Print(log, L"\nWARNING: Target size exceeds maximum size for feature level (%u)\n", opts.maxSize);
         }
 
-        if (dwOptions & (DWORD64(1) << OPT_FIT_POWEROF2))
+        if (opts.dwOptions & (DWORD64(1) << OPT_FIT_POWEROF2))
         {
-            FitPowerOf2(info.width, info.height, twidth, theight, maxSize);
+            FitPowerOf2(info.width, info.height, twidth, theight, opts.maxSize);
         }
 
-        // Convert texture
-        wprintf(L" as");
+        return STAGE_OK;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Planar, decompress, alpha, flip, resize, color, tonemap, and format conversions
+    //--------------------------------------------------------------------------------------
+    STAGE_RESULT ProcessStage(SConversionJob& job, const SConvertOptions& opts, SSharedState& shared)
+    {
+        TexMetadata& info = job.info;
+        auto& image = job.image;
+        auto& cimage = job.cimage;
+        DXGI_FORMAT& tformat = job.tformat;
+        const size_t twidth = job.twidth;
+        const size_t theight = job.theight;
+        std::wstring* log = job.log;
+
+        UNREFERENCED_PARAMETER(shared);
+
+        HRESULT hr;
+
+        Print(log, L" as");
         fflush(stdout);
 
         // --- Planar ------------------------------------------------------------------
@@ -1834,15 +1682,15 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
+                Print(log, L"\nERROR: Memory allocation failed\n");
+                return STAGE_ABORT;
             }
 
             hr = ConvertToSinglePlane(img, nimg, info, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [converttosingleplane] (%x)\n", hr);
-                continue;
+                Print(log, L" FAILED [converttosingleplane] (%x)\n", hr);
+                return STAGE_SKIP;
             }
 
             auto& tinfo = timage->GetMetadata();
@@ -1860,10 +1708,9 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             image.swap(timage);
         }
 
-        DXGI_FORMAT tformat = (format == DXGI_FORMAT_UNKNOWN) ? info.format : format;
+        tformat = (opts.format == DXGI_FORMAT_UNKNOWN) ? info.format : opts.format;
 
         // --- Decompress --------------------------------------------------------------
-        std::unique_ptr<ScratchImage> cimage;
         if (IsCompressed(info.format))
         {
             auto img = image->GetImage(0, 0, 0);
@@ -1873,15 +1720,15 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
+                Print(log, L"\nERROR: Memory allocation failed\n");
+                return STAGE_ABORT;
             }
 
             hr = Decompress(img, nimg, info, DXGI_FORMAT_UNKNOWN /* picks good default */, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [decompress] (%x)\n", hr);
-                continue;
+                Print(log, L" FAILED [decompress] (%x)\n", hr);
+                return STAGE_SKIP;
             }
 
             auto& tinfo = timage->GetMetadata();
@@ -1896,7 +1743,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             assert(info.miscFlags == tinfo.miscFlags);
             assert(info.dimension == tinfo.dimension);
 
-            if (FileType == CODEC_DDS)
+            if (opts.FileType == CODEC_DDS)
             {
                 // Keep the original compressed image in case we can reuse it
                 cimage.reset(image.release());
@@ -1909,17 +1756,17 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Undo Premultiplied Alpha (if requested) ---------------------------------
-        if ((dwOptions & (DWORD64(1) << OPT_DEMUL_ALPHA))
+        if ((opts.dwOptions & (DWORD64(1) << OPT_DEMUL_ALPHA))
             && HasAlpha(info.format)
             && info.format != DXGI_FORMAT_A8_UNORM)
         {
             if (info.GetAlphaMode() == TEX_ALPHA_MODE_STRAIGHT)
             {
-                printf("\nWARNING: Image is already using straight alpha\n");
+                Print(log, L"\nWARNING: Image is already using straight alpha\n");
             }
             else if (!info.IsPMAlpha())
             {
-                printf("\nWARNING: Image is not using premultipled alpha\n");
+                Print(log, L"\nWARNING: Image is not using premultipled alpha\n");
             }
             else
             {
@@ -1930,15 +1777,15 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
                 if (!timage)
                 {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
-                    return 1;
+                    Print(log, L"\nERROR: Memory allocation failed\n");
+                    return STAGE_ABORT;
                 }
 
-                hr = PremultiplyAlpha(img, nimg, info, TEX_PMALPHA_REVERSE | dwSRGB, *timage);
+                hr = PremultiplyAlpha(img, nimg, info, TEX_PMALPHA_REVERSE | opts.dwSRGB, *timage);
                 if (FAILED(hr))
                 {
-                    wprintf(L" FAILED [demultiply alpha] (%x)\n", hr);
-                    continue;
+                    Print(log, L" FAILED [demultiply alpha] (%x)\n", hr);
+                    return STAGE_SKIP;
                 }
 
                 auto& tinfo = timage->GetMetadata();
@@ -1958,21 +1805,21 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Flip/Rotate -------------------------------------------------------------
-        if (dwOptions & ((DWORD64(1) << OPT_HFLIP) | (DWORD64(1) << OPT_VFLIP)))
+        if (opts.dwOptions & ((DWORD64(1) << OPT_HFLIP) | (DWORD64(1) << OPT_VFLIP)))
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
+                Print(log, L"\nERROR: Memory allocation failed\n");
+                return STAGE_ABORT;
             }
 
             DWORD dwFlags = 0;
 
-            if (dwOptions & (DWORD64(1) << OPT_HFLIP))
+            if (opts.dwOptions & (DWORD64(1) << OPT_HFLIP))
                 dwFlags |= TEX_FR_FLIP_HORIZONTAL;
 
-            if (dwOptions & (DWORD64(1) << OPT_VFLIP))
+            if (opts.dwOptions & (DWORD64(1) << OPT_VFLIP))
                 dwFlags |= TEX_FR_FLIP_VERTICAL;
 
             assert(dwFlags != 0);
@@ -1980,8 +1827,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = FlipRotate(image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFlags, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [fliprotate] (%x)\n", hr);
-                return 1;
+                Print(log, L" FAILED [fliprotate] (%x)\n", hr);
+                return STAGE_ABORT;
             }
 
             auto& tinfo = timage->GetMetadata();
@@ -2008,15 +1855,15 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
+                Print(log, L"\nERROR: Memory allocation failed\n");
+                return STAGE_ABORT;
             }
 
-            hr = Resize(image->GetImages(), image->GetImageCount(), image->GetMetadata(), twidth, theight, dwFilter | dwFilterOpts, *timage);
+            hr = Resize(image->GetImages(), image->GetImageCount(), image->GetMetadata(), twidth, theight, opts.dwFilter | opts.dwFilterOpts, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [resize] (%x)\n", hr);
-                return 1;
+                Print(log, L" FAILED [resize] (%x)\n", hr);
+                return STAGE_ABORT;
             }
 
             auto& tinfo = timage->GetMetadata();
@@ -2037,23 +1884,23 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Color rotation (if requested) -------------------------------------------
-        if (dwRotateColor)
+        if (opts.dwRotateColor)
         {
-            if (dwRotateColor == ROTATE_HDR10_TO_709)
+            if (opts.dwRotateColor == ROTATE_HDR10_TO_709)
             {
                 std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
                 if (!timage)
                 {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
-                    return 1;
+                    Print(log, L"\nERROR: Memory allocation failed\n");
+                    return STAGE_ABORT;
                 }
 
                 hr = Convert(image->GetImages(), image->GetImageCount(), image->GetMetadata(), DXGI_FORMAT_R16G16B16A16_FLOAT,
-                             dwFilter | dwFilterOpts | dwSRGB | dwConvert, TEX_THRESHOLD_DEFAULT, *timage);
+                             opts.dwFilter | opts.dwFilterOpts | opts.dwSRGB | opts.dwConvert, TEX_THRESHOLD_DEFAULT, *timage);
                 if (FAILED(hr))
                 {
-                    wprintf(L" FAILED [convert] (%x)\n", hr);
-                    return 1;
+                    Print(log, L" FAILED [convert] (%x)\n", hr);
+                    return STAGE_ABORT;
                 }
 
                 auto& tinfo = timage->GetMetadata();
@@ -2077,11 +1924,11 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
+                Print(log, L"\nERROR: Memory allocation failed\n");
+                return STAGE_ABORT;
             }
 
-            switch (dwRotateColor)
+            switch (opts.dwRotateColor)
             {
             case ROTATE_709_TO_HDR10:
                 hr = TransformImage(image->GetImages(), image->GetImageCount(), image->GetMetadata(),
@@ -2089,7 +1936,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 {
                     UNREFERENCED_PARAMETER(y);
 
-                    XMVECTOR paperWhite = XMVectorReplicate(paperWhiteNits);
+                    XMVECTOR paperWhite = XMVectorReplicate(opts.paperWhiteNits);
 
                     for (size_t j = 0; j < width; ++j)
                     {
@@ -2141,7 +1988,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 {
                     UNREFERENCED_PARAMETER(y);
 
-                    XMVECTOR paperWhite = XMVectorReplicate(paperWhiteNits);
+                    XMVECTOR paperWhite = XMVectorReplicate(opts.paperWhiteNits);
 
                     for (size_t j = 0; j < width; ++j)
                     {
@@ -2193,7 +2040,7 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 {
                     UNREFERENCED_PARAMETER(y);
 
-                    XMVECTOR paperWhite = XMVectorReplicate(paperWhiteNits);
+                    XMVECTOR paperWhite = XMVectorReplicate(opts.paperWhiteNits);
 
                     for (size_t j = 0; j < width; ++j)
                     {
@@ -2245,8 +2092,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             }
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [rotate color apply] (%x)\n", hr);
-                return 1;
+                Print(log, L" FAILED [rotate color apply] (%x)\n", hr);
+                return STAGE_ABORT;
             }
 
             auto& tinfo = timage->GetMetadata();
@@ -2266,13 +2113,13 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Tonemap (if requested) --------------------------------------------------
-        if (dwOptions & DWORD64(1) << OPT_TONEMAP)
+        if (opts.dwOptions & DWORD64(1) << OPT_TONEMAP)
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
+                Print(log, L"\nERROR: Memory allocation failed\n");
+                return STAGE_ABORT;
             }
 
             // Compute max luminosity across all images
@@ -2295,8 +2142,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             });
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [tonemap maxlum] (%x)\n", hr);
-                return 1;
+                Print(log, L" FAILED [tonemap maxlum] (%x)\n", hr);
+                return STAGE_ABORT;
             }
 
             // Reinhard et al, "Photographic Tone Reproduction for Digital Images" 
@@ -2324,8 +2171,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             }, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [tonemap apply] (%x)\n", hr);
-                return 1;
+                Print(log, L" FAILED [tonemap apply] (%x)\n", hr);
+                return STAGE_ABORT;
             }
 
             auto& tinfo = timage->GetMetadata();
@@ -2345,26 +2192,26 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- Convert -----------------------------------------------------------------
-        if (dwOptions & (DWORD64(1) << OPT_NORMAL_MAP))
+        if (opts.dwOptions & (DWORD64(1) << OPT_NORMAL_MAP))
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
+                Print(log, L"\nERROR: Memory allocation failed\n");
+                return STAGE_ABORT;
             }
 
             DXGI_FORMAT nmfmt = tformat;
             if (IsCompressed(tformat))
             {
-                nmfmt = (dwNormalMap & CNMAP_COMPUTE_OCCLUSION) ? DXGI_FORMAT_R32G32B32A32_FLOAT : DXGI_FORMAT_R32G32B32_FLOAT;
+                nmfmt = (opts.dwNormalMap & CNMAP_COMPUTE_OCCLUSION) ? DXGI_FORMAT_R32G32B32A32_FLOAT : DXGI_FORMAT_R32G32B32_FLOAT;
             }
 
-            hr = ComputeNormalMap(image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwNormalMap, nmapAmplitude, nmfmt, *timage);
+            hr = ComputeNormalMap(image->GetImages(), image->GetImageCount(), image->GetMetadata(), opts.dwNormalMap, opts.nmapAmplitude, nmfmt, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [normalmap] (%x)\n", hr);
-                return 1;
+                Print(log, L" FAILED [normalmap] (%x)\n", hr);
+                return STAGE_ABORT;
             }
 
             auto& tinfo = timage->GetMetadata();
@@ -2388,16 +2235,16 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
+                Print(log, L"\nERROR: Memory allocation failed\n");
+                return STAGE_ABORT;
             }
 
             hr = Convert(image->GetImages(), image->GetImageCount(), image->GetMetadata(), tformat,
-                dwFilter | dwFilterOpts | dwSRGB | dwConvert, TEX_THRESHOLD_DEFAULT, *timage);
+                opts.dwFilter | opts.dwFilterOpts | opts.dwSRGB | opts.dwConvert, TEX_THRESHOLD_DEFAULT, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [convert] (%x)\n", hr);
-                return 1;
+                Print(log, L" FAILED [convert] (%x)\n", hr);
+                return STAGE_ABORT;
             }
 
             auto& tinfo = timage->GetMetadata();
@@ -2418,17 +2265,17 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         }
 
         // --- ColorKey/ChromaKey ------------------------------------------------------
-        if ((dwOptions & (DWORD64(1) << OPT_COLORKEY))
+        if ((opts.dwOptions & (DWORD64(1) << OPT_COLORKEY))
             && HasAlpha(info.format))
         {
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
+                Print(log, L"\nERROR: Memory allocation failed\n");
+                return STAGE_ABORT;
             }
 
-            XMVECTOR colorKeyValue = XMLoadColor(reinterpret_cast<const XMCOLOR*>(&colorKey));
+            XMVECTOR colorKeyValue = XMLoadColor(reinterpret_cast<const XMCOLOR*>(&opts.colorKey));
 
             hr = TransformImage(image->GetImages(), image->GetImageCount(), image->GetMetadata(),
                 [&](XMVECTOR* outPixels, const XMVECTOR* inPixels, size_t width, size_t y)
@@ -2455,8 +2302,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             }, *timage);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [colorkey] (%x)\n", hr);
-                return 1;
+                Print(log, L" FAILED [colorkey] (%x)\n", hr);
+                return STAGE_ABORT;
             }
 
             auto& tinfo = timage->GetMetadata();
@@ -2475,13 +2322,30 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             cimage.reset();
         }
 
+        return STAGE_OK;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Mipmap generation
+    //--------------------------------------------------------------------------------------
+    STAGE_RESULT MipsStage(SConversionJob& job, const SConvertOptions& opts, SSharedState& shared)
+    {
+        TexMetadata& info = job.info;
+        auto& image = job.image;
+        auto& cimage = job.cimage;
+        const size_t tMips = job.tMips;
+        std::wstring* log = job.log;
+
+        HRESULT hr;
+
         // --- Generate mips -----------------------------------------------------------
-        DWORD dwFilter3D = dwFilter;
+        DWORD dwFilter3D = opts.dwFilter;
         if (!ispow2(info.width) || !ispow2(info.height) || !ispow2(info.depth))
         {
             if (!tMips || info.mipLevels != 1)
             {
-                nonpow2warn = true;
+                shared.nonpow2warn = true;
             }
 
             if (info.dimension == TEX_DIMENSION_TEXTURE3D)
@@ -2497,8 +2361,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
             if (!timage)
             {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
+                Print(log, L"\nERROR: Memory allocation failed\n");
+                return STAGE_ABORT;
             }
 
             TexMetadata mdata = info;
@@ -2506,8 +2370,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             hr = timage->Initialize(mdata);
             if (FAILED(hr))
             {
-                wprintf(L" FAILED [copy to single level] (%x)\n", hr);
-                return 1;
+                Print(log, L" FAILED [copy to single level] (%x)\n", hr);
+                return STAGE_ABORT;
             }
 
             if (info.dimension == TEX_DIMENSION_TEXTURE3D)
@@ -2518,8 +2382,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                         *timage->GetImage(0, 0, d), TEX_FILTER_DEFAULT, 0, 0);
                     if (FAILED(hr))
                     {
-                        wprintf(L" FAILED [copy to single level] (%x)\n", hr);
-                        return 1;
+                        Print(log, L" FAILED [copy to single level] (%x)\n", hr);
+                        return STAGE_ABORT;
                     }
                 }
             }
@@ -2531,8 +2395,8 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                         *timage->GetImage(0, i, 0), TEX_FILTER_DEFAULT, 0, 0);
                     if (FAILED(hr))
                     {
-                        wprintf(L" FAILED [copy to single level] (%x)\n", hr);
-                        return 1;
+                        Print(log, L" FAILED [copy to single level] (%x)\n", hr);
+                        return STAGE_ABORT;
                     }
                 }
             }
@@ -2548,414 +2412,1319 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                 hr = timage->Initialize(mdata);
                 if (FAILED(hr))
                 {
-                    wprintf(L" FAILED [copy compressed to single level] (%x)\n", hr);
+                    Print(log, L" FAILED [copy compressed to single level] (%x)\n", hr);
+                    return STAGE_ABORT;
+                }
+
+                if (mdata.dimension == TEX_DIMENSION_TEXTURE3D)
+                {
+                    for (size_t d = 0; d < mdata.depth; ++d)
+                    {
+                        auto simg = cimage->GetImage(0, 0, d);
+                        auto dimg = timage->GetImage(0, 0, d);
+
+                        memcpy_s(dimg->pixels, dimg->slicePitch, simg->pixels, simg->slicePitch);
+                    }
+                }
+                else
+                {
+                    for (size_t i = 0; i < mdata.arraySize; ++i)
+                    {
+                        auto simg = cimage->GetImage(0, i, 0);
+                        auto dimg = timage->GetImage(0, i, 0);
+
+                        memcpy_s(dimg->pixels, dimg->slicePitch, simg->pixels, simg->slicePitch);
+                    }
+                }
+
+                cimage.swap(timage);
+            }
+            else
+            {
+                cimage.reset();
+            }
+        }
+
+        if ((!tMips || info.mipLevels != tMips) && (info.width > 1 || info.height > 1 || info.depth > 1))
+        {
+            std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+            if (!timage)
+            {
+                Print(log, L"\nERROR: Memory allocation failed\n");
+                return STAGE_ABORT;
+            }
+
+            if (info.dimension == TEX_DIMENSION_TEXTURE3D)
+            {
+                hr = GenerateMipMaps3D(image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFilter3D | opts.dwFilterOpts, tMips, *timage);
+            }
+            else if (opts.dwOptions & (DWORD64(1) << OPT_NORMAL_MAP))
+            {
+                // Color filtering shortens normals, so renormalize each level instead
+                hr = GenerateNormalMapMipMaps(image->GetImages(), image->GetImageCount(), image->GetMetadata(), NMAP_MIPS_DEFAULT, tMips, *timage);
+            }
+            else
+            {
+                hr = GenerateMipMaps(image->GetImages(), image->GetImageCount(), image->GetMetadata(), opts.dwFilter | opts.dwFilterOpts, tMips, *timage);
+            }
+            if (FAILED(hr))
+            {
+                Print(log, L" FAILED [mipmaps] (%x)\n", hr);
+                return STAGE_ABORT;
+            }
+
+            auto& tinfo = timage->GetMetadata();
+            info.mipLevels = tinfo.mipLevels;
+
+            assert(info.width == tinfo.width);
+            assert(info.height == tinfo.height);
+            assert(info.depth == tinfo.depth);
+            assert(info.arraySize == tinfo.arraySize);
+            assert(info.miscFlags == tinfo.miscFlags);
+            assert(info.format == tinfo.format);
+            assert(info.dimension == tinfo.dimension);
+
+            image.swap(timage);
+            cimage.reset();
+        }
+
+        // --- Specular anti-aliasing ------------------------------------------------------
+        if (opts.pSpecularAANormals)
+        {
+            if (info.dimension == TEX_DIMENSION_TEXTURE3D)
+            {
+                Print(log, L"\nWARNING: -specaa does not support volume textures\n");
+            }
+            else
+            {
+                std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+                if (!timage)
+                {
+                    Print(log, L"\nERROR: Memory allocation failed\n");
+                    return STAGE_ABORT;
+                }
+
+                const ScratchImage& normals = *opts.pSpecularAANormals;
+                hr = ComputeSpecularAA(image->GetImages(), image->GetImageCount(), image->GetMetadata(),
+                    normals.GetImages(), normals.GetImageCount(), normals.GetMetadata(),
+                    SPECAA_DEFAULT, c_SpecularAAMaxVariance, *timage);
+                if (FAILED(hr))
+                {
+                    Print(log, L" FAILED [specular AA] (%x)\n", hr);
+                    return STAGE_SKIP;
+                }
+
+                image.swap(timage);
+                cimage.reset();
+            }
+        }
+
+        return STAGE_OK;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Premultiplied alpha and block compression
+    //--------------------------------------------------------------------------------------
+    STAGE_RESULT CompressStage(SConversionJob& job, const SConvertOptions& opts, SSharedState& shared)
+    {
+        TexMetadata& info = job.info;
+        auto& image = job.image;
+        auto& cimage = job.cimage;
+        const DXGI_FORMAT tformat = job.tformat;
+        std::wstring* log = job.log;
+
+        HRESULT hr;
+
+        // --- Premultiplied alpha (if requested) --------------------------------------
+        if ((opts.dwOptions & (DWORD64(1) << OPT_PREMUL_ALPHA))
+            && HasAlpha(info.format)
+            && info.format != DXGI_FORMAT_A8_UNORM)
+        {
+            if (info.IsPMAlpha())
+            {
+                Print(log, L"\nWARNING: Image is already using premultiplied alpha\n");
+            }
+            else
+            {
+                auto img = image->GetImage(0, 0, 0);
+                assert(img);
+                size_t nimg = image->GetImageCount();
+
+                std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+                if (!timage)
+                {
+                    Print(log, L"\nERROR: Memory allocation failed\n");
+                    return STAGE_ABORT;
+                }
+
+                hr = PremultiplyAlpha(img, nimg, info, opts.dwSRGB, *timage);
+                if (FAILED(hr))
+                {
+                    Print(log, L" FAILED [premultiply alpha] (%x)\n", hr);
+                    return STAGE_SKIP;
+                }
+
+                auto& tinfo = timage->GetMetadata();
+                info.miscFlags2 = tinfo.miscFlags2;
+
+                assert(info.width == tinfo.width);
+                assert(info.height == tinfo.height);
+                assert(info.depth == tinfo.depth);
+                assert(info.arraySize == tinfo.arraySize);
+                assert(info.mipLevels == tinfo.mipLevels);
+                assert(info.miscFlags == tinfo.miscFlags);
+                assert(info.dimension == tinfo.dimension);
+
+                image.swap(timage);
+                cimage.reset();
+            }
+        }
+
+        // --- Compress ----------------------------------------------------------------
+        if (IsCompressed(tformat) && (opts.FileType == CODEC_DDS))
+        {
+            if (cimage && (cimage->GetMetadata().format == tformat))
+            {
+                // We never changed the image and it was already compressed in our desired format, use original data
+                image.reset(cimage.release());
+
+                auto& tinfo = image->GetMetadata();
+
+                if ((tinfo.width % 4) != 0 || (tinfo.height % 4) != 0)
+                {
+                    shared.non4bc = true;
+                }
+
+                info.format = tinfo.format;
+                assert(info.width == tinfo.width);
+                assert(info.height == tinfo.height);
+                assert(info.depth == tinfo.depth);
+                assert(info.arraySize == tinfo.arraySize);
+                assert(info.mipLevels == tinfo.mipLevels);
+                assert(info.miscFlags == tinfo.miscFlags);
+                assert(info.dimension == tinfo.dimension);
+            }
+            else
+            {
+                cimage.reset();
+
+                auto img = image->GetImage(0, 0, 0);
+                assert(img);
+                size_t nimg = image->GetImageCount();
+
+                std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+                if (!timage)
+                {
+                    Print(log, L"\nERROR: Memory allocation failed\n");
+                    return STAGE_ABORT;
+                }
+
+                bool bc6hbc7 = false;
+                switch (tformat)
+                {
+                case DXGI_FORMAT_BC6H_TYPELESS:
+                case DXGI_FORMAT_BC6H_UF16:
+                case DXGI_FORMAT_BC6H_SF16:
+                case DXGI_FORMAT_BC7_TYPELESS:
+                case DXGI_FORMAT_BC7_UNORM:
+                case DXGI_FORMAT_BC7_UNORM_SRGB:
+                    bc6hbc7 = true;
+
+                    {
+                        std::lock_guard<std::mutex> guard(shared.deviceLock);
+
+                        if (!shared.deviceTried)
+                        {
+                            shared.deviceTried = true;
+
+                            if (!(opts.dwOptions & (DWORD64(1) << OPT_NOGPU)))
+                            {
+                                if (!CreateDevice(opts.adapter, shared.pDevice.GetAddressOf()))
+                                    Print(log, L"\nWARNING: DirectCompute is not available, using BC6H / BC7 CPU codec\n");
+                            }
+                            else
+                            {
+                                Print(log, L"\nWARNING: using BC6H / BC7 CPU codec\n");
+                            }
+                        }
+                    }
+                    break;
+                }
+
+                DWORD cflags = opts.dwCompress;
+#ifdef _OPENMP
+                // With -j, files rather than BC blocks are the unit of parallelism
+                if (!(opts.dwOptions & (DWORD64(1) << OPT_FORCE_SINGLEPROC)) && opts.jobs <= 1)
+                {
+                    cflags |= TEX_COMPRESS_PARALLEL;
+                }
+#endif
+
+                if ((img->width % 4) != 0 || (img->height % 4) != 0)
+                {
+                    shared.non4bc = true;
+                }
+
+                if (bc6hbc7 && shared.pDevice)
+                {
+                    // The device immediate context is not free-threaded
+                    std::lock_guard<std::mutex> guard(shared.deviceLock);
+                    hr = Compress(shared.pDevice.Get(), img, nimg, info, tformat, opts.dwCompress | opts.dwSRGB, opts.alphaWeight, *timage);
+                }
+                else
+                {
+                    if (bc6hbc7 && !(opts.dwOptions & (DWORD64(1) << OPT_NOGPU)))
+                    {
+                        // The key promises DirectCompute output, which the CPU codec doesn't match bit for bit
+                        job.cacheMiss = false;
+                    }
+
+                    hr = Compress(img, nimg, info, tformat, cflags | opts.dwSRGB, TEX_THRESHOLD_DEFAULT, *timage);
+                }
+                if (FAILED(hr))
+                {
+                    Print(log, L" FAILED [compress] (%x)\n", hr);
+                    return STAGE_SKIP;
+                }
+
+                auto& tinfo = timage->GetMetadata();
+
+                info.format = tinfo.format;
+                assert(info.width == tinfo.width);
+                assert(info.height == tinfo.height);
+                assert(info.depth == tinfo.depth);
+                assert(info.arraySize == tinfo.arraySize);
+                assert(info.mipLevels == tinfo.mipLevels);
+                assert(info.miscFlags == tinfo.miscFlags);
+                assert(info.dimension == tinfo.dimension);
+
+                image.swap(timage);
+            }
+        }
+        else
+        {
+            cimage.reset();
+        }
+
+        return STAGE_OK;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Writes the result
+    //--------------------------------------------------------------------------------------
+    STAGE_RESULT SaveStage(SConversionJob& job, const SConvertOptions& opts, SSharedState& shared)
+    {
+        SConversion* pConv = job.pConv;
+        TexMetadata& info = job.info;
+        auto& image = job.image;
+        std::wstring* log = job.log;
+
+        UNREFERENCED_PARAMETER(shared);
+
+        HRESULT hr;
+
+        // --- Set alpha mode ----------------------------------------------------------
+        if (HasAlpha(info.format)
+            && info.format != DXGI_FORMAT_A8_UNORM)
+        {
+            if (image->IsAlphaAllOpaque())
+            {
+                info.SetAlphaMode(TEX_ALPHA_MODE_OPAQUE);
+            }
+            else if (info.IsPMAlpha())
+            {
+                // Aleady set TEX_ALPHA_MODE_PREMULTIPLIED
+            }
+            else if (opts.dwOptions & (DWORD64(1) << OPT_SEPALPHA))
+            {
+                info.SetAlphaMode(TEX_ALPHA_MODE_CUSTOM);
+            }
+            else if (info.GetAlphaMode() == TEX_ALPHA_MODE_UNKNOWN)
+            {
+                info.SetAlphaMode(TEX_ALPHA_MODE_STRAIGHT);
+            }
+        }
+        else
+        {
+            info.SetAlphaMode(TEX_ALPHA_MODE_UNKNOWN);
+        }
+
+        // --- Save result -------------------------------------------------------------
+        {
+            auto img = image->GetImage(0, 0, 0);
+            assert(img);
+            size_t nimg = image->GetImageCount();
+
+            PrintInfo(info, log);
+            Print(log, L"\n");
+
+            // Figure out dest filename
+            MakeOutputPath(*pConv, opts);
+
+            // Write texture
+            Print(log, L"writing %ls", pConv->szDest);
+            fflush(stdout);
+
+            if (~opts.dwOptions & (DWORD64(1) << OPT_OVERWRITE))
+            {
+                if (GetFileAttributesW(pConv->szDest) != INVALID_FILE_ATTRIBUTES)
+                {
+                    Print(log, L"\nERROR: Output file already exists, use -y to overwrite:\n");
+                    return STAGE_SKIP;
+                }
+            }
+
+            switch (opts.FileType)
+            {
+            case CODEC_DDS:
+                hr = SaveToDDSFile(img, nimg, info,
+                    (opts.dwOptions & (DWORD64(1) << OPT_USE_DX10)) ? (DDS_FLAGS_FORCE_DX10_EXT | DDS_FLAGS_FORCE_DX10_EXT_MISC2) : DDS_FLAGS_NONE,
+                    pConv->szDest);
+                break;
+
+            case CODEC_TGA:
+                hr = SaveToTGAFile(img[0], pConv->szDest);
+                break;
+
+            case CODEC_HDR:
+                hr = SaveToHDRFile(img[0], pConv->szDest);
+                break;
+
+#ifdef USE_OPENEXR
+            case CODEC_EXR:
+                hr = SaveToEXRFile(img[0], pConv->szDest);
+                break;
+#endif
+
+            default:
+            {
+                WICCodecs codec = (opts.FileType == CODEC_HDP || opts.FileType == CODEC_JXR) ? WIC_CODEC_WMP : static_cast<WICCodecs>(opts.FileType);
+                size_t nimages = (opts.dwOptions & (DWORD64(1) << OPT_WIC_MULTIFRAME)) ? nimg : 1;
+                hr = SaveToWICFile(img, nimages, WIC_FLAGS_NONE, GetWICCodec(codec), pConv->szDest, nullptr,
+                    [&](IPropertyBag2* props)
+                {
+                    bool wicLossless = (opts.dwOptions & (DWORD64(1) << OPT_WIC_LOSSLESS)) != 0;
+
+                    switch (opts.FileType)
+                    {
+                    case WIC_CODEC_JPEG:
+                        if (wicLossless || opts.wicQuality >= 0.f)
+                        {
+                            PROPBAG2 options = {};
+                            VARIANT varValues = {};
+                            options.pstrName = const_cast<wchar_t*>(L"ImageQuality");
+                            varValues.vt = VT_R4;
+                            varValues.fltVal = (wicLossless) ? 1.f : opts.wicQuality;
+                            (void)props->Write(1, &options, &varValues);
+                        }
+                        break;
+
+                    case WIC_CODEC_TIFF:
+                    {
+                        PROPBAG2 options = {};
+                        VARIANT varValues = {};
+                        if (wicLossless)
+                        {
+                            options.pstrName = const_cast<wchar_t*>(L"TiffCompressionMethod");
+                            varValues.vt = VT_UI1;
+                            varValues.bVal = WICTiffCompressionNone;
+                        }
+                        else if (opts.wicQuality >= 0.f)
+                        {
+                            options.pstrName = const_cast<wchar_t*>(L"CompressionQuality");
+                            varValues.vt = VT_R4;
+                            varValues.fltVal = opts.wicQuality;
+                        }
+                        (void)props->Write(1, &options, &varValues);
+                    }
+                    break;
+
+                    case WIC_CODEC_WMP:
+                    case CODEC_HDP:
+                    case CODEC_JXR:
+                    {
+                        PROPBAG2 options = {};
+                        VARIANT varValues = {};
+                        if (wicLossless)
+                        {
+                            options.pstrName = const_cast<wchar_t*>(L"Lossless");
+                            varValues.vt = VT_BOOL;
+                            varValues.bVal = TRUE;
+                        }
+                        else if (opts.wicQuality >= 0.f)
+                        {
+                            options.pstrName = const_cast<wchar_t*>(L"ImageQuality");
+                            varValues.vt = VT_R4;
+                            varValues.fltVal = opts.wicQuality;
+                        }
+                        (void)props->Write(1, &options, &varValues);
+                    }
+                    break;
+                    }
+                });
+            }
+            break;
+            }
+
+            if (FAILED(hr))
+            {
+                Print(log, L" FAILED (%x)\n", hr);
+                return STAGE_SKIP;
+            }
+            Print(log, L"\n");
+
+            if (job.cacheMiss)
+                StoreCache(job, opts);
+        }
+
+        return STAGE_OK;
+    }
+
+
+    STAGE_RESULT RunStage(size_t stage, SConversionJob& job, const SConvertOptions& opts, SSharedState& shared, LONGLONG& ticks)
+    {
+        LARGE_INTEGER qpcStart, qpcEnd;
+        if (!QueryPerformanceCounter(&qpcStart))
+            qpcStart.QuadPart = 0;
+
+        STAGE_RESULT result;
+        switch (stage)
+        {
+        case STAGE_LOAD:        result = LoadStage(job, opts, shared); break;
+        case STAGE_PROCESS:     result = ProcessStage(job, opts, shared); break;
+        case STAGE_MIPS:        result = MipsStage(job, opts, shared); break;
+        case STAGE_COMPRESS:    result = CompressStage(job, opts, shared); break;
+        case STAGE_SAVE:        result = SaveStage(job, opts, shared); break;
+        default:                result = STAGE_ABORT; break;
+        }
+
+        ticks = QueryPerformanceCounter(&qpcEnd) ? (qpcEnd.QuadPart - qpcStart.QuadPart) : 0;
+
+        return result;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Runs files through the stages on 'opts.jobs' worker threads. Files in later stages
+    // are picked first so that finished results release their memory, and no more than two
+    // files per worker are in flight at once. Output for each file is buffered and printed
+    // as a block when that file completes.
+    //--------------------------------------------------------------------------------------
+    bool ConvertFilesParallel(std::list<SConversion>& files, const SConvertOptions& opts, SSharedState& shared)
+    {
+        const size_t maxInFlight = opts.jobs * 2;
+
+        std::mutex lock;
+        std::condition_variable wake;
+        std::deque<std::unique_ptr<SConversionJob>> ready[STAGE_MAX];
+        auto next = files.begin();
+        size_t inFlight = 0;
+        bool aborted = false;
+        bool first = true;
+
+        auto worker = [&]()
+        {
+            HRESULT hrCOM = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+            std::unique_lock<std::mutex> guard(lock);
+            for (;;)
+            {
+                std::unique_ptr<SConversionJob> job;
+                size_t stage = STAGE_LOAD;
+                for (size_t s = STAGE_MAX - 1; s > STAGE_LOAD; --s)
+                {
+                    if (!ready[s].empty())
+                    {
+                        job = std::move(ready[s].front());
+                        ready[s].pop_front();
+                        stage = s;
+                        break;
+                    }
+                }
+
+                if (!job)
+                {
+                    if (!aborted && next != files.end() && inFlight < maxInFlight)
+                    {
+                        job.reset(new (std::nothrow) SConversionJob);
+                        if (!job)
+                        {
+                            wprintf(L"\nERROR: Memory allocation failed\n");
+                            aborted = true;
+                            wake.notify_all();
+                            continue;
+                        }
+
+                        job->pConv = &(*next);
+                        job->log = &job->output;
+                        ++next;
+                        ++inFlight;
+                    }
+                    else if (!inFlight && (aborted || next == files.end()))
+                    {
+                        break;
+                    }
+                    else
+                    {
+                        wake.wait(guard);
+                        continue;
+                    }
+                }
+
+                const bool skip = aborted;
+                guard.unlock();
+
+                LONGLONG ticks = 0;
+                STAGE_RESULT result = (skip) ? STAGE_SKIP : RunStage(stage, *job, opts, shared, ticks);
+
+                guard.lock();
+                shared.stageTime[stage] += ticks;
+
+                if (result == STAGE_OK && (stage + 1) < STAGE_MAX)
+                {
+                    ready[stage + 1].push_back(std::move(job));
+                }
+                else
+                {
+                    if (!first)
+                        wprintf(L"\n");
+                    first = false;
+
+                    wprintf(L"%ls", job->output.c_str());
+                    fflush(stdout);
+
+                    job.reset();
+                    --inFlight;
+
+                    if (result == STAGE_ABORT)
+                        aborted = true;
+                }
+
+                wake.notify_all();
+            }
+            guard.unlock();
+
+            if (SUCCEEDED(hrCOM))
+                CoUninitialize();
+        };
+
+        std::vector<std::thread> workers;
+        try
+        {
+            workers.reserve(opts.jobs);
+            for (size_t j = 0; j < opts.jobs; ++j)
+                workers.emplace_back(worker);
+        }
+        catch (const std::exception&)
+        {
+            if (workers.empty())
+            {
+                wprintf(L"\nERROR: Failed to create worker threads\n");
+                return false;
+            }
+        }
+
+        for (auto& t : workers)
+            t.join();
+
+        // Unless a stage aborted, every file was retired, so a clean run reports success
+        assert(aborted || (next == files.end() && !inFlight));
+
+        return !aborted;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Entry-point
+//--------------------------------------------------------------------------------------
+#pragma prefast(disable : 28198, "Command-line tool, frees all memory on exit")
+
+int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
+{
+    // Parameters and defaults
+    size_t width = 0;
+    size_t height = 0;
+    size_t mipLevels = 0;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+    DWORD dwFilter = TEX_FILTER_DEFAULT;
+    DWORD dwSRGB = 0;
+    DWORD dwConvert = 0;
+    DWORD dwCompress = TEX_COMPRESS_DEFAULT;
+    DWORD dwFilterOpts = 0;
+    DWORD FileType = CODEC_DDS;
+    DWORD maxSize = 16384;
+    int adapter = -1;
+    float alphaWeight = 1.f;
+    DWORD dwNormalMap = 0;
+    float nmapAmplitude = 1.f;
+    float wicQuality = -1.f;
+    DWORD colorKey = 0;
+    DWORD dwRotateColor = 0;
+    float paperWhiteNits = 200.f;
+    size_t jobs = 1;
+
+    wchar_t szPrefix[MAX_PATH];
+    wchar_t szSuffix[MAX_PATH];
+    wchar_t szOutputDir[MAX_PATH];
+    wchar_t szCacheDir[MAX_PATH];
+    wchar_t szSpecularAA[MAX_PATH];
+
+    szPrefix[0] = 0;
+    szSuffix[0] = 0;
+    szOutputDir[0] = 0;
+    szCacheDir[0] = 0;
+    szSpecularAA[0] = 0;
+
+    // Initialize COM (needed for WIC)
+    HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    if (FAILED(hr))
+    {
+        wprintf(L"Failed to initialize COM (%08X)\n", hr);
+        return 1;
+    }
+
+    // Process command line
+    DWORD64 dwOptions = 0;
+    std::list<SConversion> conversion;
+
+    for (int iArg = 1; iArg < argc; iArg++)
+    {
+        PWSTR pArg = argv[iArg];
+
+        if (('-' == pArg[0]) || ('/' == pArg[0]))
+        {
+            pArg++;
+            PWSTR pValue;
+
+            for (pValue = pArg; *pValue && (':' != *pValue); pValue++);
+
+            if (*pValue)
+                *pValue++ = 0;
+
+            DWORD dwOption = LookupByName(pArg, g_pOptions);
+
+            if (!dwOption || (dwOptions & (DWORD64(1) << dwOption)))
+            {
+                PrintUsage();
+                return 1;
+            }
+
+            dwOptions |= (DWORD64(1) << dwOption);
+
+            // Handle options with additional value parameter
+            switch (dwOption)
+            {
+            case OPT_WIDTH:
+            case OPT_HEIGHT:
+            case OPT_MIPLEVELS:
+            case OPT_FORMAT:
+            case OPT_FILTER:
+            case OPT_PREFIX:
+            case OPT_SUFFIX:
+            case OPT_OUTPUTDIR:
+            case OPT_CACHE:
+            case OPT_SPECULAR_AA:
+            case OPT_FILETYPE:
+            case OPT_GPU:
+            case OPT_FEATURE_LEVEL:
+            case OPT_ALPHA_WEIGHT:
+            case OPT_NORMAL_MAP:
+            case OPT_NORMAL_MAP_AMPLITUDE:
+            case OPT_WIC_QUALITY:
+            case OPT_COLORKEY:
+            case OPT_FILELIST:
+            case OPT_ROTATE_COLOR:
+            case OPT_PAPER_WHITE_NITS:
+            case OPT_JOBS:
+                if (!*pValue)
+                {
+                    if ((iArg + 1 >= argc))
+                    {
+                        PrintUsage();
+                        return 1;
+                    }
+
+                    iArg++;
+                    pValue = argv[iArg];
+                }
+                break;
+            }
+
+            switch (dwOption)
+            {
+            case OPT_WIDTH:
+                if (swscanf_s(pValue, L"%zu", &width) != 1)
+                {
+                    wprintf(L"Invalid value specified with -w (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_HEIGHT:
+                if (swscanf_s(pValue, L"%zu", &height) != 1)
+                {
+                    wprintf(L"Invalid value specified with -h (%ls)\n", pValue);
+                    printf("\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_MIPLEVELS:
+                if (swscanf_s(pValue, L"%zu", &mipLevels) != 1)
+                {
+                    wprintf(L"Invalid value specified with -m (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_FORMAT:
+                format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormats));
+                if (!format)
+                {
+                    format = static_cast<DXGI_FORMAT>(LookupByName(pValue, g_pFormatAliases));
+                    if (!format)
+                    {
+                        wprintf(L"Invalid value specified with -f (%ls)\n", pValue);
+                        wprintf(L"\n");
+                        PrintUsage();
+                        return 1;
+                    }
+                }
+                break;
+
+            case OPT_FILTER:
+                dwFilter = LookupByName(pValue, g_pFilters);
+                if (!dwFilter)
+                {
+                    wprintf(L"Invalid value specified with -if (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_ROTATE_COLOR:
+                dwRotateColor = LookupByName(pValue, g_pRotateColor);
+                if (!dwRotateColor)
+                {
+                    wprintf(L"Invalid value specified with -rotatecolor (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_SRGBI:
+                dwSRGB |= TEX_FILTER_SRGB_IN;
+                break;
+
+            case OPT_SRGBO:
+                dwSRGB |= TEX_FILTER_SRGB_OUT;
+                break;
+
+            case OPT_SRGB:
+                dwSRGB |= TEX_FILTER_SRGB;
+                break;
+
+            case OPT_SEPALPHA:
+                dwFilterOpts |= TEX_FILTER_SEPARATE_ALPHA;
+                break;
+
+            case OPT_NO_WIC:
+                dwFilterOpts |= TEX_FILTER_FORCE_NON_WIC;
+                break;
+
+            case OPT_PREFIX:
+                wcscpy_s(szPrefix, MAX_PATH, pValue);
+                break;
+
+            case OPT_SUFFIX:
+                wcscpy_s(szSuffix, MAX_PATH, pValue);
+                break;
+
+            case OPT_OUTPUTDIR:
+                wcscpy_s(szOutputDir, MAX_PATH, pValue);
+                break;
+
+            case OPT_CACHE:
+                wcscpy_s(szCacheDir, MAX_PATH, pValue);
+                break;
+
+            case OPT_SPECULAR_AA:
+                wcscpy_s(szSpecularAA, MAX_PATH, pValue);
+                break;
+
+            case OPT_FILETYPE:
+                FileType = LookupByName(pValue, g_pSaveFileTypes);
+                if (!FileType)
+                {
+                    wprintf(L"Invalid value specified with -ft (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_PREMUL_ALPHA:
+                if (dwOptions & (DWORD64(1) << OPT_DEMUL_ALPHA))
+                {
+                    wprintf(L"Can't use -pmalpha and -alpha at same time\n\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_DEMUL_ALPHA:
+                if (dwOptions & (DWORD64(1) << OPT_PREMUL_ALPHA))
+                {
+                    wprintf(L"Can't use -pmalpha and -alpha at same time\n\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
+
+            case OPT_TA_WRAP:
+                if (dwFilterOpts & TEX_FILTER_MIRROR)
+                {
+                    wprintf(L"Can't use -wrap and -mirror at same time\n\n");
+                    PrintUsage();
+                    return 1;
+                }
+                dwFilterOpts |= TEX_FILTER_WRAP;
+                break;
+
+            case OPT_TA_MIRROR:
+                if (dwFilterOpts & TEX_FILTER_WRAP)
+                {
+                    wprintf(L"Can't use -wrap and -mirror at same time\n\n");
+                    PrintUsage();
+                    return 1;
+                }
+                dwFilterOpts |= TEX_FILTER_MIRROR;
+                break;
+
+            case OPT_NORMAL_MAP:
+            {
+                dwNormalMap = 0;
+
+                if (wcschr(pValue, L'l'))
+                {
+                    dwNormalMap |= CNMAP_CHANNEL_LUMINANCE;
+                }
+                else if (wcschr(pValue, L'r'))
+                {
+                    dwNormalMap |= CNMAP_CHANNEL_RED;
+                }
+                else if (wcschr(pValue, L'g'))
+                {
+                    dwNormalMap |= CNMAP_CHANNEL_GREEN;
+                }
+                else if (wcschr(pValue, L'b'))
+                {
+                    dwNormalMap |= CNMAP_CHANNEL_BLUE;
+                }
+                else if (wcschr(pValue, L'a'))
+                {
+                    dwNormalMap |= CNMAP_CHANNEL_ALPHA;
+                }
+                else
+                {
+                    wprintf(L"Invalid value specified for -nmap (%ls), missing l, r, g, b, or a\n\n", pValue);
+                    PrintUsage();
                     return 1;
                 }
 
-                if (mdata.dimension == TEX_DIMENSION_TEXTURE3D)
+                if (wcschr(pValue, L'm'))
                 {
-                    for (size_t d = 0; d < mdata.depth; ++d)
-                    {
-                        auto simg = cimage->GetImage(0, 0, d);
-                        auto dimg = timage->GetImage(0, 0, d);
-
-                        memcpy_s(dimg->pixels, dimg->slicePitch, simg->pixels, simg->slicePitch);
-                    }
+                    dwNormalMap |= CNMAP_MIRROR;
                 }
                 else
                 {
-                    for (size_t i = 0; i < mdata.arraySize; ++i)
+                    if (wcschr(pValue, L'u'))
                     {
-                        auto simg = cimage->GetImage(0, i, 0);
-                        auto dimg = timage->GetImage(0, i, 0);
-
-                        memcpy_s(dimg->pixels, dimg->slicePitch, simg->pixels, simg->slicePitch);
+                        dwNormalMap |= CNMAP_MIRROR_U;
+                    }
+                    if (wcschr(pValue, L'v'))
+                    {
+                        dwNormalMap |= CNMAP_MIRROR_V;
                     }
                 }
 
-                cimage.swap(timage);
-            }
-            else
-            {
-                cimage.reset();
-            }
-        }
-
-        if ((!tMips || info.mipLevels != tMips) && (info.width > 1 || info.height > 1 || info.depth > 1))
-        {
-            std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
-            if (!timage)
-            {
-                wprintf(L"\nERROR: Memory allocation failed\n");
-                return 1;
-            }
-
-            if (info.dimension == TEX_DIMENSION_TEXTURE3D)
-            {
-                hr = GenerateMipMaps3D(image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFilter3D | dwFilterOpts, tMips, *timage);
-            }
-            else
-            {
-                hr = GenerateMipMaps(image->GetImages(), image->GetImageCount(), image->GetMetadata(), dwFilter | dwFilterOpts, tMips, *timage);
-            }
-            if (FAILED(hr))
-            {
-                wprintf(L" FAILED [mipmaps] (%x)\n", hr);
-                return 1;
-            }
-
-            auto& tinfo = timage->GetMetadata();
-            info.mipLevels = tinfo.mipLevels;
-
-            assert(info.width == tinfo.width);
-            assert(info.height == tinfo.height);
-            assert(info.depth == tinfo.depth);
-            assert(info.arraySize == tinfo.arraySize);
-            assert(info.miscFlags == tinfo.miscFlags);
-            assert(info.format == tinfo.format);
-            assert(info.dimension == tinfo.dimension);
+                if (wcschr(pValue, L'i'))
+                {
+                    dwNormalMap |= CNMAP_INVERT_SIGN;
+                }
 
-            image.swap(timage);
-            cimage.reset();
-        }
+                if (wcschr(pValue, L'o'))
+                {
+                    dwNormalMap |= CNMAP_COMPUTE_OCCLUSION;
+                }
 
-        // --- Premultiplied alpha (if requested) --------------------------------------
-        if ((dwOptions & (DWORD64(1) << OPT_PREMUL_ALPHA))
-            && HasAlpha(info.format)
-            && info.format != DXGI_FORMAT_A8_UNORM)
-        {
-            if (info.IsPMAlpha())
-            {
-                printf("\nWARNING: Image is already using premultiplied alpha\n");
+                if (wcschr(pValue, L's'))
+                {
+                    dwNormalMap |= CNMAP_SOBEL;
+                }
+                else if (wcschr(pValue, L'c'))
+                {
+                    dwNormalMap |= CNMAP_SCHARR;
+                }
             }
-            else
-            {
-                auto img = image->GetImage(0, 0, 0);
-                assert(img);
-                size_t nimg = image->GetImageCount();
+            break;
 
-                std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
-                if (!timage)
+            case OPT_NORMAL_MAP_AMPLITUDE:
+                if (!dwNormalMap)
                 {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
+                    wprintf(L"-nmapamp requires -nmap\n\n");
+                    PrintUsage();
                     return 1;
                 }
-
-                hr = PremultiplyAlpha(img, nimg, info, dwSRGB, *timage);
-                if (FAILED(hr))
+                else if (swscanf_s(pValue, L"%f", &nmapAmplitude) != 1)
                 {
-                    wprintf(L" FAILED [premultiply alpha] (%x)\n", hr);
-                    continue;
+                    wprintf(L"Invalid value specified with -nmapamp (%ls)\n\n", pValue);
+                    PrintUsage();
+                    return 1;
                 }
+                else if (nmapAmplitude < 0.f)
+                {
+                    wprintf(L"Normal map amplitude must be positive (%ls)\n\n", pValue);
+                    PrintUsage();
+                    return 1;
+                }
+                break;
 
-                auto& tinfo = timage->GetMetadata();
-                info.miscFlags2 = tinfo.miscFlags2;
-
-                assert(info.width == tinfo.width);
-                assert(info.height == tinfo.height);
-                assert(info.depth == tinfo.depth);
-                assert(info.arraySize == tinfo.arraySize);
-                assert(info.mipLevels == tinfo.mipLevels);
-                assert(info.miscFlags == tinfo.miscFlags);
-                assert(info.dimension == tinfo.dimension);
+            case OPT_GPU:
+                if (swscanf_s(pValue, L"%d", &adapter) != 1)
+                {
+                    wprintf(L"Invalid value specified with -gpu (%ls)\n\n", pValue);
+                    PrintUsage();
+                    return 1;
+                }
+                else if (adapter < 0)
+                {
+                    wprintf(L"Adapter index (%ls)\n\n", pValue);
+                    PrintUsage();
+                    return 1;
+                }
+                break;
 
-                image.swap(timage);
-                cimage.reset();
-            }
-        }
+            case OPT_FEATURE_LEVEL:
+                maxSize = LookupByName(pValue, g_pFeatureLevels);
+                if (!maxSize)
+                {
+                    wprintf(L"Invalid value specified with -fl (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                break;
 
-        // --- Compress ----------------------------------------------------------------
-        if (IsCompressed(tformat) && (FileType == CODEC_DDS))
-        {
-            if (cimage && (cimage->GetMetadata().format == tformat))
-            {
-                // We never changed the image and it was already compressed in our desired format, use original data
-                image.reset(cimage.release());
+            case OPT_ALPHA_WEIGHT:
+                if (swscanf_s(pValue, L"%f", &alphaWeight) != 1)
+                {
+                    wprintf(L"Invalid value specified with -aw (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
+                }
+                else if (alphaWeight < 0.f)
+                {
+                    wprintf(L"-aw (%ls) parameter must be positive\n", pValue);
+                    wprintf(L"\n");
+                    return 1;
+                }
+                break;
 
-                auto& tinfo = image->GetMetadata();
+            case OPT_COMPRESS_UNIFORM:
+                dwCompress |= TEX_COMPRESS_UNIFORM;
+                break;
 
-                if ((tinfo.width % 4) != 0 || (tinfo.height % 4) != 0)
+            case OPT_COMPRESS_MAX:
+                if (dwCompress & TEX_COMPRESS_BC7_QUICK)
                 {
-                    non4bc = true;
+                    wprintf(L"Can't use -bcmax and -bcquick at same time\n\n");
+                    PrintUsage();
+                    return 1;
                 }
+                dwCompress |= TEX_COMPRESS_BC7_USE_3SUBSETS;
+                break;
 
-                info.format = tinfo.format;
-                assert(info.width == tinfo.width);
-                assert(info.height == tinfo.height);
-                assert(info.depth == tinfo.depth);
-                assert(info.arraySize == tinfo.arraySize);
-                assert(info.mipLevels == tinfo.mipLevels);
-                assert(info.miscFlags == tinfo.miscFlags);
-                assert(info.dimension == tinfo.dimension);
-            }
-            else
-            {
-                cimage.reset();
+            case OPT_COMPRESS_QUICK:
+                if (dwCompress & TEX_COMPRESS_BC7_USE_3SUBSETS)
+                {
+                    wprintf(L"Can't use -bcmax and -bcquick at same time\n\n");
+                    PrintUsage();
+                    return 1;
+                }
+                dwCompress |= TEX_COMPRESS_BC7_QUICK;
+                break;
 
-                auto img = image->GetImage(0, 0, 0);
-                assert(img);
-                size_t nimg = image->GetImageCount();
+            case OPT_COMPRESS_DITHER:
+                dwCompress |= TEX_COMPRESS_DITHER;
+                break;
 
-                std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
-                if (!timage)
+            case OPT_WIC_QUALITY:
+                if (swscanf_s(pValue, L"%f", &wicQuality) != 1
+                    || (wicQuality < 0.f)
+                    || (wicQuality > 1.f))
                 {
-                    wprintf(L"\nERROR: Memory allocation failed\n");
+                    wprintf(L"Invalid value specified with -wicq (%ls)\n", pValue);
+                    printf("\n");
+                    PrintUsage();
                     return 1;
                 }
+                break;
 
-                bool bc6hbc7 = false;
-                switch (tformat)
+            case OPT_COLORKEY:
+                if (swscanf_s(pValue, L"%x", &colorKey) != 1)
                 {
-                case DXGI_FORMAT_BC6H_TYPELESS:
-                case DXGI_FORMAT_BC6H_UF16:
-                case DXGI_FORMAT_BC6H_SF16:
-                case DXGI_FORMAT_BC7_TYPELESS:
-                case DXGI_FORMAT_BC7_UNORM:
-                case DXGI_FORMAT_BC7_UNORM_SRGB:
-                    bc6hbc7 = true;
+                    printf("Invalid value specified with -c (%ls)\n", pValue);
+                    printf("\n");
+                    PrintUsage();
+                    return 1;
+                }
+                colorKey &= 0xFFFFFF;
+                break;
+
+            case OPT_X2_BIAS:
+                dwConvert |= TEX_FILTER_FLOAT_X2BIAS;
+                break;
 
+            case OPT_FILELIST:
+                {
+                    std::wifstream inFile(pValue);
+                    if (!inFile)
+                    {
+                        wprintf(L"Error opening -flist file %ls\n", pValue);
+                        return 1;
+                    }
+                    wchar_t fname[1024] = {};
+                    for (;;)
                     {
-                        static bool s_tryonce = false;
+                        inFile >> fname;
+                        if (!inFile)
+                            break;
 
-                        if (!s_tryonce)
+                        if (*fname == L'#')
                         {
-                            s_tryonce = true;
-
-                            if (!(dwOptions & (DWORD64(1) << OPT_NOGPU)))
-                            {
-                                if (!CreateDevice(adapter, pDevice.GetAddressOf()))
-                                    wprintf(L"\nWARNING: DirectCompute is not available, using BC6H / BC7 CPU codec\n");
-                            }
-                            else
-                            {
-                                wprintf(L"\nWARNING: using BC6H / BC7 CPU codec\n");
-                            }
+                            // Comment
+                        }
+                        else if (*fname == L'-')
+                        {
+                            wprintf(L"Command-line arguments not supported in -flist file\n");
+                            return 1;
+                        }
+                        else if (wcspbrk(fname, L"?*") != nullptr)
+                        {
+                            wprintf(L"Wildcards not supported in -flist file\n");
+                            return 1;
+                        }
+                        else
+                        {
+                            SConversion conv;
+                            wcscpy_s(conv.szSrc, MAX_PATH, fname);
+                            conversion.push_back(conv);
                         }
+
+                        inFile.ignore(1000, '\n');
                     }
-                    break;
+                    inFile.close();
                 }
+                break;
 
-                DWORD cflags = dwCompress;
-#ifdef _OPENMP
-                if (!(dwOptions & (DWORD64(1) << OPT_FORCE_SINGLEPROC)))
+            case OPT_PAPER_WHITE_NITS:
+                if (swscanf_s(pValue, L"%f", &paperWhiteNits) != 1)
                 {
-                    cflags |= TEX_COMPRESS_PARALLEL;
+                    wprintf(L"Invalid value specified with -nits (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
                 }
-#endif
-
-                if ((img->width % 4) != 0 || (img->height % 4) != 0)
+                else if (paperWhiteNits > 10000.f || paperWhiteNits <= 0.f)
                 {
-                    non4bc = true;
+                    wprintf(L"-nits (%ls) parameter must be between 0 and 10000\n", pValue);
+                    wprintf(L"\n");
+                    return 1;
                 }
+                break;
 
-                if (bc6hbc7 && pDevice)
-                {
-                    hr = Compress(pDevice.Get(), img, nimg, info, tformat, dwCompress | dwSRGB, alphaWeight, *timage);
-                }
-                else
-                {
-                    hr = Compress(img, nimg, info, tformat, cflags | dwSRGB, TEX_THRESHOLD_DEFAULT, *timage);
-                }
-                if (FAILED(hr))
+            case OPT_JOBS:
+                if (swscanf_s(pValue, L"%zu", &jobs) != 1 || !jobs)
                 {
-                    wprintf(L" FAILED [compress] (%x)\n", hr);
-                    continue;
+                    wprintf(L"Invalid value specified with -j (%ls)\n", pValue);
+                    wprintf(L"\n");
+                    PrintUsage();
+                    return 1;
                 }
-
-                auto& tinfo = timage->GetMetadata();
-
-                info.format = tinfo.format;
-                assert(info.width == tinfo.width);
-                assert(info.height == tinfo.height);
-                assert(info.depth == tinfo.depth);
-                assert(info.arraySize == tinfo.arraySize);
-                assert(info.mipLevels == tinfo.mipLevels);
-                assert(info.miscFlags == tinfo.miscFlags);
-                assert(info.dimension == tinfo.dimension);
-
-                image.swap(timage);
+                break;
             }
         }
-        else
-        {
-            cimage.reset();
-        }
-
-        // --- Set alpha mode ----------------------------------------------------------
-        if (HasAlpha(info.format)
-            && info.format != DXGI_FORMAT_A8_UNORM)
+        else if (wcspbrk(pArg, L"?*") != nullptr)
         {
-            if (image->IsAlphaAllOpaque())
-            {
-                info.SetAlphaMode(TEX_ALPHA_MODE_OPAQUE);
-            }
-            else if (info.IsPMAlpha())
-            {
-                // Aleady set TEX_ALPHA_MODE_PREMULTIPLIED
-            }
-            else if (dwOptions & (DWORD64(1) << OPT_SEPALPHA))
-            {
-                info.SetAlphaMode(TEX_ALPHA_MODE_CUSTOM);
-            }
-            else if (info.GetAlphaMode() == TEX_ALPHA_MODE_UNKNOWN)
+            size_t count = conversion.size();
+            SearchForFiles(pArg, conversion, (dwOptions & (DWORD64(1) << OPT_RECURSIVE)) != 0);
+            if (conversion.size() <= count)
             {
-                info.SetAlphaMode(TEX_ALPHA_MODE_STRAIGHT);
+                wprintf(L"No matching files found for %ls\n", pArg);
+                return 1;
             }
         }
         else
         {
-            info.SetAlphaMode(TEX_ALPHA_MODE_UNKNOWN);
-        }
+            SConversion conv;
+            wcscpy_s(conv.szSrc, MAX_PATH, pArg);
 
-        // --- Save result -------------------------------------------------------------
-        {
-            auto img = image->GetImage(0, 0, 0);
-            assert(img);
-            size_t nimg = image->GetImageCount();
+            conv.szDest[0] = 0;
 
-            PrintInfo(info);
-            wprintf(L"\n");
+            conversion.push_back(conv);
+        }
+    }
 
-            // Figure out dest filename
-            wchar_t *pchSlash, *pchDot;
+    if (conversion.empty())
+    {
+        PrintUsage();
+        return 0;
+    }
 
-            wcscpy_s(pConv->szDest, MAX_PATH, szPrefix);
+    if (~dwOptions & (DWORD64(1) << OPT_NOLOGO))
+        PrintLogo();
 
-            pchSlash = wcsrchr(pConv->szSrc, L'\\');
-            if (pchSlash != 0)
-                wcscat_s(pConv->szDest, MAX_PATH, pchSlash + 1);
-            else
-                wcscat_s(pConv->szDest, MAX_PATH, pConv->szSrc);
+    // Work out out filename prefix and suffix
+    if (szOutputDir[0] && (L'\\' != szOutputDir[wcslen(szOutputDir) - 1]))
+        wcscat_s(szOutputDir, MAX_PATH, L"\\");
 
-            pchSlash = wcsrchr(pConv->szDest, '\\');
-            pchDot = wcsrchr(pConv->szDest, '.');
+    if (szPrefix[0])
+        wcscat_s(szOutputDir, MAX_PATH, szPrefix);
 
-            if (pchDot > pchSlash)
-                *pchDot = 0;
+    if (szCacheDir[0])
+    {
+        if (L'\\' != szCacheDir[wcslen(szCacheDir) - 1])
+            wcscat_s(szCacheDir, MAX_PATH, L"\\");
 
-            wcscat_s(pConv->szDest, MAX_PATH, szSuffix);
+        if (!CreateDirectoryW(szCacheDir, nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+        {
+            wprintf(L"ERROR: Failed to create cache directory %ls (%x)\n", szCacheDir, HRESULT_FROM_WIN32(GetLastError()));
+            return 1;
+        }
+    }
 
-            // Write texture
-            wprintf(L"writing %ls", pConv->szDest);
-            fflush(stdout);
+    wcscpy_s(szPrefix, MAX_PATH, szOutputDir);
 
-            if (~dwOptions & (DWORD64(1) << OPT_OVERWRITE))
-            {
-                if (GetFileAttributesW(pConv->szDest) != INVALID_FILE_ATTRIBUTES)
-                {
-                    wprintf(L"\nERROR: Output file already exists, use -y to overwrite:\n");
-                    continue;
-                }
-            }
+    ScratchImage specularAANormals;
+    if (szSpecularAA[0])
+    {
+        hr = LoadNormalMap(szSpecularAA, dwOptions, specularAANormals);
+        if (FAILED(hr))
+        {
+            wprintf(L"ERROR: Failed to load normal map %ls for -specaa (%x)\n", szSpecularAA, hr);
+            return 1;
+        }
+    }
 
-            switch (FileType)
-            {
-            case CODEC_DDS:
-                hr = SaveToDDSFile(img, nimg, info,
-                    (dwOptions & (DWORD64(1) << OPT_USE_DX10)) ? (DDS_FLAGS_FORCE_DX10_EXT | DDS_FLAGS_FORCE_DX10_EXT_MISC2) : DDS_FLAGS_NONE,
-                    pConv->szDest);
-                break;
+    const wchar_t* fileTypeName = LookupByValue(FileType, g_pSaveFileTypes);
 
-            case CODEC_TGA:
-                hr = SaveToTGAFile(img[0], pConv->szDest);
-                break;
+    if (fileTypeName)
+    {
+        wcscat_s(szSuffix, MAX_PATH, L".");
+        wcscat_s(szSuffix, MAX_PATH, fileTypeName);
+    }
+    else
+    {
+        wcscat_s(szSuffix, MAX_PATH, L".unknown");
+    }
 
-            case CODEC_HDR:
-                hr = SaveToHDRFile(img[0], pConv->szDest);
-                break;
+    if (FileType != CODEC_DDS)
+    {
+        mipLevels = 1;
+    }
 
-#ifdef USE_OPENEXR
-            case CODEC_EXR:
-                hr = SaveToEXRFile(img[0], pConv->szDest);
-                break;
-#endif
+    LARGE_INTEGER qpcFreq;
+    if (!QueryPerformanceFrequency(&qpcFreq))
+    {
+        qpcFreq.QuadPart = 0;
+    }
 
-            default:
-            {
-                WICCodecs codec = (FileType == CODEC_HDP || FileType == CODEC_JXR) ? WIC_CODEC_WMP : static_cast<WICCodecs>(FileType);
-                size_t nimages = (dwOptions & (DWORD64(1) << OPT_WIC_MULTIFRAME)) ? nimg : 1;
-                hr = SaveToWICFile(img, nimages, WIC_FLAGS_NONE, GetWICCodec(codec), pConv->szDest, nullptr,
-                    [&](IPropertyBag2* props)
-                {
-                    bool wicLossless = (dwOptions & (DWORD64(1) << OPT_WIC_LOSSLESS)) != 0;
 
-                    switch (FileType)
-                    {
-                    case WIC_CODEC_JPEG:
-                        if (wicLossless || wicQuality >= 0.f)
-                        {
-                            PROPBAG2 options = {};
-                            VARIANT varValues = {};
-                            options.pstrName = const_cast<wchar_t*>(L"ImageQuality");
-                            varValues.vt = VT_R4;
-                            varValues.fltVal = (wicLossless) ? 1.f : wicQuality;
-                            (void)props->Write(1, &options, &varValues);
-                        }
-                        break;
+    LARGE_INTEGER qpcStart;
+    if (!QueryPerformanceCounter(&qpcStart))
+    {
+        qpcStart.QuadPart = 0;
+    }
 
-                    case WIC_CODEC_TIFF:
-                    {
-                        PROPBAG2 options = {};
-                        VARIANT varValues = {};
-                        if (wicLossless)
-                        {
-                            options.pstrName = const_cast<wchar_t*>(L"TiffCompressionMethod");
-                            varValues.vt = VT_UI1;
-                            varValues.bVal = WICTiffCompressionNone;
-                        }
-                        else if (wicQuality >= 0.f)
-                        {
-                            options.pstrName = const_cast<wchar_t*>(L"CompressionQuality");
-                            varValues.vt = VT_R4;
-                            varValues.fltVal = wicQuality;
-                        }
-                        (void)props->Write(1, &options, &varValues);
-                    }
-                    break;
+    // Convert images
+    SConvertOptions opts = {};
+    opts.width = width;
+    opts.height = height;
+    opts.mipLevels = mipLevels;
+    opts.format = format;
+    opts.dwFilter = dwFilter;
+    opts.dwSRGB = dwSRGB;
+    opts.dwConvert = dwConvert;
+    opts.dwCompress = dwCompress;
+    opts.dwFilterOpts = dwFilterOpts;
+    opts.FileType = FileType;
+    opts.maxSize = maxSize;
+    opts.adapter = adapter;
+    opts.alphaWeight = alphaWeight;
+    opts.dwNormalMap = dwNormalMap;
+    opts.nmapAmplitude = nmapAmplitude;
+    opts.wicQuality = wicQuality;
+    opts.colorKey = colorKey;
+    opts.dwRotateColor = dwRotateColor;
+    opts.paperWhiteNits = paperWhiteNits;
+    opts.dwOptions = dwOptions;
+    opts.jobs = std::min<size_t>(jobs, conversion.size());
+    wcscpy_s(opts.szPrefix, MAX_PATH, szPrefix);
+    wcscpy_s(opts.szSuffix, MAX_PATH, szSuffix);
+    wcscpy_s(opts.szCacheDir, MAX_PATH, szCacheDir);
+    opts.pSpecularAANormals = (szSpecularAA[0]) ? &specularAANormals : nullptr;
+    opts.cacheSeed = HashOptions(opts);
+
+    SSharedState shared;
+
+    if (opts.jobs > 1)
+    {
+        if (!ConvertFilesParallel(conversion, opts, shared))
+            return 1;
+    }
+    else
+    {
+        for (auto pConv = conversion.begin(); pConv != conversion.end(); ++pConv)
+        {
+            if (pConv != conversion.begin())
+                wprintf(L"\n");
 
-                    case WIC_CODEC_WMP:
-                    case CODEC_HDP:
-                    case CODEC_JXR:
-                    {
-                        PROPBAG2 options = {};
-                        VARIANT varValues = {};
-                        if (wicLossless)
-                        {
-                            options.pstrName = const_cast<wchar_t*>(L"Lossless");
-                            varValues.vt = VT_BOOL;
-                            varValues.bVal = TRUE;
-                        }
-                        else if (wicQuality >= 0.f)
-                        {
-                            options.pstrName = const_cast<wchar_t*>(L"ImageQuality");
-                            varValues.vt = VT_R4;
-                            varValues.fltVal = wicQuality;
-                        }
-                        (void)props->Write(1, &options, &varValues);
-                    }
-                    break;
-                    }
-                });
-            }
-            break;
-            }
+            SConversionJob job;
+            job.pConv = &(*pConv);
 
-            if (FAILED(hr))
+            for (size_t stage = STAGE_LOAD; stage < STAGE_MAX; ++stage)
             {
-                wprintf(L" FAILED (%x)\n", hr);
-                continue;
+                LONGLONG ticks = 0;
+                STAGE_RESULT result = RunStage(stage, job, opts, shared, ticks);
+                shared.stageTime[stage] += ticks;
+
+                if (result == STAGE_ABORT)
+                    return 1;
+                else if (result != STAGE_OK)
+                    break;
             }
-            wprintf(L"\n");
         }
     }
 
-    if (nonpow2warn && maxSize <= 4096)
+    if (shared.nonpow2warn && maxSize <= 4096)
     {
         // Only emit this warning if ran with -fl set to a 9.x feature level
         wprintf(L"\nWARNING: Not all feature levels support non-power-of-2 textures with mipmaps\n");
     }
 
-    if (non4bc)
+    if (shared.non4bc)
         wprintf(L"\nWARNING: Direct3D requires BC image to be multiple of 4 in width & height\n");
 
     if (dwOptions & (DWORD64(1) << OPT_TIMING))
@@ -2965,8 +3734,28 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
         {
             LONGLONG delta = qpcEnd.QuadPart - qpcStart.QuadPart;
             wprintf(L"\n Processing time: %f seconds\n", double(delta) / double(qpcFreq.QuadPart));
+
+            if (opts.jobs > 1)
+                wprintf(L" Stage times (summed over %zu jobs):\n", opts.jobs);
+            else
+                wprintf(L" Stage times:\n");
+
+            for (size_t stage = STAGE_LOAD; stage < STAGE_MAX; ++stage)
+            {
+                wprintf(L"   %-10ls %f seconds\n", g_pStageNames[stage], double(shared.stageTime[stage]) / double(qpcFreq.QuadPart));
+            }
         }
     }
 
+    if (szCacheDir[0])
+    {
+        size_t hits = shared.cacheHits;
+        size_t misses = shared.cacheMisses;
+        wprintf(L"\n Cache: %zu hits, %zu misses", hits, misses);
+        if (hits + misses > 0)
+            wprintf(L" (%.1f%% hit rate)", 100.0 * double(hits) / double(hits + misses));
+        wprintf(L"\n");
+    }
+
     return 0;
 }
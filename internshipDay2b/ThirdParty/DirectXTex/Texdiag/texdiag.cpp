@@ -21,13 +21,19 @@
 #define NOHELP
 #pragma warning(pop)
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 
+#include <atomic>
+#include <cmath>
 #include <fstream>
 #include <memory>
 #include <list>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <dxgiformat.h>
@@ -72,6 +78,9 @@ enum OPTIONS
     OPT_TARGET_PIXELX,
     OPT_TARGET_PIXELY,
     OPT_FILELIST,
+    OPT_JOBS,
+    OPT_REPORT,
+    OPT_REFERENCE,
     OPT_MAX
 };
 
@@ -120,6 +129,9 @@ const SValue g_pOptions[] =
     { L"targetx",   OPT_TARGET_PIXELX },
     { L"targety",   OPT_TARGET_PIXELY },
     { L"flist",     OPT_FILELIST },
+    { L"j",         OPT_JOBS },
+    { L"report",    OPT_REPORT },
+    { L"ref",       OPT_REFERENCE },
     { nullptr,      0 }
 };
 
@@ -551,6 +563,11 @@ namespace
         wprintf(L"   -ft <filetype>      output file type\n");
         wprintf(L"\n   -nologo             suppress copyright message\n");
         wprintf(L"   -flist <filename>   use text file with a list of input files (one per line)\n");
+        wprintf(L"\n                       (batch analyze, compare, and diff)\n");
+        wprintf(L"   -ref <dir>          compare each file with the same-named file in <dir>\n");
+        wprintf(L"   -j <n>              process up to n files at a time\n");
+        wprintf(L"   -report <filename>  write results for all files as JSON (or CSV for .csv)\n");
+        wprintf(L"                       diff writes <name>_diff.<filetype> to the -o directory\n");
 
         wprintf(L"\n   <format>: ");
         PrintList(13, g_pFormats);
@@ -3044,6 +3061,572 @@ namespace
 
         return S_OK;
     }
+
+    //--------------------------------------------------------------------------------------
+    // Batch mode
+    //--------------------------------------------------------------------------------------
+    struct SAnalyzeResult
+    {
+        size_t mip;
+        size_t item;
+        size_t slice;
+        AnalyzeData data;
+    };
+
+    struct SBatchResult
+    {
+        const SConversion* pConv;
+        wchar_t szRef[MAX_PATH];
+        wchar_t szDiff[MAX_PATH];
+        HRESULT hr;
+        const char* failedStep;     // nullptr on success
+        TexMetadata info;
+        double loadTime;            // Seconds spent decoding the file (and its reference)
+        double processTime;         // Seconds spent analyzing, comparing, or diffing
+        std::vector<SAnalyzeResult> analysis;
+        std::vector<ImageMetrics> metrics;
+
+        SBatchResult() : pConv(nullptr), szRef{}, szDiff{}, hr(S_OK), failedStep(nullptr), info{}, loadTime(0), processTime(0) {}
+    };
+
+    struct SBatchOptions
+    {
+        DWORD command;
+        DWORD dwOptions;
+        DWORD dwFilter;
+        DXGI_FORMAT diffFormat;
+        DWORD fileType;
+        const wchar_t* szRefDir;    // With trailing slash
+        const wchar_t* szOutputDir; // With trailing slash, or empty
+    };
+
+
+    double ElapsedSeconds(const LARGE_INTEGER& start, const LARGE_INTEGER& end)
+    {
+        LARGE_INTEGER qpcFreq;
+        if (!QueryPerformanceFrequency(&qpcFreq) || !qpcFreq.QuadPart)
+            return 0;
+
+        return double(end.QuadPart - start.QuadPart) / double(qpcFreq.QuadPart);
+    }
+
+
+    // Decodes the file (and its reference for compare/diff) once, then runs every analysis for the command on it
+    void ProcessBatchFile(SBatchResult& result, const SBatchOptions& opts)
+    {
+        LARGE_INTEGER qpcStart, qpcLoaded, qpcEnd;
+        QueryPerformanceCounter(&qpcStart);
+
+        std::unique_ptr<ScratchImage> image;
+        HRESULT hr = LoadImage(result.pConv->szSrc, opts.dwOptions, opts.dwFilter, result.info, image);
+        if (FAILED(hr))
+        {
+            result.hr = hr;
+            result.failedStep = "load";
+            return;
+        }
+
+        TexMetadata refInfo = {};
+        std::unique_ptr<ScratchImage> refImage;
+        if (opts.command != CMD_ANALYZE)
+        {
+            wchar_t fname[_MAX_FNAME];
+            wchar_t ext[_MAX_EXT];
+            _wsplitpath_s(result.pConv->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, ext, _MAX_EXT);
+            swprintf_s(result.szRef, L"%ls%ls%ls", opts.szRefDir, fname, ext);
+
+            hr = LoadImage(result.szRef, opts.dwOptions, opts.dwFilter, refInfo, refImage);
+            if (FAILED(hr))
+            {
+                result.hr = hr;
+                result.failedStep = "load reference";
+                return;
+            }
+        }
+
+        QueryPerformanceCounter(&qpcLoaded);
+        result.loadTime = ElapsedSeconds(qpcStart, qpcLoaded);
+
+        TexMetadata& info = result.info;
+
+        if (opts.command == CMD_ANALYZE)
+        {
+            if (IsPlanar(info.format))
+            {
+                std::unique_ptr<ScratchImage> timage(new (std::nothrow) ScratchImage);
+                if (!timage)
+                {
+                    result.hr = E_OUTOFMEMORY;
+                    result.failedStep = "converttosingleplane";
+                    return;
+                }
+
+                hr = ConvertToSinglePlane(image->GetImages(), image->GetImageCount(), info, *timage);
+                if (FAILED(hr))
+                {
+                    result.hr = hr;
+                    result.failedStep = "converttosingleplane";
+                    return;
+                }
+
+                info.format = timage->GetMetadata().format;
+                image.swap(timage);
+            }
+
+            size_t depth = info.depth;
+            for (size_t mip = 0; mip < info.mipLevels; ++mip)
+            {
+                for (size_t item = 0; item < info.arraySize; ++item)
+                {
+                    for (size_t slice = 0; slice < depth; ++slice)
+                    {
+                        const Image* img = image->GetImage(mip, item, slice);
+                        if (!img)
+                        {
+                            result.hr = E_UNEXPECTED;
+                            result.failedStep = "analyze";
+                            return;
+                        }
+
+                        SAnalyzeResult sub = {};
+                        sub.mip = mip;
+                        sub.item = item;
+                        sub.slice = slice;
+                        hr = Analyze(*img, sub.data);
+                        if (FAILED(hr))
+                        {
+                            result.hr = hr;
+                            result.failedStep = "analyze";
+                            return;
+                        }
+
+                        result.analysis.push_back(sub);
+                    }
+                }
+
+                if (depth > 1)
+                    depth >>= 1;
+            }
+        }
+        else
+        {
+            if (info.width != refInfo.width || info.height != refInfo.height)
+            {
+                result.hr = E_FAIL;
+                result.failedStep = "size mismatch";
+                return;
+            }
+
+            if (info.depth == refInfo.depth
+                && info.arraySize == refInfo.arraySize
+                && info.mipLevels == refInfo.mipLevels
+                && info.dimension == refInfo.dimension)
+            {
+                hr = ComputeMetrics(image->GetImages(), image->GetImageCount(), info,
+                    refImage->GetImages(), refImage->GetImageCount(), refInfo, CMSE_DEFAULT, result.metrics);
+            }
+            else
+            {
+                // Same as the single-file compare, only the first image of each is used
+                ImageMetrics metrics;
+                hr = ComputeMetrics(*image->GetImage(0, 0, 0), *refImage->GetImage(0, 0, 0), CMSE_DEFAULT, metrics);
+                if (SUCCEEDED(hr))
+                    result.metrics.push_back(metrics);
+            }
+            if (FAILED(hr))
+            {
+                result.hr = hr;
+                result.failedStep = "compare";
+                return;
+            }
+
+            if (opts.command == CMD_DIFF)
+            {
+                ScratchImage diffImage;
+                hr = Difference(*image->GetImage(0, 0, 0), *refImage->GetImage(0, 0, 0), opts.dwFilter, opts.diffFormat, diffImage);
+                if (FAILED(hr))
+                {
+                    result.hr = hr;
+                    result.failedStep = "diff";
+                    return;
+                }
+
+                wchar_t fname[_MAX_FNAME];
+                _wsplitpath_s(result.pConv->szSrc, nullptr, 0, nullptr, 0, fname, _MAX_FNAME, nullptr, 0);
+                swprintf_s(result.szDiff, L"%ls%ls_diff.%ls", opts.szOutputDir, fname, LookupByValue(opts.fileType, g_pDumpFileTypes));
+
+                if (~opts.dwOptions & (1 << OPT_OVERWRITE))
+                {
+                    if (GetFileAttributesW(result.szDiff) != INVALID_FILE_ATTRIBUTES)
+                    {
+                        result.hr = HRESULT_FROM_WIN32(ERROR_FILE_EXISTS);
+                        result.failedStep = "save diff";
+                        return;
+                    }
+                }
+
+                hr = SaveImage(diffImage.GetImage(0, 0, 0), result.szDiff, opts.fileType);
+                if (FAILED(hr))
+                {
+                    result.hr = hr;
+                    result.failedStep = "save diff";
+                    return;
+                }
+            }
+        }
+
+        QueryPerformanceCounter(&qpcEnd);
+        result.processTime = ElapsedSeconds(qpcLoaded, qpcEnd);
+    }
+
+
+    void PrintBatchResult(const SBatchResult& result)
+    {
+        if (result.failedStep)
+        {
+            wprintf(L"%ls FAILED [%hs] (%x)\n", result.pConv->szSrc, result.failedStep, static_cast<unsigned int>(result.hr));
+            return;
+        }
+
+        wprintf(L"%ls (%zux%zu ", result.pConv->szSrc, result.info.width, result.info.height);
+        PrintFormat(result.info.format);
+        wprintf(L") %.3f s", result.loadTime + result.processTime);
+
+        if (!result.metrics.empty())
+        {
+            // Report the worst subresource
+            float psnr = INFINITY;
+            float ssim = 1.f;
+            for (auto& it : result.metrics)
+            {
+                psnr = std::min(psnr, it.psnr);
+                ssim = std::min(ssim, it.ssim);
+            }
+
+            wprintf(L": PSNR %f dB SSIM %f", psnr, ssim);
+        }
+
+        if (*result.szDiff)
+            wprintf(L" -> %ls", result.szDiff);
+
+        wprintf(L"\n");
+    }
+
+
+    // Runs ProcessBatchFile on 'jobs' worker threads; console output is one line per file
+    void RunBatch(std::vector<SBatchResult>& results, const SBatchOptions& opts, size_t jobs)
+    {
+        std::atomic<size_t> nextFile(0);
+        std::mutex consoleLock;
+
+        auto worker = [&]()
+        {
+            HRESULT hrCOM = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+            for (;;)
+            {
+                size_t index = nextFile++;
+                if (index >= results.size())
+                    break;
+
+                ProcessBatchFile(results[index], opts);
+
+                std::lock_guard<std::mutex> guard(consoleLock);
+                PrintBatchResult(results[index]);
+                fflush(stdout);
+            }
+
+            if (SUCCEEDED(hrCOM))
+                CoUninitialize();
+        };
+
+        std::vector<std::thread> workers;
+        try
+        {
+            for (size_t j = 1; j < jobs; ++j)
+                workers.emplace_back(worker);
+        }
+        catch (const std::exception&)
+        {
+            // Carry on with the threads that were started
+        }
+
+        // The calling thread works too
+        worker();
+
+        for (auto& t : workers)
+            t.join();
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Batch report
+    //--------------------------------------------------------------------------------------
+    void AppendFormat(std::string& str, _In_z_ _Printf_format_string_ const char* format, ...)
+    {
+        char buff[512];
+
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf_s(buff, _TRUNCATE, format, args);
+        va_end(args);
+
+        if (len > 0)
+            str.append(buff, static_cast<size_t>(len));
+    }
+
+
+    void AppendNumber(std::string& str, double value, bool json)
+    {
+        if (std::isfinite(value))
+            AppendFormat(str, "%.9g", value);
+        else if (json)
+            str.append("null");
+        else if (std::isnan(value))
+            str.append("nan");
+        else
+            str.append((value < 0) ? "-inf" : "inf");
+    }
+
+
+    // Appends a path or name as UTF-8, quoted and escaped for JSON or CSV
+    void AppendString(std::string& str, const wchar_t* value, bool json)
+    {
+        char buff[MAX_PATH * 3];
+        int len = WideCharToMultiByte(CP_UTF8, 0, value, -1, buff, static_cast<int>(sizeof(buff)), nullptr, nullptr);
+        if (len <= 0)
+            buff[0] = 0;
+
+        str.push_back('"');
+        for (const char* ptr = buff; *ptr; ++ptr)
+        {
+            if (json && (*ptr == '"' || *ptr == '\\'))
+                str.push_back('\\');
+            else if (!json && *ptr == '"')
+                str.push_back('"');
+            str.push_back(*ptr);
+        }
+        str.push_back('"');
+    }
+
+
+    const wchar_t* GetFormatName(DXGI_FORMAT format)
+    {
+        const wchar_t* name = LookupByValue(static_cast<DWORD>(format), g_pFormats);
+        if (!*name)
+            name = LookupByValue(static_cast<DWORD>(format), g_pReadOnlyFormats);
+        return (*name) ? name : L"UNKNOWN";
+    }
+
+
+    void AppendVector(std::string& str, const char* name, const XMFLOAT4& value)
+    {
+        AppendFormat(str, ", \"%s\": [", name);
+        const float v[4] = { value.x, value.y, value.z, value.w };
+        for (size_t j = 0; j < 4; ++j)
+        {
+            if (j > 0)
+                str.append(", ");
+            AppendNumber(str, v[j], true);
+        }
+        str.append("]");
+    }
+
+
+    void AppendFileColumns(std::string& str, const SBatchResult& result)
+    {
+        AppendString(str, result.pConv->szSrc, false);
+        str.append(",");
+        AppendString(str, result.szRef, false);
+        AppendFormat(str, ",%s,0x%08X,", (result.failedStep) ? result.failedStep : "ok", static_cast<unsigned int>(result.hr));
+        AppendNumber(str, result.loadTime, false);
+        str.append(",");
+        AppendNumber(str, result.processTime, false);
+    }
+
+
+    HRESULT WriteBatchReport(const wchar_t* szReportFile, const std::vector<SBatchResult>& results, const SBatchOptions& opts)
+    {
+        wchar_t ext[_MAX_EXT];
+        _wsplitpath_s(szReportFile, nullptr, 0, nullptr, 0, nullptr, 0, ext, _MAX_EXT);
+        const bool json = (_wcsicmp(ext, L".csv") != 0);
+
+        std::string report;
+        try
+        {
+            if (json)
+            {
+                AppendFormat(report, "{\n  \"command\": \"%s\",\n  \"files\": [\n",
+                    (opts.command == CMD_ANALYZE) ? "analyze" : (opts.command == CMD_COMPARE) ? "compare" : "diff");
+
+                for (size_t i = 0; i < results.size(); ++i)
+                {
+                    const SBatchResult& result = results[i];
+
+                    report.append("    { \"file\": ");
+                    AppendString(report, result.pConv->szSrc, true);
+                    if (*result.szRef)
+                    {
+                        report.append(", \"reference\": ");
+                        AppendString(report, result.szRef, true);
+                    }
+                    AppendFormat(report, ", \"status\": \"%s\", \"hr\": \"0x%08X\"",
+                        (result.failedStep) ? result.failedStep : "ok", static_cast<unsigned int>(result.hr));
+                    report.append(", \"loadTime\": ");
+                    AppendNumber(report, result.loadTime, true);
+                    report.append(", \"processTime\": ");
+                    AppendNumber(report, result.processTime, true);
+
+                    if (result.info.width)
+                    {
+                        AppendFormat(report, ", \"width\": %zu, \"height\": %zu, \"depth\": %zu, \"arraySize\": %zu, \"mipLevels\": %zu, \"format\": ",
+                            result.info.width, result.info.height, result.info.depth, result.info.arraySize, result.info.mipLevels);
+                        AppendString(report, GetFormatName(result.info.format), true);
+                    }
+
+                    if (*result.szDiff)
+                    {
+                        report.append(", \"diff\": ");
+                        AppendString(report, result.szDiff, true);
+                    }
+
+                    if (opts.command == CMD_ANALYZE)
+                    {
+                        report.append(",\n      \"analysis\": [");
+                        for (size_t j = 0; j < result.analysis.size(); ++j)
+                        {
+                            const SAnalyzeResult& sub = result.analysis[j];
+                            AppendFormat(report, "%s\n        { \"mip\": %zu, \"item\": %zu, \"slice\": %zu",
+                                (j > 0) ? "," : "", sub.mip, sub.item, sub.slice);
+                            AppendVector(report, "min", sub.data.imageMin);
+                            AppendVector(report, "avg", sub.data.imageAvg);
+                            AppendVector(report, "max", sub.data.imageMax);
+                            AppendVector(report, "variance", sub.data.imageVariance);
+                            AppendVector(report, "stdDev", sub.data.imageStdDev);
+                            report.append(", \"luminance\": ");
+                            AppendNumber(report, sub.data.luminance, true);
+                            AppendFormat(report, ", \"specials\": [%zu, %zu, %zu, %zu] }",
+                                sub.data.specials_x, sub.data.specials_y, sub.data.specials_z, sub.data.specials_w);
+                        }
+                        report.append(" ]");
+                    }
+                    else if (!result.metrics.empty())
+                    {
+                        Blob blob;
+                        HRESULT hr = SaveMetricsReport(result.metrics.data(), result.metrics.size(), METRICS_REPORT_JSON, blob);
+                        if (FAILED(hr))
+                            return hr;
+
+                        report.append(",\n      \"metrics\": ");
+                        report.append(static_cast<const char*>(blob.GetBufferPointer()), blob.GetBufferSize());
+                        while (!report.empty() && report.back() == '\n')
+                            report.pop_back();
+                    }
+
+                    report.append((i + 1 < results.size()) ? " },\n" : " }\n");
+                }
+
+                report.append("  ]\n}\n");
+            }
+            else if (opts.command == CMD_ANALYZE)
+            {
+                // One row per subresource
+                report.append("file,reference,status,hr,loadTime,processTime,mip,item,slice");
+                static const char* s_names[5] = { "min", "avg", "max", "variance", "stdDev" };
+                static const char* s_channels[4] = { "R", "G", "B", "A" };
+                for (size_t j = 0; j < 5; ++j)
+                {
+                    for (size_t c = 0; c < 4; ++c)
+                        AppendFormat(report, ",%s%s", s_names[j], s_channels[c]);
+                }
+                report.append(",luminance,specialsR,specialsG,specialsB,specialsA\n");
+
+                for (auto& result : results)
+                {
+                    if (result.analysis.empty())
+                    {
+                        AppendFileColumns(report, result);
+                        report.append("\n");
+                        continue;
+                    }
+
+                    for (auto& sub : result.analysis)
+                    {
+                        AppendFileColumns(report, result);
+                        AppendFormat(report, ",%zu,%zu,%zu", sub.mip, sub.item, sub.slice);
+
+                        const XMFLOAT4* values[5] = { &sub.data.imageMin, &sub.data.imageAvg, &sub.data.imageMax, &sub.data.imageVariance, &sub.data.imageStdDev };
+                        for (size_t j = 0; j < 5; ++j)
+                        {
+                            const float v[4] = { values[j]->x, values[j]->y, values[j]->z, values[j]->w };
+                            for (size_t c = 0; c < 4; ++c)
+                            {
+                                report.append(",");
+                                AppendNumber(report, v[c], false);
+                            }
+                        }
+
+                        report.append(",");
+                        AppendNumber(report, sub.data.luminance, false);
+                        AppendFormat(report, ",%zu,%zu,%zu,%zu\n", sub.data.specials_x, sub.data.specials_y, sub.data.specials_z, sub.data.specials_w);
+                    }
+                }
+            }
+            else
+            {
+                // One row per compared subresource, using the library's metrics columns
+                bool header = false;
+                for (auto& result : results)
+                {
+                    Blob blob;
+                    HRESULT hr = SaveMetricsReport(result.metrics.data(), result.metrics.size(), METRICS_REPORT_CSV, blob);
+                    if (FAILED(hr))
+                        return hr;
+
+                    std::string rows(static_cast<const char*>(blob.GetBufferPointer()), blob.GetBufferSize());
+                    size_t eol = rows.find('\n');
+                    if (!header)
+                    {
+                        report.append("file,reference,status,hr,loadTime,processTime,");
+                        report.append(rows, 0, eol + 1);
+                        header = true;
+                    }
+
+                    if (result.metrics.empty())
+                    {
+                        AppendFileColumns(report, result);
+                        report.append("\n");
+                        continue;
+                    }
+
+                    for (size_t start = eol + 1; start < rows.size(); start = eol + 1)
+                    {
+                        eol = rows.find('\n', start);
+                        if (eol == std::string::npos)
+                            eol = rows.size() - 1;
+
+                        AppendFileColumns(report, result);
+                        report.append(",");
+                        report.append(rows, start, eol - start + 1);
+                    }
+                }
+            }
+        }
+        catch (const std::bad_alloc&)
+        {
+            return E_OUTOFMEMORY;
+        }
+
+        std::ofstream outFile(szReportFile, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!outFile)
+            return HRESULT_FROM_WIN32(ERROR_CANNOT_MAKE);
+
+        outFile.write(report.data(), static_cast<std::streamsize>(report.size()));
+        if (!outFile)
+            return HRESULT_FROM_WIN32(ERROR_WRITE_FAULT);
+
+        return S_OK;
+    }
 }
 
 
@@ -3061,6 +3644,9 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
     DXGI_FORMAT diffFormat = DXGI_FORMAT_B8G8R8A8_UNORM;
     DWORD fileType = WIC_CODEC_BMP;
     wchar_t szOutputFile[MAX_PATH] = {};
+    wchar_t szReportFile[MAX_PATH] = {};
+    wchar_t szRefDir[MAX_PATH] = {};
+    size_t jobs = 1;
 
     // Initialize COM (needed for WIC)
     HRESULT hr = hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
@@ -3130,6 +3716,9 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
             case OPT_TARGET_PIXELX:
             case OPT_TARGET_PIXELY:
             case OPT_FILELIST:
+            case OPT_JOBS:
+            case OPT_REPORT:
+            case OPT_REFERENCE:
                 if (!*pValue)
                 {
                     if ((iArg + 1 >= argc))
@@ -3279,6 +3868,22 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
                     inFile.close();
                 }
                 break;
+
+            case OPT_JOBS:
+                if (swscanf_s(pValue, L"%zu", &jobs) != 1 || !jobs)
+                {
+                    wprintf(L"Invalid value specified with -j (%ls)\n", pValue);
+                    return 1;
+                }
+                break;
+
+            case OPT_REPORT:
+                wcscpy_s(szReportFile, MAX_PATH, pValue);
+                break;
+
+            case OPT_REFERENCE:
+                wcscpy_s(szRefDir, MAX_PATH, pValue);
+                break;
             }
         }
         else if (wcspbrk(pArg, L"?*") != nullptr)
@@ -3309,6 +3914,80 @@ int __cdecl wmain(_In_ int argc, _In_z_count_(argc) wchar_t* argv[])
     if (~dwOptions & (1 << OPT_NOLOGO))
         PrintLogo();
 
+    // --- Batch analyze/compare/diff ----------------------------------------------------
+    if ((dwCommand == CMD_ANALYZE || dwCommand == CMD_COMPARE || dwCommand == CMD_DIFF)
+        && (dwOptions & ((1 << OPT_JOBS) | (1 << OPT_REPORT) | (1 << OPT_REFERENCE))))
+    {
+        if (dwCommand != CMD_ANALYZE && !*szRefDir)
+        {
+            wprintf(L"ERROR: batch compare/diff needs a reference directory via -ref\n");
+            return 1;
+        }
+
+        if (*szRefDir && (L'\\' != szRefDir[wcslen(szRefDir) - 1]))
+            wcscat_s(szRefDir, MAX_PATH, L"\\");
+
+        // -o names the directory for difference images in batch mode
+        if (*szOutputFile && (L'\\' != szOutputFile[wcslen(szOutputFile) - 1]))
+            wcscat_s(szOutputFile, MAX_PATH, L"\\");
+
+        if (*szReportFile && (~dwOptions & (1 << OPT_OVERWRITE)))
+        {
+            if (GetFileAttributesW(szReportFile) != INVALID_FILE_ATTRIBUTES)
+            {
+                wprintf(L"ERROR: Report file already exists, use -y to overwrite\n");
+                return 1;
+            }
+        }
+
+        SBatchOptions opts = {};
+        opts.command = dwCommand;
+        opts.dwOptions = dwOptions;
+        opts.dwFilter = dwFilter;
+        opts.diffFormat = diffFormat;
+        opts.fileType = fileType;
+        opts.szRefDir = szRefDir;
+        opts.szOutputDir = szOutputFile;
+
+        std::vector<SBatchResult> results(conversion.size());
+        auto pConv = conversion.cbegin();
+        for (auto& result : results)
+        {
+            result.pConv = &(*pConv);
+            ++pConv;
+        }
+
+        LARGE_INTEGER qpcStart, qpcEnd;
+        QueryPerformanceCounter(&qpcStart);
+
+        RunBatch(results, opts, std::min(jobs, results.size()));
+
+        QueryPerformanceCounter(&qpcEnd);
+
+        size_t failed = 0;
+        for (auto& result : results)
+        {
+            if (result.failedStep)
+                ++failed;
+        }
+
+        wprintf(L"\n%zu files, %zu failed, %f seconds\n", results.size(), failed, ElapsedSeconds(qpcStart, qpcEnd));
+
+        if (*szReportFile)
+        {
+            hr = WriteBatchReport(szReportFile, results, opts);
+            if (FAILED(hr))
+            {
+                wprintf(L"ERROR: Failed writing report %ls (%08X)\n", szReportFile, static_cast<unsigned int>(hr));
+                return 1;
+            }
+
+            wprintf(L"Report %ls\n", szReportFile);
+        }
+
+        return (failed > 0) ? 1 : 0;
+    }
+
     switch (dwCommand)
     {
     case CMD_COMPARE:
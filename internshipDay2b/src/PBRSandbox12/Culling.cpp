@@ -0,0 +1,455 @@
+//*********************************************************
+//
+// Culling.cpp
+//
+//*********************************************************
+
+#include "Culling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define CULLING_X86 1
+#define CULLING_AVX_FUNCTION
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#include <immintrin.h>
+#define CULLING_X86 1
+#define CULLING_AVX_FUNCTION __attribute__((target("avx")))
+#endif
+
+namespace
+{
+	void TransformPoint(const float m[4][4], float x, float y, float z, float clip[4])
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			clip[c] = x * m[0][c] + y * m[1][c] + z * m[2][c] + m[3][c];
+		}
+	}
+
+	// Plane tests are written out the same way in every path, ((nx*x + ny*y) + nz*z) + d,
+	// so all instruction sets round identically and agree on every sphere.
+	uint32_t FrustumCullScalar(const CullingFrustum& frustum,
+		const float* pX, const float* pY, const float* pZ, const float* pRadius,
+		uint32_t first, uint32_t end, uint32_t* pVisible)
+	{
+		uint32_t visibleCount = 0;
+		for (uint32_t i = first; i < end; ++i)
+		{
+			bool inside = true;
+			for (int p = 0; p < 6; ++p)
+			{
+				const float* plane = frustum.planes[p];
+				const float distance = plane[0] * pX[i] + plane[1] * pY[i] + plane[2] * pZ[i] + plane[3];
+				inside &= distance > -pRadius[i];
+			}
+
+			// Write unconditionally and only advance on a hit, which avoids a branch.
+			pVisible[visibleCount] = i;
+			visibleCount += inside ? 1 : 0;
+		}
+		return visibleCount;
+	}
+
+#if defined(CULLING_X86)
+	uint32_t FrustumCullSSE(const CullingFrustum& frustum,
+		const float* pX, const float* pY, const float* pZ, const float* pRadius,
+		uint32_t first, uint32_t end, uint32_t* pVisible)
+	{
+		const __m128 signMask = _mm_set1_ps(-0.0f);
+
+		uint32_t visibleCount = 0;
+		uint32_t i = first;
+		for (; i + 4 <= end; i += 4)
+		{
+			const __m128 x = _mm_loadu_ps(pX + i);
+			const __m128 y = _mm_loadu_ps(pY + i);
+			const __m128 z = _mm_loadu_ps(pZ + i);
+			const __m128 negRadius = _mm_xor_ps(_mm_loadu_ps(pRadius + i), signMask);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p)
+			{
+				const float* plane = frustum.planes[p];
+				__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane[0]), x), _mm_mul_ps(_mm_set1_ps(plane[1]), y));
+				distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(plane[2]), z));
+				distance = _mm_add_ps(distance, _mm_set1_ps(plane[3]));
+				inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negRadius));
+			}
+
+			const int mask = _mm_movemask_ps(inside);
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				pVisible[visibleCount] = i + lane;
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+
+		return visibleCount + FrustumCullScalar(frustum, pX, pY, pZ, pRadius, i, end, pVisible + visibleCount);
+	}
+
+	CULLING_AVX_FUNCTION
+	uint32_t FrustumCullAVX(const CullingFrustum& frustum,
+		const float* pX, const float* pY, const float* pZ, const float* pRadius,
+		uint32_t first, uint32_t end, uint32_t* pVisible)
+	{
+		const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+		uint32_t visibleCount = 0;
+		uint32_t i = first;
+		for (; i + 8 <= end; i += 8)
+		{
+			const __m256 x = _mm256_loadu_ps(pX + i);
+			const __m256 y = _mm256_loadu_ps(pY + i);
+			const __m256 z = _mm256_loadu_ps(pZ + i);
+			const __m256 negRadius = _mm256_xor_ps(_mm256_loadu_ps(pRadius + i), signMask);
+
+			__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for (int p = 0; p < 6; ++p)
+			{
+				const float* plane = frustum.planes[p];
+				__m256 distance = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane[0]), x), _mm256_mul_ps(_mm256_set1_ps(plane[1]), y));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(_mm256_set1_ps(plane[2]), z));
+				distance = _mm256_add_ps(distance, _mm256_set1_ps(plane[3]));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GT_OQ));
+			}
+
+			const int mask = _mm256_movemask_ps(inside);
+			for (uint32_t lane = 0; lane < 8; ++lane)
+			{
+				pVisible[visibleCount] = i + lane;
+				visibleCount += (mask >> lane) & 1;
+			}
+		}
+
+		return visibleCount + FrustumCullSSE(frustum, pX, pY, pZ, pRadius, i, end, pVisible + visibleCount);
+	}
+
+	bool CpuSupportsAVX()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+		return __builtin_cpu_supports("avx") != 0;
+#endif
+	}
+#endif
+}
+
+void ExtractFrustumPlanes(const float m[4][4], CullingFrustum& frustum)
+{
+	// With row vectors, clip component c is the dot product of (x, y, z, 1)
+	// with column c, and the planes are combinations of the columns.
+	for (int i = 0; i < 4; ++i)
+	{
+		const float column0 = m[i][0];
+		const float column1 = m[i][1];
+		const float column2 = m[i][2];
+		const float column3 = m[i][3];
+
+		frustum.planes[0][i] = column3 + column0;	// Left.
+		frustum.planes[1][i] = column3 - column0;	// Right.
+		frustum.planes[2][i] = column3 + column1;	// Bottom.
+		frustum.planes[3][i] = column3 - column1;	// Top.
+		frustum.planes[4][i] = column2;				// Near, z >= 0.
+		frustum.planes[5][i] = column3 - column2;	// Far.
+	}
+
+	for (int p = 0; p < 6; ++p)
+	{
+		float* plane = frustum.planes[p];
+		const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (length > 0.0f)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				plane[i] /= length;
+			}
+		}
+	}
+}
+
+bool IsCullingSimdSupported(CullingSimd simd)
+{
+	switch (simd)
+	{
+	case CullingSimd::Scalar:
+		return true;
+#if defined(CULLING_X86)
+	case CullingSimd::SSE:
+		return true;
+	case CullingSimd::AVX:
+	{
+		static const bool supported = CpuSupportsAVX();
+		return supported;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+CullingSimd GetBestCullingSimd()
+{
+	if (IsCullingSimdSupported(CullingSimd::AVX))
+		return CullingSimd::AVX;
+	if (IsCullingSimdSupported(CullingSimd::SSE))
+		return CullingSimd::SSE;
+	return CullingSimd::Scalar;
+}
+
+uint32_t FrustumCullSpheres(const CullingFrustum& frustum,
+	const float* pX, const float* pY, const float* pZ, const float* pRadius,
+	uint32_t first, uint32_t count, uint32_t* pVisible, CullingSimd simd)
+{
+	if (!IsCullingSimdSupported(simd))
+		throw std::invalid_argument("FrustumCullSpheres: instruction set not supported");
+
+	const uint32_t end = first + count;
+	switch (simd)
+	{
+#if defined(CULLING_X86)
+	case CullingSimd::AVX:
+		return FrustumCullAVX(frustum, pX, pY, pZ, pRadius, first, end, pVisible);
+	case CullingSimd::SSE:
+		return FrustumCullSSE(frustum, pX, pY, pZ, pRadius, first, end, pVisible);
+#endif
+	default:
+		return FrustumCullScalar(frustum, pX, pY, pZ, pRadius, first, end, pVisible);
+	}
+}
+
+//
+OcclusionBuffer::OcclusionBuffer() :
+	m_tilesX(0),
+	m_tilesY(0),
+	m_viewProj()
+{
+}
+
+void OcclusionBuffer::Init(uint32_t width, uint32_t height)
+{
+	if (!width || !height)
+		throw std::invalid_argument("OcclusionBuffer: size must be non-zero");
+
+	m_tilesX = (width + TileWidth - 1) / TileWidth;
+	m_tilesY = (height + TileHeight - 1) / TileHeight;
+	m_tiles.resize(static_cast<size_t>(m_tilesX) * m_tilesY);
+}
+
+void OcclusionBuffer::Clear(const float viewProj[4][4])
+{
+	for (int r = 0; r < 4; ++r)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			m_viewProj[r][c] = viewProj[r][c];
+		}
+	}
+
+	const Tile empty = { 0, 1.0f, 0.0f };
+	std::fill(m_tiles.begin(), m_tiles.end(), empty);
+}
+
+void OcclusionBuffer::RenderOccluder(const float* pVertices, const uint32_t* pIndices, uint32_t triangleCount)
+{
+	for (uint32_t t = 0; t < triangleCount; ++t)
+	{
+		float clip[3][4];
+		for (int v = 0; v < 3; ++v)
+		{
+			const float* position = pVertices + static_cast<size_t>(pIndices[t * 3 + v]) * 3;
+			TransformPoint(m_viewProj, position[0], position[1], position[2], clip[v]);
+		}
+		RasterizeTriangle(clip[0], clip[1], clip[2]);
+	}
+}
+
+void OcclusionBuffer::RasterizeTriangle(const float* v0, const float* v1, const float* v2)
+{
+	const float* clip[3] = { v0, v1, v2 };
+	const float width = static_cast<float>(GetWidth());
+	const float height = static_cast<float>(GetHeight());
+
+	float sx[3], sy[3];
+	float zMax = 0.0f;
+	for (int v = 0; v < 3; ++v)
+	{
+		const float w = clip[v][3];
+		if (w <= 1e-5f || clip[v][2] < 0.0f)
+			return;
+
+		const float invW = 1.0f / w;
+		sx[v] = (clip[v][0] * invW * 0.5f + 0.5f) * width;
+		sy[v] = (0.5f - clip[v][1] * invW * 0.5f) * height;
+		zMax = std::max(zMax, clip[v][2] * invW);
+	}
+	zMax = std::min(zMax, 1.0f);
+
+	// Orient the edges so that the inside is where all three are non-negative.
+	float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+	if (std::fabs(area) < 1e-8f)
+		return;
+	const float orientation = (area > 0.0f) ? 1.0f : -1.0f;
+
+	float edgeA[3], edgeB[3], edgeC[3];
+	for (int e = 0; e < 3; ++e)
+	{
+		const int a = e;
+		const int b = (e + 1) % 3;
+		// E(x, y) = A * x + B * y + C
+		edgeA[e] = -(sy[b] - sy[a]) * orientation;
+		edgeB[e] = (sx[b] - sx[a]) * orientation;
+		edgeC[e] = ((sy[b] - sy[a]) * sx[a] - (sx[b] - sx[a]) * sy[a]) * orientation;
+	}
+
+	const float minX = std::max(std::min(std::min(sx[0], sx[1]), sx[2]), 0.0f);
+	const float maxX = std::min(std::max(std::max(sx[0], sx[1]), sx[2]), width - 1.0f);
+	const float minY = std::max(std::min(std::min(sy[0], sy[1]), sy[2]), 0.0f);
+	const float maxY = std::min(std::max(std::max(sy[0], sy[1]), sy[2]), height - 1.0f);
+	if (minX > maxX || minY > maxY)
+		return;
+
+	const uint32_t tileMinX = static_cast<uint32_t>(minX) / TileWidth;
+	const uint32_t tileMaxX = static_cast<uint32_t>(maxX) / TileWidth;
+	const uint32_t tileMinY = static_cast<uint32_t>(minY) / TileHeight;
+	const uint32_t tileMaxY = static_cast<uint32_t>(maxY) / TileHeight;
+
+	for (uint32_t ty = tileMinY; ty <= tileMaxY; ++ty)
+	{
+		for (uint32_t tx = tileMinX; tx <= tileMaxX; ++tx)
+		{
+			Tile& tile = m_tiles[static_cast<size_t>(ty) * m_tilesX + tx];
+			if (zMax >= tile.zMax0)
+				continue;
+
+			// Coverage at pixel centres, one bit per pixel, row by row.
+			uint32_t coverage = 0;
+			for (uint32_t py = 0; py < TileHeight; ++py)
+			{
+				const float y = static_cast<float>(ty * TileHeight + py) + 0.5f;
+				for (uint32_t px = 0; px < TileWidth; ++px)
+				{
+					const float x = static_cast<float>(tx * TileWidth + px) + 0.5f;
+					bool inside = true;
+					for (int e = 0; e < 3; ++e)
+					{
+						inside &= edgeA[e] * x + edgeB[e] * y + edgeC[e] >= 0.0f;
+					}
+					coverage |= (inside ? 1u : 0u) << (py * TileWidth + px);
+				}
+			}
+
+			if (coverage)
+				UpdateTile(tile, coverage, zMax);
+		}
+	}
+}
+
+void OcclusionBuffer::UpdateTile(Tile& tile, uint32_t coverage, float triangleZMax)
+{
+	// If the triangle is much nearer than the working layer, start a new
+	// working layer rather than let the far one drag the merged depth back.
+	const float distanceToWorking = tile.zMax1 - triangleZMax;
+	const float distanceBetweenLayers = tile.zMax0 - tile.zMax1;
+	if (distanceToWorking > distanceBetweenLayers)
+	{
+		tile.zMax1 = 0.0f;
+		tile.mask = 0;
+	}
+
+	tile.zMax1 = std::max(tile.zMax1, triangleZMax);
+	tile.mask |= coverage;
+
+	// A full mask means every pixel has an occluder no farther than zMax1.
+	if (tile.mask == 0xffffffff)
+	{
+		tile.zMax0 = tile.zMax1;
+		tile.zMax1 = 0.0f;
+		tile.mask = 0;
+	}
+}
+
+bool OcclusionBuffer::IsSphereVisible(float x, float y, float z, float radius) const
+{
+	const float width = static_cast<float>(GetWidth());
+	const float height = static_cast<float>(GetHeight());
+
+	// Project the cube around the sphere. Its nearest point is a corner, and its
+	// screen footprint is the box around the projected corners.
+	float minX = width, maxX = 0.0f, minY = height, maxY = 0.0f;
+	float zMin = 1.0f;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		float clip[4];
+		TransformPoint(m_viewProj,
+			x + ((corner & 1) ? radius : -radius),
+			y + ((corner & 2) ? radius : -radius),
+			z + ((corner & 4) ? radius : -radius), clip);
+
+		if (clip[3] <= 1e-5f || clip[2] < 0.0f)
+			return true;
+
+		const float invW = 1.0f / clip[3];
+		const float screenX = (clip[0] * invW * 0.5f + 0.5f) * width;
+		const float screenY = (0.5f - clip[1] * invW * 0.5f) * height;
+		minX = std::min(minX, screenX);
+		maxX = std::max(maxX, screenX);
+		minY = std::min(minY, screenY);
+		maxY = std::max(maxY, screenY);
+		zMin = std::min(zMin, clip[2] * invW);
+	}
+
+	minX = std::max(minX, 0.0f);
+	maxX = std::min(maxX, width - 1.0f);
+	minY = std::max(minY, 0.0f);
+	maxY = std::min(maxY, height - 1.0f);
+	if (minX > maxX || minY > maxY)
+		return true;	// Off screen; that is for the frustum test to decide.
+
+	const uint32_t tileMinX = static_cast<uint32_t>(minX) / TileWidth;
+	const uint32_t tileMaxX = static_cast<uint32_t>(maxX) / TileWidth;
+	const uint32_t tileMinY = static_cast<uint32_t>(minY) / TileHeight;
+	const uint32_t tileMaxY = static_cast<uint32_t>(maxY) / TileHeight;
+
+	for (uint32_t ty = tileMinY; ty <= tileMaxY; ++ty)
+	{
+		for (uint32_t tx = tileMinX; tx <= tileMaxX; ++tx)
+		{
+			if (zMin <= m_tiles[static_cast<size_t>(ty) * m_tilesX + tx].zMax0)
+				return true;
+		}
+	}
+	return false;
+}
+
+uint32_t OcclusionBuffer::CullSpheres(const float* pX, const float* pY, const float* pZ, const float* pRadius,
+	uint32_t* pIndices, uint32_t count) const
+{
+	uint32_t visibleCount = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint32_t index = pIndices[i];
+		pIndices[visibleCount] = index;
+		visibleCount += IsSphereVisible(pX[index], pY[index], pZ[index], pRadius[index]) ? 1 : 0;
+	}
+	return visibleCount;
+}
+
+uint32_t OcclusionBuffer::GetFullTileCount() const
+{
+	uint32_t count = 0;
+	for (const Tile& tile : m_tiles)
+	{
+		count += (tile.zMax0 < 1.0f) ? 1 : 0;
+	}
+	return count;
+}
@@ -0,0 +1,107 @@
+//*********************************************************
+//
+// Culling.h
+//
+// Visibility tests for the scene's bounding spheres.
+//
+// Frustum culling reads the structure-of-arrays bounds that Scene keeps and
+// tests 4 spheres per instruction with SSE, or 8 with AVX when the CPU has
+// it, against all six planes; a scalar version is kept for reference and
+// for other targets.
+//
+// OcclusionBuffer is a small CPU depth buffer in the style of masked
+// software occlusion culling. The screen is split into 8x4-pixel tiles and
+// each tile stores a 32-bit coverage mask and two depths instead of one
+// depth per pixel: the far depth of the part of the tile that is fully
+// covered, and the far depth of the occluders that have only covered it
+// partly so far. When the mask fills up the two layers merge. Occluder
+// triangles are rasterised into it, then spheres whose nearest depth is
+// behind every tile they touch are rejected.
+//
+// Matrices follow the Scene convention: row-major, row vectors (v * M),
+// with D3D clip depth in [0, w]. Apart from the x86 intrinsics headers
+// these files only use the C++ standard library.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+enum class CullingSimd
+{
+	Scalar,
+	SSE,			// 4 spheres per instruction.
+	AVX,			// 8 spheres per instruction.
+};
+
+// Planes point inwards and are normalised, so a sphere is outside when its
+// centre is more than its radius behind any of them.
+struct CullingFrustum
+{
+	float planes[6][4];
+};
+
+void ExtractFrustumPlanes(const float viewProj[4][4], CullingFrustum& frustum);
+
+// Whether this build and this CPU can run the given instruction set.
+bool IsCullingSimdSupported(CullingSimd simd);
+CullingSimd GetBestCullingSimd();
+
+// Tests spheres [first, first + count) of the bounds arrays and writes the
+// indices of those that touch the frustum to pVisible, which must have room
+// for count entries. Returns the number written. Every instruction set
+// returns the same indices in the same order.
+uint32_t FrustumCullSpheres(const CullingFrustum& frustum,
+	const float* pX, const float* pY, const float* pZ, const float* pRadius,
+	uint32_t first, uint32_t count, uint32_t* pVisible, CullingSimd simd);
+
+class OcclusionBuffer
+{
+public:
+	static const uint32_t TileWidth = 8;
+	static const uint32_t TileHeight = 4;
+
+	OcclusionBuffer();
+
+	// The size is rounded up to whole tiles.
+	void Init(uint32_t width, uint32_t height);
+
+	// Call once per frame with the camera before adding occluders.
+	void Clear(const float viewProj[4][4]);
+
+	// Rasterises indexed world-space triangles (three floats per vertex).
+	// Triangles crossing the near plane are skipped, which only makes the
+	// buffer less complete, never wrong.
+	void RenderOccluder(const float* pVertices, const uint32_t* pIndices, uint32_t triangleCount);
+
+	// True unless the sphere is certainly hidden behind occluders.
+	bool IsSphereVisible(float x, float y, float z, float radius) const;
+
+	// Filters a list of sphere indices in place and returns the survivors.
+	uint32_t CullSpheres(const float* pX, const float* pY, const float* pZ, const float* pRadius,
+		uint32_t* pIndices, uint32_t count) const;
+
+	uint32_t GetWidth() const { return m_tilesX * TileWidth; }
+	uint32_t GetHeight() const { return m_tilesY * TileHeight; }
+
+	// Tiles whose coverage mask has been filled at least once since Clear.
+	uint32_t GetFullTileCount() const;
+
+private:
+	struct Tile
+	{
+		uint32_t mask;		// Pixels covered by the working layer.
+		float zMax0;		// Far depth of the fully covered layer.
+		float zMax1;		// Far depth of the working layer.
+	};
+
+	void RasterizeTriangle(const float* v0, const float* v1, const float* v2);
+	void UpdateTile(Tile& tile, uint32_t coverage, float triangleZMax);
+
+	uint32_t m_tilesX;
+	uint32_t m_tilesY;
+	std::vector<Tile> m_tiles;
+	float m_viewProj[4][4];
+};
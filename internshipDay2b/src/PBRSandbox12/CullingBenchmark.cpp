@@ -0,0 +1,177 @@
+//*********************************************************
+//
+// CullingBenchmark.cpp
+//
+//*********************************************************
+
+#include "CullingBenchmark.h"
+#include "Scene.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t WallCount = 6;
+
+	// Left-handed perspective projection with the camera at the origin looking
+	// down +z, as XMMatrixPerspectiveFovLH with an identity view.
+	void BuildViewProjection(float viewProj[4][4])
+	{
+		const float fovY = 60.0f * 3.14159265f / 180.0f;
+		const float aspect = 16.0f / 9.0f;
+		const float nearZ = 0.1f;
+		const float farZ = 500.0f;
+
+		const float yScale = 1.0f / std::tan(0.5f * fovY);
+		const float range = farZ / (farZ - nearZ);
+
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				viewProj[r][c] = 0.0f;
+			}
+		}
+		viewProj[0][0] = yScale / aspect;
+		viewProj[1][1] = yScale;
+		viewProj[2][2] = range;
+		viewProj[2][3] = 1.0f;
+		viewProj[3][2] = -range * nearZ;
+	}
+
+	// Walls standing across the view at z = 40, with gaps between them.
+	void BuildWalls(std::vector<float>& vertices, std::vector<uint32_t>& indices)
+	{
+		static const uint32_t boxIndices[36] =
+		{
+			0, 1, 2, 2, 1, 3,	4, 6, 5, 5, 6, 7,
+			0, 2, 4, 4, 2, 6,	1, 5, 3, 3, 5, 7,
+			0, 4, 1, 1, 4, 5,	2, 3, 6, 6, 3, 7,
+		};
+
+		for (uint32_t wall = 0; wall < WallCount; ++wall)
+		{
+			const float minCorner[3] = { -30.0f + wall * 10.0f, -15.0f, 40.0f };
+			const float maxCorner[3] = { minCorner[0] + 8.0f, 15.0f, 41.0f };
+
+			const uint32_t baseVertex = static_cast<uint32_t>(vertices.size() / 3);
+			for (int corner = 0; corner < 8; ++corner)
+			{
+				vertices.push_back((corner & 1) ? maxCorner[0] : minCorner[0]);
+				vertices.push_back((corner & 2) ? maxCorner[1] : minCorner[1]);
+				vertices.push_back((corner & 4) ? maxCorner[2] : minCorner[2]);
+			}
+			for (uint32_t index : boxIndices)
+			{
+				indices.push_back(baseVertex + index);
+			}
+		}
+	}
+
+	double ElapsedMilliseconds(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+CullingBenchmarkResult RunCullingBenchmark(uint32_t objectCount, uint32_t iterationCount)
+{
+	if (!objectCount || !iterationCount)
+		throw std::invalid_argument("RunCullingBenchmark: object and iteration counts must be at least 1");
+
+	typedef std::chrono::steady_clock Clock;
+
+	// The objects are scene nodes, so the test reads the same bounds arrays as the sample.
+	Scene scene;
+	{
+		std::mt19937 random(12345);
+		std::uniform_real_distribution<float> spreadX(-150.0f, 150.0f);
+		std::uniform_real_distribution<float> spreadY(-40.0f, 40.0f);
+		std::uniform_real_distribution<float> spreadZ(1.0f, 400.0f);
+		std::uniform_real_distribution<float> spreadRadius(0.5f, 2.0f);
+
+		const SceneFloat3 origin = { 0.0f, 0.0f, 0.0f };
+		for (uint32_t i = 0; i < objectCount; ++i)
+		{
+			const SceneNodeId node = scene.CreateNode(InvalidSceneNode);
+			const SceneFloat3 position = { spreadX(random), spreadY(random), spreadZ(random) };
+			scene.SetLocalPosition(node, position);
+			scene.SetRenderable(node, 0, 0, origin, spreadRadius(random));
+		}
+		scene.Update();
+	}
+
+	float viewProj[4][4];
+	BuildViewProjection(viewProj);
+
+	CullingFrustum frustum;
+	ExtractFrustumPlanes(viewProj, frustum);
+
+	std::vector<float> wallVertices;
+	std::vector<uint32_t> wallIndices;
+	BuildWalls(wallVertices, wallIndices);
+
+	CullingBenchmarkResult result = {};
+	result.objectCount = objectCount;
+	result.occluderTriangles = static_cast<uint32_t>(wallIndices.size() / 3);
+
+	// Frustum culling with each instruction set.
+	std::vector<uint32_t> reference;
+	std::vector<uint32_t> visible(objectCount);
+	const CullingSimd simdModes[3] = { CullingSimd::Scalar, CullingSimd::SSE, CullingSimd::AVX };
+	for (int mode = 0; mode < 3; ++mode)
+	{
+		result.frustumMilliseconds[mode] = -1.0;
+		if (!IsCullingSimdSupported(simdModes[mode]))
+			continue;
+
+		uint32_t visibleCount = 0;
+		for (uint32_t i = 0; i < iterationCount; ++i)
+		{
+			const Clock::time_point start = Clock::now();
+			visibleCount = FrustumCullSpheres(frustum, scene.GetWorldBoundsX(), scene.GetWorldBoundsY(),
+				scene.GetWorldBoundsZ(), scene.GetWorldBoundsRadius(), 0, objectCount, visible.data(), simdModes[mode]);
+			const double milliseconds = ElapsedMilliseconds(start);
+			result.frustumMilliseconds[mode] = i ? std::min(result.frustumMilliseconds[mode], milliseconds) : milliseconds;
+		}
+
+		if (mode == 0)
+		{
+			reference.assign(visible.begin(), visible.begin() + visibleCount);
+			result.frustumVisible = visibleCount;
+		}
+		else if (visibleCount != reference.size() || !std::equal(reference.begin(), reference.end(), visible.begin()))
+		{
+			throw std::runtime_error("RunCullingBenchmark: SIMD frustum culling disagrees with the scalar version");
+		}
+	}
+
+	// Occlusion culling of the frustum survivors.
+	OcclusionBuffer occlusion;
+	occlusion.Init(320, 180);
+	result.tileCount = (occlusion.GetWidth() / OcclusionBuffer::TileWidth) * (occlusion.GetHeight() / OcclusionBuffer::TileHeight);
+
+	for (uint32_t i = 0; i < iterationCount; ++i)
+	{
+		Clock::time_point start = Clock::now();
+		occlusion.Clear(viewProj);
+		occlusion.RenderOccluder(wallVertices.data(), wallIndices.data(), result.occluderTriangles);
+		const double occluderMilliseconds = ElapsedMilliseconds(start);
+
+		std::copy(reference.begin(), reference.end(), visible.begin());
+		start = Clock::now();
+		result.occlusionVisible = occlusion.CullSpheres(scene.GetWorldBoundsX(), scene.GetWorldBoundsY(),
+			scene.GetWorldBoundsZ(), scene.GetWorldBoundsRadius(), visible.data(), result.frustumVisible);
+		const double testMilliseconds = ElapsedMilliseconds(start);
+
+		result.occluderMilliseconds = i ? std::min(result.occluderMilliseconds, occluderMilliseconds) : occluderMilliseconds;
+		result.occlusionTestMilliseconds = i ? std::min(result.occlusionTestMilliseconds, testMilliseconds) : testMilliseconds;
+	}
+	result.fullTiles = occlusion.GetFullTileCount();
+
+	return result;
+}
@@ -0,0 +1,35 @@
+//*********************************************************
+//
+// CullingBenchmark.h
+//
+// Times the culling stage on a synthetic scene: objectCount spheres
+// scattered in front of the camera, with a row of wall occluders part of
+// the way in. Frustum culling is timed for each instruction set the CPU
+// supports, and every one must keep exactly the spheres the scalar version
+// keeps. The survivors then go through the occlusion buffer.
+//
+// Like RenderDevice.h, these files only use the C++ standard library.
+//
+//*********************************************************
+
+#pragma once
+
+#include "Culling.h"
+
+struct CullingBenchmarkResult
+{
+	uint32_t objectCount;
+	uint32_t occluderTriangles;
+
+	// Best time over the iterations, indexed by CullingSimd; negative if unsupported.
+	double frustumMilliseconds[3];
+	uint32_t frustumVisible;
+
+	double occluderMilliseconds;		// Clearing and rasterising the occluders.
+	double occlusionTestMilliseconds;
+	uint32_t occlusionVisible;
+	uint32_t fullTiles;
+	uint32_t tileCount;
+};
+
+CullingBenchmarkResult RunCullingBenchmark(uint32_t objectCount, uint32_t iterationCount);
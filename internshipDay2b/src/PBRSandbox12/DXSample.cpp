@@ -12,13 +12,23 @@
 #include "stdafx.h"
 #include "DXSample.h"
 
+#include <algorithm>
+
 using namespace Microsoft::WRL;
 
 DXSample::DXSample(UINT width, UINT height, std::wstring name) :
 	m_width(width),
 	m_height(height),
 	m_title(name),
-	m_useWarpDevice(false)
+	m_useWarpDevice(false),
+	m_renderBackend(RenderBackend::D3D12),
+	m_headlessFrameCount(1000),
+	m_framesInFlight(2),
+	m_objectCount(1),
+	m_recordingThreads(0),
+	m_runJobBenchmark(false),
+	m_runCullingBenchmark(false),
+	m_coldStart(false)
 {
 	WCHAR assetsPath[512];
 	GetAssetsPath(assetsPath, _countof(assetsPath));
@@ -87,5 +97,50 @@ void DXSample::ParseCommandLineArgs(WCHAR* argv[], int argc)
 			m_useWarpDevice = true;
 			m_title = m_title + L" (WARP)";
 		}
+		else if (_wcsnicmp(argv[i], L"-null", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/null", wcslen(argv[i])) == 0)
+		{
+			m_renderBackend = RenderBackend::Null;
+		}
+		else if (_wcsnicmp(argv[i], L"-software", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/software", wcslen(argv[i])) == 0)
+		{
+			m_renderBackend = RenderBackend::Software;
+		}
+		else if ((_wcsnicmp(argv[i], L"-frames", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/frames", wcslen(argv[i])) == 0) && i + 1 < argc)
+		{
+			m_headlessFrameCount = std::max(_wtoi(argv[++i]), 1);
+		}
+		else if ((_wcsnicmp(argv[i], L"-inflight", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/inflight", wcslen(argv[i])) == 0) && i + 1 < argc)
+		{
+			m_framesInFlight = std::min(std::max(_wtoi(argv[++i]), 1), static_cast<int>(RenderMaxFramesInFlight));
+		}
+		else if ((_wcsnicmp(argv[i], L"-objects", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/objects", wcslen(argv[i])) == 0) && i + 1 < argc)
+		{
+			m_objectCount = std::max(_wtoi(argv[++i]), 1);
+		}
+		else if ((_wcsnicmp(argv[i], L"-threads", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/threads", wcslen(argv[i])) == 0) && i + 1 < argc)
+		{
+			m_recordingThreads = std::min(std::max(_wtoi(argv[++i]), 0), static_cast<int>(RenderMaxWorkerCommandLists));
+		}
+		else if (_wcsnicmp(argv[i], L"-jobbench", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/jobbench", wcslen(argv[i])) == 0)
+		{
+			m_runJobBenchmark = true;
+		}
+		else if (_wcsnicmp(argv[i], L"-cullbench", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/cullbench", wcslen(argv[i])) == 0)
+		{
+			m_runCullingBenchmark = true;
+		}
+		else if (_wcsnicmp(argv[i], L"-coldstart", wcslen(argv[i])) == 0 ||
+			_wcsnicmp(argv[i], L"/coldstart", wcslen(argv[i])) == 0)
+		{
+			m_coldStart = true;
+		}
 	}
 }
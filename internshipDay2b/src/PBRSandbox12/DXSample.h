@@ -12,6 +12,7 @@
 #pragma once
 
 #include "DXSampleHelper.h"
+#include "RenderDevice.h"
 #include "Win32Application.h"
 
 class DXSample
@@ -29,11 +30,30 @@ public:
 	virtual void OnKeyDown(UINT8 /*key*/)   {}
 	virtual void OnKeyUp(UINT8 /*key*/)     {}
 
+	// Called after a headless run to print sample-specific statistics.
+	virtual void OnHeadlessReport()         {}
+
 	// Accessors.
 	UINT GetWidth() const           { return m_width; }
 	UINT GetHeight() const          { return m_height; }
 	const WCHAR* GetTitle() const   { return m_title.c_str(); }
 
+	// Headless runs (-null or -software) have no window and render a fixed number of frames.
+	bool IsHeadless() const         { return m_renderBackend != RenderBackend::D3D12; }
+	UINT GetHeadlessFrameCount() const  { return m_headlessFrameCount; }
+
+	// -jobbench measures job system scaling without creating a device. -threads
+	// caps the worker count; otherwise every hardware thread is tried.
+	bool IsJobBenchmark() const     { return m_runJobBenchmark; }
+	UINT GetRecordingThreads() const    { return m_recordingThreads; }
+
+	// -cullbench times frustum and occlusion culling on -objects spheres.
+	bool IsCullingBenchmark() const { return m_runCullingBenchmark; }
+	UINT GetObjectCount() const     { return m_objectCount; }
+
+	// -coldstart deletes the pipeline cache before the device loads it.
+	bool IsColdStart() const        { return m_coldStart; }
+
 	void ParseCommandLineArgs(_In_reads_(argc) WCHAR* argv[], int argc);
 
 protected:
@@ -49,6 +69,21 @@ protected:
 	// Adapter info.
 	bool m_useWarpDevice;
 
+	// Render backend selection.
+	RenderBackend m_renderBackend;
+	UINT m_headlessFrameCount;
+	UINT m_framesInFlight;
+
+	// Number of objects the sample draws.
+	UINT m_objectCount;
+
+	// Threads recording scene command lists; 0 records everything on the main thread.
+	UINT m_recordingThreads;
+
+	bool m_runJobBenchmark;
+	bool m_runCullingBenchmark;
+	bool m_coldStart;
+
 private:
 	// Root assets path.
 	std::wstring m_assetsPath;
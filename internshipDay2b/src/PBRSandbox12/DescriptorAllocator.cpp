@@ -0,0 +1,221 @@
+//*********************************************************
+//
+// DescriptorAllocator.cpp
+//
+//*********************************************************
+
+#include "DescriptorAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+DescriptorFreeList::DescriptorFreeList() :
+	m_capacity(0),
+	m_used(0),
+	m_peak(0)
+{
+}
+
+void DescriptorFreeList::Init(uint32_t firstSlot, uint32_t count)
+{
+	m_freeBlocks.clear();
+	if (count)
+	{
+		const Block block = { firstSlot, count };
+		m_freeBlocks.push_back(block);
+	}
+
+	m_capacity = count;
+	m_used = 0;
+	m_peak = 0;
+}
+
+bool DescriptorFreeList::Allocate(uint32_t count, uint32_t* pFirstSlot)
+{
+	if (!count)
+		return false;
+
+	for (size_t i = 0; i < m_freeBlocks.size(); ++i)
+	{
+		Block& block = m_freeBlocks[i];
+		if (block.count < count)
+			continue;
+
+		*pFirstSlot = block.firstSlot;
+		block.firstSlot += count;
+		block.count -= count;
+		if (!block.count)
+			m_freeBlocks.erase(m_freeBlocks.begin() + i);
+
+		m_used += count;
+		m_peak = std::max(m_peak, m_used);
+		return true;
+	}
+	return false;
+}
+
+void DescriptorFreeList::Free(uint32_t firstSlot, uint32_t count)
+{
+	if (!count)
+		return;
+
+	// Find the first free block after the one being released.
+	std::vector<Block>::iterator next = m_freeBlocks.begin();
+	while (next != m_freeBlocks.end() && next->firstSlot < firstSlot)
+		++next;
+
+	if (next != m_freeBlocks.end() && firstSlot + count > next->firstSlot)
+		throw std::logic_error("DescriptorFreeList: freeing a block that is already free");
+
+	if (next != m_freeBlocks.begin())
+	{
+		const Block& previous = *(next - 1);
+		if (previous.firstSlot + previous.count > firstSlot)
+			throw std::logic_error("DescriptorFreeList: freeing a block that is already free");
+	}
+
+	m_used -= count;
+
+	// Merge with the neighbours where the ranges touch.
+	const bool mergePrevious = next != m_freeBlocks.begin() && (next - 1)->firstSlot + (next - 1)->count == firstSlot;
+	const bool mergeNext = next != m_freeBlocks.end() && firstSlot + count == next->firstSlot;
+
+	if (mergePrevious && mergeNext)
+	{
+		(next - 1)->count += count + next->count;
+		m_freeBlocks.erase(next);
+	}
+	else if (mergePrevious)
+	{
+		(next - 1)->count += count;
+	}
+	else if (mergeNext)
+	{
+		next->firstSlot = firstSlot;
+		next->count += count;
+	}
+	else
+	{
+		const Block block = { firstSlot, count };
+		m_freeBlocks.insert(next, block);
+	}
+}
+
+//
+DescriptorAllocator::DescriptorAllocator() :
+	m_pDevice(nullptr),
+	m_desc(),
+	m_transientBase(0),
+	m_transientUsed(0),
+	m_transientPeak(0),
+	m_transientAllocations(0)
+{
+}
+
+uint32_t DescriptorAllocator::GetShaderVisibleCount(const DescriptorAllocatorDesc& desc, uint32_t framesInFlight)
+{
+	return desc.persistentCount + desc.transientCountPerFrame * framesInFlight;
+}
+
+void DescriptorAllocator::Init(RenderDevice* pDevice, const DescriptorAllocatorDesc& desc)
+{
+	if (!pDevice)
+		throw std::invalid_argument("DescriptorAllocator: device is required");
+
+	m_pDevice = pDevice;
+	m_desc = desc;
+
+	m_persistent.Init(0, desc.persistentCount);
+	m_staging.Init(0, desc.stagingCount);
+
+	m_transientBase = desc.persistentCount;
+	m_transientUsed = 0;
+	ResetStats();
+}
+
+uint32_t DescriptorAllocator::AllocatePersistent(uint32_t count)
+{
+	uint32_t firstSlot;
+	if (!m_persistent.Allocate(count, &firstSlot))
+		throw std::runtime_error("DescriptorAllocator: persistent region exhausted");
+	return firstSlot;
+}
+
+void DescriptorAllocator::FreePersistent(uint32_t firstSlot, uint32_t count)
+{
+	m_persistent.Free(firstSlot, count);
+}
+
+uint32_t DescriptorAllocator::AllocateStaging(uint32_t count)
+{
+	uint32_t firstSlot;
+	if (!m_staging.Allocate(count, &firstSlot))
+		throw std::runtime_error("DescriptorAllocator: staging heap exhausted");
+	return firstSlot;
+}
+
+void DescriptorAllocator::FreeStaging(uint32_t firstSlot, uint32_t count)
+{
+	m_staging.Free(firstSlot, count);
+}
+
+void DescriptorAllocator::BeginFrame()
+{
+	m_transientBase = m_desc.persistentCount + m_pDevice->GetFrameIndex() * m_desc.transientCountPerFrame;
+	m_transientUsed = 0;
+}
+
+uint32_t DescriptorAllocator::AllocateTransient(uint32_t count)
+{
+	if (!count || m_transientUsed + count > m_desc.transientCountPerFrame)
+		throw std::runtime_error("DescriptorAllocator: transient region exhausted");
+
+	const uint32_t firstSlot = m_transientBase + m_transientUsed;
+	m_transientUsed += count;
+
+	++m_transientAllocations;
+	m_transientPeak = std::max(m_transientPeak, m_transientUsed);
+	return firstSlot;
+}
+
+uint32_t DescriptorAllocator::CopyToTransient(uint32_t firstStagingSlot, uint32_t count)
+{
+	const uint32_t firstSlot = AllocateTransient(count);
+	m_pDevice->CopyDescriptors(firstSlot, firstStagingSlot, count);
+	return firstSlot;
+}
+
+uint32_t DescriptorAllocator::CopyToTransient(const uint32_t* pStagingSlots, uint32_t count)
+{
+	const uint32_t firstSlot = AllocateTransient(count);
+
+	uint32_t runStart = 0;
+	for (uint32_t i = 1; i <= count; ++i)
+	{
+		if (i == count || pStagingSlots[i] != pStagingSlots[i - 1] + 1)
+		{
+			m_pDevice->CopyDescriptors(firstSlot + runStart, pStagingSlots[runStart], i - runStart);
+			runStart = i;
+		}
+	}
+	return firstSlot;
+}
+
+DescriptorAllocatorStats DescriptorAllocator::GetStats() const
+{
+	DescriptorAllocatorStats stats;
+	stats.persistentUsed = m_persistent.GetUsed();
+	stats.persistentPeak = m_persistent.GetPeak();
+	stats.stagingUsed = m_staging.GetUsed();
+	stats.stagingPeak = m_staging.GetPeak();
+	stats.transientUsed = m_transientUsed;
+	stats.transientPeak = m_transientPeak;
+	stats.transientAllocations = m_transientAllocations;
+	return stats;
+}
+
+void DescriptorAllocator::ResetStats()
+{
+	m_transientPeak = 0;
+	m_transientAllocations = 0;
+}
@@ -0,0 +1,117 @@
+//*********************************************************
+//
+// DescriptorAllocator.h
+//
+// Hands out descriptor slots for a RenderDevice. The shader-visible heap is
+// split into a persistent region, managed by a free list, for views that
+// live as long as their resource, followed by one linear region per frame
+// in flight for transient tables. A CPU-only staging heap, also managed by
+// a free list, holds views that are copied into transient tables each frame.
+//
+// Like RenderDevice.h, these files only use the C++ standard library.
+//
+//*********************************************************
+
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <vector>
+
+// First-fit allocator over a range of descriptor slots. Freed blocks are
+// coalesced with their neighbours so tables stay contiguous.
+class DescriptorFreeList
+{
+public:
+	DescriptorFreeList();
+
+	void Init(uint32_t firstSlot, uint32_t count);
+
+	// Returns false when no free block is large enough.
+	bool Allocate(uint32_t count, uint32_t* pFirstSlot);
+	void Free(uint32_t firstSlot, uint32_t count);
+
+	uint32_t GetCapacity() const { return m_capacity; }
+	uint32_t GetUsed() const { return m_used; }
+	uint32_t GetPeak() const { return m_peak; }
+	size_t GetFreeBlockCount() const { return m_freeBlocks.size(); }
+
+private:
+	struct Block
+	{
+		uint32_t firstSlot;
+		uint32_t count;
+	};
+
+	std::vector<Block> m_freeBlocks;	// Sorted by firstSlot.
+	uint32_t m_capacity;
+	uint32_t m_used;
+	uint32_t m_peak;
+};
+
+struct DescriptorAllocatorDesc
+{
+	uint32_t persistentCount;
+	uint32_t transientCountPerFrame;
+	uint32_t stagingCount;
+};
+
+// Occupancy counters. The transient peak and allocation count accumulate
+// until ResetStats; the persistent and staging peaks cover the whole run.
+struct DescriptorAllocatorStats
+{
+	uint32_t persistentUsed;
+	uint32_t persistentPeak;
+	uint32_t stagingUsed;
+	uint32_t stagingPeak;
+	uint32_t transientUsed;			// In the frame being recorded.
+	uint32_t transientPeak;
+	uint64_t transientAllocations;
+};
+
+class DescriptorAllocator
+{
+public:
+	DescriptorAllocator();
+
+	// Sizes to put in RenderDeviceDesc::descriptorCount and stagingDescriptorCount.
+	static uint32_t GetShaderVisibleCount(const DescriptorAllocatorDesc& desc, uint32_t framesInFlight);
+	static uint32_t GetStagingCount(const DescriptorAllocatorDesc& desc) { return desc.stagingCount; }
+
+	void Init(RenderDevice* pDevice, const DescriptorAllocatorDesc& desc);
+
+	// Persistent shader-visible slots. Allocation failures throw.
+	uint32_t AllocatePersistent(uint32_t count);
+	void FreePersistent(uint32_t firstSlot, uint32_t count);
+
+	// CPU-only staging slots, filled with RenderDevice::CreateStaging*View.
+	uint32_t AllocateStaging(uint32_t count);
+	void FreeStaging(uint32_t firstSlot, uint32_t count);
+
+	// Call once per frame after RenderDevice::BeginFrame. Recycles the transient
+	// region of the frame context being recorded, which the GPU has retired.
+	void BeginFrame();
+
+	// Transient shader-visible slots, valid until the frame context is reused.
+	uint32_t AllocateTransient(uint32_t count);
+
+	// Allocates a transient table and queues copies of the given staging slots
+	// into it. Consecutive staging slots are copied as one range.
+	uint32_t CopyToTransient(uint32_t firstStagingSlot, uint32_t count);
+	uint32_t CopyToTransient(const uint32_t* pStagingSlots, uint32_t count);
+
+	DescriptorAllocatorStats GetStats() const;
+	void ResetStats();
+
+private:
+	RenderDevice* m_pDevice;
+	DescriptorAllocatorDesc m_desc;
+
+	DescriptorFreeList m_persistent;
+	DescriptorFreeList m_staging;
+
+	uint32_t m_transientBase;		// First slot of the current frame's region.
+	uint32_t m_transientUsed;
+	uint32_t m_transientPeak;
+	uint64_t m_transientAllocations;
+};
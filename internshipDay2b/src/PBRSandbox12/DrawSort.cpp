@@ -0,0 +1,255 @@
+//*********************************************************
+//
+// DrawSort.cpp
+//
+//*********************************************************
+
+#include "DrawSort.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t DepthShift = 0;
+	const uint32_t ModelShift = DepthShift + DrawKeyDepthBits;
+	const uint32_t MaterialShift = ModelShift + DrawKeyModelBits;
+	const uint32_t PipelineShift = MaterialShift + DrawKeyMaterialBits;
+	const uint32_t PassShift = PipelineShift + DrawKeyPipelineBits;
+
+	uint64_t PackField(uint32_t value, uint32_t bits, uint32_t shift, const char* message)
+	{
+		if (value >> bits)
+			throw std::out_of_range(message);
+		return static_cast<uint64_t>(value) << shift;
+	}
+
+	uint32_t UnpackField(uint64_t key, uint32_t bits, uint32_t shift)
+	{
+		return static_cast<uint32_t>(key >> shift) & ((1u << bits) - 1);
+	}
+}
+
+uint64_t PackDrawKey(const DrawKeyFields& fields)
+{
+	static_assert(PassShift + DrawKeyPassBits == 64, "draw key fields must fill 64 bits");
+
+	return PackField(fields.pass, DrawKeyPassBits, PassShift, "PackDrawKey: pass does not fit")
+		| PackField(fields.pipeline, DrawKeyPipelineBits, PipelineShift, "PackDrawKey: pipeline does not fit")
+		| PackField(fields.material, DrawKeyMaterialBits, MaterialShift, "PackDrawKey: material does not fit")
+		| PackField(fields.model, DrawKeyModelBits, ModelShift, "PackDrawKey: model does not fit")
+		| PackField(fields.depth, DrawKeyDepthBits, DepthShift, "PackDrawKey: depth does not fit");
+}
+
+DrawKeyFields UnpackDrawKey(uint64_t key)
+{
+	DrawKeyFields fields;
+	fields.pass = UnpackField(key, DrawKeyPassBits, PassShift);
+	fields.pipeline = UnpackField(key, DrawKeyPipelineBits, PipelineShift);
+	fields.material = UnpackField(key, DrawKeyMaterialBits, MaterialShift);
+	fields.model = UnpackField(key, DrawKeyModelBits, ModelShift);
+	fields.depth = UnpackField(key, DrawKeyDepthBits, DepthShift);
+	return fields;
+}
+
+uint32_t QuantizeDrawDepth(float viewDepth)
+{
+	if (!(viewDepth > 0.0f))
+		return 0;
+
+	// Positive floats order the same as their bit patterns; keep the top bits
+	// below the sign, which drops only low mantissa bits.
+	uint32_t bits;
+	memcpy(&bits, &viewDepth, sizeof(bits));
+	return bits >> (31 - DrawKeyDepthBits);
+}
+
+RadixSorter::RadixSorter() :
+	m_count(0),
+	m_partCapacity(0),
+	m_passInput(),
+	m_passActive(),
+	m_result(0)
+{
+}
+
+void RadixSorter::Resize(uint32_t count)
+{
+	m_count = count;
+	for (int buffer = 0; buffer < 2; ++buffer)
+	{
+		m_keys[buffer].resize(count);
+		m_values[buffer].resize(count);
+	}
+}
+
+void RadixSorter::Reserve(uint32_t partCount)
+{
+	if (partCount > m_partCapacity)
+	{
+		m_counts.resize(partCount * PassCount * DigitCount);
+		m_partCapacity = partCount;
+	}
+}
+
+void RadixSorter::Sort()
+{
+	Reserve(1);
+	for (uint32_t pass = 0; pass < PassCount; ++pass)
+	{
+		CountDigits(pass, 0, 1);
+		ComputeOffsets(pass, 1);
+		Scatter(pass, 0, 1);
+	}
+}
+
+TaskGraph::TaskId RadixSorter::AddSortTasks(TaskGraph& graph, TaskGraph::TaskId after, uint32_t partCount)
+{
+	if (!partCount)
+		throw std::invalid_argument("RadixSorter: partCount must be at least 1");
+
+	// The counts are sized here, on the thread building the graph, so the
+	// tasks never reallocate them.
+	Reserve(partCount);
+
+	TaskGraph::TaskId join = after;
+	for (uint32_t pass = 0; pass < PassCount; ++pass)
+	{
+		const TaskGraph::TaskId offsets = graph.AddTask([this, pass, partCount](uint32_t) { ComputeOffsets(pass, partCount); });
+		const TaskGraph::TaskId passDone = graph.AddTask([](uint32_t) {});
+
+		for (uint32_t part = 0; part < partCount; ++part)
+		{
+			const TaskGraph::TaskId count = graph.AddTask([this, pass, part, partCount](uint32_t) { CountDigits(pass, part, partCount); });
+			const TaskGraph::TaskId scatter = graph.AddTask([this, pass, part, partCount](uint32_t) { Scatter(pass, part, partCount); });
+			graph.AddDependency(join, count);
+			graph.AddDependency(count, offsets);
+			graph.AddDependency(offsets, scatter);
+			graph.AddDependency(scatter, passDone);
+		}
+		join = passDone;
+	}
+	return join;
+}
+
+uint32_t RadixSorter::GetSkippedPassCount() const
+{
+	uint32_t skipped = 0;
+	for (uint32_t pass = 0; pass < PassCount; ++pass)
+	{
+		skipped += m_passActive[pass] ? 0 : 1;
+	}
+	return skipped;
+}
+
+void RadixSorter::GetPartRange(uint32_t part, uint32_t partCount, uint32_t* pBegin, uint32_t* pEnd) const
+{
+	*pBegin = static_cast<uint32_t>(static_cast<uint64_t>(m_count) * part / partCount);
+	*pEnd = static_cast<uint32_t>(static_cast<uint64_t>(m_count) * (part + 1) / partCount);
+}
+
+void RadixSorter::CountDigits(uint32_t pass, uint32_t part, uint32_t partCount)
+{
+	if (pass && !m_passActive[pass])
+		return;
+
+	uint32_t begin, end;
+	GetPartRange(part, partCount, &begin, &end);
+
+	const uint64_t* pKeys = m_keys[m_passInput[pass]].data();
+	uint32_t* pCounts = &m_counts[part * PassCount * DigitCount];
+
+	// The first pass counts every digit; the totals do not change as the keys
+	// move, so they tell which passes would leave the order as it is.
+	if (!pass)
+	{
+		memset(pCounts, 0, PassCount * DigitCount * sizeof(uint32_t));
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const uint64_t key = pKeys[i];
+			for (uint32_t digit = 0; digit < PassCount; ++digit)
+			{
+				++pCounts[digit * DigitCount + ((key >> (digit * DigitBits)) & (DigitCount - 1))];
+			}
+		}
+		return;
+	}
+
+	pCounts += pass * DigitCount;
+	memset(pCounts, 0, DigitCount * sizeof(uint32_t));
+	const uint32_t shift = pass * DigitBits;
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		++pCounts[(pKeys[i] >> shift) & (DigitCount - 1)];
+	}
+}
+
+void RadixSorter::ComputeOffsets(uint32_t pass, uint32_t partCount)
+{
+	if (!pass)
+	{
+		// A pass is only needed if its digit differs somewhere. Passes that run
+		// alternate between the two buffers.
+		uint32_t input = 0;
+		for (uint32_t digitPass = 0; digitPass < PassCount; ++digitPass)
+		{
+			bool active = false;
+			for (uint32_t digit = 0; digit < DigitCount && !active; ++digit)
+			{
+				uint32_t total = 0;
+				for (uint32_t part = 0; part < partCount; ++part)
+				{
+					total += m_counts[(part * PassCount + digitPass) * DigitCount + digit];
+				}
+				active = total && total != m_count;
+			}
+
+			m_passInput[digitPass] = static_cast<uint8_t>(input);
+			m_passActive[digitPass] = active;
+			input ^= active ? 1 : 0;
+		}
+		m_result = input;
+	}
+
+	if (!m_passActive[pass])
+		return;
+
+	// Every part's share of a digit follows the share of the part before it,
+	// which keeps the sort stable.
+	uint32_t offset = 0;
+	for (uint32_t digit = 0; digit < DigitCount; ++digit)
+	{
+		for (uint32_t part = 0; part < partCount; ++part)
+		{
+			uint32_t& count = m_counts[(part * PassCount + pass) * DigitCount + digit];
+			const uint32_t digitCount = count;
+			count = offset;
+			offset += digitCount;
+		}
+	}
+}
+
+void RadixSorter::Scatter(uint32_t pass, uint32_t part, uint32_t partCount)
+{
+	if (!m_passActive[pass])
+		return;
+
+	uint32_t begin, end;
+	GetPartRange(part, partCount, &begin, &end);
+
+	const uint32_t input = m_passInput[pass];
+	const uint64_t* pKeys = m_keys[input].data();
+	const uint32_t* pValues = m_values[input].data();
+	uint64_t* pOutKeys = m_keys[input ^ 1].data();
+	uint32_t* pOutValues = m_values[input ^ 1].data();
+
+	uint32_t* pOffsets = &m_counts[(part * PassCount + pass) * DigitCount];
+	const uint32_t shift = pass * DigitBits;
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		const uint64_t key = pKeys[i];
+		const uint32_t destination = pOffsets[(key >> shift) & (DigitCount - 1)]++;
+		pOutKeys[destination] = key;
+		pOutValues[destination] = pValues[i];
+	}
+}
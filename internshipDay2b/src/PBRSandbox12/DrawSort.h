@@ -0,0 +1,115 @@
+//*********************************************************
+//
+// DrawSort.h
+//
+// Draw packets are ordered by a single 64-bit key whose fields, from the
+// most significant bit down, are the state a draw needs in order of how
+// expensive it is to change:
+//
+//   63..60  pass
+//   59..50  pipeline
+//   49..36  material
+//   35..24  model (vertex and index buffers)
+//   23..0   view depth, so each state group draws front to back
+//
+// Sorting the keys as plain integers therefore groups draws by pass, then
+// pipeline, then material, then model.
+//
+// RadixSorter sorts keys with a 32-bit value carried along (usually a scene
+// node id). It is an LSD radix sort over 8-bit digits; a digit that is the
+// same in every key is skipped, so fields the scene leaves at zero cost
+// nothing. Each pass can be split across jobs: the parts count their
+// digits, one task turns the counts into offsets, and the parts scatter
+// into the other buffer. The sort is stable.
+//
+// Like RenderDevice.h, these files only use the C++ standard library.
+//
+//*********************************************************
+
+#pragma once
+
+#include "JobSystem.h"
+
+#include <cstdint>
+#include <vector>
+
+static const uint32_t DrawKeyPassBits = 4;
+static const uint32_t DrawKeyPipelineBits = 10;
+static const uint32_t DrawKeyMaterialBits = 14;
+static const uint32_t DrawKeyModelBits = 12;
+static const uint32_t DrawKeyDepthBits = 24;
+
+struct DrawKeyFields
+{
+	uint32_t pass;
+	uint32_t pipeline;
+	uint32_t material;
+	uint32_t model;
+	uint32_t depth;			// From QuantizeDrawDepth.
+};
+
+// Throws std::out_of_range if a field does not fit.
+uint64_t PackDrawKey(const DrawKeyFields& fields);
+DrawKeyFields UnpackDrawKey(uint64_t key);
+
+// Maps a view-space depth to DrawKeyDepthBits bits that sort in the same
+// order. Depths at or behind the camera map to 0.
+uint32_t QuantizeDrawDepth(float viewDepth);
+
+// Everything but the depth: two draws with the same state key can share
+// every binding.
+inline uint64_t GetDrawStateKey(uint64_t key) { return key >> DrawKeyDepthBits; }
+
+class RadixSorter
+{
+public:
+	static const uint32_t DigitBits = 8;
+	static const uint32_t DigitCount = 1 << DigitBits;
+	static const uint32_t PassCount = 64 / DigitBits;
+
+	RadixSorter();
+
+	// Makes room for count pairs. Write them to GetKeys and GetValues, then
+	// sort with Sort or by running the tasks from AddSortTasks.
+	void Resize(uint32_t count);
+	uint64_t* GetKeys() { return m_keys[0].data(); }
+	uint32_t* GetValues() { return m_values[0].data(); }
+
+	// Sorts on the calling thread.
+	void Sort();
+
+	// Adds tasks that sort whatever the input holds when they run, split into
+	// partCount parts per pass. They start after the given task, which should
+	// be the one that writes the input. Returns a task that finishes after the
+	// sort. The sorter must not be used by Sort while the graph runs.
+	TaskGraph::TaskId AddSortTasks(TaskGraph& graph, TaskGraph::TaskId after, uint32_t partCount);
+
+	uint32_t GetCount() const { return m_count; }
+	const uint64_t* GetSortedKeys() const { return m_keys[m_result].data(); }
+	const uint32_t* GetSortedValues() const { return m_values[m_result].data(); }
+
+	// Passes the last sort skipped because every key had the same digit.
+	uint32_t GetSkippedPassCount() const;
+
+private:
+	void GetPartRange(uint32_t part, uint32_t partCount, uint32_t* pBegin, uint32_t* pEnd) const;
+	void CountDigits(uint32_t pass, uint32_t part, uint32_t partCount);
+	void ComputeOffsets(uint32_t pass, uint32_t partCount);
+	void Scatter(uint32_t pass, uint32_t part, uint32_t partCount);
+	void Reserve(uint32_t partCount);
+
+	uint32_t m_count;
+	std::vector<uint64_t> m_keys[2];
+	std::vector<uint32_t> m_values[2];
+
+	// Digit counts, then offsets, per part: [part][pass][digit]. The first
+	// pass counts every digit at once to find the passes it can skip.
+	std::vector<uint32_t> m_counts;
+	uint32_t m_partCapacity;
+
+	// Which buffer each pass reads, and whether it runs. Set by the first
+	// pass's offset task.
+	uint8_t m_passInput[PassCount];
+	bool m_passActive[PassCount];
+	uint32_t m_result;
+};
@@ -0,0 +1,172 @@
+//*********************************************************
+//
+// JobBenchmark.cpp
+//
+//*********************************************************
+
+#include "JobBenchmark.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace
+{
+	const uint32_t StageCount = 3;
+	const uint32_t TasksPerStage = 64;
+	const uint32_t VectorsPerTask = 1024;
+	const uint32_t RotationsPerVector = 4;
+
+	struct Vector4
+	{
+		float x, y, z, w;
+	};
+
+	// One block of vectors per task; stage s reads stage s - 1.
+	struct BenchmarkData
+	{
+		std::vector<Vector4> blocks[StageCount + 1];
+
+		Vector4* GetBlock(uint32_t stage, uint32_t task)
+		{
+			return &blocks[stage][static_cast<size_t>(task) * VectorsPerTask];
+		}
+	};
+
+	void RunBenchmarkTask(BenchmarkData& data, uint32_t stage, uint32_t task)
+	{
+		// Average the block and its neighbours from the previous stage, then spin
+		// each vector through a few rotations to give the task some arithmetic.
+		const Vector4* pLeft = data.GetBlock(stage, task ? task - 1 : task);
+		const Vector4* pCenter = data.GetBlock(stage, task);
+		const Vector4* pRight = data.GetBlock(stage, std::min(task + 1, TasksPerStage - 1));
+		Vector4* pOut = data.GetBlock(stage + 1, task);
+
+		const float c = 0.9950042f;	// cos(0.1)
+		const float s = 0.0998334f;	// sin(0.1)
+		for (uint32_t i = 0; i < VectorsPerTask; ++i)
+		{
+			Vector4 v;
+			v.x = (pLeft[i].x + pCenter[i].x + pRight[i].x) * (1.0f / 3.0f);
+			v.y = (pLeft[i].y + pCenter[i].y + pRight[i].y) * (1.0f / 3.0f);
+			v.z = (pLeft[i].z + pCenter[i].z + pRight[i].z) * (1.0f / 3.0f);
+			v.w = (pLeft[i].w + pCenter[i].w + pRight[i].w) * (1.0f / 3.0f);
+
+			for (uint32_t r = 0; r < RotationsPerVector; ++r)
+			{
+				const float x = c * v.x - s * v.z;
+				const float z = s * v.x + c * v.z;
+				const float y = c * v.y - s * v.w;
+				const float w = s * v.y + c * v.w;
+				v.x = x; v.y = y; v.z = z; v.w = w;
+			}
+			pOut[i] = v;
+		}
+	}
+
+	void ResetBenchmarkData(BenchmarkData& data)
+	{
+		for (uint32_t stage = 0; stage <= StageCount; ++stage)
+		{
+			data.blocks[stage].assign(static_cast<size_t>(TasksPerStage) * VectorsPerTask, Vector4());
+		}
+
+		std::vector<Vector4>& input = data.blocks[0];
+		for (size_t i = 0; i < input.size(); ++i)
+		{
+			const float f = static_cast<float>(i % 97);
+			input[i].x = f;
+			input[i].y = 1.0f - f;
+			input[i].z = 0.5f * f;
+			input[i].w = 1.0f;
+		}
+	}
+
+	double ComputeChecksum(const BenchmarkData& data)
+	{
+		double sum = 0.0;
+		for (const Vector4& v : data.blocks[StageCount])
+		{
+			sum += v.x + v.y + v.z + v.w;
+		}
+		return sum;
+	}
+
+	void BuildBenchmarkGraph(TaskGraph& graph, BenchmarkData& data)
+	{
+		for (uint32_t stage = 0; stage < StageCount; ++stage)
+		{
+			for (uint32_t task = 0; task < TasksPerStage; ++task)
+			{
+				BenchmarkData* pData = &data;
+				const TaskGraph::TaskId id = graph.AddTask([pData, stage, task](uint32_t)
+				{
+					RunBenchmarkTask(*pData, stage, task);
+				});
+
+				if (stage)
+				{
+					const TaskGraph::TaskId previous = id - TasksPerStage;
+					if (task)
+						graph.AddDependency(previous - 1, id);
+					graph.AddDependency(previous, id);
+					if (task + 1 < TasksPerStage)
+						graph.AddDependency(previous + 1, id);
+				}
+			}
+		}
+	}
+}
+
+std::vector<JobBenchmarkResult> RunJobBenchmark(uint32_t maxWorkerCount, uint32_t iterationCount)
+{
+	if (!maxWorkerCount || !iterationCount)
+		throw std::invalid_argument("RunJobBenchmark: worker and iteration counts must be at least 1");
+
+	typedef std::chrono::steady_clock Clock;
+
+	BenchmarkData data;
+	TaskGraph graph;
+	BuildBenchmarkGraph(graph, data);
+
+	std::vector<JobBenchmarkResult> results;
+	for (uint32_t workerCount = 1; workerCount <= maxWorkerCount; ++workerCount)
+	{
+		JobSystem jobSystem(workerCount);
+		ResetBenchmarkData(data);
+
+		// One untimed run to wake the threads and fault in the buffers.
+		jobSystem.Run(graph);
+		jobSystem.ResetStats();
+
+		double total = 0.0;
+		double fastest = 0.0;
+		for (uint32_t i = 0; i < iterationCount; ++i)
+		{
+			const Clock::time_point start = Clock::now();
+			jobSystem.Run(graph);
+			const double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+			total += milliseconds;
+			fastest = i ? std::min(fastest, milliseconds) : milliseconds;
+		}
+
+		JobBenchmarkResult result = {};
+		result.workerCount = workerCount;
+		result.averageMilliseconds = total / iterationCount;
+		result.minMilliseconds = fastest;
+		result.speedup = results.empty() ? 1.0 : results.front().averageMilliseconds / result.averageMilliseconds;
+		result.checksum = ComputeChecksum(data);
+		for (uint32_t worker = 0; worker < workerCount; ++worker)
+		{
+			result.steals += jobSystem.GetWorkerStats(worker).steals;
+		}
+
+		if (!results.empty() && result.checksum != results.front().checksum)
+			throw std::runtime_error("RunJobBenchmark: result differs from the single-worker run");
+
+		results.push_back(result);
+	}
+	return results;
+}
@@ -0,0 +1,32 @@
+//*********************************************************
+//
+// JobBenchmark.h
+//
+// Measures how a frame-shaped task graph scales across worker counts. The
+// graph has three stages standing in for update, culling and recording;
+// each task transforms its own block of vectors, and a task in one stage
+// depends on its neighbours in the stage before it. Every worker count must
+// produce the same checksum, so the benchmark doubles as a correctness test.
+//
+// Like RenderDevice.h, these files only use the C++ standard library.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct JobBenchmarkResult
+{
+	uint32_t workerCount;
+	double averageMilliseconds;		// Per graph run.
+	double minMilliseconds;
+	double speedup;					// Relative to one worker.
+	uint64_t steals;
+	double checksum;
+};
+
+// Runs the graph iterationCount times for 1..maxWorkerCount workers. Throws
+// std::runtime_error if any worker count disagrees with the one-worker result.
+std::vector<JobBenchmarkResult> RunJobBenchmark(uint32_t maxWorkerCount, uint32_t iterationCount);
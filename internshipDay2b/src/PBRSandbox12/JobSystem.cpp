@@ -0,0 +1,284 @@
+//*********************************************************
+//
+// JobSystem.cpp
+//
+//*********************************************************
+
+#include "JobSystem.h"
+
+#include <chrono>
+#include <stdexcept>
+
+TaskGraph::TaskId TaskGraph::AddTask(const TaskFunction& function)
+{
+	if (!function)
+		throw std::invalid_argument("TaskGraph: task function is empty");
+
+	Task task;
+	task.function = function;
+	task.dependencyCount = 0;
+	m_tasks.push_back(task);
+	return static_cast<TaskId>(m_tasks.size() - 1);
+}
+
+void TaskGraph::AddDependency(TaskId before, TaskId after)
+{
+	if (before >= m_tasks.size() || after >= m_tasks.size() || before == after)
+		throw std::invalid_argument("TaskGraph: invalid dependency");
+
+	m_tasks[before].successors.push_back(after);
+	++m_tasks[after].dependencyCount;
+}
+
+//
+JobSystem::JobSystem(uint32_t workerCount) :
+	m_generation(0),
+	m_pendingWorkers(0),
+	m_quit(false),
+	m_graph(nullptr),
+	m_dependencyCapacity(0),
+	m_remainingTasks(0),
+	m_cancelled(false)
+{
+	if (!workerCount)
+		throw std::invalid_argument("JobSystem: workerCount must be at least 1");
+
+	m_stats.resize(workerCount, WorkerStats());
+	m_queues.reset(new WorkerQueue[workerCount]);
+
+	m_threads.reserve(workerCount - 1);
+	for (uint32_t i = 1; i < workerCount; ++i)
+	{
+		m_threads.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+void JobSystem::Run(const TaskGraph& graph)
+{
+	const uint32_t taskCount = graph.GetTaskCount();
+	if (!taskCount)
+		return;
+
+	if (taskCount > m_dependencyCapacity)
+	{
+		m_dependencyCounts.reset(new std::atomic<uint32_t>[taskCount]);
+		m_dependencyCapacity = taskCount;
+	}
+
+	// Reject cycles up front; otherwise the workers would spin forever waiting
+	// for tasks that can never become ready.
+	{
+		std::vector<uint32_t> counts(taskCount);
+		std::vector<TaskGraph::TaskId> ready;
+		for (uint32_t i = 0; i < taskCount; ++i)
+		{
+			counts[i] = graph.m_tasks[i].dependencyCount;
+			if (!counts[i])
+				ready.push_back(i);
+		}
+
+		uint32_t visited = 0;
+		while (!ready.empty())
+		{
+			const TaskGraph::TaskId task = ready.back();
+			ready.pop_back();
+			++visited;
+
+			for (TaskGraph::TaskId successor : graph.m_tasks[task].successors)
+			{
+				if (!--counts[successor])
+					ready.push_back(successor);
+			}
+		}
+
+		if (visited != taskCount)
+			throw std::logic_error("TaskGraph: dependency cycle");
+	}
+
+	// Deal the initially ready tasks out round-robin; stealing evens out the rest.
+	const uint32_t workerCount = GetWorkerCount();
+	uint32_t nextWorker = 0;
+	for (uint32_t i = 0; i < taskCount; ++i)
+	{
+		const uint32_t dependencyCount = graph.m_tasks[i].dependencyCount;
+		m_dependencyCounts[i].store(dependencyCount, std::memory_order_relaxed);
+		if (!dependencyCount)
+		{
+			m_queues[nextWorker].tasks.push_back(i);
+			nextWorker = (nextWorker + 1) % workerCount;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_graph = &graph;
+		m_remainingTasks.store(taskCount);
+		m_cancelled.store(false);
+		m_exception = nullptr;
+		m_pendingWorkers = static_cast<uint32_t>(m_threads.size());
+		++m_generation;
+	}
+	m_wakeCondition.notify_all();
+
+	Work(0);
+
+	std::exception_ptr exception;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_doneCondition.wait(lock, [this] { return m_pendingWorkers == 0; });
+		m_graph = nullptr;
+		exception = m_exception;
+	}
+
+	if (exception)
+		std::rethrow_exception(exception);
+}
+
+void JobSystem::Run(uint32_t jobCount, const JobFunction& job)
+{
+	m_jobGraph.Clear();
+	for (uint32_t i = 0; i < jobCount; ++i)
+	{
+		m_jobGraph.AddTask([&job, i](uint32_t workerIndex) { job(i, workerIndex); });
+	}
+
+	Run(m_jobGraph);
+	m_jobGraph.Clear();
+}
+
+void JobSystem::ResetStats()
+{
+	for (WorkerStats& stats : m_stats)
+	{
+		stats = WorkerStats();
+	}
+}
+
+void JobSystem::WorkerMain(uint32_t workerIndex)
+{
+	uint64_t generation = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [&] { return m_quit || m_generation != generation; });
+			if (m_quit)
+				return;
+			generation = m_generation;
+		}
+
+		Work(workerIndex);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_pendingWorkers;
+		}
+		m_doneCondition.notify_one();
+	}
+}
+
+void JobSystem::Work(uint32_t workerIndex)
+{
+	// A worker with nothing to do keeps looking until the whole graph has
+	// finished, since a running task may still release more work.
+	while (m_remainingTasks.load(std::memory_order_acquire))
+	{
+		TaskGraph::TaskId task;
+		if (PopTask(workerIndex, &task) || StealTask(workerIndex, &task))
+		{
+			ExecuteTask(workerIndex, task);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool JobSystem::PopTask(uint32_t workerIndex, TaskGraph::TaskId* pTask)
+{
+	WorkerQueue& queue = m_queues[workerIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty())
+		return false;
+
+	*pTask = queue.tasks.back();
+	queue.tasks.pop_back();
+	return true;
+}
+
+bool JobSystem::StealTask(uint32_t workerIndex, TaskGraph::TaskId* pTask)
+{
+	const uint32_t workerCount = GetWorkerCount();
+	for (uint32_t i = 1; i < workerCount; ++i)
+	{
+		WorkerQueue& victim = m_queues[(workerIndex + i) % workerCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.tasks.empty())
+			continue;
+
+		*pTask = victim.tasks.front();
+		victim.tasks.pop_front();
+		++m_stats[workerIndex].steals;
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::PushTask(uint32_t workerIndex, TaskGraph::TaskId task)
+{
+	WorkerQueue& queue = m_queues[workerIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	queue.tasks.push_back(task);
+}
+
+void JobSystem::ExecuteTask(uint32_t workerIndex, TaskGraph::TaskId task)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	const TaskGraph::Task& graphTask = m_graph->m_tasks[task];
+	WorkerStats& stats = m_stats[workerIndex];
+
+	if (!m_cancelled.load(std::memory_order_relaxed))
+	{
+		const Clock::time_point start = Clock::now();
+		try
+		{
+			graphTask.function(workerIndex);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_exception)
+				m_exception = std::current_exception();
+			m_cancelled.store(true, std::memory_order_relaxed);
+		}
+		stats.busyMicroseconds += static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+		++stats.jobs;
+	}
+
+	// Release the successors before this task stops counting as remaining, so
+	// no worker can see zero while work is still queued.
+	for (TaskGraph::TaskId successor : graphTask.successors)
+	{
+		if (m_dependencyCounts[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+			PushTask(workerIndex, successor);
+	}
+
+	m_remainingTasks.fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,129 @@
+//*********************************************************
+//
+// JobSystem.h
+//
+// Work-stealing job system for the frame loop. Work is described as a
+// TaskGraph: tasks plus "runs after" edges. Each worker owns a queue; it
+// pops its own newest task first and steals the oldest task from another
+// worker when its queue is empty. When a task finishes, any successor whose
+// last dependency it was is pushed straight onto the finishing worker's
+// queue as a continuation, so dependent work tends to stay on the thread
+// whose caches hold its inputs. The calling thread takes part as worker 0.
+//
+// Like RenderDevice.h, these files only use the C++ standard library.
+//
+//*********************************************************
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A set of tasks and the order they must run in. A graph is built on one
+// thread and can be run any number of times; it must outlive the Run call.
+class TaskGraph
+{
+public:
+	typedef uint32_t TaskId;
+
+	// Called with the index of the worker running the task.
+	typedef std::function<void(uint32_t workerIndex)> TaskFunction;
+
+	TaskId AddTask(const TaskFunction& function);
+
+	// after does not start until before has finished.
+	void AddDependency(TaskId before, TaskId after);
+
+	void Clear() { m_tasks.clear(); }
+	uint32_t GetTaskCount() const { return static_cast<uint32_t>(m_tasks.size()); }
+
+private:
+	friend class JobSystem;
+
+	struct Task
+	{
+		TaskFunction function;
+		std::vector<TaskId> successors;
+		uint32_t dependencyCount;
+	};
+
+	std::vector<Task> m_tasks;
+};
+
+class JobSystem
+{
+public:
+	// Called once per job with the job index and the index of the worker running it.
+	typedef std::function<void(uint32_t jobIndex, uint32_t workerIndex)> JobFunction;
+
+	struct WorkerStats
+	{
+		uint64_t jobs;
+		uint64_t steals;			// Tasks taken from another worker's queue.
+		uint64_t busyMicroseconds;	// Time spent running tasks.
+	};
+
+	// workerCount includes the calling thread; 1 runs every task inline.
+	explicit JobSystem(uint32_t workerCount);
+	~JobSystem();
+
+	uint32_t GetWorkerCount() const { return static_cast<uint32_t>(m_stats.size()); }
+
+	// Blocks until every task in the graph has run. Throws std::logic_error if
+	// the graph has a cycle. The first exception thrown by a task is rethrown
+	// here; tasks that had not started by then are skipped.
+	void Run(const TaskGraph& graph);
+
+	// Runs jobCount independent jobs, as a graph with no edges.
+	void Run(uint32_t jobCount, const JobFunction& job);
+
+	const WorkerStats& GetWorkerStats(uint32_t workerIndex) const { return m_stats[workerIndex]; }
+	void ResetStats();
+
+private:
+	JobSystem(const JobSystem&);
+	JobSystem& operator=(const JobSystem&);
+
+	struct WorkerQueue
+	{
+		std::mutex mutex;
+		std::deque<TaskGraph::TaskId> tasks;
+	};
+
+	void WorkerMain(uint32_t workerIndex);
+	void Work(uint32_t workerIndex);
+	bool PopTask(uint32_t workerIndex, TaskGraph::TaskId* pTask);
+	bool StealTask(uint32_t workerIndex, TaskGraph::TaskId* pTask);
+	void PushTask(uint32_t workerIndex, TaskGraph::TaskId task);
+	void ExecuteTask(uint32_t workerIndex, TaskGraph::TaskId task);
+
+	std::vector<std::thread> m_threads;
+	std::vector<WorkerStats> m_stats;
+	std::unique_ptr<WorkerQueue[]> m_queues;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	uint64_t m_generation;
+	uint32_t m_pendingWorkers;
+	bool m_quit;
+
+	// The graph being run. Written under the mutex before m_generation changes.
+	const TaskGraph* m_graph;
+	std::unique_ptr<std::atomic<uint32_t>[]> m_dependencyCounts;
+	uint32_t m_dependencyCapacity;
+	std::atomic<uint32_t> m_remainingTasks;
+	std::atomic<bool> m_cancelled;
+	std::exception_ptr m_exception;
+
+	// Reused by Run(jobCount, job).
+	TaskGraph m_jobGraph;
+};
@@ -15,12 +15,21 @@ struct PSInput
 	float2 uv : TEXCOORD;
 };
 
-cbuffer cbVS0 : register(b0)
+// One entry per instance of an instanced draw; 512 entries fill the 64KB
+// constant buffer limit. Must match PBRSandbox12::MaxInstancesPerDraw.
+#define MAX_INSTANCES 512
+
+struct InstanceData
 {
 	float4x4 mWVP;
 	float4x4 mWorld;
 };
 
+cbuffer cbVS0 : register(b0)
+{
+	InstanceData instances[MAX_INSTANCES];
+};
+
 cbuffer cbPS0 : register(b0)
 {
 	float4 baseColor;
@@ -47,13 +56,14 @@ TextureCube PBR_RadianceTexture : register(t10);
 TextureCube PBR_IrradianceTexture : register(t11);
 SamplerState g_sampler : register(s0);
 
-PSInput VSMain(VSInput v)
+PSInput VSMain(VSInput v, uint instanceID : SV_InstanceID)
 {
 	PSInput result;
 
-	result.position = mul( v.position, mWVP);
-	result.position_ws = mul(v.position, mWorld).xyz;
-	result.normal_ws = normalize(mul(v.normal, (float3x3)mWorld));
+	const InstanceData instance = instances[instanceID];
+	result.position = mul( v.position, instance.mWVP);
+	result.position_ws = mul(v.position, instance.mWorld).xyz;
+	result.normal_ws = normalize(mul(v.normal, (float3x3)instance.mWorld));
 	result.uv = v.uv;
 
 	return result;
@@ -1,715 +1,564 @@
-//*********************************************************
-//
-// Copyright (c) Microsoft. All rights reserved.
-// This code is licensed under the MIT License (MIT).
-// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
-// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
-// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
-// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
-//
-//*********************************************************
-
-#include "stdafx.h"
-#include "PBRSandbox12.h"
-
-#include <DirectXTex.h>
-#include "DDSTextureLoader12.h"
-
-// imgui
-#include <imgui.h>
-#include "imgui_impl_win32.h"
-#include "imgui_impl_dx12.h"
-
-PBRSandbox12::PBRSandbox12(UINT width, UINT height, std::wstring name) :
-	DXSample(width, height, name),
-	m_frameIndex(0),
-	m_viewport(0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height)),
-	m_scissorRect(0, 0, static_cast<LONG>(width), static_cast<LONG>(height)),
-	m_rtvDescriptorSize(0)
-{
-}
-
-void PBRSandbox12::OnInit()
-{
-	LoadPipeline();
-	LoadAssets();
-}
-
-// Load the rendering pipeline dependencies.
-void PBRSandbox12::LoadPipeline()
-{
-	UINT dxgiFactoryFlags = 0;
-
-#if defined(_DEBUG)
-	// Enable the debug layer (requires the Graphics Tools "optional feature").
-	// NOTE: Enabling the debug layer after device creation will invalidate the active device.
-	{
-		ComPtr<ID3D12Debug> debugController;
-		if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController))))
-		{
-			debugController->EnableDebugLayer();
-
-			// Enable additional debug layers.
-			dxgiFactoryFlags |= DXGI_CREATE_FACTORY_DEBUG;
-		}
-	}
-#endif
-
-	ComPtr<IDXGIFactory4> factory;
-	ThrowIfFailed(CreateDXGIFactory2(dxgiFactoryFlags, IID_PPV_ARGS(&factory)));
-
-	if (m_useWarpDevice)
-	{
-		ComPtr<IDXGIAdapter> warpAdapter;
-		ThrowIfFailed(factory->EnumWarpAdapter(IID_PPV_ARGS(&warpAdapter)));
-
-		ThrowIfFailed(D3D12CreateDevice(
-			warpAdapter.Get(),
-			D3D_FEATURE_LEVEL_11_0,
-			IID_PPV_ARGS(&m_device)
-			));
-	}
-	else
-	{
-		ComPtr<IDXGIAdapter1> hardwareAdapter;
-		GetHardwareAdapter(factory.Get(), &hardwareAdapter);
-
-		ThrowIfFailed(D3D12CreateDevice(
-			hardwareAdapter.Get(),
-			D3D_FEATURE_LEVEL_11_0,
-			IID_PPV_ARGS(&m_device)
-			));
-	}
-
-	// Describe and create the command queue.
-	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
-	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
-	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
-
-	ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_commandQueue)));
-
-	// Describe and create the swap chain.
-	DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
-	swapChainDesc.BufferCount = FrameCount;
-	swapChainDesc.Width = m_width;
-	swapChainDesc.Height = m_height;
-	swapChainDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-	swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-	swapChainDesc.SampleDesc.Count = 1;
-
-	ComPtr<IDXGISwapChain1> swapChain;
-	ThrowIfFailed(factory->CreateSwapChainForHwnd(
-		m_commandQueue.Get(),		// Swap chain needs the queue so that it can force a flush on it.
-		Win32Application::GetHwnd(),
-		&swapChainDesc,
-		nullptr,
-		nullptr,
-		&swapChain
-		));
-
-	// This sample does not support fullscreen transitions.
-	ThrowIfFailed(factory->MakeWindowAssociation(Win32Application::GetHwnd(), DXGI_MWA_NO_ALT_ENTER));
-
-	ThrowIfFailed(swapChain.As(&m_swapChain));
-	m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
-
-	// Create descriptor heaps.
-	{
-
-		D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-		srvHeapDesc.NumDescriptors = 100;					// A descriptor for each of the 2 intermediate render targets.
-		srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-		srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-		ThrowIfFailed(m_device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&m_srvHeap)));
-
-		m_srvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	}
-
-	{
-		// Describe and create a render target view (RTV) descriptor heap.
-		D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-		rtvHeapDesc.NumDescriptors = FrameCount;
-		rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-		rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-		ThrowIfFailed(m_device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&m_rtvHeap)));
-
-		m_rtvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-
-		// Describe and create a depth stencil target view (DSV) descriptor heap.
-		D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
-		dsvHeapDesc.NumDescriptors = 1;
-		dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-		dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-		ThrowIfFailed(m_device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&m_dsvHeap)));
-	}
-
-	// Create frame resources.
-	{
-		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart());
-
-		// Create a RTV for each frame.
-		for (UINT n = 0; n < FrameCount; n++)
-		{
-			ThrowIfFailed(m_swapChain->GetBuffer(n, IID_PPV_ARGS(&m_renderTargets[n])));
-			m_device->CreateRenderTargetView(m_renderTargets[n].Get(), nullptr, rtvHandle);
-			rtvHandle.Offset(1, m_rtvDescriptorSize);
-		}
-	}
-
-	ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&m_commandAllocator)));
-
-	{
-		// Depth Stencil Target
-		CD3DX12_HEAP_PROPERTIES depthHeapProperties(D3D12_HEAP_TYPE_DEFAULT);
-		DXGI_FORMAT depthBufferFormat = DXGI_FORMAT_D32_FLOAT;
-
-		D3D12_RESOURCE_DESC depthStencilDesc = CD3DX12_RESOURCE_DESC::Tex2D(
-			depthBufferFormat,
-			m_width,
-			m_height,
-			1, 
-			1
-		);
-		depthStencilDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
-
-		D3D12_CLEAR_VALUE depthOptimizedClearValue = {};
-		depthOptimizedClearValue.Format = depthBufferFormat;
-		depthOptimizedClearValue.DepthStencil.Depth = 1.0f;
-		depthOptimizedClearValue.DepthStencil.Stencil = 0;
-
-		ThrowIfFailed(m_device->CreateCommittedResource(
-			&depthHeapProperties,
-			D3D12_HEAP_FLAG_NONE,
-			&depthStencilDesc,
-			D3D12_RESOURCE_STATE_DEPTH_WRITE,
-			&depthOptimizedClearValue,
-			IID_PPV_ARGS(m_depthStencil.ReleaseAndGetAddressOf())
-		));
-
-		m_depthStencil->SetName(L"Depth stencil");
-
-		D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
-		dsvDesc.Format = depthBufferFormat;
-		dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
-
-		m_device->CreateDepthStencilView(m_depthStencil.Get(), &dsvDesc, m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
-	}
-
-	// Imgui Init
-	IMGUI_CHECKVERSION();
-	ImGui::CreateContext();
-	ImGuiIO& io = ImGui::GetIO(); (void)io;
-	//io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;  // Enable Keyboard Controls
-	ImGui_ImplWin32_Init(Win32Application::GetHwnd());
-
-
-	CD3DX12_CPU_DESCRIPTOR_HANDLE imguiCPUHandle(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), IMGUI_HEAP_OFFSET, m_srvDescriptorSize);
-	CD3DX12_GPU_DESCRIPTOR_HANDLE imguiGPUHandle(m_srvHeap->GetGPUDescriptorHandleForHeapStart(), IMGUI_HEAP_OFFSET, m_srvDescriptorSize);
-	if (ImGui_ImplDX12_Init(m_device.Get(), FrameCount, DXGI_FORMAT_R8G8B8A8_UNORM, imguiCPUHandle, imguiGPUHandle))
-	{
-		ImGui::StyleColorsDark();
-
-		ImGui_ImplDX12_InvalidateDeviceObjects();
-		ImGui_ImplDX12_CreateDeviceObjects();
-	}
-}
-
-// Load the sample assets.
-void PBRSandbox12::LoadAssets()
-{
-	// Create an empty root signature.
-	{
-		D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
-
-		// This is the highest version the sample supports. If CheckFeatureSupport succeeds, the HighestVersion returned will not be greater than this.
-		featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
-
-		if (FAILED(m_device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
-		{
-			featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
-		}
-
-		CD3DX12_DESCRIPTOR_RANGE1 ranges[6];
-		CD3DX12_ROOT_PARAMETER1 rootParameters[3];
-
-		ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE);
-		rootParameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_VERTEX);
-
-		ranges[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 2, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE);
-		rootParameters[1].InitAsDescriptorTable(1, &ranges[1], D3D12_SHADER_VISIBILITY_PIXEL);
-
-		ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE);
-		ranges[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE);
-
-		ranges[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 10, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE);
-		ranges[5].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 11, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE);
-		rootParameters[2].InitAsDescriptorTable(4, &ranges[2], D3D12_SHADER_VISIBILITY_PIXEL);
-
-		// Allow input layout and deny uneccessary access to certain pipeline stages.
-		D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
-			D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
-			D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
-			D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
-			D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
-		
-		D3D12_STATIC_SAMPLER_DESC sampler = {};
-		sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
-		sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-		sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-		sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
-		sampler.MipLODBias = 0;
-		sampler.MaxAnisotropy = 0;
-		sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
-		sampler.BorderColor = D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK;
-		sampler.MinLOD = 0.0f;
-		sampler.MaxLOD = D3D12_FLOAT32_MAX;
-		sampler.ShaderRegister = 0;
-		sampler.RegisterSpace = 0;
-		sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
-
-		D3D12_STATIC_SAMPLER_DESC samplers[] = { sampler };
-		CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
-		rootSignatureDesc.Init_1_1(_countof(rootParameters), rootParameters, 1,samplers, rootSignatureFlags);
-
-		ComPtr<ID3DBlob> signature;
-		ComPtr<ID3DBlob> error;
-		ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, featureData.HighestVersion, &signature, &error));
-		ThrowIfFailed(m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&m_rootSignature)));
-	}
-
-	// Create the pipeline state, which includes compiling and loading shaders.
-	{
-		ComPtr<ID3DBlob> vertexShader;
-		ComPtr<ID3DBlob> pixelShader;
-
-#if defined(_DEBUG)
-		// Enable better shader debugging with the graphics debugging tools.
-		UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-		UINT compileFlags = 0;
-#endif
-
-#if 0
-		ThrowIfFailed(D3DCompileFromFile(L"ModelShader.hlsl", nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, nullptr));
-		ThrowIfFailed(D3DCompileFromFile(L"ModelShader.hlsl", nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, nullptr));
-#else
-		HRESULT hr = S_OK;
-		ID3DBlob* errorBlob = nullptr;
-
-		hr = D3DCompileFromFile(L"ModelShader.hlsl", nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, &errorBlob);
-		if (FAILED(hr))
-		{
-			if (errorBlob)
-			{
-				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-				errorBlob->Release();
-			}
-
-			ThrowIfFailed(hr);
-		}
-
-		hr = D3DCompileFromFile(L"ModelShader.hlsl", nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, &errorBlob);
-		if (FAILED(hr))
-		{
-			if (errorBlob)
-			{
-				OutputDebugStringA((char*)errorBlob->GetBufferPointer());
-				errorBlob->Release();
-			}
-
-			ThrowIfFailed(hr);
-		}
-
-#endif
-		D3D12_INPUT_ELEMENT_DESC inputElementDescs[] =
-		{
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 }
-		};
-
-		// Describe and create the graphics pipeline state object (PSO).
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-		psoDesc.InputLayout = { inputElementDescs, _countof(inputElementDescs) };
-		psoDesc.pRootSignature = m_rootSignature.Get();
-		psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
-		psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
-		psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-		psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-		psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
-		psoDesc.SampleMask = UINT_MAX;
-		psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-		psoDesc.NumRenderTargets = 1;
-		psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-		psoDesc.DSVFormat = DXGI_FORMAT_D32_FLOAT;
-		psoDesc.SampleDesc.Count = 1;
-		ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&m_pipelineState)));
-
-	}
-
-	// Create the command list.
-	ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_commandAllocator.Get(), m_pipelineState.Get(), IID_PPV_ARGS(&m_commandList)));
-
-	// Command lists are created in the recording state, but there is nothing
-	// to record yet. The main loop expects it to be closed, so close it now.
-//	ThrowIfFailed(m_commandList->Close());
-
-	m_sphereMesh.Init(m_device.Get(), 64, 64);
-	ThrowIfFailed(m_model.Load("helmet.vbo", m_device.Get()));
-
-	//
-	{
-		ThrowIfFailed(m_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(1024 * 64),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&m_vsConstantBuffer)));
-		NAME_D3D12_OBJECT(m_vsConstantBuffer);
-
-		CD3DX12_CPU_DESCRIPTOR_HANDLE cbCPUHandle(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), SCENE_CONSTANT_BUFFER, m_srvDescriptorSize);
-
-		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-		cbvDesc.BufferLocation = m_vsConstantBuffer->GetGPUVirtualAddress();
-		cbvDesc.SizeInBytes = (sizeof(SceneConstantBuffer) + 255) & ~255;
-		m_device->CreateConstantBufferView(&cbvDesc, cbCPUHandle);
-
-		CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
-		ThrowIfFailed(m_vsConstantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_pVSCbvDataBegin)));
-		memcpy(m_pVSCbvDataBegin, &m_vsConstantBufferData, sizeof(m_vsConstantBufferData));
-	}
-
-	{
-		ThrowIfFailed(m_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(1024 * 64),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&m_psConstantBuffer)));
-		NAME_D3D12_OBJECT(m_psConstantBuffer);
-
-		CD3DX12_CPU_DESCRIPTOR_HANDLE cbCPUHandle(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), MATERIAL_CONSTANT_BUFFER, m_srvDescriptorSize);
-
-		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-		cbvDesc.BufferLocation = m_psConstantBuffer->GetGPUVirtualAddress();
-		cbvDesc.SizeInBytes = (sizeof(PBRParameter) + 255) & ~255;
-		m_device->CreateConstantBufferView(&cbvDesc, cbCPUHandle);
-
-		CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
-		ThrowIfFailed(m_psConstantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_pPSCbvDataBegin)));
-		memcpy(m_pPSCbvDataBegin, &m_psConstatnBufferData, sizeof(m_vsConstantBufferData));
-	}
-
-	{
-		ThrowIfFailed(m_device->CreateCommittedResource(
-			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-			D3D12_HEAP_FLAG_NONE,
-			&CD3DX12_RESOURCE_DESC::Buffer(1024 * 64),
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(&m_psLightConstantBuffer)));
-
-		NAME_D3D12_OBJECT(m_psLightConstantBuffer);
-
-		CD3DX12_CPU_DESCRIPTOR_HANDLE cbCPUHandle(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), LIGHT_CONSTANT_BUFFER, m_srvDescriptorSize);
-
-		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
-		cbvDesc.BufferLocation = m_psLightConstantBuffer->GetGPUVirtualAddress();
-		cbvDesc.SizeInBytes = (sizeof(PBRParameter) + 255) & ~255;
-		m_device->CreateConstantBufferView(&cbvDesc, cbCPUHandle);
-
-		CD3DX12_RANGE readRange(0, 0);        // We do not intend to read from this resource on the CPU.
-		ThrowIfFailed(m_psLightConstantBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_pPLightSCbvDataBegin)));
-		memcpy(m_pPLightSCbvDataBegin, &m_psConstatnBufferData, sizeof(m_vsConstantBufferData));
-	}
-
-	// Create the GPU upload buffer.
-	ID3D12Resource* pResouce = nullptr;
-	ID3D12Resource* textureUploadHeap[4];
-	CD3DX12_CPU_DESCRIPTOR_HANDLE srvHandle;
-
-	srvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), BASE_COLOR, m_srvDescriptorSize);
-	LoadTexture(L"Default_albedo.dds", srvHandle, m_commandList.Get(), &pResouce, &textureUploadHeap[0]);
-	m_baseColorTexture.Attach(pResouce);
-	NAME_D3D12_OBJECT(m_baseColorTexture);
-
-	srvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), METALLIC_ROUGHNESS, m_srvDescriptorSize);
-	LoadTexture(L"Default_metalRoughness.dds", srvHandle, m_commandList.Get(), &pResouce, &textureUploadHeap[1]);
-	m_metallicRoughnessTexture.Attach(pResouce);
-	NAME_D3D12_OBJECT(m_metallicRoughnessTexture);
-
-
-	srvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), CUBEMAP_RADDIANCE, m_srvDescriptorSize);
-	LoadCubeTexture(L"Stonewall_Ref_radiance.dds", srvHandle, m_commandList.Get(), &pResouce, &textureUploadHeap[2]);
-	m_radianceCube.Attach(pResouce);
-	NAME_D3D12_OBJECT(m_radianceCube);
-
-	srvHandle = CD3DX12_CPU_DESCRIPTOR_HANDLE(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), CUBEMAP_IRRADIANCE, m_srvDescriptorSize);
-	LoadCubeTexture(L"Stonewall_Ref_irradiance.dds", srvHandle, m_commandList.Get(), &pResouce, &textureUploadHeap[3]);
-	m_irradianceCube.Attach(pResouce);
-	NAME_D3D12_OBJECT(m_irradianceCube);
-
-	ThrowIfFailed(m_commandList->Close());
-	ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
-	m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-
-	// Create synchronization objects and wait until assets have been uploaded to the GPU.
-	{
-		ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
-		m_fenceValue = 1;
-
-		// Create an event handle to use for frame synchronization.
-		m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-		if (m_fenceEvent == nullptr)
-		{
-			ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
-		}
-
-		// Wait for the command list to execute; we are reusing the same command 
-		// list in our main loop but for now, we just want to wait for setup to 
-		// complete before continuing.
-		WaitForPreviousFrame();
-	}
-
-	for (size_t i = 0; i < _countof(textureUploadHeap); i++)
-	{
-		textureUploadHeap[i]->Release();
-	}
-}
-
-
-void PBRSandbox12::LoadTexture(wchar_t* filename, D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle, ID3D12GraphicsCommandList* pCommandList, ID3D12Resource** texture, ID3D12Resource** textureUploadHeap)
-{
-	// Load texture from DDS.
-	std::unique_ptr<uint8_t[]> ddsData;
-	std::vector<D3D12_SUBRESOURCE_DATA> subresouceData;
-	ThrowIfFailed(LoadDDSTextureFromFile(m_device.Get(), filename, texture, ddsData, subresouceData));
-	D3D12_RESOURCE_DESC textureDesc = (*texture)->GetDesc();
-
-	CD3DX12_HEAP_PROPERTIES heapProperty;
-	D3D12_HEAP_FLAGS flags;
-
-	(*texture)->GetHeapProperties(&heapProperty, &flags);
-	const UINT subresoucesize
-		= static_cast<UINT>(subresouceData.size());
-	const UINT64 uploadBufferSize
-		= GetRequiredIntermediateSize(*texture, 0, subresoucesize);
-
-	ThrowIfFailed(m_device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize), D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(textureUploadHeap)));
-
-	UpdateSubresources(m_commandList.Get(), *texture, *textureUploadHeap, 0, 0, subresoucesize, &subresouceData[0]);
-	pCommandList->ResourceBarrier(1,
-		&CD3DX12_RESOURCE_BARRIER::Transition(*texture,
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-
-	// Describe and create a SRV for the texture.
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = textureDesc.Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = textureDesc.MipLevels;
-	m_device->CreateShaderResourceView(*texture,
-		&srvDesc,
-		cpuHandle);
-}
-
-
-void PBRSandbox12::LoadCubeTexture(wchar_t* filename, D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle, ID3D12GraphicsCommandList* pCommandList, ID3D12Resource** texture, ID3D12Resource** textureUploadHeap)
-{
-	bool isCubeMap = true;
-	std::unique_ptr<uint8_t[]> ddsData;
-	std::vector<D3D12_SUBRESOURCE_DATA> subresouceData;
-	ThrowIfFailed(LoadDDSTextureFromFile(m_device.Get(), filename, texture, ddsData, subresouceData, 0Ui64, nullptr, &isCubeMap));
-	D3D12_RESOURCE_DESC textureDesc = (*texture)->GetDesc();
-
-	CD3DX12_HEAP_PROPERTIES heapProperty;
-	D3D12_HEAP_FLAGS flags;
-
-	(*texture)->GetHeapProperties(&heapProperty, &flags);
-	const UINT subresoucesize
-		= static_cast<UINT>(subresouceData.size());
-	const UINT64 uploadBufferSize
-		= GetRequiredIntermediateSize(*texture, 0, subresoucesize);
-
-	ThrowIfFailed(m_device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize), D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(textureUploadHeap)));
-
-	UpdateSubresources(m_commandList.Get(), *texture, *textureUploadHeap, 0, 0, subresoucesize, &subresouceData[0]);
-	pCommandList->ResourceBarrier(1,
-		&CD3DX12_RESOURCE_BARRIER::Transition(*texture,
-			D3D12_RESOURCE_STATE_COPY_DEST,
-			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
-
-	// Describe and create a SRV for the texture.
-	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.Format = textureDesc.Format;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
-	srvDesc.TextureCube.MipLevels = textureDesc.MipLevels;
-	srvDesc.TextureCube.MostDetailedMip = 0;
-	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
-	m_device->CreateShaderResourceView(*texture,
-		&srvDesc,
-		cpuHandle);
-}
-
-// Update frame-based values.
-void PBRSandbox12::OnUpdate()
-{
-	static float fY = 0.0f;
-
-	// Initialize the world matrices
-	XMMATRIX world = XMMatrixIdentity();
-
-	world = XMMatrixRotationY(fY += 0.01f);
-
-	XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(60.0f), 16.0f/9.0f, 0.1f, 100);
-	XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0, 0, 3.0f,0.0f), XMVectorSet(0,0,0, 0), XMVectorSet(0,1,0, 0));
-		
-	m_vsConstantBufferData.mWVP = world * view * proj;
-	m_vsConstantBufferData.mWVP = XMMatrixTranspose(m_vsConstantBufferData.mWVP);
-	m_vsConstantBufferData.mWorld = XMMatrixTranspose(world);
-	memcpy(m_pVSCbvDataBegin, &m_vsConstantBufferData, sizeof(m_vsConstantBufferData));
-
-	m_psConstatnBufferData.view[0] = 0.0f;
-	m_psConstatnBufferData.view[1] = 0.0f;
-	m_psConstatnBufferData.view[2] = 3.0f;
-	memcpy(m_pPSCbvDataBegin, &m_psConstatnBufferData, sizeof(m_psConstatnBufferData));
-
-	memcpy(m_pPLightSCbvDataBegin, &m_psLightConstatnBufferData, sizeof(m_psLightConstatnBufferData));
-}
-
-// Render the scene.
-void PBRSandbox12::OnRender()
-{
-	IMGuiUpdate();
-
-	// Record all the commands we need to render the scene into the command list.
-	PopulateCommandList();
-
-	// Execute the command list.
-	ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
-	m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-
-	// Present the frame.
-	ThrowIfFailed(m_swapChain->Present(1, 0));
-
-	WaitForPreviousFrame();
-}
-
-void PBRSandbox12::OnDestroy()
-{
-	// Ensure that the GPU is no longer referencing resources that are about to be
-	// cleaned up by the destructor.
-	WaitForPreviousFrame();
-
-	ImGui_ImplDX12_Shutdown();
-	ImGui_ImplWin32_Shutdown();
-	ImGui::DestroyContext();
-
-	CloseHandle(m_fenceEvent);
-}
-
-//
-void PBRSandbox12::IMGuiUpdate()
-{
-	ImGui_ImplDX12_NewFrame();
-	ImGui_ImplWin32_NewFrame();
-	ImGui::NewFrame();
-
-	static bool isWindowed = true;
-	static int radioButton = 0;
-	ImGui::Begin("Material Window", &isWindowed);
-	
-//	ImGui::SliderFloat4("BaseColor",m_psConstatnBufferData.baseColor, 0.0, 1.f);
-	ImGui::ColorEdit3("BaseColor", m_psConstatnBufferData.baseColor);
-	m_psConstatnBufferData.baseColor[3] = 1.0f;
-	ImGui::SliderFloat("Metallic", &m_psConstatnBufferData.MetallicRougnessReflectance[0], 0.0f, 1.0f);
-	ImGui::SliderFloat("Roughness", &m_psConstatnBufferData.MetallicRougnessReflectance[1], 0.001f, 1.0f);
-	ImGui::SliderFloat("Reflectance", &m_psConstatnBufferData.MetallicRougnessReflectance[2], 0.0f, 1.0f);
-	ImGui::ColorEdit3("Ambient color", m_psConstatnBufferData.ambientColor);
-
-	ImGui::End();
-
-	ImGui::Begin("Light Window", &isWindowed);
-
-	ImGui::SliderFloat3("Direction", m_psLightConstatnBufferData.direction, -1.f, 1.f);
-	ImGui::SliderFloat("Intensity", &m_psLightConstatnBufferData.intensity, 0.0f, 10.0f);
-	ImGui::ColorEdit3("LightColor", m_psLightConstatnBufferData.lightColor);
-
-	ImGui::End();
-
-}
-
-void PBRSandbox12::PopulateCommandList()
-{
-	ThrowIfFailed(m_commandAllocator->Reset());
-	ThrowIfFailed(m_commandList->Reset(m_commandAllocator.Get(), m_pipelineState.Get()));
-
-	// Set necessary state.
-	m_commandList->SetGraphicsRootSignature(m_rootSignature.Get());
-	m_commandList->RSSetViewports(1, &m_viewport);
-	m_commandList->RSSetScissorRects(1, &m_scissorRect);
-
-	ID3D12DescriptorHeap* ppHeaps[] = { m_srvHeap.Get() };
-	m_commandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
-
-	// Indicate that the back buffer will be used as a render target.
-	m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
-
-	CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_frameIndex, m_rtvDescriptorSize);
-	CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_dsvHeap->GetCPUDescriptorHandleForHeapStart(), 0, m_dsvDescriptorSize);
-	m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
-
-	// Record commands.
-	const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
-	m_commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
-	m_commandList->ClearDepthStencilView(dsvHandle, D3D12_CLEAR_FLAG_DEPTH, 1.0f, 0, 0, nullptr);
-
-	CD3DX12_GPU_DESCRIPTOR_HANDLE cbSceneGPUHandle(m_srvHeap->GetGPUDescriptorHandleForHeapStart(), SCENE_CONSTANT_BUFFER, m_srvDescriptorSize);
-	m_commandList->SetGraphicsRootDescriptorTable(0, cbSceneGPUHandle);
-	
-	CD3DX12_GPU_DESCRIPTOR_HANDLE cbMaterialGPUHandle(m_srvHeap->GetGPUDescriptorHandleForHeapStart(), MATERIAL_CONSTANT_BUFFER, m_srvDescriptorSize);
-	m_commandList->SetGraphicsRootDescriptorTable(1, cbMaterialGPUHandle);
-
-	CD3DX12_GPU_DESCRIPTOR_HANDLE radianceHandle(m_srvHeap->GetGPUDescriptorHandleForHeapStart(), BASE_COLOR, m_srvDescriptorSize);
-	m_commandList->SetGraphicsRootDescriptorTable(2, radianceHandle);
-	
-
-//	m_sphereMesh.DrawMesh(m_commandList.Get());
-
-	m_model.DrawModel(m_commandList.Get());
-
-	ImGui::Render();
-	ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), m_commandList.Get());
-
-	// Indicate that the back buffer will now be used to present.
-	m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
-
-	ThrowIfFailed(m_commandList->Close());
-}
-
-void PBRSandbox12::WaitForPreviousFrame()
-{
-	// WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
-	// This is code implemented as such for simplicity. The D3D12HelloFrameBuffering
-	// sample illustrates how to use fences for efficient resource usage and to
-	// maximize GPU utilization.
-
-	// Signal and increment the fence value.
-	const UINT64 fence = m_fenceValue;
-	ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), fence));
-	m_fenceValue++;
-
-	// Wait until the previous frame is finished.
-	if (m_fence->GetCompletedValue() < fence)
-	{
-		ThrowIfFailed(m_fence->SetEventOnCompletion(fence, m_fenceEvent));
-		WaitForSingleObject(m_fenceEvent, INFINITE);
-	}
-
-	m_frameIndex = m_swapChain->GetCurrentBackBufferIndex();
-}
+//*********************************************************
+//
+// Copyright (c) Microsoft. All rights reserved.
+// This code is licensed under the MIT License (MIT).
+// THIS CODE IS PROVIDED *AS IS* WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESS OR IMPLIED, INCLUDING ANY
+// IMPLIED WARRANTIES OF FITNESS FOR A PARTICULAR
+// PURPOSE, MERCHANTABILITY, OR NON-INFRINGEMENT.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "PBRSandbox12.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// imgui
+#include <imgui.h>
+#include "imgui_impl_win32.h"
+#include "imgui_impl_dx12.h"
+
+PBRSandbox12::PBRSandbox12(UINT width, UINT height, std::wstring name) :
+	DXSample(width, height, name),
+	m_viewport{ 0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f },
+	m_d3d12Device(nullptr),
+	m_pipeline(0),
+	m_loadMilliseconds(0.0),
+	m_imguiDescriptor(0),
+	m_materialStaging(0),
+	m_environmentTable(0),
+	m_viewProj(XMMatrixIdentity()),
+	m_viewProjRows(),
+	m_gridSize(1),
+	m_gridSpacing(2.5f),
+	m_updatedNodeTotal(0),
+	m_frustum(),
+	m_cullingSimd(GetBestCullingSimd()),
+	m_visibleObjectTotal(0),
+	m_skippedSortPassTotal(0),
+	m_chunkCount(1),
+	m_pSceneCommandList(nullptr),
+	m_frameBindings(),
+	m_chunkFirstBatch()
+{
+}
+
+namespace
+{
+	// Compiled shaders, root signatures and pipeline states from earlier runs.
+	const wchar_t* PipelineCacheFile = L"PipelineCache.bin";
+}
+
+void PBRSandbox12::OnInit()
+{
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	LoadPipeline();
+	LoadAssets();
+
+	m_loadMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	if (m_d3d12Device)
+	{
+		const RenderStats& stats = m_renderDevice->GetStats();
+		WCHAR text[128];
+		swprintf_s(text, L"load %.1f ms, %llu pipelines in %.1f ms, cache %llu hits %llu misses",
+			m_loadMilliseconds, stats.pipelinesCreated, stats.pipelineCreateMicroseconds / 1000.0,
+			stats.pipelineCacheHits, stats.pipelineCacheMisses);
+		SetCustomWindowText(text);
+		OutputDebugStringW(text);
+		OutputDebugStringW(L"\n");
+	}
+}
+
+// Load the rendering pipeline dependencies.
+void PBRSandbox12::LoadPipeline()
+{
+	DescriptorAllocatorDesc descriptorDesc = {};
+	descriptorDesc.persistentCount = PersistentDescriptorCount;
+	descriptorDesc.transientCountPerFrame = TransientDescriptorsPerFrame;
+	descriptorDesc.stagingCount = StagingDescriptorCount;
+
+	RenderDeviceDesc deviceDesc = {};
+	deviceDesc.width = m_width;
+	deviceDesc.height = m_height;
+	deviceDesc.descriptorCount = DescriptorAllocator::GetShaderVisibleCount(descriptorDesc, m_framesInFlight);
+	deviceDesc.stagingDescriptorCount = DescriptorAllocator::GetStagingCount(descriptorDesc);
+	deviceDesc.framesInFlight = m_framesInFlight;
+	deviceDesc.workerCommandLists = m_recordingThreads;
+	deviceDesc.window = IsHeadless() ? nullptr : Win32Application::GetHwnd();
+	deviceDesc.useWarpDevice = m_useWarpDevice;
+	deviceDesc.pipelineCacheFile = PipelineCacheFile;
+
+	if (m_coldStart)
+	{
+		DeleteFileW(PipelineCacheFile);
+	}
+
+	m_renderDevice = CreateRenderDevice(m_renderBackend, deviceDesc);
+	m_descriptorAllocator.Init(m_renderDevice.get(), descriptorDesc);
+
+	m_jobSystem.reset(new JobSystem(std::max(m_recordingThreads, 1u)));
+
+	if (m_renderDevice->GetBackend() != RenderBackend::D3D12)
+		return;
+
+	m_d3d12Device = static_cast<D3D12RenderDevice*>(m_renderDevice.get());
+
+	// Imgui Init
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO(); (void)io;
+	//io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;  // Enable Keyboard Controls
+	ImGui_ImplWin32_Init(Win32Application::GetHwnd());
+
+	m_imguiDescriptor = m_descriptorAllocator.AllocatePersistent(1);
+	D3D12_CPU_DESCRIPTOR_HANDLE imguiCPUHandle = m_d3d12Device->GetDescriptorCpuHandle(m_imguiDescriptor);
+	D3D12_GPU_DESCRIPTOR_HANDLE imguiGPUHandle = m_d3d12Device->GetDescriptorGpuHandle(m_imguiDescriptor);
+	if (ImGui_ImplDX12_Init(m_d3d12Device->GetDevice(), m_d3d12Device->GetFramesInFlight(), D3D12RenderDevice::BackBufferFormat, imguiCPUHandle, imguiGPUHandle))
+	{
+		ImGui::StyleColorsDark();
+
+		ImGui_ImplDX12_InvalidateDeviceObjects();
+		ImGui_ImplDX12_CreateDeviceObjects();
+	}
+}
+
+// Load the sample assets.
+void PBRSandbox12::LoadAssets()
+{
+	// Create the pipeline: b0 for the vertex shader, b0-b1 and t0, t1, t10, t11 for the pixel shader.
+	// The constant buffers are root CBVs; the material and environment textures are separate tables.
+	{
+		RenderRootParameter rootParameters[5] = {};
+
+		rootParameters[0].type = RenderRootParameterType::ConstantBuffer;
+		rootParameters[0].visibility = RenderShaderVisibility::Vertex;
+		rootParameters[0].shaderRegister = 0;
+
+		rootParameters[1].type = RenderRootParameterType::ConstantBuffer;
+		rootParameters[1].visibility = RenderShaderVisibility::Pixel;
+		rootParameters[1].shaderRegister = 0;
+
+		rootParameters[2].type = RenderRootParameterType::ConstantBuffer;
+		rootParameters[2].visibility = RenderShaderVisibility::Pixel;
+		rootParameters[2].shaderRegister = 1;
+
+		rootParameters[3].type = RenderRootParameterType::DescriptorTable;
+		rootParameters[3].visibility = RenderShaderVisibility::Pixel;
+		rootParameters[3].rangeCount = 1;
+		rootParameters[3].ranges[0] = { RenderDescriptorType::ShaderResource, 2, 0 };
+
+		rootParameters[4].type = RenderRootParameterType::DescriptorTable;
+		rootParameters[4].visibility = RenderShaderVisibility::Pixel;
+		rootParameters[4].rangeCount = 1;
+		rootParameters[4].ranges[0] = { RenderDescriptorType::ShaderResource, 2, 10 };
+
+		const RenderVertexElement inputElements[] =
+		{
+			{ "POSITION", RenderVertexFormat::Float3, 0 },
+			{ "NORMAL", RenderVertexFormat::Float3, 12 },
+			{ "TEXCOORD", RenderVertexFormat::Float2, 24 }
+		};
+
+		RenderPipelineDesc pipelineDesc = {};
+		pipelineDesc.shaderFile = L"ModelShader.hlsl";
+		pipelineDesc.vertexShaderEntry = "VSMain";
+		pipelineDesc.pixelShaderEntry = "PSMain";
+		pipelineDesc.rootParameters = rootParameters;
+		pipelineDesc.rootParameterCount = _countof(rootParameters);
+		pipelineDesc.inputElements = inputElements;
+		pipelineDesc.inputElementCount = _countof(inputElements);
+		pipelineDesc.instanceConstantStride = sizeof(SceneConstantBuffer);
+		m_pipeline = m_renderDevice->CreatePipeline(pipelineDesc);
+	}
+
+	m_sphereMesh.Init(m_renderDevice.get(), 64, 64);
+	ThrowIfFailed(m_model.Load("helmet.vbo", m_renderDevice.get()));
+
+	// Size the constant ring for every object plus the material and light, for
+	// each frame in flight and the frame being recorded, plus slack for the end
+	// of the ring that a large batch may have to skip.
+	{
+		const uint64_t frameBytes = static_cast<uint64_t>(m_objectCount) * SceneConstantStride + 2 * UploadRingAllocator::Alignment;
+		m_constantAllocator.Init(m_renderDevice.get(), frameBytes * (m_renderDevice->GetFramesInFlight() + 2), L"m_constantAllocator");
+	}
+
+	m_materialStaging = m_descriptorAllocator.AllocateStaging(2);
+	m_environmentTable = m_descriptorAllocator.AllocatePersistent(2);
+
+	m_baseColorTexture = m_renderDevice->LoadTexture(L"Default_albedo.dds", RenderTextureDimension::Texture2D);
+	m_renderDevice->CreateStagingTextureView(m_materialStaging, m_baseColorTexture);
+
+	m_metallicRoughnessTexture = m_renderDevice->LoadTexture(L"Default_metalRoughness.dds", RenderTextureDimension::Texture2D);
+	m_renderDevice->CreateStagingTextureView(m_materialStaging + 1, m_metallicRoughnessTexture);
+
+	m_radianceCube = m_renderDevice->LoadTexture(L"Stonewall_Ref_radiance.dds", RenderTextureDimension::TextureCube);
+	m_renderDevice->CreateTextureView(m_environmentTable, m_radianceCube);
+
+	m_irradianceCube = m_renderDevice->LoadTexture(L"Stonewall_Ref_irradiance.dds", RenderTextureDimension::TextureCube);
+	m_renderDevice->CreateTextureView(m_environmentTable + 1, m_irradianceCube);
+
+	// Wait until assets have been uploaded to the GPU.
+	m_renderDevice->FinishUploads();
+
+	// Everything the cache holds has been created by now.
+	m_renderDevice->SavePipelineCache();
+
+	BuildScene();
+	BuildFrameGraph();
+}
+
+void PBRSandbox12::BuildScene()
+{
+	while (m_gridSize * m_gridSize < m_objectCount)
+		++m_gridSize;
+
+	const XMFLOAT3& modelCenter = m_model.GetBoundsCenter();
+	const SceneFloat3 boundsCenter = { modelCenter.x, modelCenter.y, modelCenter.z };
+
+	const SceneNodeId root = m_scene.CreateNode(InvalidSceneNode);
+	const float origin = -0.5f * (m_gridSize - 1) * m_gridSpacing;
+
+	m_objectNodes.resize(m_objectCount);
+	for (UINT object = 0; object < m_objectCount; ++object)
+	{
+		const SceneNodeId node = m_scene.CreateNode(root);
+		const SceneFloat3 position = { origin + (object % m_gridSize) * m_gridSpacing, origin + (object / m_gridSize) * m_gridSpacing, 0.0f };
+		m_scene.SetLocalPosition(node, position);
+		m_scene.SetRenderable(node, 0, 0, boundsCenter, m_model.GetBoundsRadius());
+		m_objectNodes[object] = node;
+	}
+}
+
+void PBRSandbox12::BuildFrameGraph()
+{
+	m_chunkCount = std::max(std::min(m_renderDevice->GetWorkerCommandListCount(), m_objectCount), 1u);
+
+	m_frameGraph.Clear();
+
+	const UINT nodeCount = m_scene.GetNodeCount();
+	const UINT cullTaskCount = (nodeCount + CullBatchSize - 1) / CullBatchSize;
+	m_visibleNodes.resize(nodeCount);
+	m_cullVisibleCounts.assign(cullTaskCount, 0);
+
+	// Culling reads the world bounds, so it waits for the whole update; the
+	// draw keys are then only written for the objects that survived. The sort
+	// is split between the workers.
+	const TaskGraph::TaskId sceneUpdated = m_scene.AddUpdateTasks(m_frameGraph, UpdateBatchSize);
+	const TaskGraph::TaskId keysWritten = m_frameGraph.AddTask([this](uint32_t) { WriteDrawKeys(); });
+
+	for (UINT cullTask = 0; cullTask < cullTaskCount; ++cullTask)
+	{
+		const TaskGraph::TaskId cullId = m_frameGraph.AddTask([this, cullTask](uint32_t) { CullRange(cullTask); });
+		m_frameGraph.AddDependency(sceneUpdated, cullId);
+		m_frameGraph.AddDependency(cullId, keysWritten);
+	}
+
+	const TaskGraph::TaskId keysSorted = m_drawList.AddSortTasks(m_frameGraph, keysWritten, m_jobSystem->GetWorkerCount());
+	const TaskGraph::TaskId drawsPrepared = m_frameGraph.AddTask([this](uint32_t) { PrepareDraws(); });
+	m_frameGraph.AddDependency(keysSorted, drawsPrepared);
+
+	for (UINT chunk = 0; chunk < m_chunkCount; ++chunk)
+	{
+		const TaskGraph::TaskId recordTask = m_frameGraph.AddTask([this, chunk](uint32_t) { RecordChunk(chunk); });
+		m_frameGraph.AddDependency(drawsPrepared, recordTask);
+	}
+}
+
+// Update frame-based values.
+void PBRSandbox12::OnUpdate()
+{
+	static float fY = 0.0f;
+
+	// Every object spins about its own origin.
+	XMFLOAT4 rotation;
+	XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(0.0f, fY += 0.01f, 0.0f));
+	const SceneQuaternion objectRotation = { rotation.x, rotation.y, rotation.z, rotation.w };
+	for (SceneNodeId node : m_objectNodes)
+	{
+		m_scene.SetLocalRotation(node, objectRotation);
+	}
+
+	// Pull the camera back far enough to see the whole grid.
+	const float extent = (m_gridSize - 1) * m_gridSpacing;
+	const float eyeZ = 3.0f + extent;
+
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XMConvertToRadians(60.0f), 16.0f/9.0f, 0.1f, 100 + extent);
+	XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0, 0, eyeZ, 0.0f), XMVectorSet(0,0,0, 0), XMVectorSet(0,1,0, 0));
+	m_viewProj = view * proj;
+
+	XMStoreFloat4x4(&m_viewProjRows, m_viewProj);
+	ExtractFrustumPlanes(m_viewProjRows.m, m_frustum);
+
+	m_psConstatnBufferData.view[0] = 0.0f;
+	m_psConstatnBufferData.view[1] = 0.0f;
+	m_psConstatnBufferData.view[2] = eyeZ;
+}
+
+// Render the scene.
+void PBRSandbox12::OnRender()
+{
+	if (m_d3d12Device)
+	{
+		IMGuiUpdate();
+	}
+
+	// Record all the commands we need to render the scene, then submit and present.
+	PopulateCommandList(m_renderDevice->BeginFrame());
+	m_renderDevice->EndFrame();
+}
+
+void PBRSandbox12::OnDestroy()
+{
+	// Ensure that the GPU is no longer referencing resources that are about to be
+	// cleaned up by the destructor.
+	m_renderDevice->WaitForIdle();
+
+	if (m_d3d12Device)
+	{
+		ImGui_ImplDX12_Shutdown();
+		ImGui_ImplWin32_Shutdown();
+		ImGui::DestroyContext();
+	}
+}
+
+void PBRSandbox12::OnHeadlessReport()
+{
+	const RenderStats& stats = m_renderDevice->GetStats();
+	const double frames = static_cast<double>(std::max<uint64_t>(stats.frames, 1));
+
+	wprintf(L"backend          %ls\n", (m_renderDevice->GetBackend() == RenderBackend::Software) ? L"software" : L"null");
+	wprintf(L"commands/frame   %.1f (%.1f bytes)\n", stats.commands / frames, stats.commandBytes / frames);
+	wprintf(L"draws/frame      %.1f (%.1f instances, %.1f primitives)\n", stats.drawCalls / frames, stats.instances / frames, stats.primitives / frames);
+	wprintf(L"pipeline changes %.1f/frame\n", stats.pipelineChanges / frames);
+	wprintf(L"pixels/frame     %.1f\n", stats.pixelsWritten / frames);
+	wprintf(L"buffers          %llu bytes, %llu textures\n", stats.bufferBytes, stats.textureCount);
+	wprintf(L"validation       %llu errors\n", stats.validationErrors);
+	wprintf(L"load             %.1f ms, %llu pipelines in %.3f ms\n",
+		m_loadMilliseconds, stats.pipelinesCreated, stats.pipelineCreateMicroseconds / 1000.0);
+	const UploadRingStats& ringStats = m_constantAllocator.GetStats();
+	wprintf(L"constant ring    %.1f allocs/frame, peak %llu of %llu bytes, %llu wraps, %llu stalls\n",
+		ringStats.allocations / frames, ringStats.peakUsedBytes, m_constantAllocator.GetCapacity(), ringStats.wraps, ringStats.stalls);
+	const DescriptorAllocatorStats descriptorStats = m_descriptorAllocator.GetStats();
+	wprintf(L"descriptors      persistent %u/%u, staging %u/%u, transient peak %u/%u per frame\n",
+		descriptorStats.persistentUsed, PersistentDescriptorCount, descriptorStats.stagingUsed, StagingDescriptorCount,
+		descriptorStats.transientPeak, TransientDescriptorsPerFrame);
+	wprintf(L"descriptor copy  %.1f/frame in %.1f batches\n", stats.descriptorCopies / frames, stats.descriptorCopyBatches / frames);
+	wprintf(L"frame waits      %llu of %llu frames (%.3f ms total, %u in flight)\n",
+		stats.frameWaits, stats.frames, stats.frameWaitMicroseconds / 1000.0, m_renderDevice->GetFramesInFlight());
+
+	wprintf(L"scene            %u nodes in %u levels, %.1f updated/frame, %.1f batches/frame\n",
+		m_scene.GetNodeCount(), m_scene.GetLevelCount(), m_updatedNodeTotal / frames, stats.drawCalls / frames);
+	const WCHAR* simdNames[3] = { L"scalar", L"sse", L"avx" };
+	wprintf(L"culling          %.1f of %u objects visible/frame (%ls frustum test)\n",
+		m_visibleObjectTotal / frames, m_objectCount, simdNames[static_cast<int>(m_cullingSimd)]);
+	wprintf(L"draw sort        %.1f of %u radix passes skipped/frame, %u parts\n",
+		m_skippedSortPassTotal / frames, RadixSorter::PassCount, m_jobSystem->GetWorkerCount());
+	RenderStateFilterStats filterStats = {};
+	for (const RenderStateFilter& filter : m_stateFilters)
+	{
+		const RenderStateFilterStats& chunkStats = filter.GetStats();
+		filterStats.stateCommands += chunkStats.stateCommands;
+		filterStats.pipelinesSkipped += chunkStats.pipelinesSkipped;
+		filterStats.viewportsSkipped += chunkStats.viewportsSkipped;
+		filterStats.rootArgumentsSkipped += chunkStats.rootArgumentsSkipped;
+		filterStats.buffersSkipped += chunkStats.buffersSkipped;
+	}
+	wprintf(L"state filter     %.1f of %.1f state commands skipped/frame (%.1f pipelines, %.1f viewports, %.1f root args, %.1f buffers)\n",
+		(filterStats.pipelinesSkipped + filterStats.viewportsSkipped + filterStats.rootArgumentsSkipped + filterStats.buffersSkipped) / frames,
+		filterStats.stateCommands / frames, filterStats.pipelinesSkipped / frames, filterStats.viewportsSkipped / frames,
+		filterStats.rootArgumentsSkipped / frames, filterStats.buffersSkipped / frames);
+	wprintf(L"frame graph      %u tasks, %u cull tasks, %u record chunks\n",
+		m_frameGraph.GetTaskCount(), static_cast<UINT>(m_cullVisibleCounts.size()), m_chunkCount);
+	if (m_recordingThreads)
+	{
+		wprintf(L"worker lists     %.1f/frame\n", stats.workerCommandLists / frames);
+	}
+	for (UINT i = 0; i < m_jobSystem->GetWorkerCount(); ++i)
+	{
+		const JobSystem::WorkerStats& workerStats = m_jobSystem->GetWorkerStats(i);
+		wprintf(L"  worker %-2u      %.2f tasks/frame (%.2f stolen), %.3f ms/frame%ls\n", i,
+			workerStats.jobs / frames, workerStats.steals / frames, workerStats.busyMicroseconds / 1000.0 / frames,
+			i ? L"" : L" (main thread)");
+	}
+}
+
+//
+void PBRSandbox12::IMGuiUpdate()
+{
+	ImGui_ImplDX12_NewFrame();
+	ImGui_ImplWin32_NewFrame();
+	ImGui::NewFrame();
+
+	static bool isWindowed = true;
+	static int radioButton = 0;
+	ImGui::Begin("Material Window", &isWindowed);
+	
+//	ImGui::SliderFloat4("BaseColor",m_psConstatnBufferData.baseColor, 0.0, 1.f);
+	ImGui::ColorEdit3("BaseColor", m_psConstatnBufferData.baseColor);
+	m_psConstatnBufferData.baseColor[3] = 1.0f;
+	ImGui::SliderFloat("Metallic", &m_psConstatnBufferData.MetallicRougnessReflectance[0], 0.0f, 1.0f);
+	ImGui::SliderFloat("Roughness", &m_psConstatnBufferData.MetallicRougnessReflectance[1], 0.001f, 1.0f);
+	ImGui::SliderFloat("Reflectance", &m_psConstatnBufferData.MetallicRougnessReflectance[2], 0.0f, 1.0f);
+	ImGui::ColorEdit3("Ambient color", m_psConstatnBufferData.ambientColor);
+
+	ImGui::End();
+
+	ImGui::Begin("Light Window", &isWindowed);
+
+	ImGui::SliderFloat3("Direction", m_psLightConstatnBufferData.direction, -1.f, 1.f);
+	ImGui::SliderFloat("Intensity", &m_psLightConstatnBufferData.intensity, 0.0f, 10.0f);
+	ImGui::ColorEdit3("LightColor", m_psLightConstatnBufferData.lightColor);
+
+	ImGui::End();
+
+}
+
+void PBRSandbox12::PopulateCommandList(RenderCommandList* pCommandList)
+{
+	// Record commands.
+	const float clearColor[] = { 0.0f, 0.2f, 0.4f, 1.0f };
+	pCommandList->ClearRenderTarget(clearColor);
+	pCommandList->ClearDepth(1.0f);
+
+	m_constantAllocator.BeginFrame();
+	m_descriptorAllocator.BeginFrame();
+
+	m_frameBindings.material = m_constantAllocator.Upload(m_psConstatnBufferData);
+	m_frameBindings.light = m_constantAllocator.Upload(m_psLightConstatnBufferData);
+	m_frameBindings.materialTable = m_descriptorAllocator.CopyToTransient(m_materialStaging, 2);
+
+	m_pSceneCommandList = pCommandList;
+	m_jobSystem->Run(m_frameGraph);
+	m_updatedNodeTotal += m_scene.GetUpdatedNodeCount();
+
+//	m_sphereMesh.DrawMesh(pCommandList);
+
+	if (m_d3d12Device)
+	{
+		ImGui::Render();
+		ImGui_ImplDX12_RenderDrawData(ImGui::GetDrawData(), m_d3d12Device->GetOverlayCommandList());
+	}
+}
+
+// Tests one range of scene nodes against the frustum. Transform-only nodes
+// may pass too; the draw list skips them.
+void PBRSandbox12::CullRange(UINT cullTask)
+{
+	const UINT first = cullTask * CullBatchSize;
+	const UINT remaining = m_scene.GetNodeCount() - first;
+	const UINT count = (remaining < CullBatchSize) ? remaining : CullBatchSize;
+
+	m_cullVisibleCounts[cullTask] = FrustumCullSpheres(m_frustum, m_scene.GetWorldBoundsX(), m_scene.GetWorldBoundsY(),
+		m_scene.GetWorldBoundsZ(), m_scene.GetWorldBoundsRadius(), first, count, &m_visibleNodes[first], m_cullingSimd);
+}
+
+// Packs the cull results together and writes a draw key for each visible
+// object, ready for the sort tasks.
+void PBRSandbox12::WriteDrawKeys()
+{
+	// Every range only moves towards the front.
+	UINT visibleCount = 0;
+	for (UINT cullTask = 0; cullTask < m_cullVisibleCounts.size(); ++cullTask)
+	{
+		const SceneNodeId* pRange = &m_visibleNodes[cullTask * CullBatchSize];
+		std::copy(pRange, pRange + m_cullVisibleCounts[cullTask], &m_visibleNodes[visibleCount]);
+		visibleCount += m_cullVisibleCounts[cullTask];
+	}
+
+	m_drawList.WriteKeys(m_scene, m_visibleNodes.data(), visibleCount, *reinterpret_cast<const SceneMatrix*>(&m_viewProjRows));
+}
+
+// Groups the sorted objects into instanced batches, reserves their constants
+// and splits the batches between the record chunks. The allocators are not
+// thread-safe, so only this task touches them while the graph runs.
+void PBRSandbox12::PrepareDraws()
+{
+	const UINT drawCount = m_drawList.GetSorter().GetCount();
+	m_visibleObjectTotal += drawCount;
+	m_skippedSortPassTotal += m_drawList.GetSorter().GetSkippedPassCount();
+
+	// Cap the batch size so that every chunk has something to record.
+	const UINT objectsPerChunk = std::max((drawCount + m_chunkCount - 1) / m_chunkCount, 1u);
+	const UINT maxInstancesPerBatch = (objectsPerChunk < MaxInstancesPerDraw) ? objectsPerChunk : MaxInstancesPerDraw;
+	m_drawList.BuildBatches(maxInstancesPerBatch);
+
+	const std::vector<SceneDrawBatch>& batches = m_drawList.GetBatches();
+	const UINT batchCount = static_cast<UINT>(batches.size());
+
+	m_batchConstants.resize(batchCount);
+	for (UINT batch = 0; batch < batchCount; ++batch)
+	{
+		m_batchConstants[batch] = m_constantAllocator.Allocate(batches[batch].instanceCount * sizeof(SceneConstantBuffer));
+	}
+
+	for (UINT chunk = 0; chunk <= m_chunkCount; ++chunk)
+	{
+		m_chunkFirstBatch[chunk] = chunk * batchCount / m_chunkCount;
+	}
+}
+
+// Chunk i is always recorded onto worker list i, so submission order does not
+// depend on which thread picked the chunk up.
+void PBRSandbox12::RecordChunk(UINT chunk)
+{
+	const UINT firstBatch = m_chunkFirstBatch[chunk];
+	const UINT batchCount = m_chunkFirstBatch[chunk + 1] - firstBatch;
+
+	if (!m_renderDevice->GetWorkerCommandListCount())
+	{
+		RecordScene(m_stateFilters[chunk], m_pSceneCommandList, m_frameBindings, firstBatch, batchCount);
+		return;
+	}
+
+	if (!batchCount)
+		return;
+
+	RenderCommandList* pWorkerList = m_renderDevice->BeginWorkerCommandList(chunk);
+	RecordScene(m_stateFilters[chunk], pWorkerList, m_frameBindings, firstBatch, batchCount);
+	m_renderDevice->EndWorkerCommandList(chunk);
+}
+
+// Issues one instanced draw per batch, writing each instance's transforms
+// into the batch's constants first. Every batch sets its full state; the
+// filter only passes on what differs from the batch before.
+void PBRSandbox12::RecordScene(RenderStateFilter& filter, RenderCommandList* pCommandList, const FrameBindings& bindings, UINT firstBatch, UINT batchCount)
+{
+	filter.Begin(pCommandList);
+
+	const std::vector<SceneDrawBatch>& batches = m_drawList.GetBatches();
+	const SceneNodeId* pInstances = m_drawList.GetInstances().data();
+
+	for (UINT batch = firstBatch; batch < firstBatch + batchCount; ++batch)
+	{
+		const SceneDrawBatch& drawBatch = batches[batch];
+		const UploadAllocation& constants = m_batchConstants[batch];
+
+		SceneConstantBuffer* pInstanceData = static_cast<SceneConstantBuffer*>(constants.pData);
+		for (UINT i = 0; i < drawBatch.instanceCount; ++i)
+		{
+			const SceneMatrix& sceneWorld = m_scene.GetWorldMatrix(pInstances[drawBatch.firstInstance + i]);
+			const XMMATRIX world = XMLoadFloat4x4(reinterpret_cast<const XMFLOAT4X4*>(&sceneWorld));
+			pInstanceData[i].mWVP = XMMatrixTranspose(world * m_viewProj);
+			pInstanceData[i].mWorld = XMMatrixTranspose(world);
+		}
+
+		// The sample has one pipeline, one material and one model, so every
+		// batch's indices resolve to m_pipeline, the frame's material table and
+		// m_model.
+		filter.SetPipeline(m_pipeline);
+		filter.SetViewport(m_viewport);
+
+		filter.SetRootConstantBuffer(0, constants.buffer, constants.offset);
+		filter.SetRootConstantBuffer(1, bindings.material.buffer, bindings.material.offset);
+		filter.SetRootConstantBuffer(2, bindings.light.buffer, bindings.light.offset);
+		filter.SetRootDescriptorTable(3, bindings.materialTable);
+		filter.SetRootDescriptorTable(4, m_environmentTable);
+
+		m_model.DrawModel(&filter, drawBatch.instanceCount);
+	}
+}
@@ -12,6 +12,13 @@
 #pragma once
 
 #include "DXSample.h"
+#include "RenderDeviceD3D12.h"
+#include "UploadRingAllocator.h"
+#include "DescriptorAllocator.h"
+#include "JobSystem.h"
+#include "Scene.h"
+#include "Culling.h"
+#include "RenderStateFilter.h"
 #include "SphereMesh.h"
 #include "Model12.h"
 
@@ -42,12 +49,28 @@ class PBRSandbox12 : public DXSample
 		float lightColor[3];
 	};
 	
+	// Per-instance constants. An instanced draw binds b0 as an array of these,
+	// indexed by SV_InstanceID; 512 of them fill the 64KB constant buffer limit.
 	struct SceneConstantBuffer
 	{
 		DirectX::XMMATRIX mWVP;
 		DirectX::XMMATRIX mWorld;
 	};
 
+	static const UINT MaxInstancesPerDraw = 65536 / sizeof(SceneConstantBuffer);
+
+	// Root CBV addresses must be 256-byte aligned, so an instance alone in its
+	// batch takes this much of the constant ring.
+	static const UINT SceneConstantStride = (sizeof(SceneConstantBuffer) + UploadRingAllocator::Alignment - 1) & ~(UploadRingAllocator::Alignment - 1);
+
+	// Per-frame arguments shared by every command list that draws the scene.
+	struct FrameBindings
+	{
+		UploadAllocation material;
+		UploadAllocation light;
+		uint32_t materialTable;
+	};
+
 public:
 	PBRSandbox12(UINT width, UINT height, std::wstring name);
 
@@ -55,82 +78,109 @@ public:
 	virtual void OnUpdate();
 	virtual void OnRender();
 	virtual void OnDestroy();
+	virtual void OnHeadlessReport();
 
 private:
-	static const UINT FrameCount = 2;
+	// Descriptor budget: persistent shader-visible slots, transient slots per
+	// frame in flight, and CPU-only staging slots for material views.
+	static const UINT PersistentDescriptorCount = 64;
+	static const UINT TransientDescriptorsPerFrame = 256;
+	static const UINT StagingDescriptorCount = 256;
 
-	enum HEAP_OFFSET : uint32_t
-	{
-		IMGUI_HEAP_OFFSET = 0,
-		SCENE_CONSTANT_BUFFER,
-		MATERIAL_CONSTANT_BUFFER,
-		LIGHT_CONSTANT_BUFFER,
-		BASE_COLOR,
-		METALLIC_ROUGHNESS,
-		CUBEMAP_RADDIANCE,
-		CUBEMAP_IRRADIANCE,
-	};
+	// Scene nodes whose world transforms one update task computes.
+	static const UINT UpdateBatchSize = 256;
 
-	// Pipeline objects.
-	CD3DX12_VIEWPORT m_viewport;
-	CD3DX12_RECT m_scissorRect;
-	ComPtr<IDXGISwapChain3> m_swapChain;
-	ComPtr<ID3D12Device> m_device;
-	ComPtr<ID3D12Resource> m_renderTargets[FrameCount];
-	ComPtr<ID3D12Resource> m_depthStencil;
-
-	ComPtr<ID3D12CommandAllocator> m_commandAllocator;
-	ComPtr<ID3D12CommandQueue> m_commandQueue;
-	ComPtr<ID3D12RootSignature> m_rootSignature;
-	
-	ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
-	ComPtr<ID3D12DescriptorHeap> m_dsvHeap;
-	ComPtr<ID3D12DescriptorHeap> m_srvHeap;
+	// Scene nodes whose bounds one culling task tests.
+	static const UINT CullBatchSize = 4096;
 
-	ComPtr<ID3D12PipelineState> m_pipelineState;
-	ComPtr<ID3D12GraphicsCommandList> m_commandList;
+	// Pipeline objects.
+	RenderViewport m_viewport;
+	std::unique_ptr<RenderDevice> m_renderDevice;
+	D3D12RenderDevice* m_d3d12Device;		// Null for the headless backends.
+	RenderPipelineHandle m_pipeline;
+	DescriptorAllocator m_descriptorAllocator;
 
-	UINT m_srvDescriptorSize;
-	UINT m_rtvDescriptorSize;
-	UINT m_dsvDescriptorSize;
+	// Time LoadPipeline and LoadAssets take, before any frame is recorded.
+	// The pipeline cache shortens it.
+	double m_loadMilliseconds;
 
 	// App resources.
-	ComPtr<ID3D12Resource> m_baseColorTexture;
-	ComPtr<ID3D12Resource> m_metallicRoughnessTexture;
-	ComPtr<ID3D12Resource> m_radianceCube;
-	ComPtr<ID3D12Resource> m_irradianceCube;
+	RenderTextureHandle m_baseColorTexture;
+	RenderTextureHandle m_metallicRoughnessTexture;
+	RenderTextureHandle m_radianceCube;
+	RenderTextureHandle m_irradianceCube;
+
+	// Material views live in staging slots and are copied into a transient
+	// table each frame; the environment cubemaps sit in a persistent table.
+	uint32_t m_imguiDescriptor;
+	uint32_t m_materialStaging;
+	uint32_t m_environmentTable;
+
+	// Per-draw constants are suballocated from a ring shared by all frames in
+	// flight and bound as root CBVs.
+	UploadRingAllocator m_constantAllocator;
+
+	// Objects are children of one root node, laid out on a square grid around
+	// the origin. Visible objects are sorted by draw key, and runs that share
+	// every binding are drawn instanced.
+	Scene m_scene;
+	std::vector<SceneNodeId> m_objectNodes;
+	SceneDrawList m_drawList;
+	XMMATRIX m_viewProj;
+	XMFLOAT4X4 m_viewProjRows;		// m_viewProj for the culling and sorting code.
+	UINT m_gridSize;
+	float m_gridSpacing;
+	uint64_t m_updatedNodeTotal;
+
+	// Frustum culling runs over the world bounds once the update is done. Cull
+	// task i writes the visible node ids of its range to m_visibleNodes from
+	// i * CullBatchSize on, and their number to m_cullVisibleCounts[i].
+	CullingFrustum m_frustum;
+	CullingSimd m_cullingSimd;
+	std::vector<SceneNodeId> m_visibleNodes;
+	std::vector<UINT> m_cullVisibleCounts;
+	uint64_t m_visibleObjectTotal;
+	uint64_t m_skippedSortPassTotal;
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_vsConstantBuffer;
-	SceneConstantBuffer m_vsConstantBufferData;
-	UINT8* m_pVSCbvDataBegin;
-
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_psConstantBuffer;
 	PBRParameter	m_psConstatnBufferData;
-	UINT8* m_pPSCbvDataBegin;
-
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_psLightConstantBuffer;
 	Light	m_psLightConstatnBufferData;
-	UINT8* m_pPLightSCbvDataBegin;
 	
+	// The frame graph is built once. The scene update tasks are followed by
+	// the cull tasks, a task that writes the visible objects' draw keys, the
+	// radix sort tasks, and a task that groups the sorted objects into
+	// instanced batches and splits them into chunks; each record task draws
+	// one chunk. With worker command lists chunk i records onto list i;
+	// without them there is a single chunk on the frame's own list.
+	std::unique_ptr<JobSystem> m_jobSystem;
+	TaskGraph m_frameGraph;
+	UINT m_chunkCount;
+
+	// Inputs for the frame graph, written on the main thread before it runs.
+	RenderCommandList* m_pSceneCommandList;
+	FrameBindings m_frameBindings;
+
+	// Written by the batching task. Chunk i records batches
+	// [m_chunkFirstBatch[i], m_chunkFirstBatch[i + 1]).
+	std::vector<UploadAllocation> m_batchConstants;
+	UINT m_chunkFirstBatch[RenderMaxWorkerCommandLists + 1];
+
+	// Chunk i records through filter i, which drops state its batches repeat.
+	RenderStateFilter m_stateFilters[RenderMaxWorkerCommandLists];
+
 	SphereMesh m_sphereMesh;
 	Model	m_model;
 
-	// Synchronization objects.
-	UINT m_frameIndex;
-	HANDLE m_fenceEvent;
-	ComPtr<ID3D12Fence> m_fence;
-	UINT64 m_fenceValue;
-
 	void LoadPipeline();
 	void LoadAssets();
-	void PopulateCommandList();
-	void WaitForPreviousFrame();
+	void BuildScene();
+	void BuildFrameGraph();
+	void PopulateCommandList(RenderCommandList* pCommandList);
+	void CullRange(UINT cullTask);
+	void WriteDrawKeys();
+	void PrepareDraws();
+	void RecordChunk(UINT chunk);
+	void RecordScene(RenderStateFilter& filter, RenderCommandList* pCommandList, const FrameBindings& bindings, UINT firstBatch, UINT batchCount);
 
 	void IMGuiUpdate();
 
-	void LoadTexture(wchar_t* filename, D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle,
-		ID3D12GraphicsCommandList* pCommandList, ID3D12Resource** texture, ID3D12Resource** textureUploadHeap);
-
-	void LoadCubeTexture(wchar_t* filename, D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle,
-		ID3D12GraphicsCommandList* pCommandList, ID3D12Resource** texture, ID3D12Resource** textureUploadHeap);
 };
@@ -0,0 +1,182 @@
+//*********************************************************
+//
+// PipelineCache.cpp
+//
+//*********************************************************
+
+#include "PipelineCache.h"
+
+#include <cstring>
+
+namespace
+{
+	const uint32_t CacheMagic = 0x43504C50;		// "PLPC"
+	const uint32_t CacheVersion = 1;
+
+	const uint64_t FnvOffsetBasis = 0xcbf29ce484222325ull;
+	const uint64_t FnvPrime = 0x100000001b3ull;
+
+	// File layout: a header, then entryCount entries, each a header followed
+	// by its bytes.
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+	};
+
+	struct EntryHeader
+	{
+		uint32_t type;
+		uint32_t reserved;
+		uint64_t key;
+		uint64_t size;
+		uint64_t contentHash;
+	};
+
+	uint64_t HashContents(const void* pData, size_t size)
+	{
+		PipelineCacheKey hash;
+		hash.AddBytes(pData, size);
+		return hash.GetValue();
+	}
+}
+
+PipelineCacheKey::PipelineCacheKey() :
+	m_hash(FnvOffsetBasis)
+{
+}
+
+void PipelineCacheKey::AddBytes(const void* pData, size_t size)
+{
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+	for (size_t i = 0; i < size; ++i)
+	{
+		m_hash = (m_hash ^ pBytes[i]) * FnvPrime;
+	}
+}
+
+// Strings are added with their terminator, so "ab" + "c" and "a" + "bc" differ.
+void PipelineCacheKey::AddString(const char* pString)
+{
+	AddBytes(pString, pString ? strlen(pString) + 1 : 0);
+}
+
+void PipelineCacheKey::AddWideString(const wchar_t* pString)
+{
+	if (!pString)
+		return;
+
+	for (; *pString; ++pString)
+	{
+		const uint16_t character = static_cast<uint16_t>(*pString);
+		AddValue(character);
+	}
+	const uint16_t terminator = 0;
+	AddValue(terminator);
+}
+
+PipelineCache::PipelineCache() :
+	m_dirty(false),
+	m_stats()
+{
+}
+
+void PipelineCache::ResetStats()
+{
+	m_stats = PipelineCacheStats();
+}
+
+bool PipelineCache::Deserialize(const void* pData, size_t size)
+{
+	m_entries.clear();
+	m_dirty = false;
+
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+	FileHeader header;
+	if (size < sizeof(header))
+		return false;
+
+	memcpy(&header, pBytes, sizeof(header));
+	if (header.magic != CacheMagic || header.version != CacheVersion)
+		return false;
+
+	size_t offset = sizeof(header);
+	for (uint32_t i = 0; i < header.entryCount; ++i)
+	{
+		EntryHeader entry;
+		if (size - offset < sizeof(entry))
+			break;
+		memcpy(&entry, pBytes + offset, sizeof(entry));
+		offset += sizeof(entry);
+
+		// A truncated file keeps the entries before the cut.
+		if (size - offset < entry.size)
+			break;
+
+		const uint8_t* pEntryData = pBytes + offset;
+		offset += static_cast<size_t>(entry.size);
+
+		if (HashContents(pEntryData, static_cast<size_t>(entry.size)) != entry.contentHash)
+		{
+			++m_stats.droppedEntries;
+			continue;
+		}
+		m_entries[EntryKey(entry.type, entry.key)].assign(pEntryData, pEntryData + entry.size);
+	}
+	return true;
+}
+
+void PipelineCache::Serialize(std::vector<uint8_t>& data) const
+{
+	size_t size = sizeof(FileHeader);
+	for (const auto& entry : m_entries)
+	{
+		size += sizeof(EntryHeader) + entry.second.size();
+	}
+	data.resize(size);
+
+	FileHeader header = {};
+	header.magic = CacheMagic;
+	header.version = CacheVersion;
+	header.entryCount = static_cast<uint32_t>(m_entries.size());
+	memcpy(data.data(), &header, sizeof(header));
+
+	size_t offset = sizeof(header);
+	for (const auto& entry : m_entries)
+	{
+		EntryHeader entryHeader = {};
+		entryHeader.type = entry.first.first;
+		entryHeader.key = entry.first.second;
+		entryHeader.size = entry.second.size();
+		entryHeader.contentHash = HashContents(entry.second.data(), entry.second.size());
+		memcpy(data.data() + offset, &entryHeader, sizeof(entryHeader));
+		offset += sizeof(entryHeader);
+
+		if (!entry.second.empty())
+			memcpy(data.data() + offset, entry.second.data(), entry.second.size());
+		offset += entry.second.size();
+	}
+}
+
+const std::vector<uint8_t>* PipelineCache::Find(PipelineCacheBlob type, uint64_t key)
+{
+	const auto it = m_entries.find(EntryKey(static_cast<uint32_t>(type), key));
+	if (it == m_entries.end())
+	{
+		++m_stats.misses;
+		return nullptr;
+	}
+
+	++m_stats.hits;
+	return &it->second;
+}
+
+void PipelineCache::Store(PipelineCacheBlob type, uint64_t key, const void* pData, size_t size)
+{
+	const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+	m_entries[EntryKey(static_cast<uint32_t>(type), key)].assign(pBytes, pBytes + size);
+	m_dirty = true;
+	++m_stats.stores;
+}
@@ -0,0 +1,93 @@
+//*********************************************************
+//
+// PipelineCache.h
+//
+// In-memory store for the blobs that are slow to produce when a pipeline is
+// created: compiled shader bytecode, serialized root signatures and the
+// driver's pipeline state library. Each blob is looked up by its type and a
+// 64-bit key, which the backend builds with PipelineCacheKey from
+// everything that affects the blob (shader source text, entry point,
+// compiler flags, root parameters, formats and so on), so a changed input
+// simply misses.
+//
+// The cache serializes to one byte array that the backend writes to disk.
+// Every entry carries a hash of its contents; entries that fail it when
+// loaded are dropped, and a file from another format version is ignored.
+//
+// Like RenderDevice.h, these files only use the C++ standard library.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// 64-bit FNV-1a over everything added to it.
+class PipelineCacheKey
+{
+public:
+	PipelineCacheKey();
+
+	void AddBytes(const void* pData, size_t size);
+	void AddString(const char* pString);
+	void AddWideString(const wchar_t* pString);
+
+	// For plain values and structs without padding.
+	template<typename T> void AddValue(const T& value) { AddBytes(&value, sizeof(value)); }
+
+	uint64_t GetValue() const { return m_hash; }
+
+private:
+	uint64_t m_hash;
+};
+
+enum class PipelineCacheBlob : uint32_t
+{
+	ShaderBytecode,
+	RootSignature,
+	PipelineLibrary,
+};
+
+// Counters accumulate until ResetStats.
+struct PipelineCacheStats
+{
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t stores;
+	uint64_t droppedEntries;	// Entries that failed their content hash on load.
+};
+
+class PipelineCache
+{
+public:
+	PipelineCache();
+
+	// Replaces the contents with a serialized cache. Returns false, leaving the
+	// cache empty, if the data is not a cache of this version.
+	bool Deserialize(const void* pData, size_t size);
+	void Serialize(std::vector<uint8_t>& data) const;
+
+	// Returns the stored blob, or null on a miss. The pointer stays valid until
+	// the same blob is stored again or the cache is replaced.
+	const std::vector<uint8_t>* Find(PipelineCacheBlob type, uint64_t key);
+	void Store(PipelineCacheBlob type, uint64_t key, const void* pData, size_t size);
+
+	// True once something has been stored since the last Deserialize or MarkClean.
+	bool IsDirty() const { return m_dirty; }
+	void MarkClean() { m_dirty = false; }
+
+	uint32_t GetEntryCount() const { return static_cast<uint32_t>(m_entries.size()); }
+
+	const PipelineCacheStats& GetStats() const { return m_stats; }
+	void ResetStats();
+
+private:
+	typedef std::pair<uint32_t, uint64_t> EntryKey;
+
+	std::map<EntryKey, std::vector<uint8_t> > m_entries;
+	bool m_dirty;
+	PipelineCacheStats m_stats;
+};
@@ -0,0 +1,269 @@
+//*********************************************************
+//
+// RenderDevice.h
+//
+// Backend-agnostic device and command-recording interface used by
+// PBRSandbox12. The D3D12 backend drives the GPU; the null and software
+// backends run the same frame logic headless so CPU cost can be measured
+// without a window or a GPU.
+//
+// This header is deliberately free of Windows and D3D12 types.
+//
+//*********************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+// Opaque resource handles. Zero is never a valid handle.
+typedef uint32_t RenderBufferHandle;
+typedef uint32_t RenderTextureHandle;
+typedef uint32_t RenderPipelineHandle;
+
+enum class RenderBackend
+{
+	D3D12,
+	Null,			// Records and validates commands, executes nothing.
+	Software,		// Null backend plus a CPU depth/colour rasteriser.
+};
+
+enum class RenderBufferUsage
+{
+	Vertex,
+	Index,
+	Constant,		// CPU-writable and persistently mapped.
+};
+
+struct RenderBufferDesc
+{
+	RenderBufferUsage usage;
+	uint64_t sizeInBytes;
+	uint32_t strideInBytes;		// Vertex stride, or 2/4 for 16/32-bit indices.
+	const wchar_t* name;
+};
+
+enum class RenderTextureDimension
+{
+	Texture2D,
+	TextureCube,
+};
+
+enum class RenderShaderVisibility
+{
+	All,
+	Vertex,
+	Pixel,
+};
+
+enum class RenderDescriptorType
+{
+	ConstantBuffer,
+	ShaderResource,
+};
+
+struct RenderDescriptorRange
+{
+	RenderDescriptorType type;
+	uint32_t count;
+	uint32_t baseRegister;
+};
+
+enum class RenderRootParameterType
+{
+	DescriptorTable,
+	ConstantBuffer,
+};
+
+static const uint32_t RenderMaxFramesInFlight = 4;
+static const uint32_t RenderMaxWorkerCommandLists = 16;
+static const uint32_t RenderMaxRootParameters = 8;
+static const uint32_t RenderMaxRangesPerTable = 4;
+
+struct RenderRootParameter
+{
+	RenderRootParameterType type;
+	RenderShaderVisibility visibility;
+	uint32_t shaderRegister;			// ConstantBuffer only.
+	uint32_t rangeCount;				// DescriptorTable only.
+	RenderDescriptorRange ranges[RenderMaxRangesPerTable];
+};
+
+enum class RenderVertexFormat
+{
+	Float2,
+	Float3,
+	Float4,
+};
+
+struct RenderVertexElement
+{
+	const char* semantic;
+	RenderVertexFormat format;
+	uint32_t offset;
+};
+
+// The first input element must be the position; the software backend
+// transforms it by the first vertex-visible b0 constant buffer.
+struct RenderPipelineDesc
+{
+	const wchar_t* shaderFile;
+	const char* vertexShaderEntry;
+	const char* pixelShaderEntry;
+	const RenderRootParameter* rootParameters;
+	uint32_t rootParameterCount;
+	const RenderVertexElement* inputElements;
+	uint32_t inputElementCount;
+	uint32_t instanceConstantStride;	// Bytes between per-instance entries in b0, or 0 if instances share one.
+};
+
+struct RenderViewport
+{
+	float x;
+	float y;
+	float width;
+	float height;
+	float minDepth;
+	float maxDepth;
+};
+
+struct RenderDeviceDesc
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t descriptorCount;	// Shader-visible CBV/SRV slots.
+	uint32_t stagingDescriptorCount;	// CPU-only CBV/SRV slots, may be zero.
+	uint32_t framesInFlight;	// 1 to RenderMaxFramesInFlight.
+	uint32_t workerCommandLists;	// 0 to RenderMaxWorkerCommandLists, for parallel recording.
+	void* window;				// HWND for the D3D12 backend, ignored headless.
+	bool useWarpDevice;
+	const wchar_t* pipelineCacheFile;	// D3D12 only: file caching compiled pipelines, or null for none.
+};
+
+// Counters accumulate until ResetStats. commandBytes is the size of the
+// recorded command stream for the null/software backends and an estimate
+// of the API argument payload for D3D12.
+struct RenderStats
+{
+	uint64_t frames;
+	uint64_t commands;
+	uint64_t commandBytes;
+	uint64_t drawCalls;
+	uint64_t instances;
+	uint64_t primitives;
+	uint64_t pipelineChanges;
+	uint64_t bufferBytes;
+	uint64_t textureCount;
+	uint64_t validationErrors;
+	uint64_t pixelsWritten;		// Software backend only.
+	uint64_t frameWaits;		// BeginFrame calls that blocked on the GPU.
+	uint64_t frameWaitMicroseconds;
+	uint64_t descriptorCopies;		// Staging descriptors copied to shader-visible slots.
+	uint64_t descriptorCopyBatches;	// Batched copy calls issued for them.
+	uint64_t workerCommandLists;	// Worker command lists submitted.
+	uint64_t pipelinesCreated;
+	uint64_t pipelineCreateMicroseconds;	// Time spent in CreatePipeline.
+	uint64_t pipelineCacheHits;		// Shaders, root signatures and pipeline states loaded from the cache (D3D12).
+	uint64_t pipelineCacheMisses;	// The same, built from scratch.
+};
+
+// Adds the counters a command list records to a device total.
+inline void AccumulateCommandStats(RenderStats& total, const RenderStats& list)
+{
+	total.commands += list.commands;
+	total.commandBytes += list.commandBytes;
+	total.drawCalls += list.drawCalls;
+	total.instances += list.instances;
+	total.primitives += list.primitives;
+	total.pipelineChanges += list.pipelineChanges;
+	total.validationErrors += list.validationErrors;
+}
+
+class RenderCommandList
+{
+public:
+	virtual ~RenderCommandList() {}
+
+	virtual void SetPipeline(RenderPipelineHandle pipeline) = 0;
+	virtual void SetViewport(const RenderViewport& viewport) = 0;
+	virtual void ClearRenderTarget(const float color[4]) = 0;
+	virtual void ClearDepth(float depth) = 0;
+
+	// Tables are addressed by the first descriptor slot they cover.
+	virtual void SetRootDescriptorTable(uint32_t rootIndex, uint32_t firstSlot) = 0;
+	virtual void SetRootConstantBuffer(uint32_t rootIndex, RenderBufferHandle buffer, uint64_t offset) = 0;
+
+	virtual void SetVertexBuffer(RenderBufferHandle buffer) = 0;
+	virtual void SetIndexBuffer(RenderBufferHandle buffer) = 0;
+	virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+		uint32_t startIndex, int32_t baseVertex, uint32_t startInstance) = 0;
+};
+
+class RenderDevice
+{
+public:
+	virtual ~RenderDevice() {}
+
+	virtual RenderBackend GetBackend() const = 0;
+
+	// Resources. Creation failures throw; handles stay valid for the device lifetime.
+	virtual RenderBufferHandle CreateBuffer(const RenderBufferDesc& desc, const void* initialData) = 0;
+	virtual void* MapBuffer(RenderBufferHandle buffer) = 0;
+	virtual RenderTextureHandle LoadTexture(const wchar_t* filename, RenderTextureDimension dimension) = 0;
+	virtual RenderPipelineHandle CreatePipeline(const RenderPipelineDesc& desc) = 0;
+
+	// Views are written to shader-visible descriptor slots.
+	virtual void CreateConstantBufferView(uint32_t slot, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes) = 0;
+	virtual void CreateTextureView(uint32_t slot, RenderTextureHandle texture) = 0;
+
+	// Staging slots are CPU-only; shaders see their views once copied into shader-visible slots.
+	virtual void CreateStagingConstantBufferView(uint32_t stagingSlot, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes) = 0;
+	virtual void CreateStagingTextureView(uint32_t stagingSlot, RenderTextureHandle texture) = 0;
+
+	// Copies count staging descriptors to shader-visible slots. Copies are queued and
+	// flushed in as few batches as possible before the frame is submitted.
+	virtual void CopyDescriptors(uint32_t dstSlot, uint32_t srcStagingSlot, uint32_t count) = 0;
+
+	// Submits pending texture uploads and waits for them to complete.
+	virtual void FinishUploads() = 0;
+
+	// Writes the pipeline cache file if pipelines were added to it since it
+	// was loaded. Call once the startup pipelines have been created.
+	virtual void SavePipelineCache() = 0;
+
+	// Frame recording. The command list is valid until EndFrame, which submits and presents.
+	// Up to framesInFlight frames may be queued on the GPU; BeginFrame only blocks
+	// once the frame context it is about to reuse is still executing.
+	virtual RenderCommandList* BeginFrame() = 0;
+	virtual void EndFrame() = 0;
+	virtual void WaitForIdle() = 0;
+
+	// Parallel recording. Between BeginFrame and EndFrame each worker list may be
+	// opened, recorded and closed on its own thread; different lists never share
+	// state. EndFrame submits the frame list first, then the worker lists that were
+	// recorded, in index order. A worker list starts with the frame's render
+	// targets bound but no pipeline, viewport or root arguments.
+	virtual uint32_t GetWorkerCommandListCount() const = 0;
+	virtual RenderCommandList* BeginWorkerCommandList(uint32_t worker) = 0;
+	virtual void EndWorkerCommandList(uint32_t worker) = 0;
+
+	// Index of the frame context being recorded, in [0, GetFramesInFlight()).
+	// Per-frame CPU-written data should be sliced by this index.
+	virtual uint32_t GetFramesInFlight() const = 0;
+	virtual uint32_t GetFrameIndex() const = 0;
+
+	// Fence value the frame being recorded signals when it retires, and the most
+	// recently retired value. Both increase monotonically; data written for a
+	// frame may be reused once GetCompletedFence() >= the frame's fence.
+	virtual uint64_t GetFrameFence() const = 0;
+	virtual uint64_t GetCompletedFence() const = 0;
+
+	virtual const RenderStats& GetStats() const = 0;
+	virtual void ResetStats() = 0;
+};
+
+// Creates any backend. Defined with the D3D12 backend, so Windows only.
+std::unique_ptr<RenderDevice> CreateRenderDevice(RenderBackend backend, const RenderDeviceDesc& desc);
+
+// Creates the null or software backend. Has no platform dependencies.
+std::unique_ptr<RenderDevice> CreateHeadlessRenderDevice(RenderBackend backend, const RenderDeviceDesc& desc);
@@ -0,0 +1,1197 @@
+//*********************************************************
+//
+// RenderDeviceD3D12.cpp
+//
+// D3D12 render backend.
+//
+//*********************************************************
+
+#include "stdafx.h"
+#include "DXSampleHelper.h"
+#include "RenderDeviceD3D12.h"
+
+#include "DDSTextureLoader12.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+	// Picks the first hardware adapter that supports Direct3D 12.
+	void GetHardwareAdapter(IDXGIFactory2* pFactory, IDXGIAdapter1** ppAdapter)
+	{
+		ComPtr<IDXGIAdapter1> adapter;
+		*ppAdapter = nullptr;
+
+		for (UINT adapterIndex = 0; DXGI_ERROR_NOT_FOUND != pFactory->EnumAdapters1(adapterIndex, &adapter); ++adapterIndex)
+		{
+			DXGI_ADAPTER_DESC1 desc;
+			adapter->GetDesc1(&desc);
+
+			if (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE)
+				continue;
+
+			if (SUCCEEDED(D3D12CreateDevice(adapter.Get(), D3D_FEATURE_LEVEL_11_0, _uuidof(ID3D12Device), nullptr)))
+				break;
+		}
+
+		*ppAdapter = adapter.Detach();
+	}
+
+	D3D12_SHADER_VISIBILITY ToShaderVisibility(RenderShaderVisibility visibility)
+	{
+		switch (visibility)
+		{
+		case RenderShaderVisibility::Vertex:	return D3D12_SHADER_VISIBILITY_VERTEX;
+		case RenderShaderVisibility::Pixel:		return D3D12_SHADER_VISIBILITY_PIXEL;
+		default:								return D3D12_SHADER_VISIBILITY_ALL;
+		}
+	}
+
+	DXGI_FORMAT ToVertexFormat(RenderVertexFormat format)
+	{
+		switch (format)
+		{
+		case RenderVertexFormat::Float2:	return DXGI_FORMAT_R32G32_FLOAT;
+		case RenderVertexFormat::Float3:	return DXGI_FORMAT_R32G32B32_FLOAT;
+		default:							return DXGI_FORMAT_R32G32B32A32_FLOAT;
+		}
+	}
+
+	// Change this whenever the way a cached blob is built changes (the static
+	// sampler, root signature flags, pipeline state defaults), so that old
+	// entries miss.
+	const uint32_t PipelineCacheVersion = 1;
+
+#if defined(_DEBUG)
+	// Enable better shader debugging with the graphics debugging tools.
+	const UINT ShaderCompileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+	const UINT ShaderCompileFlags = 0;
+#endif
+
+	ComPtr<ID3DBlob> CompileShader(const std::vector<uint8_t>& source, const char* entryPoint, const char* target)
+	{
+		ComPtr<ID3DBlob> shader;
+		ComPtr<ID3DBlob> errorBlob;
+		HRESULT hr = D3DCompile(source.data(), source.size(), nullptr, nullptr, nullptr, entryPoint, target, ShaderCompileFlags, 0, &shader, &errorBlob);
+		if (FAILED(hr))
+		{
+			if (errorBlob)
+			{
+				OutputDebugStringA(reinterpret_cast<const char*>(errorBlob->GetBufferPointer()));
+			}
+
+			ThrowIfFailed(hr);
+		}
+
+		return shader;
+	}
+
+	bool ReadWholeFile(const wchar_t* filename, std::vector<uint8_t>& data)
+	{
+		HANDLE file = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size = {};
+		bool succeeded = GetFileSizeEx(file, &size) && !size.HighPart;
+		if (succeeded)
+		{
+			DWORD bytesRead = 0;
+			data.resize(size.LowPart);
+			succeeded = !size.LowPart || (ReadFile(file, data.data(), size.LowPart, &bytesRead, nullptr) && bytesRead == size.LowPart);
+		}
+
+		CloseHandle(file);
+		return succeeded;
+	}
+
+	// Writes to a temporary file first, so an interrupted write never leaves a
+	// half-written file behind.
+	bool WriteWholeFile(const wchar_t* filename, const std::vector<uint8_t>& data)
+	{
+		const std::wstring temporaryName = std::wstring(filename) + L".tmp";
+		HANDLE file = CreateFileW(temporaryName.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		DWORD bytesWritten = 0;
+		const bool succeeded = WriteFile(file, data.data(), static_cast<DWORD>(data.size()), &bytesWritten, nullptr) && bytesWritten == data.size();
+		CloseHandle(file);
+
+		if (!succeeded || !MoveFileExW(temporaryName.c_str(), filename, MOVEFILE_REPLACE_EXISTING))
+		{
+			DeleteFileW(temporaryName.c_str());
+			return false;
+		}
+		return true;
+	}
+}
+
+D3D12RenderDevice::D3D12RenderDevice(const RenderDeviceDesc& desc) :
+	m_desc(desc),
+	m_stats(),
+	m_srvDescriptorSize(0),
+	m_rtvDescriptorSize(0),
+	m_pipelineLibraryKey(0),
+	m_pipelineLibraryDirty(false),
+	m_uploadsPending(true),
+	m_frames(),
+	m_frameCommandList(this),
+	m_backBufferCount(0),
+	m_backBufferIndex(0),
+	m_frameIndex(0),
+	m_fenceEvent(nullptr),
+	m_fenceValue(0)
+{
+	if (!desc.framesInFlight || desc.framesInFlight > RenderMaxFramesInFlight ||
+		desc.workerCommandLists > RenderMaxWorkerCommandLists)
+		throw HrException(E_INVALIDARG);
+
+	m_backBufferCount = std::max<UINT>(2, desc.framesInFlight);
+
+	UINT dxgiFactoryFlags = 0;
+
+#if defined(_DEBUG)
+	// Enable the debug layer (requires the Graphics Tools "optional feature").
+	// NOTE: Enabling the debug layer after device creation will invalidate the active device.
+	{
+		ComPtr<ID3D12Debug> debugController;
+		if (SUCCEEDED(D3D12GetDebugInterface(IID_PPV_ARGS(&debugController))))
+		{
+			debugController->EnableDebugLayer();
+
+			// Enable additional debug layers.
+			dxgiFactoryFlags |= DXGI_CREATE_FACTORY_DEBUG;
+		}
+	}
+#endif
+
+	ComPtr<IDXGIFactory4> factory;
+	ThrowIfFailed(CreateDXGIFactory2(dxgiFactoryFlags, IID_PPV_ARGS(&factory)));
+
+	if (desc.useWarpDevice)
+	{
+		ComPtr<IDXGIAdapter> warpAdapter;
+		ThrowIfFailed(factory->EnumWarpAdapter(IID_PPV_ARGS(&warpAdapter)));
+
+		ThrowIfFailed(D3D12CreateDevice(
+			warpAdapter.Get(),
+			D3D_FEATURE_LEVEL_11_0,
+			IID_PPV_ARGS(&m_device)
+			));
+	}
+	else
+	{
+		ComPtr<IDXGIAdapter1> hardwareAdapter;
+		GetHardwareAdapter(factory.Get(), &hardwareAdapter);
+
+		ThrowIfFailed(D3D12CreateDevice(
+			hardwareAdapter.Get(),
+			D3D_FEATURE_LEVEL_11_0,
+			IID_PPV_ARGS(&m_device)
+			));
+	}
+
+	LoadPipelineCache(factory.Get());
+
+	// Describe and create the command queue.
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+
+	ThrowIfFailed(m_device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_commandQueue)));
+
+	// Describe and create the swap chain.
+	const HWND hwnd = static_cast<HWND>(desc.window);
+
+	DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
+	swapChainDesc.BufferCount = m_backBufferCount;
+	swapChainDesc.Width = desc.width;
+	swapChainDesc.Height = desc.height;
+	swapChainDesc.Format = BackBufferFormat;
+	swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+	swapChainDesc.SampleDesc.Count = 1;
+
+	ComPtr<IDXGISwapChain1> swapChain;
+	ThrowIfFailed(factory->CreateSwapChainForHwnd(
+		m_commandQueue.Get(),		// Swap chain needs the queue so that it can force a flush on it.
+		hwnd,
+		&swapChainDesc,
+		nullptr,
+		nullptr,
+		&swapChain
+		));
+
+	// This sample does not support fullscreen transitions.
+	ThrowIfFailed(factory->MakeWindowAssociation(hwnd, DXGI_MWA_NO_ALT_ENTER));
+
+	ThrowIfFailed(swapChain.As(&m_swapChain));
+	m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+
+	// Create descriptor heaps.
+	{
+		D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
+		srvHeapDesc.NumDescriptors = desc.descriptorCount;
+		srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+		srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+		ThrowIfFailed(m_device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&m_srvHeap)));
+
+		// Describe and create the CPU-only staging heap that views are copied from.
+		if (desc.stagingDescriptorCount)
+		{
+			D3D12_DESCRIPTOR_HEAP_DESC stagingHeapDesc = {};
+			stagingHeapDesc.NumDescriptors = desc.stagingDescriptorCount;
+			stagingHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+			stagingHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+			ThrowIfFailed(m_device->CreateDescriptorHeap(&stagingHeapDesc, IID_PPV_ARGS(&m_stagingHeap)));
+			NAME_D3D12_OBJECT(m_stagingHeap);
+		}
+
+		m_srvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+		// Describe and create a render target view (RTV) descriptor heap.
+		D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
+		rtvHeapDesc.NumDescriptors = m_backBufferCount;
+		rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+		rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+		ThrowIfFailed(m_device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&m_rtvHeap)));
+
+		m_rtvDescriptorSize = m_device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+
+		// Describe and create a depth stencil target view (DSV) descriptor heap.
+		D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
+		dsvHeapDesc.NumDescriptors = 1;
+		dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
+		dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+		ThrowIfFailed(m_device->CreateDescriptorHeap(&dsvHeapDesc, IID_PPV_ARGS(&m_dsvHeap)));
+	}
+
+	// Create a RTV for each back buffer.
+	{
+		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_rtvHeap->GetCPUDescriptorHandleForHeapStart());
+
+		for (UINT n = 0; n < m_backBufferCount; n++)
+		{
+			ThrowIfFailed(m_swapChain->GetBuffer(n, IID_PPV_ARGS(&m_renderTargets[n])));
+			m_device->CreateRenderTargetView(m_renderTargets[n].Get(), nullptr, rtvHandle);
+			rtvHandle.Offset(1, m_rtvDescriptorSize);
+		}
+	}
+
+	// Depth Stencil Target
+	{
+		CD3DX12_HEAP_PROPERTIES depthHeapProperties(D3D12_HEAP_TYPE_DEFAULT);
+
+		D3D12_RESOURCE_DESC depthStencilDesc = CD3DX12_RESOURCE_DESC::Tex2D(
+			DepthBufferFormat,
+			desc.width,
+			desc.height,
+			1,
+			1
+		);
+		depthStencilDesc.Flags |= D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL;
+
+		D3D12_CLEAR_VALUE depthOptimizedClearValue = {};
+		depthOptimizedClearValue.Format = DepthBufferFormat;
+		depthOptimizedClearValue.DepthStencil.Depth = 1.0f;
+		depthOptimizedClearValue.DepthStencil.Stencil = 0;
+
+		ThrowIfFailed(m_device->CreateCommittedResource(
+			&depthHeapProperties,
+			D3D12_HEAP_FLAG_NONE,
+			&depthStencilDesc,
+			D3D12_RESOURCE_STATE_DEPTH_WRITE,
+			&depthOptimizedClearValue,
+			IID_PPV_ARGS(m_depthStencil.ReleaseAndGetAddressOf())
+		));
+
+		m_depthStencil->SetName(L"Depth stencil");
+
+		D3D12_DEPTH_STENCIL_VIEW_DESC dsvDesc = {};
+		dsvDesc.Format = DepthBufferFormat;
+		dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2D;
+
+		m_device->CreateDepthStencilView(m_depthStencil.Get(), &dsvDesc, m_dsvHeap->GetCPUDescriptorHandleForHeapStart());
+	}
+
+	for (UINT n = 0; n < desc.framesInFlight; n++)
+	{
+		FrameContext& frame = m_frames[n];
+		ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&frame.commandAllocator)));
+		SetNameIndexed(frame.commandAllocator.Get(), L"m_frames.commandAllocator", n);
+		ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&frame.overlayAllocator)));
+		SetNameIndexed(frame.overlayAllocator.Get(), L"m_frames.overlayAllocator", n);
+
+		// Each worker thread records with its own allocator so no allocator is shared across threads.
+		for (UINT w = 0; w < desc.workerCommandLists; w++)
+		{
+			ThrowIfFailed(m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&frame.workerAllocators[w])));
+			SetNameIndexed(frame.workerAllocators[w].Get(), L"m_frames.workerAllocators", n * RenderMaxWorkerCommandLists + w);
+		}
+	}
+
+	// The command list starts open so that texture uploads can be recorded
+	// into it; FinishUploads closes and submits it.
+	ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_frames[m_frameIndex].commandAllocator.Get(), nullptr, IID_PPV_ARGS(&m_commandList)));
+	NAME_D3D12_OBJECT(m_commandList);
+
+	// The overlay and worker lists are opened per frame.
+	ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_frames[m_frameIndex].overlayAllocator.Get(), nullptr, IID_PPV_ARGS(&m_overlayCommandList)));
+	NAME_D3D12_OBJECT(m_overlayCommandList);
+	ThrowIfFailed(m_overlayCommandList->Close());
+
+	m_workerCommandLists.resize(desc.workerCommandLists);
+	for (UINT w = 0; w < desc.workerCommandLists; w++)
+	{
+		WorkerCommandList& worker = m_workerCommandLists[w];
+		ThrowIfFailed(m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, m_frames[m_frameIndex].workerAllocators[w].Get(), nullptr, IID_PPV_ARGS(&worker.commandList)));
+		SetNameIndexed(worker.commandList.Get(), L"m_workerCommandLists", w);
+		ThrowIfFailed(worker.commandList->Close());
+
+		worker.recorder.reset(new CommandList(this));
+		worker.state = ListState::Idle;
+	}
+
+	// Create synchronization objects.
+	ThrowIfFailed(m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_fence)));
+	m_fenceValue = 1;
+
+	m_fenceEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	if (m_fenceEvent == nullptr)
+	{
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+	}
+}
+
+D3D12RenderDevice::~D3D12RenderDevice()
+{
+	if (m_fenceEvent)
+	{
+		CloseHandle(m_fenceEvent);
+	}
+}
+
+RenderBufferHandle D3D12RenderDevice::CreateBuffer(const RenderBufferDesc& desc, const void* initialData)
+{
+	if (!desc.sizeInBytes)
+		throw HrException(E_INVALIDARG);
+
+	if (desc.usage == RenderBufferUsage::Index && desc.strideInBytes != 2 && desc.strideInBytes != 4)
+		throw HrException(E_INVALIDARG);
+
+	Buffer buffer = {};
+	buffer.usage = desc.usage;
+	buffer.strideInBytes = desc.strideInBytes;
+	buffer.sizeInBytes = desc.sizeInBytes;
+
+	// Geometry is small enough to live in the upload heap, as Model did.
+	ThrowIfFailed(m_device->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(desc.sizeInBytes),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&buffer.resource)));
+
+	if (desc.name)
+	{
+		SetName(buffer.resource.Get(), desc.name);
+	}
+
+	void* pData;
+	CD3DX12_RANGE readRange(0, 0);		// We do not intend to read from this resource on the CPU.
+	ThrowIfFailed(buffer.resource->Map(0, &readRange, &pData));
+
+	if (initialData)
+	{
+		memcpy(pData, initialData, static_cast<size_t>(desc.sizeInBytes));
+	}
+
+	// Constant buffers stay mapped for the lifetime of the device.
+	if (desc.usage == RenderBufferUsage::Constant)
+	{
+		buffer.pMapped = pData;
+	}
+	else
+	{
+		buffer.resource->Unmap(0, nullptr);
+	}
+
+	m_buffers.push_back(buffer);
+	m_stats.bufferBytes += desc.sizeInBytes;
+
+	return static_cast<RenderBufferHandle>(m_buffers.size());
+}
+
+void* D3D12RenderDevice::MapBuffer(RenderBufferHandle buffer)
+{
+	const Buffer& b = GetBuffer(buffer);
+	if (!b.pMapped)
+		throw HrException(E_INVALIDARG);
+
+	return b.pMapped;
+}
+
+RenderTextureHandle D3D12RenderDevice::LoadTexture(const wchar_t* filename, RenderTextureDimension dimension)
+{
+	if (!m_uploadsPending)
+	{
+		// Reopen the command list for another batch of uploads once the
+		// current frame context is no longer in use.
+		ID3D12CommandAllocator* pAllocator = m_frames[m_frameIndex].commandAllocator.Get();
+		WaitForFence(m_frames[m_frameIndex].fenceValue);
+		ThrowIfFailed(pAllocator->Reset());
+		ThrowIfFailed(m_commandList->Reset(pAllocator, nullptr));
+		m_uploadsPending = true;
+	}
+
+	Texture texture;
+	texture.dimension = dimension;
+
+	// Load texture from DDS.
+	bool isCubeMap = false;
+	std::unique_ptr<uint8_t[]> ddsData;
+	std::vector<D3D12_SUBRESOURCE_DATA> subresouceData;
+	ThrowIfFailed(LoadDDSTextureFromFile(m_device.Get(), filename, texture.resource.ReleaseAndGetAddressOf(), ddsData, subresouceData, 0Ui64, nullptr, &isCubeMap));
+	SetName(texture.resource.Get(), filename);
+
+	const UINT subresoucesize = static_cast<UINT>(subresouceData.size());
+	const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.resource.Get(), 0, subresoucesize);
+
+	ComPtr<ID3D12Resource> textureUploadHeap;
+	ThrowIfFailed(m_device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize), D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&textureUploadHeap)));
+
+	UpdateSubresources(m_commandList.Get(), texture.resource.Get(), textureUploadHeap.Get(), 0, 0, subresoucesize, &subresouceData[0]);
+	m_commandList->ResourceBarrier(1,
+		&CD3DX12_RESOURCE_BARRIER::Transition(texture.resource.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST,
+			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+	m_textureUploadHeaps.push_back(textureUploadHeap);
+	m_textures.push_back(texture);
+	++m_stats.textureCount;
+
+	return static_cast<RenderTextureHandle>(m_textures.size());
+}
+
+RenderPipelineHandle D3D12RenderDevice::CreatePipeline(const RenderPipelineDesc& desc)
+{
+	if (desc.rootParameterCount > RenderMaxRootParameters || !desc.inputElementCount)
+		throw HrException(E_INVALIDARG);
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	Pipeline pipeline;
+	PipelineCacheKey pipelineKey;
+	pipelineKey.AddValue(PipelineCacheVersion);
+
+	// Root signature.
+	{
+		D3D12_FEATURE_DATA_ROOT_SIGNATURE featureData = {};
+
+		// This is the highest version the sample supports. If CheckFeatureSupport succeeds, the HighestVersion returned will not be greater than this.
+		featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_1;
+
+		if (FAILED(m_device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
+		{
+			featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
+		}
+
+		// Only the fields each parameter type uses go into the key.
+		PipelineCacheKey rootSignatureKey;
+		rootSignatureKey.AddValue(PipelineCacheVersion);
+		rootSignatureKey.AddValue(featureData.HighestVersion);
+		rootSignatureKey.AddValue(desc.rootParameterCount);
+
+		CD3DX12_DESCRIPTOR_RANGE1 ranges[RenderMaxRootParameters][RenderMaxRangesPerTable];
+		CD3DX12_ROOT_PARAMETER1 rootParameters[RenderMaxRootParameters];
+
+		for (UINT i = 0; i < desc.rootParameterCount; ++i)
+		{
+			const RenderRootParameter& parameter = desc.rootParameters[i];
+			const D3D12_SHADER_VISIBILITY visibility = ToShaderVisibility(parameter.visibility);
+			rootSignatureKey.AddValue(parameter.type);
+			rootSignatureKey.AddValue(parameter.visibility);
+
+			if (parameter.type == RenderRootParameterType::ConstantBuffer)
+			{
+				rootParameters[i].InitAsConstantBufferView(parameter.shaderRegister, 0, D3D12_ROOT_DESCRIPTOR_FLAG_DATA_VOLATILE, visibility);
+				rootSignatureKey.AddValue(parameter.shaderRegister);
+			}
+			else
+			{
+				if (!parameter.rangeCount || parameter.rangeCount > RenderMaxRangesPerTable)
+					throw HrException(E_INVALIDARG);
+
+				for (UINT r = 0; r < parameter.rangeCount; ++r)
+				{
+					const RenderDescriptorRange& range = parameter.ranges[r];
+					ranges[i][r].Init(
+						(range.type == RenderDescriptorType::ConstantBuffer) ? D3D12_DESCRIPTOR_RANGE_TYPE_CBV : D3D12_DESCRIPTOR_RANGE_TYPE_SRV,
+						range.count, range.baseRegister, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_VOLATILE);
+				}
+				rootParameters[i].InitAsDescriptorTable(parameter.rangeCount, ranges[i], visibility);
+				rootSignatureKey.AddValue(parameter.rangeCount);
+				rootSignatureKey.AddBytes(parameter.ranges, sizeof(RenderDescriptorRange) * parameter.rangeCount);
+			}
+		}
+
+		const std::vector<uint8_t>* pCached = m_pipelineCache.Find(PipelineCacheBlob::RootSignature, rootSignatureKey.GetValue());
+		if (pCached)
+		{
+			++m_stats.pipelineCacheHits;
+			ThrowIfFailed(m_device->CreateRootSignature(0, pCached->data(), pCached->size(), IID_PPV_ARGS(&pipeline.rootSignature)));
+		}
+		else
+		{
+			++m_stats.pipelineCacheMisses;
+
+			// Allow input layout and deny uneccessary access to certain pipeline stages.
+			D3D12_ROOT_SIGNATURE_FLAGS rootSignatureFlags =
+				D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+				D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+				D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+				D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS;
+
+			D3D12_STATIC_SAMPLER_DESC sampler = {};
+			sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+			sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+			sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+			sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_WRAP;
+			sampler.MipLODBias = 0;
+			sampler.MaxAnisotropy = 0;
+			sampler.ComparisonFunc = D3D12_COMPARISON_FUNC_NEVER;
+			sampler.BorderColor = D3D12_STATIC_BORDER_COLOR_TRANSPARENT_BLACK;
+			sampler.MinLOD = 0.0f;
+			sampler.MaxLOD = D3D12_FLOAT32_MAX;
+			sampler.ShaderRegister = 0;
+			sampler.RegisterSpace = 0;
+			sampler.ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+			CD3DX12_VERSIONED_ROOT_SIGNATURE_DESC rootSignatureDesc;
+			rootSignatureDesc.Init_1_1(desc.rootParameterCount, rootParameters, 1, &sampler, rootSignatureFlags);
+
+			ComPtr<ID3DBlob> signature;
+			ComPtr<ID3DBlob> error;
+			ThrowIfFailed(D3DX12SerializeVersionedRootSignature(&rootSignatureDesc, featureData.HighestVersion, &signature, &error));
+			ThrowIfFailed(m_device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&pipeline.rootSignature)));
+			m_pipelineCache.Store(PipelineCacheBlob::RootSignature, rootSignatureKey.GetValue(), signature->GetBufferPointer(), signature->GetBufferSize());
+		}
+		pipelineKey.AddValue(rootSignatureKey.GetValue());
+	}
+
+	// Create the pipeline state, which includes compiling and loading shaders.
+	{
+		std::vector<uint8_t> vertexShader;
+		std::vector<uint8_t> pixelShader;
+		pipelineKey.AddValue(GetShaderBytecode(desc.shaderFile, desc.vertexShaderEntry, "vs_5_0", vertexShader));
+		pipelineKey.AddValue(GetShaderBytecode(desc.shaderFile, desc.pixelShaderEntry, "ps_5_0", pixelShader));
+
+		std::vector<D3D12_INPUT_ELEMENT_DESC> inputElementDescs(desc.inputElementCount);
+		for (UINT i = 0; i < desc.inputElementCount; ++i)
+		{
+			const RenderVertexElement& element = desc.inputElements[i];
+			inputElementDescs[i] = { element.semantic, 0, ToVertexFormat(element.format), 0, element.offset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 };
+
+			pipelineKey.AddString(element.semantic);
+			pipelineKey.AddValue(element.format);
+			pipelineKey.AddValue(element.offset);
+		}
+		pipelineKey.AddValue(BackBufferFormat);
+		pipelineKey.AddValue(DepthBufferFormat);
+
+		// Describe and create the graphics pipeline state object (PSO).
+		D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+		psoDesc.InputLayout = { inputElementDescs.data(), static_cast<UINT>(inputElementDescs.size()) };
+		psoDesc.pRootSignature = pipeline.rootSignature.Get();
+		psoDesc.VS = { vertexShader.data(), vertexShader.size() };
+		psoDesc.PS = { pixelShader.data(), pixelShader.size() };
+		psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+		psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+		psoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+		psoDesc.SampleMask = UINT_MAX;
+		psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+		psoDesc.NumRenderTargets = 1;
+		psoDesc.RTVFormats[0] = BackBufferFormat;
+		psoDesc.DSVFormat = DepthBufferFormat;
+		psoDesc.SampleDesc.Count = 1;
+
+		// The library finds pipelines by name; the name is the key of the whole description.
+		wchar_t pipelineName[32];
+		swprintf_s(pipelineName, L"%016llx", static_cast<unsigned long long>(pipelineKey.GetValue()));
+
+		if (m_pipelineLibrary && SUCCEEDED(m_pipelineLibrary->LoadGraphicsPipeline(pipelineName, &psoDesc, IID_PPV_ARGS(&pipeline.pipelineState))))
+		{
+			++m_stats.pipelineCacheHits;
+		}
+		else
+		{
+			++m_stats.pipelineCacheMisses;
+			ThrowIfFailed(m_device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipeline.pipelineState)));
+
+			if (m_pipelineLibrary && SUCCEEDED(m_pipelineLibrary->StorePipeline(pipelineName, pipeline.pipelineState.Get())))
+			{
+				m_pipelineLibraryDirty = true;
+			}
+		}
+	}
+
+	m_pipelines.push_back(pipeline);
+	++m_stats.pipelinesCreated;
+	m_stats.pipelineCreateMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	return static_cast<RenderPipelineHandle>(m_pipelines.size());
+}
+
+// Returns the key of the bytecode, which covers the source text, so editing
+// the shader file recompiles it.
+uint64_t D3D12RenderDevice::GetShaderBytecode(const wchar_t* filename, const char* entryPoint, const char* target, std::vector<uint8_t>& bytecode)
+{
+	std::vector<uint8_t> source;
+	if (!ReadWholeFile(filename, source))
+		ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+
+	PipelineCacheKey key;
+	key.AddValue(PipelineCacheVersion);
+	key.AddBytes(source.data(), source.size());
+	key.AddString(entryPoint);
+	key.AddString(target);
+	key.AddValue(ShaderCompileFlags);
+
+	const std::vector<uint8_t>* pCached = m_pipelineCache.Find(PipelineCacheBlob::ShaderBytecode, key.GetValue());
+	if (pCached)
+	{
+		++m_stats.pipelineCacheHits;
+		bytecode = *pCached;
+		return key.GetValue();
+	}
+
+	++m_stats.pipelineCacheMisses;
+	ComPtr<ID3DBlob> shader = CompileShader(source, entryPoint, target);
+	const uint8_t* pBytes = static_cast<const uint8_t*>(shader->GetBufferPointer());
+	bytecode.assign(pBytes, pBytes + shader->GetBufferSize());
+	m_pipelineCache.Store(PipelineCacheBlob::ShaderBytecode, key.GetValue(), bytecode.data(), bytecode.size());
+	return key.GetValue();
+}
+
+void D3D12RenderDevice::LoadPipelineCache(IDXGIFactory4* pFactory)
+{
+	if (!m_desc.pipelineCacheFile)
+		return;
+
+	// A missing or unreadable file just means a cold start.
+	std::vector<uint8_t> file;
+	if (ReadWholeFile(m_desc.pipelineCacheFile, file))
+	{
+		m_pipelineCache.Deserialize(file.data(), file.size());
+	}
+
+	// Pipeline libraries need ID3D12Device1. A library only loads on the
+	// adapter and driver that wrote it, so they are part of its key.
+	ComPtr<ID3D12Device1> device1;
+	if (FAILED(m_device.As(&device1)))
+		return;
+
+	DXGI_ADAPTER_DESC1 adapterDesc = {};
+	LARGE_INTEGER driverVersion = {};
+	ComPtr<IDXGIAdapter1> adapter;
+	if (SUCCEEDED(pFactory->EnumAdapterByLuid(m_device->GetAdapterLuid(), IID_PPV_ARGS(&adapter))))
+	{
+		adapter->GetDesc1(&adapterDesc);
+		adapter->CheckInterfaceSupport(__uuidof(IDXGIDevice), &driverVersion);
+	}
+
+	PipelineCacheKey libraryKey;
+	libraryKey.AddValue(PipelineCacheVersion);
+	libraryKey.AddValue(adapterDesc.VendorId);
+	libraryKey.AddValue(adapterDesc.DeviceId);
+	libraryKey.AddValue(adapterDesc.SubSysId);
+	libraryKey.AddValue(adapterDesc.Revision);
+	libraryKey.AddValue(driverVersion.QuadPart);
+	m_pipelineLibraryKey = libraryKey.GetValue();
+
+	const std::vector<uint8_t>* pLibrary = m_pipelineCache.Find(PipelineCacheBlob::PipelineLibrary, m_pipelineLibraryKey);
+	if (pLibrary && !pLibrary->empty())
+	{
+		m_pipelineLibraryData = *pLibrary;
+		if (FAILED(device1->CreatePipelineLibrary(m_pipelineLibraryData.data(), m_pipelineLibraryData.size(), IID_PPV_ARGS(&m_pipelineLibrary))))
+		{
+			m_pipelineLibrary.Reset();
+			m_pipelineLibraryData.clear();
+		}
+	}
+
+	// Without a usable library, start an empty one; some tools do not support
+	// libraries at all, in which case pipelines are simply never cached.
+	if (!m_pipelineLibrary && FAILED(device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&m_pipelineLibrary))))
+	{
+		m_pipelineLibrary.Reset();
+	}
+}
+
+void D3D12RenderDevice::SavePipelineCache()
+{
+	if (!m_desc.pipelineCacheFile)
+		return;
+
+	if (m_pipelineLibraryDirty)
+	{
+		std::vector<uint8_t> library(m_pipelineLibrary->GetSerializedSize());
+		ThrowIfFailed(m_pipelineLibrary->Serialize(library.data(), library.size()));
+		m_pipelineCache.Store(PipelineCacheBlob::PipelineLibrary, m_pipelineLibraryKey, library.data(), library.size());
+		m_pipelineLibraryDirty = false;
+	}
+
+	if (!m_pipelineCache.IsDirty())
+		return;
+
+	// Failing to write the cache only costs the next start its time.
+	std::vector<uint8_t> file;
+	m_pipelineCache.Serialize(file);
+	if (WriteWholeFile(m_desc.pipelineCacheFile, file))
+	{
+		m_pipelineCache.MarkClean();
+	}
+}
+
+void D3D12RenderDevice::CreateConstantBufferView(uint32_t slot, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes)
+{
+	if (slot >= m_desc.descriptorCount)
+		throw HrException(E_INVALIDARG);
+
+	WriteConstantBufferView(GetDescriptorCpuHandle(slot), buffer, offset, sizeInBytes);
+}
+
+void D3D12RenderDevice::CreateTextureView(uint32_t slot, RenderTextureHandle texture)
+{
+	if (slot >= m_desc.descriptorCount)
+		throw HrException(E_INVALIDARG);
+
+	WriteTextureView(GetDescriptorCpuHandle(slot), texture);
+}
+
+void D3D12RenderDevice::CreateStagingConstantBufferView(uint32_t stagingSlot, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes)
+{
+	if (stagingSlot >= m_desc.stagingDescriptorCount)
+		throw HrException(E_INVALIDARG);
+
+	WriteConstantBufferView(GetStagingCpuHandle(stagingSlot), buffer, offset, sizeInBytes);
+}
+
+void D3D12RenderDevice::CreateStagingTextureView(uint32_t stagingSlot, RenderTextureHandle texture)
+{
+	if (stagingSlot >= m_desc.stagingDescriptorCount)
+		throw HrException(E_INVALIDARG);
+
+	WriteTextureView(GetStagingCpuHandle(stagingSlot), texture);
+}
+
+void D3D12RenderDevice::WriteConstantBufferView(D3D12_CPU_DESCRIPTOR_HANDLE handle, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes)
+{
+	const Buffer& b = GetBuffer(buffer);
+	if (offset + sizeInBytes > b.sizeInBytes)
+		throw HrException(E_INVALIDARG);
+
+	D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+	cbvDesc.BufferLocation = b.resource->GetGPUVirtualAddress() + offset;
+	cbvDesc.SizeInBytes = CalculateConstantBufferByteSize(sizeInBytes);
+	m_device->CreateConstantBufferView(&cbvDesc, handle);
+}
+
+void D3D12RenderDevice::WriteTextureView(D3D12_CPU_DESCRIPTOR_HANDLE handle, RenderTextureHandle texture)
+{
+	if (!texture || texture > m_textures.size())
+		throw HrException(E_INVALIDARG);
+
+	const Texture& t = m_textures[texture - 1];
+	const D3D12_RESOURCE_DESC textureDesc = t.resource->GetDesc();
+
+	// Describe and create a SRV for the texture.
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = textureDesc.Format;
+	if (t.dimension == RenderTextureDimension::TextureCube)
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+		srvDesc.TextureCube.MipLevels = textureDesc.MipLevels;
+		srvDesc.TextureCube.MostDetailedMip = 0;
+		srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
+	}
+	else
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = textureDesc.MipLevels;
+	}
+	m_device->CreateShaderResourceView(t.resource.Get(), &srvDesc, handle);
+}
+
+void D3D12RenderDevice::CopyDescriptors(uint32_t dstSlot, uint32_t srcStagingSlot, uint32_t count)
+{
+	if (static_cast<UINT64>(dstSlot) + count > m_desc.descriptorCount ||
+		static_cast<UINT64>(srcStagingSlot) + count > m_desc.stagingDescriptorCount)
+		throw HrException(E_INVALIDARG);
+
+	if (!count)
+		return;
+
+	const D3D12_CPU_DESCRIPTOR_HANDLE dst = GetDescriptorCpuHandle(dstSlot);
+	const D3D12_CPU_DESCRIPTOR_HANDLE src = GetStagingCpuHandle(srcStagingSlot);
+
+	// Extend the previous range when both sides continue where it ended.
+	if (!m_copySizes.empty())
+	{
+		const SIZE_T extent = static_cast<SIZE_T>(m_copySizes.back()) * m_srvDescriptorSize;
+		if (m_copyDstStarts.back().ptr + extent == dst.ptr && m_copySrcStarts.back().ptr + extent == src.ptr)
+		{
+			m_copySizes.back() += count;
+			m_stats.descriptorCopies += count;
+			return;
+		}
+	}
+
+	m_copyDstStarts.push_back(dst);
+	m_copySrcStarts.push_back(src);
+	m_copySizes.push_back(count);
+	m_stats.descriptorCopies += count;
+}
+
+void D3D12RenderDevice::FlushDescriptorCopies()
+{
+	if (m_copySizes.empty())
+		return;
+
+	const UINT rangeCount = static_cast<UINT>(m_copySizes.size());
+	m_device->CopyDescriptors(
+		rangeCount, m_copyDstStarts.data(), m_copySizes.data(),
+		rangeCount, m_copySrcStarts.data(), m_copySizes.data(),
+		D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	++m_stats.descriptorCopyBatches;
+
+	m_copyDstStarts.clear();
+	m_copySrcStarts.clear();
+	m_copySizes.clear();
+}
+
+void D3D12RenderDevice::FinishUploads()
+{
+	FlushDescriptorCopies();
+
+	if (!m_uploadsPending)
+		return;
+
+	ThrowIfFailed(m_commandList->Close());
+	ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
+	m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
+
+	// Wait until assets have been uploaded to the GPU before the upload heaps go away.
+	WaitForIdle();
+
+	m_textureUploadHeaps.clear();
+	m_uploadsPending = false;
+}
+
+RenderCommandList* D3D12RenderDevice::BeginFrame()
+{
+	FinishUploads();
+
+	// Reuse this frame context once the GPU has retired the frame that last used it.
+	FrameContext& frame = m_frames[m_frameIndex];
+	if (m_fence->GetCompletedValue() < frame.fenceValue)
+	{
+		LARGE_INTEGER frequency, start, end;
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&start);
+
+		WaitForFence(frame.fenceValue);
+
+		QueryPerformanceCounter(&end);
+		++m_stats.frameWaits;
+		m_stats.frameWaitMicroseconds += static_cast<uint64_t>((end.QuadPart - start.QuadPart) * 1000000 / frequency.QuadPart);
+	}
+
+	BeginNativeCommandList(m_commandList.Get(), frame.commandAllocator.Get());
+	BeginNativeCommandList(m_overlayCommandList.Get(), frame.overlayAllocator.Get());
+	m_frameCommandList.Reset(m_commandList.Get());
+
+	// Indicate that the back buffer will be used as a render target.
+	m_commandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_backBufferIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET));
+
+	return &m_frameCommandList;
+}
+
+void D3D12RenderDevice::EndFrame()
+{
+	// Indicate that the back buffer will now be used to present.
+	m_overlayCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_backBufferIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
+
+	ThrowIfFailed(m_commandList->Close());
+	ThrowIfFailed(m_overlayCommandList->Close());
+
+	// Descriptor copies happen on the CPU timeline, so they only need to land before submission.
+	FlushDescriptorCopies();
+
+	// Submit the frame list, the recorded worker lists in order, then the overlay.
+	ID3D12CommandList* ppCommandLists[RenderMaxWorkerCommandLists + 2];
+	UINT commandListCount = 0;
+	ppCommandLists[commandListCount++] = m_commandList.Get();
+	AccumulateCommandStats(m_stats, m_frameCommandList.GetStats());
+
+	for (WorkerCommandList& worker : m_workerCommandLists)
+	{
+		if (worker.state == ListState::Recording)
+			throw HrException(E_FAIL);
+
+		if (worker.state == ListState::Recorded)
+		{
+			ppCommandLists[commandListCount++] = worker.commandList.Get();
+			AccumulateCommandStats(m_stats, worker.recorder->GetStats());
+			++m_stats.workerCommandLists;
+		}
+		worker.state = ListState::Idle;
+	}
+
+	ppCommandLists[commandListCount++] = m_overlayCommandList.Get();
+	m_commandQueue->ExecuteCommandLists(commandListCount, ppCommandLists);
+
+	// Present the frame.
+	ThrowIfFailed(m_swapChain->Present(1, 0));
+
+	// Tag the frame context and move on without waiting for the GPU.
+	m_frames[m_frameIndex].fenceValue = Signal();
+	m_frameIndex = (m_frameIndex + 1) % m_desc.framesInFlight;
+	m_backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+	++m_stats.frames;
+}
+
+// Safe to call from any thread, as long as each thread uses its own worker index.
+RenderCommandList* D3D12RenderDevice::BeginWorkerCommandList(uint32_t worker)
+{
+	if (worker >= m_workerCommandLists.size() || m_workerCommandLists[worker].state != ListState::Idle)
+		throw HrException(E_INVALIDARG);
+
+	WorkerCommandList& entry = m_workerCommandLists[worker];
+	BeginNativeCommandList(entry.commandList.Get(), m_frames[m_frameIndex].workerAllocators[worker].Get());
+	entry.recorder->Reset(entry.commandList.Get());
+	entry.state = ListState::Recording;
+	return entry.recorder.get();
+}
+
+void D3D12RenderDevice::EndWorkerCommandList(uint32_t worker)
+{
+	if (worker >= m_workerCommandLists.size() || m_workerCommandLists[worker].state != ListState::Recording)
+		throw HrException(E_INVALIDARG);
+
+	ThrowIfFailed(m_workerCommandLists[worker].commandList->Close());
+	m_workerCommandLists[worker].state = ListState::Recorded;
+}
+
+// Resets a command list for this frame and binds the state every frame list starts with.
+void D3D12RenderDevice::BeginNativeCommandList(ID3D12GraphicsCommandList* pCommandList, ID3D12CommandAllocator* pAllocator)
+{
+	ThrowIfFailed(pAllocator->Reset());
+	ThrowIfFailed(pCommandList->Reset(pAllocator, nullptr));
+
+	ID3D12DescriptorHeap* ppHeaps[] = { m_srvHeap.Get() };
+	pCommandList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+
+	const D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = GetRenderTargetView();
+	const D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = GetDepthStencilView();
+	pCommandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
+	pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void D3D12RenderDevice::WaitForIdle()
+{
+	WaitForFence(Signal());
+}
+
+void D3D12RenderDevice::ResetStats()
+{
+	const uint64_t bufferBytes = m_stats.bufferBytes;
+	const uint64_t textureCount = m_stats.textureCount;
+
+	m_stats = RenderStats();
+
+	// Resource totals describe what is alive, not per-frame work.
+	m_stats.bufferBytes = bufferBytes;
+	m_stats.textureCount = textureCount;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE D3D12RenderDevice::GetDescriptorCpuHandle(uint32_t slot) const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_srvHeap->GetCPUDescriptorHandleForHeapStart(), slot, m_srvDescriptorSize);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE D3D12RenderDevice::GetDescriptorGpuHandle(uint32_t slot) const
+{
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_srvHeap->GetGPUDescriptorHandleForHeapStart(), slot, m_srvDescriptorSize);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE D3D12RenderDevice::GetStagingCpuHandle(uint32_t stagingSlot) const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_stagingHeap->GetCPUDescriptorHandleForHeapStart(), stagingSlot, m_srvDescriptorSize);
+}
+
+const D3D12RenderDevice::Buffer& D3D12RenderDevice::GetBuffer(RenderBufferHandle buffer) const
+{
+	if (!buffer || buffer > m_buffers.size())
+		throw HrException(E_INVALIDARG);
+
+	return m_buffers[buffer - 1];
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE D3D12RenderDevice::GetRenderTargetView() const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_rtvHeap->GetCPUDescriptorHandleForHeapStart(), m_backBufferIndex, m_rtvDescriptorSize);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE D3D12RenderDevice::GetDepthStencilView() const
+{
+	return m_dsvHeap->GetCPUDescriptorHandleForHeapStart();
+}
+
+// Signals the queue with the next fence value and returns it.
+UINT64 D3D12RenderDevice::Signal()
+{
+	const UINT64 fence = m_fenceValue;
+	ThrowIfFailed(m_commandQueue->Signal(m_fence.Get(), fence));
+	m_fenceValue++;
+	return fence;
+}
+
+void D3D12RenderDevice::WaitForFence(UINT64 fenceValue)
+{
+	if (m_fence->GetCompletedValue() < fenceValue)
+	{
+		ThrowIfFailed(m_fence->SetEventOnCompletion(fenceValue, m_fenceEvent));
+		WaitForSingleObject(m_fenceEvent, INFINITE);
+	}
+}
+
+//
+D3D12RenderDevice::CommandList::CommandList(D3D12RenderDevice* device) :
+	m_device(device)
+{
+	Reset(nullptr);
+}
+
+void D3D12RenderDevice::CommandList::Reset(ID3D12GraphicsCommandList* pCommandList)
+{
+	m_commandList = pCommandList;
+	m_stats = RenderStats();
+	m_pipeline = 0;
+	m_rootSignature = nullptr;
+}
+
+void D3D12RenderDevice::CommandList::Count(size_t argumentBytes)
+{
+	++m_stats.commands;
+	m_stats.commandBytes += argumentBytes;
+}
+
+void D3D12RenderDevice::CommandList::SetPipeline(RenderPipelineHandle pipeline)
+{
+	if (!pipeline || pipeline > m_device->m_pipelines.size())
+		throw HrException(E_INVALIDARG);
+
+	const Pipeline& p = m_device->m_pipelines[pipeline - 1];
+	ID3D12GraphicsCommandList* pCommandList = m_commandList;
+
+	if (p.rootSignature.Get() != m_rootSignature)
+	{
+		pCommandList->SetGraphicsRootSignature(p.rootSignature.Get());
+		m_rootSignature = p.rootSignature.Get();
+		Count(sizeof(void*));
+	}
+
+	if (pipeline != m_pipeline)
+	{
+		++m_stats.pipelineChanges;
+	}
+	pCommandList->SetPipelineState(p.pipelineState.Get());
+	m_pipeline = pipeline;
+	Count(sizeof(void*));
+}
+
+void D3D12RenderDevice::CommandList::SetViewport(const RenderViewport& viewport)
+{
+	const CD3DX12_VIEWPORT d3dViewport(viewport.x, viewport.y, viewport.width, viewport.height, viewport.minDepth, viewport.maxDepth);
+	const CD3DX12_RECT scissorRect(static_cast<LONG>(viewport.x), static_cast<LONG>(viewport.y),
+		static_cast<LONG>(viewport.x + viewport.width), static_cast<LONG>(viewport.y + viewport.height));
+
+	ID3D12GraphicsCommandList* pCommandList = m_commandList;
+	pCommandList->RSSetViewports(1, &d3dViewport);
+	pCommandList->RSSetScissorRects(1, &scissorRect);
+	Count(sizeof(d3dViewport) + sizeof(scissorRect));
+}
+
+void D3D12RenderDevice::CommandList::ClearRenderTarget(const float color[4])
+{
+	m_commandList->ClearRenderTargetView(m_device->GetRenderTargetView(), color, 0, nullptr);
+	Count(sizeof(float) * 4);
+}
+
+void D3D12RenderDevice::CommandList::ClearDepth(float depth)
+{
+	m_commandList->ClearDepthStencilView(m_device->GetDepthStencilView(), D3D12_CLEAR_FLAG_DEPTH, depth, 0, 0, nullptr);
+	Count(sizeof(float));
+}
+
+void D3D12RenderDevice::CommandList::SetRootDescriptorTable(uint32_t rootIndex, uint32_t firstSlot)
+{
+	m_commandList->SetGraphicsRootDescriptorTable(rootIndex, m_device->GetDescriptorGpuHandle(firstSlot));
+	Count(sizeof(uint32_t) + sizeof(D3D12_GPU_DESCRIPTOR_HANDLE));
+}
+
+void D3D12RenderDevice::CommandList::SetRootConstantBuffer(uint32_t rootIndex, RenderBufferHandle buffer, uint64_t offset)
+{
+	const Buffer& b = m_device->GetBuffer(buffer);
+	m_commandList->SetGraphicsRootConstantBufferView(rootIndex, b.resource->GetGPUVirtualAddress() + offset);
+	Count(sizeof(uint32_t) + sizeof(D3D12_GPU_VIRTUAL_ADDRESS));
+}
+
+void D3D12RenderDevice::CommandList::SetVertexBuffer(RenderBufferHandle buffer)
+{
+	const Buffer& b = m_device->GetBuffer(buffer);
+
+	D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
+	vertexBufferView.BufferLocation = b.resource->GetGPUVirtualAddress();
+	vertexBufferView.StrideInBytes = b.strideInBytes;
+	vertexBufferView.SizeInBytes = static_cast<UINT>(b.sizeInBytes);
+	m_commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
+	Count(sizeof(vertexBufferView));
+}
+
+void D3D12RenderDevice::CommandList::SetIndexBuffer(RenderBufferHandle buffer)
+{
+	const Buffer& b = m_device->GetBuffer(buffer);
+
+	D3D12_INDEX_BUFFER_VIEW indexBufferView;
+	indexBufferView.BufferLocation = b.resource->GetGPUVirtualAddress();
+	indexBufferView.Format = (b.strideInBytes == 2) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	indexBufferView.SizeInBytes = static_cast<UINT>(b.sizeInBytes);
+	m_commandList->IASetIndexBuffer(&indexBufferView);
+	Count(sizeof(indexBufferView));
+}
+
+void D3D12RenderDevice::CommandList::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+	uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	m_commandList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+	Count(sizeof(uint32_t) * 5);
+
+	++m_stats.drawCalls;
+	m_stats.instances += instanceCount;
+	m_stats.primitives += static_cast<uint64_t>(indexCount / 3) * instanceCount;
+}
+
+//
+std::unique_ptr<RenderDevice> CreateRenderDevice(RenderBackend backend, const RenderDeviceDesc& desc)
+{
+	if (backend == RenderBackend::D3D12)
+		return std::unique_ptr<RenderDevice>(new D3D12RenderDevice(desc));
+
+	return CreateHeadlessRenderDevice(backend, desc);
+}
@@ -0,0 +1,214 @@
+//*********************************************************
+//
+// RenderDeviceD3D12.h
+//
+// D3D12 implementation of RenderDevice. Owns the device, queue, swap chain,
+// descriptor heaps and depth buffer that PBRSandbox12 used to create itself.
+//
+//*********************************************************
+
+#pragma once
+
+#include "RenderDevice.h"
+#include "PipelineCache.h"
+
+#include <vector>
+
+using Microsoft::WRL::ComPtr;
+
+class D3D12RenderDevice : public RenderDevice
+{
+public:
+	static const DXGI_FORMAT BackBufferFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+	static const DXGI_FORMAT DepthBufferFormat = DXGI_FORMAT_D32_FLOAT;
+
+	explicit D3D12RenderDevice(const RenderDeviceDesc& desc);
+	virtual ~D3D12RenderDevice();
+
+	virtual RenderBackend GetBackend() const { return RenderBackend::D3D12; }
+
+	virtual RenderBufferHandle CreateBuffer(const RenderBufferDesc& desc, const void* initialData);
+	virtual void* MapBuffer(RenderBufferHandle buffer);
+	virtual RenderTextureHandle LoadTexture(const wchar_t* filename, RenderTextureDimension dimension);
+	virtual RenderPipelineHandle CreatePipeline(const RenderPipelineDesc& desc);
+
+	virtual void CreateConstantBufferView(uint32_t slot, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes);
+	virtual void CreateTextureView(uint32_t slot, RenderTextureHandle texture);
+	virtual void CreateStagingConstantBufferView(uint32_t stagingSlot, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes);
+	virtual void CreateStagingTextureView(uint32_t stagingSlot, RenderTextureHandle texture);
+	virtual void CopyDescriptors(uint32_t dstSlot, uint32_t srcStagingSlot, uint32_t count);
+
+	virtual void FinishUploads();
+	virtual void SavePipelineCache();
+
+	virtual RenderCommandList* BeginFrame();
+	virtual void EndFrame();
+	virtual void WaitForIdle();
+
+	virtual uint32_t GetWorkerCommandListCount() const { return m_desc.workerCommandLists; }
+	virtual RenderCommandList* BeginWorkerCommandList(uint32_t worker);
+	virtual void EndWorkerCommandList(uint32_t worker);
+
+	virtual uint32_t GetFramesInFlight() const { return m_desc.framesInFlight; }
+	virtual uint32_t GetFrameIndex() const { return m_frameIndex; }
+	virtual uint64_t GetFrameFence() const { return m_fenceValue; }
+	virtual uint64_t GetCompletedFence() const { return m_fence->GetCompletedValue(); }
+
+	virtual const RenderStats& GetStats() const { return m_stats; }
+	virtual void ResetStats();
+
+	// Native access for code with no backend-agnostic equivalent (ImGui).
+	// The overlay list is open between BeginFrame and EndFrame and executes
+	// after the frame and worker lists, right before present.
+	ID3D12Device* GetDevice() const { return m_device.Get(); }
+	ID3D12GraphicsCommandList* GetOverlayCommandList() const { return m_overlayCommandList.Get(); }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetDescriptorCpuHandle(uint32_t slot) const;
+	D3D12_GPU_DESCRIPTOR_HANDLE GetDescriptorGpuHandle(uint32_t slot) const;
+
+private:
+	// Everything a frame owns while the GPU may still be executing it.
+	struct FrameContext
+	{
+		ComPtr<ID3D12CommandAllocator> commandAllocator;
+		ComPtr<ID3D12CommandAllocator> overlayAllocator;
+		ComPtr<ID3D12CommandAllocator> workerAllocators[RenderMaxWorkerCommandLists];
+		UINT64 fenceValue;
+	};
+
+	enum class ListState
+	{
+		Idle,
+		Recording,
+		Recorded,
+	};
+
+	struct Buffer
+	{
+		ComPtr<ID3D12Resource> resource;
+		RenderBufferUsage usage;
+		UINT strideInBytes;
+		UINT64 sizeInBytes;
+		void* pMapped;
+	};
+
+	struct Texture
+	{
+		ComPtr<ID3D12Resource> resource;
+		RenderTextureDimension dimension;
+	};
+
+	struct Pipeline
+	{
+		ComPtr<ID3D12RootSignature> rootSignature;
+		ComPtr<ID3D12PipelineState> pipelineState;
+	};
+
+	// Wraps one native command list. Counters are kept per list so worker
+	// lists can record concurrently; EndFrame merges them.
+	class CommandList : public RenderCommandList
+	{
+	public:
+		explicit CommandList(D3D12RenderDevice* device);
+
+		void Reset(ID3D12GraphicsCommandList* pCommandList);
+
+		const RenderStats& GetStats() const { return m_stats; }
+
+		virtual void SetPipeline(RenderPipelineHandle pipeline);
+		virtual void SetViewport(const RenderViewport& viewport);
+		virtual void ClearRenderTarget(const float color[4]);
+		virtual void ClearDepth(float depth);
+		virtual void SetRootDescriptorTable(uint32_t rootIndex, uint32_t firstSlot);
+		virtual void SetRootConstantBuffer(uint32_t rootIndex, RenderBufferHandle buffer, uint64_t offset);
+		virtual void SetVertexBuffer(RenderBufferHandle buffer);
+		virtual void SetIndexBuffer(RenderBufferHandle buffer);
+		virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+			uint32_t startIndex, int32_t baseVertex, uint32_t startInstance);
+
+	private:
+		void Count(size_t argumentBytes);
+
+		D3D12RenderDevice* m_device;
+		ID3D12GraphicsCommandList* m_commandList;
+		RenderStats m_stats;
+		RenderPipelineHandle m_pipeline;
+		ID3D12RootSignature* m_rootSignature;
+	};
+
+	struct WorkerCommandList
+	{
+		ComPtr<ID3D12GraphicsCommandList> commandList;
+		std::unique_ptr<CommandList> recorder;
+		ListState state;
+	};
+
+	const Buffer& GetBuffer(RenderBufferHandle buffer) const;
+	void LoadPipelineCache(IDXGIFactory4* pFactory);
+	uint64_t GetShaderBytecode(const wchar_t* filename, const char* entryPoint, const char* target, std::vector<uint8_t>& bytecode);
+	D3D12_CPU_DESCRIPTOR_HANDLE GetRenderTargetView() const;
+	D3D12_CPU_DESCRIPTOR_HANDLE GetDepthStencilView() const;
+	D3D12_CPU_DESCRIPTOR_HANDLE GetStagingCpuHandle(uint32_t stagingSlot) const;
+	void WriteConstantBufferView(D3D12_CPU_DESCRIPTOR_HANDLE handle, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes);
+	void WriteTextureView(D3D12_CPU_DESCRIPTOR_HANDLE handle, RenderTextureHandle texture);
+	void FlushDescriptorCopies();
+	void BeginNativeCommandList(ID3D12GraphicsCommandList* pCommandList, ID3D12CommandAllocator* pAllocator);
+	UINT64 Signal();
+	void WaitForFence(UINT64 fenceValue);
+
+	RenderDeviceDesc m_desc;
+	RenderStats m_stats;
+
+	// Pipeline objects.
+	ComPtr<IDXGISwapChain3> m_swapChain;
+	ComPtr<ID3D12Device> m_device;
+	ComPtr<ID3D12Resource> m_renderTargets[RenderMaxFramesInFlight];
+	ComPtr<ID3D12Resource> m_depthStencil;
+	ComPtr<ID3D12CommandQueue> m_commandQueue;
+	ComPtr<ID3D12GraphicsCommandList> m_commandList;
+	ComPtr<ID3D12GraphicsCommandList> m_overlayCommandList;
+
+	ComPtr<ID3D12DescriptorHeap> m_rtvHeap;
+	ComPtr<ID3D12DescriptorHeap> m_dsvHeap;
+	ComPtr<ID3D12DescriptorHeap> m_srvHeap;
+	ComPtr<ID3D12DescriptorHeap> m_stagingHeap;
+	UINT m_srvDescriptorSize;
+	UINT m_rtvDescriptorSize;
+
+	// Queued staging-to-shader-visible copies, merged into ranges and issued
+	// as a single ID3D12Device::CopyDescriptors call per flush.
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_copyDstStarts;
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_copySrcStarts;
+	std::vector<UINT> m_copySizes;
+
+	// Resources.
+	std::vector<Buffer> m_buffers;
+	std::vector<Texture> m_textures;
+	std::vector<Pipeline> m_pipelines;
+
+	// Shader bytecode and root signatures are cached by content; pipeline
+	// states go through a driver pipeline library, itself stored in the cache
+	// under a key naming the adapter and driver. m_pipelineLibraryData backs
+	// the library and must outlive it.
+	PipelineCache m_pipelineCache;
+	std::vector<uint8_t> m_pipelineLibraryData;
+	ComPtr<ID3D12PipelineLibrary> m_pipelineLibrary;
+	uint64_t m_pipelineLibraryKey;
+	bool m_pipelineLibraryDirty;
+
+	std::vector<ComPtr<ID3D12Resource>> m_textureUploadHeaps;
+	bool m_uploadsPending;
+
+	// Frame contexts. The back buffer count is at least two, and at least the
+	// number of frames in flight so Present never waits on a buffer we own.
+	FrameContext m_frames[RenderMaxFramesInFlight];
+	CommandList m_frameCommandList;
+	std::vector<WorkerCommandList> m_workerCommandLists;
+	UINT m_backBufferCount;
+	UINT m_backBufferIndex;
+	UINT m_frameIndex;
+
+	// Synchronization objects. m_fenceValue is the next value to be signalled.
+	HANDLE m_fenceEvent;
+	ComPtr<ID3D12Fence> m_fence;
+	UINT64 m_fenceValue;
+};
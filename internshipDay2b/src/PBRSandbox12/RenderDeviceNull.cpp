@@ -0,0 +1,879 @@
+//*********************************************************
+//
+// RenderDeviceNull.cpp
+//
+// Null and software render backends.
+//
+//*********************************************************
+
+#include "RenderDeviceNull.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+	uint32_t ToIndex(uint32_t handle)
+	{
+		return handle - 1;
+	}
+
+	uint32_t PackColor(const float color[4])
+	{
+		uint32_t packed = 0;
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			const float c = std::min(std::max(color[i], 0.0f), 1.0f);
+			packed |= static_cast<uint32_t>(c * 255.0f + 0.5f) << (i * 8);
+		}
+		return packed;
+	}
+
+	bool IsVertexVisible(RenderShaderVisibility visibility)
+	{
+		return visibility == RenderShaderVisibility::All || visibility == RenderShaderVisibility::Vertex;
+	}
+}
+
+//
+NullRenderDevice::NullRenderDevice(const RenderDeviceDesc& desc) :
+	m_desc(desc),
+	m_stats(),
+	m_descriptorCopiesPending(false),
+	m_textureCount(0),
+	m_commandList(this),
+	m_recording(false),
+	m_frameIndex(0),
+	m_frameFences(),
+	m_nextFence(1),
+	m_completedFence(0)
+{
+	if (!desc.width || !desc.height || !desc.descriptorCount)
+		throw std::invalid_argument("NullRenderDevice: width, height and descriptorCount must be non-zero");
+
+	if (!desc.framesInFlight || desc.framesInFlight > RenderMaxFramesInFlight)
+		throw std::invalid_argument("NullRenderDevice: framesInFlight out of range");
+
+	if (desc.workerCommandLists > RenderMaxWorkerCommandLists)
+		throw std::invalid_argument("NullRenderDevice: workerCommandLists out of range");
+
+	m_descriptors.resize(desc.descriptorCount);
+	m_stagingDescriptors.resize(desc.stagingDescriptorCount);
+
+	m_workerCommandLists.resize(desc.workerCommandLists);
+	for (WorkerCommandList& worker : m_workerCommandLists)
+	{
+		worker.commandList.reset(new CommandList(this));
+		worker.state = ListState::Idle;
+	}
+}
+
+NullRenderDevice::~NullRenderDevice()
+{
+}
+
+RenderBufferHandle NullRenderDevice::CreateBuffer(const RenderBufferDesc& desc, const void* initialData)
+{
+	if (!desc.sizeInBytes)
+		throw std::invalid_argument("NullRenderDevice: zero-sized buffer");
+
+	if (desc.usage == RenderBufferUsage::Index && desc.strideInBytes != 2 && desc.strideInBytes != 4)
+		throw std::invalid_argument("NullRenderDevice: index buffers need a 2 or 4 byte stride");
+
+	Buffer buffer;
+	buffer.usage = desc.usage;
+	buffer.strideInBytes = desc.strideInBytes;
+	buffer.data.resize(static_cast<size_t>(desc.sizeInBytes));
+	if (initialData)
+	{
+		memcpy(buffer.data.data(), initialData, buffer.data.size());
+	}
+
+	m_buffers.push_back(std::move(buffer));
+	m_stats.bufferBytes += desc.sizeInBytes;
+
+	return static_cast<RenderBufferHandle>(m_buffers.size());
+}
+
+void* NullRenderDevice::MapBuffer(RenderBufferHandle buffer)
+{
+	if (!GetBuffer(buffer))
+		throw std::invalid_argument("NullRenderDevice: MapBuffer on an invalid handle");
+
+	return m_buffers[ToIndex(buffer)].data.data();
+}
+
+RenderTextureHandle NullRenderDevice::LoadTexture(const wchar_t* filename, RenderTextureDimension /*dimension*/)
+{
+	if (!filename)
+		throw std::invalid_argument("NullRenderDevice: LoadTexture without a filename");
+
+	// Texture contents never influence CPU cost here, so nothing is read.
+	++m_stats.textureCount;
+	return ++m_textureCount;
+}
+
+RenderPipelineHandle NullRenderDevice::CreatePipeline(const RenderPipelineDesc& desc)
+{
+	if (!desc.shaderFile || !desc.vertexShaderEntry || !desc.pixelShaderEntry)
+		throw std::invalid_argument("NullRenderDevice: pipeline needs a shader file and entry points");
+
+	if (desc.rootParameterCount > RenderMaxRootParameters || (desc.rootParameterCount && !desc.rootParameters))
+		throw std::invalid_argument("NullRenderDevice: invalid root parameters");
+
+	if (!desc.inputElementCount || !desc.inputElements)
+		throw std::invalid_argument("NullRenderDevice: pipeline needs a position input element");
+
+	Pipeline pipeline = {};
+	pipeline.rootParameterCount = desc.rootParameterCount;
+	for (uint32_t i = 0; i < desc.rootParameterCount; ++i)
+	{
+		const RenderRootParameter& parameter = desc.rootParameters[i];
+		if (parameter.type == RenderRootParameterType::DescriptorTable
+			&& (!parameter.rangeCount || parameter.rangeCount > RenderMaxRangesPerTable))
+			throw std::invalid_argument("NullRenderDevice: descriptor table with an invalid range count");
+
+		pipeline.rootParameters[i] = parameter;
+	}
+	pipeline.positionFormat = desc.inputElements[0].format;
+	pipeline.positionOffset = desc.inputElements[0].offset;
+	pipeline.instanceConstantStride = desc.instanceConstantStride;
+
+	m_pipelines.push_back(pipeline);
+	++m_stats.pipelinesCreated;
+	return static_cast<RenderPipelineHandle>(m_pipelines.size());
+}
+
+void NullRenderDevice::CreateConstantBufferView(uint32_t slot, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes)
+{
+	if (slot >= m_descriptors.size())
+		throw std::invalid_argument("NullRenderDevice: descriptor slot out of range");
+
+	WriteConstantBufferView(m_descriptors[slot], buffer, offset, sizeInBytes);
+}
+
+void NullRenderDevice::CreateTextureView(uint32_t slot, RenderTextureHandle texture)
+{
+	if (slot >= m_descriptors.size())
+		throw std::invalid_argument("NullRenderDevice: descriptor slot out of range");
+
+	WriteTextureView(m_descriptors[slot], texture);
+}
+
+void NullRenderDevice::CreateStagingConstantBufferView(uint32_t stagingSlot, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes)
+{
+	if (stagingSlot >= m_stagingDescriptors.size())
+		throw std::invalid_argument("NullRenderDevice: staging descriptor slot out of range");
+
+	WriteConstantBufferView(m_stagingDescriptors[stagingSlot], buffer, offset, sizeInBytes);
+}
+
+void NullRenderDevice::CreateStagingTextureView(uint32_t stagingSlot, RenderTextureHandle texture)
+{
+	if (stagingSlot >= m_stagingDescriptors.size())
+		throw std::invalid_argument("NullRenderDevice: staging descriptor slot out of range");
+
+	WriteTextureView(m_stagingDescriptors[stagingSlot], texture);
+}
+
+void NullRenderDevice::WriteConstantBufferView(Descriptor& descriptor, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes)
+{
+	const Buffer* pBuffer = GetBuffer(buffer);
+	if (!pBuffer || offset + sizeInBytes > pBuffer->data.size() || (offset & 255) || (sizeInBytes & 255))
+		throw std::invalid_argument("NullRenderDevice: invalid constant buffer view");
+
+	descriptor.valid = true;
+	descriptor.type = RenderDescriptorType::ConstantBuffer;
+	descriptor.buffer = buffer;
+	descriptor.offset = offset;
+	descriptor.sizeInBytes = sizeInBytes;
+	descriptor.texture = 0;
+}
+
+void NullRenderDevice::WriteTextureView(Descriptor& descriptor, RenderTextureHandle texture)
+{
+	if (!texture || texture > m_textureCount)
+		throw std::invalid_argument("NullRenderDevice: invalid texture view");
+
+	descriptor.valid = true;
+	descriptor.type = RenderDescriptorType::ShaderResource;
+	descriptor.buffer = 0;
+	descriptor.offset = 0;
+	descriptor.sizeInBytes = 0;
+	descriptor.texture = texture;
+}
+
+void NullRenderDevice::CopyDescriptors(uint32_t dstSlot, uint32_t srcStagingSlot, uint32_t count)
+{
+	if (static_cast<uint64_t>(dstSlot) + count > m_descriptors.size() ||
+		static_cast<uint64_t>(srcStagingSlot) + count > m_stagingDescriptors.size())
+		throw std::invalid_argument("NullRenderDevice: descriptor copy out of range");
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Validate(m_stagingDescriptors[srcStagingSlot + i].valid, "CopyDescriptors: source descriptor is empty");
+		m_descriptors[dstSlot + i] = m_stagingDescriptors[srcStagingSlot + i];
+	}
+
+	m_stats.descriptorCopies += count;
+	m_descriptorCopiesPending = m_descriptorCopiesPending || count;
+}
+
+void NullRenderDevice::FlushDescriptorCopies()
+{
+	if (m_descriptorCopiesPending)
+	{
+		++m_stats.descriptorCopyBatches;
+		m_descriptorCopiesPending = false;
+	}
+}
+
+RenderCommandList* NullRenderDevice::BeginFrame()
+{
+	if (m_recording)
+		throw std::logic_error("NullRenderDevice: BeginFrame called twice");
+
+	// Retire the frame that last used this context.
+	if (m_frameFences[m_frameIndex] > m_completedFence)
+	{
+		m_completedFence = m_frameFences[m_frameIndex];
+	}
+
+	m_recording = true;
+	m_commandList.Reset();
+	return &m_commandList;
+}
+
+void NullRenderDevice::EndFrame()
+{
+	if (!m_recording)
+		throw std::logic_error("NullRenderDevice: EndFrame without BeginFrame");
+
+	for (const WorkerCommandList& worker : m_workerCommandLists)
+	{
+		if (worker.state == ListState::Recording)
+			throw std::logic_error("NullRenderDevice: EndFrame with a worker command list still open");
+	}
+
+	m_recording = false;
+	FlushDescriptorCopies();
+
+	SubmitCommandList(m_commandList);
+	for (WorkerCommandList& worker : m_workerCommandLists)
+	{
+		if (worker.state == ListState::Recorded)
+		{
+			SubmitCommandList(*worker.commandList);
+			++m_stats.workerCommandLists;
+		}
+		worker.state = ListState::Idle;
+	}
+	++m_stats.frames;
+
+	m_frameFences[m_frameIndex] = m_nextFence++;
+	m_frameIndex = (m_frameIndex + 1) % m_desc.framesInFlight;
+}
+
+RenderCommandList* NullRenderDevice::BeginWorkerCommandList(uint32_t worker)
+{
+	if (!m_recording || worker >= m_workerCommandLists.size() || m_workerCommandLists[worker].state != ListState::Idle)
+		throw std::logic_error("NullRenderDevice: BeginWorkerCommandList outside a frame or on a used list");
+
+	WorkerCommandList& entry = m_workerCommandLists[worker];
+	entry.commandList->Reset();
+	entry.state = ListState::Recording;
+	return entry.commandList.get();
+}
+
+void NullRenderDevice::EndWorkerCommandList(uint32_t worker)
+{
+	if (worker >= m_workerCommandLists.size() || m_workerCommandLists[worker].state != ListState::Recording)
+		throw std::logic_error("NullRenderDevice: EndWorkerCommandList on a list that is not recording");
+
+	m_workerCommandLists[worker].state = ListState::Recorded;
+}
+
+void NullRenderDevice::SubmitCommandList(const CommandList& commandList)
+{
+	AccumulateCommandStats(m_stats, commandList.GetStats());
+	if (!commandList.GetLastValidationError().empty())
+	{
+		m_lastValidationError = commandList.GetLastValidationError();
+	}
+
+	const std::vector<uint8_t>& stream = commandList.GetStream();
+	ExecuteCommands(stream.data(), stream.size());
+}
+
+void NullRenderDevice::WaitForIdle()
+{
+	m_completedFence = m_nextFence - 1;
+}
+
+void NullRenderDevice::ResetStats()
+{
+	const uint64_t bufferBytes = m_stats.bufferBytes;
+	const uint64_t textureCount = m_stats.textureCount;
+
+	m_stats = RenderStats();
+
+	// Resource totals describe what is alive, not per-frame work.
+	m_stats.bufferBytes = bufferBytes;
+	m_stats.textureCount = textureCount;
+}
+
+const NullRenderDevice::Buffer* NullRenderDevice::GetBuffer(RenderBufferHandle buffer) const
+{
+	return (buffer && buffer <= m_buffers.size()) ? &m_buffers[ToIndex(buffer)] : nullptr;
+}
+
+const NullRenderDevice::Pipeline* NullRenderDevice::GetPipeline(RenderPipelineHandle pipeline) const
+{
+	return (pipeline && pipeline <= m_pipelines.size()) ? &m_pipelines[ToIndex(pipeline)] : nullptr;
+}
+
+const NullRenderDevice::Descriptor* NullRenderDevice::GetDescriptor(uint32_t slot) const
+{
+	return (slot < m_descriptors.size() && m_descriptors[slot].valid) ? &m_descriptors[slot] : nullptr;
+}
+
+bool NullRenderDevice::Validate(bool condition, const char* message)
+{
+	if (!condition)
+	{
+		++m_stats.validationErrors;
+		m_lastValidationError = message;
+	}
+	return condition;
+}
+
+//
+NullRenderDevice::CommandList::CommandList(NullRenderDevice* device) :
+	m_device(device)
+{
+	m_stream.reserve(64 * 1024);
+	Reset();
+}
+
+void NullRenderDevice::CommandList::Reset()
+{
+	m_stream.clear();
+	m_stats = RenderStats();
+	m_lastValidationError.clear();
+
+	m_pipeline = 0;
+	m_boundRootParameters = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+}
+
+template<typename T>
+void NullRenderDevice::CommandList::Emit(T& command, CommandType type)
+{
+	static_assert(sizeof(T) <= UINT16_MAX, "command too large for its header");
+
+	command.header.type = type;
+	command.header.size = static_cast<uint16_t>(sizeof(T));
+
+	const size_t offset = m_stream.size();
+	m_stream.resize(offset + sizeof(T));
+	memcpy(m_stream.data() + offset, &command, sizeof(T));
+
+	++m_stats.commands;
+	m_stats.commandBytes += sizeof(T);
+}
+
+bool NullRenderDevice::CommandList::Validate(bool condition, const char* message)
+{
+	if (!condition)
+	{
+		++m_stats.validationErrors;
+		m_lastValidationError = message;
+	}
+	return condition;
+}
+
+void NullRenderDevice::CommandList::SetPipeline(RenderPipelineHandle pipeline)
+{
+	const Pipeline* pNew = m_device->GetPipeline(pipeline);
+	if (!Validate(pNew != nullptr, "SetPipeline: invalid pipeline handle"))
+		return;
+
+	// Root arguments survive a pipeline change only if the layout is identical.
+	const Pipeline* pOld = m_device->GetPipeline(m_pipeline);
+	if (!pOld || pOld->rootParameterCount != pNew->rootParameterCount
+		|| memcmp(pOld->rootParameters, pNew->rootParameters, sizeof(RenderRootParameter) * pNew->rootParameterCount) != 0)
+	{
+		m_boundRootParameters = 0;
+	}
+
+	if (pipeline != m_pipeline)
+	{
+		++m_stats.pipelineChanges;
+	}
+	m_pipeline = pipeline;
+
+	SetPipelineCommand command = {};
+	command.pipeline = pipeline;
+	Emit(command, CommandType::SetPipeline);
+}
+
+void NullRenderDevice::CommandList::SetViewport(const RenderViewport& viewport)
+{
+	if (!Validate(viewport.width > 0.0f && viewport.height > 0.0f
+		&& viewport.minDepth >= 0.0f && viewport.maxDepth <= 1.0f && viewport.minDepth <= viewport.maxDepth,
+		"SetViewport: invalid viewport"))
+		return;
+
+	SetViewportCommand command = {};
+	command.viewport = viewport;
+	Emit(command, CommandType::SetViewport);
+}
+
+void NullRenderDevice::CommandList::ClearRenderTarget(const float color[4])
+{
+	ClearRenderTargetCommand command = {};
+	memcpy(command.color, color, sizeof(command.color));
+	Emit(command, CommandType::ClearRenderTarget);
+}
+
+void NullRenderDevice::CommandList::ClearDepth(float depth)
+{
+	if (!Validate(depth >= 0.0f && depth <= 1.0f, "ClearDepth: depth outside [0, 1]"))
+		return;
+
+	ClearDepthCommand command = {};
+	command.depth = depth;
+	Emit(command, CommandType::ClearDepth);
+}
+
+void NullRenderDevice::CommandList::SetRootDescriptorTable(uint32_t rootIndex, uint32_t firstSlot)
+{
+	const Pipeline* pPipeline = m_device->GetPipeline(m_pipeline);
+	if (!Validate(pPipeline && rootIndex < pPipeline->rootParameterCount
+		&& pPipeline->rootParameters[rootIndex].type == RenderRootParameterType::DescriptorTable,
+		"SetRootDescriptorTable: root parameter is not a descriptor table"))
+		return;
+
+	// Every descriptor the table covers must exist and match the range type.
+	const RenderRootParameter& parameter = pPipeline->rootParameters[rootIndex];
+	uint32_t slot = firstSlot;
+	for (uint32_t r = 0; r < parameter.rangeCount; ++r)
+	{
+		for (uint32_t i = 0; i < parameter.ranges[r].count; ++i, ++slot)
+		{
+			const Descriptor* pDescriptor = m_device->GetDescriptor(slot);
+			if (!Validate(pDescriptor && pDescriptor->type == parameter.ranges[r].type,
+				"SetRootDescriptorTable: table references an empty or mismatched descriptor"))
+				return;
+		}
+	}
+
+	m_boundRootParameters |= 1u << rootIndex;
+
+	SetRootDescriptorTableCommand command = {};
+	command.rootIndex = rootIndex;
+	command.firstSlot = firstSlot;
+	Emit(command, CommandType::SetRootDescriptorTable);
+}
+
+void NullRenderDevice::CommandList::SetRootConstantBuffer(uint32_t rootIndex, RenderBufferHandle buffer, uint64_t offset)
+{
+	const Pipeline* pPipeline = m_device->GetPipeline(m_pipeline);
+	if (!Validate(pPipeline && rootIndex < pPipeline->rootParameterCount
+		&& pPipeline->rootParameters[rootIndex].type == RenderRootParameterType::ConstantBuffer,
+		"SetRootConstantBuffer: root parameter is not a constant buffer"))
+		return;
+
+	const Buffer* pBuffer = m_device->GetBuffer(buffer);
+	if (!Validate(pBuffer && pBuffer->usage == RenderBufferUsage::Constant
+		&& offset < pBuffer->data.size() && !(offset & 255),
+		"SetRootConstantBuffer: invalid buffer or misaligned offset"))
+		return;
+
+	m_boundRootParameters |= 1u << rootIndex;
+
+	SetRootConstantBufferCommand command = {};
+	command.rootIndex = rootIndex;
+	command.buffer = buffer;
+	command.offset = offset;
+	Emit(command, CommandType::SetRootConstantBuffer);
+}
+
+void NullRenderDevice::CommandList::SetVertexBuffer(RenderBufferHandle buffer)
+{
+	const Buffer* pBuffer = m_device->GetBuffer(buffer);
+	if (!Validate(pBuffer && pBuffer->usage == RenderBufferUsage::Vertex && pBuffer->strideInBytes,
+		"SetVertexBuffer: not a vertex buffer"))
+		return;
+
+	m_vertexBuffer = buffer;
+
+	SetBufferCommand command = {};
+	command.buffer = buffer;
+	Emit(command, CommandType::SetVertexBuffer);
+}
+
+void NullRenderDevice::CommandList::SetIndexBuffer(RenderBufferHandle buffer)
+{
+	const Buffer* pBuffer = m_device->GetBuffer(buffer);
+	if (!Validate(pBuffer && pBuffer->usage == RenderBufferUsage::Index,
+		"SetIndexBuffer: not an index buffer"))
+		return;
+
+	m_indexBuffer = buffer;
+
+	SetBufferCommand command = {};
+	command.buffer = buffer;
+	Emit(command, CommandType::SetIndexBuffer);
+}
+
+void NullRenderDevice::CommandList::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+	uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	const Pipeline* pPipeline = m_device->GetPipeline(m_pipeline);
+	if (!Validate(pPipeline != nullptr, "DrawIndexedInstanced: no pipeline bound"))
+		return;
+
+	const uint32_t requiredRootParameters = (pPipeline->rootParameterCount < 32)
+		? ((1u << pPipeline->rootParameterCount) - 1) : ~0u;
+	if (!Validate((m_boundRootParameters & requiredRootParameters) == requiredRootParameters,
+		"DrawIndexedInstanced: not every root parameter is bound"))
+		return;
+
+	const Buffer* pIndexBuffer = m_device->GetBuffer(m_indexBuffer);
+	if (!Validate(m_device->GetBuffer(m_vertexBuffer) && pIndexBuffer,
+		"DrawIndexedInstanced: vertex or index buffer missing"))
+		return;
+
+	if (!Validate((static_cast<uint64_t>(startIndex) + indexCount) * pIndexBuffer->strideInBytes <= pIndexBuffer->data.size(),
+		"DrawIndexedInstanced: index range exceeds the index buffer"))
+		return;
+
+	if (!indexCount || !instanceCount)
+		return;
+
+	++m_stats.drawCalls;
+	m_stats.instances += instanceCount;
+	m_stats.primitives += static_cast<uint64_t>(indexCount / 3) * instanceCount;
+
+	DrawIndexedInstancedCommand command = {};
+	command.indexCount = indexCount;
+	command.instanceCount = instanceCount;
+	command.startIndex = startIndex;
+	command.baseVertex = baseVertex;
+	command.startInstance = startInstance;
+	Emit(command, CommandType::DrawIndexedInstanced);
+}
+
+//
+SoftwareRenderDevice::SoftwareRenderDevice(const RenderDeviceDesc& desc) :
+	NullRenderDevice(desc)
+{
+	const size_t pixels = static_cast<size_t>(desc.width) * desc.height;
+	m_colorBuffer.resize(pixels, 0);
+	m_depthBuffer.resize(pixels, 1.0f);
+}
+
+SoftwareRenderDevice::~SoftwareRenderDevice()
+{
+}
+
+void SoftwareRenderDevice::ExecuteCommands(const uint8_t* stream, size_t size)
+{
+	ExecutionState state = {};
+	state.viewport.width = static_cast<float>(m_desc.width);
+	state.viewport.height = static_cast<float>(m_desc.height);
+	state.viewport.maxDepth = 1.0f;
+
+	size_t offset = 0;
+	while (offset + sizeof(CommandHeader) <= size)
+	{
+		CommandHeader header;
+		memcpy(&header, stream + offset, sizeof(header));
+		const uint8_t* pCommand = stream + offset;
+		offset += header.size;
+
+		switch (header.type)
+		{
+		case CommandType::SetPipeline:
+		{
+			SetPipelineCommand command;
+			memcpy(&command, pCommand, sizeof(command));
+			state.pipeline = command.pipeline;
+			break;
+		}
+
+		case CommandType::SetViewport:
+		{
+			SetViewportCommand command;
+			memcpy(&command, pCommand, sizeof(command));
+			state.viewport = command.viewport;
+			break;
+		}
+
+		case CommandType::ClearRenderTarget:
+		{
+			ClearRenderTargetCommand command;
+			memcpy(&command, pCommand, sizeof(command));
+			std::fill(m_colorBuffer.begin(), m_colorBuffer.end(), PackColor(command.color));
+			break;
+		}
+
+		case CommandType::ClearDepth:
+		{
+			ClearDepthCommand command;
+			memcpy(&command, pCommand, sizeof(command));
+			std::fill(m_depthBuffer.begin(), m_depthBuffer.end(), command.depth);
+			break;
+		}
+
+		case CommandType::SetRootDescriptorTable:
+		{
+			SetRootDescriptorTableCommand command;
+			memcpy(&command, pCommand, sizeof(command));
+			state.tables[command.rootIndex] = command.firstSlot;
+			break;
+		}
+
+		case CommandType::SetRootConstantBuffer:
+		{
+			SetRootConstantBufferCommand command;
+			memcpy(&command, pCommand, sizeof(command));
+			state.rootBuffers[command.rootIndex] = command.buffer;
+			state.rootOffsets[command.rootIndex] = command.offset;
+			break;
+		}
+
+		case CommandType::SetVertexBuffer:
+		case CommandType::SetIndexBuffer:
+		{
+			SetBufferCommand command;
+			memcpy(&command, pCommand, sizeof(command));
+			if (header.type == CommandType::SetVertexBuffer)
+				state.vertexBuffer = command.buffer;
+			else
+				state.indexBuffer = command.buffer;
+			break;
+		}
+
+		case CommandType::DrawIndexedInstanced:
+		{
+			DrawIndexedInstancedCommand command;
+			memcpy(&command, pCommand, sizeof(command));
+			Draw(state, command);
+			break;
+		}
+		}
+	}
+}
+
+// Finds the b0 constant buffer visible to the vertex stage. Each instance's
+// entry starts with the transposed world-view-projection matrix, matching
+// ModelShader.hlsl.
+const float* SoftwareRenderDevice::FindTransform(const ExecutionState& state, uint32_t instance) const
+{
+	const Pipeline* pPipeline = GetPipeline(state.pipeline);
+	if (!pPipeline)
+		return nullptr;
+
+	for (uint32_t i = 0; i < pPipeline->rootParameterCount; ++i)
+	{
+		const RenderRootParameter& parameter = pPipeline->rootParameters[i];
+		if (!IsVertexVisible(parameter.visibility))
+			continue;
+
+		const Buffer* pBuffer = nullptr;
+		uint64_t offset = 0;
+
+		if (parameter.type == RenderRootParameterType::ConstantBuffer)
+		{
+			if (parameter.shaderRegister != 0)
+				continue;
+
+			pBuffer = GetBuffer(state.rootBuffers[i]);
+			offset = state.rootOffsets[i];
+		}
+		else
+		{
+			uint32_t slot = state.tables[i];
+			for (uint32_t r = 0; r < parameter.rangeCount && !pBuffer; ++r)
+			{
+				const RenderDescriptorRange& range = parameter.ranges[r];
+				if (range.type == RenderDescriptorType::ConstantBuffer && range.baseRegister == 0)
+				{
+					const Descriptor* pDescriptor = GetDescriptor(slot);
+					if (pDescriptor)
+					{
+						pBuffer = GetBuffer(pDescriptor->buffer);
+						offset = pDescriptor->offset;
+					}
+				}
+				slot += range.count;
+			}
+		}
+
+		offset += static_cast<uint64_t>(instance) * pPipeline->instanceConstantStride;
+		if (pBuffer && offset + 16 * sizeof(float) <= pBuffer->data.size())
+			return reinterpret_cast<const float*>(pBuffer->data.data() + offset);
+	}
+
+	return nullptr;
+}
+
+void SoftwareRenderDevice::Draw(const ExecutionState& state, const DrawIndexedInstancedCommand& command)
+{
+	const Pipeline* pPipeline = GetPipeline(state.pipeline);
+	const Buffer* pVertexBuffer = GetBuffer(state.vertexBuffer);
+	const Buffer* pIndexBuffer = GetBuffer(state.indexBuffer);
+	if (!pPipeline || !pVertexBuffer || !pIndexBuffer)
+		return;
+
+	// Without a per-instance stride every instance shares the transform, so one
+	// pass covers them all. As with SV_InstanceID, instances count from zero
+	// whatever the start instance.
+	const uint32_t passCount = pPipeline->instanceConstantStride ? command.instanceCount : 1;
+	for (uint32_t instance = 0; instance < passCount; ++instance)
+	{
+		const float* transform = FindTransform(state, instance);
+		if (!transform)
+			return;
+
+		DrawInstance(pPipeline, pVertexBuffer, pIndexBuffer, transform, state.viewport, command);
+	}
+}
+
+void SoftwareRenderDevice::DrawInstance(const Pipeline* pPipeline, const Buffer* pVertexBuffer, const Buffer* pIndexBuffer,
+	const float* transform, const RenderViewport& viewport, const DrawIndexedInstancedCommand& command)
+{
+	const uint32_t components = (pPipeline->positionFormat == RenderVertexFormat::Float2) ? 2
+		: (pPipeline->positionFormat == RenderVertexFormat::Float3) ? 3 : 4;
+	const size_t vertexCount = pVertexBuffer->data.size() / pVertexBuffer->strideInBytes;
+
+	for (uint32_t i = 0; i + 2 < command.indexCount; i += 3)
+	{
+		float clip[3][4];
+		bool valid = true;
+
+		for (uint32_t v = 0; v < 3 && valid; ++v)
+		{
+			const size_t indexOffset = static_cast<size_t>(command.startIndex + i + v) * pIndexBuffer->strideInBytes;
+			uint32_t index;
+			if (pIndexBuffer->strideInBytes == 2)
+			{
+				uint16_t index16;
+				memcpy(&index16, pIndexBuffer->data.data() + indexOffset, sizeof(index16));
+				index = index16;
+			}
+			else
+			{
+				memcpy(&index, pIndexBuffer->data.data() + indexOffset, sizeof(index));
+			}
+
+			const int64_t vertex = static_cast<int64_t>(index) + command.baseVertex;
+			if (vertex < 0 || static_cast<size_t>(vertex) >= vertexCount)
+			{
+				valid = false;
+				break;
+			}
+
+			float position[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+			memcpy(position, pVertexBuffer->data.data() + static_cast<size_t>(vertex) * pVertexBuffer->strideInBytes + pPipeline->positionOffset,
+				components * sizeof(float));
+
+			// mul(position, WVP) with the matrix stored transposed.
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				const float* column = transform + c * 4;
+				clip[v][c] = position[0] * column[0] + position[1] * column[1] + position[2] * column[2] + position[3] * column[3];
+			}
+		}
+
+		if (valid)
+		{
+			RasterizeTriangle(viewport, clip[0], clip[1], clip[2]);
+		}
+	}
+}
+
+// Half-space rasteriser with a LESS depth test and back-face culling
+// (clockwise front faces, as the D3D12 default rasteriser state).
+// Triangles crossing the near plane are dropped rather than clipped.
+void SoftwareRenderDevice::RasterizeTriangle(const RenderViewport& viewport, const float* v0, const float* v1, const float* v2)
+{
+	const float* clip[3] = { v0, v1, v2 };
+	float sx[3], sy[3], sz[3];
+
+	for (uint32_t v = 0; v < 3; ++v)
+	{
+		const float w = clip[v][3];
+		if (w <= 1e-5f)
+			return;
+
+		const float invW = 1.0f / w;
+		sx[v] = viewport.x + (clip[v][0] * invW * 0.5f + 0.5f) * viewport.width;
+		sy[v] = viewport.y + (0.5f - clip[v][1] * invW * 0.5f) * viewport.height;
+		sz[v] = viewport.minDepth + clip[v][2] * invW * (viewport.maxDepth - viewport.minDepth);
+	}
+
+	const float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+	if (area <= 0.0f)
+		return;
+
+	const float right = std::min(viewport.x + viewport.width, static_cast<float>(m_desc.width));
+	const float bottom = std::min(viewport.y + viewport.height, static_cast<float>(m_desc.height));
+
+	const int minX = static_cast<int>(std::max(std::min(std::min(sx[0], sx[1]), sx[2]), std::max(viewport.x, 0.0f)));
+	const int minY = static_cast<int>(std::max(std::min(std::min(sy[0], sy[1]), sy[2]), std::max(viewport.y, 0.0f)));
+	const int maxX = static_cast<int>(std::min(std::max(std::max(sx[0], sx[1]), sx[2]) + 1.0f, right));
+	const int maxY = static_cast<int>(std::min(std::max(std::max(sy[0], sy[1]), sy[2]) + 1.0f, bottom));
+
+	const float invArea = 1.0f / area;
+	uint64_t written = 0;
+
+	for (int y = minY; y < maxY; ++y)
+	{
+		const float py = static_cast<float>(y) + 0.5f;
+		uint32_t* colorRow = &m_colorBuffer[static_cast<size_t>(y) * m_desc.width];
+		float* depthRow = &m_depthBuffer[static_cast<size_t>(y) * m_desc.width];
+
+		for (int x = minX; x < maxX; ++x)
+		{
+			const float px = static_cast<float>(x) + 0.5f;
+			const float w0 = (sx[2] - sx[1]) * (py - sy[1]) - (sy[2] - sy[1]) * (px - sx[1]);
+			const float w1 = (sx[0] - sx[2]) * (py - sy[2]) - (sy[0] - sy[2]) * (px - sx[2]);
+			const float w2 = (sx[1] - sx[0]) * (py - sy[0]) - (sy[1] - sy[0]) * (px - sx[0]);
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+
+			const float z = (w0 * sz[0] + w1 * sz[1] + w2 * sz[2]) * invArea;
+			if (z < depthRow[x])
+			{
+				depthRow[x] = z;
+
+				const uint32_t shade = static_cast<uint32_t>((1.0f - std::min(std::max(z, 0.0f), 1.0f)) * 255.0f);
+				colorRow[x] = 0xFF000000u | (shade << 16) | (shade << 8) | shade;
+				++written;
+			}
+		}
+	}
+
+	m_stats.pixelsWritten += written;
+}
+
+//
+std::unique_ptr<RenderDevice> CreateHeadlessRenderDevice(RenderBackend backend, const RenderDeviceDesc& desc)
+{
+	switch (backend)
+	{
+	case RenderBackend::Null:
+		return std::unique_ptr<RenderDevice>(new NullRenderDevice(desc));
+
+	case RenderBackend::Software:
+		return std::unique_ptr<RenderDevice>(new SoftwareRenderDevice(desc));
+
+	default:
+		throw std::invalid_argument("CreateHeadlessRenderDevice: not a headless backend");
+	}
+}
@@ -0,0 +1,260 @@
+//*********************************************************
+//
+// RenderDeviceNull.h
+//
+// Headless render backends. NullRenderDevice records every command into a
+// compact byte stream and validates it against the bound pipeline, buffers
+// and descriptors; SoftwareRenderDevice additionally replays the stream
+// through a simple CPU rasteriser so draws cost roughly what they would
+// cost to shade depth.
+//
+// Like RenderDevice.h, these files only use the C++ standard library.
+//
+//*********************************************************
+
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <string>
+#include <vector>
+
+class NullRenderDevice : public RenderDevice
+{
+public:
+	explicit NullRenderDevice(const RenderDeviceDesc& desc);
+	virtual ~NullRenderDevice();
+
+	virtual RenderBackend GetBackend() const { return RenderBackend::Null; }
+
+	virtual RenderBufferHandle CreateBuffer(const RenderBufferDesc& desc, const void* initialData);
+	virtual void* MapBuffer(RenderBufferHandle buffer);
+	virtual RenderTextureHandle LoadTexture(const wchar_t* filename, RenderTextureDimension dimension);
+	virtual RenderPipelineHandle CreatePipeline(const RenderPipelineDesc& desc);
+
+	virtual void CreateConstantBufferView(uint32_t slot, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes);
+	virtual void CreateTextureView(uint32_t slot, RenderTextureHandle texture);
+	virtual void CreateStagingConstantBufferView(uint32_t stagingSlot, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes);
+	virtual void CreateStagingTextureView(uint32_t stagingSlot, RenderTextureHandle texture);
+	virtual void CopyDescriptors(uint32_t dstSlot, uint32_t srcStagingSlot, uint32_t count);
+
+	virtual void FinishUploads() { FlushDescriptorCopies(); }
+	virtual void SavePipelineCache() {}
+
+	virtual RenderCommandList* BeginFrame();
+	virtual void EndFrame();
+	virtual void WaitForIdle();
+
+	virtual uint32_t GetWorkerCommandListCount() const { return m_desc.workerCommandLists; }
+	virtual RenderCommandList* BeginWorkerCommandList(uint32_t worker);
+	virtual void EndWorkerCommandList(uint32_t worker);
+
+	virtual uint32_t GetFramesInFlight() const { return m_desc.framesInFlight; }
+	virtual uint32_t GetFrameIndex() const { return m_frameIndex; }
+	virtual uint64_t GetFrameFence() const { return m_nextFence; }
+	virtual uint64_t GetCompletedFence() const { return m_completedFence; }
+
+	virtual const RenderStats& GetStats() const { return m_stats; }
+	virtual void ResetStats();
+
+	// The most recent validation failure, or an empty string.
+	const std::string& GetLastValidationError() const { return m_lastValidationError; }
+
+protected:
+	enum class CommandType : uint16_t
+	{
+		SetPipeline,
+		SetViewport,
+		ClearRenderTarget,
+		ClearDepth,
+		SetRootDescriptorTable,
+		SetRootConstantBuffer,
+		SetVertexBuffer,
+		SetIndexBuffer,
+		DrawIndexedInstanced,
+	};
+
+	// Every command starts with a header; size covers the header and the payload.
+	struct CommandHeader
+	{
+		CommandType type;
+		uint16_t size;
+	};
+
+	struct SetPipelineCommand { CommandHeader header; RenderPipelineHandle pipeline; };
+	struct SetViewportCommand { CommandHeader header; RenderViewport viewport; };
+	struct ClearRenderTargetCommand { CommandHeader header; float color[4]; };
+	struct ClearDepthCommand { CommandHeader header; float depth; };
+	struct SetRootDescriptorTableCommand { CommandHeader header; uint32_t rootIndex; uint32_t firstSlot; };
+	struct SetRootConstantBufferCommand { CommandHeader header; uint32_t rootIndex; RenderBufferHandle buffer; uint64_t offset; };
+	struct SetBufferCommand { CommandHeader header; RenderBufferHandle buffer; };
+	struct DrawIndexedInstancedCommand
+	{
+		CommandHeader header;
+		uint32_t indexCount;
+		uint32_t instanceCount;
+		uint32_t startIndex;
+		int32_t baseVertex;
+		uint32_t startInstance;
+	};
+
+	struct Buffer
+	{
+		RenderBufferUsage usage;
+		uint32_t strideInBytes;
+		std::vector<uint8_t> data;
+	};
+
+	struct Pipeline
+	{
+		RenderRootParameter rootParameters[RenderMaxRootParameters];
+		uint32_t rootParameterCount;
+		RenderVertexFormat positionFormat;
+		uint32_t positionOffset;
+		uint32_t instanceConstantStride;
+	};
+
+	struct Descriptor
+	{
+		bool valid;
+		RenderDescriptorType type;
+		RenderBufferHandle buffer;
+		uint64_t offset;
+		uint32_t sizeInBytes;
+		RenderTextureHandle texture;
+	};
+
+	// Each command list records into its own stream and counters, so worker
+	// lists can be recorded concurrently; EndFrame merges them in order.
+	class CommandList : public RenderCommandList
+	{
+	public:
+		explicit CommandList(NullRenderDevice* device);
+
+		void Reset();
+
+		const std::vector<uint8_t>& GetStream() const { return m_stream; }
+		const RenderStats& GetStats() const { return m_stats; }
+		const std::string& GetLastValidationError() const { return m_lastValidationError; }
+
+		virtual void SetPipeline(RenderPipelineHandle pipeline);
+		virtual void SetViewport(const RenderViewport& viewport);
+		virtual void ClearRenderTarget(const float color[4]);
+		virtual void ClearDepth(float depth);
+		virtual void SetRootDescriptorTable(uint32_t rootIndex, uint32_t firstSlot);
+		virtual void SetRootConstantBuffer(uint32_t rootIndex, RenderBufferHandle buffer, uint64_t offset);
+		virtual void SetVertexBuffer(RenderBufferHandle buffer);
+		virtual void SetIndexBuffer(RenderBufferHandle buffer);
+		virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+			uint32_t startIndex, int32_t baseVertex, uint32_t startInstance);
+
+	private:
+		template<typename T> void Emit(T& command, CommandType type);
+		bool Validate(bool condition, const char* message);
+
+		NullRenderDevice* m_device;
+		std::vector<uint8_t> m_stream;
+		RenderStats m_stats;
+		std::string m_lastValidationError;
+
+		// Validation state.
+		RenderPipelineHandle m_pipeline;
+		uint32_t m_boundRootParameters;
+		RenderBufferHandle m_vertexBuffer;
+		RenderBufferHandle m_indexBuffer;
+	};
+
+	const Buffer* GetBuffer(RenderBufferHandle buffer) const;
+	const Pipeline* GetPipeline(RenderPipelineHandle pipeline) const;
+	const Descriptor* GetDescriptor(uint32_t slot) const;
+
+	void WriteConstantBufferView(Descriptor& descriptor, RenderBufferHandle buffer, uint64_t offset, uint32_t sizeInBytes);
+	void WriteTextureView(Descriptor& descriptor, RenderTextureHandle texture);
+
+	// Copies are applied immediately so recording validates against them; the
+	// flush only accounts for the batch the D3D12 backend would issue.
+	void FlushDescriptorCopies();
+
+	enum class ListState
+	{
+		Idle,
+		Recording,
+		Recorded,
+	};
+
+	struct WorkerCommandList
+	{
+		std::unique_ptr<CommandList> commandList;
+		ListState state;
+	};
+
+	// Returns condition so callers can bail out of the failing command.
+	bool Validate(bool condition, const char* message);
+
+	// Merges a recorded list into the frame statistics and executes it.
+	void SubmitCommandList(const CommandList& commandList);
+
+	// Called by EndFrame with the command stream of each submitted list, in order.
+	virtual void ExecuteCommands(const uint8_t* /*stream*/, size_t /*size*/) {}
+
+	RenderDeviceDesc m_desc;
+	RenderStats m_stats;
+
+	std::vector<Buffer> m_buffers;
+	std::vector<Pipeline> m_pipelines;
+	std::vector<Descriptor> m_descriptors;
+	std::vector<Descriptor> m_stagingDescriptors;
+	bool m_descriptorCopiesPending;
+	uint32_t m_textureCount;
+
+	CommandList m_commandList;
+	std::vector<WorkerCommandList> m_workerCommandLists;
+	bool m_recording;
+
+	// Simulated frame pacing. The "GPU" retires a frame only when BeginFrame
+	// needs its context back, so fence-based reuse is exercised at the
+	// maximum queue depth.
+	uint32_t m_frameIndex;
+	uint64_t m_frameFences[RenderMaxFramesInFlight];
+	uint64_t m_nextFence;
+	uint64_t m_completedFence;
+
+	std::string m_lastValidationError;
+};
+
+class SoftwareRenderDevice : public NullRenderDevice
+{
+public:
+	explicit SoftwareRenderDevice(const RenderDeviceDesc& desc);
+	virtual ~SoftwareRenderDevice();
+
+	virtual RenderBackend GetBackend() const { return RenderBackend::Software; }
+
+	// RGBA8 colour and 32-bit float depth, width * height each.
+	const uint32_t* GetColorBuffer() const { return m_colorBuffer.data(); }
+	const float* GetDepthBuffer() const { return m_depthBuffer.data(); }
+
+protected:
+	virtual void ExecuteCommands(const uint8_t* stream, size_t size);
+
+private:
+	struct ExecutionState
+	{
+		RenderViewport viewport;
+		RenderPipelineHandle pipeline;
+		uint32_t tables[RenderMaxRootParameters];
+		RenderBufferHandle rootBuffers[RenderMaxRootParameters];
+		uint64_t rootOffsets[RenderMaxRootParameters];
+		RenderBufferHandle vertexBuffer;
+		RenderBufferHandle indexBuffer;
+	};
+
+	const float* FindTransform(const ExecutionState& state, uint32_t instance) const;
+	void Draw(const ExecutionState& state, const DrawIndexedInstancedCommand& command);
+	void DrawInstance(const Pipeline* pPipeline, const Buffer* pVertexBuffer, const Buffer* pIndexBuffer,
+		const float* transform, const RenderViewport& viewport, const DrawIndexedInstancedCommand& command);
+	void RasterizeTriangle(const RenderViewport& viewport, const float* v0, const float* v1, const float* v2);
+
+	std::vector<uint32_t> m_colorBuffer;
+	std::vector<float> m_depthBuffer;
+};
@@ -0,0 +1,160 @@
+//*********************************************************
+//
+// RenderStateFilter.cpp
+//
+//*********************************************************
+
+#include "RenderStateFilter.h"
+
+#include <cstring>
+
+RenderStateFilter::RenderStateFilter() :
+	m_pCommandList(nullptr),
+	m_pipeline(0),
+	m_viewportSet(false),
+	m_viewport(),
+	m_rootArguments(),
+	m_vertexBuffer(0),
+	m_indexBuffer(0),
+	m_stats()
+{
+}
+
+void RenderStateFilter::Begin(RenderCommandList* pCommandList)
+{
+	m_pCommandList = pCommandList;
+	m_pipeline = 0;
+	m_viewportSet = false;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	ForgetRootArguments();
+}
+
+void RenderStateFilter::ResetStats()
+{
+	m_stats = RenderStateFilterStats();
+}
+
+uint64_t RenderStateFilter::GetSkippedCount() const
+{
+	return m_stats.pipelinesSkipped + m_stats.viewportsSkipped + m_stats.rootArgumentsSkipped + m_stats.buffersSkipped;
+}
+
+void RenderStateFilter::ForgetRootArguments()
+{
+	for (RootArgument& argument : m_rootArguments)
+	{
+		argument.type = RootArgumentType::None;
+	}
+}
+
+void RenderStateFilter::SetPipeline(RenderPipelineHandle pipeline)
+{
+	++m_stats.stateCommands;
+	if (pipeline && pipeline == m_pipeline)
+	{
+		++m_stats.pipelinesSkipped;
+		return;
+	}
+
+	m_pipeline = pipeline;
+	ForgetRootArguments();
+	m_pCommandList->SetPipeline(pipeline);
+}
+
+void RenderStateFilter::SetViewport(const RenderViewport& viewport)
+{
+	++m_stats.stateCommands;
+	if (m_viewportSet && memcmp(&viewport, &m_viewport, sizeof(viewport)) == 0)
+	{
+		++m_stats.viewportsSkipped;
+		return;
+	}
+
+	m_viewport = viewport;
+	m_viewportSet = true;
+	m_pCommandList->SetViewport(viewport);
+}
+
+void RenderStateFilter::ClearRenderTarget(const float color[4])
+{
+	m_pCommandList->ClearRenderTarget(color);
+}
+
+void RenderStateFilter::ClearDepth(float depth)
+{
+	m_pCommandList->ClearDepth(depth);
+}
+
+void RenderStateFilter::SetRootDescriptorTable(uint32_t rootIndex, uint32_t firstSlot)
+{
+	++m_stats.stateCommands;
+
+	// Out-of-range indices go through untracked so the backend reports them.
+	if (rootIndex < RenderMaxRootParameters)
+	{
+		RootArgument& argument = m_rootArguments[rootIndex];
+		if (argument.type == RootArgumentType::DescriptorTable && argument.offset == firstSlot)
+		{
+			++m_stats.rootArgumentsSkipped;
+			return;
+		}
+
+		argument.type = RootArgumentType::DescriptorTable;
+		argument.buffer = 0;
+		argument.offset = firstSlot;
+	}
+	m_pCommandList->SetRootDescriptorTable(rootIndex, firstSlot);
+}
+
+void RenderStateFilter::SetRootConstantBuffer(uint32_t rootIndex, RenderBufferHandle buffer, uint64_t offset)
+{
+	++m_stats.stateCommands;
+
+	if (rootIndex < RenderMaxRootParameters)
+	{
+		RootArgument& argument = m_rootArguments[rootIndex];
+		if (argument.type == RootArgumentType::ConstantBuffer && argument.buffer == buffer && argument.offset == offset)
+		{
+			++m_stats.rootArgumentsSkipped;
+			return;
+		}
+
+		argument.type = RootArgumentType::ConstantBuffer;
+		argument.buffer = buffer;
+		argument.offset = offset;
+	}
+	m_pCommandList->SetRootConstantBuffer(rootIndex, buffer, offset);
+}
+
+void RenderStateFilter::SetVertexBuffer(RenderBufferHandle buffer)
+{
+	++m_stats.stateCommands;
+	if (buffer && buffer == m_vertexBuffer)
+	{
+		++m_stats.buffersSkipped;
+		return;
+	}
+
+	m_vertexBuffer = buffer;
+	m_pCommandList->SetVertexBuffer(buffer);
+}
+
+void RenderStateFilter::SetIndexBuffer(RenderBufferHandle buffer)
+{
+	++m_stats.stateCommands;
+	if (buffer && buffer == m_indexBuffer)
+	{
+		++m_stats.buffersSkipped;
+		return;
+	}
+
+	m_indexBuffer = buffer;
+	m_pCommandList->SetIndexBuffer(buffer);
+}
+
+void RenderStateFilter::DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+	uint32_t startIndex, int32_t baseVertex, uint32_t startInstance)
+{
+	m_pCommandList->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
@@ -0,0 +1,86 @@
+//*********************************************************
+//
+// RenderStateFilter.h
+//
+// A command list that forwards to another one but drops state commands that
+// would set what is already bound: the same pipeline, viewport, root
+// argument, vertex buffer or index buffer. Recording code can then set the
+// full state of every draw and leave it to the filter to emit only the
+// changes, which after sorting draws by state are few.
+//
+// A pipeline change forgets the root arguments, since a different root
+// layout would invalidate them. Use one filter per command list.
+//
+// Like RenderDevice.h, these files only use the C++ standard library.
+//
+//*********************************************************
+
+#pragma once
+
+#include "RenderDevice.h"
+
+// Counters accumulate until ResetStats.
+struct RenderStateFilterStats
+{
+	uint64_t stateCommands;		// State commands received.
+	uint64_t pipelinesSkipped;
+	uint64_t viewportsSkipped;
+	uint64_t rootArgumentsSkipped;
+	uint64_t buffersSkipped;	// Vertex and index buffers.
+};
+
+class RenderStateFilter : public RenderCommandList
+{
+public:
+	RenderStateFilter();
+
+	// Forwards to pCommandList from now on, with nothing known to be bound.
+	void Begin(RenderCommandList* pCommandList);
+
+	virtual void SetPipeline(RenderPipelineHandle pipeline);
+	virtual void SetViewport(const RenderViewport& viewport);
+	virtual void ClearRenderTarget(const float color[4]);
+	virtual void ClearDepth(float depth);
+
+	virtual void SetRootDescriptorTable(uint32_t rootIndex, uint32_t firstSlot);
+	virtual void SetRootConstantBuffer(uint32_t rootIndex, RenderBufferHandle buffer, uint64_t offset);
+
+	virtual void SetVertexBuffer(RenderBufferHandle buffer);
+	virtual void SetIndexBuffer(RenderBufferHandle buffer);
+	virtual void DrawIndexedInstanced(uint32_t indexCount, uint32_t instanceCount,
+		uint32_t startIndex, int32_t baseVertex, uint32_t startInstance);
+
+	const RenderStateFilterStats& GetStats() const { return m_stats; }
+	void ResetStats();
+
+	// State commands dropped since the last ResetStats.
+	uint64_t GetSkippedCount() const;
+
+private:
+	enum class RootArgumentType
+	{
+		None,
+		DescriptorTable,
+		ConstantBuffer,
+	};
+
+	struct RootArgument
+	{
+		RootArgumentType type;
+		RenderBufferHandle buffer;
+		uint64_t offset;			// Buffer offset, or the table's first slot.
+	};
+
+	void ForgetRootArguments();
+
+	RenderCommandList* m_pCommandList;
+
+	RenderPipelineHandle m_pipeline;
+	bool m_viewportSet;
+	RenderViewport m_viewport;
+	RootArgument m_rootArguments[RenderMaxRootParameters];
+	RenderBufferHandle m_vertexBuffer;
+	RenderBufferHandle m_indexBuffer;
+
+	RenderStateFilterStats m_stats;
+};
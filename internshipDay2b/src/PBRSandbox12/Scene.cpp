@@ -0,0 +1,301 @@
+//*********************************************************
+//
+// Scene.cpp
+//
+//*********************************************************
+
+#include "Scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+	// Scale, then rotate, then translate, as XMMatrixAffineTransformation.
+	void ComposeMatrix(const SceneFloat3& position, const SceneQuaternion& q, float scale, SceneMatrix& out)
+	{
+		const float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		const float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		const float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+		out.m[0][0] = (1.0f - 2.0f * (yy + zz)) * scale;
+		out.m[0][1] = 2.0f * (xy + wz) * scale;
+		out.m[0][2] = 2.0f * (xz - wy) * scale;
+		out.m[0][3] = 0.0f;
+
+		out.m[1][0] = 2.0f * (xy - wz) * scale;
+		out.m[1][1] = (1.0f - 2.0f * (xx + zz)) * scale;
+		out.m[1][2] = 2.0f * (yz + wx) * scale;
+		out.m[1][3] = 0.0f;
+
+		out.m[2][0] = 2.0f * (xz + wy) * scale;
+		out.m[2][1] = 2.0f * (yz - wx) * scale;
+		out.m[2][2] = (1.0f - 2.0f * (xx + yy)) * scale;
+		out.m[2][3] = 0.0f;
+
+		out.m[3][0] = position.x;
+		out.m[3][1] = position.y;
+		out.m[3][2] = position.z;
+		out.m[3][3] = 1.0f;
+	}
+
+	void MultiplyMatrix(const SceneMatrix& a, const SceneMatrix& b, SceneMatrix& out)
+	{
+		for (int r = 0; r < 4; ++r)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				out.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c] + a.m[r][3] * b.m[3][c];
+			}
+		}
+	}
+}
+
+Scene::Scene() :
+	m_updatedNodes(0)
+{
+}
+
+SceneNodeId Scene::CreateNode(SceneNodeId parent)
+{
+	const SceneNodeId node = GetNodeCount();
+	if (parent != InvalidSceneNode && parent >= node)
+		throw std::invalid_argument("Scene: parent does not exist");
+
+	// Depth is one more than the parent's; roots are level 0.
+	uint32_t level = 0;
+	if (parent != InvalidSceneNode)
+	{
+		SceneNodeId ancestor = parent;
+		while (ancestor != InvalidSceneNode)
+		{
+			++level;
+			ancestor = m_parent[ancestor];
+		}
+	}
+	if (level >= m_levels.size())
+		m_levels.resize(level + 1);
+	m_levels[level].push_back(node);
+
+	const SceneFloat3 zero = { 0.0f, 0.0f, 0.0f };
+	const SceneQuaternion identity = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const SceneMatrix identityMatrix = { { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+
+	m_parent.push_back(parent);
+	m_localPosition.push_back(zero);
+	m_localRotation.push_back(identity);
+	m_localScale.push_back(1.0f);
+	m_localDirty.push_back(1);
+	m_worldChanged.push_back(0);
+
+	m_world.push_back(identityMatrix);
+	m_worldBoundsX.push_back(0.0f);
+	m_worldBoundsY.push_back(0.0f);
+	m_worldBoundsZ.push_back(0.0f);
+	m_worldBoundsRadius.push_back(0.0f);
+
+	m_model.push_back(SceneNoModel);
+	m_material.push_back(0);
+	m_pass.push_back(0);
+	m_pipeline.push_back(0);
+	m_localBoundsCenter.push_back(zero);
+	m_localBoundsRadius.push_back(0.0f);
+
+	return node;
+}
+
+void Scene::SetLocalPosition(SceneNodeId node, const SceneFloat3& position)
+{
+	m_localPosition[node] = position;
+	m_localDirty[node] = 1;
+}
+
+void Scene::SetLocalRotation(SceneNodeId node, const SceneQuaternion& rotation)
+{
+	m_localRotation[node] = rotation;
+	m_localDirty[node] = 1;
+}
+
+void Scene::SetLocalScale(SceneNodeId node, float scale)
+{
+	m_localScale[node] = scale;
+	m_localDirty[node] = 1;
+}
+
+void Scene::SetRenderable(SceneNodeId node, uint32_t model, uint32_t material,
+	const SceneFloat3& boundsCenter, float boundsRadius)
+{
+	m_model[node] = model;
+	m_material[node] = material;
+	m_localBoundsCenter[node] = boundsCenter;
+	m_localBoundsRadius[node] = boundsRadius;
+	m_localDirty[node] = 1;
+}
+
+void Scene::SetPipeline(SceneNodeId node, uint32_t pass, uint32_t pipeline)
+{
+	m_pass[node] = pass;
+	m_pipeline[node] = pipeline;
+}
+
+void Scene::BeginUpdate()
+{
+	m_updatedNodes.store(0);
+}
+
+void Scene::Update()
+{
+	BeginUpdate();
+	for (uint32_t level = 0; level < GetLevelCount(); ++level)
+	{
+		UpdateLevel(level, 0, static_cast<uint32_t>(m_levels[level].size()));
+	}
+}
+
+TaskGraph::TaskId Scene::AddUpdateTasks(TaskGraph& graph, uint32_t batchSize)
+{
+	if (!batchSize)
+		throw std::invalid_argument("Scene: batchSize must be at least 1");
+
+	// Each level's batches hang off the join task of the level above, which
+	// keeps the edge count linear in the number of batches.
+	TaskGraph::TaskId join = graph.AddTask([this](uint32_t) { BeginUpdate(); });
+
+	for (uint32_t level = 0; level < GetLevelCount(); ++level)
+	{
+		const uint32_t nodeCount = static_cast<uint32_t>(m_levels[level].size());
+		const TaskGraph::TaskId levelDone = graph.AddTask([](uint32_t) {});
+
+		for (uint32_t begin = 0; begin < nodeCount; begin += batchSize)
+		{
+			const uint32_t end = std::min(begin + batchSize, nodeCount);
+			const TaskGraph::TaskId batch = graph.AddTask([this, level, begin, end](uint32_t) { UpdateLevel(level, begin, end); });
+			graph.AddDependency(join, batch);
+			graph.AddDependency(batch, levelDone);
+		}
+
+		if (!nodeCount)
+			graph.AddDependency(join, levelDone);
+		join = levelDone;
+	}
+	return join;
+}
+
+void Scene::UpdateLevel(uint32_t level, uint32_t begin, uint32_t end)
+{
+	const SceneNodeId* pNodes = m_levels[level].data();
+	uint32_t updated = 0;
+
+	for (uint32_t i = begin; i < end; ++i)
+	{
+		const SceneNodeId node = pNodes[i];
+		const SceneNodeId parent = m_parent[node];
+
+		// Parents sit on the level above, which has already been updated.
+		if (!m_localDirty[node] && (parent == InvalidSceneNode || !m_worldChanged[parent]))
+		{
+			m_worldChanged[node] = 0;
+			continue;
+		}
+
+		SceneMatrix local;
+		ComposeMatrix(m_localPosition[node], m_localRotation[node], m_localScale[node], local);
+
+		SceneMatrix& world = m_world[node];
+		if (parent == InvalidSceneNode)
+			world = local;
+		else
+			MultiplyMatrix(local, m_world[parent], world);
+
+		// Move the bounding sphere centre and grow the radius by the largest axis scale.
+		const SceneFloat3& center = m_localBoundsCenter[node];
+		m_worldBoundsX[node] = center.x * world.m[0][0] + center.y * world.m[1][0] + center.z * world.m[2][0] + world.m[3][0];
+		m_worldBoundsY[node] = center.x * world.m[0][1] + center.y * world.m[1][1] + center.z * world.m[2][1] + world.m[3][1];
+		m_worldBoundsZ[node] = center.x * world.m[0][2] + center.y * world.m[1][2] + center.z * world.m[2][2] + world.m[3][2];
+
+		float maxScaleSquared = 0.0f;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float lengthSquared = world.m[axis][0] * world.m[axis][0] + world.m[axis][1] * world.m[axis][1] + world.m[axis][2] * world.m[axis][2];
+			maxScaleSquared = std::max(maxScaleSquared, lengthSquared);
+		}
+		m_worldBoundsRadius[node] = m_localBoundsRadius[node] * std::sqrt(maxScaleSquared);
+
+		m_localDirty[node] = 0;
+		m_worldChanged[node] = 1;
+		++updated;
+	}
+
+	if (updated)
+		m_updatedNodes.fetch_add(updated);
+}
+
+//
+void SceneDrawList::Build(const Scene& scene, const SceneNodeId* pNodes, uint32_t nodeCount,
+	const SceneMatrix& viewProj, uint32_t maxInstancesPerBatch)
+{
+	WriteKeys(scene, pNodes, nodeCount, viewProj);
+	Sort();
+	BuildBatches(maxInstancesPerBatch);
+}
+
+void SceneDrawList::WriteKeys(const Scene& scene, const SceneNodeId* pNodes, uint32_t nodeCount, const SceneMatrix& viewProj)
+{
+	const float* pX = scene.GetWorldBoundsX();
+	const float* pY = scene.GetWorldBoundsY();
+	const float* pZ = scene.GetWorldBoundsZ();
+
+	m_sorter.Resize(nodeCount);
+	uint64_t* pKeys = m_sorter.GetKeys();
+	uint32_t* pValues = m_sorter.GetValues();
+
+	uint32_t keyCount = 0;
+	for (uint32_t i = 0; i < nodeCount; ++i)
+	{
+		const SceneNodeId node = pNodes[i];
+		if (scene.GetModel(node) == SceneNoModel)
+			continue;
+
+		const float viewDepth = pX[node] * viewProj.m[0][3] + pY[node] * viewProj.m[1][3] + pZ[node] * viewProj.m[2][3] + viewProj.m[3][3];
+
+		DrawKeyFields fields;
+		fields.pass = scene.GetPass(node);
+		fields.pipeline = scene.GetPipeline(node);
+		fields.material = scene.GetMaterial(node);
+		fields.model = scene.GetModel(node);
+		fields.depth = QuantizeDrawDepth(viewDepth);
+
+		pKeys[keyCount] = PackDrawKey(fields);
+		pValues[keyCount] = node;
+		++keyCount;
+	}
+	m_sorter.Resize(keyCount);
+}
+
+void SceneDrawList::BuildBatches(uint32_t maxInstancesPerBatch)
+{
+	if (!maxInstancesPerBatch)
+		throw std::invalid_argument("SceneDrawList: maxInstancesPerBatch must be at least 1");
+
+	const uint32_t count = m_sorter.GetCount();
+	const uint64_t* pKeys = m_sorter.GetSortedKeys();
+	const uint32_t* pNodes = m_sorter.GetSortedValues();
+
+	m_batches.clear();
+	m_instances.assign(pNodes, pNodes + count);
+
+	uint64_t batchState = 0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const uint64_t state = GetDrawStateKey(pKeys[i]);
+		if (m_batches.empty() || state != batchState || m_batches.back().instanceCount == maxInstancesPerBatch)
+		{
+			const DrawKeyFields fields = UnpackDrawKey(pKeys[i]);
+			const SceneDrawBatch batch = { fields.pass, fields.pipeline, fields.material, fields.model, i, 0 };
+			m_batches.push_back(batch);
+			batchState = state;
+		}
+		++m_batches.back().instanceCount;
+	}
+}
@@ -0,0 +1,181 @@
+//*********************************************************
+//
+// Scene.h
+//
+// Scene graph stored as structure-of-arrays. Every per-node attribute
+// (parent, local transform, world matrix, world bounds, model and material
+// index) lives in its own array indexed by node id, so a pass that only
+// needs one attribute streams through just that array. Nodes are also
+// grouped by depth; a level only reads the level above it, so each level
+// can be updated in parallel batches. Only nodes whose local transform
+// changed, or whose parent's world transform changed, are recomputed.
+//
+// SceneDrawList sorts renderable nodes by the draw keys from DrawSort.h
+// and groups the ones that share every binding into instanced draw batches.
+//
+// Like RenderDevice.h, these files only use the C++ standard library.
+//
+//*********************************************************
+
+#pragma once
+
+#include "JobSystem.h"
+#include "DrawSort.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Matrices are row-major and transform row vectors (v * M), the same layout
+// and convention as DirectX::XMFLOAT4X4, so they can be loaded directly.
+struct SceneFloat3
+{
+	float x, y, z;
+};
+
+struct SceneQuaternion
+{
+	float x, y, z, w;
+};
+
+struct SceneMatrix
+{
+	float m[4][4];
+};
+
+typedef uint32_t SceneNodeId;
+static const SceneNodeId InvalidSceneNode = 0xffffffff;
+
+// Nodes without a model are transform-only.
+static const uint32_t SceneNoModel = 0xffffffff;
+
+class Scene
+{
+public:
+	Scene();
+
+	// Parents must be created before their children. Nodes start at the origin
+	// with no rotation and unit scale.
+	SceneNodeId CreateNode(SceneNodeId parent);
+
+	void SetLocalPosition(SceneNodeId node, const SceneFloat3& position);
+	void SetLocalRotation(SceneNodeId node, const SceneQuaternion& rotation);
+	void SetLocalScale(SceneNodeId node, float scale);
+
+	// Makes the node draw a model with a material. The bounding sphere is in
+	// the model's own space.
+	void SetRenderable(SceneNodeId node, uint32_t model, uint32_t material,
+		const SceneFloat3& boundsCenter, float boundsRadius);
+
+	// Draws the node in a render pass with a pipeline, both indices into the
+	// app's own tables. Renderables start in pass 0 with pipeline 0.
+	void SetPipeline(SceneNodeId node, uint32_t pass, uint32_t pipeline);
+
+	// Recomputes dirty world transforms on the calling thread.
+	void Update();
+
+	// Adds tasks that do the same as Update, one level after another, in batches
+	// of up to batchSize nodes. Returns a task that finishes after all of them.
+	// The tasks refer to the current node layout; rebuild the graph after
+	// creating nodes.
+	TaskGraph::TaskId AddUpdateTasks(TaskGraph& graph, uint32_t batchSize);
+
+	uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_parent.size()); }
+	uint32_t GetLevelCount() const { return static_cast<uint32_t>(m_levels.size()); }
+	SceneNodeId GetParent(SceneNodeId node) const { return m_parent[node]; }
+
+	const SceneMatrix& GetWorldMatrix(SceneNodeId node) const { return m_world[node]; }
+	uint32_t GetModel(SceneNodeId node) const { return m_model[node]; }
+	uint32_t GetMaterial(SceneNodeId node) const { return m_material[node]; }
+	uint32_t GetPass(SceneNodeId node) const { return m_pass[node]; }
+	uint32_t GetPipeline(SceneNodeId node) const { return m_pipeline[node]; }
+
+	// World-space bounding spheres, one component per array, indexed by node.
+	const float* GetWorldBoundsX() const { return m_worldBoundsX.data(); }
+	const float* GetWorldBoundsY() const { return m_worldBoundsY.data(); }
+	const float* GetWorldBoundsZ() const { return m_worldBoundsZ.data(); }
+	const float* GetWorldBoundsRadius() const { return m_worldBoundsRadius.data(); }
+
+	// Nodes recomputed by the last Update or run of the update tasks.
+	uint32_t GetUpdatedNodeCount() const { return m_updatedNodes.load(); }
+
+private:
+	void UpdateLevel(uint32_t level, uint32_t begin, uint32_t end);
+	void BeginUpdate();
+
+	// Hierarchy.
+	std::vector<SceneNodeId> m_parent;
+	std::vector<std::vector<SceneNodeId> > m_levels;	// Node ids by depth.
+
+	// Local transforms and change tracking.
+	std::vector<SceneFloat3> m_localPosition;
+	std::vector<SceneQuaternion> m_localRotation;
+	std::vector<float> m_localScale;
+	std::vector<uint8_t> m_localDirty;
+	std::vector<uint8_t> m_worldChanged;		// Set when the last update recomputed the node.
+
+	// World transforms and bounds.
+	std::vector<SceneMatrix> m_world;
+	std::vector<float> m_worldBoundsX;
+	std::vector<float> m_worldBoundsY;
+	std::vector<float> m_worldBoundsZ;
+	std::vector<float> m_worldBoundsRadius;
+
+	// Rendering.
+	std::vector<uint32_t> m_model;
+	std::vector<uint32_t> m_material;
+	std::vector<uint32_t> m_pass;
+	std::vector<uint32_t> m_pipeline;
+	std::vector<SceneFloat3> m_localBoundsCenter;
+	std::vector<float> m_localBoundsRadius;
+
+	std::atomic<uint32_t> m_updatedNodes;
+};
+
+// A run of instances that share a pass, pipeline, material and model. The
+// node ids of its instances are
+// GetInstances()[firstInstance, firstInstance + instanceCount).
+struct SceneDrawBatch
+{
+	uint32_t pass;
+	uint32_t pipeline;
+	uint32_t material;
+	uint32_t model;
+	uint32_t firstInstance;
+	uint32_t instanceCount;
+};
+
+class SceneDrawList
+{
+public:
+	// Sorts the given renderable nodes by draw key and groups them into batches
+	// on the calling thread; the same as WriteKeys, Sort and BuildBatches.
+	void Build(const Scene& scene, const SceneNodeId* pNodes, uint32_t nodeCount,
+		const SceneMatrix& viewProj, uint32_t maxInstancesPerBatch);
+
+	// Packs a draw key for every renderable node among the given ones. The depth
+	// field is the clip-space w of the node's bounds centre, which is the view
+	// depth for a perspective projection. Throws std::out_of_range if an index
+	// does not fit its key field.
+	void WriteKeys(const Scene& scene, const SceneNodeId* pNodes, uint32_t nodeCount, const SceneMatrix& viewProj);
+
+	// Sorts the keys, on the calling thread or as tasks; see RadixSorter.
+	void Sort() { m_sorter.Sort(); }
+	TaskGraph::TaskId AddSortTasks(TaskGraph& graph, TaskGraph::TaskId after, uint32_t partCount)
+	{
+		return m_sorter.AddSortTasks(graph, after, partCount);
+	}
+
+	// Starts a batch wherever the state changes. Runs longer than
+	// maxInstancesPerBatch are split. Within a batch, nodes are front to back.
+	void BuildBatches(uint32_t maxInstancesPerBatch);
+
+	const std::vector<SceneDrawBatch>& GetBatches() const { return m_batches; }
+	const std::vector<SceneNodeId>& GetInstances() const { return m_instances; }
+	const RadixSorter& GetSorter() const { return m_sorter; }
+
+private:
+	RadixSorter m_sorter;
+	std::vector<SceneDrawBatch> m_batches;
+	std::vector<SceneNodeId> m_instances;
+};
@@ -6,6 +6,8 @@
 #include <vector>
 
 SphereMesh::SphereMesh() : 
+	m_vertexBuffer(0),
+	m_indexBuffer(0),
 	m_vertexSize(0),
 	m_indexSize(0)
 {
@@ -17,7 +19,7 @@ SphereMesh::~SphereMesh()
 
 }
 
-void SphereMesh::InitVertex(ID3D12Device* pDevice, const uint32_t slices, const uint32_t stacks, const bool isReverse)
+void SphereMesh::InitVertex(RenderDevice* pDevice, const uint32_t slices, const uint32_t stacks, const bool isReverse)
 {
 	std::vector<Vertex> vertexArray;
 
@@ -55,23 +57,12 @@ void SphereMesh::InitVertex(ID3D12Device* pDevice, const uint32_t slices, const
 	m_vertexSize = static_cast<uint32_t>(vertexArray.size());
 	uint32_t vertexBufferSize = sizeof(Vertex) * m_vertexSize;
 
-	ThrowIfFailed(pDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&m_vertexBuffer)));
-
-	UINT8* pVertexDataBegin;
-	CD3DX12_RANGE readRange(0, 0);
-	ThrowIfFailed(m_vertexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pVertexDataBegin)));
-	memcpy(pVertexDataBegin, &vertexArray[0], sizeof(Vertex)*m_vertexSize);
-	m_vertexBuffer->Unmap(0, nullptr);
-
-	m_vertexBufferView.BufferLocation = m_vertexBuffer->GetGPUVirtualAddress();
-	m_vertexBufferView.StrideInBytes = sizeof(Vertex);
-	m_vertexBufferView.SizeInBytes = vertexBufferSize;
+	RenderBufferDesc vertexBufferDesc = {};
+	vertexBufferDesc.usage = RenderBufferUsage::Vertex;
+	vertexBufferDesc.sizeInBytes = vertexBufferSize;
+	vertexBufferDesc.strideInBytes = sizeof(Vertex);
+	vertexBufferDesc.name = L"Sphere vertex buffer";
+	m_vertexBuffer = pDevice->CreateBuffer(vertexBufferDesc, &vertexArray[0]);
 
 	std::vector<uint32_t> indexArray;
 
@@ -92,36 +83,25 @@ void SphereMesh::InitVertex(ID3D12Device* pDevice, const uint32_t slices, const
 	m_indexSize = static_cast<uint32_t>(indexArray.size());
 	uint32_t indexBufferSize =  sizeof(uint32_t) * m_indexSize;
 
-	ThrowIfFailed(pDevice->CreateCommittedResource(
-		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
-		D3D12_HEAP_FLAG_NONE,
-		&CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize),
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(&m_indexBuffer)));
-
-	UINT8* pIndexDataBegin;
-	ThrowIfFailed(m_indexBuffer->Map(0, &readRange, reinterpret_cast<void**>(&pIndexDataBegin)));
-	memcpy(pIndexDataBegin, &indexArray[0], sizeof(uint32_t)*m_indexSize);
-	m_indexBuffer->Unmap(0, nullptr);
-
-	m_indexBufferView.BufferLocation = m_indexBuffer->GetGPUVirtualAddress();
-	m_indexBufferView.Format = DXGI_FORMAT_R32_UINT;
-	m_indexBufferView.SizeInBytes = indexBufferSize;
+	RenderBufferDesc indexBufferDesc = {};
+	indexBufferDesc.usage = RenderBufferUsage::Index;
+	indexBufferDesc.sizeInBytes = indexBufferSize;
+	indexBufferDesc.strideInBytes = sizeof(uint32_t);
+	indexBufferDesc.name = L"Sphere index buffer";
+	m_indexBuffer = pDevice->CreateBuffer(indexBufferDesc, &indexArray[0]);
 }
 
-void SphereMesh::Init(ID3D12Device* pDevice, const uint32_t slices, const uint32_t stacks, const bool isReverse)
+void SphereMesh::Init(RenderDevice* pDevice, const uint32_t slices, const uint32_t stacks, const bool isReverse)
 {
 	InitVertex(pDevice,slices,stacks,isReverse);
 }
 
-HRESULT SphereMesh::DrawMesh(ID3D12GraphicsCommandList* pCommandList)
+HRESULT SphereMesh::DrawMesh(RenderCommandList* pCommandList)
 {
 	HRESULT hr = S_OK;
 
-	pCommandList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	pCommandList->IASetVertexBuffers(0, 1, &m_vertexBufferView);
-	pCommandList->IASetIndexBuffer(&m_indexBufferView);
+	pCommandList->SetVertexBuffer(m_vertexBuffer);
+	pCommandList->SetIndexBuffer(m_indexBuffer);
 	pCommandList->DrawIndexedInstanced(m_indexSize, 1, 0, 0, 0);
 
 	return hr;
@@ -1,7 +1,7 @@
 #pragma once
 
-#include <d3d12.h>
 #include <DirectXMath.h>
+#include "RenderDevice.h"
 
 class SphereMesh
 {
@@ -12,21 +12,18 @@ class SphereMesh
 		DirectX::XMFLOAT2 uv;
 	};
 
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_vertexBuffer;
-	D3D12_VERTEX_BUFFER_VIEW m_vertexBufferView;
-
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_indexBuffer;
-	D3D12_INDEX_BUFFER_VIEW m_indexBufferView;
+	RenderBufferHandle m_vertexBuffer;
+	RenderBufferHandle m_indexBuffer;
 
 	uint32_t m_vertexSize;
 	uint32_t m_indexSize;
 
-	void InitVertex(ID3D12Device* pDevice, const uint32_t slices, const uint32_t stacks, const bool isReverse);
+	void InitVertex(RenderDevice* pDevice, const uint32_t slices, const uint32_t stacks, const bool isReverse);
 
 public:
 	SphereMesh();
 	~SphereMesh();
 
-	void Init(ID3D12Device* pDevice, const uint32_t slices, const uint32_t stacks, const bool isReverse = false);
-	HRESULT DrawMesh(ID3D12GraphicsCommandList* pCommandList);
+	void Init(RenderDevice* pDevice, const uint32_t slices, const uint32_t stacks, const bool isReverse = false);
+	HRESULT DrawMesh(RenderCommandList* pCommandList);
 };
\ No newline at end of file
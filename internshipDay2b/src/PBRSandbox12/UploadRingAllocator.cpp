@@ -0,0 +1,132 @@
+//*********************************************************
+//
+// UploadRingAllocator.cpp
+//
+//*********************************************************
+
+#include "UploadRingAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+UploadRingAllocator::UploadRingAllocator() :
+	m_pDevice(nullptr),
+	m_buffer(0),
+	m_pData(nullptr),
+	m_capacity(0),
+	m_head(0),
+	m_tail(0),
+	m_frameStart(0),
+	m_frameFence(0),
+	m_frameOpen(false),
+	m_stats()
+{
+}
+
+UploadRingAllocator::~UploadRingAllocator()
+{
+}
+
+void UploadRingAllocator::Init(RenderDevice* pDevice, uint64_t capacity, const wchar_t* name)
+{
+	if (!pDevice || !capacity)
+		throw std::invalid_argument("UploadRingAllocator: device and capacity are required");
+
+	m_pDevice = pDevice;
+	m_capacity = (capacity + Alignment - 1) & ~static_cast<uint64_t>(Alignment - 1);
+
+	RenderBufferDesc bufferDesc = {};
+	bufferDesc.usage = RenderBufferUsage::Constant;
+	bufferDesc.sizeInBytes = m_capacity;
+	bufferDesc.name = name;
+
+	m_buffer = pDevice->CreateBuffer(bufferDesc, nullptr);
+	m_pData = static_cast<uint8_t*>(pDevice->MapBuffer(m_buffer));
+
+	m_head = m_tail = m_frameStart = 0;
+	m_frameOpen = false;
+	m_partitions.clear();
+}
+
+void UploadRingAllocator::BeginFrame()
+{
+	if (m_frameOpen)
+	{
+		const Partition partition = { m_frameFence, m_head };
+		m_partitions.push_back(partition);
+	}
+
+	Retire(m_pDevice->GetCompletedFence());
+
+	m_frameStart = m_head;
+	m_frameFence = m_pDevice->GetFrameFence();
+	m_frameOpen = true;
+}
+
+void UploadRingAllocator::Retire(uint64_t completedFence)
+{
+	while (!m_partitions.empty() && m_partitions.front().fence <= completedFence)
+	{
+		m_tail = m_partitions.front().end;
+		m_partitions.pop_front();
+	}
+}
+
+UploadAllocation UploadRingAllocator::Allocate(uint32_t sizeInBytes)
+{
+	if (!m_frameOpen)
+		throw std::logic_error("UploadRingAllocator: Allocate called before BeginFrame");
+
+	const uint64_t size = (std::max<uint64_t>(sizeInBytes, 1) + Alignment - 1) & ~static_cast<uint64_t>(Alignment - 1);
+
+	// Suballocations never straddle the end of the buffer; the remainder is skipped instead.
+	const uint64_t position = m_head % m_capacity;
+	const uint64_t skip = (position + size > m_capacity) ? m_capacity - position : 0;
+
+	if (m_head + skip + size - m_tail > m_capacity)
+	{
+		// Out of space: first pick up anything the GPU finished since BeginFrame,
+		// then drain the queue. Only the frame being recorded survives a drain.
+		Retire(m_pDevice->GetCompletedFence());
+
+		if (m_head + skip + size - m_tail > m_capacity)
+		{
+			m_pDevice->WaitForIdle();
+			++m_stats.stalls;
+
+			m_partitions.clear();
+			m_tail = m_frameStart;
+
+			// Draining may have consumed the fence value this frame was going to signal.
+			m_frameFence = m_pDevice->GetFrameFence();
+
+			if (m_head + skip + size - m_tail > m_capacity)
+				throw std::runtime_error("UploadRingAllocator: frame exceeds ring capacity");
+		}
+	}
+
+	m_head += skip;
+	m_stats.bytesSkipped += skip;
+
+	UploadAllocation allocation;
+	allocation.buffer = m_buffer;
+	allocation.offset = m_head % m_capacity;
+	allocation.pData = m_pData + allocation.offset;
+
+	if (m_head && !allocation.offset)
+		++m_stats.wraps;
+
+	m_head += size;
+
+	++m_stats.allocations;
+	m_stats.bytesAllocated += size;
+	m_stats.peakFrameBytes = std::max(m_stats.peakFrameBytes, m_head - m_frameStart);
+	m_stats.peakUsedBytes = std::max(m_stats.peakUsedBytes, m_head - m_tail);
+
+	return allocation;
+}
+
+void UploadRingAllocator::ResetStats()
+{
+	m_stats = UploadRingStats();
+}
@@ -0,0 +1,99 @@
+//*********************************************************
+//
+// UploadRingAllocator.h
+//
+// Linear allocator for per-draw constant data. One persistently mapped
+// constant buffer is used as a ring: every frame appends 256-byte aligned
+// suballocations at the head, and the space a frame used is reclaimed once
+// the device reports that frame's fence as completed.
+//
+// Like RenderDevice.h, these files only use the C++ standard library.
+//
+//*********************************************************
+
+#pragma once
+
+#include "RenderDevice.h"
+
+#include <cstring>
+#include <deque>
+
+struct UploadAllocation
+{
+	RenderBufferHandle buffer;
+	uint64_t offset;		// Pass to SetRootConstantBuffer.
+	void* pData;			// CPU write pointer, valid until the frame retires.
+};
+
+// Counters accumulate until ResetStats.
+struct UploadRingStats
+{
+	uint64_t allocations;
+	uint64_t bytesAllocated;	// Including alignment.
+	uint64_t bytesSkipped;		// Left unused at the end of the ring when wrapping.
+	uint64_t peakFrameBytes;
+	uint64_t peakUsedBytes;		// High-water mark of all frames still in flight.
+	uint64_t wraps;
+	uint64_t stalls;			// Allocations that had to wait for the GPU.
+};
+
+class UploadRingAllocator
+{
+public:
+	static const uint32_t Alignment = 256;
+
+	UploadRingAllocator();
+	~UploadRingAllocator();
+
+	// Capacity is rounded up to the alignment. It should hold framesInFlight
+	// frames of data; allocating more waits for the GPU, and a single frame
+	// that does not fit at all throws.
+	void Init(RenderDevice* pDevice, uint64_t capacity, const wchar_t* name);
+
+	// Call once per frame after RenderDevice::BeginFrame. Reclaims the space of
+	// retired frames and starts a new partition tagged with the frame's fence.
+	void BeginFrame();
+
+	UploadAllocation Allocate(uint32_t sizeInBytes);
+
+	template<typename T>
+	UploadAllocation Upload(const T& data)
+	{
+		UploadAllocation allocation = Allocate(sizeof(T));
+		memcpy(allocation.pData, &data, sizeof(T));
+		return allocation;
+	}
+
+	RenderBufferHandle GetBuffer() const { return m_buffer; }
+	uint64_t GetCapacity() const { return m_capacity; }
+	uint64_t GetUsedBytes() const { return m_head - m_tail; }
+	uint64_t GetFrameBytes() const { return m_head - m_frameStart; }
+
+	const UploadRingStats& GetStats() const { return m_stats; }
+	void ResetStats();
+
+private:
+	// A closed frame partition: its space up to end is free once fence completes.
+	struct Partition
+	{
+		uint64_t fence;
+		uint64_t end;
+	};
+
+	void Retire(uint64_t completedFence);
+
+	RenderDevice* m_pDevice;
+	RenderBufferHandle m_buffer;
+	uint8_t* m_pData;
+	uint64_t m_capacity;
+
+	// Head and tail grow monotonically; the ring position is value % capacity.
+	uint64_t m_head;
+	uint64_t m_tail;
+	uint64_t m_frameStart;
+	uint64_t m_frameFence;
+	bool m_frameOpen;
+	std::deque<Partition> m_partitions;
+
+	UploadRingStats m_stats;
+};
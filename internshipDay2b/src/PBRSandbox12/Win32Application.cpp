@@ -16,6 +16,14 @@
 #include "imgui_impl_win32.h"
 #include "imgui_impl_dx12.h"
 
+#include "JobBenchmark.h"
+#include "CullingBenchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
 HWND Win32Application::m_hwnd = nullptr;
 
 int Win32Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
@@ -26,6 +34,21 @@ int Win32Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
 	pSample->ParseCommandLineArgs(argv, argc);
 	LocalFree(argv);
 
+	if (pSample->IsJobBenchmark())
+	{
+		return RunJobBenchmark(pSample);
+	}
+
+	if (pSample->IsCullingBenchmark())
+	{
+		return RunCullingBenchmark(pSample);
+	}
+
+	if (pSample->IsHeadless())
+	{
+		return RunHeadless(pSample);
+	}
+
 	// Initialize the window class.
 	WNDCLASSEX windowClass = { 0 };
 	windowClass.cbSize = sizeof(WNDCLASSEX);
@@ -76,6 +99,144 @@ int Win32Application::Run(DXSample* pSample, HINSTANCE hInstance, int nCmdShow)
 	return static_cast<char>(msg.wParam);
 }
 
+// Runs the sample without a window for a fixed number of frames and prints
+// CPU frame timings, followed by the sample's own statistics.
+int Win32Application::RunHeadless(DXSample* pSample)
+{
+	AttachConsoleOutput();
+
+	try
+	{
+		pSample->OnInit();
+
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+
+		const UINT frameCount = pSample->GetHeadlessFrameCount();
+		std::vector<double> frameTimes(frameCount);
+
+		for (UINT i = 0; i < frameCount; ++i)
+		{
+			LARGE_INTEGER start, end;
+			QueryPerformanceCounter(&start);
+
+			pSample->OnUpdate();
+			pSample->OnRender();
+
+			QueryPerformanceCounter(&end);
+			frameTimes[i] = static_cast<double>(end.QuadPart - start.QuadPart) * 1000.0 / static_cast<double>(frequency.QuadPart);
+		}
+
+		double total = 0.0;
+		for (double t : frameTimes)
+		{
+			total += t;
+		}
+
+		std::sort(frameTimes.begin(), frameTimes.end());
+
+		wprintf(L"%ls\n", pSample->GetTitle());
+		wprintf(L"frames           %u\n", frameCount);
+		wprintf(L"cpu ms/frame     avg %.4f, min %.4f, p50 %.4f, p95 %.4f, max %.4f\n",
+			total / frameCount, frameTimes.front(), frameTimes[frameCount / 2],
+			frameTimes[std::min<size_t>(frameCount * 95 / 100, frameCount - 1)], frameTimes.back());
+
+		pSample->OnHeadlessReport();
+		pSample->OnDestroy();
+	}
+	catch (const std::exception& e)
+	{
+		printf("headless run failed: %s\n", e.what());
+		return 1;
+	}
+
+	fflush(stdout);
+	return 0;
+}
+
+// Runs the synthetic task graph from JobBenchmark.h on 1..N workers and prints
+// the time per graph and the speedup over one worker.
+int Win32Application::RunJobBenchmark(DXSample* pSample)
+{
+	AttachConsoleOutput();
+
+	const UINT iterationCount = 100;
+	const UINT maxWorkerCount = pSample->GetRecordingThreads() ?
+		pSample->GetRecordingThreads() : std::max(std::thread::hardware_concurrency(), 1u);
+
+	try
+	{
+		const std::vector<JobBenchmarkResult> results = ::RunJobBenchmark(maxWorkerCount, iterationCount);
+
+		wprintf(L"job system scaling, %u runs per worker count\n", iterationCount);
+		wprintf(L"workers  avg ms   min ms   speedup  efficiency  steals/run\n");
+		for (const JobBenchmarkResult& result : results)
+		{
+			wprintf(L"%-7u  %-7.3f  %-7.3f  %-7.2f  %-10.2f  %.1f\n", result.workerCount,
+				result.averageMilliseconds, result.minMilliseconds, result.speedup,
+				result.speedup / result.workerCount, static_cast<double>(result.steals) / iterationCount);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		printf("job benchmark failed: %s\n", e.what());
+		return 1;
+	}
+
+	fflush(stdout);
+	return 0;
+}
+
+// Runs the culling test from CullingBenchmark.h and prints the best time of
+// each stage. Without -objects it culls 100000 spheres.
+int Win32Application::RunCullingBenchmark(DXSample* pSample)
+{
+	AttachConsoleOutput();
+
+	const UINT iterationCount = 50;
+	const UINT objectCount = (pSample->GetObjectCount() > 1) ? pSample->GetObjectCount() : 100000;
+
+	try
+	{
+		const CullingBenchmarkResult result = ::RunCullingBenchmark(objectCount, iterationCount);
+
+		wprintf(L"culling %u spheres, best of %u runs\n", result.objectCount, iterationCount);
+		const WCHAR* simdNames[3] = { L"scalar", L"sse", L"avx" };
+		for (int mode = 0; mode < 3; ++mode)
+		{
+			if (result.frustumMilliseconds[mode] < 0.0)
+			{
+				wprintf(L"frustum %-7s  not supported\n", simdNames[mode]);
+				continue;
+			}
+			wprintf(L"frustum %-7s  %.3f ms (%.2fx scalar), %u visible\n", simdNames[mode], result.frustumMilliseconds[mode],
+				result.frustumMilliseconds[0] / std::max(result.frustumMilliseconds[mode], 1e-6), result.frustumVisible);
+		}
+		wprintf(L"occluders       %u triangles in %.3f ms, %u of %u tiles full\n",
+			result.occluderTriangles, result.occluderMilliseconds, result.fullTiles, result.tileCount);
+		wprintf(L"occlusion test  %.3f ms, %u of %u visible\n",
+			result.occlusionTestMilliseconds, result.occlusionVisible, result.frustumVisible);
+	}
+	catch (const std::exception& e)
+	{
+		printf("culling benchmark failed: %s\n", e.what());
+		return 1;
+	}
+
+	fflush(stdout);
+	return 0;
+}
+
+// The sample is a GUI subsystem app; borrow the console we were launched from.
+void Win32Application::AttachConsoleOutput()
+{
+	if (AttachConsole(ATTACH_PARENT_PROCESS) || AllocConsole())
+	{
+		FILE* pStream;
+		freopen_s(&pStream, "CONOUT$", "w", stdout);
+	}
+}
+
 extern LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 // Main message handler for the sample.
 LRESULT CALLBACK Win32Application::WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
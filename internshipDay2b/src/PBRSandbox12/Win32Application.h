@@ -22,6 +22,10 @@ public:
 	static HWND GetHwnd() { return m_hwnd; }
 
 protected:
+	static int RunHeadless(DXSample* pSample);
+	static int RunJobBenchmark(DXSample* pSample);
+	static int RunCullingBenchmark(DXSample* pSample);
+	static void AttachConsoleOutput();
 	static LRESULT CALLBACK WindowProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
 private: